@@ -0,0 +1,103 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/time.h>
+#include <sys/zio.h>
+#include <sys/zio_checksum.h>
+#include <sys/abd.h>
+#include <sys/blake3.h>
+#include <stdio.h>
+#include <strings.h>
+
+#include "blake3_test.h"
+
+#define	BENCH_MEMORY	(((uint64_t)1ULL)<<30)
+
+/*
+ * Checksum blocks of each size in the benchmark range with one
+ * implementation, the way ZFS does: through the zio checksum entry point,
+ * keyed with a salt, from both a linear and a scattered ABD.
+ */
+static void
+run_blake3_bench_impl(const char *impl)
+{
+	zio_cksum_salt_t salt;
+	zio_cksum_t zc;
+	void *tmpl;
+	uint64_t ds, iter_cnt, iter;
+	hrtime_t start;
+	double elapsed, bw;
+	uint8_t *buf;
+	abd_t *abd;
+	int i;
+
+	for (i = 0; i < sizeof (salt.zcs_bytes); i++)
+		salt.zcs_bytes[i] = i;
+	tmpl = abd_checksum_blake3_tmpl_init(&salt);
+
+	buf = umem_alloc(1ULL << bto_opts.bto_max_shift, UMEM_NOFAIL);
+	for (iter = 0; iter < (1ULL << bto_opts.bto_max_shift); iter++)
+		buf[iter] = rand();
+
+	for (ds = bto_opts.bto_min_shift; ds <= bto_opts.bto_max_shift;
+	    ds++) {
+		for (i = 0; i < 2; i++) {
+			if (i == 0)
+				abd = abd_alloc_linear(1ULL << ds, B_FALSE);
+			else
+				abd = abd_alloc(1ULL << ds, B_FALSE);
+			abd_copy_from_buf(abd, buf, 1ULL << ds);
+
+			iter_cnt = BENCH_MEMORY >> ds;
+
+			start = gethrtime();
+			for (iter = 0; iter < iter_cnt; iter++) {
+				abd_checksum_blake3_native(abd, 1ULL << ds,
+				    tmpl, &zc);
+			}
+			elapsed = NSEC2SEC((double)(gethrtime() - start));
+
+			bw = (double)iter_cnt * (double)(1ULL << ds);
+			bw /= (1024.0 * 1024.0 * elapsed);
+
+			LOG(D_ALL, "%10s, %9s, %10llu, %lf, %u\n",
+			    impl,
+			    abd_is_linear(abd) ? "linear" : "scattered",
+			    (u_longlong_t)(1ULL << ds),
+			    bw,
+			    (unsigned)iter_cnt);
+
+			abd_free(abd);
+		}
+	}
+
+	umem_free(buf, 1ULL << bto_opts.bto_max_shift);
+	abd_checksum_blake3_tmpl_free(tmpl);
+}
+
+void
+run_blake3_benchmark(void)
+{
+	char **impl_name;
+
+	LOG(D_INFO, DBLSEP "\nBenchmarking BLAKE3 implementations...\n\n");
+	LOG(D_ALL, "impl, abd, iosize, bw, iter\n");
+
+	for (impl_name = (char **)blake3_impl_names; *impl_name != NULL;
+	    impl_name++) {
+
+		if (blake3_impl_set(*impl_name) != 0)
+			continue;
+
+		run_blake3_bench_impl(*impl_name);
+	}
+}
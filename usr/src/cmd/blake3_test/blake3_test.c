@@ -0,0 +1,399 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Known answer tests for the BLAKE3 checksum.  Every implementation the
+ * CPU supports is run against the official BLAKE3 test vectors, both
+ * unkeyed and keyed, with the input fed to the hasher in pieces of
+ * several sizes and through linear and scattered ABDs, the way ZFS uses
+ * it.  With -B the implementations are benchmarked instead.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/zio.h>
+#include <sys/zio_checksum.h>
+#include <sys/abd.h>
+#include <sys/blake3.h>
+#include <stdio.h>
+#include <strings.h>
+
+#include "blake3_test.h"
+
+blake3_test_opts_t bto_opts;
+
+/*
+ * The input of vector i is len bytes with byte n equal to n % 251.  The
+ * keyed hash uses this key, which is also used as the checksum salt.
+ */
+static const char *kat_key = "whats the Elvish word for friend";
+
+typedef struct blake3_kat {
+	size_t		bk_len;
+	const char	*bk_hash;
+	const char	*bk_keyed_hash;
+} blake3_kat_t;
+
+static const blake3_kat_t blake3_kats[] = {
+	{ 0,
+	    "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262",
+	    "92b2b75604ed3c761f9d6f62392c8a9227ad0ea3f09573e783f1498a4ed60d26"
+	},
+	{ 1,
+	    "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213",
+	    "6d7878dfff2f485635d39013278ae14f1454b8c0a3a2d34bc1ab38228a80c95b"
+	},
+	{ 1023,
+	    "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11",
+	    "c951ecdf03288d0fcc96ee3413563d8a6d3589547f2c2fb36d9786470f1b9d6e"
+	},
+	{ 1024,
+	    "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7",
+	    "75c46f6f3d9eb4f55ecaaee480db732e6c2105546f1e675003687c31719c7ba4"
+	},
+	{ 1025,
+	    "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444",
+	    "357dc55de0c7e382c900fd6e320acc04146be01db6a8ce7210b7189bd664ea69"
+	},
+	{ 2048,
+	    "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a",
+	    "879cf1fa2ea0e79126cb1063617a05b6ad9d0b696d0d757cf053439f60a99dd1"
+	},
+	{ 2049,
+	    "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030",
+	    "9f29700902f7c86e514ddc4df1e3049f258b2472b6dd5267f61bf13983b78dd5"
+	},
+	{ 3072,
+	    "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2",
+	    "044a0e7b172a312dc02a4c9a818c036ffa2776368d7f528268d2e6b5df191770"
+	},
+	{ 3073,
+	    "7124b49501012f81cc7f11ca069ec9226cecb8a2c850cfe644e327d22d3e1cd3",
+	    "68dede9bef00ba89e43f31a6825f4cf433389fedae75c04ee9f0cf16a427c95a"
+	},
+	{ 4096,
+	    "015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969",
+	    "befc660aea2f1718884cd8deb9902811d332f4fc4a38cf7c7300d597a081bfc0"
+	},
+	{ 4097,
+	    "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995",
+	    "00df940cd36bb9fa7cbbc3556744e0dbc8191401afe70520ba292ee3ca80abbc"
+	},
+	{ 5120,
+	    "9cadc15fed8b5d854562b26a9536d9707cadeda9b143978f319ab34230535833",
+	    "2c493e48e9b9bf31e0553a22b23503c0a3388f035cece68eb438d22fa1943e20"
+	},
+	{ 5121,
+	    "628bd2cb2004694adaab7bbd778a25df25c47b9d4155a55f8fbd79f2fe154cff",
+	    "6ccf1c34753e7a044db80798ecd0782a8f76f33563accaddbfbb2e0ea4b2d024"
+	},
+	{ 6144,
+	    "3e2e5b74e048f3add6d21faab3f83aa44d3b2278afb83b80b3c35164ebeca205",
+	    "3d6b6d21281d0ade5b2b016ae4034c5dec10ca7e475f90f76eac7138e9bc8f1d"
+	},
+	{ 6145,
+	    "f1323a8631446cc50536a9f705ee5cb619424d46887f3c376c695b70e0f0507f",
+	    "9ac301e9e39e45e3250a7e3b3df701aa0fb6889fbd80eeecf28dbc6300fbc539"
+	},
+	{ 7168,
+	    "61da957ec2499a95d6b8023e2b0e604ec7f6b50e80a9678b89d2628e99ada77a",
+	    "b42835e40e9d4a7f42ad8cc04f85a963a76e18198377ed84adddeaecacc6f3fc"
+	},
+	{ 7169,
+	    "a003fc7a51754a9b3c7fae0367ab3d782dccf28855a03d435f8cfe74605e7817",
+	    "ed9b1a922c046fdb3d423ae34e143b05ca1bf28b710432857bf738bcedbfa511"
+	},
+	{ 8192,
+	    "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63",
+	    "dc9637c8845a770b4cbf76b8daec0eebf7dc2eac11498517f08d44c8fc00d58a"
+	},
+	{ 8193,
+	    "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b",
+	    "954a2a75420c8d6547e3ba5b98d963e6fa6491addc8c023189cc519821b4a1f5"
+	},
+	{ 16384,
+	    "f875d6646de28985646f34ee13be9a576fd515f76b5b0a26bb324735041ddde4",
+	    "9e9fc4eb7cf081ea7c47d1807790ed211bfec56aa25bb7037784c13c4b707b0d"
+	},
+	{ 31744,
+	    "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47",
+	    "efa53b389ab67c593dba624d898d0f7353ab99e4ac9d42302ee64cbf9939a419"
+	},
+	{ 102400,
+	    "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085",
+	    "1c35d1a5811083fd7119f5d5d1ba027b4d01c0c6c49fb6ff2cf75393ea5db4a7"
+	},
+};
+
+/* Sizes of the pieces the input is passed to Blake3_Update() in */
+static const size_t update_sizes[] = {
+	0, 1, 63, 64, 1000, 1024, 4096, 5000
+};
+
+static uint8_t *kat_data;
+static size_t kat_data_len;
+
+static void
+usage(boolean_t requested)
+{
+	const blake3_test_opts_t *o = &bto_opts_defaults;
+
+	FILE *fp = requested ? stdout : stderr;
+
+	(void) fprintf(fp, "Usage:\n"
+	    "\t[-B benchmark all BLAKE3 implementations]\n"
+	    "\t[-s smallest benchmark size, exponent radix 2 (default: %zu)]\n"
+	    "\t[-S largest benchmark size, exponent radix 2 (default: %zu)]\n"
+	    "\t[-v increase verbosity (default: %zu)]\n"
+	    "\t[-h (print help)]\n"
+	    "\t[-T test the test, see if failure would be detected]\n"
+	    "",
+	    o->bto_min_shift,				/* -s */
+	    o->bto_max_shift,				/* -S */
+	    o->bto_v);					/* -v */
+
+	exit(requested ? 0 : 1);
+}
+
+static void
+process_options(int argc, char **argv)
+{
+	size_t value;
+	int opt;
+
+	blake3_test_opts_t *o = &bto_opts;
+
+	bcopy(&bto_opts_defaults, o, sizeof (*o));
+
+	while ((opt = getopt(argc, argv, "TBvhs:S:")) != -1) {
+		switch (opt) {
+		case 's':
+			value = strtoull(optarg, NULL, 0);
+			o->bto_min_shift = MIN(SPA_MAXBLOCKSHIFT,
+			    MAX(SPA_MINBLOCKSHIFT, value));
+			break;
+		case 'S':
+			value = strtoull(optarg, NULL, 0);
+			o->bto_max_shift = MIN(SPA_MAXBLOCKSHIFT,
+			    MAX(SPA_MINBLOCKSHIFT, value));
+			break;
+		case 'v':
+			o->bto_v++;
+			break;
+		case 'B':
+			o->bto_benchmark = 1;
+			break;
+		case 'T':
+			o->bto_sanity = 1;
+			break;
+		case 'h':
+			usage(B_TRUE);
+			break;
+		case '?':
+		default:
+			usage(B_FALSE);
+			break;
+		}
+	}
+
+	if (o->bto_min_shift > o->bto_max_shift)
+		usage(B_FALSE);
+}
+
+static void
+hex_encode(const uint8_t *digest, char *hex)
+{
+	int i;
+
+	for (i = 0; i < BLAKE3_OUT_LEN; i++)
+		(void) sprintf(hex + 2 * i, "%02x", digest[i]);
+}
+
+static int
+check_digest(const char *impl, const blake3_kat_t *kat, const char *how,
+    const uint8_t *digest, const char *expected)
+{
+	char hex[2 * BLAKE3_OUT_LEN + 1];
+
+	hex_encode(digest, hex);
+	if (bto_opts.bto_sanity)
+		hex[0] = hex[0] == '0' ? '1' : '0';
+
+	if (strcmp(hex, expected) != 0) {
+		ERRMSG("%s: %s of %zu bytes is wrong\n"
+		    "  expected %s\n  got      %s\n",
+		    impl, how, kat->bk_len, expected, hex);
+		return (1);
+	}
+	LOG(D_DEBUG, "%s: %s of %zu bytes ok\n", impl, how, kat->bk_len);
+	return (0);
+}
+
+static int
+run_kat_update(const char *impl, const blake3_kat_t *kat, boolean_t keyed,
+    size_t piece)
+{
+	BLAKE3_CTX ctx;
+	uint8_t digest[BLAKE3_OUT_LEN];
+	char how[64];
+	size_t off, len;
+
+	if (keyed)
+		Blake3_InitKeyed(&ctx, (const uint8_t *)kat_key);
+	else
+		Blake3_Init(&ctx);
+
+	if (piece == 0)
+		piece = MAX(kat->bk_len, 1);
+	for (off = 0; off < kat->bk_len; off += len) {
+		len = MIN(piece, kat->bk_len - off);
+		Blake3_Update(&ctx, kat_data + off, len);
+	}
+	Blake3_Final(&ctx, digest);
+
+	(void) snprintf(how, sizeof (how), "%s in %zu byte pieces",
+	    keyed ? "keyed hash" : "hash", piece);
+	return (check_digest(impl, kat, how, digest,
+	    keyed ? kat->bk_keyed_hash : kat->bk_hash));
+}
+
+/*
+ * Run the keyed vector through the zio checksum entry point, with the key
+ * as the salt, on a linear and on a scattered ABD.
+ */
+static int
+run_kat_abd(const char *impl, const blake3_kat_t *kat, void *tmpl)
+{
+	zio_cksum_t zc;
+	abd_t *abd;
+	int i, err = 0;
+
+	if (kat->bk_len == 0)
+		return (0);
+
+	for (i = 0; i < 2; i++) {
+		/* abd_alloc() only scatters buffers above a minimum size */
+		if (i == 0)
+			abd = abd_alloc_linear(kat->bk_len, B_FALSE);
+		else
+			abd = abd_alloc(kat->bk_len, B_FALSE);
+		abd_copy_from_buf(abd, kat_data, kat->bk_len);
+
+		abd_checksum_blake3_native(abd, kat->bk_len, tmpl, &zc);
+		err += check_digest(impl, kat,
+		    abd_is_linear(abd) ? "linear abd" : "scattered abd",
+		    (const uint8_t *)&zc, kat->bk_keyed_hash);
+		abd_free(abd);
+	}
+
+	return (err);
+}
+
+static int
+run_kat(const char *impl)
+{
+	zio_cksum_salt_t salt;
+	void *tmpl;
+	size_t i, j;
+	int err = 0;
+
+	bcopy(kat_key, salt.zcs_bytes, sizeof (salt.zcs_bytes));
+	tmpl = abd_checksum_blake3_tmpl_init(&salt);
+
+	for (i = 0; i < ARRAY_SIZE(blake3_kats); i++) {
+		const blake3_kat_t *kat = &blake3_kats[i];
+
+		for (j = 0; j < ARRAY_SIZE(update_sizes); j++) {
+			err += run_kat_update(impl, kat, B_FALSE,
+			    update_sizes[j]);
+			err += run_kat_update(impl, kat, B_TRUE,
+			    update_sizes[j]);
+		}
+		err += run_kat_abd(impl, kat, tmpl);
+	}
+
+	abd_checksum_blake3_tmpl_free(tmpl);
+	return (err);
+}
+
+static int
+run_test(void)
+{
+	char **impl_name;
+	int err = 0, tested = 0;
+
+	for (impl_name = (char **)blake3_impl_names; *impl_name != NULL;
+	    impl_name++) {
+		int impl_err;
+
+		if (blake3_impl_set(*impl_name) != 0) {
+			LOG(D_INFO, "%-8s not supported\n", *impl_name);
+			continue;
+		}
+
+		impl_err = run_kat(*impl_name);
+		LOG(D_ALL, "%-8s %s\n", *impl_name,
+		    impl_err == 0 ? "[PASS]" : "[FAIL]");
+		err += impl_err;
+		tested++;
+	}
+
+	/* Mixing implementations within one hash must not matter */
+	VERIFY0(blake3_impl_set("cycle"));
+	err += run_kat("cycle");
+	VERIFY0(blake3_impl_set("fastest"));
+
+	if (tested == 0) {
+		ERRMSG("No BLAKE3 implementation could be tested\n");
+		return (1);
+	}
+
+	if (bto_opts.bto_sanity) {
+		/* Every check should have failed */
+		if (err == 0) {
+			ERRMSG("Sanity test failed: no error detected\n");
+			return (1);
+		}
+		LOG(D_ALL, "Sanity test passed: %d errors detected\n", err);
+		return (0);
+	}
+
+	return (err != 0 ? 1 : 0);
+}
+
+int
+main(int argc, char **argv)
+{
+	size_t i;
+	int err = 0;
+
+	(void) setvbuf(stdout, NULL, _IOLBF, 0);
+
+	dprintf_setup(&argc, argv);
+
+	process_options(argc, argv);
+
+	kernel_init(FREAD);
+
+	kat_data_len = blake3_kats[ARRAY_SIZE(blake3_kats) - 1].bk_len;
+	kat_data = umem_alloc(kat_data_len, UMEM_NOFAIL);
+	for (i = 0; i < kat_data_len; i++)
+		kat_data[i] = i % 251;
+
+	if (bto_opts.bto_benchmark)
+		run_blake3_benchmark();
+	else
+		err = run_test();
+
+	umem_free(kat_data, kat_data_len);
+	kernel_fini();
+
+	return (err);
+}
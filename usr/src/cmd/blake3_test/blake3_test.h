@@ -0,0 +1,60 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef	BLAKE3_TEST_H
+#define	BLAKE3_TEST_H
+
+#include <sys/spa.h>
+
+static const char *blake3_impl_names[] = {
+	"generic",
+	"sse41",
+	"avx2",
+	"avx512",
+	NULL
+};
+
+typedef struct blake3_test_opts {
+	size_t bto_v;
+	size_t bto_benchmark;
+	size_t bto_sanity;
+	size_t bto_min_shift;
+	size_t bto_max_shift;
+} blake3_test_opts_t;
+
+static const blake3_test_opts_t bto_opts_defaults = {
+	.bto_v = 0,
+	.bto_benchmark = 0,
+	.bto_sanity = 0,
+	.bto_min_shift = 12,
+	.bto_max_shift = SPA_OLD_MAXBLOCKSHIFT + 3
+};
+
+extern blake3_test_opts_t bto_opts;
+
+#define	D_ALL	0
+#define	D_INFO	1
+#define	D_DEBUG	2
+
+#define	LOG(lvl, a...)				\
+{						\
+	if (bto_opts.bto_v >= lvl)		\
+		(void) fprintf(stdout, a);	\
+}						\
+
+#define	ERRMSG(a...)	(void) fprintf(stderr, a)
+
+#define	DBLSEP "================\n"
+#define	SEP    "----------------\n"
+
+void run_blake3_benchmark(void);
+
+#endif /* BLAKE3_TEST_H */
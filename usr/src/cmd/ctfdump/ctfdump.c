@@ -283,6 +283,19 @@ ctfdump_header(void)
 	    hp->cth_stroff);
 	ctfdump_printf(CTFDUMP_HEADER, "  cth_strlen   = %u\n",
 	    hp->cth_strlen);
+
+	if (hp->cth_version >= CTF_VERSION_3) {
+		const ctf_index_t *cip = (const ctf_index_t *)(hp + 1);
+
+		ctfdump_printf(CTFDUMP_HEADER, "  cti_len      = %u\n",
+		    cip->cti_len);
+		ctfdump_printf(CTFDUMP_HEADER, "  cti_flags    = 0x%02x\n",
+		    cip->cti_flags);
+		ctfdump_printf(CTFDUMP_HEADER, "  cti_stroff   = %u\n",
+		    cip->cti_stroff);
+		ctfdump_printf(CTFDUMP_HEADER, "  cti_strlen   = %u\n",
+		    cip->cti_strlen);
+	}
 }
 
 static int
@@ -66,7 +66,8 @@ static datafmt_t umemfmt[] = {
 	{ "    buf",	"  total",	"-------",	"%7u "		},
 	{ " memory",	" in use",	"-------",	"%7H "		},
 	{ "    alloc",	"  succeed",	"---------",	"%9u "		},
-	{ "alloc",	" fail",	"-----",	"%5llu"		},
+	{ "alloc",	" fail",	"-----",	"%5llu "	},
+	{ " remote",	"   free",	"-------",	"%7llu"		},
 	{ NULL,		NULL,		NULL,		NULL		}
 };
 
@@ -117,6 +118,7 @@ typedef struct umastat_vmem {
 	int kv_meminuse;
 	int kv_alloc;
 	int kv_fail;
+	uint64_t kv_remote;
 } umastat_vmem_t;
 
 /*ARGSUSED*/
@@ -217,6 +219,9 @@ umastat_cache(uintptr_t addr, const umem_cache_t *cp, umastat_vmem_t **kvp)
 	datafmt_t *dfp = umemfmt;
 	char buf[10];
 	int magsize;
+	umem_depot_t *dp;
+	uint_t i, ndepots;
+	uint64_t remote = 0;
 
 	int avail, alloc, total, nptc = 0;
 	size_t meminuse = (cp->cache_slab_create - cp->cache_slab_destroy) *
@@ -228,10 +233,18 @@ umastat_cache(uintptr_t addr, const umem_cache_t *cp, umastat_vmem_t **kvp)
 
 	magsize = umem_get_magsize(cp);
 
-	alloc = cp->cache_slab_alloc + cp->cache_full.ml_alloc;
-	avail = cp->cache_full.ml_total * magsize;
+	alloc = cp->cache_slab_alloc;
+	avail = 0;
 	total = cp->cache_buftotal;
 
+	dp = umem_read_depots(cp, &ndepots);
+	for (i = 0; i < ndepots; i++) {
+		alloc += dp[i].dp_full.ml_alloc;
+		avail += dp[i].dp_full.ml_total * magsize;
+		remote += dp[i].dp_remote_free;
+	}
+	mdb_free(dp, ndepots * sizeof (umem_depot_t));
+
 	(void) mdb_pwalk("umem_cpu_cache", cpu_alloc, &alloc, addr);
 	(void) mdb_pwalk("umem_cpu_cache", cpu_avail, &avail, addr);
 	(void) mdb_pwalk("umem_slab_partial", slab_avail, &avail, addr);
@@ -264,6 +277,7 @@ out:
 	kv->kv_meminuse += meminuse;
 	kv->kv_alloc += alloc;
 	kv->kv_fail += cp->cache_alloc_fail;
+	kv->kv_remote += remote;
 
 	mdb_printf((dfp++)->fmt, cp->cache_name);
 	mdb_printf((dfp++)->fmt, cp->cache_bufsize);
@@ -273,6 +287,7 @@ out:
 	mdb_printf((dfp++)->fmt, meminuse);
 	mdb_printf((dfp++)->fmt, alloc);
 	mdb_printf((dfp++)->fmt, cp->cache_alloc_fail);
+	mdb_printf((dfp++)->fmt, remote);
 	mdb_printf("\n");
 
 	return (WALK_NEXT);
@@ -287,9 +302,9 @@ umastat_vmem_totals(uintptr_t addr, const vmem_t *v, umastat_vmem_t *kv)
 	if (kv == NULL || kv->kv_alloc == 0)
 		return (WALK_NEXT);
 
-	mdb_printf("Total [%s]%*s %6s %7s %7s %7s %7H %9u %5u\n", v->vm_name,
-	    17 - strlen(v->vm_name), "", "", "", "", "",
-	    kv->kv_meminuse, kv->kv_alloc, kv->kv_fail);
+	mdb_printf("Total [%s]%*s %6s %7s %7s %7s %7H %9u %5u %7llu\n",
+	    v->vm_name, 17 - strlen(v->vm_name), "", "", "", "", "",
+	    kv->kv_meminuse, kv->kv_alloc, kv->kv_fail, kv->kv_remote);
 
 	return (WALK_NEXT);
 }
@@ -843,6 +843,31 @@ umem_get_magsize(const umem_cache_t *cp)
 	return (mt.mt_magsize);
 }
 
+/*
+ * Returns a copy of the depots of a cache, the process-wide depot first and
+ * then its lgroup depots, if any.  The caller must mdb_free() the array,
+ * which is *ndepots depots long.
+ */
+umem_depot_t *
+umem_read_depots(const umem_cache_t *cp, uint_t *ndepots)
+{
+	uint_t n = 1 + cp->cache_lgrp_ndepots;
+	umem_depot_t *dp;
+
+	dp = mdb_alloc(n * sizeof (umem_depot_t), UM_SLEEP);
+	dp[0] = cp->cache_depot;
+
+	if (n > 1 && mdb_vread(&dp[1], (n - 1) * sizeof (umem_depot_t),
+	    (uintptr_t)cp->cache_lgrp_depot) == -1) {
+		mdb_warn("unable to read lgroup depots of cache '%s' at %p",
+		    cp->cache_name, cp->cache_lgrp_depot);
+		n = 1;
+	}
+
+	*ndepots = n;
+	return (dp);
+}
+
 /*ARGSUSED*/
 static int
 umem_estimate_slab(uintptr_t addr, const umem_slab_t *sp, size_t *est)
@@ -868,7 +893,14 @@ umem_estimate_allocated(uintptr_t addr, const umem_cache_t *cp)
 	    (mdb_walk_cb_t)umem_estimate_slab, &cache_est, addr);
 
 	if ((magsize = umem_get_magsize(cp)) != 0) {
-		size_t mag_est = cp->cache_full.ml_total * magsize;
+		umem_depot_t *dp;
+		uint_t i, ndepots;
+		size_t mag_est = 0;
+
+		dp = umem_read_depots(cp, &ndepots);
+		for (i = 0; i < ndepots; i++)
+			mag_est += dp[i].dp_full.ml_total * magsize;
+		mdb_free(dp, ndepots * sizeof (umem_depot_t));
 
 		if (cache_est >= mag_est) {
 			cache_est -= mag_est;
@@ -904,6 +936,9 @@ umem_read_magazines(umem_cache_t *cp, uintptr_t addr,
 	int i, cpu;
 	size_t magsize, magmax, magbsize;
 	size_t magcnt = 0;
+	umem_depot_t *dp = NULL;
+	uint_t d, ndepots = 0;
+	long nfull = 0;
 
 	/*
 	 * Read the magtype out of the cache, after verifying the pointer's
@@ -920,16 +955,15 @@ umem_read_magazines(umem_cache_t *cp, uintptr_t addr,
 	/*
 	 * There are several places where we need to go buffer hunting:
 	 * the per-CPU loaded magazine, the per-CPU spare full magazine,
-	 * and the full magazine list in the depot.
+	 * and the full magazine lists in the depots.
 	 *
 	 * For an upper bound on the number of buffers in the magazine
-	 * layer, we have the number of magazines on the cache_full
-	 * list plus at most two magazines per CPU (the loaded and the
+	 * layer, we have the number of magazines on the full lists of the
+	 * depots plus at most two magazines per CPU (the loaded and the
 	 * spare).  Toss in 100 magazines as a fudge factor in case this
 	 * is live (the number "100" comes from the same fudge factor in
 	 * crash(1M)).
 	 */
-	magmax = (cp->cache_full.ml_total + 2 * umem_max_ncpus + 100) * magsize;
 	magbsize = offsetof(umem_magazine_t, mag_round[magsize]);
 
 	if (magbsize >= PAGESIZE / 2) {
@@ -938,23 +972,30 @@ umem_read_magazines(umem_cache_t *cp, uintptr_t addr,
 		return (-1);
 	}
 
+	dp = umem_read_depots(cp, &ndepots);
+	for (d = 0; d < ndepots; d++)
+		nfull += dp[d].dp_full.ml_total;
+	magmax = (nfull + 2 * umem_max_ncpus + 100) * magsize;
+
 	maglist = mdb_alloc(magmax * sizeof (void *), UM_SLEEP);
 	mp = mdb_alloc(magbsize, UM_SLEEP);
 	if (mp == NULL || maglist == NULL)
 		goto fail;
 
 	/*
-	 * First up: the magazines in the depot (i.e. on the cache_full list).
+	 * First up: the magazines in the depots (i.e. on their full lists).
 	 */
-	for (ump = cp->cache_full.ml_list; ump != NULL; ) {
-		READMAG_ROUNDS(magsize);
-		ump = mp->mag_next;
+	for (d = 0; d < ndepots; d++) {
+		for (ump = dp[d].dp_full.ml_list; ump != NULL; ) {
+			READMAG_ROUNDS(magsize);
+			ump = mp->mag_next;
 
-		if (ump == cp->cache_full.ml_list)
-			break; /* cache_full list loop detected */
+			if (ump == dp[d].dp_full.ml_list)
+				break; /* dp_full list loop detected */
+		}
 	}
 
-	dprintf(("cache_full list done\n"));
+	dprintf(("dp_full lists done\n"));
 
 	/*
 	 * Now whip through the CPUs, snagging the loaded magazines
@@ -983,6 +1024,7 @@ umem_read_magazines(umem_cache_t *cp, uintptr_t addr,
 	dprintf(("magazine layer: %d buffers\n", magcnt));
 
 	mdb_free(mp, magbsize);
+	mdb_free(dp, ndepots * sizeof (umem_depot_t));
 
 	*maglistp = maglist;
 	*magcntp = magcnt;
@@ -995,6 +1037,8 @@ fail:
 		mdb_free(mp, magbsize);
 	if (maglist)
 		mdb_free(maglist, magmax * sizeof (void *));
+	if (dp)
+		mdb_free(dp, ndepots * sizeof (umem_depot_t));
 
 	return (-1);
 }
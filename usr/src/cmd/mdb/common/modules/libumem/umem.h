@@ -131,6 +131,7 @@ extern void vmem_seg_help(void);
  */
 extern int umem_init(void);
 extern int umem_get_magsize(const umem_cache_t *);
+extern umem_depot_t *umem_read_depots(const umem_cache_t *, uint_t *);
 extern size_t umem_estimate_allocated(uintptr_t, const umem_cache_t *);
 
 #ifdef __cplusplus
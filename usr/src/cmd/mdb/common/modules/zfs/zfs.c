@@ -373,6 +373,7 @@ zfs_params(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 		"dbuf_cache_lowater_pct",
 		"dbuf_cache_max_bytes",
 		"dbuf_cache_max_shift",
+		"dbuf_hash_max_load",
 		"ddt_zap_indirect_blockshift",
 		"ddt_zap_leaf_blockshift",
 		"ditto_same_vdev_distance_shift",
@@ -420,11 +421,16 @@ zfs_params(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 		"spa_slop_shift",
 		"space_map_blksz",
 		"vdev_mirror_shift",
+		"zfetch_adaptive_distance",
 		"zfetch_max_distance",
+		"zfetch_max_stride",
+		"zfetch_min_distance",
 		"zfs_abd_chunk_size",
 		"zfs_abd_scatter_enabled",
 		"zfs_arc_average_blocksize",
 		"zfs_arc_evict_batch_limit",
+		"zfs_arc_evict_thread_bytes",
+		"zfs_arc_evict_threads",
 		"zfs_arc_grow_retry",
 		"zfs_arc_max",
 		"zfs_arc_meta_limit",
@@ -487,6 +493,7 @@ zfs_params(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 		"zfs_read_chunk_size",
 		"zfs_recover",
 		"zfs_recv_queue_length",
+		"zfs_recv_writer_threads",
 		"zfs_redundant_metadata_most_ditto_level",
 		"zfs_remap_blkptr_enable",
 		"zfs_remove_max_copy_bytes",
@@ -498,40 +505,56 @@ zfs_params(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 		"zfs_scrub_delay",
 		"zfs_scrub_limit",
 		"zfs_send_corrupt_data",
+		"zfs_send_prefetch_queue_length",
 		"zfs_send_queue_length",
 		"zfs_send_set_freerecords_bit",
+		"zfs_send_traverse_threads",
 		"zfs_sync_pass_deferred_free",
 		"zfs_sync_pass_dont_compress",
 		"zfs_sync_pass_rewrite",
 		"zfs_sync_taskq_batch_pct",
 		"zfs_top_maxinflight",
 		"zfs_txg_timeout",
+		"zfs_vdev_adaptive_interval_ms",
+		"zfs_vdev_adaptive_latency_pct",
+		"zfs_vdev_adaptive_max_active",
+		"zfs_vdev_adaptive_min_ios",
+		"zfs_vdev_adaptive_queue_depth",
 		"zfs_vdev_aggregation_limit",
 		"zfs_vdev_async_read_max_active",
 		"zfs_vdev_async_read_min_active",
+		"zfs_vdev_async_read_target_us",
 		"zfs_vdev_async_write_active_max_dirty_percent",
 		"zfs_vdev_async_write_active_min_dirty_percent",
 		"zfs_vdev_async_write_max_active",
 		"zfs_vdev_async_write_min_active",
+		"zfs_vdev_async_write_target_us",
 		"zfs_vdev_cache_bshift",
 		"zfs_vdev_cache_max",
 		"zfs_vdev_cache_size",
+		"zfs_vdev_initializing_target_us",
 		"zfs_vdev_max_active",
 		"zfs_vdev_queue_depth_pct",
 		"zfs_vdev_read_gap_limit",
 		"zfs_vdev_removal_max_active",
 		"zfs_vdev_removal_min_active",
+		"zfs_vdev_removal_target_us",
 		"zfs_vdev_scrub_max_active",
 		"zfs_vdev_scrub_min_active",
+		"zfs_vdev_scrub_target_us",
 		"zfs_vdev_sync_read_max_active",
 		"zfs_vdev_sync_read_min_active",
+		"zfs_vdev_sync_read_target_us",
 		"zfs_vdev_sync_write_max_active",
 		"zfs_vdev_sync_write_min_active",
+		"zfs_vdev_sync_write_target_us",
+		"zfs_vdev_trim_target_us",
 		"zfs_vdev_write_gap_limit",
 		"zfs_write_implies_delete_child",
 		"zfs_zil_clean_taskq_maxalloc",
 		"zfs_zil_clean_taskq_minalloc",
 		"zfs_zil_clean_taskq_nthr_pct",
+		"zil_itx_sublists",
 		"zil_replay_disable",
 		"zil_slog_bulk",
 		"zio_buf_debug_limit",
@@ -696,6 +719,8 @@ dbuf_stats(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 	uintptr_t dbp;
 	dmu_buf_impl_t db;
 	dbuf_hash_table_t ht;
+	dbuf_hash_buckets_t dhb;
+	uintptr_t table;
 	uint64_t bucket, ndbufs;
 	uint64_t histo[HISTOSZ];
 	uint64_t histo2[HISTOSZ];
@@ -705,6 +730,14 @@ dbuf_stats(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 		mdb_warn("failed to read 'dbuf_hash_table'");
 		return (DCMD_ERR);
 	}
+	if (mdb_vread(&dhb, sizeof (dhb), (uintptr_t)ht.hash_buckets) == -1) {
+		mdb_warn("failed to read hash buckets at %p", ht.hash_buckets);
+		return (DCMD_ERR);
+	}
+	if (ht.hash_new_buckets != NULL)
+		mdb_warn("hash table is being resized; counts are partial\n");
+	table = (uintptr_t)ht.hash_buckets +
+	    offsetof(dbuf_hash_buckets_t, dhb_table);
 
 	for (i = 0; i < HISTOSZ; i++) {
 		histo[i] = 0;
@@ -712,13 +745,13 @@ dbuf_stats(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 	}
 
 	ndbufs = 0;
-	for (bucket = 0; bucket < ht.hash_table_mask+1; bucket++) {
+	for (bucket = 0; bucket < dhb.dhb_mask+1; bucket++) {
 		int len;
 
 		if (mdb_vread(&dbp, sizeof (void *),
-		    (uintptr_t)(ht.hash_table+bucket)) == -1) {
+		    table + bucket * sizeof (void *)) == -1) {
 			mdb_warn("failed to read hash bucket %u at %p",
-			    bucket, ht.hash_table+bucket);
+			    bucket, table + bucket * sizeof (void *));
 			return (DCMD_ERR);
 		}
 
@@ -743,8 +776,8 @@ dbuf_stats(uintptr_t addr, uint_t flags, int argc, const mdb_arg_t *argv)
 
 	mdb_printf("hash table has %llu buckets, %llu dbufs "
 	    "(avg %llu buckets/dbuf)\n",
-	    ht.hash_table_mask+1, ndbufs,
-	    (ht.hash_table_mask+1)/ndbufs);
+	    dhb.dhb_mask+1, ndbufs,
+	    (dhb.dhb_mask+1)/ndbufs);
 
 	mdb_printf("\n");
 	maxidx = 0;
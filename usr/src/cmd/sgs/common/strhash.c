@@ -43,3 +43,21 @@ sgs_str_hash(const char *str)
 		hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
 	return (hash);
 }
+
+/*
+ * The hash function of the GNU hash table (.gnu.hash, DT_GNU_HASH).  This
+ * is the same Bernstein function, but computed over unsigned characters as
+ * the format requires, so the value is the same whatever the signedness of
+ * char on the host that built the table.
+ */
+uint_t
+sgs_gnu_hash(const char *str)
+{
+	const uchar_t	*ustr = (const uchar_t *)str;
+	uint_t		hash = 5381;
+	uint_t		c;
+
+	while ((c = *ustr++) != 0)
+		hash = ((hash << 5) + hash) + c;
+	return (hash);
+}
@@ -296,7 +296,11 @@ struct ofl_desc {
 	APlist		*ofl_ostlsseg;	/* pointer to sections in TLS segment */
 	APlist		*ofl_unwind;	/* list of unwind output sections */
 	Os_desc		*ofl_unwindhdr;	/* Unwind hdr */
-	avl_tree_t	ofl_symavl;	/* pointer to head of Syms AVL tree */
+	Sym_hent	*ofl_symhtab;	/* global symbol hash table */
+	Word		ofl_symhtabsz;	/*	no. of table slots */
+	Sym_hent	*ofl_symlist;	/* global symbols, see ld_sym_sort() */
+	Word		ofl_symlistsz;	/*	size of the list */
+	Word		ofl_symsorted;	/*	no. of symbols sorted */
 	Sym_desc	**ofl_regsyms;	/* array of potential register */
 	Word		ofl_regsymsno;	/*    symbols and array count */
 	Word		ofl_regsymcnt;	/* no. of output register symbols */
@@ -353,6 +357,8 @@ struct ofl_desc {
 	Word		ofl_pltcnt;	/* no. of .plt entries */
 	Word		ofl_pltpad;	/* no. of .plt padd entries */
 	Word		ofl_hashbkts;	/* no. of hash buckets required */
+	Word		ofl_gnubloom;	/* no. of .gnu.hash bloom words */
+	Word		ofl_gnushift;	/* .gnu.hash bloom filter shift */
 	Is_desc		*ofl_isbss;	/* .bss input section (globals) */
 	Is_desc		*ofl_islbss;	/* .lbss input section (globals) */
 	Is_desc		*ofl_istlsbss;	/* .tlsbss input section (globals) */
@@ -365,6 +371,7 @@ struct ofl_desc {
 	Os_desc		*ofl_osdyntlssort; /* .SUNW_dyntlssort output section */
 	Os_desc		*ofl_osgot;	/* .got output section */
 	Os_desc		*ofl_oshash;	/* .hash output section */
+	Os_desc		*ofl_osgnuhash;	/* .gnu.hash output section */
 	Os_desc		*ofl_osinitarray; /* .init_array output section */
 	Os_desc		*ofl_osfiniarray; /* .fini_array output section */
 	Os_desc		*ofl_ospreinitarray; /* .preinit_array output section */
@@ -407,6 +414,9 @@ struct ofl_desc {
 	ofl_guideflag_t	ofl_guideflags;	/* -z guide flags */
 	APlist		*ofl_assdeflib;	/* -z assert-deflib exceptions */
 	int		ofl_aslr;	/* -z aslr, -1 disable, 1 enable */
+	int		ofl_threads;	/* -z threads, maximum no. of threads */
+	Word		*ofl_symhash;	/* global symbol name hash values */
+	Word		ofl_symhashcnt;	/*	and the size of that buffer */
 	APlist		*ofl_symasserts; /* assertions about symbols */
 					/* from mapfiles */
 };
@@ -524,6 +534,7 @@ struct ofl_desc {
 #define	FLG_OF1_OVMACHCAP 0x0800000000	/* override CA_SUNW_MACH capability */
 #define	FLG_OF1_OVPLATCAP 0x1000000000	/* override CA_SUNW_PLAT capability */
 #define	FLG_OF1_OVIDCAP	0x2000000000	/* override CA_SUNW_ID capability */
+#define	FLG_OF1_NGNUHSH	0x4000000000	/* -z nognuhash set */
 
 /*
  * Guidance flags. The flags with the FLG_OFG_NO_ prefix are used to suppress
@@ -567,6 +578,14 @@ struct ofl_desc {
 #define	OFL_ALLOW_LDYNSYM(_ofl) (((_ofl)->ofl_flags & \
 	(FLG_OF_DYNAMIC | FLG_OF_RELOBJ | FLG_OF_NOLDYNSYM)) == FLG_OF_DYNAMIC)
 
+/*
+ * Test to see if the output file should contain a .gnu.hash section, in
+ * addition to the .hash section that accompanies every .dynsym.  The GNU
+ * hash table is generated unless -znognuhash has been specified.
+ */
+#define	OFL_ALLOW_GNUHASH(_ofl) (OFL_ALLOW_DYNSYM(_ofl) && \
+	(((_ofl)->ofl_flags1 & FLG_OF1_NGNUHSH) == 0))
+
 /*
  * Test to see if relocation processing should be done. This is normally
  * true, but can be disabled via the '-z noreloc' option. Note that
@@ -1213,7 +1232,19 @@ struct sym_aux {
 };
 
 /*
- * Nodes used to track symbols in the global AVL symbol dictionary.
+ * Entries of the global symbol hash table, and of the global symbol list.
+ * A NULL she_sdp denotes an unused hash table entry.  The hash value and
+ * name are those the symbol was entered with, so that probing the table
+ * seldom has to reference the symbol descriptor itself.
+ */
+struct sym_hent {
+	Word		she_hash;	/* symbol hash value */
+	const char	*she_name;	/* symbol name */
+	Sym_desc	*she_sdp;	/* symbol descriptor */
+};
+
+/*
+ * Nodes used to track symbols in AVL symbol dictionaries.
  */
 struct sym_avlnode {
 	avl_node_t	sav_node;	/* AVL node */
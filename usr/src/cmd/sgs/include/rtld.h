@@ -1064,6 +1064,8 @@ struct slookup {
 	Rt_map		*sl_imap;	/* initial link-map to search */
 	ulong_t		sl_id;		/* identifier for this lookup */
 	ulong_t		sl_hash;	/* symbol hash value */
+	uint_t		sl_gnuhash;	/* symbol GNU hash value, computed */
+					/*    on first use */
 	ulong_t		sl_rsymndx;	/* referencing reloc symndx */
 	Sym		*sl_rsym;	/* referencing symbol */
 	uchar_t		sl_rtype;	/* relocation type associate with */
@@ -1075,9 +1077,9 @@ struct slookup {
 #define	SLOOKUP_INIT(sl, name, cmap, imap, id, hash, rsymndx, rsym, rtype, \
     flags) \
 	(void) (sl.sl_name = (name), sl.sl_cmap = (cmap), sl.sl_imap = (imap), \
-	    sl.sl_id = (id), sl.sl_hash = (hash), sl.sl_rsymndx = (rsymndx), \
-	    sl.sl_rsym = (rsym), sl.sl_rtype = (rtype), sl.sl_bind = 0, \
-	    sl.sl_flags = (flags))
+	    sl.sl_id = (id), sl.sl_hash = (hash), sl.sl_gnuhash = 0, \
+	    sl.sl_rsymndx = (rsymndx), sl.sl_rsym = (rsym), \
+	    sl.sl_rtype = (rtype), sl.sl_bind = 0, sl.sl_flags = (flags))
 
 /*
  * After a symbol lookup has been resolved, the runtime linker needs to retain
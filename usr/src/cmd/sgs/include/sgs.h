@@ -245,6 +245,7 @@ typedef struct sort_desc	Sort_desc;
 typedef	struct sym_avlnode	Sym_avlnode;
 typedef struct sym_aux		Sym_aux;
 typedef struct sym_desc		Sym_desc;
+typedef struct sym_hent		Sym_hent;
 typedef	struct uts_desc		Uts_desc;
 typedef struct ver_desc		Ver_desc;
 typedef struct ver_index	Ver_index;
@@ -264,6 +265,7 @@ extern int	assfail(const char *, const char *, int);
 extern void	eprintf(Lm_list *, Error, const char *, ...);
 extern void	veprintf(Lm_list *, Error, const char *, va_list);
 extern uint_t	sgs_str_hash(const char *);
+extern uint_t	sgs_gnu_hash(const char *);
 extern uint_t	findprime(uint_t);
 
 #endif /* _ASM */
@@ -98,6 +98,13 @@ veprintf(Lm_list *lml, Error error, const char *format, va_list args)
 	 */
 	lml = 0;
 #endif
+	/*
+	 * A diagnostic is written with several stdio calls.  Hold the stream
+	 * lock across them, so that a diagnostic issued from one of libld's
+	 * parallel passes (-z threads) isn't interleaved with another.
+	 */
+	flockfile(stderr);
+
 	/*
 	 * For error types we issue a prefix for, make sure the necessary
 	 * string has been internationalized and is ready.
@@ -140,6 +147,7 @@ veprintf(Lm_list *lml, Error error, const char *format, va_list args)
 	}
 	(void) fprintf(stderr, MSG_ORIG(MSG_STR_NL));
 	(void) fflush(stderr);
+	funlockfile(stderr);
 }
 
 
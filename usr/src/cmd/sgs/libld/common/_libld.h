@@ -295,10 +295,20 @@ typedef struct reloc_list {
 
 
 typedef struct sym_s_list {
-	Word		sl_hval;
+	Word		sl_hval;	/* hash bucket */
+	Word		sl_gnuhval;	/* GNU hash value (.gnu.hash only) */
 	Sym_desc	*sl_sdp;
 } Sym_s_list;
 
+/*
+ * The .gnu.hash bloom filter is a power of two number of address sized
+ * words.  ld(1) sizes it to provide at least GNUHASH_BLOOMSYM bits for each
+ * symbol, which keeps the false positive rate of the two bit test used by
+ * ld.so.1 to a few percent.
+ */
+#define	GNUHASH_BLOOMBITS	(sizeof (Addr) * 8)
+#define	GNUHASH_BLOOMSYM	12
+
 /*
  * ld heap management structure
  */
@@ -312,6 +322,17 @@ struct _ld_heap {
 #define	HEAPBLOCK	0x800000	/* default allocation block size */
 #define	HEAPALIGN	0x8		/* heap blocks alignment requirement */
 
+/*
+ * Parallel link-editor passes (-z threads=n), see ld_par_run().  Debugging
+ * output must reflect the order in which the link-edit is processed, and
+ * symbol demangling uses a static buffer, so either forces the passes to
+ * be single threaded.
+ */
+#define	LD_PAR_MAXTHREADS	64
+
+#define	OFL_PARALLEL(_ofl)	(((_ofl)->ofl_threads > 1) && \
+	!DBG_ENABLED && (demangle_flag == 0))
+
 /*
  * Dynamic per-symbol filtee string table descriptor.  This associates filtee
  * strings that will be created in the .dynstr, with .dynamic entries.
@@ -673,6 +694,11 @@ extern void		*libld_realloc(void *, size_t);
 
 extern int		isdavl_compare(const void *, const void *);
 
+extern void		ld_par_lock(void);
+extern uintptr_t	ld_par_run(int, size_t, uintptr_t (*)(void *, size_t),
+			    void *);
+extern void		ld_par_unlock(void);
+
 extern Sdf_desc		*sdf_add(const char *, APlist **);
 extern Sdf_desc		*sdf_find(const char *, APlist *);
 
@@ -723,6 +749,7 @@ extern Sdf_desc		*sdf_find(const char *, APlist *);
 #define	ld_process_open		ld64_process_open
 #define	ld_process_ordered	ld64_process_ordered
 #define	ld_process_sym_reloc	ld64_process_sym_reloc
+#define	ld_reloc_activerelocs	ld64_reloc_activerelocs
 #define	ld_reloc_enter		ld64_reloc_enter
 #define	ld_reloc_GOT_relative	ld64_reloc_GOT_relative
 #define	ld_reloc_plt		ld64_reloc_plt
@@ -756,6 +783,8 @@ extern Sdf_desc		*sdf_find(const char *, APlist *);
 #define	ld_sym_process		ld64_sym_process
 #define	ld_sym_resolve		ld64_sym_resolve
 #define	ld_sym_reducable	ld64_sym_reducable
+#define	ld_sym_reserve		ld64_sym_reserve
+#define	ld_sym_sort		ld64_sym_sort
 #define	ld_sym_spec		ld64_sym_spec
 #define	ld_targ			ld64_targ
 #define	ld_targ_init_sparc	ld64_targ_init_sparc
@@ -822,6 +851,7 @@ extern Sdf_desc		*sdf_find(const char *, APlist *);
 #define	ld_process_open		ld32_process_open
 #define	ld_process_ordered	ld32_process_ordered
 #define	ld_process_sym_reloc	ld32_process_sym_reloc
+#define	ld_reloc_activerelocs	ld32_reloc_activerelocs
 #define	ld_reloc_enter		ld32_reloc_enter
 #define	ld_reloc_GOT_relative	ld32_reloc_GOT_relative
 #define	ld_reloc_plt		ld32_reloc_plt
@@ -855,6 +885,8 @@ extern Sdf_desc		*sdf_find(const char *, APlist *);
 #define	ld_sym_process		ld32_sym_process
 #define	ld_sym_resolve		ld32_sym_resolve
 #define	ld_sym_reducable	ld32_sym_reducable
+#define	ld_sym_reserve		ld32_sym_reserve
+#define	ld_sym_sort		ld32_sym_sort
 #define	ld_sym_spec		ld32_sym_spec
 #define	ld_targ			ld32_targ
 #define	ld_targ_init_sparc	ld32_targ_init_sparc
@@ -952,6 +984,8 @@ extern uintptr_t	ld_process_ordered(Ofl_desc *, Ifl_desc *,
 extern uintptr_t	ld_process_sym_reloc(Ofl_desc *, Rel_desc *, Rel *,
 			    Is_desc *, const char *, Word);
 
+extern uintptr_t	ld_reloc_activerelocs(Ofl_desc *,
+			    uintptr_t (*)(Ofl_desc *, Rel_desc *));
 extern Rel_desc		*ld_reloc_enter(Ofl_desc *, Rel_cache *, Rel_desc *,
 			    Word);
 extern uintptr_t	ld_reloc_GOT_relative(Boolean, Rel_desc *, Ofl_desc *);
@@ -1001,6 +1035,8 @@ extern uintptr_t	ld_sym_process(Is_desc *, Ifl_desc *, Ofl_desc *);
 extern uintptr_t	ld_sym_resolve(Sym_desc *, Sym *, Ifl_desc *,
 			    Ofl_desc *, int, Word, sd_flag_t);
 extern Boolean		ld_sym_reducable(Ofl_desc *, Sym_desc *);
+extern uintptr_t	ld_sym_reserve(Ofl_desc *, Word);
+extern void		ld_sym_sort(Ofl_desc *);
 extern uintptr_t	ld_sym_spec(Ofl_desc *);
 
 extern Target		ld_targ;
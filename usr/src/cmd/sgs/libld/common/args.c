@@ -78,6 +78,7 @@
 #include	<fcntl.h>
 #include	<string.h>
 #include	<errno.h>
+#include	<stdlib.h>
 #include	<elf.h>
 #include	<unistd.h>
 #include	<debug.h>
@@ -201,6 +202,7 @@ usage_mesg(Boolean detail)
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZE));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZFATW));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZFA));
+	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZGH));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZGP));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZGUIDE));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZH));
@@ -233,6 +235,7 @@ usage_mesg(Boolean detail)
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZSCAP));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZTARG));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZT));
+	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZTHR));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZTO));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZTW));
 	(void) fprintf(stderr, MSG_INTL(MSG_ARG_DETAIL_ZTY));
@@ -1430,6 +1433,12 @@ parseopt_pass1(Ofl_desc *ofl, int argc, char **argv, int *usage)
 			} else if (strcmp(optarg,
 			    MSG_ORIG(MSG_ARG_NOLDYNSYM)) == 0) {
 				ofl->ofl_flags |= FLG_OF_NOLDYNSYM;
+			} else if (strcmp(optarg,
+			    MSG_ORIG(MSG_ARG_GNUHASH)) == 0) {
+				ofl->ofl_flags1 &= ~FLG_OF1_NGNUHSH;
+			} else if (strcmp(optarg,
+			    MSG_ORIG(MSG_ARG_NOGNUHASH)) == 0) {
+				ofl->ofl_flags1 |= FLG_OF1_NGNUHSH;
 			} else if (strcmp(optarg,
 			    MSG_ORIG(MSG_ARG_GLOBAUDIT)) == 0) {
 				ofl->ofl_dtflags_1 |= DF_1_GLOBAUDIT;
@@ -1510,6 +1519,23 @@ parseopt_pass1(Ofl_desc *ofl, int argc, char **argv, int *usage)
 					    MSG_ORIG(MSG_ARG_Z), optarg);
 					return (S_ERROR);
 				}
+			} else if (strncmp(optarg, MSG_ORIG(MSG_ARG_THREADS),
+			    MSG_ARG_THREADS_SIZE) == 0) {
+				char	*p = optarg + MSG_ARG_THREADS_SIZE;
+				char	*end;
+				long	cnt;
+
+				errno = 0;
+				cnt = strtol(p, &end, 10);
+				if ((*p == '\0') || (*end != '\0') ||
+				    (errno != 0) || (cnt < 1) ||
+				    (cnt > LD_PAR_MAXTHREADS)) {
+					ld_eprintf(ofl, ERR_FATAL,
+					    MSG_INTL(MSG_ARG_ILLEGAL),
+					    MSG_ORIG(MSG_ARG_ZTHREADS), p);
+					return (S_ERROR);
+				}
+				ofl->ofl_threads = (int)cnt;
 			} else if ((strncmp(optarg, MSG_ORIG(MSG_ARG_GUIDE),
 			    MSG_ARG_GUIDE_SIZE) == 0) &&
 			    ((optarg[MSG_ARG_GUIDE_SIZE] == '=') ||
@@ -366,12 +366,6 @@ ld_ent_setup(Ofl_desc *ofl, Xword segalign)
 		return (S_ERROR);
 	}
 
-	/*
-	 * Initialize internal Global Symbol Table AVL tree
-	 */
-	avl_create(&ofl->ofl_symavl, &ld_sym_avl_comp, sizeof (Sym_avlnode),
-	    SGSOFFSETOF(Sym_avlnode, sav_node));
-
 	/* Initialize segment AVL tree */
 	avl_create(&ofl->ofl_segs_avl, ofl_segs_avl_cmp,
 	    sizeof (Sg_desc), SGSOFFSETOF(Sg_desc, sg_avlnode));
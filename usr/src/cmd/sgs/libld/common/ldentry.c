@@ -59,7 +59,7 @@ ld_map_out(Ofl_desc *ofl)
 {
 	Sg_desc		*sgp;
 	Is_desc		*isp;
-	Sym_avlnode	*sav;
+	Word		sndx;
 	Aliste		idx1;
 
 	(void) printf(MSG_INTL(MSG_ENT_MAP_FMT_TIL_1),
@@ -141,9 +141,9 @@ ld_map_out(Ofl_desc *ofl)
 	 * Check for any multiply referenced symbols (ie. symbols that have
 	 * been overridden from a shared library).
 	 */
-	for (sav = avl_first(&ofl->ofl_symavl); sav;
-	    sav = AVL_NEXT(&ofl->ofl_symavl, sav)) {
-		Sym_desc	*sdp = sav->sav_sdp;
+	ld_sym_sort(ofl);
+	for (sndx = 0; sndx < ofl->ofl_entercnt; sndx++) {
+		Sym_desc	*sdp = ofl->ofl_symlist[sndx].she_sdp;
 		const char	*name = sdp->sd_name, *ducp, *adcp;
 		APlist		*dfiles;
 		Aliste		idx;
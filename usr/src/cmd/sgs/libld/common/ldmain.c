@@ -38,6 +38,7 @@
 #include	<sys/types.h>
 #include	<sys/time.h>
 #include	<sys/mman.h>
+#include	<sys/sysmacros.h>
 #include	<string.h>
 #include	<stdio.h>
 #include	<locale.h>
@@ -82,6 +83,8 @@ ld_eprintf(Ofl_desc *ofl, Error error, const char *format, ...)
 {
 	va_list	args;
 
+	ld_par_lock();
+
 	/* Set flag indicating type of error being issued */
 	switch (error) {
 	case ERR_NONE:
@@ -102,6 +105,8 @@ ld_eprintf(Ofl_desc *ofl, Error error, const char *format, ...)
 	va_start(args, format);
 	veprintf(ofl->ofl_lml, error, format, args);
 	va_end(args);
+
+	ld_par_unlock();
 }
 
 /*
@@ -137,6 +142,111 @@ ld_init_target(Lm_list *lml, Half mach)
 }
 
 
+/*
+ * The DT_CHECKSUM of a large output file can be computed across the -z threads
+ * worker threads.  The checksum is the elf_checksum(3ELF) sum of the bytes of
+ * the allocatable sections, which is independent of the order in which the
+ * bytes are summed, so the data buffers are split into chunks that are summed
+ * in parallel, and the partial sums are then combined and folded exactly as
+ * elf_checksum() does.
+ */
+#define	CKSUM_CHUNK	(1024 * 1024)
+
+typedef struct {
+	uchar_t		*ck_buf;	/* data to sum */
+	size_t		ck_size;	/*	and its size */
+	ulong_t		ck_sum;		/* partial sum */
+} Cksum_chunk;
+
+static uintptr_t
+checksum_work(void *arg, size_t ndx)
+{
+	Cksum_chunk	*ckp = (Cksum_chunk *)arg + ndx;
+	uchar_t		*cp = ckp->ck_buf;
+	size_t		cnt = ckp->ck_size;
+	ulong_t		sum = 0;
+
+	while (cnt--)
+		sum += *cp++;
+	ckp->ck_sum = sum;
+	return (1);
+}
+
+/*
+ * Visit the buffers that elf_checksum() would sum, either counting the chunks
+ * they divide into, or filling in the chunk array.  Returns the number of
+ * chunks, or -1 if the image can't be inspected.
+ */
+static ssize_t
+checksum_chunks(Elf *elf, Cksum_chunk *chunks)
+{
+	Elf_Scn		*scn = NULL;
+	ssize_t		cnt = 0;
+
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		Shdr		*shdr;
+		Elf_Data	*data = NULL;
+
+		if ((shdr = elf_getshdr(scn)) == NULL)
+			return (-1);
+
+		if (((shdr->sh_flags & SHF_ALLOC) == 0) ||
+		    (shdr->sh_type == SHT_DYNSYM) ||
+		    (shdr->sh_type == SHT_DYNAMIC) ||
+		    (shdr->sh_type == SHT_SUNW_dof))
+			continue;
+
+		while ((data = elf_getdata(scn, data)) != NULL) {
+			uchar_t	*buf = data->d_buf;
+			size_t	size = data->d_size;
+
+			if (buf == NULL)
+				continue;
+
+			while (size > 0) {
+				size_t	csize = MIN(size, CKSUM_CHUNK);
+
+				if (chunks != NULL) {
+					chunks[cnt].ck_buf = buf;
+					chunks[cnt].ck_size = csize;
+				}
+				buf += csize;
+				size -= csize;
+				cnt++;
+			}
+		}
+	}
+	return (cnt);
+}
+
+static Xword
+ld_checksum(Ofl_desc *ofl)
+{
+	Cksum_chunk	*chunks;
+	ssize_t		cnt, ndx;
+	ulong_t		sum = 0;
+	long		lsum;
+
+	if (!OFL_PARALLEL(ofl) ||
+	    ((cnt = checksum_chunks(ofl->ofl_elf, NULL)) < 2) ||
+	    ((chunks = libld_malloc(cnt * sizeof (Cksum_chunk))) == NULL))
+		return ((Xword)elf_checksum(ofl->ofl_elf));
+
+	(void) checksum_chunks(ofl->ofl_elf, chunks);
+	if (ld_par_run(ofl->ofl_threads, cnt, checksum_work, chunks) != 1)
+		return ((Xword)elf_checksum(ofl->ofl_elf));
+
+	for (ndx = 0; ndx < cnt; ndx++)
+		sum += chunks[ndx].ck_sum;
+
+	/*
+	 * Fold the sum as elf_checksum() does.
+	 */
+	lsum = (long)sum;
+	lsum = (lsum & 0xffff) + ((lsum >> 16) & 0xffff);
+	return ((Xword)(ushort_t)((lsum & 0xffff) + ((lsum >> 16) & 0xffff)));
+}
+
 /*
  * The main program
  */
@@ -448,7 +558,7 @@ ld_main(int argc, char **argv, Half mach)
 	 * Finally create the files elf checksum.
 	 */
 	if (ofl->ofl_checksum)
-		*ofl->ofl_checksum = (Xword)elf_checksum(ofl->ofl_elf);
+		*ofl->ofl_checksum = ld_checksum(ofl);
 
 	/*
 	 * If this is a cross link to a target with a different byte
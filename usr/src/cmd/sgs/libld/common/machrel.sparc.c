@@ -1063,355 +1063,352 @@ gotop_fixups(Ofl_desc *ofl, Rel_desc *arsp)
 	return (FIX_ERROR);
 }
 
+/*
+ * Apply a single active relocation.  Returns 1 on success, 0 if the
+ * relocation failed but the remaining relocations should still be
+ * processed, or S_ERROR if relocation processing should stop.
+ */
 static uintptr_t
-ld_do_activerelocs(Ofl_desc *ofl)
+do_activereloc(Ofl_desc *ofl, Rel_desc *arsp)
 {
-	Rel_desc	*arsp;
-	Rel_cachebuf	*rcbp;
-	Aliste		idx;
-	uintptr_t	return_code = 1;
+	uchar_t		*addr;
+	Xword		value;
+	Sym_desc	*sdp;
+	const char	*ifl_name;
+	Xword		refaddr;
+	Os_desc		*osp;
 	ofl_flag_t	flags = ofl->ofl_flags;
 
-	if (aplist_nitems(ofl->ofl_actrels.rc_list) != 0)
-		DBG_CALL(Dbg_reloc_doact_title(ofl->ofl_lml));
+	/*
+	 * If the section this relocation is against has been discarded
+	 * (-zignore), then discard (skip) the relocation itself.
+	 */
+	if ((arsp->rel_isdesc->is_flags & FLG_IS_DISCARD) &&
+	    ((arsp->rel_flags & (FLG_REL_GOT | FLG_REL_BSS |
+	    FLG_REL_PLT | FLG_REL_NOINFO)) == 0)) {
+		DBG_CALL(Dbg_reloc_discard(ofl->ofl_lml, M_MACH, arsp));
+		return (1);
+	}
 
 	/*
-	 * Process active relocations.
+	 * Perform any required TLS fixups.
 	 */
-	REL_CACHE_TRAVERSE(&ofl->ofl_actrels, idx, rcbp, arsp) {
-		uchar_t		*addr;
-		Xword		value;
-		Sym_desc	*sdp;
-		const char	*ifl_name;
-		Xword		refaddr;
-		Os_desc		*osp;
+	if (arsp->rel_flags & FLG_REL_TLSFIX) {
+		Fixupret	ret;
 
-		/*
-		 * If the section this relocation is against has been discarded
-		 * (-zignore), then discard (skip) the relocation itself.
-		 */
-		if ((arsp->rel_isdesc->is_flags & FLG_IS_DISCARD) &&
-		    ((arsp->rel_flags & (FLG_REL_GOT | FLG_REL_BSS |
-		    FLG_REL_PLT | FLG_REL_NOINFO)) == 0)) {
-			DBG_CALL(Dbg_reloc_discard(ofl->ofl_lml, M_MACH, arsp));
-			continue;
-		}
+		if ((ret = tls_fixups(ofl, arsp)) == FIX_ERROR)
+			return (S_ERROR);
+		if (ret == FIX_DONE)
+			return (1);
+	}
 
-		/*
-		 * Perform any required TLS fixups.
-		 */
-		if (arsp->rel_flags & FLG_REL_TLSFIX) {
-			Fixupret	ret;
+	/*
+	 * Perform any required GOTOP fixups.
+	 */
+	if (arsp->rel_flags & FLG_REL_GOTFIX) {
+		Fixupret	ret;
 
-			if ((ret = tls_fixups(ofl, arsp)) == FIX_ERROR)
-				return (S_ERROR);
-			if (ret == FIX_DONE)
-				continue;
-		}
+		if ((ret = gotop_fixups(ofl, arsp)) == FIX_ERROR)
+			return (S_ERROR);
+		if (ret == FIX_DONE)
+			return (1);
+	}
 
-		/*
-		 * Perform any required GOTOP fixups.
-		 */
-		if (arsp->rel_flags & FLG_REL_GOTFIX) {
-			Fixupret	ret;
+	/*
+	 * If this is a relocation against the move table, or
+	 * expanded move table, adjust the relocation entries.
+	 */
+	if (RELAUX_GET_MOVE(arsp))
+		ld_adj_movereloc(ofl, arsp);
 
-			if ((ret = gotop_fixups(ofl, arsp)) == FIX_ERROR)
-				return (S_ERROR);
-			if (ret == FIX_DONE)
-				continue;
-		}
+	sdp = arsp->rel_sym;
+	refaddr = arsp->rel_roffset +
+	    (Off)_elf_getxoff(arsp->rel_isdesc->is_indata);
+
+	if ((arsp->rel_flags & FLG_REL_CLVAL) ||
+	    (arsp->rel_flags & FLG_REL_GOTCL))
+		value = 0;
+	else if (ELF_ST_TYPE(sdp->sd_sym->st_info) == STT_SECTION) {
+		Sym_desc	*sym;
 
 		/*
-		 * If this is a relocation against the move table, or
-		 * expanded move table, adjust the relocation entries.
+		 * The value for a symbol pointing to a SECTION
+		 * is based off of that sections position.
 		 */
-		if (RELAUX_GET_MOVE(arsp))
-			ld_adj_movereloc(ofl, arsp);
-
-		sdp = arsp->rel_sym;
-		refaddr = arsp->rel_roffset +
-		    (Off)_elf_getxoff(arsp->rel_isdesc->is_indata);
-
-		if ((arsp->rel_flags & FLG_REL_CLVAL) ||
-		    (arsp->rel_flags & FLG_REL_GOTCL))
-			value = 0;
-		else if (ELF_ST_TYPE(sdp->sd_sym->st_info) == STT_SECTION) {
-			Sym_desc	*sym;
-
+		if ((sdp->sd_isc->is_flags & FLG_IS_RELUPD) &&
+		    (sym = ld_am_I_partial(arsp, arsp->rel_raddend))) {
 			/*
-			 * The value for a symbol pointing to a SECTION
-			 * is based off of that sections position.
+			 * The symbol was moved, so adjust the value
+			 * relative to the new section.
 			 */
-			if ((sdp->sd_isc->is_flags & FLG_IS_RELUPD) &&
-			    (sym = ld_am_I_partial(arsp, arsp->rel_raddend))) {
-				/*
-				 * The symbol was moved, so adjust the value
-				 * relative to the new section.
-				 */
-				value = _elf_getxoff(sym->sd_isc->is_indata);
-				if (sym->sd_isc->is_shdr->sh_flags & SHF_ALLOC)
-					value += sym->sd_isc->
-					    is_osdesc->os_shdr->sh_addr;
-
-				/*
-				 * The original raddend covers the displacement
-				 * from the section start to the desired
-				 * address. The value computed above gets us
-				 * from the section start to the start of the
-				 * symbol range. Adjust the old raddend to
-				 * remove the offset from section start to
-				 * symbol start, leaving the displacement
-				 * within the range of the symbol.
-				 */
-				arsp->rel_raddend -= sym->sd_osym->st_value;
-			} else {
-				value = _elf_getxoff(sdp->sd_isc->is_indata);
-				if (sdp->sd_isc->is_shdr->sh_flags & SHF_ALLOC)
-					value += sdp->sd_isc->
-					    is_osdesc->os_shdr->sh_addr;
-			}
-
-			if (sdp->sd_isc->is_shdr->sh_flags & SHF_TLS)
-				value -= ofl->ofl_tlsphdr->p_vaddr;
+			value = _elf_getxoff(sym->sd_isc->is_indata);
+			if (sym->sd_isc->is_shdr->sh_flags & SHF_ALLOC)
+				value += sym->sd_isc->
+				    is_osdesc->os_shdr->sh_addr;
 
-		} else if (IS_SIZE(arsp->rel_rtype)) {
 			/*
-			 * Size relocations require the symbols size.
+			 * The original raddend covers the displacement
+			 * from the section start to the desired
+			 * address. The value computed above gets us
+			 * from the section start to the start of the
+			 * symbol range. Adjust the old raddend to
+			 * remove the offset from section start to
+			 * symbol start, leaving the displacement
+			 * within the range of the symbol.
 			 */
-			value = sdp->sd_sym->st_size;
-
-		} else if ((sdp->sd_flags & FLG_SY_CAP) &&
-		    sdp->sd_aux && sdp->sd_aux->sa_PLTndx) {
-			/*
-			 * If relocation is against a capabilities symbol, we
-			 * need to jump to an associated PLT, so that at runtime
-			 * ld.so.1 is involved to determine the best binding
-			 * choice. Otherwise, the value is the symbols value.
-			 */
-			value = ld_calc_plt_addr(sdp, ofl);
+			arsp->rel_raddend -= sym->sd_osym->st_value;
+		} else {
+			value = _elf_getxoff(sdp->sd_isc->is_indata);
+			if (sdp->sd_isc->is_shdr->sh_flags & SHF_ALLOC)
+				value += sdp->sd_isc->
+				    is_osdesc->os_shdr->sh_addr;
+		}
 
-		} else
-			value = sdp->sd_sym->st_value;
+		if (sdp->sd_isc->is_shdr->sh_flags & SHF_TLS)
+			value -= ofl->ofl_tlsphdr->p_vaddr;
 
+	} else if (IS_SIZE(arsp->rel_rtype)) {
 		/*
-		 * Relocation against the GLOBAL_OFFSET_TABLE.
+		 * Size relocations require the symbols size.
 		 */
-		if ((arsp->rel_flags & FLG_REL_GOT) &&
-		    !ld_reloc_set_aux_osdesc(ofl, arsp, ofl->ofl_osgot))
-			return (S_ERROR);
-		osp = RELAUX_GET_OSDESC(arsp);
+		value = sdp->sd_sym->st_size;
 
+	} else if ((sdp->sd_flags & FLG_SY_CAP) &&
+	    sdp->sd_aux && sdp->sd_aux->sa_PLTndx) {
 		/*
-		 * If loadable and not producing a relocatable object add the
-		 * sections virtual address to the reference address.
+		 * If relocation is against a capabilities symbol, we
+		 * need to jump to an associated PLT, so that at runtime
+		 * ld.so.1 is involved to determine the best binding
+		 * choice. Otherwise, the value is the symbols value.
 		 */
-		if ((arsp->rel_flags & FLG_REL_LOAD) &&
-		    ((flags & FLG_OF_RELOBJ) == 0))
-			refaddr +=
-			    arsp->rel_isdesc->is_osdesc->os_shdr->sh_addr;
+		value = ld_calc_plt_addr(sdp, ofl);
+
+	} else
+		value = sdp->sd_sym->st_value;
+
+	/*
+	 * Relocation against the GLOBAL_OFFSET_TABLE.
+	 */
+	if ((arsp->rel_flags & FLG_REL_GOT) &&
+	    !ld_reloc_set_aux_osdesc(ofl, arsp, ofl->ofl_osgot))
+		return (S_ERROR);
+	osp = RELAUX_GET_OSDESC(arsp);
+
+	/*
+	 * If loadable and not producing a relocatable object add the
+	 * sections virtual address to the reference address.
+	 */
+	if ((arsp->rel_flags & FLG_REL_LOAD) &&
+	    ((flags & FLG_OF_RELOBJ) == 0))
+		refaddr +=
+		    arsp->rel_isdesc->is_osdesc->os_shdr->sh_addr;
+
+	/*
+	 * If this entry has a PLT assigned to it, its value is actually
+	 * the address of the PLT (and not the address of the function).
+	 */
+	if (IS_PLT(arsp->rel_rtype)) {
+		if (sdp->sd_aux && sdp->sd_aux->sa_PLTndx)
+			value = ld_calc_plt_addr(sdp, ofl);
+	}
+
+	/*
+	 * Add relocations addend to value.  Add extra
+	 * relocation addend if needed.
+	 */
+	value += arsp->rel_raddend;
+	if (IS_EXTOFFSET(arsp->rel_rtype))
+		value += RELAUX_GET_TYPEDATA(arsp);
+
+	/*
+	 * Determine whether the value needs further adjustment. Filter
+	 * through the attributes of the relocation to determine what
+	 * adjustment is required.  Note, many of the following cases
+	 * are only applicable when a .got is present.  As a .got is
+	 * not generated when a relocatable object is being built,
+	 * any adjustments that require a .got need to be skipped.
+	 */
+	if ((arsp->rel_flags & FLG_REL_GOT) &&
+	    ((flags & FLG_OF_RELOBJ) == 0)) {
+		Xword		R1addr;
+		uintptr_t	R2addr;
+		Sword		gotndx;
+		Gotndx		*gnp;
+		Gotref		gref;
 
 		/*
-		 * If this entry has a PLT assigned to it, its value is actually
-		 * the address of the PLT (and not the address of the function).
+		 * Clear the GOT table entry, on SPARC we clear
+		 * the entry and the 'value' if needed is stored
+		 * in an output relocations addend.
+		 *
+		 * Calculate offset into GOT at which to apply
+		 * the relocation.
 		 */
-		if (IS_PLT(arsp->rel_rtype)) {
-			if (sdp->sd_aux && sdp->sd_aux->sa_PLTndx)
-				value = ld_calc_plt_addr(sdp, ofl);
-		}
+		if (arsp->rel_flags & FLG_REL_DTLS)
+			gref = GOT_REF_TLSGD;
+		else if (arsp->rel_flags & FLG_REL_MTLS)
+			gref = GOT_REF_TLSLD;
+		else if (arsp->rel_flags & FLG_REL_STLS)
+			gref = GOT_REF_TLSIE;
+		else
+			gref = GOT_REF_GENERIC;
+
+		gnp = ld_find_got_ndx(sdp->sd_GOTndxs, gref, ofl, arsp);
+		assert(gnp);
+
+		if (arsp->rel_rtype == M_R_DTPOFF)
+			gotndx = gnp->gn_gotndx + 1;
+		else
+			gotndx = gnp->gn_gotndx;
+
+		/* LINTED */
+		R1addr = (Xword)((-neggotoffset * M_GOT_ENTSIZE) +
+		    (gotndx * M_GOT_ENTSIZE));
 
 		/*
-		 * Add relocations addend to value.  Add extra
-		 * relocation addend if needed.
+		 * Add the GOTs data's offset.
 		 */
-		value += arsp->rel_raddend;
-		if (IS_EXTOFFSET(arsp->rel_rtype))
-			value += RELAUX_GET_TYPEDATA(arsp);
+		R2addr = R1addr + (uintptr_t)osp->os_outdata->d_buf;
+
+		DBG_CALL(Dbg_reloc_doact(ofl->ofl_lml,
+		    ELF_DBG_LD_ACT, M_MACH, SHT_RELA,
+		    arsp, R1addr, value, ld_reloc_sym_name));
 
 		/*
-		 * Determine whether the value needs further adjustment. Filter
-		 * through the attributes of the relocation to determine what
-		 * adjustment is required.  Note, many of the following cases
-		 * are only applicable when a .got is present.  As a .got is
-		 * not generated when a relocatable object is being built,
-		 * any adjustments that require a .got need to be skipped.
+		 * And do it.
 		 */
-		if ((arsp->rel_flags & FLG_REL_GOT) &&
-		    ((flags & FLG_OF_RELOBJ) == 0)) {
-			Xword		R1addr;
-			uintptr_t	R2addr;
-			Sword		gotndx;
-			Gotndx		*gnp;
-			Gotref		gref;
-
-			/*
-			 * Clear the GOT table entry, on SPARC we clear
-			 * the entry and the 'value' if needed is stored
-			 * in an output relocations addend.
-			 *
-			 * Calculate offset into GOT at which to apply
-			 * the relocation.
-			 */
-			if (arsp->rel_flags & FLG_REL_DTLS)
-				gref = GOT_REF_TLSGD;
-			else if (arsp->rel_flags & FLG_REL_MTLS)
-				gref = GOT_REF_TLSLD;
-			else if (arsp->rel_flags & FLG_REL_STLS)
-				gref = GOT_REF_TLSIE;
-			else
-				gref = GOT_REF_GENERIC;
+		if (ofl->ofl_flags1 & FLG_OF1_ENCDIFF)
+			*(Xword *)R2addr = ld_bswap_Xword(value);
+		else
+			*(Xword *)R2addr = value;
+		return (1);
 
-			gnp = ld_find_got_ndx(sdp->sd_GOTndxs, gref, ofl, arsp);
-			assert(gnp);
+	} else if (IS_GOT_BASED(arsp->rel_rtype) &&
+	    ((flags & FLG_OF_RELOBJ) == 0)) {
+		value -= (ofl->ofl_osgot->os_shdr->sh_addr +
+		    (-neggotoffset * M_GOT_ENTSIZE));
 
-			if (arsp->rel_rtype == M_R_DTPOFF)
-				gotndx = gnp->gn_gotndx + 1;
-			else
-				gotndx = gnp->gn_gotndx;
+	} else if (IS_PC_RELATIVE(arsp->rel_rtype)) {
+		value -= refaddr;
 
-			/* LINTED */
-			R1addr = (Xword)((-neggotoffset * M_GOT_ENTSIZE) +
-			    (gotndx * M_GOT_ENTSIZE));
+	} else if (IS_TLS_INS(arsp->rel_rtype) &&
+	    IS_GOT_RELATIVE(arsp->rel_rtype) &&
+	    ((flags & FLG_OF_RELOBJ) == 0)) {
+		Gotndx	*gnp;
+		Gotref	gref;
 
-			/*
-			 * Add the GOTs data's offset.
-			 */
-			R2addr = R1addr + (uintptr_t)osp->os_outdata->d_buf;
+		if (arsp->rel_flags & FLG_REL_STLS)
+			gref = GOT_REF_TLSIE;
+		else if (arsp->rel_flags & FLG_REL_DTLS)
+			gref = GOT_REF_TLSGD;
+		else if (arsp->rel_flags & FLG_REL_MTLS)
+			gref = GOT_REF_TLSLD;
 
-			DBG_CALL(Dbg_reloc_doact(ofl->ofl_lml,
-			    ELF_DBG_LD_ACT, M_MACH, SHT_RELA,
-			    arsp, R1addr, value, ld_reloc_sym_name));
+		gnp = ld_find_got_ndx(sdp->sd_GOTndxs, gref, ofl, arsp);
+		assert(gnp);
 
-			/*
-			 * And do it.
-			 */
-			if (ofl->ofl_flags1 & FLG_OF1_ENCDIFF)
-				*(Xword *)R2addr = ld_bswap_Xword(value);
-			else
-				*(Xword *)R2addr = value;
-			continue;
+		value = gnp->gn_gotndx * M_GOT_ENTSIZE;
 
-		} else if (IS_GOT_BASED(arsp->rel_rtype) &&
-		    ((flags & FLG_OF_RELOBJ) == 0)) {
-			value -= (ofl->ofl_osgot->os_shdr->sh_addr +
-			    (-neggotoffset * M_GOT_ENTSIZE));
+	} else if (IS_GOT_RELATIVE(arsp->rel_rtype) &&
+	    ((flags & FLG_OF_RELOBJ) == 0)) {
+		Gotndx	*gnp;
 
-		} else if (IS_PC_RELATIVE(arsp->rel_rtype)) {
-			value -= refaddr;
+		gnp = ld_find_got_ndx(sdp->sd_GOTndxs,
+		    GOT_REF_GENERIC, ofl, arsp);
+		assert(gnp);
 
-		} else if (IS_TLS_INS(arsp->rel_rtype) &&
-		    IS_GOT_RELATIVE(arsp->rel_rtype) &&
-		    ((flags & FLG_OF_RELOBJ) == 0)) {
-			Gotndx	*gnp;
-			Gotref	gref;
+		value = gnp->gn_gotndx * M_GOT_ENTSIZE;
 
-			if (arsp->rel_flags & FLG_REL_STLS)
-				gref = GOT_REF_TLSIE;
-			else if (arsp->rel_flags & FLG_REL_DTLS)
-				gref = GOT_REF_TLSGD;
-			else if (arsp->rel_flags & FLG_REL_MTLS)
-				gref = GOT_REF_TLSLD;
+	} else if ((arsp->rel_flags & FLG_REL_STLS) &&
+	    ((flags & FLG_OF_RELOBJ) == 0)) {
+		Xword	tlsstatsize;
 
-			gnp = ld_find_got_ndx(sdp->sd_GOTndxs, gref, ofl, arsp);
-			assert(gnp);
+		/*
+		 * This is the LE TLS reference model. Static offset is
+		 * hard-coded, and negated so that it can be added to
+		 * the thread pointer (%g7)
+		 */
+		tlsstatsize =
+		    S_ROUND(ofl->ofl_tlsphdr->p_memsz, M_TLSSTATALIGN);
+		value = -(tlsstatsize - value);
+	}
 
-			value = gnp->gn_gotndx * M_GOT_ENTSIZE;
+	if (arsp->rel_isdesc->is_file)
+		ifl_name = arsp->rel_isdesc->is_file->ifl_name;
+	else
+		ifl_name = MSG_INTL(MSG_STR_NULL);
 
-		} else if (IS_GOT_RELATIVE(arsp->rel_rtype) &&
-		    ((flags & FLG_OF_RELOBJ) == 0)) {
-			Gotndx	*gnp;
+	/*
+	 * Make sure we have data to relocate.  Compiler and assembler
+	 * developers have been known to generate relocations against
+	 * invalid sections (normally .bss), so for their benefit give
+	 * them sufficient information to help analyze the problem.
+	 * End users should never see this.
+	 */
+	if (arsp->rel_isdesc->is_indata->d_buf == 0) {
+		Conv_inv_buf_t	inv_buf;
 
-			gnp = ld_find_got_ndx(sdp->sd_GOTndxs,
-			    GOT_REF_GENERIC, ofl, arsp);
-			assert(gnp);
+		ld_eprintf(ofl, ERR_FATAL, MSG_INTL(MSG_REL_EMPTYSEC),
+		    conv_reloc_SPARC_type(arsp->rel_rtype, 0, &inv_buf),
+		    ifl_name, ld_reloc_sym_name(arsp),
+		    EC_WORD(arsp->rel_isdesc->is_scnndx),
+		    arsp->rel_isdesc->is_name);
+		return (S_ERROR);
+	}
 
-			value = gnp->gn_gotndx * M_GOT_ENTSIZE;
+	/*
+	 * Get the address of the data item we need to modify.
+	 */
+	addr = (uchar_t *)((uintptr_t)arsp->rel_roffset +
+	    (uintptr_t)_elf_getxoff(arsp->rel_isdesc->is_indata));
 
-		} else if ((arsp->rel_flags & FLG_REL_STLS) &&
-		    ((flags & FLG_OF_RELOBJ) == 0)) {
-			Xword	tlsstatsize;
+	DBG_CALL(Dbg_reloc_doact(ofl->ofl_lml, ELF_DBG_LD_ACT,
+	    M_MACH, SHT_RELA, arsp, EC_NATPTR(addr), value,
+	    ld_reloc_sym_name));
+	addr += (uintptr_t)osp->os_outdata->d_buf;
 
-			/*
-			 * This is the LE TLS reference model. Static offset is
-			 * hard-coded, and negated so that it can be added to
-			 * the thread pointer (%g7)
-			 */
-			tlsstatsize =
-			    S_ROUND(ofl->ofl_tlsphdr->p_memsz, M_TLSSTATALIGN);
-			value = -(tlsstatsize - value);
-		}
+	if ((((uintptr_t)addr - (uintptr_t)ofl->ofl_nehdr) >
+	    ofl->ofl_size) || (arsp->rel_roffset >
+	    osp->os_shdr->sh_size)) {
+		Conv_inv_buf_t	inv_buf;
+		int		class;
 
-		if (arsp->rel_isdesc->is_file)
-			ifl_name = arsp->rel_isdesc->is_file->ifl_name;
+		if (((uintptr_t)addr - (uintptr_t)ofl->ofl_nehdr) >
+		    ofl->ofl_size)
+			class = ERR_FATAL;
 		else
-			ifl_name = MSG_INTL(MSG_STR_NULL);
-
-		/*
-		 * Make sure we have data to relocate.  Compiler and assembler
-		 * developers have been known to generate relocations against
-		 * invalid sections (normally .bss), so for their benefit give
-		 * them sufficient information to help analyze the problem.
-		 * End users should never see this.
-		 */
-		if (arsp->rel_isdesc->is_indata->d_buf == 0) {
-			Conv_inv_buf_t	inv_buf;
-
-			ld_eprintf(ofl, ERR_FATAL, MSG_INTL(MSG_REL_EMPTYSEC),
-			    conv_reloc_SPARC_type(arsp->rel_rtype, 0, &inv_buf),
-			    ifl_name, ld_reloc_sym_name(arsp),
-			    EC_WORD(arsp->rel_isdesc->is_scnndx),
-			    arsp->rel_isdesc->is_name);
-			return (S_ERROR);
-		}
+			class = ERR_WARNING;
 
-		/*
-		 * Get the address of the data item we need to modify.
-		 */
-		addr = (uchar_t *)((uintptr_t)arsp->rel_roffset +
-		    (uintptr_t)_elf_getxoff(arsp->rel_isdesc->is_indata));
+		ld_eprintf(ofl, class, MSG_INTL(MSG_REL_INVALOFFSET),
+		    conv_reloc_SPARC_type(arsp->rel_rtype, 0, &inv_buf),
+		    ifl_name, EC_WORD(arsp->rel_isdesc->is_scnndx),
+		    arsp->rel_isdesc->is_name, ld_reloc_sym_name(arsp),
+		    EC_ADDR((uintptr_t)addr -
+		    (uintptr_t)ofl->ofl_nehdr));
 
-		DBG_CALL(Dbg_reloc_doact(ofl->ofl_lml, ELF_DBG_LD_ACT,
-		    M_MACH, SHT_RELA, arsp, EC_NATPTR(addr), value,
-		    ld_reloc_sym_name));
-		addr += (uintptr_t)osp->os_outdata->d_buf;
+		if (class == ERR_FATAL)
+			return (0);
+	}
 
-		if ((((uintptr_t)addr - (uintptr_t)ofl->ofl_nehdr) >
-		    ofl->ofl_size) || (arsp->rel_roffset >
-		    osp->os_shdr->sh_size)) {
-			Conv_inv_buf_t	inv_buf;
-			int		class;
+	/*
+	 * If '-z noreloc' is specified - skip the do_reloc stage.
+	 */
+	if (OFL_DO_RELOC(ofl)) {
+		if (do_reloc_ld(arsp, addr, &value, ld_reloc_sym_name,
+		    ifl_name, OFL_SWAP_RELOC_DATA(ofl, arsp),
+		    ofl->ofl_lml) == 0)
+			return (0);
+	}
+	return (1);
+}
 
-			if (((uintptr_t)addr - (uintptr_t)ofl->ofl_nehdr) >
-			    ofl->ofl_size)
-				class = ERR_FATAL;
-			else
-				class = ERR_WARNING;
-
-			ld_eprintf(ofl, class, MSG_INTL(MSG_REL_INVALOFFSET),
-			    conv_reloc_SPARC_type(arsp->rel_rtype, 0, &inv_buf),
-			    ifl_name, EC_WORD(arsp->rel_isdesc->is_scnndx),
-			    arsp->rel_isdesc->is_name, ld_reloc_sym_name(arsp),
-			    EC_ADDR((uintptr_t)addr -
-			    (uintptr_t)ofl->ofl_nehdr));
-
-			if (class == ERR_FATAL) {
-				return_code = S_ERROR;
-				continue;
-			}
-		}
+static uintptr_t
+ld_do_activerelocs(Ofl_desc *ofl)
+{
+	if (aplist_nitems(ofl->ofl_actrels.rc_list) != 0)
+		DBG_CALL(Dbg_reloc_doact_title(ofl->ofl_lml));
 
-		/*
-		 * If '-z noreloc' is specified - skip the do_reloc stage.
-		 */
-		if (OFL_DO_RELOC(ofl)) {
-			if (do_reloc_ld(arsp, addr, &value, ld_reloc_sym_name,
-			    ifl_name, OFL_SWAP_RELOC_DATA(ofl, arsp),
-			    ofl->ofl_lml) == 0) {
-				ofl->ofl_flags |= FLG_OF_FATAL;
-				return_code = S_ERROR;
-			}
-		}
-	}
-	return (return_code);
+	return (ld_reloc_activerelocs(ofl, do_activereloc));
 }
 
 static uintptr_t
@@ -35,6 +35,7 @@
 
 #include	<string.h>
 #include	<stdio.h>
+#include	<stdlib.h>
 #include	<alloca.h>
 #include	<debug.h>
 #include	"msg.h"
@@ -2652,6 +2653,190 @@ do_sorted_outrelocs(Ofl_desc *ofl)
 	return (error);
 }
 
+/*
+ * Applying the active relocations in parallel (-z threads).
+ *
+ * Each active relocation modifies the output image at its own offset within
+ * the input section it relocates.  Input sections don't overlap within the
+ * output image, so the relocations against one input section are independent
+ * of those against any other.  The active relocation list is broken into
+ * runs of consecutive relocations against the same input section, and the
+ * runs are grouped by input section.  Each group is a unit of work whose runs
+ * are applied in their original order, so that any relocations to the same
+ * offset are applied just as they would be by a single thread.
+ *
+ * Some relocations can write outside of their own offset.  GOT relocations
+ * update the .got, TLS and GOTOP relocations may rewrite a sequence of
+ * instructions, and move table relocations have their offset adjusted.
+ * These are applied by a single thread, in their original order, once all
+ * other relocations have been applied.
+ */
+#define	ACTREL_SERIAL(_ofl, _rsp) \
+	(((_rsp)->rel_flags & \
+	(FLG_REL_GOT | FLG_REL_TLSFIX | FLG_REL_GOTFIX)) || \
+	(RELAUX_GET_MOVE(_rsp) != NULL) || \
+	(RELAUX_GET_OSDESC(_rsp) == (_ofl)->ofl_osgot))
+
+typedef struct {
+	Is_desc		*ar_isp;	/* input section being relocated */
+	Rel_desc	*ar_first;	/* first relocation of the run */
+	Rel_desc	*ar_end;	/* one past the last relocation */
+	size_t		ar_ndx;		/* original position of the run */
+} Actrel_run;
+
+typedef struct {
+	Ofl_desc	*aw_ofl;
+	uintptr_t	(*aw_func)(Ofl_desc *, Rel_desc *);
+	Actrel_run	*aw_runs;	/* runs, sorted by input section */
+	size_t		aw_nruns;
+	size_t		*aw_groups;	/* first run of each input section */
+} Actrel_work;
+
+static int
+actrel_run_compare(const void *v1, const void *v2)
+{
+	const Actrel_run	*r1 = v1, *r2 = v2;
+
+	if ((uintptr_t)r1->ar_isp > (uintptr_t)r2->ar_isp)
+		return (1);
+	if ((uintptr_t)r1->ar_isp < (uintptr_t)r2->ar_isp)
+		return (-1);
+	if (r1->ar_ndx > r2->ar_ndx)
+		return (1);
+	if (r1->ar_ndx < r2->ar_ndx)
+		return (-1);
+	return (0);
+}
+
+/*
+ * Collect the runs of active relocations that can be applied in parallel.
+ * The runs array is filled in if non-NULL.  Returns the number of runs.
+ */
+static size_t
+actrel_runs(Ofl_desc *ofl, Actrel_run *runs)
+{
+	Rel_cachebuf	*rcbp;
+	Rel_desc	*rsp;
+	Aliste		idx;
+	Is_desc		*isp;
+	size_t		nruns = 0;
+
+	for (APLIST_TRAVERSE(ofl->ofl_actrels.rc_list, idx, rcbp)) {
+		isp = NULL;
+		for (rsp = rcbp->rc_arr; rsp < rcbp->rc_free; rsp++) {
+			if (ACTREL_SERIAL(ofl, rsp)) {
+				isp = NULL;
+				continue;
+			}
+			if (rsp->rel_isdesc == isp) {
+				if (runs != NULL)
+					runs[nruns - 1].ar_end = rsp + 1;
+				continue;
+			}
+
+			isp = rsp->rel_isdesc;
+			if (runs != NULL) {
+				runs[nruns].ar_isp = isp;
+				runs[nruns].ar_first = rsp;
+				runs[nruns].ar_end = rsp + 1;
+				runs[nruns].ar_ndx = nruns;
+			}
+			nruns++;
+		}
+	}
+	return (nruns);
+}
+
+/*
+ * Apply the active relocations of one input section.
+ */
+static uintptr_t
+actrel_work(void *arg, size_t ndx)
+{
+	Actrel_work	*awp = arg;
+	Actrel_run	*arp = &awp->aw_runs[awp->aw_groups[ndx]];
+	Actrel_run	*earp = &awp->aw_runs[awp->aw_nruns];
+	Is_desc		*isp = arp->ar_isp;
+	Rel_desc	*rsp;
+	uintptr_t	ret, return_code = 1;
+
+	for (; (arp < earp) && (arp->ar_isp == isp); arp++) {
+		for (rsp = arp->ar_first; rsp < arp->ar_end; rsp++) {
+			if ((ret = (*awp->aw_func)(awp->aw_ofl, rsp)) ==
+			    S_ERROR)
+				return (S_ERROR);
+			if (ret == 0)
+				return_code = 0;
+		}
+	}
+	return (return_code);
+}
+
+/*
+ * Apply the active relocations, using the target specific function to apply
+ * each individual relocation.  With -z threads, relocations are applied in
+ * parallel where that can't affect the output image.
+ */
+uintptr_t
+ld_reloc_activerelocs(Ofl_desc *ofl,
+    uintptr_t (*func)(Ofl_desc *, Rel_desc *))
+{
+	Rel_cachebuf	*rcbp;
+	Rel_desc	*rsp;
+	Aliste		idx;
+	Actrel_work	aw;
+	size_t		ndx, ngroups = 0;
+	uintptr_t	ret, return_code = 1;
+	int		parallel = 0;
+
+	if (OFL_PARALLEL(ofl) &&
+	    ((aw.aw_nruns = actrel_runs(ofl, NULL)) > 1)) {
+		if (((aw.aw_runs = libld_malloc(aw.aw_nruns *
+		    sizeof (Actrel_run))) == NULL) ||
+		    ((aw.aw_groups = libld_malloc(aw.aw_nruns *
+		    sizeof (size_t))) == NULL))
+			return (S_ERROR);
+
+		(void) actrel_runs(ofl, aw.aw_runs);
+		qsort(aw.aw_runs, aw.aw_nruns, sizeof (Actrel_run),
+		    actrel_run_compare);
+
+		for (ndx = 0; ndx < aw.aw_nruns; ndx++) {
+			if ((ndx == 0) || (aw.aw_runs[ndx].ar_isp !=
+			    aw.aw_runs[ndx - 1].ar_isp))
+				aw.aw_groups[ngroups++] = ndx;
+		}
+		aw.aw_ofl = ofl;
+		aw.aw_func = func;
+
+		if ((ret = ld_par_run(ofl->ofl_threads, ngroups, actrel_work,
+		    &aw)) == S_ERROR)
+			return (S_ERROR);
+		if (ret == 0) {
+			ofl->ofl_flags |= FLG_OF_FATAL;
+			return_code = S_ERROR;
+		}
+		parallel = 1;
+	}
+
+	/*
+	 * Apply all of the active relocations, or when they've been applied
+	 * in parallel, those that remain.
+	 */
+	REL_CACHE_TRAVERSE(&ofl->ofl_actrels, idx, rcbp, rsp) {
+		if (parallel && !ACTREL_SERIAL(ofl, rsp))
+			continue;
+
+		if ((ret = (*func)(ofl, rsp)) == S_ERROR)
+			return (S_ERROR);
+		if (ret == 0) {
+			ofl->ofl_flags |= FLG_OF_FATAL;
+			return_code = S_ERROR;
+		}
+	}
+	return (return_code);
+}
+
 /*
  * Process relocations.  Finds every input relocation section for each output
  * section and invokes reloc_section() to relocate that section.
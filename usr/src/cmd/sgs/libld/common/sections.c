@@ -522,6 +522,17 @@ new_section(Ofl_desc *ofl, Word shtype, const char *shname, Xword entcnt,
 		SET_SEC_INFO_WORD_ALIGN(ELF_T_WORD, SHF_ALLOC, sizeof (Word))
 		break;
 
+	case SHT_GNU_HASH:
+		/*
+		 * The bloom filter within a GNU hash table is made of address
+		 * sized words, so a 64-bit table has no uniform entry size.
+		 * The section is translated as words, and update_ognuhash()
+		 * compensates for the 64-bit bloom words.
+		 */
+		SET_SEC_INFO_WORD_ALIGN(ELF_T_WORD, SHF_ALLOC,
+		    (sizeof (Addr) == sizeof (Word)) ? sizeof (Word) : 0)
+		break;
+
 	case SHT_SUNW_symsort:
 	case SHT_SUNW_tlssort:
 		ofl->ofl_flags |= FLG_OF_OSABI;
@@ -1150,6 +1161,9 @@ make_dynamic(Ofl_desc *ofl)
 		 */
 		cnt += 6;
 
+		if (OFL_ALLOW_GNUHASH(ofl))
+			cnt++;		/* DT_GNU_HASH */
+
 		/*
 		 * If we are including local functions at the head of
 		 * the dynsym, then also reserve entries for DT_SUNW_SYMTAB
@@ -2013,6 +2027,76 @@ make_hash(Ofl_desc *ofl)
 	return (1);
 }
 
+/*
+ * Make the GNU hash table.  This supplements the .hash section of dynamic
+ * executables and shared libraries, and allows the run-time linker to
+ * reject most symbols an object does not define without walking a hash
+ * chain.  The form of the table is:
+ *
+ *	|------------------|
+ *	| # of buckets     |
+ *	|------------------|
+ *	| .dynsym offset   |	index of the first hashed symbol
+ *	|------------------|
+ *	| # of bloom words |
+ *	|------------------|
+ *	| bloom shift      |
+ *	|------------------|
+ *	|   bloom[]        |	Addr sized words
+ *	|------------------|
+ *	|   bucket[]       |
+ *	|------------------|
+ *	|   chain[]        |	one entry for each hashed symbol
+ *	|------------------|
+ *
+ * The hashed symbols are the globals of the .dynsym, which update_osym()
+ * orders by bucket.  The table is filled in by update_ognuhash().
+ */
+static uintptr_t
+make_gnuhash(Ofl_desc *ofl)
+{
+	Shdr		*shdr;
+	Elf_Data	*data;
+	Is_desc		*isec;
+	size_t		size;
+	Word		nsyms = ofl->ofl_globcnt;
+	Word		nbloom, nbits;
+
+	if (new_section(ofl, SHT_GNU_HASH, MSG_ORIG(MSG_SCN_GNUHASH), 0,
+	    &isec, &shdr, &data) == S_ERROR)
+		return (S_ERROR);
+
+	ofl->ofl_osgnuhash =
+	    ld_place_section(ofl, isec, NULL, ld_targ.t_id.id_hash, NULL);
+	if (ofl->ofl_osgnuhash == (Os_desc *)S_ERROR)
+		return (S_ERROR);
+
+	/*
+	 * The buckets are shared with the .hash section, which has already
+	 * been sized.  The bloom filter must be a power of two words, and
+	 * the second bloom hash is taken from the bits above those that
+	 * select the bloom word and bit.
+	 */
+	nbloom = 1;
+	while ((nbloom * GNUHASH_BLOOMBITS) < (nsyms * GNUHASH_BLOOMSYM))
+		nbloom <<= 1;
+	ofl->ofl_gnubloom = nbloom;
+
+	ofl->ofl_gnushift = 0;
+	for (nbits = nbloom * GNUHASH_BLOOMBITS; nbits > 1; nbits >>= 1)
+		ofl->ofl_gnushift++;
+
+	size = (4 * sizeof (Word)) + (nbloom * sizeof (Addr)) +
+	    ((ofl->ofl_hashbkts + nsyms) * sizeof (Word));
+
+	if ((data->d_buf = libld_calloc(size, 1)) == NULL)
+		return (S_ERROR);
+	data->d_size = size;
+	shdr->sh_size = (Xword)size;
+
+	return (1);
+}
+
 /*
  * Generate the standard symbol table.  Contains all locals and globals,
  * and resides in a non-allocatable section (ie. it can be stripped).
@@ -2815,53 +2899,48 @@ strmerge_pass1(Ofl_desc *ofl, Os_desc *osp, Str_tbl *mstrtab,
 }
 
 /*
- * If the output section has any SHF_MERGE|SHF_STRINGS input sections,
- * replace them with a single merged/compressed input section.
+ * String table merging state for a single output section.
+ */
+typedef struct {
+	Os_desc		*sm_osp;	/* output section */
+	Is_desc		*sm_isp;	/* first mergeable input section */
+	Str_tbl		*sm_mstrtab;	/* string table for string merge secs */
+	APlist		*sm_rel_alp;	/* relocations to be modified */
+	APlist		*sm_sym_alp;	/* symbols to be modified */
+} Strmerge_desc;
+
+/*
+ * Collect the strings of an output section's SHF_MERGE|SHF_STRINGS input
+ * sections that are referenced by relocations, along with the relocations
+ * and symbols that will need to be modified.  This is the first of the
+ * three passes described in ld_make_strmerge().
+ *
+ * This step only reads the relocations and symbols, and those that it reads
+ * are particular to the output section, so it can be carried out for a
+ * number of output sections at once (see ld_make_strmerges()).
  *
  * entry:
  *	ofl - Output file descriptor
- *	osp - Output section descriptor
- *	rel_alpp, sym_alpp, - Address of 2 APlists, to be used
- *		for internal processing. On the initial call to
- *		ld_make_strmerge, these list pointers must be NULL.
- *		The caller is encouraged to pass the same lists back for
- *		successive calls to this function without freeing
- *		them in between calls. This causes a single pair of
- *		memory allocations to be reused multiple times.
+ *	smp - String merge descriptor, with sm_osp set.  sm_rel_alp and
+ *		sm_sym_alp may retain lists from a previous call, for reuse.
  *
  * exit:
- *	If section merging is possible, it is done. If no errors are
- *	encountered, True (1) is returned. On error, S_ERROR.
- *
- *	The contents of rel_alpp and sym_alpp on exit are
- *	undefined. The caller can free them, or pass them back to a subsequent
- *	call to this routine, but should not examine their contents.
+ *	If the output section has no mergeable input sections, sm_mstrtab is
+ *	NULL.  Otherwise sm_mstrtab, sm_isp and the lists are set up for
+ *	strmerge_apply().  True (1) is returned on success, S_ERROR on error.
  */
 static uintptr_t
-ld_make_strmerge(Ofl_desc *ofl, Os_desc *osp, APlist **rel_alpp,
-    APlist **sym_alpp)
+strmerge_collect(Ofl_desc *ofl, Strmerge_desc *smp)
 {
-	Str_tbl		*mstrtab;	/* string table for string merge secs */
-	Is_desc		*mstrsec;	/* Generated string merge section */
+	Os_desc		*osp = smp->sm_osp;
 	Is_desc		*isp;
-	Shdr		*mstr_shdr;
-	Elf_Data	*mstr_data;
-	Sym_desc	*sdp;
-	Rel_desc	*rsp;
 	Aliste		idx;
-	size_t		data_size;
-	int		st_setstring_status;
-	size_t		stoff;
-
-	/* If string table compression is disabled, there's nothing to do */
-	if ((ofl->ofl_flags1 & FLG_OF1_NCSTTAB) != 0)
-		return (1);
 
 	/*
 	 * Pass over the mergeable input sections, and if they haven't
 	 * all been discarded, create a string table.
 	 */
-	mstrtab = NULL;
+	smp->sm_mstrtab = NULL;
 	for (APLIST_TRAVERSE(osp->os_mstrisdescs, idx, isp)) {
 		if (isdesc_discarded(isp))
 			continue;
@@ -2877,44 +2956,21 @@ ld_make_strmerge(Ofl_desc *ofl, Os_desc *osp, APlist **rel_alpp,
 		 * We have at least one non-discarded section.
 		 * Create a string table descriptor.
 		 */
-		if ((mstrtab = st_new(FLG_STNEW_COMPRESS)) == NULL)
+		if ((smp->sm_mstrtab = st_new(FLG_STNEW_COMPRESS)) == NULL)
 			return (S_ERROR);
 		break;
 	}
 
 	/* If no string table was created, we have no mergeable sections */
-	if (mstrtab == NULL)
+	if (smp->sm_mstrtab == NULL)
 		return (1);
+	smp->sm_isp = isp;
 
 	/*
-	 * This routine has to make 3 passes:
-	 *
-	 *	1) Examine all relocations, insert strings from relocations
-	 *		to the mergeable input sections into the string table.
-	 *	2) Modify the relocation values to be correct for the
-	 *		new merged section.
-	 *	3) Modify the symbols used by the relocations to reference
-	 *		the new section.
-	 *
-	 * These passes cannot be combined:
-	 *	- The string table code works in two passes, and all
-	 *		strings have to be loaded in pass one before the
-	 *		offset of any strings can be determined.
-	 *	- Multiple relocations reference a single symbol, so the
-	 *		symbol cannot be modified until all relocations are
-	 *		fixed.
-	 *
-	 * The number of relocations related to section merging is usually
-	 * a mere fraction of the overall active and output relocation lists,
-	 * and the number of symbols is usually a fraction of the number
-	 * of related relocations. We therefore build APlists for the
-	 * relocations and symbols in the first pass, and then use those
-	 * lists to accelerate the operation of pass 2 and 3.
-	 *
 	 * Reinitialize the lists to a completely empty state.
 	 */
-	aplist_reset(*rel_alpp);
-	aplist_reset(*sym_alpp);
+	aplist_reset(smp->sm_rel_alp);
+	aplist_reset(smp->sm_sym_alp);
 
 	/*
 	 * Pass 1:
@@ -2928,12 +2984,43 @@ ld_make_strmerge(Ofl_desc *ofl, Os_desc *osp, APlist **rel_alpp,
 	 * Build lists of relocations and symbols that will need modification,
 	 * and insert the strings they reference into the mstrtab string table.
 	 */
-	if (strmerge_pass1(ofl, osp, mstrtab, rel_alpp, sym_alpp,
-	    &ofl->ofl_actrels) == 0)
-		goto return_s_error;
-	if (strmerge_pass1(ofl, osp, mstrtab, rel_alpp, sym_alpp,
-	    &ofl->ofl_outrels) == 0)
-		goto return_s_error;
+	if ((strmerge_pass1(ofl, osp, smp->sm_mstrtab, &smp->sm_rel_alp,
+	    &smp->sm_sym_alp, &ofl->ofl_actrels) == 0) ||
+	    (strmerge_pass1(ofl, osp, smp->sm_mstrtab, &smp->sm_rel_alp,
+	    &smp->sm_sym_alp, &ofl->ofl_outrels) == 0)) {
+		st_destroy(smp->sm_mstrtab);
+		smp->sm_mstrtab = NULL;
+		return (S_ERROR);
+	}
+	return (1);
+}
+
+/*
+ * Replace the mergeable input sections collected by strmerge_collect() with
+ * a single merged/compressed input section, and update the relocations and
+ * symbols that reference them.  This is the second and third of the passes
+ * described in ld_make_strmerge().
+ *
+ * The string table is destroyed, and sm_mstrtab reset, on return.  The
+ * contents of sm_rel_alp and sm_sym_alp are undefined on exit.
+ */
+static uintptr_t
+strmerge_apply(Ofl_desc *ofl, Strmerge_desc *smp)
+{
+	Os_desc		*osp = smp->sm_osp;
+	Str_tbl		*mstrtab = smp->sm_mstrtab;
+	Is_desc		*isp = smp->sm_isp;
+	Is_desc		*mstrsec;	/* Generated string merge section */
+	Shdr		*mstr_shdr;
+	Elf_Data	*mstr_data;
+	Sym_desc	*sdp;
+	Rel_desc	*rsp;
+	Aliste		idx;
+	size_t		data_size;
+	int		st_setstring_status;
+	size_t		stoff;
+
+	smp->sm_mstrtab = NULL;
 
 	/*
 	 * Get the size of the new input section. Requesting the
@@ -2969,7 +3056,7 @@ ld_make_strmerge(Ofl_desc *ofl, Os_desc *osp, APlist **rel_alpp,
 	 * record so that the offset it contains is for the new section
 	 * instead of the original.
 	 */
-	for (APLIST_TRAVERSE(*rel_alpp, idx, rsp)) {
+	for (APLIST_TRAVERSE(smp->sm_rel_alp, idx, rsp)) {
 		const char	*name;
 
 		/* Put the string into the merged string table */
@@ -3023,7 +3110,7 @@ ld_make_strmerge(Ofl_desc *ofl, Os_desc *osp, APlist **rel_alpp,
 	 * so that they reference the new input section containing the
 	 * merged strings instead of the original input sections.
 	 */
-	for (APLIST_TRAVERSE(*sym_alpp, idx, sdp)) {
+	for (APLIST_TRAVERSE(smp->sm_sym_alp, idx, sdp)) {
 		/*
 		 * If we've already processed this symbol, don't do it
 		 * twice. strmerge_pass1() uses a heuristic (relocations to
@@ -3093,6 +3180,155 @@ return_s_error:
 	return (S_ERROR);
 }
 
+/*
+ * If the output section has any SHF_MERGE|SHF_STRINGS input sections,
+ * replace them with a single merged/compressed input section.
+ *
+ * entry:
+ *	ofl - Output file descriptor
+ *	smp - String merge descriptor for the output section, as described
+ *		by strmerge_collect().
+ *
+ * exit:
+ *	If section merging is possible, it is done. If no errors are
+ *	encountered, True (1) is returned. On error, S_ERROR.
+ */
+static uintptr_t
+ld_make_strmerge(Ofl_desc *ofl, Strmerge_desc *smp)
+{
+	/*
+	 * This routine has to make 3 passes:
+	 *
+	 *	1) Examine all relocations, insert strings from relocations
+	 *		to the mergeable input sections into the string table.
+	 *	2) Modify the relocation values to be correct for the
+	 *		new merged section.
+	 *	3) Modify the symbols used by the relocations to reference
+	 *		the new section.
+	 *
+	 * These passes cannot be combined:
+	 *	- The string table code works in two passes, and all
+	 *		strings have to be loaded in pass one before the
+	 *		offset of any strings can be determined.
+	 *	- Multiple relocations reference a single symbol, so the
+	 *		symbol cannot be modified until all relocations are
+	 *		fixed.
+	 *
+	 * The number of relocations related to section merging is usually
+	 * a mere fraction of the overall active and output relocation lists,
+	 * and the number of symbols is usually a fraction of the number
+	 * of related relocations. We therefore build APlists for the
+	 * relocations and symbols in the first pass, and then use those
+	 * lists to accelerate the operation of pass 2 and 3.
+	 */
+	if (strmerge_collect(ofl, smp) == S_ERROR)
+		return (S_ERROR);
+	if (smp->sm_mstrtab == NULL)
+		return (1);
+
+	return (strmerge_apply(ofl, smp));
+}
+
+/*
+ * Used by ld_make_strmerges() to call strmerge_collect() for a number of
+ * output sections in parallel.
+ */
+typedef struct {
+	Ofl_desc	*smw_ofl;
+	Strmerge_desc	*smw_descs;
+} Strmerge_work;
+
+static uintptr_t
+strmerge_collect_work(void *arg, size_t ndx)
+{
+	Strmerge_work	*smwp = arg;
+
+	return (strmerge_collect(smwp->smw_ofl, &smwp->smw_descs[ndx]));
+}
+
+/*
+ * Do any of the output sections contain input sections that are candidates
+ * for string table merging? For each such case, we create a replacement
+ * section, insert it, and discard the originals.
+ *
+ * Normally the output sections are processed one at a time, reusing a single
+ * pair of lists for all of them.  With -z threads, the first pass is instead
+ * carried out for all of the output sections in parallel, each with its own
+ * lists.  The remaining passes then follow, one output section at a time and
+ * in the usual order, so the output is the same either way.
+ */
+static uintptr_t
+ld_make_strmerges(Ofl_desc *ofl)
+{
+	Strmerge_desc	*descs;
+	Strmerge_work	smw;
+	Sg_desc		*sgp;
+	Os_desc		*osp;
+	Aliste		idx1, idx2;
+	size_t		ndx, cnt = 0;
+	uintptr_t	ret = 1;
+
+	for (APLIST_TRAVERSE(ofl->ofl_segs, idx1, sgp)) {
+		for (APLIST_TRAVERSE(sgp->sg_osdescs, idx2, osp))
+			if (osp->os_mstrisdescs != NULL)
+				cnt++;
+	}
+
+	if (!OFL_PARALLEL(ofl) || (cnt < 2)) {
+		Strmerge_desc	sm;
+
+		sm.sm_rel_alp = NULL;
+		sm.sm_sym_alp = NULL;
+
+		for (APLIST_TRAVERSE(ofl->ofl_segs, idx1, sgp)) {
+			for (APLIST_TRAVERSE(sgp->sg_osdescs, idx2, osp)) {
+				if (osp->os_mstrisdescs == NULL)
+					continue;
+
+				sm.sm_osp = osp;
+				if (ld_make_strmerge(ofl, &sm) == S_ERROR) {
+					ret = S_ERROR;
+					break;
+				}
+			}
+		}
+		if (sm.sm_rel_alp != NULL)
+			libld_free(sm.sm_rel_alp);
+		if (sm.sm_sym_alp != NULL)
+			libld_free(sm.sm_sym_alp);
+		return (ret);
+	}
+
+	if ((descs = libld_calloc(cnt, sizeof (Strmerge_desc))) == NULL)
+		return (S_ERROR);
+
+	ndx = 0;
+	for (APLIST_TRAVERSE(ofl->ofl_segs, idx1, sgp)) {
+		for (APLIST_TRAVERSE(sgp->sg_osdescs, idx2, osp))
+			if (osp->os_mstrisdescs != NULL)
+				descs[ndx++].sm_osp = osp;
+	}
+
+	smw.smw_ofl = ofl;
+	smw.smw_descs = descs;
+	if (ld_par_run(ofl->ofl_threads, cnt, strmerge_collect_work,
+	    &smw) == S_ERROR)
+		ret = S_ERROR;
+
+	for (ndx = 0; ndx < cnt; ndx++) {
+		Strmerge_desc	*smp = &descs[ndx];
+
+		if (smp->sm_mstrtab == NULL)
+			continue;
+		if (ret == S_ERROR)
+			st_destroy(smp->sm_mstrtab);
+		else if (strmerge_apply(ofl, smp) == S_ERROR)
+			ret = S_ERROR;
+	}
+	libld_free(descs);
+	return (ret);
+}
+
 /*
  * Update a data buffers size.  A number of sections have to be created, and
  * the sections header contributes to the size of the eventual section.  Thus,
@@ -3185,43 +3421,11 @@ ld_make_sections(Ofl_desc *ofl)
 		adjust_os_count(ofl);
 
 	/*
-	 * Do any of the output sections contain input sections that
-	 * are candidates for string table merging? For each such case,
-	 * we create a replacement section, insert it, and discard the
-	 * originals.
-	 *
-	 * rel_alpp and sym_alpp are used by ld_make_strmerge()
-	 * for its internal processing. We are responsible for the
-	 * initialization and cleanup, and ld_make_strmerge() handles the rest.
-	 * This allows us to reuse a single pair of memory buffers, allocated
-	 * for this processing, for all the output sections.
-	 */
-	if ((ofl->ofl_flags1 & FLG_OF1_NCSTTAB) == 0) {
-		int	error_seen = 0;
-		APlist	*rel_alpp = NULL;
-		APlist	*sym_alpp = NULL;
-		Aliste	idx1;
-
-		for (APLIST_TRAVERSE(ofl->ofl_segs, idx1, sgp)) {
-			Os_desc	*osp;
-			Aliste	idx2;
-
-			for (APLIST_TRAVERSE(sgp->sg_osdescs, idx2, osp))
-				if ((osp->os_mstrisdescs != NULL) &&
-				    (ld_make_strmerge(ofl, osp,
-				    &rel_alpp, &sym_alpp) ==
-				    S_ERROR)) {
-					error_seen = 1;
-					break;
-				}
-		}
-		if (rel_alpp != NULL)
-			libld_free(rel_alpp);
-		if (sym_alpp != NULL)
-			libld_free(sym_alpp);
-		if (error_seen != 0)
-			return (S_ERROR);
-	}
+	 * Carry out any string table merging.
+	 */
+	if (((ofl->ofl_flags1 & FLG_OF1_NCSTTAB) == 0) &&
+	    (ld_make_strmerges(ofl) == S_ERROR))
+		return (S_ERROR);
 
 	/*
 	 * Add any necessary versioning information.
@@ -3318,6 +3522,9 @@ ld_make_sections(Ofl_desc *ofl)
 		if (!(flags & FLG_OF_RELOBJ)) {
 			if (make_hash(ofl) == S_ERROR)
 				return (S_ERROR);
+			if (OFL_ALLOW_GNUHASH(ofl) &&
+			    (make_gnuhash(ofl) == S_ERROR))
+				return (S_ERROR);
 			if (make_dynstr(ofl) == S_ERROR)
 				return (S_ERROR);
 			if (make_dynsym(ofl) == S_ERROR)
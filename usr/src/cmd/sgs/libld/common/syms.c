@@ -285,6 +285,138 @@ ld_sym_copy(Sym_desc *sdp)
 	return (1);
 }
 
+/*
+ * The link editors internal symbol table.
+ *
+ * Global symbols are entered in an open addressed hash table that uses linear
+ * probing.  The table is kept no more than half full and, as symbols are never
+ * removed, a search ends at the first unused entry.  Before the global symbols
+ * of an input file are processed, the table is sized to accommodate all of
+ * them (see ld_sym_reserve()), so that it seldom has to grow while symbols
+ * are being entered.
+ *
+ * The low order bits of an elf_hash() value depend mostly on the last few
+ * characters of a name, and names often differ only in those characters, so
+ * the hash value is scrambled before being reduced to a table index.
+ *
+ * The symbols are also recorded on a list in the order they are entered.
+ * Passes that traverse all global symbols, and whose results depend on the
+ * traversal order, use this list once it has been sorted by ld_sym_sort().
+ */
+#define	SYM_HTAB_MINSZ	1024		/* initial no. of hash table entries */
+
+#define	SYM_HTAB_NDX(_hash, _size) \
+	((Word)(((u_longlong_t)(_hash) * 0x9e3779b97f4a7c15ULL) >> 32) & \
+	((_size) - 1))
+
+/*
+ * Return the index of the hash table entry for a name, or if the name hasn't
+ * been entered, the index of the unused entry at which it would be entered.
+ */
+static Word
+sym_htab_probe(Sym_hent *htab, Word size, const char *name, Word hash)
+{
+	Word	ndx = SYM_HTAB_NDX(hash, size);
+
+	for (;;) {
+		Sym_hent	*hep = &htab[ndx];
+
+		if ((hep->she_sdp == NULL) || ((hep->she_hash == hash) &&
+		    (strcmp(hep->she_name, name) == 0)))
+			return (ndx);
+		ndx = (ndx + 1) & (size - 1);
+	}
+	/* NOTREACHED */
+}
+
+/*
+ * Ensure the hash table, and the symbol list, can hold the given number of
+ * symbols, growing them if necessary.
+ */
+static uintptr_t
+sym_htab_grow(Ofl_desc *ofl, Word cnt)
+{
+	Sym_hent	*htab, *list;
+	Word		size, ndx;
+
+	if (cnt <= (ofl->ofl_symhtabsz / 2))
+		return (1);
+
+	for (size = SYM_HTAB_MINSZ; (size / 2) < cnt; size *= 2)
+		;
+
+	if (((htab = libld_calloc(size, sizeof (Sym_hent))) == NULL) ||
+	    ((list = libld_malloc((size / 2) * sizeof (Sym_hent))) == NULL))
+		return (S_ERROR);
+
+	for (ndx = 0; ndx < ofl->ofl_entercnt; ndx++) {
+		Sym_hent	*hep = &ofl->ofl_symlist[ndx];
+		Word		hndx = SYM_HTAB_NDX(hep->she_hash, size);
+
+		while (htab[hndx].she_sdp != NULL)
+			hndx = (hndx + 1) & (size - 1);
+		htab[hndx] = list[ndx] = *hep;
+	}
+
+	ofl->ofl_symhtab = htab;
+	ofl->ofl_symhtabsz = size;
+	ofl->ofl_symlist = list;
+	ofl->ofl_symlistsz = size / 2;
+	return (1);
+}
+
+/*
+ * Prepare the internal symbol table for the entry of up to cnt additional
+ * symbols, typically the global symbols of an input file.
+ */
+uintptr_t
+ld_sym_reserve(Ofl_desc *ofl, Word cnt)
+{
+	return (sym_htab_grow(ofl, ofl->ofl_entercnt + cnt));
+}
+
+/*
+ * Compare two global symbol list entries.  The primary key is the symbol
+ * name hash with a secondary key of the symbol name itself, as for
+ * ld_sym_avl_comp().
+ */
+static int
+sym_list_compare(const void *v1, const void *v2)
+{
+	const Sym_hent	*hep1 = v1, *hep2 = v2;
+	int		res;
+
+	if (hep1->she_hash < hep2->she_hash)
+		return (-1);
+	if (hep1->she_hash > hep2->she_hash)
+		return (1);
+
+	res = strcmp(hep1->she_name, hep2->she_name);
+	if (res == 0)
+		return (0);
+	if (res > 0)
+		return (1);
+	return (-1);
+}
+
+/*
+ * Sort the global symbol list into symbol name hash and name order.  This
+ * order is independent of the order in which the symbols were entered, and
+ * of the size of the hash table, and so provides traversals of the symbol
+ * table, and thus the output file, with a consistent order.  The list is only
+ * sorted again if symbols have been entered since it was last sorted.
+ */
+void
+ld_sym_sort(Ofl_desc *ofl)
+{
+	if (ofl->ofl_symsorted == ofl->ofl_entercnt)
+		return;
+
+	qsort(ofl->ofl_symlist, ofl->ofl_entercnt, sizeof (Sym_hent),
+	    sym_list_compare);
+	ofl->ofl_symsorted = ofl->ofl_entercnt;
+}
+
 /*
  * Finds a given name in the link editors internal symbol table.  If no
  * hash value is specified it is calculated.  A pointer to the located
@@ -293,31 +425,32 @@ ld_sym_copy(Sym_desc *sdp)
 Sym_desc *
 ld_sym_find(const char *name, Word hash, avl_index_t *where, Ofl_desc *ofl)
 {
-	Sym_avlnode	qsav, *sav;
+	Word	ndx;
 
 	if (hash == SYM_NOHASH)
 		/* LINTED */
 		hash = (Word)elf_hash((const char *)name);
-	qsav.sav_hash = hash;
-	qsav.sav_name = name;
 
-	/*
-	 * Perform search for symbol in AVL tree.  Note that the 'where' field
-	 * is passed in from the caller.  If a 'where' is present, it can be
-	 * used in subsequent 'ld_sym_enter()' calls if required.
-	 */
-	sav = avl_find(&ofl->ofl_symavl, &qsav, where);
+	if (ofl->ofl_symhtab == NULL) {
+		if (where)
+			*where = 0;
+		return (NULL);
+	}
 
 	/*
-	 * If symbol was not found in the avl tree, return null to show that.
+	 * Search for the symbol in the hash table.  Note that the 'where'
+	 * field is passed in from the caller.  If a 'where' is present, it
+	 * records the hash table entry at which the symbol would be entered,
+	 * and can be used in subsequent 'ld_sym_enter()' calls if required.
 	 */
-	if (sav == NULL)
-		return (NULL);
+	ndx = sym_htab_probe(ofl->ofl_symhtab, ofl->ofl_symhtabsz, name, hash);
+	if (where)
+		*where = ndx;
 
 	/*
-	 * Return symbol found.
+	 * Return the symbol found, or null if there isn't one.
 	 */
-	return (sav->sav_sdp);
+	return (ofl->ofl_symhtab[ndx].she_sdp);
 }
 
 /*
@@ -367,12 +500,12 @@ ld_sym_enter(const char *name, Sym *osym, Word hash, Ifl_desc *ifl,
 {
 	Sym_desc	*sdp;
 	Sym_aux		*sap;
-	Sym_avlnode	*savl;
+	Sym_hent	*hep;
 	char		*_name;
 	Sym		*nsym;
 	Half		etype;
 	uchar_t		vis;
-	avl_index_t	_where;
+	Word		htabsz, hndx;
 
 	/*
 	 * Establish the file type.
@@ -382,25 +515,18 @@ ld_sym_enter(const char *name, Sym *osym, Word hash, Ifl_desc *ifl,
 	else
 		etype = ET_NONE;
 
-	ofl->ofl_entercnt++;
-
 	/*
-	 * Allocate a Sym Descriptor, Auxiliary Descriptor, and a Sym AVLNode -
-	 * contiguously.
+	 * Allocate a Sym Descriptor and Auxiliary Descriptor - contiguously.
 	 */
-	if ((savl = libld_calloc(S_DROUND(sizeof (Sym_avlnode)) +
-	    S_DROUND(sizeof (Sym_desc)) +
+	if ((sdp = libld_calloc(S_DROUND(sizeof (Sym_desc)) +
 	    S_DROUND(sizeof (Sym_aux)), 1)) == NULL)
 		return ((Sym_desc *)S_ERROR);
-	sdp = (Sym_desc *)((uintptr_t)savl +
-	    S_DROUND(sizeof (Sym_avlnode)));
 	sap = (Sym_aux *)((uintptr_t)sdp +
 	    S_DROUND(sizeof (Sym_desc)));
 
-	savl->sav_sdp = sdp;
 	sdp->sd_file = ifl;
 	sdp->sd_aux = sap;
-	savl->sav_hash = sap->sa_hash = hash;
+	sap->sa_hash = hash;
 
 	/*
 	 * Copy the symbol table entry from the input file into the internal
@@ -413,23 +539,30 @@ ld_sym_enter(const char *name, Sym *osym, Word hash, Ifl_desc *ifl,
 
 	if ((_name = libld_malloc(strlen(name) + 1)) == NULL)
 		return ((Sym_desc *)S_ERROR);
-	savl->sav_name = sdp->sd_name = (const char *)strcpy(_name, name);
+	sdp->sd_name = (const char *)strcpy(_name, name);
 
 	/*
-	 * Enter Symbol in AVL tree.
+	 * Enter Symbol in the hash table, and on the symbol list.  If a
+	 * previous ld_sym_find() hasn't initialized 'where', or the table has
+	 * since grown, locate the hash table entry now.
 	 */
-	if (where == 0) {
-		/* LINTED */
-		Sym_avlnode	*_savl;
-		/*
-		 * If a previous ld_sym_find() hasn't initialized 'where' do it
-		 * now.
-		 */
-		where = &_where;
-		_savl = avl_find(&ofl->ofl_symavl, savl, where);
-		assert(_savl == NULL);
-	}
-	avl_insert(&ofl->ofl_symavl, savl, *where);
+	htabsz = ofl->ofl_symhtabsz;
+	if (sym_htab_grow(ofl, ofl->ofl_entercnt + 1) == S_ERROR)
+		return ((Sym_desc *)S_ERROR);
+
+	if ((where == NULL) || (htabsz != ofl->ofl_symhtabsz) ||
+	    (ofl->ofl_symhtab[*where].she_sdp != NULL)) {
+		hndx = sym_htab_probe(ofl->ofl_symhtab, ofl->ofl_symhtabsz,
+		    name, hash);
+		assert(ofl->ofl_symhtab[hndx].she_sdp == NULL);
+	} else
+		hndx = (Word)*where;
+
+	hep = &ofl->ofl_symhtab[hndx];
+	hep->she_hash = hash;
+	hep->she_name = sdp->sd_name;
+	hep->she_sdp = sdp;
+	ofl->ofl_symlist[ofl->ofl_entercnt++] = *hep;
 
 	/*
 	 * Record the section index.  This is possible because the
@@ -1283,8 +1416,8 @@ ensure_array_local(Ofl_desc *ofl, APlist *apl, const char *str)
 uintptr_t
 ld_sym_validate(Ofl_desc *ofl)
 {
-	Sym_avlnode	*sav;
 	Sym_desc	*sdp;
+	Word		sndx;
 	Sym		*sym;
 	ofl_flag_t	oflags = ofl->ofl_flags;
 	ofl_flag_t	undef = 0, needed = 0, verdesc = 0;
@@ -1391,13 +1524,13 @@ ld_sym_validate(Ofl_desc *ofl)
 	/*
 	 * Collect and validate the globals from the internal symbol table.
 	 */
-	for (sav = avl_first(&ofl->ofl_symavl); sav;
-	    sav = AVL_NEXT(&ofl->ofl_symavl, sav)) {
+	ld_sym_sort(ofl);
+	for (sndx = 0; sndx < ofl->ofl_entercnt; sndx++) {
 		Is_desc		*isp;
 		int		undeferr = 0;
 		uchar_t		vis;
 
-		sdp = sav->sav_sdp;
+		sdp = ofl->ofl_symlist[sndx].she_sdp;
 
 		/*
 		 * If undefined symbols are allowed, and we're not being
@@ -2022,6 +2155,89 @@ typedef struct {
 	Word		c_ndx;		/* symbol index */
 } Cap_pair;
 
+/*
+ * Hashing the names of the global symbols of a large input file is spread
+ * across the -z threads worker threads, in chunks of SYM_PARHASH_CHUNK
+ * symbols.  The symbol table is then processed serially using the
+ * precomputed hash values, so symbol resolution order is unchanged.
+ */
+#define	SYM_PARHASH_MIN		4096
+#define	SYM_PARHASH_CHUNK	1024
+
+typedef struct {
+	Sym		*shw_syms;	/* first global symbol */
+	const char	*shw_strs;	/* associated string table */
+	size_t		shw_strsize;	/*	and its size */
+	Word		*shw_hashes;	/* hash value per global symbol */
+	Word		shw_cnt;	/* no. of global symbols */
+} Symhash_work;
+
+static uintptr_t
+sym_hash_work(void *arg, size_t chunk)
+{
+	Symhash_work	*shwp = arg;
+	Word		ndx, end;
+
+	ndx = (Word)(chunk * SYM_PARHASH_CHUNK);
+	if ((end = ndx + SYM_PARHASH_CHUNK) > shwp->shw_cnt)
+		end = shwp->shw_cnt;
+
+	for (; ndx < end; ndx++) {
+		Word	name = shwp->shw_syms[ndx].st_name;
+
+		/*
+		 * Invalid names are diagnosed by ld_sym_process(), which
+		 * never uses the hash value of such a symbol.
+		 */
+		if (name < shwp->shw_strsize) {
+			/* LINTED */
+			shwp->shw_hashes[ndx] =
+			    (Word)elf_hash(shwp->shw_strs + name);
+		}
+	}
+	return (1);
+}
+
+/*
+ * Compute the hash values of the names of the global symbols of a symbol
+ * table in parallel.  Returns the hash value buffer, indexed from the first
+ * global symbol, or NULL if the names should be hashed as they are processed.
+ */
+static Word *
+sym_hash_globals(Ofl_desc *ofl, Sym *syms, Word cnt, const char *strs,
+    size_t strsize)
+{
+	Symhash_work	shw;
+
+	if (!OFL_PARALLEL(ofl) || (cnt < SYM_PARHASH_MIN) || (strsize == 0))
+		return (NULL);
+
+	/*
+	 * The buffer is retained for the next input file.
+	 */
+	if (cnt > ofl->ofl_symhashcnt) {
+		Word	*hashes;
+
+		if ((hashes = libld_malloc(cnt * sizeof (Word))) == NULL)
+			return (NULL);
+		ofl->ofl_symhash = hashes;
+		ofl->ofl_symhashcnt = cnt;
+	}
+
+	shw.shw_syms = syms;
+	shw.shw_strs = strs;
+	shw.shw_strsize = strsize;
+	shw.shw_hashes = ofl->ofl_symhash;
+	shw.shw_cnt = cnt;
+
+	if (ld_par_run(ofl->ofl_threads,
+	    (cnt + SYM_PARHASH_CHUNK - 1) / SYM_PARHASH_CHUNK,
+	    sym_hash_work, &shw) != 1)
+		return (NULL);
+
+	return (ofl->ofl_symhash);
+}
+
 /*
  * Process the symbol table for the specified input file.  At this point all
  * input sections from this input file have been assigned an input section
@@ -2085,6 +2301,7 @@ ld_sym_process(Is_desc *isc, Ifl_desc *ifl, Ofl_desc *ofl)
 	int		test_gnu_hidden_bit, weak;
 	Cap_desc	*cdp = NULL;
 	Alist		*cappairs = NULL;
+	Word		*hashes;
 
 	/*
 	 * Its possible that a file may contain more that one symbol table,
@@ -2496,11 +2713,17 @@ ld_sym_process(Is_desc *isc, Ifl_desc *ifl, Ofl_desc *ofl)
 
 	/*
 	 * Now scan the global symbols entering them in the internal symbol
-	 * table or resolving them as necessary.
+	 * table or resolving them as necessary.  Size the internal symbol
+	 * table so that it can take all of these symbols without growing.
 	 */
+	if ((total > local) && (ld_sym_reserve(ofl, total - local) == S_ERROR))
+		return (S_ERROR);
+
 	sym = (Sym *)isc->is_indata->d_buf;
 	sym += local;
 	weak = 0;
+	hashes = (total > local) ? sym_hash_globals(ofl, sym, total - local,
+	    strs, strsize) : NULL;
 	/* LINTED */
 	for (ndx = (int)local; ndx < total; sym++, ndx++) {
 		const char	*name;
@@ -2698,8 +2921,12 @@ ld_sym_process(Is_desc *isc, Ifl_desc *ifl, Ofl_desc *ofl)
 		 *	This symbol is associated to the same location, and
 		 *	becomes a capabilities family member.
 		 */
-		/* LINTED */
-		hash = (Word)elf_hash(name);
+		if ((hashes != NULL) && (name == (strs + nsym->st_name))) {
+			hash = hashes[ndx - local];
+		} else {
+			/* LINTED */
+			hash = (Word)elf_hash(name);
+		}
 
 		ntype = ELF_ST_TYPE(nsym->st_info);
 		if (cdp && (nsym->st_shndx != SHN_UNDEF) &&
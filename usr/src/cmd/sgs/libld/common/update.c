@@ -44,6 +44,8 @@
 /*
  * Comparison routine used by qsort() for sorting of the global symbol list
  * based off of the hashbuckets the symbol will eventually be deposited in.
+ * When a .gnu.hash section is created these are the GNU hash buckets, as
+ * that table requires the symbols of each bucket to be contiguous.
  */
 static int
 sym_hash_compare(Sym_s_list * s1, Sym_s_list * s2)
@@ -129,6 +131,60 @@ dynsort_dupwarn(Ofl_desc *ofl, Sym *ldynsym, const char *str,
 	}
 }
 
+/*
+ * Fill in the .gnu.hash section from the sorted global symbol list.  The
+ * globals are the last ofl_globcnt entries of the .dynsym, in the order of
+ * this list, so a bucket references its first symbol and the chain entry of
+ * the last symbol of each bucket has its low bit set.
+ */
+static void
+update_ognuhash(Ofl_desc *ofl, Sym_s_list *ssp)
+{
+	Word	*hdr = (Word *)ofl->ofl_osgnuhash->os_outdata->d_buf;
+	Word	nbkts = ofl->ofl_hashbkts, nbloom = ofl->ofl_gnubloom;
+	Word	shift = ofl->ofl_gnushift, symoff = DYNSYM_LOC_CNT(ofl);
+	Addr	*bloom = (Addr *)&hdr[4];
+	Word	*bkts = (Word *)&bloom[nbloom];
+	Word	*chain = &bkts[nbkts];
+	Word	ndx;
+
+	hdr[0] = nbkts;
+	hdr[1] = symoff;
+	hdr[2] = nbloom;
+	hdr[3] = shift;
+
+	for (ndx = 0; ndx < ofl->ofl_globcnt; ndx++) {
+		Word	hval = ssp[ndx].sl_gnuhval;
+		Word	bkt = ssp[ndx].sl_hval;
+
+		assert(ssp[ndx].sl_sdp->sd_symndx == (symoff + ndx));
+
+		bloom[(hval / GNUHASH_BLOOMBITS) & (nbloom - 1)] |=
+		    ((Addr)1 << (hval % GNUHASH_BLOOMBITS)) |
+		    ((Addr)1 << ((hval >> shift) % GNUHASH_BLOOMBITS));
+
+		if (bkts[bkt] == 0)
+			bkts[bkt] = symoff + ndx;
+
+		chain[ndx] = hval & ~1;
+		if (((ndx + 1) == ofl->ofl_globcnt) ||
+		    (ssp[ndx + 1].sl_hval != bkt))
+			chain[ndx] |= 1;
+	}
+
+#if	defined(_ELF64)
+	/*
+	 * The section is translated as an array of words.  Should the output
+	 * byte order differ from ours, swap the halves of each bloom word so
+	 * that the translation produces the correctly ordered 64-bit value.
+	 */
+	if (ofl->ofl_flags1 & FLG_OF1_ENCDIFF) {
+		for (ndx = 0; ndx < nbloom; ndx++)
+			bloom[ndx] = (bloom[ndx] << 32) | (bloom[ndx] >> 32);
+	}
+#endif
+}
+
 static inline Boolean
 ass_enabled(Ass_desc *ma, uint_t ass)
 {
@@ -176,7 +232,7 @@ update_osym(Ofl_desc *ofl)
 	}
 
 	Sym_desc	*sdp;
-	Sym_avlnode	*sav;
+	Word		sndx;
 	Sg_desc		*sgp, *tsgp = NULL, *dsgp = NULL, *esgp = NULL;
 	Os_desc		*osp, *iosp = NULL, *fosp = NULL;
 	Is_desc		*isc;
@@ -996,13 +1052,13 @@ update_osym(Ofl_desc *ofl)
 	 * Traverse the internal symbol table updating global symbol information
 	 * and allocating common.
 	 */
-	for (sav = avl_first(&ofl->ofl_symavl); sav;
-	    sav = AVL_NEXT(&ofl->ofl_symavl, sav)) {
+	ld_sym_sort(ofl);
+	for (sndx = 0; sndx < ofl->ofl_entercnt; sndx++) {
 		Sym	*symptr;
 		int	local;
 		int	restore;
 
-		sdp = sav->sav_sdp;
+		sdp = ofl->ofl_symlist[sndx].she_sdp;
 
 		/*
 		 * Ignore any symbols that have been marked as invalid during
@@ -1028,6 +1084,13 @@ update_osym(Ofl_desc *ofl)
 
 		if (local || (ofl->ofl_hashbkts == 0)) {
 			sorted_syms[scndx++].sl_sdp = sdp;
+		} else if (ofl->ofl_osgnuhash) {
+			Word	hval = sgs_gnu_hash(sdp->sd_name);
+
+			sorted_syms[ssndx].sl_gnuhval = hval;
+			sorted_syms[ssndx].sl_hval = hval % ofl->ofl_hashbkts;
+			sorted_syms[ssndx].sl_sdp = sdp;
+			ssndx++;
 		} else {
 			sorted_syms[ssndx].sl_hval = sdp->sd_aux->sa_hash %
 			    ofl->ofl_hashbkts;
@@ -2033,6 +2096,13 @@ update_osym(Ofl_desc *ofl)
 		ofl->ofl_oshash->os_shdr->sh_link =
 		    /* LINTED */
 		    (Word)elf_ndxscn(ofl->ofl_osdynsym->os_scn);
+		if (ofl->ofl_osgnuhash) {
+			update_ognuhash(ofl, sorted_syms +
+			    ofl->ofl_scopecnt + ofl->ofl_elimcnt);
+			ofl->ofl_osgnuhash->os_shdr->sh_link =
+			    /* LINTED */
+			    (Word)elf_ndxscn(ofl->ofl_osdynsym->os_scn);
+		}
 		if (dynshndx) {
 			shdr = ofl->ofl_osdynshndx->os_shdr;
 			shdr->sh_link =
@@ -2290,6 +2360,12 @@ update_odynamic(Ofl_desc *ofl)
 		dyn->d_un.d_ptr = ofl->ofl_oshash->os_shdr->sh_addr;
 		dyn++;
 
+		if (ofl->ofl_osgnuhash) {
+			dyn->d_tag = DT_GNU_HASH;
+			dyn->d_un.d_ptr = ofl->ofl_osgnuhash->os_shdr->sh_addr;
+			dyn++;
+		}
+
 		shdr = strosp->os_shdr;
 		dyn->d_tag = DT_STRTAB;
 		dyn->d_un.d_ptr = shdr->sh_addr;
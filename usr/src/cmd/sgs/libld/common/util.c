@@ -43,6 +43,8 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <errno.h>
+#include <pthread.h>
+#include <atomic.h>
 #include <sgs.h>
 #include <libintl.h>
 #include <debug.h>
@@ -106,10 +108,13 @@ dz_map(size_t size)
 void *
 libld_malloc(size_t size)
 {
-	Ld_heap		*chp = ld_heap;
+	Ld_heap		*chp;
 	void		*vptr;
 	size_t		asize = size + HEAPALIGN;
 
+	ld_par_lock();
+	chp = ld_heap;
+
 	/*
 	 * If this is the first allocation, or the allocation request is greater
 	 * than the current free space available, allocate a new heap.
@@ -126,8 +131,10 @@ libld_malloc(size_t size)
 		if (tsize < HEAPBLOCK)
 			tsize = HEAPBLOCK;
 
-		if ((nhp = dz_map(tsize)) == MAP_FAILED)
+		if ((nhp = dz_map(tsize)) == MAP_FAILED) {
+			ld_par_unlock();
 			return (NULL);
+		}
 
 		nhp->lh_next = chp;
 		nhp->lh_free = (void *)((size_t)nhp + hsize);
@@ -150,6 +157,7 @@ libld_malloc(size_t size)
 	chp->lh_free = (void *)S_ROUND((size_t)chp->lh_free + asize,
 	    HEAPALIGN);
 
+	ld_par_unlock();
 	return (vptr);
 }
 
@@ -186,6 +194,123 @@ libld_free(void *ptr)
 {
 }
 
+/*
+ * Parallel processing (-z threads).
+ *
+ * The link-edit is single threaded, and most of its data structures have no
+ * locking.  However, a few passes consist of units of work that are
+ * independent of each other, and whose results don't depend on the order
+ * in which the work is carried out.  ld_par_run() spreads such work over a
+ * number of threads.  While these threads are running, the few shared
+ * facilities a unit of work may use (memory allocation and the issuing of
+ * diagnostics) are serialized with ld_par_lock() and ld_par_unlock().
+ * Outside of ld_par_run() these are no-ops.
+ */
+typedef struct {
+	uintptr_t	(*pw_func)(void *, size_t);
+	void		*pw_arg;
+	size_t		pw_nitems;	/* number of units of work */
+	ulong_t		pw_next;	/* next unit to be claimed */
+	uintptr_t	pw_ret;		/* combined return value */
+} Par_work;
+
+static pthread_mutex_t	par_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int		par_active = 0;
+
+void
+ld_par_lock(void)
+{
+	if (par_active)
+		(void) pthread_mutex_lock(&par_mutex);
+}
+
+void
+ld_par_unlock(void)
+{
+	if (par_active)
+		(void) pthread_mutex_unlock(&par_mutex);
+}
+
+/*
+ * Claim and process units of work until there are none left, or until a
+ * unit of work has failed with S_ERROR.
+ */
+static void *
+par_worker(void *arg)
+{
+	Par_work	*pw = arg;
+	size_t		ndx;
+	uintptr_t	ret;
+
+	while ((ndx = (size_t)(atomic_inc_ulong_nv(&pw->pw_next) - 1)) <
+	    pw->pw_nitems) {
+		if ((ret = (*pw->pw_func)(pw->pw_arg, ndx)) == 1)
+			continue;
+
+		ld_par_lock();
+		if (pw->pw_ret != S_ERROR)
+			pw->pw_ret = ret;
+		ld_par_unlock();
+
+		if (ret == S_ERROR) {
+			(void) atomic_swap_ulong(&pw->pw_next, pw->pw_nitems);
+			break;
+		}
+	}
+	return (NULL);
+}
+
+/*
+ * Call func(arg, ndx) for each ndx in the range [0, nitems), using up to
+ * nthreads threads, the calling thread included.  The function returns 1
+ * on success, 0 on an error that shouldn't stop further units of work from
+ * being processed, or S_ERROR on an error that should.
+ *
+ * Returns 1 if every unit of work succeeded, otherwise S_ERROR if any unit
+ * of work returned S_ERROR, or 0.  If nthreads is 1 (or threads can't be
+ * created) the units of work are processed by the calling thread, in order.
+ */
+uintptr_t
+ld_par_run(int nthreads, size_t nitems, uintptr_t (*func)(void *, size_t),
+    void *arg)
+{
+	Par_work	pw;
+	pthread_t	tids[LD_PAR_MAXTHREADS];
+	int		ndx, ntids = 0;
+
+	pw.pw_func = func;
+	pw.pw_arg = arg;
+	pw.pw_nitems = nitems;
+	pw.pw_next = 0;
+	pw.pw_ret = 1;
+
+	if (nthreads > LD_PAR_MAXTHREADS)
+		nthreads = LD_PAR_MAXTHREADS;
+	if ((size_t)nthreads > nitems)
+		nthreads = (int)nitems;
+
+	if (nthreads > 1)
+		par_active = 1;
+
+	/*
+	 * Failure to create a thread isn't fatal, the work is simply shared
+	 * between the threads that do exist.
+	 */
+	for (ndx = 1; ndx < nthreads; ndx++) {
+		if (pthread_create(&tids[ntids], NULL, par_worker, &pw) != 0)
+			break;
+		ntids++;
+	}
+
+	(void) par_worker(&pw);
+
+	for (ndx = 0; ndx < ntids; ndx++)
+		(void) pthread_join(tids[ndx], NULL);
+
+	par_active = 0;
+	return (pw.pw_ret);
+}
+
 /*
  * Determine if a shared object definition structure already exists and if
  * not create one.  These definitions provide for recording information
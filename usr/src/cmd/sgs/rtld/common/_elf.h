@@ -96,6 +96,7 @@ typedef struct _rt_elf_private {
 	void		*e_symtab;	/* symbol table */
 	void		*e_sunwsymtab;	/* symtab augmented with local fcns */
 	uint_t		*e_hash;	/* hash table */
+	uint_t		*e_gnuhash;	/* GNU hash table */
 	char		*e_strtab;	/* string table */
 	void		*e_reloc;	/* relocation table */
 	uint_t		*e_pltgot;	/* addrs for procedure linkage table */
@@ -135,6 +136,7 @@ typedef struct _rt_elf_private {
 #define	SYMTAB(X)		(((Rt_elfp *)(X)->rt_priv)->e_symtab)
 #define	SUNWSYMTAB(X)		(((Rt_elfp *)(X)->rt_priv)->e_sunwsymtab)
 #define	HASH(X)			(((Rt_elfp *)(X)->rt_priv)->e_hash)
+#define	GNUHASH(X)		(((Rt_elfp *)(X)->rt_priv)->e_gnuhash)
 #define	STRTAB(X)		(((Rt_elfp *)(X)->rt_priv)->e_strtab)
 #define	REL(X)			(((Rt_elfp *)(X)->rt_priv)->e_reloc)
 #define	PLTGOT(X)		(((Rt_elfp *)(X)->rt_priv)->e_pltgot)
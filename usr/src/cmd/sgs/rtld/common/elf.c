@@ -1322,6 +1322,7 @@ elf_find_sym(Slookup *slp, Sresult *srp, uint_t *binfo, int *in_nfavl)
 	Rt_map		*ilmp = slp->sl_imap;
 	ulong_t		hash = slp->sl_hash;
 	uint_t		ndx, hashoff, buckets, *chainptr;
+	uint_t		gnuhash = 0, *gnuchain = NULL;
 	Sym		*sym, *symtabptr;
 	char		*strtabptr, *strtabname;
 	uint_t		flags1;
@@ -1334,21 +1335,71 @@ elf_find_sym(Slookup *slp, Sresult *srp, uint_t *binfo, int *in_nfavl)
 	if ((slp->sl_flags & LKUP_SYMNDX) == 0)
 		DBG_CALL(Dbg_syms_lookup(ilmp, name, MSG_ORIG(MSG_STR_ELF)));
 
-	if (HASH(ilmp) == NULL)
-		return (0);
+	/*
+	 * The GNU ld leaves undefined symbols out of its .gnu.hash tables,
+	 * so a lookup to establish a symbol's index, which may be that of a
+	 * reference, uses the SysV hash table if the object has one.
+	 */
+	if ((GNUHASH(ilmp) != NULL) &&
+	    (((slp->sl_flags & LKUP_SYMNDX) == 0) || (HASH(ilmp) == NULL))) {
+		uint_t	*gnuhashtab = GNUHASH(ilmp);
+		uint_t	symoff, nbloom, shift;
+		Addr	*bloom, bword;
 
-	buckets = HASH(ilmp)[0];
-	/* LINTED */
-	hashoff = ((uint_t)hash % buckets) + 2;
+		/*
+		 * The GNU hash table consists of a header, giving the number
+		 * of buckets, the index of the first hashed symbol, and the
+		 * size and shift of a bloom filter, followed by the Addr sized
+		 * bloom filter words, the buckets and the chain.  The bloom
+		 * filter rejects most of the symbols this object doesn't
+		 * define without any further memory references.  See
+		 * make_gnuhash() in libld.
+		 */
+		if ((gnuhash = slp->sl_gnuhash) == 0)
+			gnuhash = slp->sl_gnuhash = sgs_gnu_hash(name);
+
+		buckets = gnuhashtab[0];
+		symoff = gnuhashtab[1];
+		nbloom = gnuhashtab[2];
+		shift = gnuhashtab[3];
+		bloom = (Addr *)&gnuhashtab[4];
+
+		bword = bloom[(gnuhash / (sizeof (Addr) * 8)) & (nbloom - 1)];
+		if (((bword >> (gnuhash % (sizeof (Addr) * 8))) &
+		    (bword >> ((gnuhash >> shift) % (sizeof (Addr) * 8))) &
+		    1) == 0)
+			return (0);
+
+		/*
+		 * Get the first symbol from the hash bucket.  The chain holds
+		 * the hash value of each symbol, with the low bit set for the
+		 * last symbol of the bucket.
+		 */
+		if ((ndx = ((uint_t *)&bloom[nbloom])[gnuhash % buckets]) == 0)
+			return (0);
+
+		gnuchain = (uint_t *)&bloom[nbloom] + buckets - symoff;
+		chainptr = NULL;
+	} else {
+		if (HASH(ilmp) == NULL)
+			return (0);
+
+		buckets = HASH(ilmp)[0];
+		/* LINTED */
+		hashoff = ((uint_t)hash % buckets) + 2;
+
+		/*
+		 * Get the first symbol from the hash chain.
+		 */
+		if ((ndx = HASH(ilmp)[hashoff]) == 0)
+			return (0);
+
+		chainptr = HASH(ilmp) + 2 + buckets;
+	}
 
 	/*
-	 * Get the first symbol from the hash chain and initialize the string
-	 * and symbol table pointers.
+	 * Initialize the string and symbol table pointers.
 	 */
-	if ((ndx = HASH(ilmp)[hashoff]) == 0)
-		return (0);
-
-	chainptr = HASH(ilmp) + 2 + buckets;
 	strtabptr = STRTAB(ilmp);
 	symtabptr = SYMTAB(ilmp);
 
@@ -1358,10 +1409,17 @@ elf_find_sym(Slookup *slp, Sresult *srp, uint_t *binfo, int *in_nfavl)
 
 		/*
 		 * Compare the symbol found with the name required.  If the
-		 * names don't match continue with the next hash entry.
+		 * names don't match continue with the next hash entry.  A
+		 * GNU hash chain provides the full hash value of each symbol,
+		 * which avoids most of the string comparisons.
 		 */
-		if ((*strtabname++ != *name) || strcmp(strtabname, &name[1])) {
-			hashoff = ndx + buckets + 2;
+		if ((gnuchain && ((gnuchain[ndx] ^ gnuhash) & ~1)) ||
+		    (*strtabname++ != *name) || strcmp(strtabname, &name[1])) {
+			if (gnuchain) {
+				if (gnuchain[ndx++] & 1)
+					return (0);
+				continue;
+			}
 			if ((ndx = chainptr[ndx]) != 0)
 				continue;
 			return (0);
@@ -1836,6 +1894,10 @@ elf_new_lmp(Lm_list *lml, Aliste lmco, Fdesc *fdp, Addr addr, size_t msize,
 			case DT_HASH:
 				HASH(lmp) = (uint_t *)(dyn->d_un.d_ptr + base);
 				break;
+			case DT_GNU_HASH:
+				GNUHASH(lmp) =
+				    (uint_t *)(dyn->d_un.d_ptr + base);
+				break;
 			case DT_PLTGOT:
 				PLTGOT(lmp) =
 				    (uint_t *)(dyn->d_un.d_ptr + base);
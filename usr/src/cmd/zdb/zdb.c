@@ -63,6 +63,7 @@
 #include <sys/arc.h>
 #include <sys/arc_impl.h>
 #include <sys/ddt.h>
+#include <sys/brt.h>
 #include <sys/zfeature.h>
 #include <sys/abd.h>
 #include <sys/blkptr.h>
@@ -107,6 +108,7 @@ typedef void object_viewer_t(objset_t *, uint64_t, void *data, size_t size);
 uint64_t *zopt_object = NULL;
 static unsigned zopt_objects = 0;
 uint64_t max_inflight = 1000;
+static int zdb_traverse_threads = 1;
 static int leaked_objects = 0;
 
 static void snprintf_blkptr_compact(char *, size_t, const blkptr_t *);
@@ -134,7 +136,8 @@ usage(void)
 	(void) fprintf(stderr,
 	    "Usage:\t%s [-AbcdDFGhikLMPsvX] [-e [-V] [-p <path> ...]] "
 	    "[-I <inflight I/Os>]\n"
-	    "\t\t[-o <var>=<value>]... [-t <txg>] [-U <cache>] [-x <dumpdir>]\n"
+	    "\t\t[-j <threads>] [-o <var>=<value>]... [-t <txg>] [-U <cache>]\n"
+	    "\t\t[-x <dumpdir>]\n"
 	    "\t\t[<poolname> [<object> ...]]\n"
 	    "\t%s [-AdiPv] [-e [-V] [-p <path> ...]] [-U <cache>] <dataset> "
 	    "[<object> ...]\n"
@@ -195,6 +198,8 @@ usage(void)
 	(void) fprintf(stderr, "        -I <number of inflight I/Os> -- "
 	    "specify the maximum number of "
 	    "checksumming I/Os [default is 200]\n");
+	(void) fprintf(stderr, "        -j <threads> -- traverse the pool "
+	    "with several threads for -b and -c\n");
 	(void) fprintf(stderr, "        -o <variable>=<value> set global "
 	    "variable to an unsigned 32-bit integer value\n");
 	(void) fprintf(stderr, "        -p <path> -- use one or more with "
@@ -1264,6 +1269,25 @@ dump_ddt(ddt_t *ddt, enum ddt_type type, enum ddt_class class)
 	(void) printf("\n");
 }
 
+static void
+dump_ddt_log(ddt_t *ddt)
+{
+	ddt_log_t *active = ddt->ddt_log_active;
+	ddt_log_t *flushing = ddt->ddt_log_flushing;
+
+	if (active == NULL)
+		return;
+
+	(void) printf("DDT-log-%s: active %llu entries, %llu bytes, "
+	    "since txg %llu; flushing %llu entries, %llu bytes\n",
+	    zio_checksum_table[ddt->ddt_checksum].ci_name,
+	    (u_longlong_t)avl_numnodes(&active->ddl_tree),
+	    (u_longlong_t)active->ddl_length,
+	    (u_longlong_t)active->ddl_first_txg,
+	    (u_longlong_t)avl_numnodes(&flushing->ddl_tree),
+	    (u_longlong_t)flushing->ddl_length);
+}
+
 static void
 dump_all_ddts(spa_t *spa)
 {
@@ -1281,6 +1305,7 @@ dump_all_ddts(spa_t *spa)
 				dump_ddt(ddt, type, class);
 			}
 		}
+		dump_ddt_log(ddt);
 	}
 
 	ddt_get_dedup_stats(spa, &dds_total);
@@ -3445,6 +3470,11 @@ typedef struct zdb_cb {
 	uint64_t	zcb_checkpoint_size;
 	uint64_t	zcb_dedup_asize;
 	uint64_t	zcb_dedup_blocks;
+	uint64_t	zcb_clone_asize;
+	uint64_t	zcb_clone_blocks;
+	boolean_t	zcb_brt_is_active;
+	avl_tree_t	zcb_brt;
+	kmutex_t	zcb_brt_lock;
 	uint64_t	zcb_embedded_blocks[NUM_BP_EMBEDDED_TYPES];
 	uint64_t	zcb_embedded_histogram[NUM_BP_EMBEDDED_TYPES]
 	    [BPE_PAYLOAD_SIZE];
@@ -3456,8 +3486,34 @@ typedef struct zdb_cb {
 	int		zcb_haderrors;
 	spa_t		*zcb_spa;
 	uint32_t	**zcb_vd_obsolete_counts;
+	struct zdb_cb	*zcb_main;	/* set for parallel traversal workers */
 } zdb_cb_t;
 
+/*
+ * A block with BRT references is claimed when it is first seen; the entry
+ * then counts down the remaining references so that the block is not
+ * claimed again.
+ */
+typedef struct zdb_brt_entry {
+	dva_t		zbre_dva;
+	uint64_t	zbre_refcount;
+	avl_node_t	zbre_node;
+} zdb_brt_entry_t;
+
+static int
+zdb_brt_entry_compare(const void *zcn1, const void *zcn2)
+{
+	const dva_t *dva1 = &((const zdb_brt_entry_t *)zcn1)->zbre_dva;
+	const dva_t *dva2 = &((const zdb_brt_entry_t *)zcn2)->zbre_dva;
+	int cmp;
+
+	cmp = TREE_CMP(DVA_GET_VDEV(dva1), DVA_GET_VDEV(dva2));
+	if (cmp == 0)
+		cmp = TREE_CMP(DVA_GET_OFFSET(dva1), DVA_GET_OFFSET(dva2));
+
+	return (cmp);
+}
+
 /* test if two DVA offsets from same vdev are within the same metaslab */
 static boolean_t
 same_metaslab(spa_t *spa, uint64_t vdev, uint64_t off1, uint64_t off2)
@@ -3473,6 +3529,7 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
     dmu_object_type_t type)
 {
 	uint64_t refcnt = 0;
+	ddt_t *ddt = NULL;
 
 	ASSERT(type < ZDB_OT_TOTAL);
 
@@ -3565,9 +3622,14 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 		return;
 
 	if (BP_GET_DEDUP(bp)) {
-		ddt_t *ddt;
 		ddt_entry_t *dde;
 
+		/*
+		 * The DDT stays locked until the block has been claimed: the
+		 * claim of the last reference removes the block from the
+		 * space map, so with a parallel traversal it must not overtake
+		 * the dry-run claim of an earlier reference.
+		 */
 		ddt = ddt_select(zcb->zcb_spa, bp);
 		ddt_enter(ddt);
 		dde = ddt_lookup(ddt, bp, B_FALSE);
@@ -3581,12 +3643,45 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 			if (ddt_phys_total_refcnt(dde) == 0)
 				ddt_remove(ddt, dde);
 		}
-		ddt_exit(ddt);
+	} else if (zcb->zcb_brt_is_active &&
+	    brt_maybe_exists(zcb->zcb_spa, bp)) {
+		zdb_cb_t *bzcb = (zcb->zcb_main != NULL) ? zcb->zcb_main : zcb;
+		zdb_brt_entry_t zbre_search, *zbre;
+		avl_index_t where;
+
+		zbre_search.zbre_dva = bp->blk_dva[0];
+		mutex_enter(&bzcb->zcb_brt_lock);
+		zbre = avl_find(&bzcb->zcb_brt, &zbre_search, &where);
+		if (zbre != NULL) {
+			/*
+			 * Already claimed through an earlier reference.
+			 */
+			zcb->zcb_clone_asize += BP_GET_ASIZE(bp);
+			zcb->zcb_clone_blocks++;
+			if (--zbre->zbre_refcount == 0) {
+				avl_remove(&bzcb->zcb_brt, zbre);
+				umem_free(zbre, sizeof (*zbre));
+			}
+			mutex_exit(&bzcb->zcb_brt_lock);
+			return;
+		}
+
+		uint64_t brtcnt = brt_entry_get_refcount(zcb->zcb_spa, bp);
+		if (brtcnt != 0) {
+			zbre = umem_zalloc(sizeof (*zbre), UMEM_NOFAIL);
+			zbre->zbre_dva = bp->blk_dva[0];
+			zbre->zbre_refcount = brtcnt;
+			avl_insert(&bzcb->zcb_brt, zbre, where);
+		}
+		mutex_exit(&bzcb->zcb_brt_lock);
 	}
 
 	VERIFY3U(zio_wait(zio_claim(NULL, zcb->zcb_spa,
 	    refcnt ? 0 : spa_min_claim_txg(zcb->zcb_spa),
 	    bp, NULL, NULL, ZIO_FLAG_CANFAIL)), ==, 0);
+
+	if (ddt != NULL)
+		ddt_exit(ddt);
 }
 
 static void
@@ -3628,6 +3723,31 @@ zdb_blkptr_done(zio_t *zio)
 	mutex_exit(&spa->spa_scrub_lock);
 }
 
+static void
+zdb_print_progress(zdb_cb_t *zcb, uint64_t bytes)
+{
+	uint64_t now = gethrtime();
+	char buf[10];
+	int kb_per_sec =
+	    1 + bytes / (1 + ((now - zcb->zcb_start) / 1000 / 1000));
+	int sec_remaining =
+	    (zcb->zcb_totalasize - bytes) / 1024 / kb_per_sec;
+
+	/* make sure nicenum has enough space */
+	CTASSERT(sizeof (buf) >= NN_NUMBUF_SZ);
+
+	zfs_nicenum(bytes, buf, sizeof (buf));
+	(void) fprintf(stderr,
+	    "\r%5s completed (%4dMB/s) "
+	    "estimated time remaining: %uhr %02umin %02usec        ",
+	    buf, kb_per_sec / 1024,
+	    sec_remaining / 60 / 60,
+	    sec_remaining / 60 % 60,
+	    sec_remaining % 60);
+
+	zcb->zcb_lastprint = now;
+}
+
 static int
 zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
@@ -3683,6 +3803,10 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	zcb->zcb_readfails = 0;
 
+	/* the progress of a parallel traversal is reported by its caller */
+	if (zcb->zcb_main != NULL)
+		return (0);
+
 	/* only call gethrtime() every 100 blocks */
 	static int iters;
 	if (++iters > 100)
@@ -3691,27 +3815,8 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 		return (0);
 
 	if (dump_opt['b'] < 5 && gethrtime() > zcb->zcb_lastprint + NANOSEC) {
-		uint64_t now = gethrtime();
-		char buf[10];
-		uint64_t bytes = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
-		int kb_per_sec =
-		    1 + bytes / (1 + ((now - zcb->zcb_start) / 1000 / 1000));
-		int sec_remaining =
-		    (zcb->zcb_totalasize - bytes) / 1024 / kb_per_sec;
-
-		/* make sure nicenum has enough space */
-		CTASSERT(sizeof (buf) >= NN_NUMBUF_SZ);
-
-		zfs_nicenum(bytes, buf, sizeof (buf));
-		(void) fprintf(stderr,
-		    "\r%5s completed (%4dMB/s) "
-		    "estimated time remaining: %uhr %02umin %02usec        ",
-		    buf, kb_per_sec / 1024,
-		    sec_remaining / 60 / 60,
-		    sec_remaining / 60 % 60,
-		    sec_remaining % 60);
-
-		zcb->zcb_lastprint = now;
+		zdb_print_progress(zcb,
+		    zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize);
 	}
 
 	return (0);
@@ -3809,6 +3914,33 @@ load_unflushed_svr_segs_cb(spa_t *spa, space_map_entry_t *sme,
 	return (0);
 }
 
+static void
+zdb_ddt_leak_init_entry(spa_t *spa, zdb_cb_t *zcb, enum zio_checksum checksum,
+    ddt_entry_t *dde)
+{
+	ddt_t *ddt = spa->spa_ddt[checksum];
+	ddt_phys_t *ddp = dde->dde_phys;
+	blkptr_t blk;
+
+	ASSERT(ddt_phys_total_refcnt(dde) > 1);
+
+	for (int p = 0; p < DDT_PHYS_TYPES; p++, ddp++) {
+		if (ddp->ddp_phys_birth == 0)
+			continue;
+		ddt_bp_create(checksum, &dde->dde_key, ddp, &blk);
+		if (p == DDT_PHYS_DITTO) {
+			zdb_count_block(zcb, NULL, &blk, ZDB_OT_DITTO);
+		} else {
+			zcb->zcb_dedup_asize +=
+			    BP_GET_ASIZE(&blk) * (ddp->ddp_refcnt - 1);
+			zcb->zcb_dedup_blocks++;
+		}
+	}
+	ddt_enter(ddt);
+	VERIFY(ddt_lookup(ddt, &blk, B_TRUE) != NULL);
+	ddt_exit(ddt);
+}
+
 static void
 zdb_ddt_leak_init(spa_t *spa, zdb_cb_t *zcb)
 {
@@ -3820,34 +3952,50 @@ zdb_ddt_leak_init(spa_t *spa, zdb_cb_t *zcb)
 
 	bzero(&ddb, sizeof (ddb));
 	while ((error = ddt_walk(spa, &ddb, &dde)) == 0) {
-		blkptr_t blk;
-		ddt_phys_t *ddp = dde.dde_phys;
+		ddt_t *ddt = spa->spa_ddt[ddb.ddb_checksum];
+		boolean_t logged;
 
 		if (ddb.ddb_class == DDT_CLASS_UNIQUE)
-			return;
-
-		ASSERT(ddt_phys_total_refcnt(&dde) > 1);
+			break;
 
-		for (int p = 0; p < DDT_PHYS_TYPES; p++, ddp++) {
-			if (ddp->ddp_phys_birth == 0)
-				continue;
-			ddt_bp_create(ddb.ddb_checksum,
-			    &dde.dde_key, ddp, &blk);
-			if (p == DDT_PHYS_DITTO) {
-				zdb_count_block(zcb, NULL, &blk, ZDB_OT_DITTO);
-			} else {
-				zcb->zcb_dedup_asize +=
-				    BP_GET_ASIZE(&blk) * (ddp->ddp_refcnt - 1);
-				zcb->zcb_dedup_blocks++;
-			}
-		}
-		ddt_t *ddt = spa->spa_ddt[ddb.ddb_checksum];
+		/*
+		 * Entries that are in the dedup log are done below, from
+		 * their logged state.
+		 */
 		ddt_enter(ddt);
-		VERIFY(ddt_lookup(ddt, &blk, B_TRUE) != NULL);
+		logged = (ddt_log_find(ddt, &dde.dde_key) != NULL);
 		ddt_exit(ddt);
+		if (logged)
+			continue;
+
+		zdb_ddt_leak_init_entry(spa, zcb, ddb.ddb_checksum, &dde);
 	}
 
-	ASSERT(error == ENOENT);
+	ASSERT(error == 0 || error == ENOENT);
+
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+
+		if (ddt->ddt_log_active == NULL)
+			continue;
+
+		for (int n = 0; n < 2; n++) {
+			avl_tree_t *t = &ddt->ddt_log[n].ddl_tree;
+
+			for (ddt_log_entry_t *ddle = avl_first(t);
+			    ddle != NULL; ddle = AVL_NEXT(t, ddle)) {
+				bzero(&dde, sizeof (dde));
+				dde.dde_key = ddle->ddle_key;
+				bcopy(ddle->ddle_phys, dde.dde_phys,
+				    sizeof (dde.dde_phys));
+				if (ddle->ddle_phys[DDT_PHYS_DITTO].
+				    ddp_phys_birth == 0 &&
+				    ddt_phys_total_refcnt(&dde) <= 1)
+					continue;
+				zdb_ddt_leak_init_entry(spa, zcb, c, &dde);
+			}
+		}
+	}
 }
 
 /* ARGSUSED */
@@ -4514,6 +4662,318 @@ count_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 	return (0);
 }
 
+static void
+zdb_blkptr_wait(spa_t *spa)
+{
+	for (int i = 0; i < max_ncpus; i++) {
+		(void) zio_wait(spa->spa_async_zio_root[i]);
+		spa->spa_async_zio_root[i] = zio_root(spa, NULL, NULL,
+		    ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE |
+		    ZIO_FLAG_GODFATHER);
+	}
+}
+
+/*
+ * Parallel block traversal (-j).  The pool is divided into work items: the
+ * MOS, and ranges of the objects of each dataset, for which
+ * traverse_dataset_range() visits every block exactly once.  The items are
+ * dealt out to the threads in turn, and a thread that runs out of work
+ * steals from the tail of another thread's list, so that one large dataset
+ * does not leave the others idle.  Each thread counts the blocks it visits
+ * in a zdb_cb_t of its own, which is merged into the caller's once all of
+ * the reads are done; the state they share, the space maps, the DDT and the
+ * BRT entries, is locked where zdb_count_block() uses it.
+ */
+#define	ZDB_TRAVERSE_OBJECTS	(1ULL << 14)	/* objects per work item */
+
+typedef struct zdb_trav_item {
+	uint64_t	zti_dsobj;	/* 0 for the MOS */
+	uint64_t	zti_start;
+	uint64_t	zti_end;
+	list_node_t	zti_node;
+} zdb_trav_item_t;
+
+typedef struct zdb_trav_worker {
+	struct zdb_trav	*ztw_trav;
+	int		ztw_id;
+	kmutex_t	ztw_lock;
+	list_t		ztw_items;
+	zdb_cb_t	*ztw_zcb;
+} zdb_trav_worker_t;
+
+typedef struct zdb_trav {
+	spa_t		*zt_spa;
+	int		zt_flags;
+	int		zt_nworkers;
+	int		zt_next;
+	zdb_trav_worker_t *zt_workers;
+	kmutex_t	zt_lock;
+	kcondvar_t	zt_cv;
+	int		zt_running;
+	int		zt_err;
+} zdb_trav_t;
+
+static void
+zdb_trav_add(zdb_trav_t *zt, uint64_t dsobj, uint64_t start, uint64_t end)
+{
+	zdb_trav_worker_t *ztw = &zt->zt_workers[zt->zt_next++ %
+	    zt->zt_nworkers];
+	zdb_trav_item_t *zti = umem_zalloc(sizeof (*zti), UMEM_NOFAIL);
+
+	zti->zti_dsobj = dsobj;
+	zti->zti_start = start;
+	zti->zti_end = end;
+	list_insert_tail(&ztw->ztw_items, zti);
+}
+
+/*
+ * Divide the pool into work items, visiting the datasets in the same way as
+ * traverse_pool().
+ */
+static int
+zdb_trav_add_items(zdb_trav_t *zt)
+{
+	dsl_pool_t *dp = spa_get_dsl(zt->zt_spa);
+	objset_t *mos = dp->dp_meta_objset;
+	boolean_t hard = (zt->zt_flags & TRAVERSE_HARD);
+	int err = 0;
+
+	zdb_trav_add(zt, 0, 0, DMU_OBJECT_END);
+
+	for (uint64_t obj = 1; err == 0;
+	    err = dmu_object_next(mos, &obj, B_FALSE, 0)) {
+		dmu_object_info_t doi;
+		dsl_dataset_t *ds;
+		uint64_t nobjs, start;
+
+		err = dmu_object_info(mos, obj, &doi);
+		if (err != 0) {
+			if (hard)
+				continue;
+			break;
+		}
+		if (doi.doi_bonus_type != DMU_OT_DSL_DATASET)
+			continue;
+
+		dsl_pool_config_enter(dp, FTAG);
+		err = dsl_dataset_hold_obj(dp, obj, FTAG, &ds);
+		dsl_pool_config_exit(dp, FTAG);
+		if (err != 0) {
+			if (hard)
+				continue;
+			break;
+		}
+
+		/*
+		 * The fill count of the root block is the number of objects
+		 * in use.  The last range is open-ended, since their numbers
+		 * can be sparse.
+		 */
+		nobjs = BP_GET_FILL(&dsl_dataset_phys(ds)->ds_bp);
+		dsl_dataset_rele(ds, FTAG);
+
+		for (start = 0; start + ZDB_TRAVERSE_OBJECTS < nobjs;
+		    start += ZDB_TRAVERSE_OBJECTS) {
+			zdb_trav_add(zt, obj, start,
+			    start + ZDB_TRAVERSE_OBJECTS);
+		}
+		zdb_trav_add(zt, obj, start, DMU_OBJECT_END);
+	}
+	if (err == ESRCH)
+		err = 0;
+	return (err);
+}
+
+static zdb_trav_item_t *
+zdb_trav_next(zdb_trav_worker_t *ztw)
+{
+	zdb_trav_t *zt = ztw->ztw_trav;
+	zdb_trav_item_t *zti;
+
+	mutex_enter(&ztw->ztw_lock);
+	zti = list_remove_head(&ztw->ztw_items);
+	mutex_exit(&ztw->ztw_lock);
+
+	for (int i = 1; zti == NULL && i < zt->zt_nworkers; i++) {
+		zdb_trav_worker_t *victim =
+		    &zt->zt_workers[(ztw->ztw_id + i) % zt->zt_nworkers];
+
+		mutex_enter(&victim->ztw_lock);
+		zti = list_remove_tail(&victim->ztw_items);
+		mutex_exit(&victim->ztw_lock);
+	}
+
+	return (zti);
+}
+
+static void
+zdb_trav_thread(void *arg)
+{
+	zdb_trav_worker_t *ztw = arg;
+	zdb_trav_t *zt = ztw->ztw_trav;
+	dsl_pool_t *dp = spa_get_dsl(zt->zt_spa);
+	zdb_trav_item_t *zti;
+	int err = 0;
+
+	while (err == 0 && zt->zt_err == 0 &&
+	    (zti = zdb_trav_next(ztw)) != NULL) {
+		dsl_dataset_t *ds;
+
+		if (zti->zti_dsobj == 0) {
+			err = traverse_pool_mos(zt->zt_spa, 0, zt->zt_flags,
+			    zdb_blkptr_cb, ztw->ztw_zcb);
+			umem_free(zti, sizeof (*zti));
+			continue;
+		}
+
+		dsl_pool_config_enter(dp, FTAG);
+		err = dsl_dataset_hold_obj(dp, zti->zti_dsobj, FTAG, &ds);
+		dsl_pool_config_exit(dp, FTAG);
+		if (err == 0) {
+			err = traverse_dataset_range(ds,
+			    dsl_dataset_phys(ds)->ds_prev_snap_txg, NULL,
+			    zti->zti_start, zti->zti_end, zt->zt_flags,
+			    zdb_blkptr_cb, ztw->ztw_zcb);
+			dsl_dataset_rele(ds, FTAG);
+		} else if (zt->zt_flags & TRAVERSE_HARD) {
+			err = 0;
+		}
+		umem_free(zti, sizeof (*zti));
+	}
+
+	mutex_enter(&zt->zt_lock);
+	if (zt->zt_err == 0)
+		zt->zt_err = err;
+	zt->zt_running--;
+	cv_broadcast(&zt->zt_cv);
+	mutex_exit(&zt->zt_lock);
+}
+
+static void
+zdb_cb_merge(zdb_cb_t *zcb, const zdb_cb_t *wzcb)
+{
+	for (int l = 0; l <= ZB_TOTAL; l++) {
+		for (int t = 0; t <= ZDB_OT_TOTAL; t++) {
+			zdb_blkstats_t *zb = &zcb->zcb_type[l][t];
+			const zdb_blkstats_t *wzb = &wzcb->zcb_type[l][t];
+
+			zb->zb_asize += wzb->zb_asize;
+			zb->zb_lsize += wzb->zb_lsize;
+			zb->zb_psize += wzb->zb_psize;
+			zb->zb_count += wzb->zb_count;
+			zb->zb_gangs += wzb->zb_gangs;
+			zb->zb_ditto_samevdev += wzb->zb_ditto_samevdev;
+			zb->zb_ditto_same_ms += wzb->zb_ditto_same_ms;
+			for (int i = 0; i < PSIZE_HISTO_SIZE; i++) {
+				zb->zb_psize_histogram[i] +=
+				    wzb->zb_psize_histogram[i];
+			}
+		}
+	}
+
+	zcb->zcb_clone_asize += wzcb->zcb_clone_asize;
+	zcb->zcb_clone_blocks += wzcb->zcb_clone_blocks;
+	for (int i = 0; i < NUM_BP_EMBEDDED_TYPES; i++) {
+		zcb->zcb_embedded_blocks[i] += wzcb->zcb_embedded_blocks[i];
+		for (int j = 0; j < BPE_PAYLOAD_SIZE; j++) {
+			zcb->zcb_embedded_histogram[i][j] +=
+			    wzcb->zcb_embedded_histogram[i][j];
+		}
+	}
+	for (int e = 0; e < 256; e++)
+		zcb->zcb_errors[e] += wzcb->zcb_errors[e];
+	zcb->zcb_haderrors |= wzcb->zcb_haderrors;
+}
+
+static int
+zdb_traverse_parallel(spa_t *spa, int flags, zdb_cb_t *zcb)
+{
+	zdb_trav_t zt;
+	int nworkers = zdb_traverse_threads;
+	int err;
+
+	bzero(&zt, sizeof (zt));
+	zt.zt_spa = spa;
+	zt.zt_flags = flags;
+	zt.zt_nworkers = nworkers;
+	zt.zt_workers = umem_zalloc(nworkers * sizeof (zdb_trav_worker_t),
+	    UMEM_NOFAIL);
+	mutex_init(&zt.zt_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&zt.zt_cv, NULL, CV_DEFAULT, NULL);
+
+	for (int i = 0; i < nworkers; i++) {
+		zdb_trav_worker_t *ztw = &zt.zt_workers[i];
+
+		ztw->ztw_trav = &zt;
+		ztw->ztw_id = i;
+		mutex_init(&ztw->ztw_lock, NULL, MUTEX_DEFAULT, NULL);
+		list_create(&ztw->ztw_items, sizeof (zdb_trav_item_t),
+		    offsetof(zdb_trav_item_t, zti_node));
+		ztw->ztw_zcb = umem_zalloc(sizeof (zdb_cb_t), UMEM_NOFAIL);
+		ztw->ztw_zcb->zcb_spa = spa;
+		ztw->ztw_zcb->zcb_brt_is_active = zcb->zcb_brt_is_active;
+		ztw->ztw_zcb->zcb_main = zcb;
+	}
+
+	err = zdb_trav_add_items(&zt);
+	if (err == 0) {
+		taskq_t *tq = taskq_create("zdb_traverse", nworkers,
+		    minclsyspri, nworkers, nworkers, TASKQ_PREPOPULATE);
+
+		zt.zt_running = nworkers;
+		for (int i = 0; i < nworkers; i++) {
+			VERIFY(taskq_dispatch(tq, zdb_trav_thread,
+			    &zt.zt_workers[i], TQ_SLEEP) != TASKQID_INVALID);
+		}
+
+		mutex_enter(&zt.zt_lock);
+		while (zt.zt_running > 0) {
+			(void) cv_timedwait_hires(&zt.zt_cv, &zt.zt_lock,
+			    SEC2NSEC(1), MSEC2NSEC(1), 0);
+			if (dump_opt['b'] >= 5)
+				continue;
+
+			uint64_t bytes =
+			    zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
+			for (int i = 0; i < nworkers; i++) {
+				bytes += zt.zt_workers[i].ztw_zcb->
+				    zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
+			}
+			zdb_print_progress(zcb, bytes);
+		}
+		err = zt.zt_err;
+		mutex_exit(&zt.zt_lock);
+
+		taskq_destroy(tq);
+	}
+
+	/*
+	 * Read errors are counted in the workers' zdb_cb_t, so the reads
+	 * must be complete before they are merged.
+	 */
+	if (dump_opt['c'])
+		zdb_blkptr_wait(spa);
+
+	for (int i = 0; i < nworkers; i++) {
+		zdb_trav_worker_t *ztw = &zt.zt_workers[i];
+		zdb_trav_item_t *zti;
+
+		while ((zti = list_remove_head(&ztw->ztw_items)) != NULL)
+			umem_free(zti, sizeof (*zti));
+		list_destroy(&ztw->ztw_items);
+		mutex_destroy(&ztw->ztw_lock);
+
+		zdb_cb_merge(zcb, ztw->ztw_zcb);
+		umem_free(ztw->ztw_zcb, sizeof (zdb_cb_t));
+	}
+
+	cv_destroy(&zt.zt_cv);
+	mutex_destroy(&zt.zt_lock);
+	umem_free(zt.zt_workers, nworkers * sizeof (zdb_trav_worker_t));
+
+	return (err);
+}
+
 static int
 dump_block_stats(spa_t *spa)
 {
@@ -4546,6 +5006,11 @@ dump_block_stats(spa_t *spa)
 	 * maps.
 	 */
 	bzero(&zcb, sizeof (zdb_cb_t));
+	zcb.zcb_brt_is_active = spa_feature_is_active(spa,
+	    SPA_FEATURE_BLOCK_CLONING);
+	avl_create(&zcb.zcb_brt, zdb_brt_entry_compare,
+	    sizeof (zdb_brt_entry_t), offsetof(zdb_brt_entry_t, zbre_node));
+	mutex_init(&zcb.zcb_brt_lock, NULL, MUTEX_DEFAULT, NULL);
 	zdb_leak_init(spa, &zcb);
 
 	/*
@@ -4574,21 +5039,18 @@ dump_block_stats(spa_t *spa)
 	zcb.zcb_totalasize += metaslab_class_get_alloc(spa_special_class(spa));
 	zcb.zcb_totalasize += metaslab_class_get_alloc(spa_dedup_class(spa));
 	zcb.zcb_start = zcb.zcb_lastprint = gethrtime();
-	err = traverse_pool(spa, 0, flags, zdb_blkptr_cb, &zcb);
+	if (zdb_traverse_threads > 1)
+		err = zdb_traverse_parallel(spa, flags, &zcb);
+	else
+		err = traverse_pool(spa, 0, flags, zdb_blkptr_cb, &zcb);
 
 	/*
 	 * If we've traversed the data blocks then we need to wait for those
 	 * I/Os to complete. We leverage "The Godfather" zio to wait on
 	 * all async I/Os to complete.
 	 */
-	if (dump_opt['c']) {
-		for (int i = 0; i < max_ncpus; i++) {
-			(void) zio_wait(spa->spa_async_zio_root[i]);
-			spa->spa_async_zio_root[i] = zio_root(spa, NULL, NULL,
-			    ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE |
-			    ZIO_FLAG_GODFATHER);
-		}
-	}
+	if (dump_opt['c'])
+		zdb_blkptr_wait(spa);
 
 	/*
 	 * Done after zio_wait() since zcb_haderrors is modified in
@@ -4612,6 +5074,24 @@ dump_block_stats(spa_t *spa)
 	 */
 	leaks |= zdb_leak_fini(spa, &zcb);
 
+	/*
+	 * Anything left in the BRT tree is a reference count that is higher
+	 * than the number of block pointers we found for the block.
+	 */
+	zdb_brt_entry_t *zbre;
+	void *cookie = NULL;
+	while ((zbre = avl_destroy_nodes(&zcb.zcb_brt, &cookie)) != NULL) {
+		(void) printf("BRT entry %llu:%llx has %llu unreferenced "
+		    "references\n",
+		    (u_longlong_t)DVA_GET_VDEV(&zbre->zbre_dva),
+		    (u_longlong_t)DVA_GET_OFFSET(&zbre->zbre_dva),
+		    (u_longlong_t)zbre->zbre_refcount);
+		umem_free(zbre, sizeof (*zbre));
+		leaks = B_TRUE;
+	}
+	avl_destroy(&zcb.zcb_brt);
+	mutex_destroy(&zcb.zcb_brt_lock);
+
 	tzb = &zcb.zcb_type[ZB_TOTAL][ZDB_OT_TOTAL];
 
 	norm_alloc = metaslab_class_get_alloc(spa_normal_class(spa));
@@ -4622,8 +5102,9 @@ dump_block_stats(spa_t *spa)
 	    metaslab_class_get_alloc(spa_special_class(spa)) +
 	    metaslab_class_get_alloc(spa_dedup_class(spa)) +
 	    get_unflushed_alloc_space(spa);
-	total_found = tzb->zb_asize - zcb.zcb_dedup_asize +
-	    zcb.zcb_removing_size + zcb.zcb_checkpoint_size;
+	total_found = tzb->zb_asize - zcb.zcb_dedup_asize -
+	    zcb.zcb_clone_asize + zcb.zcb_removing_size +
+	    zcb.zcb_checkpoint_size;
 
 	if (total_found == total_alloc && !dump_opt['L']) {
 		(void) printf("\n\tNo leaks (block sum matches space"
@@ -4661,6 +5142,9 @@ dump_block_stats(spa_t *spa)
 	    "bp deduped:", (u_longlong_t)zcb.zcb_dedup_asize,
 	    (u_longlong_t)zcb.zcb_dedup_blocks,
 	    (double)zcb.zcb_dedup_asize / tzb->zb_asize + 1.0);
+	(void) printf("\t%-16s %14llu    count: %6llu\n",
+	    "bp cloned:", (u_longlong_t)zcb.zcb_clone_asize,
+	    (u_longlong_t)zcb.zcb_clone_blocks);
 	(void) printf("\t%-16s %14llu     used: %5.2f%%\n", "Normal class:",
 	    (u_longlong_t)norm_alloc, 100.0 * norm_alloc / norm_space);
 
@@ -5534,6 +6018,32 @@ mos_leak_log_spacemaps(spa_t *spa)
 		mos_obj_refd(sls->sls_sm_obj);
 }
 
+static void
+mos_leak_brt(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+	objset_t *mos = spa_meta_objset(spa);
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		brt_vdev_phys_t *bvp;
+		dmu_buf_t *db;
+		uint64_t obj;
+		char name[64];
+
+		(void) snprintf(name, sizeof (name), "%s%llu",
+		    DMU_POOL_BRT_VDEV_PREFIX, (u_longlong_t)c);
+		if (zap_lookup(mos, DMU_POOL_DIRECTORY_OBJECT, name,
+		    sizeof (obj), 1, &obj) != 0)
+			continue;
+
+		mos_obj_refd(obj);
+		VERIFY0(dmu_bonus_hold(mos, obj, FTAG, &db));
+		bvp = db->db_data;
+		mos_obj_refd(bvp->bvp_mos_entries);
+		dmu_buf_rele(db, FTAG);
+	}
+}
+
 static int
 dump_mos_leaks(spa_t *spa)
 {
@@ -5568,6 +6078,7 @@ dump_mos_leaks(spa_t *spa)
 	if (spa->spa_syncing_log_sm != NULL)
 		mos_obj_refd(spa->spa_syncing_log_sm->sm_object);
 	mos_leak_log_spacemaps(spa);
+	mos_leak_brt(spa);
 
 	mos_obj_refd(spa->spa_condensing_indirect_phys.
 	    scip_next_mapping_object);
@@ -5613,6 +6124,11 @@ dump_mos_leaks(spa_t *spa)
 			}
 		}
 	}
+	for (uint64_t cksum = 0; cksum < ZIO_CHECKSUM_FUNCTIONS; cksum++) {
+		ddt_t *ddt = spa->spa_ddt[cksum];
+		mos_obj_refd(ddt->ddt_log[0].ddl_object);
+		mos_obj_refd(ddt->ddt_log[1].ddl_object);
+	}
 
 	/*
 	 * Visit all allocated objects and make sure they are referenced.
@@ -6282,7 +6798,7 @@ main(int argc, char **argv)
 	zfs_btree_verify_intensity = 3;
 
 	while ((c = getopt(argc, argv,
-	    "AbcCdDeEFGhiI:klLmMo:Op:PqRsSt:uU:vVx:X")) != -1) {
+	    "AbcCdDeEFGhiI:j:klLmMo:Op:PqRsSt:uU:vVx:X")) != -1) {
 		switch (c) {
 		case 'b':
 		case 'c':
@@ -6324,6 +6840,14 @@ main(int argc, char **argv)
 				usage();
 			}
 			break;
+		case 'j':
+			zdb_traverse_threads = atoi(optarg);
+			if (zdb_traverse_threads <= 0) {
+				(void) fprintf(stderr, "number of traversal "
+				    "threads must be greater than 0\n");
+				usage();
+			}
+			break;
 		case 'o':
 			error = set_global_var(optarg);
 			if (error != 0)
@@ -218,6 +218,26 @@ zil_prt_rec_truncate(zilog_t *zilog, int txtype, void *arg)
 	    (u_longlong_t)lr->lr_length);
 }
 
+/* ARGSUSED */
+static void
+zil_prt_rec_clone_range(zilog_t *zilog, int txtype, void *arg)
+{
+	lr_clone_range_t *lr = arg;
+	int verbose = MAX(dump_opt['d'], dump_opt['i']);
+
+	(void) printf("%sfoid %llu, offset 0x%llx, length 0x%llx, "
+	    "blksz 0x%llx, nbps %llu\n", tab_prefix,
+	    (u_longlong_t)lr->lr_foid, (u_longlong_t)lr->lr_offset,
+	    (u_longlong_t)lr->lr_length, (u_longlong_t)lr->lr_blksz,
+	    (u_longlong_t)lr->lr_nbps);
+
+	if (verbose < 5)
+		return;
+
+	for (uint64_t i = 0; i < lr->lr_nbps; i++)
+		print_log_bp(&lr->lr_bps[i], tab_prefix);
+}
+
 /* ARGSUSED */
 static void
 zil_prt_rec_setattr(zilog_t *zilog, int txtype, void *arg)
@@ -303,6 +323,8 @@ static zil_rec_info_t zil_rec_info[TX_MAX_TYPE] = {
 	{.zri_print = zil_prt_rec_create,   .zri_name = "TX_MKDIR_ATTR      "},
 	{.zri_print = zil_prt_rec_create,   .zri_name = "TX_MKDIR_ACL_ATTR  "},
 	{.zri_print = zil_prt_rec_write,    .zri_name = "TX_WRITE2          "},
+	{.zri_print = zil_prt_rec_clone_range,
+	    .zri_name = "TX_CLONE_RANGE     "},
 };
 
 /* ARGSUSED */
@@ -432,6 +432,14 @@ zfs_for_each(int argc, char **argv, int flags, zfs_type_t types,
 	if ((cb.cb_avl = uu_avl_create(avl_pool, NULL, UU_DEFAULT)) == NULL)
 		nomem();
 
+	/*
+	 * The handles that zfs_callback() prunes can come from the kernel
+	 * with only the properties in the table in the first place, which
+	 * makes listing many datasets much cheaper.
+	 */
+	if (cb.cb_proplist && *cb.cb_proplist && !(*cb.cb_proplist)->pl_all)
+		zfs_iter_prune_proplist(g_zfs, cb.cb_props_table);
+
 	if (argc == 0) {
 		/*
 		 * If given no arguments, iterate over all datasets.
@@ -469,6 +477,8 @@ zfs_for_each(int argc, char **argv, int flags, zfs_type_t types,
 		}
 	}
 
+	zfs_iter_prune_proplist(g_zfs, NULL);
+
 	/*
 	 * At this point we've got our AVL tree full of zfs handles, so iterate
 	 * over each one and execute the real user callback.
@@ -373,7 +373,8 @@ get_usage(zpool_help_t idx)
 		return (gettext("\tinitialize [-c | -s] <pool> "
 		    "[<device> ...]\n"));
 	case HELP_SCRUB:
-		return (gettext("\tscrub [-s | -p] <pool> ...\n"));
+		return (gettext("\tscrub [-s | -p] [-t txg | -S time] "
+		    "<pool> ...\n"));
 	case HELP_RESILVER:
 		return (gettext("\tresilver <pool> ...\n"));
 	case HELP_TRIM:
@@ -5670,6 +5671,9 @@ zpool_do_replace(int argc, char **argv)
  * part of a mirror, then <device> will be transformed into a mirror of
  * <device> and <new_device>.  In either case, <new_device> will begin life
  * with a DTL of [0, now], and will immediately begin to resilver itself.
+ *
+ * If <device> is a raidz vdev (e.g. raidz1-0), <new_device> is added to it
+ * and the raidz's existing data is reflowed across the new, wider layout.
  */
 int
 zpool_do_attach(int argc, char **argv)
@@ -6220,6 +6224,8 @@ typedef struct scrub_cbdata {
 	int	cb_argc;
 	char	**cb_argv;
 	pool_scrub_cmd_t cb_scrub_cmd;
+	uint64_t cb_txg;
+	time_t	cb_since;
 } scrub_cbdata_t;
 
 static boolean_t
@@ -6252,6 +6258,7 @@ int
 scrub_callback(zpool_handle_t *zhp, void *data)
 {
 	scrub_cbdata_t *cb = data;
+	uint64_t txg;
 	int err;
 
 	/*
@@ -6263,7 +6270,22 @@ scrub_callback(zpool_handle_t *zhp, void *data)
 		return (1);
 	}
 
-	err = zpool_scan(zhp, cb->cb_type, cb->cb_scrub_cmd);
+	txg = cb->cb_txg;
+	if (cb->cb_since != 0) {
+		if (zpool_history_txg(zhp, cb->cb_since, &txg) != 0) {
+			(void) fprintf(stderr, gettext("cannot scrub '%s': "
+			    "unable to read the pool history\n"),
+			    zpool_get_name(zhp));
+			return (1);
+		}
+		if (txg == 0) {
+			(void) printf(gettext("the history of pool '%s' does "
+			    "not go back to the given time; scrubbing all "
+			    "blocks\n"), zpool_get_name(zhp));
+		}
+	}
+
+	err = zpool_scan_txg(zhp, cb->cb_type, cb->cb_scrub_cmd, txg);
 
 	if (err == 0 && zpool_has_checkpoint(zhp) &&
 	    cb->cb_type == POOL_SCAN_SCRUB) {
@@ -6276,22 +6298,62 @@ scrub_callback(zpool_handle_t *zhp, void *data)
 }
 
 /*
- * zpool scrub [-s | -p] <pool> ...
+ * Parses the argument of zpool scrub -S: either a number of seconds since
+ * the epoch, or an age with an s, m, h or d suffix.  Returns 0 if invalid.
+ */
+static time_t
+parse_scrub_since(const char *arg)
+{
+	static const struct {
+		char	unit;
+		time_t	secs;
+	} units[] = {
+		{ 's', 1 }, { 'm', 60 }, { 'h', 60 * 60 }, { 'd', 24 * 60 * 60 }
+	};
+	time_t now = time(NULL);
+	u_longlong_t val;
+	char *end;
+	int i;
+
+	errno = 0;
+	val = strtoull(arg, &end, 10);
+	if (errno != 0 || end == arg)
+		return (0);
+	if (*end == '\0')
+		return (val < now ? (time_t)val : 0);
+	if (end[1] != '\0')
+		return (0);
+	for (i = 0; i < ARRAY_SIZE(units); i++) {
+		if (*end == units[i].unit && val > 0 &&
+		    val < now / units[i].secs)
+			return (now - (time_t)val * units[i].secs);
+	}
+	return (0);
+}
+
+/*
+ * zpool scrub [-s | -p] [-t txg | -S time] <pool> ...
  *
  *	-s	Stop.  Stops any in-progress scrub.
  *	-p	Pause. Pause in-progress scrub.
+ *	-t	Only scrub the blocks born in the given txg or later.
+ *	-S	Only scrub the blocks written since the given time, in seconds
+ *		since the epoch or as an age such as 12h or 3d.
  */
 int
 zpool_do_scrub(int argc, char **argv)
 {
 	int c;
 	scrub_cbdata_t cb;
+	char *end;
 
 	cb.cb_type = POOL_SCAN_SCRUB;
 	cb.cb_scrub_cmd = POOL_SCRUB_NORMAL;
+	cb.cb_txg = 0;
+	cb.cb_since = 0;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "sp")) != -1) {
+	while ((c = getopt(argc, argv, "spt:S:")) != -1) {
 		switch (c) {
 		case 's':
 			cb.cb_type = POOL_SCAN_NONE;
@@ -6299,6 +6361,22 @@ zpool_do_scrub(int argc, char **argv)
 		case 'p':
 			cb.cb_scrub_cmd = POOL_SCRUB_PAUSE;
 			break;
+		case 't':
+			errno = 0;
+			cb.cb_txg = strtoull(optarg, &end, 0);
+			if (errno != 0 || *end != '\0' || cb.cb_txg == 0) {
+				(void) fprintf(stderr,
+				    gettext("invalid txg value\n"));
+				usage(B_FALSE);
+			}
+			break;
+		case 'S':
+			if ((cb.cb_since = parse_scrub_since(optarg)) == 0) {
+				(void) fprintf(stderr,
+				    gettext("invalid time value\n"));
+				usage(B_FALSE);
+			}
+			break;
 		case '?':
 			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
 			    optopt);
@@ -6313,6 +6391,20 @@ zpool_do_scrub(int argc, char **argv)
 		usage(B_FALSE);
 	}
 
+	if ((cb.cb_txg != 0 || cb.cb_since != 0) &&
+	    (cb.cb_type == POOL_SCAN_NONE ||
+	    cb.cb_scrub_cmd == POOL_SCRUB_PAUSE)) {
+		(void) fprintf(stderr, gettext("invalid option combination: "
+		    "-t and -S only apply when starting a scrub\n"));
+		usage(B_FALSE);
+	}
+
+	if (cb.cb_txg != 0 && cb.cb_since != 0) {
+		(void) fprintf(stderr, gettext("invalid option combination: "
+		    "-t and -S are mutually exclusive\n"));
+		usage(B_FALSE);
+	}
+
 	cb.cb_argc = argc;
 	cb.cb_argv = argv;
 	argc -= optind;
@@ -6339,6 +6431,8 @@ zpool_do_resilver(int argc, char **argv)
 
 	cb.cb_type = POOL_SCAN_RESILVER;
 	cb.cb_scrub_cmd = POOL_SCRUB_NORMAL;
+	cb.cb_txg = 0;
+	cb.cb_since = 0;
 	cb.cb_argc = argc;
 	cb.cb_argv = argv;
 
@@ -6626,6 +6720,11 @@ print_scan_status(pool_scan_stat_t *ps)
 			    (u_longlong_t)days_left, (u_longlong_t)hours_left,
 			    (u_longlong_t)mins_left, (u_longlong_t)secs_left,
 			    (u_longlong_t)ps->pss_errors, ctime(&end));
+			if (ps->pss_min_txg != 0) {
+				(void) printf(gettext("\tof the blocks born "
+				    "after txg %llu\n"),
+				    (u_longlong_t)ps->pss_min_txg);
+			}
 		} else if (ps->pss_func == POOL_SCAN_RESILVER) {
 			(void) printf(gettext("resilvered %s "
 			    "in %llu days %02llu:%02llu:%02llu "
@@ -6659,6 +6758,10 @@ print_scan_status(pool_scan_stat_t *ps)
 			(void) printf(gettext("\tscrub started on %s"),
 			    ctime(&start));
 		}
+		if (ps->pss_min_txg != 0) {
+			(void) printf(gettext("\tof the blocks born after "
+			    "txg %llu\n"), (u_longlong_t)ps->pss_min_txg);
+		}
 	} else if (ps->pss_func == POOL_SCAN_RESILVER) {
 		(void) printf(gettext("resilver in progress since %s"),
 		    ctime(&start));
@@ -6729,6 +6832,67 @@ print_scan_status(pool_scan_stat_t *ps)
 	}
 }
 
+/*
+ * Print out the sequential rebuild status of each top-level vdev.
+ */
+static void
+print_rebuild_status(zpool_handle_t *zhp, nvlist_t *nvroot)
+{
+	nvlist_t **child;
+	uint_t c, children;
+
+	if (nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN,
+	    &child, &children) != 0)
+		return;
+
+	for (c = 0; c < children; c++) {
+		vdev_stat_t *vs;
+		uint_t i;
+		time_t when;
+		char *name;
+		char done_buf[7], est_buf[7];
+		double pct;
+
+		if (nvlist_lookup_uint64_array(child[c],
+		    ZPOOL_CONFIG_VDEV_STATS, (uint64_t **)&vs, &i) != 0)
+			continue;
+
+		/* Older kernels do not report rebuild state */
+		if (i * sizeof (uint64_t) < sizeof (vdev_stat_t) ||
+		    vs->vs_rebuild_state == VDEV_REBUILD_NONE)
+			continue;
+
+		name = zpool_vdev_name(g_zfs, zhp, child[c],
+		    VDEV_NAME_TYPE_ID);
+		when = vs->vs_rebuild_action_time;
+		zfs_nicenum(vs->vs_rebuild_bytes_done, done_buf,
+		    sizeof (done_buf));
+		zfs_nicenum(vs->vs_rebuild_bytes_est, est_buf,
+		    sizeof (est_buf));
+		pct = (vs->vs_rebuild_bytes_est == 0) ? 0.0 :
+		    100.0 * vs->vs_rebuild_bytes_done /
+		    vs->vs_rebuild_bytes_est;
+
+		switch (vs->vs_rebuild_state) {
+		case VDEV_REBUILD_ACTIVE:
+			(void) printf(gettext(" rebuild: %s in progress "
+			    "since %s"), name, ctime(&when));
+			(void) printf(gettext("\t%s rebuilt of %s, "
+			    "%.2f%% done\n"), done_buf, est_buf, pct);
+			break;
+		case VDEV_REBUILD_CANCELED:
+			(void) printf(gettext(" rebuild: %s canceled on %s"),
+			    name, ctime(&when));
+			break;
+		case VDEV_REBUILD_COMPLETE:
+			(void) printf(gettext(" rebuild: %s rebuilt %s on %s"),
+			    name, done_buf, ctime(&when));
+			break;
+		}
+		free(name);
+	}
+}
+
 /*
  * As we don't scrub checkpointed blocks, we want to warn the
  * user that we skipped scanning some blocks if a checkpoint exists
@@ -6868,6 +7032,94 @@ print_removal_status(zpool_handle_t *zhp, pool_removal_stat_t *prs)
 	}
 }
 
+/*
+ * Print out detailed raidz expansion status.
+ */
+static void
+print_raidz_expand_status(zpool_handle_t *zhp, pool_raidz_expand_stat_t *pres)
+{
+	char copied_buf[7], total_buf[7], rate_buf[7];
+	time_t start, end;
+	nvlist_t *config, *nvroot;
+	nvlist_t **child;
+	uint_t children;
+	char *vdev_name;
+
+	if (pres == NULL || pres->pres_state == DSS_NONE)
+		return;
+
+	/*
+	 * Determine name of vdev.
+	 */
+	config = zpool_get_config(zhp, NULL);
+	nvroot = fnvlist_lookup_nvlist(config,
+	    ZPOOL_CONFIG_VDEV_TREE);
+	verify(nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN,
+	    &child, &children) == 0);
+	assert(pres->pres_expanding_vdev < children);
+	vdev_name = zpool_vdev_name(g_zfs, zhp,
+	    child[pres->pres_expanding_vdev], VDEV_NAME_TYPE_ID);
+
+	(void) printf(gettext("expand: "));
+
+	start = pres->pres_start_time;
+	end = pres->pres_end_time;
+	zfs_nicenum(pres->pres_reflowed, copied_buf, sizeof (copied_buf));
+
+	if (pres->pres_state == DSS_FINISHED) {
+		uint64_t minutes_taken = (end - start) / 60;
+
+		(void) printf(gettext("Expansion of vdev %s copied %s "
+		    "in %lluh%um, completed on %s"),
+		    vdev_name, copied_buf,
+		    (u_longlong_t)(minutes_taken / 60),
+		    (uint_t)(minutes_taken % 60),
+		    ctime((time_t *)&end));
+	} else {
+		uint64_t copied, total, elapsed, mins_left, hours_left;
+		double fraction_done;
+		uint_t rate;
+
+		assert(pres->pres_state == DSS_SCANNING);
+
+		(void) printf(gettext(
+		    "Expansion of %s in progress since %s"),
+		    vdev_name, ctime(&start));
+
+		copied = pres->pres_reflowed > 0 ? pres->pres_reflowed : 1;
+		total = pres->pres_to_reflow > 0 ? pres->pres_to_reflow : 1;
+		fraction_done = MIN((double)copied / total, 1.0);
+
+		elapsed = time(NULL) - pres->pres_start_time;
+		elapsed = elapsed > 0 ? elapsed : 1;
+		rate = copied / elapsed;
+		rate = rate > 0 ? rate : 1;
+		mins_left = (copied < total) ?
+		    ((total - copied) / rate) / 60 : 0;
+		hours_left = mins_left / 60;
+
+		zfs_nicenum(copied, copied_buf, sizeof (copied_buf));
+		zfs_nicenum(total, total_buf, sizeof (total_buf));
+		zfs_nicenum(rate, rate_buf, sizeof (rate_buf));
+
+		(void) printf(gettext("    %s copied out of %s at %s/s, "
+		    "%.2f%% done"),
+		    copied_buf, total_buf, rate_buf, 100 * fraction_done);
+		if (pres->pres_waiting_for_resilver) {
+			(void) printf(gettext(", paused for resilver or "
+			    "device errors\n"));
+		} else if (hours_left < (30 * 24)) {
+			(void) printf(gettext(", %lluh%um to go\n"),
+			    (u_longlong_t)hours_left, (uint_t)(mins_left % 60));
+		} else {
+			(void) printf(gettext(
+			    ", (copy is slow, no estimated time)\n"));
+		}
+	}
+
+	free(vdev_name);
+}
+
 static void
 print_checkpoint_status(pool_checkpoint_stat_t *pcs)
 {
@@ -7328,19 +7580,30 @@ status_callback(zpool_handle_t *zhp, void *data)
 		nvlist_t **spares, **l2cache;
 		uint_t nspares, nl2cache;
 		pool_checkpoint_stat_t *pcs = NULL;
-		pool_scan_stat_t *ps = NULL;
+		pool_scan_stat_t *ps = NULL, pss;
 		pool_removal_stat_t *prs = NULL;
+		pool_raidz_expand_stat_t *pres = NULL;
 
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_CHECKPOINT_STATS, (uint64_t **)&pcs, &c);
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_SCAN_STATS, (uint64_t **)&ps, &c);
+		/* An older kernel does not report the newer fields. */
+		if (ps != NULL && c < sizeof (pss) / sizeof (uint64_t)) {
+			bzero(&pss, sizeof (pss));
+			bcopy(ps, &pss, c * sizeof (uint64_t));
+			ps = &pss;
+		}
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_REMOVAL_STATS, (uint64_t **)&prs, &c);
+		(void) nvlist_lookup_uint64_array(nvroot,
+		    ZPOOL_CONFIG_RAIDZ_EXPAND_STATS, (uint64_t **)&pres, &c);
 
 		print_scan_status(ps);
+		print_rebuild_status(zhp, nvroot);
 		print_checkpoint_scan_warning(ps, pcs);
 		print_removal_status(zhp, prs);
+		print_raidz_expand_status(zhp, pres);
 		print_checkpoint_status(pcs);
 
 		cbp->cb_namewidth = max_width(zhp, nvroot, 0, 0,
@@ -36,6 +36,7 @@
  *
  *	Group vdevs
  *		raidz[1|2]=(...)
+ *		draid[<parity>][:<data>d][:<children>c][:<spares>s]=(...)
  *		mirror=(...)
  *
  *	Hot spares
@@ -380,6 +381,68 @@ is_whole_disk(const char *arg)
 	return (B_TRUE);
 }
 
+/*
+ * Parse a dRAID vdev type of the form
+ * draid[<parity>][:<data>d][:<children>c][:<spares>s].  Values that are
+ * not given are returned as zero, except the parity which defaults to 1.
+ */
+static boolean_t
+draid_parse_type(const char *type, uint64_t *nparityp, uint64_t *ndatap,
+    uint64_t *nchildrenp, uint64_t *nsparesp)
+{
+	const char *p = type + strlen(VDEV_TYPE_DRAID);
+	char *end;
+
+	if (strncmp(type, VDEV_TYPE_DRAID, strlen(VDEV_TYPE_DRAID)) != 0)
+		return (B_FALSE);
+
+	*nparityp = 1;
+	*ndatap = *nchildrenp = *nsparesp = 0;
+
+	if (*p != '\0' && *p != ':') {
+		if (*p == '0')
+			return (B_FALSE); /* no zero prefixes allowed */
+		errno = 0;
+		*nparityp = strtoull(p, &end, 10);
+		if (errno != 0 || *nparityp < 1 ||
+		    *nparityp > VDEV_DRAID_MAXPARITY)
+			return (B_FALSE);
+		p = end;
+	}
+
+	while (*p == ':') {
+		uint64_t val;
+
+		errno = 0;
+		val = strtoull(p + 1, &end, 10);
+		if (errno != 0 || end == p + 1)
+			return (B_FALSE);
+
+		switch (*end) {
+		case 'd':
+			if (val == 0)
+				return (B_FALSE);
+			*ndatap = val;
+			break;
+		case 'c':
+			if (val == 0 || val > VDEV_DRAID_MAX_CHILDREN)
+				return (B_FALSE);
+			*nchildrenp = val;
+			break;
+		case 's':
+			if (val > VDEV_DRAID_MAX_SPARES)
+				return (B_FALSE);
+			*nsparesp = val;
+			break;
+		default:
+			return (B_FALSE);
+		}
+		p = end + 1;
+	}
+
+	return (*p == '\0');
+}
+
 /*
  * Create a leaf vdev.  Determine if this is a file or a device.  If it's a
  * device, fill in the device id to make a complete nvlist.  Valid forms for a
@@ -399,6 +462,20 @@ make_leaf_vdev(nvlist_t *props, const char *arg, uint64_t is_log)
 	boolean_t wholedisk = B_FALSE;
 	uint64_t ashift = 0;
 
+	/*
+	 * A distributed spare is named after the dRAID vdev it belongs to
+	 * and has no device of its own to examine.
+	 */
+	if (zpool_is_draid_spare(arg)) {
+		verify(nvlist_alloc(&vdev, NV_UNIQUE_NAME, 0) == 0);
+		verify(nvlist_add_string(vdev, ZPOOL_CONFIG_PATH, arg) == 0);
+		verify(nvlist_add_string(vdev, ZPOOL_CONFIG_TYPE,
+		    VDEV_TYPE_DRAID_SPARE) == 0);
+		verify(nvlist_add_uint64(vdev, ZPOOL_CONFIG_IS_LOG,
+		    is_log) == 0);
+		return (vdev);
+	}
+
 	/*
 	 * Determine what type of vdev this is, and put the full path into
 	 * 'path'.  We detect whether this is a device of file afterwards by
@@ -645,7 +722,8 @@ get_replication(nvlist_t *nvroot, boolean_t fatal)
 			rep.zprl_type = type;
 			rep.zprl_children = 0;
 
-			if (strcmp(type, VDEV_TYPE_RAIDZ) == 0) {
+			if (strcmp(type, VDEV_TYPE_RAIDZ) == 0 ||
+			    strcmp(type, VDEV_TYPE_DRAID) == 0) {
 				verify(nvlist_lookup_uint64(nv,
 				    ZPOOL_CONFIG_NPARITY,
 				    &rep.zprl_parity) == 0);
@@ -1248,6 +1326,24 @@ is_grouping(const char *type, int *mindev, int *maxdev)
 		return (VDEV_TYPE_RAIDZ);
 	}
 
+	if (strncmp(type, VDEV_TYPE_DRAID, strlen(VDEV_TYPE_DRAID)) == 0) {
+		uint64_t nparity, ndata, nchildren, nspares;
+
+		if (!draid_parse_type(type, &nparity, &ndata, &nchildren,
+		    &nspares))
+			return (NULL);
+
+		if (mindev != NULL) {
+			*mindev = nchildren != 0 ? nchildren :
+			    nparity + MAX(ndata, 1) + nspares;
+		}
+		if (maxdev != NULL) {
+			*maxdev = nchildren != 0 ? nchildren :
+			    VDEV_DRAID_MAX_CHILDREN;
+		}
+		return (VDEV_TYPE_DRAID);
+	}
+
 	if (maxdev != NULL)
 		*maxdev = INT_MAX;
 
@@ -1285,6 +1381,118 @@ is_grouping(const char *type, int *mindev, int *maxdev)
 	return (NULL);
 }
 
+/*
+ * Add the dRAID layout described by 'spec' to the top-level vdev 'nv'.
+ * Unless given explicitly, each redundancy group holds up to eight data
+ * sectors.
+ */
+static int
+draid_config_add(nvlist_t *nv, const char *spec, int children)
+{
+	uint64_t nparity, ndata, nchildren, nspares;
+
+	verify(draid_parse_type(spec, &nparity, &ndata, &nchildren,
+	    &nspares));
+
+	if (nspares + nparity >= children) {
+		(void) fprintf(stderr, gettext("invalid vdev specification: "
+		    "%s leaves no devices for data\n"), spec);
+		return (-1);
+	}
+
+	if (ndata == 0)
+		ndata = MIN(8, children - nspares - nparity);
+
+	if (ndata + nparity > children - nspares) {
+		(void) fprintf(stderr, gettext("invalid vdev specification: "
+		    "%s requires at least %llu devices\n"), spec,
+		    (u_longlong_t)(ndata + nparity + nspares));
+		return (-1);
+	}
+
+	verify(nvlist_add_uint64(nv, ZPOOL_CONFIG_NPARITY, nparity) == 0);
+	verify(nvlist_add_uint64(nv, ZPOOL_CONFIG_DRAID_NDATA, ndata) == 0);
+	verify(nvlist_add_uint64(nv, ZPOOL_CONFIG_DRAID_NSPARES,
+	    nspares) == 0);
+
+	return (0);
+}
+
+/*
+ * Add the distributed spares of every dRAID vdev in 'nvroot' to its list
+ * of hot spares.  The spares are named after the id their dRAID vdev will
+ * have in the pool, so when adding to an existing pool the ids start
+ * after its current top-level vdevs.
+ */
+static void
+draid_add_spares(nvlist_t *poolconfig, nvlist_t *nvroot)
+{
+	nvlist_t **top, **spares, **newspares;
+	uint_t t, toplevels, nspares = 0, nnew = 0;
+	uint64_t base = 0;
+
+	if (poolconfig != NULL) {
+		nvlist_t *tree, **ptop;
+		uint_t ptoplevels;
+
+		verify(nvlist_lookup_nvlist(poolconfig,
+		    ZPOOL_CONFIG_VDEV_TREE, &tree) == 0);
+		verify(nvlist_lookup_nvlist_array(tree, ZPOOL_CONFIG_CHILDREN,
+		    &ptop, &ptoplevels) == 0);
+		base = ptoplevels;
+	}
+
+	verify(nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN,
+	    &top, &toplevels) == 0);
+	(void) nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_SPARES,
+	    &spares, &nspares);
+
+	newspares = safe_malloc((nspares + toplevels *
+	    VDEV_DRAID_MAX_SPARES) * sizeof (nvlist_t *));
+	for (uint_t s = 0; s < nspares; s++)
+		verify(nvlist_dup(spares[s], &newspares[nnew++], 0) == 0);
+
+	for (t = 0; t < toplevels; t++) {
+		char *type;
+		uint64_t nparity, ndspares = 0;
+
+		verify(nvlist_lookup_string(top[t], ZPOOL_CONFIG_TYPE,
+		    &type) == 0);
+		if (strcmp(type, VDEV_TYPE_DRAID) != 0)
+			continue;
+
+		verify(nvlist_lookup_uint64(top[t], ZPOOL_CONFIG_NPARITY,
+		    &nparity) == 0);
+		(void) nvlist_lookup_uint64(top[t],
+		    ZPOOL_CONFIG_DRAID_NSPARES, &ndspares);
+
+		for (uint64_t s = 0; s < ndspares; s++) {
+			char name[MAXNAMELEN];
+			nvlist_t *nv;
+
+			(void) snprintf(name, sizeof (name),
+			    VDEV_DRAID_SPARE_PATH_FMT, (u_longlong_t)nparity,
+			    (u_longlong_t)(base + t), (u_longlong_t)s);
+			verify(nvlist_alloc(&nv, NV_UNIQUE_NAME, 0) == 0);
+			verify(nvlist_add_string(nv, ZPOOL_CONFIG_PATH,
+			    name) == 0);
+			verify(nvlist_add_string(nv, ZPOOL_CONFIG_TYPE,
+			    VDEV_TYPE_DRAID_SPARE) == 0);
+			verify(nvlist_add_uint64(nv, ZPOOL_CONFIG_IS_LOG,
+			    B_FALSE) == 0);
+			newspares[nnew++] = nv;
+		}
+	}
+
+	if (nnew != nspares) {
+		verify(nvlist_add_nvlist_array(nvroot, ZPOOL_CONFIG_SPARES,
+		    newspares, nnew) == 0);
+	}
+	for (uint_t s = 0; s < nnew; s++)
+		nvlist_free(newspares[s]);
+	free(newspares);
+}
+
 /*
  * Construct a syntactically valid vdev specification,
  * and ensure that all devices and files exist and can be opened.
@@ -1296,7 +1504,7 @@ construct_spec(nvlist_t *props, int argc, char **argv)
 {
 	nvlist_t *nvroot, *nv, **top, **spares, **l2cache;
 	int t, toplevels, mindev, maxdev, nspares, nlogs, nl2cache;
-	const char *type;
+	const char *type, *spec;
 	uint64_t is_log, is_special, is_dedup;
 	boolean_t seen_logs;
 
@@ -1321,6 +1529,8 @@ construct_spec(nvlist_t *props, int argc, char **argv)
 			nvlist_t **child = NULL;
 			int c, children = 0;
 
+			spec = argv[0];
+
 			if (strcmp(type, VDEV_TYPE_SPARE) == 0) {
 				if (spares != NULL) {
 					(void) fprintf(stderr,
@@ -1460,6 +1670,9 @@ construct_spec(nvlist_t *props, int argc, char **argv)
 					    ZPOOL_CONFIG_NPARITY,
 					    mindev - 1) == 0);
 				}
+				if (strcmp(type, VDEV_TYPE_DRAID) == 0 &&
+				    draid_config_add(nv, spec, children) != 0)
+					return (NULL);
 				verify(nvlist_add_nvlist_array(nv,
 				    ZPOOL_CONFIG_CHILDREN, child,
 				    children) == 0);
@@ -1649,6 +1862,8 @@ make_root_vdev(zpool_handle_t *zhp, nvlist_t *props, int force, int check_rep,
 	if (zhp && ((poolconfig = zpool_get_config(zhp, NULL)) == NULL))
 		return (NULL);
 
+	draid_add_spares(poolconfig, newroot);
+
 	/*
 	 * Validate each device to make sure that its not shared with another
 	 * subsystem.  We do this even if 'force' is set, because there are some
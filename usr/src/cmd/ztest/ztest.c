@@ -106,6 +106,7 @@
 #include <sys/vdev_file.h>
 #include <sys/vdev_initialize.h>
 #include <sys/vdev_trim.h>
+#include <sys/vdev_draid.h>
 #include <sys/spa_impl.h>
 #include <sys/metaslab_impl.h>
 #include <sys/dsl_prop.h>
@@ -164,6 +165,8 @@ typedef struct ztest_shared_opts {
 	int zo_mirrors;
 	int zo_raidz;
 	int zo_raidz_parity;
+	char zo_raid_type[8];
+	int zo_draid_spares;
 	int zo_datasets;
 	int zo_threads;
 	uint64_t zo_passtime;
@@ -187,6 +190,8 @@ static const ztest_shared_opts_t ztest_opts_defaults = {
 	.zo_mirrors = 2,
 	.zo_raidz = 4,
 	.zo_raidz_parity = 1,
+	.zo_raid_type = { 'r', 'a', 'i', 'd', 'z', '\0' },
+	.zo_draid_spares = 1,
 	.zo_vdev_size = SPA_MINDEVSIZE * 4,	/* 256m default size */
 	.zo_datasets = 7,
 	.zo_threads = 23,
@@ -205,11 +210,14 @@ extern uint64_t metaslab_force_ganging;
 extern uint64_t metaslab_df_alloc_threshold;
 extern uint64_t zfs_deadman_synctime_ms;
 extern int metaslab_preload_limit;
+extern int zfs_dedup_log_txg_max;
+extern int zfs_dedup_log_flush_entries_min;
 extern boolean_t zfs_compressed_arc_enabled;
 extern boolean_t zfs_abd_scatter_enabled;
 extern int dmu_object_alloc_chunk_shift;
 extern boolean_t zfs_force_some_double_word_sm_entries;
 extern unsigned long zfs_reconstruct_indirect_damage_fraction;
+extern int zil_itx_sublists;
 
 static ztest_shared_opts_t *ztest_shared_opts;
 static ztest_shared_opts_t ztest_opts;
@@ -347,6 +355,7 @@ ztest_func_t ztest_zil_remount;
 ztest_func_t ztest_dmu_read_write_zcopy;
 ztest_func_t ztest_dmu_objset_create_destroy;
 ztest_func_t ztest_dmu_prealloc;
+ztest_func_t ztest_dmu_clone_range;
 ztest_func_t ztest_fzap;
 ztest_func_t ztest_dmu_snapshot_create_destroy;
 ztest_func_t ztest_dsl_prop_get_set;
@@ -359,6 +368,7 @@ ztest_func_t ztest_mmp_enable_disable;
 ztest_func_t ztest_scrub;
 ztest_func_t ztest_dsl_dataset_promote_busy;
 ztest_func_t ztest_vdev_attach_detach;
+ztest_func_t ztest_vdev_raidz_attach;
 ztest_func_t ztest_vdev_LUN_growth;
 ztest_func_t ztest_vdev_add_remove;
 ztest_func_t ztest_vdev_class_add;
@@ -397,6 +407,7 @@ ztest_info_t ztest_info[] = {
 #if 0
 	{ ztest_dmu_prealloc,			1,	&zopt_sometimes	},
 #endif
+	{ ztest_dmu_clone_range,		1,	&zopt_sometimes	},
 	{ ztest_fzap,				1,	&zopt_sometimes	},
 	{ ztest_dmu_snapshot_create_destroy,	1,	&zopt_sometimes	},
 	{ ztest_spa_create_destroy,		1,	&zopt_sometimes	},
@@ -409,6 +420,7 @@ ztest_info_t ztest_info[] = {
 	{ ztest_spa_upgrade,			1,	&zopt_rarely	},
 	{ ztest_dsl_dataset_promote_busy,	1,	&zopt_rarely	},
 	{ ztest_vdev_attach_detach,		1,	&zopt_incessant	},
+	{ ztest_vdev_raidz_attach,		1,	&zopt_rarely	},
 	{ ztest_vdev_LUN_growth,		1,	&zopt_rarely	},
 	{ ztest_vdev_add_remove,		1,
 	    &ztest_opts.zo_vdevtime				},
@@ -613,6 +625,8 @@ usage(boolean_t requested)
 	    "\t[-m mirror_copies (default: %d)]\n"
 	    "\t[-r raidz_disks (default: %d)]\n"
 	    "\t[-R raidz_parity (default: %d)]\n"
+	    "\t[-K raid_kind (default: %s)] raidz|draid\n"
+	    "\t[-D draid_spares (default: %d)]\n"
 	    "\t[-d datasets (default: %d)]\n"
 	    "\t[-t threads (default: %d)]\n"
 	    "\t[-g gang_block_threshold (default: %s)]\n"
@@ -639,6 +653,8 @@ usage(boolean_t requested)
 	    zo->zo_mirrors,				/* -m */
 	    zo->zo_raidz,				/* -r */
 	    zo->zo_raidz_parity,			/* -R */
+	    zo->zo_raid_type,				/* -K */
+	    zo->zo_draid_spares,			/* -D */
 	    zo->zo_datasets,				/* -d */
 	    zo->zo_threads,				/* -t */
 	    nice_force_ganging,				/* -g */
@@ -705,7 +721,7 @@ process_options(int argc, char **argv)
 	bcopy(&ztest_opts_defaults, zo, sizeof (*zo));
 
 	while ((opt = getopt(argc, argv,
-	    "v:s:a:m:r:R:d:t:g:i:k:p:f:MVET:P:hF:B:C:o:")) != EOF) {
+	    "v:s:a:m:r:R:K:D:d:t:g:i:k:p:f:MVET:P:hF:B:C:o:")) != EOF) {
 		value = 0;
 		switch (opt) {
 		case 'v':
@@ -714,6 +730,7 @@ process_options(int argc, char **argv)
 		case 'm':
 		case 'r':
 		case 'R':
+		case 'D':
 		case 'd':
 		case 't':
 		case 'g':
@@ -743,6 +760,20 @@ process_options(int argc, char **argv)
 		case 'R':
 			zo->zo_raidz_parity = MIN(MAX(value, 1), 3);
 			break;
+		case 'K':
+			if (strcmp(optarg, VDEV_TYPE_RAIDZ) != 0 &&
+			    strcmp(optarg, VDEV_TYPE_DRAID) != 0) {
+				(void) fprintf(stderr, "invalid raid kind "
+				    "'%s'\n", optarg);
+				usage(B_FALSE);
+			}
+			(void) strlcpy(zo->zo_raid_type, optarg,
+			    sizeof (zo->zo_raid_type));
+			break;
+		case 'D':
+			zo->zo_draid_spares = MIN(MAX(value, 1),
+			    VDEV_DRAID_MAX_SPARES);
+			break;
 		case 'd':
 			zo->zo_datasets = MAX(1, value);
 			break;
@@ -812,6 +843,17 @@ process_options(int argc, char **argv)
 		}
 	}
 
+	if (strcmp(zo->zo_raid_type, VDEV_TYPE_DRAID) == 0) {
+		/*
+		 * A dRAID vdev needs room for at least one data column in
+		 * addition to its parity and distributed spares, and can't
+		 * be mirrored.
+		 */
+		zo->zo_raidz = MAX(zo->zo_raidz,
+		    zo->zo_raidz_parity + zo->zo_draid_spares + 1);
+		zo->zo_mirrors = 0;
+	}
+
 	zo->zo_raidz_parity = MIN(zo->zo_raidz_parity, zo->zo_raidz - 1);
 
 	zo->zo_vdevtime =
@@ -975,9 +1017,17 @@ make_vdev_raidz(char *path, char *aux, char *pool, size_t size,
 
 	VERIFY(nvlist_alloc(&raidz, NV_UNIQUE_NAME, 0) == 0);
 	VERIFY(nvlist_add_string(raidz, ZPOOL_CONFIG_TYPE,
-	    VDEV_TYPE_RAIDZ) == 0);
+	    ztest_opts.zo_raid_type) == 0);
 	VERIFY(nvlist_add_uint64(raidz, ZPOOL_CONFIG_NPARITY,
 	    ztest_opts.zo_raidz_parity) == 0);
+	if (strcmp(ztest_opts.zo_raid_type, VDEV_TYPE_DRAID) == 0) {
+		int nspares = ztest_opts.zo_draid_spares;
+
+		VERIFY(nvlist_add_uint64(raidz, ZPOOL_CONFIG_DRAID_NDATA,
+		    MIN(8, r - nspares - ztest_opts.zo_raidz_parity)) == 0);
+		VERIFY(nvlist_add_uint64(raidz, ZPOOL_CONFIG_DRAID_NSPARES,
+		    nspares) == 0);
+	}
 	VERIFY(nvlist_add_nvlist_array(raidz, ZPOOL_CONFIG_CHILDREN,
 	    child, r) == 0);
 
@@ -2049,6 +2099,7 @@ zil_replay_func_t *ztest_replay_vector[TX_MAX_TYPE] = {
 	NULL,			/* TX_MKDIR_ATTR */
 	NULL,			/* TX_MKDIR_ACL_ATTR */
 	NULL,			/* TX_WRITE2 */
+	NULL,			/* TX_CLONE_RANGE */
 };
 
 /*
@@ -2693,6 +2744,10 @@ ztest_spa_upgrade(ztest_ds_t *zd, uint64_t id)
 	if (ztest_opts.zo_mmp_test)
 		return;
 
+	/* dRAID vdevs require a feature, so there's nothing to upgrade */
+	if (strcmp(ztest_opts.zo_raid_type, VDEV_TYPE_DRAID) == 0)
+		return;
+
 	mutex_enter(&ztest_vdev_lock);
 	name = kmem_asprintf("%s_upgrade", ztest_opts.zo_pool);
 
@@ -3272,8 +3327,9 @@ ztest_vdev_attach_detach(ztest_ds_t *zd, uint64_t id)
 
 	/* pick a child out of the raidz group */
 	if (ztest_opts.zo_raidz > 1) {
-		ASSERT(oldvd->vdev_ops == &vdev_raidz_ops);
-		ASSERT(oldvd->vdev_children == ztest_opts.zo_raidz);
+		ASSERT(oldvd->vdev_ops == &vdev_raidz_ops ||
+		    oldvd->vdev_ops == &vdev_draid_ops);
+		ASSERT(oldvd->vdev_children >= ztest_opts.zo_raidz);
 		oldvd = oldvd->vdev_child[leaf % ztest_opts.zo_raidz];
 	}
 
@@ -3356,6 +3412,10 @@ ztest_vdev_attach_detach(ztest_ds_t *zd, uint64_t id)
 		expected_error = ENOTSUP;
 	else if (newvd_is_spare && (!replacing || oldvd_is_log))
 		expected_error = ENOTSUP;
+	else if (newvd_is_spare &&
+	    newvd->vdev_ops == &vdev_draid_spare_ops &&
+	    vdev_draid_spare_get_parent(newvd) != oldvd->vdev_top)
+		expected_error = ENOTSUP;
 	else if (newvd == oldvd)
 		expected_error = replacing ? 0 : EBUSY;
 	else if (vdev_lookup_by_path(rvd, newpath) != NULL)
@@ -3409,6 +3469,105 @@ ztest_vdev_attach_detach(ztest_ds_t *zd, uint64_t id)
 	mutex_exit(&ztest_vdev_lock);
 }
 
+/*
+ * Verify that we can expand a raidz vdev by attaching a new child to it.
+ * The new child is not one of the devices that the other tests pick by
+ * index, so they keep operating on the original children only.
+ */
+/* ARGSUSED */
+void
+ztest_vdev_raidz_attach(ztest_ds_t *zd, uint64_t id)
+{
+	ztest_shared_t *zs = ztest_shared;
+	spa_t *spa = ztest_spa;
+	vdev_t *rvd = spa->spa_root_vdev;
+	vdev_t *tvd;
+	nvlist_t *root;
+	uint64_t ashift = ztest_get_ashift();
+	uint64_t leaves, top, guid, newsize;
+	char newpath[MAXPATHLEN];
+	int error, expected_error;
+
+	if (ztest_opts.zo_mmp_test || zs->zs_mirrors != 0 ||
+	    ztest_opts.zo_raidz < 2)
+		return;
+
+	mutex_enter(&ztest_vdev_lock);
+	leaves = ztest_opts.zo_raidz;
+
+	spa_config_enter(spa, SCL_VDEV, FTAG, RW_READER);
+
+	if (ztest_device_removal_active) {
+		spa_config_exit(spa, SCL_VDEV, FTAG);
+		mutex_exit(&ztest_vdev_lock);
+		return;
+	}
+
+	top = ztest_random_vdev_top(spa, B_FALSE);
+	tvd = rvd->vdev_child[top];
+
+	/*
+	 * Only plain raidz vdevs can be expanded.  Limit each one to two
+	 * additional children so the pool doesn't grow without bound.
+	 */
+	if (tvd->vdev_ops != &vdev_raidz_ops ||
+	    tvd->vdev_children >= leaves + 2) {
+		spa_config_exit(spa, SCL_VDEV, FTAG);
+		mutex_exit(&ztest_vdev_lock);
+		return;
+	}
+
+	guid = tvd->vdev_guid;
+	newsize = vdev_get_min_asize(tvd->vdev_child[0]);
+
+	expected_error = 0;
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		if (rvd->vdev_child[c]->vdev_rz_expanding)
+			expected_error = ZFS_ERR_RAIDZ_EXPAND_IN_PROGRESS;
+	}
+
+	/*
+	 * Name the new child after its top-level vdev and position, with
+	 * a suffix that none of the other tests use.
+	 */
+	(void) snprintf(newpath, sizeof (newpath), ztest_dev_template,
+	    ztest_opts.zo_dir, ztest_opts.zo_pool,
+	    top * (leaves + 2) + tvd->vdev_children);
+	newpath[strlen(newpath) - 1] = 'x';
+
+	spa_config_exit(spa, SCL_VDEV, FTAG);
+
+	root = make_vdev_root(newpath, NULL, NULL, newsize, ashift,
+	    NULL, 0, 0, 1);
+
+	error = spa_vdev_attach(spa, guid, root, B_FALSE);
+
+	nvlist_free(root);
+
+	/*
+	 * A resilver in progress, or a LUN grown by ztest_vdev_LUN_growth()
+	 * since we sized the new device, are not errors.
+	 */
+	if (error == EBUSY || error == EOVERFLOW)
+		expected_error = error;
+
+	if (error == ZFS_ERR_CHECKPOINT_EXISTS ||
+	    error == ZFS_ERR_DISCARDING_CHECKPOINT)
+		expected_error = error;
+
+	if (error != expected_error) {
+		fatal(0, "raidz attach (%s %llu) returned %d, expected %d",
+		    newpath, (u_longlong_t)newsize, error, expected_error);
+	}
+
+	if (ztest_opts.zo_verbose >= 5 && error == 0) {
+		(void) printf("expanding raidz vdev %llu with %s\n",
+		    (u_longlong_t)top, newpath);
+	}
+
+	mutex_exit(&ztest_vdev_lock);
+}
+
 /* ARGSUSED */
 void
 ztest_device_removal(ztest_ds_t *zd, uint64_t id)
@@ -4745,6 +4904,85 @@ ztest_dmu_prealloc(ztest_ds_t *zd, uint64_t id)
 	umem_free(data, blocksize);
 }
 
+/*
+ * Verify that blocks cloned with dmu_brt_clone() read back the same as
+ * the source range, both before and after the clone is synced.
+ */
+#define	ZTEST_CLONE_MAX_BLOCKS	8
+
+void
+ztest_dmu_clone_range(ztest_ds_t *zd, uint64_t id)
+{
+	objset_t *os = zd->zd_os;
+	spa_t *spa = dmu_objset_spa(os);
+	ztest_od_t od[1];
+	blkptr_t bps[ZTEST_CLONE_MAX_BLOCKS];
+	uint64_t blocksize = ztest_random_blocksize();
+	uint64_t nblocks = ztest_random(ZTEST_CLONE_MAX_BLOCKS) + 1;
+	uint64_t length = nblocks * blocksize;
+	uint64_t srcoff = 0;
+	uint64_t dstoff = ZTEST_CLONE_MAX_BLOCKS * blocksize;
+	uint64_t object, txg;
+	size_t nbps;
+	uint64_t *data, *copy;
+	dmu_tx_t *tx;
+	int error;
+
+	if (!spa_feature_is_enabled(spa, SPA_FEATURE_BLOCK_CLONING))
+		return;
+
+	ztest_od_init(&od[0], id, FTAG, 0, DMU_OT_UINT64_OTHER, blocksize,
+	    0, 0);
+
+	if (ztest_object_init(zd, od, sizeof (od), B_TRUE) != 0)
+		return;
+
+	object = od[0].od_object;
+	data = umem_alloc(length, UMEM_NOFAIL);
+	copy = umem_alloc(length, UMEM_NOFAIL);
+
+	for (uint64_t i = 0; i < length / sizeof (uint64_t); i++)
+		data[i] = (id << 48) ^ (object << 32) ^ i;
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_write(tx, object, srcoff, length);
+	txg = ztest_tx_assign(tx, TXG_WAIT, FTAG);
+	if (txg == 0)
+		goto out;
+	dmu_write(os, object, srcoff, length, data, tx);
+	dmu_tx_commit(tx);
+
+	/*
+	 * Only blocks that are on disk can be cloned; wait for them to
+	 * get there.
+	 */
+	txg_wait_synced(dmu_objset_pool(os), txg);
+
+	error = dmu_read_l0_bps(os, object, srcoff, length, bps, &nbps);
+	if (error == EAGAIN)
+		goto out;
+	ASSERT0(error);
+	ASSERT3U(nbps, ==, nblocks);
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_clone(tx, object, dstoff, length);
+	txg = ztest_tx_assign(tx, TXG_WAIT, FTAG);
+	if (txg == 0)
+		goto out;
+	dmu_brt_clone(os, object, dstoff, length, tx, bps, nbps);
+	dmu_tx_commit(tx);
+
+	txg_wait_synced(dmu_objset_pool(os), txg);
+
+	VERIFY0(dmu_read(os, object, dstoff, length, copy,
+	    DMU_READ_NO_PREFETCH));
+	VERIFY0(bcmp(data, copy, length));
+
+out:
+	umem_free(copy, length);
+	umem_free(data, length);
+}
+
 /*
  * Verify that zap_{create,destroy,add,remove,update} work as expected.
  */
@@ -6534,6 +6772,13 @@ ztest_run(ztest_shared_t *zs)
 	kernel_init(FREAD | FWRITE);
 	VERIFY0(spa_open(ztest_opts.zo_pool, &spa, FTAG));
 	metaslab_preload_limit = ztest_random(20) + 1;
+
+	/*
+	 * Keep the dedup logs small, so that they are swapped and flushed
+	 * many times over the course of a run.
+	 */
+	zfs_dedup_log_txg_max = ztest_random(4) + 1;
+	zfs_dedup_log_flush_entries_min = ztest_random(100) + 1;
 	ztest_spa = spa;
 
 	dmu_objset_stats_t dds;
@@ -6676,20 +6921,61 @@ ztest_run(ztest_shared_t *zs)
 	mutex_destroy(&ztest_checkpoint_lock);
 }
 
+/*
+ * The number of threads that write and commit log records at the same time
+ * while the pool is frozen, and the number of commits each of them makes.
+ */
+#define	ZTEST_FREEZE_THREADS	8
+#define	ZTEST_FREEZE_COMMITS	16
+
+static void *
+ztest_freeze_thread(void *arg)
+{
+	ztest_ds_t *zd = &ztest_ds[0];
+	uint64_t id = (uintptr_t)arg;
+	ztest_od_t od;
+
+	/*
+	 * Each thread has an object of its own, so that its commits only
+	 * have to wait for its own records.
+	 */
+	ztest_od_init(&od, id, FTAG, 0, DMU_OT_UINT64_OTHER, 0, 0, 0);
+	VERIFY0(ztest_object_init(zd, &od, sizeof (od), B_FALSE));
+
+	for (int i = 0; i < ZTEST_FREEZE_COMMITS; i++) {
+		ztest_io(zd, od.od_object,
+		    ztest_random(ZTEST_RANGE_LOCKS) << SPA_MAXBLOCKSHIFT);
+		zil_commit(zd->zd_zilog, od.od_object);
+	}
+
+	return (NULL);
+}
+
 static void
 ztest_freeze(void)
 {
 	ztest_ds_t *zd = &ztest_ds[0];
+	thread_t tid[ZTEST_FREEZE_THREADS];
 	spa_t *spa;
 	int numloops = 0;
 
 	if (ztest_opts.zo_verbose >= 3)
 		(void) printf("testing spa_freeze()...\n");
 
+	/*
+	 * The itxs of concurrent writers are spread over several sublists,
+	 * and must be merged back in order when they are committed.  The
+	 * number of sublists is fixed when the zilog is allocated, so choose
+	 * it before the dataset is opened.
+	 */
+	zil_itx_sublists = 2 + ztest_random(ZIL_ITX_SUBLISTS_MAX - 1);
+
 	kernel_init(FREAD | FWRITE);
 	VERIFY3U(0, ==, spa_open(ztest_opts.zo_pool, &spa, FTAG));
 	VERIFY3U(0, ==, ztest_dataset_open(0));
 	ztest_spa = spa;
+	VERIFY3U(zd->zd_zilog->zl_itx_nsublists, ==,
+	    MIN(zil_itx_sublists, boot_ncpus));
 
 	/*
 	 * Force the first log block to be transactionally allocated.
@@ -6737,6 +7023,21 @@ ztest_freeze(void)
 		txg_wait_synced(spa_get_dsl(spa), 0);
 	}
 
+	/*
+	 * Then have several threads write and commit at once, so that the
+	 * log holds records assigned to different sublists and written out
+	 * by concurrent commits.  Replaying it when the pool is opened again
+	 * verifies that none of them was lost or reordered.
+	 */
+	if (metaslab_class_get_alloc(spa_normal_class(spa)) < capacity) {
+		for (int t = 0; t < ZTEST_FREEZE_THREADS; t++) {
+			VERIFY0(thr_create(0, 0, ztest_freeze_thread,
+			    (void *)(uintptr_t)(t + 1), THR_BOUND, &tid[t]));
+		}
+		for (int t = 0; t < ZTEST_FREEZE_THREADS; t++)
+			VERIFY0(thr_join(tid[t], NULL, NULL));
+	}
+
 	/*
 	 * Commit all of the changes we just generated.
 	 */
@@ -6857,6 +7158,37 @@ ztest_import(ztest_shared_t *zs)
  * Create a storage pool with the given name and initial vdev size.
  * Then test spa_freeze() functionality.
  */
+/*
+ * Add the distributed spares of the initial dRAID vdev to the pool's list
+ * of hot spares, so that replacing one of its children may use them.
+ */
+static void
+ztest_add_draid_spares(nvlist_t *nvroot)
+{
+	int nspares = ztest_opts.zo_draid_spares;
+	nvlist_t **spares;
+
+	spares = umem_alloc(nspares * sizeof (nvlist_t *), UMEM_NOFAIL);
+	for (int s = 0; s < nspares; s++) {
+		char path[MAXPATHLEN];
+
+		(void) snprintf(path, sizeof (path), VDEV_DRAID_SPARE_PATH_FMT,
+		    (u_longlong_t)ztest_opts.zo_raidz_parity, 0ULL,
+		    (u_longlong_t)s);
+		VERIFY(nvlist_alloc(&spares[s], NV_UNIQUE_NAME, 0) == 0);
+		VERIFY(nvlist_add_string(spares[s], ZPOOL_CONFIG_TYPE,
+		    VDEV_TYPE_DRAID_SPARE) == 0);
+		VERIFY(nvlist_add_string(spares[s], ZPOOL_CONFIG_PATH,
+		    path) == 0);
+	}
+	VERIFY(nvlist_add_nvlist_array(nvroot, ZPOOL_CONFIG_SPARES,
+	    spares, nspares) == 0);
+
+	for (int s = 0; s < nspares; s++)
+		nvlist_free(spares[s]);
+	umem_free(spares, nspares * sizeof (nvlist_t *));
+}
+
 static void
 ztest_init(ztest_shared_t *zs)
 {
@@ -6878,6 +7210,8 @@ ztest_init(ztest_shared_t *zs)
 	zs->zs_mirrors = ztest_opts.zo_mirrors;
 	nvroot = make_vdev_root(NULL, NULL, NULL, ztest_opts.zo_vdev_size, 0,
 	    NULL, ztest_opts.zo_raidz, zs->zs_mirrors, 1);
+	if (strcmp(ztest_opts.zo_raid_type, VDEV_TYPE_DRAID) == 0)
+		ztest_add_draid_spares(nvroot);
 	props = make_random_props();
 	for (int i = 0; i < SPA_FEATURES; i++) {
 		char buf[1024];
@@ -6890,6 +7224,13 @@ ztest_init(ztest_shared_t *zs)
 		if (i == SPA_FEATURE_LOG_SPACEMAP && ztest_random(4) == 0)
 			continue;
 
+		/*
+		 * Likewise for the dedup log, so that the DDT is updated
+		 * both directly and through the log.
+		 */
+		if (i == SPA_FEATURE_DEDUP_LOG && ztest_random(4) == 0)
+			continue;
+
 		(void) snprintf(buf, sizeof (buf), "feature@%s",
 		    spa_feature_table[i].fi_uname);
 		VERIFY3U(0, ==, nvlist_add_uint64(props, buf, 0));
@@ -52,8 +52,21 @@
 static const char _CTF_STRTAB_TEMPLATE[] = "\0PARENT";
 
 /*
- * To create an empty CTF container, we just declare a zeroed header and call
- * ctf_bufopen() on it.  If ctf_bufopen succeeds, we mark the new container r/w
+ * This is the CTF data of an empty container: a header followed by a name
+ * index that is zero-filled beyond its length, and so is ignored by
+ * ctf_bufopen() in favour of the (empty) type data.
+ */
+static const struct {
+	ctf_header_t ce_hdr;
+	ctf_index_t ce_idx;
+} _CTF_EMPTY_TEMPLATE = {
+	{ { CTF_MAGIC, CTF_VERSION, 0 } },
+	{ sizeof (ctf_index_t) }
+};
+
+/*
+ * To create an empty CTF container, we just call ctf_bufopen() on the empty
+ * template above.  If ctf_bufopen succeeds, we mark the new container r/w
  * and initialize the dynamic members.  We set dtstrlen to 1 to reserve the
  * first byte of the string table for a \0 byte, and we start assigning type
  * IDs at 1 because type ID 0 is used as a sentinel.
@@ -61,8 +74,6 @@ static const char _CTF_STRTAB_TEMPLATE[] = "\0PARENT";
 ctf_file_t *
 ctf_create(int *errp)
 {
-	static const ctf_header_t hdr = { { CTF_MAGIC, CTF_VERSION, 0 } };
-
 	const ulong_t hashlen = 128;
 	ctf_dtdef_t **hash = ctf_alloc(hashlen * sizeof (ctf_dtdef_t *));
 	ctf_sect_t cts;
@@ -74,8 +85,8 @@ ctf_create(int *errp)
 	cts.cts_name = _CTF_SECTION;
 	cts.cts_type = SHT_PROGBITS;
 	cts.cts_flags = 0;
-	cts.cts_data = &hdr;
-	cts.cts_size = sizeof (hdr);
+	cts.cts_data = &_CTF_EMPTY_TEMPLATE;
+	cts.cts_size = sizeof (_CTF_EMPTY_TEMPLATE);
 	cts.cts_entsize = 1;
 	cts.cts_offset = 0;
 
@@ -99,8 +110,6 @@ ctf_file_t *
 ctf_fdcreate(int fd, int *errp)
 {
 	ctf_file_t *fp;
-	static const ctf_header_t hdr = { { CTF_MAGIC, CTF_VERSION, 0 } };
-
 	const ulong_t hashlen = 128;
 	ctf_dtdef_t **hash;
 	ctf_sect_t cts;
@@ -116,8 +125,8 @@ ctf_fdcreate(int fd, int *errp)
 	cts.cts_name = _CTF_SECTION;
 	cts.cts_type = SHT_PROGBITS;
 	cts.cts_flags = 0;
-	cts.cts_data = &hdr;
-	cts.cts_size = sizeof (hdr);
+	cts.cts_data = &_CTF_EMPTY_TEMPLATE;
+	cts.cts_size = sizeof (_CTF_EMPTY_TEMPLATE);
 	cts.cts_entsize = 1;
 	cts.cts_offset = 0;
 
@@ -264,6 +273,114 @@ ctf_ref_dec(ctf_file_t *fp, ctf_id_t tid)
 	dtd->dtd_ref--;
 }
 
+/*
+ * Return the space to reserve for the name index of a container with nnames
+ * type names, whose lengths along with those of the parent name and label
+ * come to strsize bytes.  Each name is in at most one of the hash tables, so
+ * this is an upper bound on what ctf_index_write() will use.
+ */
+static size_t
+ctf_index_size(size_t nnames, size_t strsize)
+{
+	size_t size = sizeof (ctf_index_t);
+
+	size += CTF_IDX_MAX *
+	    P2ROUNDUP(sizeof (ushort_t) * CTF_HASH_NBUCKETS, sizeof (uint_t));
+	size += (nnames + CTF_IDX_MAX) * sizeof (ctf_idxelem_t);
+	size += sizeof (_CTF_STRTAB_TEMPLATE) + strsize;
+
+	return (P2ROUNDUP(size, sizeof (uint_t)));
+}
+
+/*
+ * Fill in the name index of a newly opened container from the hash tables that
+ * ctf_bufopen() has just built for it, which the index mirrors exactly.  The
+ * index was zero-filled and sized by ctf_update() using ctf_index_size().
+ */
+static void
+ctf_index_write(ctf_file_t *fp, ctf_index_t *cip)
+{
+	const ctf_hash_t *hashes[CTF_IDX_MAX];
+	uchar_t *base = (uchar_t *)cip;
+	char *s, *s0;
+	uint_t off, t, i;
+
+	hashes[CTF_IDX_STRUCT] = &fp->ctf_structs;
+	hashes[CTF_IDX_UNION] = &fp->ctf_unions;
+	hashes[CTF_IDX_ENUM] = &fp->ctf_enums;
+	hashes[CTF_IDX_NAMES] = &fp->ctf_names;
+
+	/*
+	 * Lay out the bucket and element arrays of each hash table, and then
+	 * the string table, whose first byte is left as \0.
+	 */
+	off = sizeof (ctf_index_t);
+	for (t = 0; t < CTF_IDX_MAX; t++) {
+		const ctf_hash_t *hp = hashes[t];
+		ctf_idxtab_t *cit = &cip->cti_tabs[t];
+
+		cit->cit_nbuckets = hp->h_nbuckets;
+		cit->cit_nelems = hp->h_free;
+		cit->cit_bucketoff = off;
+		bcopy(hp->h_buckets, base + off,
+		    sizeof (ushort_t) * hp->h_nbuckets);
+		off += P2ROUNDUP(sizeof (ushort_t) * hp->h_nbuckets,
+		    sizeof (uint_t));
+		cit->cit_elemoff = off;
+		off += sizeof (ctf_idxelem_t) * cit->cit_nelems;
+	}
+
+	cip->cti_stroff = off;
+	s0 = (char *)base + off;
+	s = s0 + 1;
+
+	/*
+	 * Copy out the elements, and the names that they refer to, leaving the
+	 * sentinel element zero-filled.
+	 */
+	for (t = 0; t < CTF_IDX_MAX; t++) {
+		const ctf_hash_t *hp = hashes[t];
+		const ctf_idxtab_t *cit = &cip->cti_tabs[t];
+		/* LINTED - pointer alignment */
+		ctf_idxelem_t *cie = (ctf_idxelem_t *)(base + cit->cit_elemoff);
+
+		for (i = 1; i < cit->cit_nelems; i++) {
+			const ctf_helem_t *hep = &hp->h_chains[i];
+			const char *name = ctf_strptr(fp, hep->h_name);
+			size_t len = strlen(name) + 1;
+
+			VERIFY((uchar_t *)s + len <= base + cip->cti_len);
+			bcopy(name, s, len);
+			cie[i].cie_name = s - s0;
+			cie[i].cie_type = hep->h_type;
+			cie[i].cie_next = hep->h_next;
+			s += len;
+		}
+	}
+
+	if (fp->ctf_parname != NULL) {
+		size_t len = strlen(fp->ctf_parname) + 1;
+
+		VERIFY((uchar_t *)s + len <= base + cip->cti_len);
+		bcopy(fp->ctf_parname, s, len);
+		cip->cti_parname = s - s0;
+		s += len;
+	}
+
+	if (fp->ctf_parlabel != NULL) {
+		size_t len = strlen(fp->ctf_parlabel) + 1;
+
+		VERIFY((uchar_t *)s + len <= base + cip->cti_len);
+		bcopy(fp->ctf_parlabel, s, len);
+		cip->cti_parlabel = s - s0;
+		s += len;
+	}
+
+	cip->cti_strlen = s - s0;
+	if (fp->ctf_flags & LCTF_CHILD)
+		cip->cti_flags |= CTF_IDX_F_CHILD;
+}
+
 /*
  * If the specified CTF container is writable and has been modified, reload
  * this container with the updated type definitions.  In order to make this
@@ -288,6 +405,7 @@ ctf_update(ctf_file_t *fp)
 {
 	ctf_file_t ofp, *nfp;
 	ctf_header_t hdr, *bhdr;
+	ctf_index_t *cip;
 	ctf_dtdef_t *dtd;
 	ctf_dsdef_t *dsd;
 	ctf_dldef_t *dld;
@@ -297,6 +415,7 @@ ctf_update(ctf_file_t *fp)
 	ctf_lblent_t *label;
 	uint16_t *obj, *func;
 	size_t size, objsize, funcsize, labelsize, plen;
+	size_t hdrsz, nnames, namelen;
 	void *buf;
 	int err;
 	ulong_t i;
@@ -345,14 +464,21 @@ ctf_update(ctf_file_t *fp)
 
 	/*
 	 * Iterate through the dynamic type definition list and compute the
-	 * size of the CTF type section we will need to generate.
+	 * size of the CTF type section we will need to generate, along with
+	 * the number and length of the type names for the name index.
 	 */
-	for (size = 0, dtd = ctf_list_next(&fp->ctf_dtdefs);
+	for (size = 0, nnames = 0, namelen = 0,
+	    dtd = ctf_list_next(&fp->ctf_dtdefs);
 	    dtd != NULL; dtd = ctf_list_next(dtd)) {
 
 		uint_t kind = CTF_INFO_KIND(dtd->dtd_data.ctt_info);
 		uint_t vlen = CTF_INFO_VLEN(dtd->dtd_data.ctt_info);
 
+		if (dtd->dtd_name != NULL) {
+			nnames++;
+			namelen += strlen(dtd->dtd_name) + 1;
+		}
+
 		if (dtd->dtd_data.ctt_size != CTF_LSIZE_SENT)
 			size += sizeof (ctf_stype_t);
 		else
@@ -442,29 +568,35 @@ ctf_update(ctf_file_t *fp)
 
 	/*
 	 * Fill in the string table offset and size, compute the size of the
-	 * entire CTF buffer we need, and then allocate a new buffer and
-	 * bcopy the finished header to the start of the buffer.
+	 * entire CTF buffer we need, including the space for the name index
+	 * that follows the header, and then allocate a new buffer and bcopy
+	 * the finished header to the start of the buffer.  The index itself
+	 * is filled in once the new container has been opened, below.
 	 */
 	hdr.cth_stroff = hdr.cth_typeoff + size;
 	hdr.cth_strlen = fp->ctf_dtstrlen + plen;
-	size = sizeof (ctf_header_t) + hdr.cth_stroff + hdr.cth_strlen;
+	hdrsz = sizeof (ctf_header_t) + ctf_index_size(nnames,
+	    namelen + plen + (plabel != NULL ? strlen(plabel) + 1 : 0));
+	size = hdrsz + hdr.cth_stroff + hdr.cth_strlen;
 	ctf_dprintf("lbloff: %u\nobjtoff: %u\nfuncoff: %u\n"
-	    "typeoff: %u\nstroff: %u\nstrlen: %u\n",
+	    "typeoff: %u\nstroff: %u\nstrlen: %u\nidxlen: %lu\n",
 	    hdr.cth_lbloff, hdr.cth_objtoff, hdr.cth_funcoff,
-	    hdr.cth_typeoff, hdr.cth_stroff, hdr.cth_strlen);
+	    hdr.cth_typeoff, hdr.cth_stroff, hdr.cth_strlen,
+	    (ulong_t)(hdrsz - sizeof (ctf_header_t)));
 
 	if ((buf = ctf_data_alloc(size)) == MAP_FAILED)
 		return (ctf_set_errno(fp, EAGAIN));
 
 	bcopy(&hdr, buf, sizeof (ctf_header_t));
 	bhdr = buf;
-	label = (ctf_lblent_t *)((uintptr_t)buf + sizeof (ctf_header_t));
-	t = (uchar_t *)buf + sizeof (ctf_header_t) + hdr.cth_typeoff;
-	s = s0 = (uchar_t *)buf + sizeof (ctf_header_t) + hdr.cth_stroff;
-	obj = (uint16_t *)((uintptr_t)buf + sizeof (ctf_header_t) +
-	    hdr.cth_objtoff);
-	func = (uint16_t *)((uintptr_t)buf + sizeof (ctf_header_t) +
-	    hdr.cth_funcoff);
+	cip = (ctf_index_t *)((uintptr_t)buf + sizeof (ctf_header_t));
+	bzero(cip, hdrsz - sizeof (ctf_header_t));
+	cip->cti_len = hdrsz - sizeof (ctf_header_t);
+	label = (ctf_lblent_t *)((uintptr_t)buf + hdrsz);
+	t = (uchar_t *)buf + hdrsz + hdr.cth_typeoff;
+	s = s0 = (uchar_t *)buf + hdrsz + hdr.cth_stroff;
+	obj = (uint16_t *)((uintptr_t)buf + hdrsz + hdr.cth_objtoff);
+	func = (uint16_t *)((uintptr_t)buf + hdrsz + hdr.cth_funcoff);
 
 	bcopy(_CTF_STRTAB_TEMPLATE, s, sizeof (_CTF_STRTAB_TEMPLATE));
 	s += sizeof (_CTF_STRTAB_TEMPLATE);
@@ -642,10 +774,11 @@ ctf_update(ctf_file_t *fp)
 	}
 
 	/*
-	 * Finally, we are ready to ctf_bufopen() the new container.  If this
-	 * is successful, we then switch nfp and fp and free the old container.
+	 * Finally, we are ready to ctf_bufopen() the new container.  As its
+	 * name index is still zero-filled, it is loaded immediately, and we
+	 * then build the index from its hash tables.  If this is successful,
+	 * we then switch nfp and fp and free the old container.
 	 */
-	ctf_data_protect(buf, size);
 	cts.cts_name = _CTF_SECTION;
 	cts.cts_type = SHT_PROGBITS;
 	cts.cts_flags = 0;
@@ -667,6 +800,9 @@ ctf_update(ctf_file_t *fp)
 		return (ctf_set_errno(fp, err));
 	}
 
+	ctf_index_write(nfp, cip);
+	ctf_data_protect(buf, size);
+
 	(void) ctf_setmodel(nfp, ctf_getmodel(fp));
 	(void) ctf_import(nfp, fp->ctf_parent);
 
@@ -2104,6 +2240,8 @@ ctf_add_object(ctf_file_t *fp, ulong_t idx, ctf_id_t type)
 void
 ctf_dataptr(ctf_file_t *fp, const void **addrp, size_t *sizep)
 {
+	(void) ctf_load(fp);
+
 	if (addrp != NULL)
 		*addrp = fp->ctf_base;
 	if (sizep != NULL)
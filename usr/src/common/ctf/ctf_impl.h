@@ -67,12 +67,19 @@
 extern "C" {
 #endif
 
+/*
+ * The layout of a ctf_helem_t matches that of the ctf_idxelem_t in the name
+ * index of a CTF_VERSION_3 container, so that the hash tables of a container
+ * that has yet to be loaded can refer directly to the mapped index.
+ */
 typedef struct ctf_helem {
 	uint_t h_name;		/* reference to name in string table */
 	ushort_t h_type;	/* corresponding type ID number */
 	ushort_t h_next;	/* index of next element in hash chain */
 } ctf_helem_t;
 
+#define	CTF_HASH_NBUCKETS	211	/* a prime number of hash buckets */
+
 typedef struct ctf_hash {
 	ushort_t *h_buckets;	/* hash bucket array (chain indices) */
 	ctf_helem_t *h_chains;	/* hash chains buffer */
@@ -254,6 +261,11 @@ struct ctf_file {
  * and libctf should free it with ctf_data_free() on close.
  */
 #define	LCTF_FREE	0x0010
+/*
+ * The CTF data has yet to be decompressed and processed: only the hash tables,
+ * which refer to the container's name index, may be used.  See ctf_load().
+ */
+#define	LCTF_LAZY	0x0020
 
 #define	CTF_ELF_SCN_NAME	".SUNW_ctf"
 
@@ -264,6 +276,8 @@ extern void ctf_set_ctt_size(ctf_type_t *, ssize_t);
 
 extern const ctf_type_t *ctf_lookup_by_id(ctf_file_t **, ctf_id_t);
 
+extern int ctf_load(ctf_file_t *);
+
 extern ctf_file_t *ctf_fdcreate_int(int, int *, ctf_sect_t *);
 
 extern int ctf_hash_create(ctf_hash_t *, ulong_t);
@@ -39,6 +39,9 @@ extract_label_info(ctf_file_t *fp, const ctf_lblent_t **ctl, uint_t *num_labels)
 	if (fp->ctf_version < CTF_VERSION_2)
 		return (ctf_set_errno(fp, ECTF_NOTSUP));
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
 	h = (const ctf_header_t *)fp->ctf_data.cts_data;
 
 	/* LINTED - pointer alignment */
@@ -102,6 +102,9 @@ ctf_lookup_by_name(ctf_file_t *fp, const char *name)
 			q = end; /* compare until end */
 
 		if (*p == '*') {
+			if (ctf_load(fp) == CTF_ERR)
+				goto err;
+
 			/*
 			 * Find a pointer to type by looking in fp->ctf_ptrtab.
 			 * If we can't find a pointer to the given type, see if
@@ -187,6 +190,9 @@ ctf_lookup_by_symbol(ctf_file_t *fp, ulong_t symidx)
 	if (sp->cts_data == NULL)
 		return (ctf_set_errno(fp, ECTF_NOSYMTAB));
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
 	if (symidx >= fp->ctf_nsyms)
 		return (ctf_set_errno(fp, EINVAL));
 
@@ -226,6 +232,9 @@ ctf_lookup_by_id(ctf_file_t **fpp, ctf_id_t type)
 		return (NULL);
 	}
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (NULL); /* errno is set for us */
+
 	type = CTF_TYPE_TO_INDEX(type);
 	if (type > 0 && type <= fp->ctf_typemax) {
 		*fpp = fp; /* function returns ending CTF container */
@@ -250,6 +259,9 @@ ctf_func_info(ctf_file_t *fp, ulong_t symidx, ctf_funcinfo_t *fip)
 	if (sp->cts_data == NULL)
 		return (ctf_set_errno(fp, ECTF_NOSYMTAB));
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
 	if (symidx >= fp->ctf_nsyms)
 		return (ctf_set_errno(fp, EINVAL));
 
@@ -85,6 +85,7 @@ static const ctf_fileops_t ctf_fileops[] = {
 	{ NULL, NULL },
 	{ get_kind_v1, get_root_v1, get_vlen_v1 },
 	{ get_kind_v2, get_root_v2, get_vlen_v2 },
+	{ get_kind_v2, get_root_v2, get_vlen_v2 },
 };
 
 /*
@@ -535,6 +536,301 @@ init_types(ctf_file_t *fp, const ctf_header_t *cth)
 	return (0);
 }
 
+/*
+ * Validate the name index of a CTF_VERSION_3 container.  We check that each
+ * hash table lies within the index, and that every bucket, chain link and name
+ * refers to something within it, so that lookups through the index need no
+ * further checking.  Chain links must refer to earlier elements, which is how
+ * ctf_hash_insert() builds them and which rules out cycles.  An index that has
+ * been left zero-filled by its producer fails these checks.
+ */
+static boolean_t
+valid_index(const ctf_index_t *cip)
+{
+	const uchar_t *base = (const uchar_t *)cip;
+	const char *strs;
+	uint_t t, i;
+
+	if (((uintptr_t)cip & 3) != 0 ||
+	    cip->cti_stroff < sizeof (ctf_index_t) ||
+	    cip->cti_stroff > cip->cti_len || cip->cti_strlen == 0 ||
+	    cip->cti_strlen > cip->cti_len - cip->cti_stroff)
+		return (B_FALSE);
+
+	strs = (const char *)base + cip->cti_stroff;
+
+	if (strs[0] != '\0' || strs[cip->cti_strlen - 1] != '\0' ||
+	    cip->cti_parlabel >= cip->cti_strlen ||
+	    cip->cti_parname >= cip->cti_strlen)
+		return (B_FALSE);
+
+	for (t = 0; t < CTF_IDX_MAX; t++) {
+		const ctf_idxtab_t *cit = &cip->cti_tabs[t];
+		const ushort_t *buckets;
+		const ctf_idxelem_t *elems;
+
+		if (cit->cit_nbuckets == 0 || cit->cit_nbuckets > USHRT_MAX ||
+		    cit->cit_nelems > USHRT_MAX ||
+		    (cit->cit_bucketoff & 1) != 0 ||
+		    (cit->cit_elemoff & 3) != 0 ||
+		    cit->cit_bucketoff > cip->cti_stroff ||
+		    cit->cit_elemoff > cip->cti_stroff ||
+		    cit->cit_nbuckets > (cip->cti_stroff -
+		    cit->cit_bucketoff) / sizeof (ushort_t) ||
+		    cit->cit_nelems > (cip->cti_stroff -
+		    cit->cit_elemoff) / sizeof (ctf_idxelem_t))
+			return (B_FALSE);
+
+		/* LINTED - pointer alignment */
+		buckets = (const ushort_t *)(base + cit->cit_bucketoff);
+		/* LINTED - pointer alignment */
+		elems = (const ctf_idxelem_t *)(base + cit->cit_elemoff);
+
+		for (i = 0; i < cit->cit_nbuckets; i++) {
+			if (buckets[i] != 0 && buckets[i] >= cit->cit_nelems)
+				return (B_FALSE);
+		}
+
+		for (i = 1; i < cit->cit_nelems; i++) {
+			if (elems[i].cie_name == 0 ||
+			    elems[i].cie_name >= cip->cti_strlen ||
+			    elems[i].cie_type == 0 || elems[i].cie_next >= i)
+				return (B_FALSE);
+		}
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Point the hash tables of the container at its name index, so that they can
+ * be used by ctf_lookup_by_name() before the container is loaded.  The names
+ * the index refers to are in its own string table, which stands in for the
+ * CTF string table until ctf_load() is called.
+ */
+static void
+init_index(ctf_file_t *fp, const ctf_index_t *cip)
+{
+	const char *strs = (const char *)cip + cip->cti_stroff;
+	ctf_hash_t *hashes[CTF_IDX_MAX];
+	uint_t t;
+
+	hashes[CTF_IDX_STRUCT] = &fp->ctf_structs;
+	hashes[CTF_IDX_UNION] = &fp->ctf_unions;
+	hashes[CTF_IDX_ENUM] = &fp->ctf_enums;
+	hashes[CTF_IDX_NAMES] = &fp->ctf_names;
+
+	for (t = 0; t < CTF_IDX_MAX; t++) {
+		const ctf_idxtab_t *cit = &cip->cti_tabs[t];
+		ctf_hash_t *hp = hashes[t];
+
+		/* LINTED - pointer alignment */
+		hp->h_buckets = (ushort_t *)((uintptr_t)cip +
+		    cit->cit_bucketoff);
+		/* LINTED - pointer alignment */
+		hp->h_chains = cit->cit_nelems == 0 ? NULL :
+		    (ctf_helem_t *)((uintptr_t)cip + cit->cit_elemoff);
+		hp->h_nbuckets = (ushort_t)cit->cit_nbuckets;
+		hp->h_nelems = (ushort_t)cit->cit_nelems;
+		hp->h_free = cit->cit_nelems;
+	}
+
+	fp->ctf_str[CTF_STRTAB_0].cts_strs = strs;
+	fp->ctf_str[CTF_STRTAB_0].cts_len = cip->cti_strlen;
+
+	fp->ctf_parlabel = cip->cti_parlabel != 0 ?
+	    strs + cip->cti_parlabel : NULL;
+	fp->ctf_parname = cip->cti_parname != 0 ?
+	    strs + cip->cti_parname : NULL;
+
+	if (cip->cti_flags & CTF_IDX_F_CHILD)
+		fp->ctf_flags |= LCTF_CHILD;
+	fp->ctf_flags |= LCTF_LAZY;
+
+	ctf_dprintf("CTF container %p opened using its name index\n",
+	    (void *)fp);
+}
+
+/*
+ * Decompress the CTF data buffer if it is compressed, and initialize the
+ * symtab and type translation tables and the type name hash tables.  If this
+ * fails, the caller must release whatever was allocated using fini_data().
+ */
+static int
+init_data(ctf_file_t *fp, const ctf_header_t *hp, size_t hdrsz)
+{
+	const ctf_sect_t *ctfsect = &fp->ctf_data;
+	size_t size = hp->cth_stroff + hp->cth_strlen;
+	void *buf, *base;
+	int err;
+
+	/*
+	 * Attempt to decompress the CTF data buffer if it is compressed.
+	 * Otherwise we just put the data section's buffer pointer into
+	 * ctf_buf, below.  The header, and the name index if there is one,
+	 * are never compressed.
+	 */
+	if (hp->cth_flags & CTF_F_COMPRESS) {
+		size_t srclen, dstlen;
+		const void *src;
+		int rc = Z_OK;
+
+		if (ctf_zopen(&err) == NULL)
+			return (err);
+
+		if ((base = ctf_data_alloc(size + hdrsz)) == MAP_FAILED)
+			return (ECTF_ZALLOC);
+
+		bcopy(ctfsect->cts_data, base, hdrsz);
+		((ctf_preamble_t *)base)->ctp_flags &= ~CTF_F_COMPRESS;
+		buf = (uchar_t *)base + hdrsz;
+
+		src = (uchar_t *)ctfsect->cts_data + hdrsz;
+		srclen = ctfsect->cts_size - hdrsz;
+		dstlen = size;
+
+		if ((rc = z_uncompress(buf, &dstlen, src, srclen)) != Z_OK) {
+			ctf_dprintf("zlib inflate err: %s\n", z_strerror(rc));
+			ctf_data_free(base, size + hdrsz);
+			return (ECTF_DECOMPRESS);
+		}
+
+		if (dstlen != size) {
+			ctf_dprintf("zlib inflate short -- got %lu of %lu "
+			    "bytes\n", (ulong_t)dstlen, (ulong_t)size);
+			ctf_data_free(base, size + hdrsz);
+			return (ECTF_CORRUPT);
+		}
+
+		ctf_data_protect(base, size + hdrsz);
+
+	} else {
+		base = (void *)ctfsect->cts_data;
+		buf = (uchar_t *)base + hdrsz;
+	}
+
+	fp->ctf_str[CTF_STRTAB_0].cts_strs = (const char *)buf + hp->cth_stroff;
+	fp->ctf_str[CTF_STRTAB_0].cts_len = hp->cth_strlen;
+
+	fp->ctf_base = base;
+	fp->ctf_buf = buf;
+	fp->ctf_size = size + hdrsz;
+
+	/*
+	 * If we have a parent container name and label, store the relocated
+	 * string pointers in the CTF container for easy access later.
+	 */
+	fp->ctf_parlabel = hp->cth_parlabel != 0 ?
+	    ctf_strptr(fp, hp->cth_parlabel) : NULL;
+	fp->ctf_parname = hp->cth_parname != 0 ?
+	    ctf_strptr(fp, hp->cth_parname) : NULL;
+
+	ctf_dprintf("ctf_bufopen: parent name %s (label %s)\n",
+	    fp->ctf_parname ? fp->ctf_parname : "<NULL>",
+	    fp->ctf_parlabel ? fp->ctf_parlabel : "<NULL>");
+
+	/*
+	 * If we have a symbol table section, allocate and initialize
+	 * the symtab translation table, pointed to by ctf_sxlate.
+	 */
+	if (fp->ctf_symtab.cts_data != NULL) {
+		fp->ctf_nsyms =
+		    fp->ctf_symtab.cts_size / fp->ctf_symtab.cts_entsize;
+		fp->ctf_sxlate = ctf_alloc(fp->ctf_nsyms * sizeof (uint_t));
+
+		if (fp->ctf_sxlate == NULL)
+			return (EAGAIN);
+
+		if ((err = init_symtab(fp, hp, &fp->ctf_symtab,
+		    &fp->ctf_strtab)) != 0)
+			return (err);
+	}
+
+	return (init_types(fp, hp));
+}
+
+/*
+ * Release everything allocated by init_data(), leaving the container as it was
+ * before init_data() was called.  If the container hasn't been loaded, its hash
+ * tables refer to its name index and there is nothing to free.
+ */
+static void
+fini_data(ctf_file_t *fp)
+{
+	if (fp->ctf_base != fp->ctf_data.cts_data && fp->ctf_base != NULL)
+		ctf_data_free((void *)fp->ctf_base, fp->ctf_size);
+
+	if (fp->ctf_sxlate != NULL)
+		ctf_free(fp->ctf_sxlate, sizeof (uint_t) * fp->ctf_nsyms);
+
+	if (fp->ctf_txlate != NULL) {
+		ctf_free(fp->ctf_txlate,
+		    sizeof (uint_t) * (fp->ctf_typemax + 1));
+	}
+
+	if (fp->ctf_ptrtab != NULL) {
+		ctf_free(fp->ctf_ptrtab,
+		    sizeof (ushort_t) * (fp->ctf_typemax + 1));
+	}
+
+	if (!(fp->ctf_flags & LCTF_LAZY)) {
+		ctf_hash_destroy(&fp->ctf_structs);
+		ctf_hash_destroy(&fp->ctf_unions);
+		ctf_hash_destroy(&fp->ctf_enums);
+		ctf_hash_destroy(&fp->ctf_names);
+	}
+
+	fp->ctf_base = NULL;
+	fp->ctf_buf = NULL;
+	fp->ctf_size = 0;
+	fp->ctf_sxlate = NULL;
+	fp->ctf_nsyms = 0;
+	fp->ctf_txlate = NULL;
+	fp->ctf_ptrtab = NULL;
+	fp->ctf_typemax = 0;
+}
+
+/*
+ * Load a container that ctf_bufopen() opened using its name index, by doing
+ * the work that ctf_bufopen() deferred: decompressing the CTF data and building
+ * the translation and hash tables.  Opening a container and looking up types
+ * by name is therefore cheap, and only the containers whose types are actually
+ * examined pay the cost of loading.  Each of the routines that needs more than
+ * the name index calls this first.  If loading fails, the container is left as
+ * it was, and the error is returned to the caller.
+ */
+int
+ctf_load(ctf_file_t *fp)
+{
+	const ctf_index_t *cip;
+	ctf_header_t hp;
+	int err;
+
+	if (!(fp->ctf_flags & LCTF_LAZY))
+		return (0);
+
+	bcopy(fp->ctf_data.cts_data, &hp, sizeof (hp));
+	cip = (const ctf_index_t *)((uintptr_t)fp->ctf_data.cts_data +
+	    sizeof (ctf_header_t));
+
+	ctf_dprintf("ctf_load: loading CTF container %p\n", (void *)fp);
+
+	fp->ctf_flags &= ~LCTF_LAZY;
+	bzero(&fp->ctf_structs, sizeof (ctf_hash_t));
+	bzero(&fp->ctf_unions, sizeof (ctf_hash_t));
+	bzero(&fp->ctf_enums, sizeof (ctf_hash_t));
+	bzero(&fp->ctf_names, sizeof (ctf_hash_t));
+
+	if ((err = init_data(fp, &hp,
+	    sizeof (ctf_header_t) + cip->cti_len)) != 0) {
+		fini_data(fp);
+		init_index(fp, cip);
+		return (ctf_set_errno(fp, err));
+	}
+
+	return (0);
+}
+
 /*
  * Decode the specified CTF buffer and optional symbol table and create a new
  * CTF container representing the symbolic debugging information.  This code
@@ -546,12 +842,11 @@ ctf_bufopen(const ctf_sect_t *ctfsect, const ctf_sect_t *symsect,
     const ctf_sect_t *strsect, int *errp)
 {
 	const ctf_preamble_t *pp;
+	const ctf_index_t *cip = NULL;
 	ctf_header_t hp;
 	ctf_file_t *fp;
-	void *buf, *base;
 	size_t size, hdrsz;
 	int err;
-	uint_t hflags;
 
 	if (ctfsect == NULL || ((symsect == NULL) != (strsect == NULL)))
 		return (ctf_set_open_errno(errp, EINVAL));
@@ -575,7 +870,7 @@ ctf_bufopen(const ctf_sect_t *ctfsect, const ctf_sect_t *symsect,
 	    pp->ctp_magic, pp->ctp_version);
 
 	/*
-	 * Validate each part of the CTF header (either V1 or V2).
+	 * Validate each part of the CTF header (V1, V2 or V3).
 	 * First, we validate the preamble (common to all versions).  At that
 	 * point, we know specific header version, and can validate the
 	 * version-specific parts including section offsets and alignments.
@@ -583,13 +878,36 @@ ctf_bufopen(const ctf_sect_t *ctfsect, const ctf_sect_t *symsect,
 	if (pp->ctp_magic != CTF_MAGIC)
 		return (ctf_set_open_errno(errp, ECTF_NOCTFBUF));
 
-	if (pp->ctp_version == CTF_VERSION_2) {
+	if (pp->ctp_version == CTF_VERSION_2 ||
+	    pp->ctp_version == CTF_VERSION_3) {
 		if (ctfsect->cts_size < sizeof (ctf_header_t))
 			return (ctf_set_open_errno(errp, ECTF_NOCTFBUF));
 
 		bcopy(ctfsect->cts_data, &hp, sizeof (hp));
 		hdrsz = sizeof (ctf_header_t);
 
+		/*
+		 * A V3 header is followed by the name index, and the section
+		 * offsets are relative to the end of the index.
+		 */
+		if (pp->ctp_version == CTF_VERSION_3) {
+			uint_t idxlen;
+
+			if (ctfsect->cts_size < hdrsz + sizeof (ctf_index_t))
+				return (ctf_set_open_errno(errp,
+				    ECTF_NOCTFBUF));
+
+			cip = (const ctf_index_t *)
+			    ((uintptr_t)ctfsect->cts_data + hdrsz);
+			bcopy(&cip->cti_len, &idxlen, sizeof (idxlen));
+
+			if (idxlen < sizeof (ctf_index_t) || (idxlen & 3) ||
+			    idxlen > ctfsect->cts_size - hdrsz)
+				return (ctf_set_open_errno(errp, ECTF_CORRUPT));
+
+			hdrsz += idxlen;
+		}
+
 	} else if (pp->ctp_version == CTF_VERSION_1) {
 		const ctf_header_v1_t *h1p =
 		    (const ctf_header_v1_t *)ctfsect->cts_data;
@@ -629,53 +947,8 @@ ctf_bufopen(const ctf_sect_t *ctfsect, const ctf_sect_t *symsect,
 		return (ctf_set_open_errno(errp, ECTF_CORRUPT));
 
 	/*
-	 * Once everything is determined to be valid, attempt to decompress
-	 * the CTF data buffer if it is compressed.  Otherwise we just put
-	 * the data section's buffer pointer into ctf_buf, below.
-	 */
-	hflags = hp.cth_flags;
-	if (hp.cth_flags & CTF_F_COMPRESS) {
-		size_t srclen, dstlen;
-		const void *src;
-		int rc = Z_OK;
-
-		if (ctf_zopen(errp) == NULL)
-			return (NULL); /* errp is set for us */
-
-		if ((base = ctf_data_alloc(size + hdrsz)) == MAP_FAILED)
-			return (ctf_set_open_errno(errp, ECTF_ZALLOC));
-
-		bcopy(ctfsect->cts_data, base, hdrsz);
-		((ctf_preamble_t *)base)->ctp_flags &= ~CTF_F_COMPRESS;
-		buf = (uchar_t *)base + hdrsz;
-
-		src = (uchar_t *)ctfsect->cts_data + hdrsz;
-		srclen = ctfsect->cts_size - hdrsz;
-		dstlen = size;
-
-		if ((rc = z_uncompress(buf, &dstlen, src, srclen)) != Z_OK) {
-			ctf_dprintf("zlib inflate err: %s\n", z_strerror(rc));
-			ctf_data_free(base, size + hdrsz);
-			return (ctf_set_open_errno(errp, ECTF_DECOMPRESS));
-		}
-
-		if (dstlen != size) {
-			ctf_dprintf("zlib inflate short -- got %lu of %lu "
-			    "bytes\n", (ulong_t)dstlen, (ulong_t)size);
-			ctf_data_free(base, size + hdrsz);
-			return (ctf_set_open_errno(errp, ECTF_CORRUPT));
-		}
-
-		ctf_data_protect(base, size + hdrsz);
-
-	} else {
-		base = (void *)ctfsect->cts_data;
-		buf = (uchar_t *)base + hdrsz;
-	}
-
-	/*
-	 * Once we have uncompressed and validated the CTF data buffer, we can
-	 * proceed with allocating a ctf_file_t and initializing it.
+	 * Once the header is determined to be valid, we can proceed with
+	 * allocating a ctf_file_t and initializing it.
 	 */
 	if ((fp = ctf_alloc(sizeof (ctf_file_t))) == NULL)
 		return (ctf_set_open_errno(errp, EAGAIN));
@@ -683,7 +956,7 @@ ctf_bufopen(const ctf_sect_t *ctfsect, const ctf_sect_t *symsect,
 	bzero(fp, sizeof (ctf_file_t));
 	fp->ctf_version = hp.cth_version;
 	fp->ctf_fileops = &ctf_fileops[hp.cth_version];
-	fp->ctf_hflags = hflags;
+	fp->ctf_hflags = hp.cth_flags;
 	bcopy(ctfsect, &fp->ctf_data, sizeof (ctf_sect_t));
 
 	if (symsect != NULL) {
@@ -705,51 +978,19 @@ ctf_bufopen(const ctf_sect_t *ctfsect, const ctf_sect_t *symsect,
 	if (fp->ctf_strtab.cts_name == NULL)
 		fp->ctf_strtab.cts_name = _CTF_NULLSTR;
 
-	fp->ctf_str[CTF_STRTAB_0].cts_strs = (const char *)buf + hp.cth_stroff;
-	fp->ctf_str[CTF_STRTAB_0].cts_len = hp.cth_strlen;
-
 	if (strsect != NULL) {
 		fp->ctf_str[CTF_STRTAB_1].cts_strs = strsect->cts_data;
 		fp->ctf_str[CTF_STRTAB_1].cts_len = strsect->cts_size;
 	}
 
-	fp->ctf_base = base;
-	fp->ctf_buf = buf;
-	fp->ctf_size = size + hdrsz;
-
 	/*
-	 * If we have a parent container name and label, store the relocated
-	 * string pointers in the CTF container for easy access later.
+	 * If the container has a usable name index, all we need do now is
+	 * point the hash tables at it, and leave the rest to ctf_load().
+	 * Otherwise, we load the container now.
 	 */
-	if (hp.cth_parlabel != 0)
-		fp->ctf_parlabel = ctf_strptr(fp, hp.cth_parlabel);
-	if (hp.cth_parname != 0)
-		fp->ctf_parname = ctf_strptr(fp, hp.cth_parname);
-
-	ctf_dprintf("ctf_bufopen: parent name %s (label %s)\n",
-	    fp->ctf_parname ? fp->ctf_parname : "<NULL>",
-	    fp->ctf_parlabel ? fp->ctf_parlabel : "<NULL>");
-
-	/*
-	 * If we have a symbol table section, allocate and initialize
-	 * the symtab translation table, pointed to by ctf_sxlate.
-	 */
-	if (symsect != NULL) {
-		fp->ctf_nsyms = symsect->cts_size / symsect->cts_entsize;
-		fp->ctf_sxlate = ctf_alloc(fp->ctf_nsyms * sizeof (uint_t));
-
-		if (fp->ctf_sxlate == NULL) {
-			(void) ctf_set_open_errno(errp, EAGAIN);
-			goto bad;
-		}
-
-		if ((err = init_symtab(fp, &hp, symsect, strsect)) != 0) {
-			(void) ctf_set_open_errno(errp, err);
-			goto bad;
-		}
-	}
-
-	if ((err = init_types(fp, &hp)) != 0) {
+	if (cip != NULL && valid_index(cip)) {
+		init_index(fp, cip);
+	} else if ((err = init_data(fp, &hp, hdrsz)) != 0) {
 		(void) ctf_set_open_errno(errp, err);
 		goto bad;
 	}
@@ -960,26 +1201,7 @@ ctf_close(ctf_file_t *fp)
 		    strlen(fp->ctf_strtab.cts_name) + 1);
 	}
 
-	if (fp->ctf_base != fp->ctf_data.cts_data && fp->ctf_base != NULL)
-		ctf_data_free((void *)fp->ctf_base, fp->ctf_size);
-
-	if (fp->ctf_sxlate != NULL)
-		ctf_free(fp->ctf_sxlate, sizeof (uint_t) * fp->ctf_nsyms);
-
-	if (fp->ctf_txlate != NULL) {
-		ctf_free(fp->ctf_txlate,
-		    sizeof (uint_t) * (fp->ctf_typemax + 1));
-	}
-
-	if (fp->ctf_ptrtab != NULL) {
-		ctf_free(fp->ctf_ptrtab,
-		    sizeof (ushort_t) * (fp->ctf_typemax + 1));
-	}
-
-	ctf_hash_destroy(&fp->ctf_structs);
-	ctf_hash_destroy(&fp->ctf_unions);
-	ctf_hash_destroy(&fp->ctf_enums);
-	ctf_hash_destroy(&fp->ctf_names);
+	fini_data(fp);
 
 	ctf_free(fp, sizeof (ctf_file_t));
 }
@@ -162,9 +162,13 @@ ctf_enum_iter(ctf_file_t *fp, ctf_id_t type, ctf_enum_f *func, void *arg)
 int
 ctf_type_iter(ctf_file_t *fp, boolean_t nonroot, ctf_type_f *func, void *arg)
 {
-	ctf_id_t id, max = fp->ctf_typemax;
+	ctf_id_t id, max;
 	int rc, child = (fp->ctf_flags & LCTF_CHILD);
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
+	max = fp->ctf_typemax;
 	for (id = 1; id <= max; id++) {
 		const ctf_type_t *tp = LCTF_INDEX_TO_TYPEPTR(fp, id);
 		if ((nonroot || CTF_INFO_ISROOT(tp->ctt_info)) &&
@@ -1104,6 +1108,9 @@ ctf_object_iter(ctf_file_t *fp, ctf_object_f *func, void *arg)
 	if (fp->ctf_symtab.cts_data == NULL)
 		return (ctf_set_errno(fp, ECTF_NOSYMTAB));
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
 	for (i = 0; i < fp->ctf_nsyms; i++) {
 		char *name;
 		if (fp->ctf_sxlate[i] == -1u)
@@ -1152,6 +1159,9 @@ ctf_function_iter(ctf_file_t *fp, ctf_function_f *func, void *arg)
 	if (fp->ctf_symtab.cts_data == NULL)
 		return (ctf_set_errno(fp, ECTF_NOSYMTAB));
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
 	for (i = 0; i < fp->ctf_nsyms; i++) {
 		char *name;
 		ushort_t info, *dp;
@@ -1226,6 +1236,9 @@ ctf_symbol_name(ctf_file_t *fp, ulong_t idx, char *buf, size_t len)
 		return (NULL);
 	}
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (NULL); /* errno is set for us */
+
 	if (idx > fp->ctf_nsyms) {
 		(void) ctf_set_errno(fp, ECTF_NOTDATA);
 		return (NULL);
@@ -1266,8 +1279,14 @@ int
 ctf_string_iter(ctf_file_t *fp, ctf_string_f *func, void *arg)
 {
 	int rc;
-	const char *strp = fp->ctf_str[CTF_STRTAB_0].cts_strs;
-	size_t strl = fp->ctf_str[CTF_STRTAB_0].cts_len;
+	const char *strp;
+	size_t strl;
+
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
+	strp = fp->ctf_str[CTF_STRTAB_0].cts_strs;
+	strl = fp->ctf_str[CTF_STRTAB_0].cts_len;
 
 	while (strl > 0) {
 		size_t len;
@@ -1327,11 +1346,18 @@ ctf_id_t
 ctf_max_id(ctf_file_t *fp)
 {
 	int child = (fp->ctf_flags & LCTF_CHILD);
+
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
 	return (fp->ctf_typemax + (child ? CTF_CHILD_START : 0));
 }
 
 ulong_t
 ctf_nr_syms(ctf_file_t *fp)
 {
+	if (ctf_load(fp) == CTF_ERR)
+		return (0);
+
 	return (fp->ctf_nsyms);
 }
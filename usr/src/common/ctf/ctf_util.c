@@ -120,6 +120,9 @@ ctf_strraw(ctf_file_t *fp, uint_t name)
 {
 	ctf_strs_t *ctsp = &fp->ctf_str[CTF_NAME_STID(name)];
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (NULL);
+
 	if (ctsp->cts_strs != NULL && CTF_NAME_OFFSET(name) < ctsp->cts_len)
 		return (ctsp->cts_strs + CTF_NAME_OFFSET(name));
 
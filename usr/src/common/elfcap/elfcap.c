@@ -488,6 +488,14 @@ static const elfcap_desc_t hw2_386[ELFCAP_NUM_HW2_386] = {
 	{						/* 0x10000000 */
 		AV_386_2_VAES, STRDESC("AV_386_2_VAES"),
 		STRDESC("VAES"), STRDESC("vaes")
+	},
+	{						/* 0x20000000 */
+		AV_386_2_ERMS, STRDESC("AV_386_2_ERMS"),
+		STRDESC("ERMS"), STRDESC("erms")
+	},
+	{						/* 0x40000000 */
+		AV_386_2_FSRM, STRDESC("AV_386_2_FSRM"),
+		STRDESC("FSRM"), STRDESC("fsrm")
 	}
 };
 
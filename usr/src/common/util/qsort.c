@@ -34,56 +34,44 @@
 #if !defined(_KERNEL) && !defined(_KMDB)
 #include <stdlib.h>
 #include <synch.h>
+#include <thread.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
 #endif /* !_KERNEL && !_KMDB */
 
 #include "qsort.h"
 
-static void swapp32(uint32_t *r1, uint32_t *r2, size_t cnt);
-static void swapp64(uint64_t *r1, uint64_t *r2, size_t cnt);
-static void swapi(uint32_t *r1, uint32_t *r2, size_t cnt);
-static void swapb(char *r1, char *r2, size_t cnt);
-
 typedef int (*cmp_f)(const void *, const void *, void *);
 
-/*
- * choose a median of 3 values
- */
-static __GNU_INLINE char *
-med3(char *a, char *b, char *c, cmp_f cmp, void *arg)
-{
-	if (cmp(a, b, arg) < 0) {
-		if (cmp(b, c, arg) < 0) {
-			return (b);
-		} else if (cmp(a, c, arg) < 0) {
-			return (c);
-		} else {
-			return (a);
-		}
-	} else {
-		if (cmp(b, c, arg) > 0) {
-			return (b);
-		} else if (cmp(a, c, arg) > 0) {
-			return (c);
-		} else {
-			return (a);
-		}
-	}
-}
-
-#define	THRESH_L	5	/* threshold for insertion sort */
-#define	THRESH_M3	20	/* threshold for median of 3 */
-#define	THRESH_M9	50	/* threshold for median of 9 */
-
-typedef struct {
-	char	*b_lim;
-	size_t	nrec;
-} stk_t;
-
 /*
  * qsort() is a general purpose, in-place sorting routine using a
  * user provided call back function for comparisons.  This implementation
- * utilizes a ternary quicksort algorithm, and cuts over to an
- * insertion sort for partitions involving fewer than THRESH_L records.
+ * is a pattern-defeating quicksort (Orson Peters, "Pattern-defeating
+ * Quicksort", 2021), an introsort which:
+ *
+ *   o  takes the median of 3 records as the pivot, or an approximate
+ *	median of 9 for partitions of more than THRESH_M9 records;
+ *
+ *   o  cuts over to an insertion sort for partitions of fewer than
+ *	THRESH_L records;
+ *
+ *   o  notices when a partition needed no exchanges, and then tries to
+ *	finish it with an insertion sort which gives up after a few moves,
+ *	so that already sorted and nearly sorted input is O(n) (reverse
+ *	sorted input is not, and takes O(n log n) like random input);
+ *
+ *   o  notices when the pivot is equal to the record just below the
+ *	partition (which is less than or equal to all of the partition),
+ *	and then splits off all of the records equal to the pivot at once,
+ *	so that input with few distinct keys is O(n * keys);
+ *
+ *   o  counts badly unbalanced partitions, and shuffles some records
+ *	to break up the pattern which caused each one; after log2(n) of
+ *	them the partition is heapsorted instead, so that the worst case,
+ *	including adversarial input, is O(n log n).
+ *
+ * The sort is not stable.  Records are only ever exchanged, using a swap
+ * specialized for the size and alignment of the records.
  *
  * Potential User Errors
  *   There is no return value from qsort, this function has no method
@@ -98,7 +86,7 @@ typedef struct {
  *
  *   Examples of qsort parameter errors might be
  *   1) record size (rsiz) equal to 0
- *      qsort will loop and never return.
+ *      qsort will return without examining any records
  *   2) record size (rsiz) less than 0
  *      rsiz is unsigned, so a negative value is insanely large
  *   3) number of records (nrec) is 0
@@ -120,377 +108,522 @@ typedef struct {
  *   9) The user compare function modifies the data records
  */
 
-static int
-qsort_r_wrapper(const void *a, const void *b, void *arg)
+#define	THRESH_L	12	/* threshold for insertion sort */
+#define	THRESH_M9	128	/* threshold for median of 9 */
+#define	THRESH_PART	8	/* moves allowed by partial insertion sort */
+
+/*
+ * How records are exchanged, chosen once per sort from the size and the
+ * alignment of the records.
+ */
+typedef enum {
+	SWAP_P64,	/* one aligned 64 bit word */
+	SWAP_P32,	/* one aligned 32 bit word */
+	SWAP_L64,	/* an array of aligned 64 bit words */
+	SWAP_L32,	/* an array of aligned 32 bit words */
+	SWAP_B		/* an array of characters */
+} swap_t;
+
+typedef struct {
+	cmp_f	qs_cmp;
+	void	*qs_arg;
+	size_t	qs_rsiz;
+	swap_t	qs_swap;
+	size_t	qs_loops;	/* words or characters per record */
+} qs_t;
+
+/*
+ * A partition still to be sorted.  bad is the number of badly unbalanced
+ * partitionings it may still have before it is heapsorted, and leftmost
+ * is set if there is no record below it which is known to be less than or
+ * equal to all of its records.
+ */
+typedef struct {
+	char	*b_lim;
+	size_t	nrec;
+	uint_t	bad;
+	boolean_t leftmost;
+} stk_t;
+
+static __GNU_INLINE void
+swap(const qs_t *qs, char *r1, char *r2)
 {
-	int (*cmp)(const void *, const void *) =
-	    (int(*)(const void *, const void *))(uintptr_t)arg;
-	return (cmp(a, b));
+	size_t cnt = qs->qs_loops;
+
+	switch (qs->qs_swap) {
+	case SWAP_P64: {
+		uint64_t temp = *(uint64_t *)r1;
+		*(uint64_t *)r1 = *(uint64_t *)r2;
+		*(uint64_t *)r2 = temp;
+		break;
+	}
+	case SWAP_P32: {
+		uint32_t temp = *(uint32_t *)r1;
+		*(uint32_t *)r1 = *(uint32_t *)r2;
+		*(uint32_t *)r2 = temp;
+		break;
+	}
+	case SWAP_L64: {
+		uint64_t *p1 = (uint64_t *)r1, *p2 = (uint64_t *)r2, temp;
+
+		while (cnt--) {
+			temp = *p1;
+			*p1++ = *p2;
+			*p2++ = temp;
+		}
+		break;
+	}
+	case SWAP_L32: {
+		uint32_t *p1 = (uint32_t *)r1, *p2 = (uint32_t *)r2, temp;
+
+		while (cnt--) {
+			temp = *p1;
+			*p1++ = *p2;
+			*p2++ = temp;
+		}
+		break;
+	}
+	default: {
+		char temp;
+
+		/* character by character */
+		while (cnt--) {
+			temp = *r1;
+			*r1++ = *r2;
+			*r2++ = temp;
+		}
+		break;
+	}
+	}
 }
 
-void
-qsort_r(void *basep, size_t nrec, size_t rsiz,
-    cmp_f cmp, void *arg)
+static __GNU_INLINE int
+compare(const qs_t *qs, const char *r1, const char *r2)
 {
-	size_t		i;		/* temporary variable */
-
-	/* variables used by swap */
-	void		(*swapf)(char *, char *, size_t);
-	size_t		loops;
-
-	/* variables used by sort */
-	stk_t		stack[8 * sizeof (nrec) + 1];
-	stk_t		*sp;
-	char		*b_lim;		/* bottom limit */
-	char		*b_dup;		/* bottom duplicate */
-	char		*b_par;		/* bottom partition */
-	char		*t_lim;		/* top limit */
-	char		*t_dup;		/* top duplicate */
-	char		*t_par;		/* top partition */
-	char		*m1, *m2, *m3;	/* median pointers */
-	uintptr_t	d_bytelength;	/* byte length of duplicate records */
-	int		b_nrec;
-	int		t_nrec;
-	int		cv;		/* results of compare (bottom / top) */
+	return (qs->qs_cmp(r1, r2, qs->qs_arg));
+}
 
-	/*
-	 * choose a swap function based on alignment and size
-	 *
-	 * The qsort function sorts an array of fixed length records.
-	 * We have very limited knowledge about the data record itself.
-	 * It may be that the data record is in the array we are sorting
-	 * or it may be that the array contains pointers or indexes to
-	 * the actual data record and all that we are sorting is the indexes.
-	 *
-	 * The following decision will choose an optimal swap function
-	 * based on the size and alignment of the data records
-	 *   swapp64	will swap 64 bit pointers
-	 *   swapp32	will swap 32 bit pointers
-	 *   swapi	will swap an array of 32 bit integers
-	 *   swapb	will swap an array of 8 bit characters
-	 *
-	 * swapi and swapb will also require the variable loops to be set
-	 * to control the length of the array being swapped
-	 */
-	if ((((uintptr_t)basep & (sizeof (uint64_t) - 1)) == 0) &&
-	    (rsiz == sizeof (uint64_t))) {
-		loops = 1;
-		swapf = (void (*)(char *, char *, size_t))swapp64;
-	} else if ((((uintptr_t)basep & (sizeof (uint32_t) - 1)) == 0) &&
-	    (rsiz == sizeof (uint32_t))) {
-		loops = 1;
-		swapf = (void (*)(char *, char *, size_t))swapp32;
-	} else if ((((uintptr_t)basep & (sizeof (uint32_t) - 1)) == 0) &&
-	    ((rsiz & (sizeof (uint32_t) - 1)) == 0)) {
-		loops = rsiz / sizeof (int);
-		swapf = (void (*)(char *, char *, size_t))swapi;
+/*
+ * choose a swap function based on alignment and size
+ *
+ * The qsort function sorts an array of fixed length records.
+ * We have very limited knowledge about the data record itself.
+ * It may be that the data record is in the array we are sorting
+ * or it may be that the array contains pointers or indexes to
+ * the actual data record and all that we are sorting is the indexes.
+ */
+static void
+qs_init(qs_t *qs, void *basep, size_t rsiz, cmp_f cmp, void *arg)
+{
+	uintptr_t align = (uintptr_t)basep | rsiz;
+
+	qs->qs_cmp = cmp;
+	qs->qs_arg = arg;
+	qs->qs_rsiz = rsiz;
+
+	if ((align & (sizeof (uint64_t) - 1)) == 0) {
+		qs->qs_swap = rsiz == sizeof (uint64_t) ? SWAP_P64 : SWAP_L64;
+		qs->qs_loops = rsiz / sizeof (uint64_t);
+	} else if ((align & (sizeof (uint32_t) - 1)) == 0) {
+		qs->qs_swap = rsiz == sizeof (uint32_t) ? SWAP_P32 : SWAP_L32;
+		qs->qs_loops = rsiz / sizeof (uint32_t);
 	} else {
-		loops = rsiz;
-		swapf = swapb;
+		qs->qs_swap = SWAP_B;
+		qs->qs_loops = rsiz;
 	}
+}
 
-	/*
-	 * qsort is a partitioning sort
-	 *
-	 * the stack is the bookkeeping mechanism to keep track of all
-	 * the partitions.
-	 *
-	 * each sort pass takes one partition and sorts it into two partitions.
-	 * at the top of the loop we simply take the partition on the top
-	 * of the stack and sort it. See the comments at the bottom
-	 * of the loop regarding which partitions to add in what order.
-	 *
-	 * initially put the whole partition on the stack
-	 */
-	sp = stack;
-	sp->b_lim = (char *)basep;
-	sp->nrec = nrec;
-	sp++;
-	while (sp > stack) {
-		sp--;
-		b_lim = sp->b_lim;
-		nrec = sp->nrec;
-
-		/*
-		 * a linear insertion sort i faster than a qsort for
-		 * very small number of records (THRESH_L)
-		 *
-		 * if number records < threshold use linear insertion sort
-		 *
-		 * this also handles the special case where the partition
-		 * 0 or 1 records length.
-		 */
-		if (nrec < THRESH_L) {
-			/*
-			 * Linear insertion sort
-			 */
-			t_par = b_lim;
-			for (i = 1; i < nrec; i++) {
-				t_par += rsiz;
-				b_par = t_par;
-				while (b_par > b_lim) {
-					b_par -= rsiz;
-					if ((*cmp)(b_par, b_par + rsiz, arg) <=
-					    0) {
-						break;
-					}
-					(*swapf)(b_par, b_par + rsiz, loops);
-				}
-			}
+/*
+ * Linear insertion sort of nrec records.
+ */
+static void
+insertion_sort(const qs_t *qs, char *b_lim, size_t nrec)
+{
+	size_t rsiz = qs->qs_rsiz;
+	char *t_lim = b_lim + nrec * rsiz;
+	char *t_par, *b_par;
+
+	for (t_par = b_lim + rsiz; t_par < t_lim; t_par += rsiz) {
+		for (b_par = t_par; b_par > b_lim; b_par -= rsiz) {
+			if (compare(qs, b_par - rsiz, b_par) <= 0)
+				break;
+			swap(qs, b_par - rsiz, b_par);
+		}
+	}
+}
+
+/*
+ * Insertion sort which gives up once it has moved records THRESH_PART
+ * places in total, for partitions which are probably already sorted.
+ * Returns B_TRUE if the partition is now sorted.
+ */
+static boolean_t
+partial_insertion_sort(const qs_t *qs, char *b_lim, size_t nrec)
+{
+	size_t rsiz = qs->qs_rsiz;
+	char *t_lim = b_lim + nrec * rsiz;
+	char *t_par, *b_par;
+	uint_t moves = 0;
+
+	for (t_par = b_lim + rsiz; t_par < t_lim; t_par += rsiz) {
+		for (b_par = t_par; b_par > b_lim; b_par -= rsiz) {
+			if (compare(qs, b_par - rsiz, b_par) <= 0)
+				break;
+			swap(qs, b_par - rsiz, b_par);
+			moves++;
+		}
+		if (moves > THRESH_PART)
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+static void
+sift_down(const qs_t *qs, char *b_lim, size_t root, size_t nrec)
+{
+	size_t rsiz = qs->qs_rsiz;
+	size_t child;
 
-			/*
-			 * a linear insertion sort will put all records
-			 * in their final position and will not create
-			 * subpartitions.
-			 *
-			 * therefore when the insertion sort is complete
-			 * just go to the top of the loop and get the
-			 * next partition to sort.
-			 */
-			continue;
+	while ((child = 2 * root + 1) < nrec) {
+		if (child + 1 < nrec && compare(qs, b_lim + child * rsiz,
+		    b_lim + (child + 1) * rsiz) < 0) {
+			child++;
 		}
+		if (compare(qs, b_lim + root * rsiz, b_lim + child * rsiz) >= 0)
+			break;
+		swap(qs, b_lim + root * rsiz, b_lim + child * rsiz);
+		root = child;
+	}
+}
+
+/*
+ * Heapsort, for partitions where quicksort keeps choosing bad pivots.
+ */
+static void
+heap_sort(const qs_t *qs, char *b_lim, size_t nrec)
+{
+	size_t i;
 
-		/* quicksort */
-
-		/*
-		 * choose a pivot record
-		 *
-		 * Ideally the pivot record will divide the partition
-		 * into two equal parts. however we have to balance the
-		 * work involved in selecting the pivot record with the
-		 * expected benefit.
-		 *
-		 * The choice of pivot record depends on the number of
-		 * records in the partition
-		 *
-		 * for small partitions (nrec < THRESH_M3)
-		 *   we just select the record in the middle of the partition
-		 *
-		 * if (nrec >= THRESH_M3 && nrec < THRESH_M9)
-		 *   we select three values and choose the median of 3
-		 *
-		 * if (nrec >= THRESH_M9)
-		 *   then we use an approximate median of 9
-		 *   9 records are selected and grouped in 3 groups of 3
-		 *   the median of each of these 3 groups is fed into another
-		 *   median of 3 decision.
-		 *
-		 * Each median of 3 decision is 2 or 3 compares,
-		 * so median of 9 costs between 8 and 12 compares.
-		 *
-		 * i is byte distance between two consecutive samples
-		 * m2 will point to the pivot record
-		 */
-		if (nrec < THRESH_M3) {
-			m2 = b_lim + (nrec / 2) * rsiz;
-		} else if (nrec < THRESH_M9) {
-			/* use median of 3 */
-			i = ((nrec - 1) / 2) * rsiz;
-			m2 = med3(b_lim, b_lim + i, b_lim + 2 * i, cmp, arg);
+	for (i = nrec / 2; i-- > 0; )
+		sift_down(qs, b_lim, i, nrec);
+	for (i = nrec - 1; i > 0; i--) {
+		swap(qs, b_lim, b_lim + i * qs->qs_rsiz);
+		sift_down(qs, b_lim, 0, i);
+	}
+}
+
+/*
+ * choose a median of 3 values
+ */
+static __GNU_INLINE char *
+med3(const qs_t *qs, char *a, char *b, char *c)
+{
+	if (compare(qs, a, b) < 0) {
+		if (compare(qs, b, c) < 0) {
+			return (b);
+		} else if (compare(qs, a, c) < 0) {
+			return (c);
+		} else {
+			return (a);
+		}
+	} else {
+		if (compare(qs, b, c) > 0) {
+			return (b);
+		} else if (compare(qs, a, c) > 0) {
+			return (c);
 		} else {
-			/* approx median of 9 */
-			i = ((nrec - 1) / 8) * rsiz;
-			m1 = med3(b_lim, b_lim +  i, b_lim + 2 * i, cmp, arg);
-			m2 = med3(b_lim + 3 * i, b_lim + 4 * i, b_lim + 5 * i,
-			    cmp, arg);
-			m3 = med3(b_lim + 6 * i, b_lim + 7 * i, b_lim + 8 * i,
-			    cmp, arg);
-			m2 = med3(m1, m2, m3, cmp, arg);
+			return (a);
 		}
+	}
+}
 
-		/*
-		 * quick sort partitioning
-		 *
-		 * The partition limits are defined by bottom and top pointers
-		 * b_lim and t_lim.
-		 *
-		 * qsort uses a fairly standard method of moving the
-		 * partitioning pointers, b_par and t_par, to the middle of
-		 * the partition and exchanging records that are in the
-		 * wrong part of the partition.
-		 *
-		 * Two enhancements have been made to the basic algorithm.
-		 * One for handling duplicate records and one to minimize
-		 * the number of swaps.
-		 *
-		 * Two duplicate records pointers are (b_dup and t_dup) are
-		 * initially set to b_lim and t_lim.  Each time a record
-		 * whose sort key value is equal to the pivot record is found
-		 * it will be swapped with the record pointed to by
-		 * b_dup or t_dup and the duplicate pointer will be
-		 * incremented toward the center.
-		 * When partitioning is complete, all the duplicate records
-		 * will have been collected at the upper and lower limits of
-		 * the partition and can easily be moved adjacent to the
-		 * pivot record.
-		 *
-		 * The second optimization is to minimize the number of swaps.
-		 * The pointer m2 points to the pivot record.
-		 * During partitioning, if m2 is ever equal to the partitioning
-		 * pointers, b_par or t_par, then b_par or t_par just moves
-		 * onto the next record without doing a compare.
-		 * If as a result of duplicate record detection,
-		 * b_dup or t_dup is ever equal to m2,
-		 * then m2 is changed to point to the duplicate record and
-		 * b_dup or t_dup is incremented with out swapping records.
-		 *
-		 * When partitioning is done, we may not have the same pivot
-		 * record that we started with, but we will have one with
-		 * an equal sort key.
-		 */
-		b_dup = b_par		= b_lim;
-		t_dup = t_par = t_lim	= b_lim + rsiz * (nrec - 1);
-		for (;;) {
-
-			/* move bottom pointer up */
-			for (; b_par <= t_par; b_par += rsiz) {
-				if (b_par == m2) {
-					continue;
-				}
-				cv = cmp(b_par, m2, arg);
-				if (cv > 0) {
-					break;
-				}
-				if (cv == 0) {
-					if (b_dup == m2) {
-						m2 = b_par;
-					} else if (b_dup != b_par) {
-						(*swapf)(b_dup, b_par, loops);
-					}
-					b_dup += rsiz;
-				}
-			}
+/*
+ * Moves the chosen pivot record to the bottom of the partition.
+ *
+ * For small partitions the pivot is the median of the bottom, middle and
+ * top records, and for partitions of more than THRESH_M9 records it is an
+ * approximate median of 9: 9 evenly spaced records are selected and
+ * grouped in 3 groups of 3, and the median of each of these groups is fed
+ * into another median of 3.  Either way, one of the other samples is
+ * greater than or equal to the pivot and stays above the bottom of the
+ * partition, which bounds the first scan in partition_right().  Only the
+ * pivot is moved, so that runs in the input survive.
+ */
+static void
+choose_pivot(const qs_t *qs, char *b_lim, size_t nrec)
+{
+	size_t rsiz = qs->qs_rsiz;
+	char *m1, *m2, *m3;
+	size_t i;
+
+	if (nrec > THRESH_M9) {
+		i = ((nrec - 1) / 8) * rsiz;
+		m1 = med3(qs, b_lim, b_lim + i, b_lim + 2 * i);
+		m2 = med3(qs, b_lim + 3 * i, b_lim + 4 * i, b_lim + 5 * i);
+		m3 = med3(qs, b_lim + 6 * i, b_lim + 7 * i, b_lim + 8 * i);
+		m2 = med3(qs, m1, m2, m3);
+	} else {
+		i = ((nrec - 1) / 2) * rsiz;
+		m2 = med3(qs, b_lim, b_lim + i, b_lim + 2 * i);
+	}
 
-			/* move top pointer down */
-			for (; b_par < t_par; t_par -= rsiz) {
-				if (t_par == m2) {
-					continue;
-				}
-				cv = cmp(t_par, m2, arg);
-				if (cv < 0) {
-					break;
-				}
-				if (cv == 0) {
-					if (t_dup == m2) {
-						m2 = t_par;
-					} else if (t_dup != t_par) {
-						(*swapf)(t_dup, t_par, loops);
-					}
-					t_dup -= rsiz;
-				}
-			}
+	if (m2 != b_lim)
+		swap(qs, b_lim, m2);
+}
 
-			/* break if we are done partitioning */
-			if (b_par >= t_par) {
-				break;
-			}
+/*
+ * Partitions nrec records around the pivot record at b_lim: the records
+ * less than the pivot end up below it and the others above it.  Returns
+ * the final position of the pivot, and sets *done if no records needed
+ * to be exchanged.
+ */
+static char *
+partition_right(const qs_t *qs, char *b_lim, size_t nrec, boolean_t *done)
+{
+	size_t rsiz = qs->qs_rsiz;
+	char *b_par = b_lim;
+	char *t_par = b_lim + nrec * rsiz;
+
+	/* find the first record greater than or equal to the pivot */
+	do {
+		b_par += rsiz;
+	} while (compare(qs, b_par, b_lim) < 0);
+
+	/*
+	 * find the last record less than the pivot; this scan has to be
+	 * bounded only if nothing below b_par is less than the pivot
+	 */
+	if (b_par - rsiz == b_lim) {
+		do {
+			t_par -= rsiz;
+		} while (b_par < t_par && compare(qs, t_par, b_lim) >= 0);
+	} else {
+		do {
+			t_par -= rsiz;
+		} while (compare(qs, t_par, b_lim) >= 0);
+	}
 
-			/* exchange records at upper and lower break points */
-			(*swapf)(b_par, t_par, loops);
+	*done = b_par >= t_par;
+
+	while (b_par < t_par) {
+		swap(qs, b_par, t_par);
+		do {
 			b_par += rsiz;
+		} while (compare(qs, b_par, b_lim) < 0);
+		do {
 			t_par -= rsiz;
-		}
+		} while (compare(qs, t_par, b_lim) >= 0);
+	}
 
-		/*
-		 * partitioning is now complete
-		 *
-		 * there are two termination conditions from the partitioning
-		 * loop above.  Either b_par or t_par have crossed or
-		 * they are equal.
-		 *
-		 * we need to swap the pivot record to its final position
-		 * m2 could be in either the upper or lower partitions
-		 * or it could already be in its final position
-		 */
-		/*
-		 * R[b_par] > R[m2]
-		 * R[t_par] < R[m2]
-		 */
-		if (t_par < b_par) {
-			if (m2 < t_par) {
-				(*swapf)(m2, t_par, loops);
-				m2 = b_par = t_par;
-			} else if (m2 > b_par) {
-				(*swapf)(m2, b_par, loops);
-				m2 = t_par = b_par;
-			} else {
-				b_par = t_par = m2;
-			}
-		} else {
-			if (m2 < t_par) {
-				t_par = b_par = t_par - rsiz;
-			}
-			if (m2 != b_par) {
-				(*swapf)(m2, b_par, loops);
-			}
-			m2 = t_par;
-		}
+	b_par -= rsiz;
+	if (b_par != b_lim)
+		swap(qs, b_lim, b_par);
 
-		/*
-		 * move bottom duplicates next to pivot
-		 * optimized to eliminate overlap
-		 */
-		d_bytelength = b_dup - b_lim;
-		if (b_par - b_dup < d_bytelength) {
-			b_dup = b_lim + (b_par - b_dup);
-		}
-		while (b_dup > b_lim) {
-			b_dup -= rsiz;
-			b_par -= rsiz;
-			(*swapf)(b_dup, b_par, loops);
-		}
-		b_par = m2 - d_bytelength;
-
-		/*
-		 * move top duplicates next to pivot
-		 */
-		d_bytelength = t_lim - t_dup;
-		if (t_dup - t_par < d_bytelength) {
-			t_dup = t_lim - (t_dup - t_par);
-		}
-		while (t_dup < t_lim) {
-			t_dup += rsiz;
-			t_par += rsiz;
-			(*swapf)(t_dup, t_par, loops);
+	return (b_par);
+}
+
+/*
+ * Like partition_right(), but the records equal to the pivot end up below
+ * it.  This is used when the pivot is equal to the record below the
+ * partition, so that all of the records below the pivot's final position
+ * are equal to it and need no more sorting.
+ */
+static char *
+partition_left(const qs_t *qs, char *b_lim, size_t nrec)
+{
+	size_t rsiz = qs->qs_rsiz;
+	char *b_par = b_lim;
+	char *t_par = b_lim + nrec * rsiz;
+	char *t_lim = t_par;
+
+	do {
+		t_par -= rsiz;
+	} while (compare(qs, b_lim, t_par) < 0);
+
+	if (t_par + rsiz == t_lim) {
+		do {
+			b_par += rsiz;
+		} while (b_par < t_par && compare(qs, b_lim, b_par) >= 0);
+	} else {
+		do {
+			b_par += rsiz;
+		} while (compare(qs, b_lim, b_par) >= 0);
+	}
+
+	while (b_par < t_par) {
+		swap(qs, b_par, t_par);
+		do {
+			t_par -= rsiz;
+		} while (compare(qs, b_lim, t_par) < 0);
+		do {
+			b_par += rsiz;
+		} while (compare(qs, b_lim, b_par) >= 0);
+	}
+
+	if (t_par != b_lim)
+		swap(qs, b_lim, t_par);
+
+	return (t_par);
+}
+
+/*
+ * Exchanges a few records of a partition which came out of a badly
+ * unbalanced partitioning, to break up whatever pattern caused it.
+ */
+static void
+shuffle(const qs_t *qs, char *b_lim, size_t nrec)
+{
+	size_t rsiz = qs->qs_rsiz;
+	size_t q = nrec / 4;
+	char *t_lim = b_lim + (nrec - 1) * rsiz;
+
+	if (nrec < THRESH_L)
+		return;
+
+	swap(qs, b_lim, b_lim + q * rsiz);
+	swap(qs, t_lim, t_lim - q * rsiz);
+	if (nrec > THRESH_M9) {
+		swap(qs, b_lim + rsiz, b_lim + (q + 1) * rsiz);
+		swap(qs, b_lim + 2 * rsiz, b_lim + (q + 2) * rsiz);
+		swap(qs, t_lim - rsiz, t_lim - (q + 1) * rsiz);
+		swap(qs, t_lim - 2 * rsiz, t_lim - (q + 2) * rsiz);
+	}
+}
+
+/*
+ * One pass of the sort over the partition *sp.  Returns 0 if the
+ * partition is now sorted, 1 if what is left of it to sort is in *sp, and
+ * 2 if the partition has been split into *sp and *tp.
+ */
+static int
+qs_pass(const qs_t *qs, stk_t *sp, stk_t *tp)
+{
+	size_t rsiz = qs->qs_rsiz;
+	char *b_lim = sp->b_lim;
+	size_t nrec = sp->nrec;
+	size_t b_nrec, t_nrec;
+	boolean_t done;
+	char *m2;
+
+	if (nrec < THRESH_L) {
+		insertion_sort(qs, b_lim, nrec);
+		return (0);
+	}
+
+	choose_pivot(qs, b_lim, nrec);
+
+	/*
+	 * If the pivot is equal to the record below the partition, there
+	 * are likely to be many records equal to it, so put them all in
+	 * their final place at once.
+	 */
+	if (!sp->leftmost && compare(qs, b_lim - rsiz, b_lim) >= 0) {
+		m2 = partition_left(qs, b_lim, nrec);
+		sp->b_lim = m2 + rsiz;
+		sp->nrec = nrec - (m2 - b_lim) / rsiz - 1;
+		return (1);
+	}
+
+	m2 = partition_right(qs, b_lim, nrec, &done);
+	b_nrec = (m2 - b_lim) / rsiz;
+	t_nrec = nrec - b_nrec - 1;
+
+	if (b_nrec < nrec / 8 || t_nrec < nrec / 8) {
+		if (--sp->bad == 0) {
+			heap_sort(qs, b_lim, nrec);
+			return (0);
 		}
-		t_par = m2 + d_bytelength;
-
-		/*
-		 * when a qsort pass completes there are three partitions
-		 * 1) the lower contains all records less than pivot
-		 * 2) the upper contains all records greater than pivot
-		 * 3) the pivot partition contains all record equal to pivot
-		 *
-		 * all records in the pivot partition are in their final
-		 * position and do not need to be accounted for by the stack
-		 *
-		 * when adding partitions to the stack
-		 * it is important to add the largest partition first
-		 * to prevent stack overflow.
-		 *
-		 * calculate number of unsorted records in top and bottom
-		 * push resulting partitions on stack
-		 */
-		b_nrec = (b_par - b_lim) / rsiz;
-		t_nrec = (t_lim - t_par) / rsiz;
-		if (b_nrec < t_nrec) {
-			sp->b_lim = t_par + rsiz;
-			sp->nrec = t_nrec;
-			sp++;
-			sp->b_lim = b_lim;
-			sp->nrec = b_nrec;
-			sp++;
-		} else {
-			sp->b_lim = b_lim;
-			sp->nrec = b_nrec;
-			sp++;
-			sp->b_lim = t_par + rsiz;
-			sp->nrec = t_nrec;
-			sp++;
+		shuffle(qs, b_lim, b_nrec);
+		shuffle(qs, m2 + rsiz, t_nrec);
+	} else if (done && partial_insertion_sort(qs, b_lim, b_nrec) &&
+	    partial_insertion_sort(qs, m2 + rsiz, t_nrec)) {
+		return (0);
+	}
+
+	sp->nrec = b_nrec;
+	tp->b_lim = m2 + rsiz;
+	tp->nrec = t_nrec;
+	tp->bad = sp->bad;
+	tp->leftmost = B_FALSE;
+
+	return (2);
+}
+
+/*
+ * Sorts the partition *sp and everything it splits into.
+ *
+ * The stack is the bookkeeping mechanism to keep track of the partitions
+ * still to be sorted.  When a partition is split, the larger part is
+ * pushed and the smaller one sorted first, so the stack never holds more
+ * than log2(nrec) partitions.
+ */
+static void
+qs_sort(const qs_t *qs, stk_t *sp)
+{
+	stk_t	stack[8 * sizeof (size_t) + 1];
+	stk_t	cur = *sp;
+	stk_t	*top = stack;
+
+	for (;;) {
+		switch (qs_pass(qs, &cur, top)) {
+		case 0:
+			if (top == stack)
+				return;
+			cur = *--top;
+			break;
+		case 1:
+			break;
+		case 2:
+			if (cur.nrec > top->nrec) {
+				stk_t tmp = cur;
+
+				cur = *top;
+				*top = tmp;
+			}
+			top++;
+			break;
 		}
 	}
 }
 
+static uint_t
+log2_nrec(size_t nrec)
+{
+	uint_t log = 0;
+
+	while (nrec >>= 1)
+		log++;
+
+	return (log);
+}
+
+static int
+qsort_r_wrapper(const void *a, const void *b, void *arg)
+{
+	int (*cmp)(const void *, const void *) =
+	    (int(*)(const void *, const void *))(uintptr_t)arg;
+	return (cmp(a, b));
+}
+
+void
+qsort_r(void *basep, size_t nrec, size_t rsiz,
+    cmp_f cmp, void *arg)
+{
+	qs_t	qs;
+	stk_t	part;
+
+	if (nrec < 2 || rsiz == 0)
+		return;
+
+	qs_init(&qs, basep, rsiz, cmp, arg);
+	part.b_lim = basep;
+	part.nrec = nrec;
+	part.bad = log2_nrec(nrec);
+	part.leftmost = B_TRUE;
+	qs_sort(&qs, &part);
+}
+
 void
 qsort(void *basep, size_t nrec, size_t rsiz,
     int (*cmp)(const void *, const void *))
@@ -499,58 +632,141 @@ qsort(void *basep, size_t nrec, size_t rsiz,
 	    (void *)(uintptr_t)cmp));
 }
 
+#if !defined(_KERNEL) && !defined(_KMDB)
+
 /*
- * The following swap functions should not create a stack frame
- * the SPARC call / return instruction will be executed
- * but the a save / restore will not be executed
- * which means we won't do a window turn with the spill / fill overhead
- * verify this by examining the assembly code
+ * pqsort() and pqsort_r() are versions of qsort() and qsort_r() which
+ * sort large arrays with several threads.  The caller and up to
+ * PQS_MAXTHR - 1 helper threads, one per online CPU, take partitions from
+ * a shared queue.  Each thread runs passes of the sort on its partition,
+ * queueing the larger part of every split, until the partition is small
+ * enough to sort on its own.  The first few passes are necessarily
+ * serial, but the partitions multiply quickly.
+ *
+ * The comparison function is called from several threads at once and so
+ * must be safe to call concurrently.  If no threads can be created, the
+ * caller sorts the whole array itself.
  */
 
-/* ARGSUSED */
-static void
-swapp32(uint32_t *r1, uint32_t *r2, size_t cnt)
+#define	PQS_MINREC	(64 * 1024)	/* below this, sort in one thread */
+#define	PQS_SPLITS	32		/* partitions per thread to aim for */
+#define	PQS_MAXTHR	32
+
+typedef struct {
+	qs_t		pq_qs;
+	mutex_t		pq_lock;
+	cond_t		pq_cv;
+	stk_t		*pq_queue;	/* partitions waiting for a thread */
+	size_t		pq_queued;
+	uint_t		pq_busy;	/* threads sorting a partition */
+	size_t		pq_cutoff;	/* partitions sorted by one thread */
+} pqs_t;
+
+static void *
+pqs_worker(void *arg)
 {
-	uint32_t temp;
+	pqs_t *pq = arg;
+	stk_t cur, next;
+	int r;
+
+	(void) mutex_lock(&pq->pq_lock);
+	for (;;) {
+		while (pq->pq_queued == 0 && pq->pq_busy != 0)
+			(void) cond_wait(&pq->pq_cv, &pq->pq_lock);
+		if (pq->pq_queued == 0)
+			break;
+
+		cur = pq->pq_queue[--pq->pq_queued];
+		pq->pq_busy++;
+		(void) mutex_unlock(&pq->pq_lock);
+
+		r = 1;
+		while (r != 0 && cur.nrec > pq->pq_cutoff) {
+			if ((r = qs_pass(&pq->pq_qs, &cur, &next)) != 2)
+				continue;
+
+			if (cur.nrec > next.nrec) {
+				stk_t tmp = cur;
+
+				cur = next;
+				next = tmp;
+			}
+			(void) mutex_lock(&pq->pq_lock);
+			pq->pq_queue[pq->pq_queued++] = next;
+			(void) cond_signal(&pq->pq_cv);
+			(void) mutex_unlock(&pq->pq_lock);
+		}
+		if (r != 0)
+			qs_sort(&pq->pq_qs, &cur);
 
-	temp = *r1;
-	*r1++ = *r2;
-	*r2++ = temp;
-}
+		(void) mutex_lock(&pq->pq_lock);
+		pq->pq_busy--;
+	}
 
-/* ARGSUSED */
-static void
-swapp64(uint64_t *r1, uint64_t *r2, size_t cnt)
-{
-	uint64_t temp;
+	/* the queue is empty and nobody can add to it: wake the others */
+	(void) cond_broadcast(&pq->pq_cv);
+	(void) mutex_unlock(&pq->pq_lock);
 
-	temp = *r1;
-	*r1++ = *r2;
-	*r2++ = temp;
+	return (NULL);
 }
 
-static void
-swapi(uint32_t *r1, uint32_t *r2, size_t cnt)
+void
+pqsort_r(void *basep, size_t nrec, size_t rsiz, cmp_f cmp, void *arg)
 {
-	uint32_t temp;
+	thread_t	tids[PQS_MAXTHR - 1];
+	pqs_t		pq;
+	long		ncpu;
+	uint_t		nthr, i;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nrec < 2 * PQS_MINREC || rsiz == 0 || ncpu < 2) {
+		qsort_r(basep, nrec, rsiz, cmp, arg);
+		return;
+	}
+
+	nthr = (uint_t)MIN(ncpu, PQS_MAXTHR);
+	pq.pq_cutoff = MAX(PQS_MINREC, nrec / (nthr * PQS_SPLITS));
+
+	/*
+	 * Every queued partition is more than half of a partition which was
+	 * above the cutoff, and they are all disjoint.
+	 */
+	pq.pq_queue = malloc((2 * nrec / pq.pq_cutoff + 2) * sizeof (stk_t));
+	if (pq.pq_queue == NULL) {
+		qsort_r(basep, nrec, rsiz, cmp, arg);
+		return;
+	}
 
-	/* character by character */
-	while (cnt--) {
-		temp = *r1;
-		*r1++ = *r2;
-		*r2++ = temp;
+	qs_init(&pq.pq_qs, basep, rsiz, cmp, arg);
+	(void) mutex_init(&pq.pq_lock, USYNC_THREAD, NULL);
+	(void) cond_init(&pq.pq_cv, USYNC_THREAD, NULL);
+	pq.pq_queue[0].b_lim = basep;
+	pq.pq_queue[0].nrec = nrec;
+	pq.pq_queue[0].bad = log2_nrec(nrec);
+	pq.pq_queue[0].leftmost = B_TRUE;
+	pq.pq_queued = 1;
+	pq.pq_busy = 0;
+
+	for (i = 0; i < nthr - 1; i++) {
+		if (thr_create(NULL, 0, pqs_worker, &pq, 0, &tids[i]) != 0)
+			break;
 	}
+	nthr = i;
+
+	(void) pqs_worker(&pq);
+	for (i = 0; i < nthr; i++)
+		(void) thr_join(tids[i], NULL, NULL);
+
+	(void) cond_destroy(&pq.pq_cv);
+	(void) mutex_destroy(&pq.pq_lock);
+	free(pq.pq_queue);
 }
 
-static void
-swapb(char *r1, char *r2, size_t cnt)
+void
+pqsort(void *basep, size_t nrec, size_t rsiz,
+    int (*cmp)(const void *, const void *))
 {
-	char	temp;
-
-	/* character by character */
-	while (cnt--) {
-		temp = *r1;
-		*r1++ = *r2;
-		*r2++ = temp;
-	}
+	pqsort_r(basep, nrec, rsiz, qsort_r_wrapper, (void *)(uintptr_t)cmp);
 }
+
+#endif /* !_KERNEL && !_KMDB */
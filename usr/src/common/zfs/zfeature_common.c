@@ -377,4 +377,33 @@ zpool_feature_init(void)
 	    "flush them periodically.",
 	    ZFEATURE_FLAG_READONLY_COMPAT,
 	    log_spacemap_deps);
+
+	zfeature_register(SPA_FEATURE_DRAID,
+	    "org.illumos:draid", "draid",
+	    "Support for distributed spare RAID (dRAID).",
+	    ZFEATURE_FLAG_MOS, NULL);
+
+	zfeature_register(SPA_FEATURE_RAIDZ_EXPANSION,
+	    "org.illumos:raidz_expansion", "raidz_expansion",
+	    "Support for raidz expansion.",
+	    ZFEATURE_FLAG_MOS, NULL);
+
+	zfeature_register(SPA_FEATURE_BLOCK_CLONING,
+	    "org.illumos:block_cloning", "block_cloning",
+	    "Support for block cloning via Block Reference Table.",
+	    ZFEATURE_FLAG_READONLY_COMPAT, NULL);
+
+	zfeature_register(SPA_FEATURE_DEDUP_LOG,
+	    "org.illumos:dedup_log", "dedup_log",
+	    "Log-structured staging of dedup table updates.",
+	    ZFEATURE_FLAG_READONLY_COMPAT, NULL);
+
+	static const spa_feature_t blake3_deps[] = {
+		SPA_FEATURE_EXTENSIBLE_DATASET,
+		SPA_FEATURE_NONE
+	};
+	zfeature_register(SPA_FEATURE_BLAKE3,
+	    "org.openzfs:blake3", "blake3",
+	    "BLAKE3 hash algorithm.",
+	    ZFEATURE_FLAG_PER_DATASET, blake3_deps);
 }
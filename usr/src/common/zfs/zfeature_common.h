@@ -69,6 +69,11 @@ typedef enum spa_feature {
 	SPA_FEATURE_USEROBJ_ACCOUNTING,
 	SPA_FEATURE_PROJECT_QUOTA,
 	SPA_FEATURE_LOG_SPACEMAP,
+	SPA_FEATURE_DRAID,
+	SPA_FEATURE_RAIDZ_EXPANSION,
+	SPA_FEATURE_BLOCK_CLONING,
+	SPA_FEATURE_DEDUP_LOG,
+	SPA_FEATURE_BLAKE3,
 	SPA_FEATURES
 } spa_feature_t;
 
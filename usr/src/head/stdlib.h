@@ -326,6 +326,10 @@ extern void *reallocf(void *, size_t);
 
 extern void qsort_r(void *, size_t, size_t,
     int (*)(const void *, const void *, void *), void *);
+extern void pqsort(void *, size_t, size_t,
+    int (*)(const void *, const void *));
+extern void pqsort_r(void *, size_t, size_t,
+    int (*)(const void *, const void *, void *), void *);
 #endif	/* !_STRICT_SYBMOLS */
 
 
@@ -0,0 +1,79 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"memchr_avx2.s"
+
+/*
+ * memchr for processors with AVX2, the avx2 member of the memchr
+ * capabilities family.
+ *
+ * The buffer is scanned in aligned 32-byte blocks, which never cross a
+ * page boundary, so bytes on either side of the buffer may be read but
+ * are never matched: bits for the bytes before it are shifted out of the
+ * first mask, and a match at or beyond its end is discarded.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.memchr_avx2/**/s
+
+	ENTRY(memchr)		/* (const void *, int, size_t) */
+	testq	%rdx, %rdx
+	jz	L(notfound_novec)
+	vmovd	%esi, %xmm0
+	vpbroadcastb %xmm0, %ymm0
+	movq	%rdi, %r8
+	andq	$-32, %r8
+	vpcmpeqb (%r8), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	movl	%edi, %ecx
+	andl	$31, %ecx
+	shrl	%cl, %eax
+	testl	%eax, %eax
+	jz	L(first_miss)
+	bsfl	%eax, %eax
+	cmpq	%rdx, %rax
+	jae	L(notfound)
+	addq	%rdi, %rax
+	vzeroupper
+	ret
+
+L(first_miss):
+	/* %rdx becomes the number of bytes left after the first block */
+	subl	$32, %ecx
+	negl	%ecx
+	subq	%rcx, %rdx
+	jbe	L(notfound)
+
+	.p2align 4
+L(loop):
+	addq	$32, %r8
+	vpcmpeqb (%r8), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	testl	%eax, %eax
+	jnz	L(found)
+	subq	$32, %rdx
+	ja	L(loop)
+
+L(notfound):
+	vzeroupper
+L(notfound_novec):
+	xorl	%eax, %eax
+	ret
+
+L(found):
+	bsfl	%eax, %eax
+	cmpq	%rdx, %rax
+	jae	L(notfound)
+	addq	%r8, %rax
+	vzeroupper
+	ret
+	SET_SIZE(memchr)
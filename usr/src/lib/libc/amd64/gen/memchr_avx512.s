@@ -0,0 +1,70 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"memchr_avx512.s"
+
+/*
+ * memchr for processors with AVX-512BW, the avx512 member of the memchr
+ * capabilities family.  This is memchr_avx2.s with 64-byte blocks and
+ * mask registers; see strlen_avx512.s for the choice of registers.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.memchr_avx512/**/s
+
+	ENTRY(memchr)		/* (const void *, int, size_t) */
+	testq	%rdx, %rdx
+	jz	L(notfound)
+	vpbroadcastb %esi, %zmm16
+	movq	%rdi, %r8
+	andq	$-64, %r8
+	vpcmpeqb (%r8), %zmm16, %k0
+	kmovq	%k0, %rax
+	movl	%edi, %ecx
+	andl	$63, %ecx
+	shrq	%cl, %rax
+	testq	%rax, %rax
+	jz	L(first_miss)
+	bsfq	%rax, %rax
+	cmpq	%rdx, %rax
+	jae	L(notfound)
+	addq	%rdi, %rax
+	ret
+
+L(first_miss):
+	/* %rdx becomes the number of bytes left after the first block */
+	subl	$64, %ecx
+	negl	%ecx
+	subq	%rcx, %rdx
+	jbe	L(notfound)
+
+	.p2align 4
+L(loop):
+	addq	$64, %r8
+	vpcmpeqb (%r8), %zmm16, %k0
+	kortestq %k0, %k0
+	jnz	L(found)
+	subq	$64, %rdx
+	ja	L(loop)
+
+L(notfound):
+	xorl	%eax, %eax
+	ret
+
+L(found):
+	kmovq	%k0, %rax
+	bsfq	%rax, %rax
+	cmpq	%rdx, %rax
+	jae	L(notfound)
+	addq	%r8, %rax
+	ret
+	SET_SIZE(memchr)
@@ -0,0 +1,157 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"memcmp_avx2.s"
+
+/*
+ * memcmp for processors with AVX2, the avx2 member of the memcmp
+ * capabilities family.
+ *
+ * Buffers are compared 32 bytes at a time, the last 32 bytes overlapping
+ * the previous block.  Shorter buffers are compared with two overlapping
+ * loads of the largest size which fits.  When words differ, comparing them
+ * byte-swapped gives the ordering of the first differing byte.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.memcmp_avx2/**/s
+
+	ENTRY(memcmp)		/* (const void *, const void *, size_t) */
+	cmpq	$32, %rdx
+	jb	L(less_32)
+
+	.p2align 4
+L(loop):
+	vmovdqu	(%rdi), %ymm0
+	vpcmpeqb (%rsi), %ymm0, %ymm0
+	vpmovmskb %ymm0, %ecx
+	incl	%ecx			/* first differing byte, if any */
+	jnz	L(diff)
+	addq	$32, %rdi
+	addq	$32, %rsi
+	subq	$32, %rdx
+	cmpq	$32, %rdx
+	jae	L(loop)
+
+	testq	%rdx, %rdx
+	jz	L(equal)
+	leaq	-32(%rdi,%rdx), %rdi
+	leaq	-32(%rsi,%rdx), %rsi
+	vmovdqu	(%rdi), %ymm0
+	vpcmpeqb (%rsi), %ymm0, %ymm0
+	vpmovmskb %ymm0, %ecx
+	incl	%ecx
+	jnz	L(diff)
+
+L(equal):
+	xorl	%eax, %eax
+	vzeroupper
+	ret
+
+L(diff):
+	bsfl	%ecx, %ecx
+	movzbl	(%rdi,%rcx), %eax
+	movzbl	(%rsi,%rcx), %edx
+	subl	%edx, %eax
+	vzeroupper
+	ret
+
+L(less_32):
+	cmpl	$16, %edx
+	jae	L(16_31)
+	cmpl	$8, %edx
+	jae	L(8_15)
+	cmpl	$4, %edx
+	jae	L(4_7)
+	testl	%edx, %edx
+	jz	L(zero)
+
+L(bytes):
+	movzbl	(%rdi), %eax
+	movzbl	(%rsi), %ecx
+	subl	%ecx, %eax
+	jnz	L(ret)
+	incq	%rdi
+	incq	%rsi
+	decl	%edx
+	jnz	L(bytes)
+L(ret):
+	ret
+
+L(zero):
+	xorl	%eax, %eax
+	ret
+
+L(16_31):
+	vmovdqu	(%rdi), %xmm0
+	vpcmpeqb (%rsi), %xmm0, %xmm0
+	vpmovmskb %xmm0, %ecx
+	subl	$0xffff, %ecx
+	jnz	L(diff16)
+	leaq	-16(%rdi,%rdx), %rdi
+	leaq	-16(%rsi,%rdx), %rsi
+	vmovdqu	(%rdi), %xmm0
+	vpcmpeqb (%rsi), %xmm0, %xmm0
+	vpmovmskb %xmm0, %ecx
+	subl	$0xffff, %ecx
+	jnz	L(diff16)
+	xorl	%eax, %eax
+	ret
+
+L(diff16):
+	/* %ecx is now (mask - 0xffff); its lowest set bit is the first miss */
+	bsfl	%ecx, %ecx
+	movzbl	(%rdi,%rcx), %eax
+	movzbl	(%rsi,%rcx), %edx
+	subl	%edx, %eax
+	ret
+
+L(8_15):
+	movq	(%rdi), %rax
+	movq	(%rsi), %rcx
+	cmpq	%rcx, %rax
+	jne	L(diff8)
+	movq	-8(%rdi,%rdx), %rax
+	movq	-8(%rsi,%rdx), %rcx
+	cmpq	%rcx, %rax
+	jne	L(diff8)
+	xorl	%eax, %eax
+	ret
+
+L(diff8):
+	bswapq	%rax
+	bswapq	%rcx
+	cmpq	%rcx, %rax
+	sbbl	%eax, %eax
+	orl	$1, %eax
+	ret
+
+L(4_7):
+	movl	(%rdi), %eax
+	movl	(%rsi), %ecx
+	cmpl	%ecx, %eax
+	jne	L(diff4)
+	movl	-4(%rdi,%rdx), %eax
+	movl	-4(%rsi,%rdx), %ecx
+	cmpl	%ecx, %eax
+	jne	L(diff4)
+	xorl	%eax, %eax
+	ret
+
+L(diff4):
+	bswapl	%eax
+	bswapl	%ecx
+	cmpl	%ecx, %eax
+	sbbl	%eax, %eax
+	orl	$1, %eax
+	ret
+	SET_SIZE(memcmp)
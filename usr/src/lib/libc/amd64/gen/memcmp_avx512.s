@@ -0,0 +1,76 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"memcmp_avx512.s"
+
+/*
+ * memcmp for processors with AVX-512BW, the avx512 member of the memcmp
+ * capabilities family; see strlen_avx512.s for the choice of registers.
+ *
+ * Buffers are compared 64 bytes at a time, the last 64 bytes overlapping
+ * the previous block.  Buffers shorter than that are compared with a
+ * single masked load, which cannot fault on the bytes it leaves out.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.memcmp_avx512/**/s
+
+	ENTRY(memcmp)		/* (const void *, const void *, size_t) */
+	cmpq	$64, %rdx
+	jb	L(less_64)
+
+	.p2align 4
+L(loop):
+	vmovdqu64 (%rdi), %zmm16
+	vpcmpneqb (%rsi), %zmm16, %k0
+	kortestq %k0, %k0
+	jnz	L(diff)
+	addq	$64, %rdi
+	addq	$64, %rsi
+	subq	$64, %rdx
+	cmpq	$64, %rdx
+	jae	L(loop)
+
+	testq	%rdx, %rdx
+	jz	L(equal)
+	leaq	-64(%rdi,%rdx), %rdi
+	leaq	-64(%rsi,%rdx), %rsi
+	vmovdqu64 (%rdi), %zmm16
+	vpcmpneqb (%rsi), %zmm16, %k0
+	kortestq %k0, %k0
+	jnz	L(diff)
+
+L(equal):
+	xorl	%eax, %eax
+	ret
+
+L(less_64):
+	testq	%rdx, %rdx
+	jz	L(equal)
+	xorl	%eax, %eax
+	btsq	%rdx, %rax
+	decq	%rax
+	kmovq	%rax, %k1
+	vmovdqu8 (%rdi), %zmm16{%k1}{z}
+	vmovdqu8 (%rsi), %zmm17{%k1}{z}
+	vpcmpneqb %zmm17, %zmm16, %k0
+	kortestq %k0, %k0
+	jz	L(equal)
+
+L(diff):
+	kmovq	%k0, %rcx
+	bsfq	%rcx, %rcx
+	movzbl	(%rdi,%rcx), %eax
+	movzbl	(%rsi,%rcx), %edx
+	subl	%edx, %eax
+	ret
+	SET_SIZE(memcmp)
@@ -0,0 +1,229 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"memcpy_avx2.s"
+
+/*
+ * memcpy and memmove for processors with AVX2.  This file is assembled
+ * into several members of the memcpy and memmove capabilities families:
+ *
+ *	avx2	32-byte vector moves for every size.
+ *
+ *	erms	(-D_ERMS) as above, but large forward copies use rep movsb,
+ *		which is faster than the vector loop on processors with
+ *		Enhanced REP MOVSB/STOSB.
+ *
+ *	fsrm	(-D_ERMS -D_FSRM) as erms, with a lower threshold for
+ *		rep movsb on processors with Fast Short REP MOV, where its
+ *		startup cost is much smaller.
+ *
+ * Both routines handle overlapping buffers.  Copies of up to 128 bytes load
+ * the whole source before storing anything.  Larger copies load the head
+ * and tail of the source first, then move the rest 128 bytes at a time
+ * with stores aligned on the destination, forwards unless the destination
+ * starts inside the source.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.memcpy_avx2/**/s
+
+#if defined(_FSRM)
+#define	REP_MOVSB_THRESHOLD	2048
+#elif defined(_ERMS)
+#define	REP_MOVSB_THRESHOLD	4096
+#endif
+
+	ENTRY(memmove)		/* (void *, const void *, size_t) */
+	ENTRY(memcpy)		/* (void *, const void *, size_t) */
+	movq	%rdi, %rax
+	cmpq	$32, %rdx
+	jb	L(less_32)
+	cmpq	$64, %rdx
+	ja	L(more_64)
+
+	/* 32 to 64 bytes */
+	vmovdqu	(%rsi), %ymm0
+	vmovdqu	-32(%rsi,%rdx), %ymm1
+	vmovdqu	%ymm0, (%rdi)
+	vmovdqu	%ymm1, -32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+L(less_32):
+	cmpl	$16, %edx
+	jae	L(16_31)
+	cmpl	$8, %edx
+	jae	L(8_15)
+	cmpl	$4, %edx
+	jae	L(4_7)
+	cmpl	$1, %edx
+	ja	L(2_3)
+	jb	L(done)
+	movzbl	(%rsi), %ecx
+	movb	%cl, (%rdi)
+L(done):
+	ret
+
+L(16_31):
+	vmovdqu	(%rsi), %xmm0
+	vmovdqu	-16(%rsi,%rdx), %xmm1
+	vmovdqu	%xmm0, (%rdi)
+	vmovdqu	%xmm1, -16(%rdi,%rdx)
+	ret
+
+L(8_15):
+	movq	(%rsi), %rcx
+	movq	-8(%rsi,%rdx), %r8
+	movq	%rcx, (%rdi)
+	movq	%r8, -8(%rdi,%rdx)
+	ret
+
+L(4_7):
+	movl	(%rsi), %ecx
+	movl	-4(%rsi,%rdx), %r8d
+	movl	%ecx, (%rdi)
+	movl	%r8d, -4(%rdi,%rdx)
+	ret
+
+L(2_3):
+	movzwl	(%rsi), %ecx
+	movzwl	-2(%rsi,%rdx), %r8d
+	movw	%cx, (%rdi)
+	movw	%r8w, -2(%rdi,%rdx)
+	ret
+
+L(more_64):
+	cmpq	$128, %rdx
+	ja	L(more_128)
+
+	/* 65 to 128 bytes */
+	vmovdqu	(%rsi), %ymm0
+	vmovdqu	32(%rsi), %ymm1
+	vmovdqu	-64(%rsi,%rdx), %ymm2
+	vmovdqu	-32(%rsi,%rdx), %ymm3
+	vmovdqu	%ymm0, (%rdi)
+	vmovdqu	%ymm1, 32(%rdi)
+	vmovdqu	%ymm2, -64(%rdi,%rdx)
+	vmovdqu	%ymm3, -32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+L(more_128):
+	/*
+	 * Copy backwards if the destination starts inside the source, that
+	 * is if (dst - src) < len as an unsigned comparison.
+	 */
+	movq	%rdi, %rcx
+	subq	%rsi, %rcx
+	cmpq	%rdx, %rcx
+	jb	L(backward)
+
+#if defined(REP_MOVSB_THRESHOLD)
+	cmpq	$REP_MOVSB_THRESHOLD, %rdx
+	jae	L(rep_movsb)
+#endif
+
+	/*
+	 * Load the first 32 and the last 128 bytes, which are stored last.
+	 * The loop starts at the first 32-byte boundary after the
+	 * destination and stops once fewer than 128 bytes are left.
+	 */
+	vmovdqu	(%rsi), %ymm4
+	vmovdqu	-128(%rsi,%rdx), %ymm5
+	vmovdqu	-96(%rsi,%rdx), %ymm6
+	vmovdqu	-64(%rsi,%rdx), %ymm7
+	vmovdqu	-32(%rsi,%rdx), %ymm8
+	leaq	-128(%rdi,%rdx), %r9
+	leaq	32(%rdi), %r8
+	andq	$-32, %r8
+	movq	%r8, %rcx
+	subq	%rdi, %rcx
+	addq	%rcx, %rsi
+
+	.p2align 4
+L(fwd_loop):
+	cmpq	%r9, %r8
+	jae	L(fwd_done)
+	vmovdqu	(%rsi), %ymm0
+	vmovdqu	32(%rsi), %ymm1
+	vmovdqu	64(%rsi), %ymm2
+	vmovdqu	96(%rsi), %ymm3
+	vmovdqa	%ymm0, (%r8)
+	vmovdqa	%ymm1, 32(%r8)
+	vmovdqa	%ymm2, 64(%r8)
+	vmovdqa	%ymm3, 96(%r8)
+	subq	$-128, %rsi
+	subq	$-128, %r8
+	jmp	L(fwd_loop)
+
+L(fwd_done):
+	vmovdqu	%ymm4, (%rdi)
+	vmovdqu	%ymm5, -128(%rdi,%rdx)
+	vmovdqu	%ymm6, -96(%rdi,%rdx)
+	vmovdqu	%ymm7, -64(%rdi,%rdx)
+	vmovdqu	%ymm8, -32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+L(backward):
+	/*
+	 * The mirror image of the forward copy: load the first 128 and the
+	 * last 32 bytes, and move the rest from the last 32-byte boundary
+	 * in the destination downwards.
+	 */
+	vmovdqu	(%rsi), %ymm4
+	vmovdqu	32(%rsi), %ymm5
+	vmovdqu	64(%rsi), %ymm6
+	vmovdqu	96(%rsi), %ymm7
+	vmovdqu	-32(%rsi,%rdx), %ymm8
+	leaq	128(%rdi), %r9
+	leaq	(%rdi,%rdx), %r8
+	movq	%r8, %rcx
+	andq	$31, %rcx
+	subq	%rcx, %r8
+	leaq	(%rsi,%rdx), %r10
+	subq	%rcx, %r10
+
+	.p2align 4
+L(bwd_loop):
+	cmpq	%r9, %r8
+	jbe	L(bwd_done)
+	vmovdqu	-32(%r10), %ymm0
+	vmovdqu	-64(%r10), %ymm1
+	vmovdqu	-96(%r10), %ymm2
+	vmovdqu	-128(%r10), %ymm3
+	vmovdqa	%ymm0, -32(%r8)
+	vmovdqa	%ymm1, -64(%r8)
+	vmovdqa	%ymm2, -96(%r8)
+	vmovdqa	%ymm3, -128(%r8)
+	addq	$-128, %r10
+	addq	$-128, %r8
+	jmp	L(bwd_loop)
+
+L(bwd_done):
+	vmovdqu	%ymm4, (%rdi)
+	vmovdqu	%ymm5, 32(%rdi)
+	vmovdqu	%ymm6, 64(%rdi)
+	vmovdqu	%ymm7, 96(%rdi)
+	vmovdqu	%ymm8, -32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+#if defined(REP_MOVSB_THRESHOLD)
+L(rep_movsb):
+	movq	%rdx, %rcx
+	rep
+	movsb
+	ret
+#endif
+	SET_SIZE(memcpy)
+	SET_SIZE(memmove)
@@ -0,0 +1,136 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"memset_avx2.s"
+
+/*
+ * memset for processors with AVX2.  This file is assembled into two
+ * members of the memset capabilities family: avx2, which uses 32-byte
+ * vector stores for every size, and erms (-D_ERMS), which uses rep stosb
+ * for large buffers on processors with Enhanced REP MOVSB/STOSB.
+ *
+ * Buffers of up to 128 bytes are filled with overlapping stores from both
+ * ends.  Larger ones are filled 128 bytes at a time with aligned stores,
+ * the unaligned head and tail being covered by unaligned stores.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.memset_avx2/**/s
+
+#if defined(_ERMS)
+#define	REP_STOSB_THRESHOLD	2048
+#endif
+
+	ENTRY(memset)		/* (void *, int, size_t) */
+	movq	%rdi, %rax
+	vmovd	%esi, %xmm0
+	cmpq	$32, %rdx
+	jb	L(less_32)
+	vpbroadcastb %xmm0, %ymm0
+	cmpq	$64, %rdx
+	ja	L(more_64)
+
+	/* 32 to 64 bytes */
+	vmovdqu	%ymm0, (%rdi)
+	vmovdqu	%ymm0, -32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+L(less_32):
+	vpbroadcastb %xmm0, %xmm0
+	cmpl	$16, %edx
+	jae	L(16_31)
+	vmovq	%xmm0, %rcx
+	cmpl	$8, %edx
+	jae	L(8_15)
+	cmpl	$4, %edx
+	jae	L(4_7)
+	cmpl	$1, %edx
+	ja	L(2_3)
+	jb	L(done)
+	movb	%cl, (%rdi)
+L(done):
+	ret
+
+L(16_31):
+	vmovdqu	%xmm0, (%rdi)
+	vmovdqu	%xmm0, -16(%rdi,%rdx)
+	ret
+
+L(8_15):
+	movq	%rcx, (%rdi)
+	movq	%rcx, -8(%rdi,%rdx)
+	ret
+
+L(4_7):
+	movl	%ecx, (%rdi)
+	movl	%ecx, -4(%rdi,%rdx)
+	ret
+
+L(2_3):
+	movw	%cx, (%rdi)
+	movw	%cx, -2(%rdi,%rdx)
+	ret
+
+L(more_64):
+	cmpq	$128, %rdx
+	ja	L(more_128)
+
+	/* 65 to 128 bytes */
+	vmovdqu	%ymm0, (%rdi)
+	vmovdqu	%ymm0, 32(%rdi)
+	vmovdqu	%ymm0, -64(%rdi,%rdx)
+	vmovdqu	%ymm0, -32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+L(more_128):
+#if defined(REP_STOSB_THRESHOLD)
+	cmpq	$REP_STOSB_THRESHOLD, %rdx
+	jae	L(rep_stosb)
+#endif
+	vmovdqu	%ymm0, (%rdi)
+	leaq	-128(%rdi,%rdx), %r9
+	leaq	32(%rdi), %r8
+	andq	$-32, %r8
+
+	.p2align 4
+L(loop):
+	cmpq	%r9, %r8
+	jae	L(loop_done)
+	vmovdqa	%ymm0, (%r8)
+	vmovdqa	%ymm0, 32(%r8)
+	vmovdqa	%ymm0, 64(%r8)
+	vmovdqa	%ymm0, 96(%r8)
+	subq	$-128, %r8
+	jmp	L(loop)
+
+L(loop_done):
+	vmovdqu	%ymm0, -128(%rdi,%rdx)
+	vmovdqu	%ymm0, -96(%rdi,%rdx)
+	vmovdqu	%ymm0, -64(%rdi,%rdx)
+	vmovdqu	%ymm0, -32(%rdi,%rdx)
+	vzeroupper
+	ret
+
+#if defined(REP_STOSB_THRESHOLD)
+L(rep_stosb):
+	vzeroupper
+	movq	%rdx, %rcx
+	movzbl	%sil, %eax
+	movq	%rdi, %rdx
+	rep
+	stosb
+	movq	%rdx, %rax
+	ret
+#endif
+	SET_SIZE(memset)
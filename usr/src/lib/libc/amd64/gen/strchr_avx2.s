@@ -0,0 +1,71 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"strchr_avx2.s"
+
+/*
+ * strchr for processors with AVX2, the avx2 member of the strchr
+ * capabilities family.
+ *
+ * The string is scanned in aligned 32-byte blocks, which never cross a
+ * page boundary.  XORing a block with the character turns matches into
+ * zero bytes, so the minimum of that and the block itself is zero exactly
+ * where the block holds either the character or the terminating null.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.strchr_avx2/**/s
+
+	ENTRY(strchr)		/* (const char *, int) */
+	vmovd	%esi, %xmm0
+	vpbroadcastb %xmm0, %ymm0
+	vpxor	%xmm1, %xmm1, %xmm1
+	movq	%rdi, %rdx
+	andq	$-32, %rdx
+	vmovdqa	(%rdx), %ymm2
+	vpxor	%ymm2, %ymm0, %ymm3
+	vpminub	%ymm3, %ymm2, %ymm3
+	vpcmpeqb %ymm1, %ymm3, %ymm3
+	vpmovmskb %ymm3, %eax
+	movl	%edi, %ecx
+	andl	$31, %ecx
+	shrl	%cl, %eax
+	testl	%eax, %eax
+	jz	L(loop)
+	bsfl	%eax, %eax
+	addq	%rdi, %rax
+	jmp	L(check)
+
+	.p2align 4
+L(loop):
+	addq	$32, %rdx
+	vmovdqa	(%rdx), %ymm2
+	vpxor	%ymm2, %ymm0, %ymm3
+	vpminub	%ymm3, %ymm2, %ymm3
+	vpcmpeqb %ymm1, %ymm3, %ymm3
+	vpmovmskb %ymm3, %eax
+	testl	%eax, %eax
+	jz	L(loop)
+	bsfl	%eax, %eax
+	addq	%rdx, %rax
+
+L(check):
+	/* Either the character or the end of the string */
+	vzeroupper
+	cmpb	(%rax), %sil
+	jne	L(notfound)
+	ret
+
+L(notfound):
+	xorl	%eax, %eax
+	ret
+	SET_SIZE(strchr)
@@ -0,0 +1,64 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"strchr_avx512.s"
+
+/*
+ * strchr for processors with AVX-512BW, the avx512 member of the strchr
+ * capabilities family.  This is strchr_avx2.s with 64-byte blocks and
+ * mask registers; see strlen_avx512.s for the choice of registers.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.strchr_avx512/**/s
+
+	ENTRY(strchr)		/* (const char *, int) */
+	vpbroadcastb %esi, %zmm16
+	movq	%rdi, %rdx
+	andq	$-64, %rdx
+	vmovdqa64 (%rdx), %zmm17
+	vpxorq	%zmm17, %zmm16, %zmm18
+	vpminub	%zmm18, %zmm17, %zmm18
+	vptestnmb %zmm18, %zmm18, %k0
+	kmovq	%k0, %rax
+	movl	%edi, %ecx
+	andl	$63, %ecx
+	shrq	%cl, %rax
+	testq	%rax, %rax
+	jz	L(loop)
+	bsfq	%rax, %rax
+	addq	%rdi, %rax
+	jmp	L(check)
+
+	.p2align 4
+L(loop):
+	addq	$64, %rdx
+	vmovdqa64 (%rdx), %zmm17
+	vpxorq	%zmm17, %zmm16, %zmm18
+	vpminub	%zmm18, %zmm17, %zmm18
+	vptestnmb %zmm18, %zmm18, %k0
+	kortestq %k0, %k0
+	jz	L(loop)
+	kmovq	%k0, %rax
+	bsfq	%rax, %rax
+	addq	%rdx, %rax
+
+L(check):
+	/* Either the character or the end of the string */
+	cmpb	(%rax), %sil
+	jne	L(notfound)
+	ret
+
+L(notfound):
+	xorl	%eax, %eax
+	ret
+	SET_SIZE(strchr)
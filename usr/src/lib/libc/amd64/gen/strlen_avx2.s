@@ -0,0 +1,81 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"strlen_avx2.s"
+
+/*
+ * strlen for processors with AVX2, the avx2 member of the strlen
+ * capabilities family.
+ *
+ * All loads are of aligned 32-byte blocks, so they never cross a page
+ * boundary; bits for the bytes before the start of the string are shifted
+ * out of the first mask.  Once the scan reaches a 128-byte boundary, four
+ * blocks are folded together with vpminub and checked at once.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.strlen_avx2/**/s
+
+	ENTRY(strlen)		/* (const char *) */
+	vpxor	%xmm0, %xmm0, %xmm0
+	movq	%rdi, %rdx
+	andq	$-32, %rdx
+	vpcmpeqb (%rdx), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	movl	%edi, %ecx
+	andl	$31, %ecx
+	shrl	%cl, %eax
+	testl	%eax, %eax
+	jz	L(next)
+	bsfl	%eax, %eax
+	vzeroupper
+	ret
+
+L(next):
+	addq	$32, %rdx
+	testq	$127, %rdx
+	jz	L(loop)
+	vpcmpeqb (%rdx), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	testl	%eax, %eax
+	jz	L(next)
+	jmp	L(found)
+
+	.p2align 4
+L(loop):
+	vmovdqa	(%rdx), %ymm1
+	vpminub	32(%rdx), %ymm1, %ymm1
+	vmovdqa	64(%rdx), %ymm2
+	vpminub	96(%rdx), %ymm2, %ymm2
+	vpminub	%ymm2, %ymm1, %ymm1
+	vpcmpeqb %ymm0, %ymm1, %ymm1
+	vpmovmskb %ymm1, %eax
+	testl	%eax, %eax
+	jnz	L(found4)
+	subq	$-128, %rdx
+	jmp	L(loop)
+
+L(found4):
+	vpcmpeqb (%rdx), %ymm0, %ymm1
+	vpmovmskb %ymm1, %eax
+	testl	%eax, %eax
+	jnz	L(found)
+	addq	$32, %rdx
+	jmp	L(found4)
+
+L(found):
+	bsfl	%eax, %eax
+	addq	%rdx, %rax
+	subq	%rdi, %rax
+	vzeroupper
+	ret
+	SET_SIZE(strlen)
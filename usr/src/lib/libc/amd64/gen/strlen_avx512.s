@@ -0,0 +1,76 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+	.file	"strlen_avx512.s"
+
+/*
+ * strlen for processors with AVX-512BW, the avx512 member of the strlen
+ * capabilities family.
+ *
+ * This is strlen_avx2.s with 64-byte blocks, comparing into mask registers.
+ * Only %zmm16-%zmm31 are used: they are not subject to the SSE/AVX
+ * transition penalties, so no vzeroupper is needed on the way out.
+ */
+
+#include "SYS.h"
+
+#define	L(s)	.strlen_avx512/**/s
+
+	ENTRY(strlen)		/* (const char *) */
+	vpxorq	%zmm16, %zmm16, %zmm16
+	movq	%rdi, %rdx
+	andq	$-64, %rdx
+	vpcmpeqb (%rdx), %zmm16, %k0
+	kmovq	%k0, %rax
+	movl	%edi, %ecx
+	andl	$63, %ecx
+	shrq	%cl, %rax
+	testq	%rax, %rax
+	jz	L(next)
+	bsfq	%rax, %rax
+	ret
+
+L(next):
+	addq	$64, %rdx
+	testq	$255, %rdx
+	jz	L(loop)
+	vpcmpeqb (%rdx), %zmm16, %k0
+	kortestq %k0, %k0
+	jz	L(next)
+	jmp	L(found)
+
+	.p2align 4
+L(loop):
+	vmovdqa64 (%rdx), %zmm17
+	vpminub	64(%rdx), %zmm17, %zmm17
+	vmovdqa64 128(%rdx), %zmm18
+	vpminub	192(%rdx), %zmm18, %zmm18
+	vpminub	%zmm18, %zmm17, %zmm17
+	vptestnmb %zmm17, %zmm17, %k0
+	kortestq %k0, %k0
+	jnz	L(found4)
+	addq	$256, %rdx
+	jmp	L(loop)
+
+L(found4):
+	vpcmpeqb (%rdx), %zmm16, %k0
+	kortestq %k0, %k0
+	jnz	L(found)
+	addq	$64, %rdx
+	jmp	L(found4)
+
+L(found):
+	kmovq	%k0, %rax
+	bsfq	%rax, %rax
+	addq	%rdx, %rax
+	subq	%rdi, %rax
+	ret
+	SET_SIZE(strlen)
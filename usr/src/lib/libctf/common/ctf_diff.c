@@ -821,6 +821,12 @@ ctf_diff_init(ctf_file_t *ifp, ctf_file_t *ofp, ctf_diff_t **cdsp)
 	ctf_diff_t *cds;
 	size_t fsize, rsize;
 
+	if (ctf_load(ifp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
+	if (ctf_load(ofp) == CTF_ERR)
+		return (ctf_set_errno(ifp, ctf_errno(ofp)));
+
 	cds = ctf_alloc(sizeof (ctf_diff_t));
 	if (cds == NULL)
 		return (ctf_set_errno(ifp, ENOMEM));
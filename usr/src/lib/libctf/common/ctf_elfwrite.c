@@ -68,6 +68,11 @@ ctf_write_elf(ctf_file_t *fp, Elf *src, Elf *dst, int flags)
 		goto out;
 	}
 
+	if (ctf_load(fp) == CTF_ERR) {
+		ret = CTF_ERR; /* errno is set for us */
+		goto out;
+	}
+
 	if (gelf_newehdr(dst, gelf_getclass(src)) == 0) {
 		ret = ctf_set_errno(fp, ECTF_ELF);
 		goto out;
@@ -136,10 +136,15 @@ z_strerror(int err)
 	return (zlib.z_error(err));
 }
 
+/*
+ * The header, and the name index that follows it if there is one, are copied
+ * as they are; only the data that follows them is compressed.
+ */
 static int
 ctf_zdata_init(ctf_zdata_t *czd, ctf_file_t *fp)
 {
 	ctf_header_t *cthp;
+	size_t hdrsz = (uintptr_t)fp->ctf_buf - (uintptr_t)fp->ctf_base;
 
 	bzero(czd, sizeof (ctf_zdata_t));
 
@@ -148,12 +153,11 @@ ctf_zdata_init(ctf_zdata_t *czd, ctf_file_t *fp)
 	if (czd->czd_buf == MAP_FAILED)
 		return (ctf_set_errno(fp, ENOMEM));
 
-	bcopy(fp->ctf_base, czd->czd_buf, sizeof (ctf_header_t));
+	bcopy(fp->ctf_base, czd->czd_buf, hdrsz);
 	czd->czd_ctfp = fp;
 	cthp = czd->czd_buf;
 	cthp->cth_flags |= CTF_F_COMPRESS;
-	czd->czd_next = (void *)((uintptr_t)czd->czd_buf +
-	    sizeof (ctf_header_t));
+	czd->czd_next = (void *)((uintptr_t)czd->czd_buf + hdrsz);
 
 	if (zlib.z_initcomp(&czd->czd_zstr, Z_BEST_COMPRESSION,
 	    ZLIB_VERSION, sizeof (z_stream)) != Z_OK)
@@ -277,8 +281,12 @@ ctf_compress(ctf_file_t *fp, void **buf, size_t *allocsz, size_t *elfsize)
 {
 	int err;
 	ctf_zdata_t czd;
-	ctf_header_t *cthp = (ctf_header_t *)fp->ctf_base;
+	ctf_header_t *cthp;
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (ctf_errno(fp));
+
+	cthp = (ctf_header_t *)fp->ctf_base;
 	if ((err = ctf_zdata_init(&czd, fp)) != 0)
 		return (err);
 
@@ -705,10 +713,15 @@ ctf_open(const char *filename, int *errp)
 int
 ctf_write(ctf_file_t *fp, int fd)
 {
-	const uchar_t *buf = fp->ctf_base;
-	ssize_t resid = fp->ctf_size;
+	const uchar_t *buf;
+	ssize_t resid;
 	ssize_t len;
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (CTF_ERR); /* errno is set for us */
+
+	buf = fp->ctf_base;
+	resid = fp->ctf_size;
 	while (resid != 0) {
 		if ((len = write(fd, buf, resid)) <= 0)
 			return (ctf_set_errno(fp, errno));
@@ -788,6 +801,9 @@ ctf_symtab_iter(ctf_file_t *fp, ctf_symtab_f func, void *arg)
 		return (ECTF_NOSYMTAB);
 	}
 
+	if (ctf_load(fp) == CTF_ERR)
+		return (ctf_errno(fp));
+
 	symbase = (uintptr_t)fp->ctf_symtab.cts_data;
 	strbase = (uintptr_t)fp->ctf_strtab.cts_data;
 
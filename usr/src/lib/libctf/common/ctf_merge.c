@@ -1198,6 +1198,9 @@ ctf_merge_add(ctf_merge_t *cmh, ctf_file_t *input)
 
 	ctf_dprintf("adding input %p\n", input);
 
+	if (ctf_load(input) == CTF_ERR)
+		return (ctf_errno(input));
+
 	if (input->ctf_flags & LCTF_CHILD)
 		return (ECTF_MCHILD);
 
@@ -1253,6 +1256,9 @@ ctf_merge_uniquify(ctf_merge_t *cmh, ctf_file_t *u, const char *pname)
 {
 	char *dup;
 
+	if (ctf_load(u) == CTF_ERR)
+		return (ctf_errno(u));
+
 	if (u->ctf_flags & LCTF_CHILD)
 		return (ECTF_MCHILD);
 	if (pname == NULL)
@@ -154,11 +154,21 @@ static umem_env_item_t umem_options_items[] = {
 		"The preferred page size for the sbrk(2) heap.",
 		NULL, 0, NULL,	&vmem_sbrk_pagesize
 	},
+	{ "mmap_pagesize",	"Private",	ITEM_SIZE,
+		"The preferred page size for the mmap(2) heap.",
+		NULL, 0, NULL,	&vmem_mmap_pagesize
+	},
 #endif
 	{ "perthread_cache",	"Evolving",	ITEM_SIZE,
 		"Size (in bytes) of per-thread allocation cache",
 		NULL, 0, NULL, &umem_ptc_size
 	},
+#ifndef UMEM_STANDALONE
+	{ "lgrp",		"Private",	ITEM_OPTUINT,
+		"Per-lgroup depots and slab arenas, optionally how many",
+		&umem_lgrp_enable, 1,	&umem_lgrp_ndepots
+	},
+#endif
 	{ NULL, "-- end of UMEM_OPTIONS --",	ITEM_INVALID }
 };
 
@@ -34,6 +34,10 @@
 #include "vmem_base.h"
 #include <unistd.h>
 #include <dlfcn.h>
+#include <sys/mman.h>
+#include <sys/lgrp_user.h>
+
+extern lgrp_id_t _lgrp_home_fast(void);
 
 void
 vmem_heap_init(void)
@@ -69,3 +73,23 @@ umem_get_max_ncpus(void)
 	else
 		return (1);
 }
+
+/*
+ * The home lgroup of the calling thread.  This is what lgrp_home(3LGRP)
+ * does for the current thread, without linking against liblgrp.
+ */
+int
+umem_lgrp_home(void)
+{
+	return (_lgrp_home_fast());
+}
+
+/*
+ * Place the pages of [addr, addr + len) in the lgroup of the next thread
+ * touching them.
+ */
+void
+umem_lgrp_advise(void *addr, size_t len)
+{
+	(void) madvise(addr, len, MADV_ACCESS_LWP);
+}
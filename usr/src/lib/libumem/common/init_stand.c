@@ -57,6 +57,18 @@ umem_get_max_ncpus(void)
 	return (1);
 }
 
+int
+umem_lgrp_home(void)
+{
+	return (0);
+}
+
+/*ARGSUSED*/
+void
+umem_lgrp_advise(void *addr, size_t len)
+{
+}
+
 int
 umem_add(caddr_t base, size_t len)
 {
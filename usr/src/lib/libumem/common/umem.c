@@ -47,7 +47,7 @@
  *
  * 1. Overview
  * -----------
- * umem is very close to kmem in implementation.  There are seven major
+ * umem is very close to kmem in implementation.  There are eight major
  * areas of divergence:
  *
  *	* Initialization
@@ -64,6 +64,8 @@
  *
  *	* Per-thread caching for malloc/free
  *
+ *	* Lgroup-aware depots and slab arenas
+ *
  * 2. Initialization
  * -----------------
  * kmem is initialized early on in boot, and knows that no one will call
@@ -357,7 +359,8 @@
  *	umem_flags_lock
  *	umem_cache_t's:
  *		cache_cpu[*].cc_lock
- *		cache_depot_lock
+ *		cache_depot.dp_lock
+ *		cache_lgrp_depot[*].dp_lock
  *		cache_lock
  *	umem_log_header_t's:
  *		lh_cpu[*].clh_lock
@@ -598,6 +601,37 @@
  * be iterated over with the umem_ptc_* walkers. (These walkers allow an
  * optional ulwp_t to be specified to iterate only over a particular thread's
  * cache.)
+ *
+ * 9. Lgroup-aware depots and slab arenas
+ * --------------------------------------
+ *
+ * By default a cache has a single depot, and all slabs come from one arena,
+ * so on a NUMA machine a magazine filled by a thread on one lgroup is just
+ * as likely to be handed to a thread on another, and slab memory is wherever
+ * it happened to be first touched.  The lgrp UMEM_OPTION (UMEM_OPTIONS=lgrp
+ * or UMEM_OPTIONS=lgrp=<n>) changes this for the caches backed by
+ * umem_default_arena (this includes the umem_alloc_* caches behind malloc):
+ *
+ *	* umem_cache_init() creates <n> arenas (8 by default), umem_lgrp_0
+ *	  through umem_lgrp_<n-1>.  They import from the same source as
+ *	  umem_default_arena, and advise each imported span MADV_ACCESS_LWP,
+ *	  so that its pages are placed in the lgroup of the thread creating
+ *	  the slab, which is the next to touch them.
+ *
+ *	* Every such cache gets <n> depots in cache_lgrp_depot, in addition to
+ *	  the process-wide cache_depot (which is then unused).
+ *
+ * Both are indexed by the home lgroup of the calling thread, modulo <n>,
+ * which umem_lgrp_home() gets with the same fast trap as lgrp_home(3LGRP);
+ * the rest of liblgrp cannot be used here, as it allocates memory.  Slabs
+ * record the arena they came from in slab_lgrp.
+ *
+ * Buffers still move between lgroups when they are allocated on one and
+ * freed on another.  When a full magazine is returned to an lgroup depot,
+ * its rounds from another lgroup's slabs are counted in dp_remote_free,
+ * which ::umastat reports per cache.  Finding the slab of a buffer in a
+ * UMF_HASH cache requires the hash table, so their remote frees are not
+ * counted.
  */
 
 #include <umem_impl.h>
@@ -707,6 +741,8 @@ size_t umem_lite_maxalign = 1024; /* maximum buffer alignment for UMF_LITE */
 size_t umem_maxverify;		/* maximum bytes to inspect in debug routines */
 size_t umem_minfirewall;	/* hardware-enforced redzone threshold */
 size_t umem_ptc_size = 1048576;	/* size of per-thread cache (in bytes) */
+uint_t umem_lgrp_enable = 0;	/* lgroup depots and arenas [default: off] */
+uint_t umem_lgrp_ndepots = 8;	/* # of lgroup depots and arenas */
 
 uint_t umem_flags = 0;
 uintptr_t umem_tmem_off;
@@ -743,6 +779,11 @@ static vmem_t		*umem_default_arena;
 static vmem_t		*umem_firewall_va_arena;
 static vmem_t		*umem_firewall_arena;
 
+#define	UMEM_LGRP_MAXDEPOTS	64	/* NLGRPS_MAX */
+
+static vmem_t		*umem_lgrp_arena[UMEM_LGRP_MAXDEPOTS];
+static uint_t		umem_lgrp_narenas;	/* # of lgroup arenas */
+
 vmem_t			*umem_memalign_arena;
 
 umem_log_header_t *umem_transaction_log;
@@ -807,16 +848,18 @@ umem_cache_t		umem_null_cache = {
 		&umem_null_cache.cache_nullslab,
 		NULL,
 		-1,
+		0,
 		0
 	},
 	NULL,
 	NULL,
-	DEFAULTMUTEX,				/* start of depot layer */
-	NULL, {
-		NULL, 0, 0, 0, 0
-	}, {
-		NULL, 0, 0, 0, 0
-	}, {
+	{
+		DEFAULTMUTEX,			/* start of depot layer */
+		{ NULL, 0, 0, 0, 0 },
+		{ NULL, 0, 0, 0, 0 },
+		0, 0
+	},
+	NULL, NULL, 0, {
 		{
 			DEFAULTMUTEX,		/* start of CPU cache */
 			0, 0, NULL, NULL, -1, -1, 0
@@ -1407,6 +1450,12 @@ umem_slab_create(umem_cache_t *cp, int umflag)
 	umem_slab_t *sp;
 	umem_bufctl_t *bcp;
 	vmem_t *vmp = cp->cache_arena;
+	int lgrp = 0;
+
+	if (cp->cache_lgrp_ndepots != 0) {
+		lgrp = (uint_t)umem_lgrp_home() % cp->cache_lgrp_ndepots;
+		vmp = umem_lgrp_arena[lgrp];
+	}
 
 	color = cp->cache_color + cp->cache_align;
 	if (color > cp->cache_maxcolor)
@@ -1438,6 +1487,7 @@ umem_slab_create(umem_cache_t *cp, int umflag)
 	sp->slab_refcnt	= 0;
 	sp->slab_base	= buf = slab + color;
 	sp->slab_chunks	= chunks;
+	sp->slab_lgrp	= lgrp;
 
 	ASSERT(chunks > 0);
 	while (chunks-- != 0) {
@@ -1501,7 +1551,8 @@ vmem_alloc_failure:
 static void
 umem_slab_destroy(umem_cache_t *cp, umem_slab_t *sp)
 {
-	vmem_t *vmp = cp->cache_arena;
+	vmem_t *vmp = cp->cache_lgrp_ndepots != 0 ?
+	    umem_lgrp_arena[sp->slab_lgrp] : cp->cache_arena;
 	void *slab = (void *)P2ALIGN((uintptr_t)sp->slab_base, vmp->vm_quantum);
 
 	if (cp->cache_flags & UMF_HASH) {
@@ -1805,11 +1856,27 @@ umem_magazine_destroy(umem_cache_t *cp, umem_magazine_t *mp, int nrounds)
 	_umem_cache_free(cp->cache_magtype->mt_cache, mp);
 }
 
+/*
+ * Return the depot for the calling thread: the depot of its home lgroup if
+ * cp has lgroup depots, or the process-wide depot.
+ */
+static umem_depot_t *
+umem_cache_depot(umem_cache_t *cp)
+{
+	uint_t lgrp;
+
+	if (cp->cache_lgrp_ndepots == 0)
+		return (&cp->cache_depot);
+
+	lgrp = (uint_t)umem_lgrp_home() % cp->cache_lgrp_ndepots;
+	return (&cp->cache_lgrp_depot[lgrp]);
+}
+
 /*
  * Allocate a magazine from the depot.
  */
 static umem_magazine_t *
-umem_depot_alloc(umem_cache_t *cp, umem_maglist_t *mlp)
+umem_depot_alloc(umem_cache_t *cp, umem_depot_t *dp, umem_maglist_t *mlp)
 {
 	umem_magazine_t *mp;
 
@@ -1819,9 +1886,9 @@ umem_depot_alloc(umem_cache_t *cp, umem_maglist_t *mlp)
 	 * contention rate to determine whether we need to
 	 * increase the magazine size for better scalability.
 	 */
-	if (mutex_trylock(&cp->cache_depot_lock) != 0) {
-		(void) mutex_lock(&cp->cache_depot_lock);
-		cp->cache_depot_contention++;
+	if (mutex_trylock(&dp->dp_lock) != 0) {
+		(void) mutex_lock(&dp->dp_lock);
+		dp->dp_contention++;
 	}
 
 	if ((mp = mlp->ml_list) != NULL) {
@@ -1832,7 +1899,7 @@ umem_depot_alloc(umem_cache_t *cp, umem_maglist_t *mlp)
 		mlp->ml_alloc++;
 	}
 
-	(void) mutex_unlock(&cp->cache_depot_lock);
+	(void) mutex_unlock(&dp->dp_lock);
 
 	return (mp);
 }
@@ -1841,48 +1908,88 @@ umem_depot_alloc(umem_cache_t *cp, umem_maglist_t *mlp)
  * Free a magazine to the depot.
  */
 static void
-umem_depot_free(umem_cache_t *cp, umem_maglist_t *mlp, umem_magazine_t *mp)
+umem_depot_free(umem_cache_t *cp, umem_depot_t *dp, umem_maglist_t *mlp,
+    umem_magazine_t *mp)
 {
-	(void) mutex_lock(&cp->cache_depot_lock);
+	(void) mutex_lock(&dp->dp_lock);
 	ASSERT(UMEM_MAGAZINE_VALID(cp, mp));
 	mp->mag_next = mlp->ml_list;
 	mlp->ml_list = mp;
 	mlp->ml_total++;
-	(void) mutex_unlock(&cp->cache_depot_lock);
+	(void) mutex_unlock(&dp->dp_lock);
+}
+
+/*
+ * Count the rounds of the full magazine mp, about to be freed to the lgroup
+ * depot dp, that came from the slabs of another lgroup's arena.
+ */
+static void
+umem_depot_count_remote(umem_cache_t *cp, umem_depot_t *dp,
+    umem_magazine_t *mp, int rounds)
+{
+	int lgrp = dp - cp->cache_lgrp_depot;
+	uint64_t remote = 0;
+	int i;
+
+	if (cp->cache_lgrp_ndepots == 0 || (cp->cache_flags & UMF_HASH))
+		return;
+
+	for (i = 0; i < rounds; i++) {
+		if (UMEM_SLAB(cp, mp->mag_round[i])->slab_lgrp != lgrp)
+			remote++;
+	}
+
+	if (remote != 0)
+		atomic_add_64(&dp->dp_remote_free, remote);
 }
 
 /*
- * Update the working set statistics for cp's depot.
+ * Update the working set statistics for cp's depots.
  */
 static void
 umem_depot_ws_update(umem_cache_t *cp)
 {
-	(void) mutex_lock(&cp->cache_depot_lock);
-	cp->cache_full.ml_reaplimit = cp->cache_full.ml_min;
-	cp->cache_full.ml_min = cp->cache_full.ml_total;
-	cp->cache_empty.ml_reaplimit = cp->cache_empty.ml_min;
-	cp->cache_empty.ml_min = cp->cache_empty.ml_total;
-	(void) mutex_unlock(&cp->cache_depot_lock);
+	umem_depot_t *dp;
+	uint_t i;
+
+	for (i = 0; i <= cp->cache_lgrp_ndepots; i++) {
+		dp = UMEM_DEPOT(cp, i);
+		(void) mutex_lock(&dp->dp_lock);
+		dp->dp_full.ml_reaplimit = dp->dp_full.ml_min;
+		dp->dp_full.ml_min = dp->dp_full.ml_total;
+		dp->dp_empty.ml_reaplimit = dp->dp_empty.ml_min;
+		dp->dp_empty.ml_min = dp->dp_empty.ml_total;
+		(void) mutex_unlock(&dp->dp_lock);
+	}
 }
 
 /*
- * Reap all magazines that have fallen out of the depot's working set.
+ * Reap all magazines that have fallen out of the depots' working sets.
  */
 static void
 umem_depot_ws_reap(umem_cache_t *cp)
 {
 	long reap;
 	umem_magazine_t *mp;
+	umem_depot_t *dp;
+	uint_t i;
 
 	ASSERT(cp->cache_next == NULL || IN_REAP());
 
-	reap = MIN(cp->cache_full.ml_reaplimit, cp->cache_full.ml_min);
-	while (reap-- && (mp = umem_depot_alloc(cp, &cp->cache_full)) != NULL)
-		umem_magazine_destroy(cp, mp, cp->cache_magtype->mt_magsize);
+	for (i = 0; i <= cp->cache_lgrp_ndepots; i++) {
+		dp = UMEM_DEPOT(cp, i);
+
+		reap = MIN(dp->dp_full.ml_reaplimit, dp->dp_full.ml_min);
+		while (reap-- &&
+		    (mp = umem_depot_alloc(cp, dp, &dp->dp_full)) != NULL)
+			umem_magazine_destroy(cp, mp,
+			    cp->cache_magtype->mt_magsize);
 
-	reap = MIN(cp->cache_empty.ml_reaplimit, cp->cache_empty.ml_min);
-	while (reap-- && (mp = umem_depot_alloc(cp, &cp->cache_empty)) != NULL)
-		umem_magazine_destroy(cp, mp, 0);
+		reap = MIN(dp->dp_empty.ml_reaplimit, dp->dp_empty.ml_min);
+		while (reap-- &&
+		    (mp = umem_depot_alloc(cp, dp, &dp->dp_empty)) != NULL)
+			umem_magazine_destroy(cp, mp, 0);
+	}
 }
 
 static void
@@ -1907,6 +2014,7 @@ _umem_cache_alloc(umem_cache_t *cp, int umflag)
 {
 	umem_cpu_cache_t *ccp;
 	umem_magazine_t *fmp;
+	umem_depot_t *dp;
 	void *buf;
 	int flags_nfatal;
 
@@ -1951,10 +2059,11 @@ retry:
 		/*
 		 * Try to get a full magazine from the depot.
 		 */
-		fmp = umem_depot_alloc(cp, &cp->cache_full);
+		dp = umem_cache_depot(cp);
+		fmp = umem_depot_alloc(cp, dp, &dp->dp_full);
 		if (fmp != NULL) {
 			if (ccp->cc_ploaded != NULL)
-				umem_depot_free(cp, &cp->cache_empty,
+				umem_depot_free(cp, dp, &dp->dp_empty,
 				    ccp->cc_ploaded);
 			umem_cpu_reload(ccp, fmp, ccp->cc_magsize);
 			continue;
@@ -2026,6 +2135,7 @@ _umem_cache_free(umem_cache_t *cp, void *buf)
 	umem_cpu_cache_t *ccp = UMEM_CPU_CACHE(cp, CPU(cp->cache_cpu_mask));
 	umem_magazine_t *emp;
 	umem_magtype_t *mtp;
+	umem_depot_t *dp;
 
 	if (ccp->cc_flags & UMF_BUFTAG)
 		if (umem_cache_free_debug(cp, buf) == -1)
@@ -2062,11 +2172,15 @@ _umem_cache_free(umem_cache_t *cp, void *buf)
 		/*
 		 * Try to get an empty magazine from the depot.
 		 */
-		emp = umem_depot_alloc(cp, &cp->cache_empty);
+		dp = umem_cache_depot(cp);
+		emp = umem_depot_alloc(cp, dp, &dp->dp_empty);
 		if (emp != NULL) {
-			if (ccp->cc_ploaded != NULL)
-				umem_depot_free(cp, &cp->cache_full,
+			if (ccp->cc_ploaded != NULL) {
+				umem_depot_count_remote(cp, dp,
+				    ccp->cc_ploaded, ccp->cc_prounds);
+				umem_depot_free(cp, dp, &dp->dp_full,
 				    ccp->cc_ploaded);
+			}
 			umem_cpu_reload(ccp, emp, 0);
 			continue;
 		}
@@ -2100,7 +2214,7 @@ _umem_cache_free(umem_cache_t *cp, void *buf)
 			 * We got a magazine of the right size.  Add it to
 			 * the depot and try the whole dance again.
 			 */
-			umem_depot_free(cp, &cp->cache_empty, emp);
+			umem_depot_free(cp, dp, &dp->dp_empty, emp);
 			continue;
 		}
 
@@ -2291,6 +2405,20 @@ umem_firewall_va_free(vmem_t *vmp, void *addr, size_t size)
 	vmem_free(vmp, addr, size + vmp->vm_quantum);
 }
 
+/*
+ * Import function of the lgroup arenas.  The span is only ever touched by
+ * threads creating slabs, all of which are homed in the arena's lgroup.
+ */
+static void *
+umem_lgrp_alloc(vmem_t *vmp, size_t size, int vmflag)
+{
+	void *addr = heap_alloc(vmp, size, vmflag);
+
+	if (addr != NULL)
+		umem_lgrp_advise(addr, size);
+	return (addr);
+}
+
 /*
  * Reclaim all unused memory from a cache.
  */
@@ -2397,11 +2525,11 @@ umem_cache_magazine_resize(umem_cache_t *cp)
 
 	if (cp->cache_chunksize < mtp->mt_maxbuf) {
 		umem_cache_magazine_purge(cp);
-		(void) mutex_lock(&cp->cache_depot_lock);
+		(void) mutex_lock(&cp->cache_depot.dp_lock);
 		cp->cache_magtype = ++mtp;
 		cp->cache_depot_contention_prev =
 		    cp->cache_depot_contention + INT_MAX;
-		(void) mutex_unlock(&cp->cache_depot_lock);
+		(void) mutex_unlock(&cp->cache_depot.dp_lock);
 		umem_cache_magazine_enable(cp);
 	}
 }
@@ -2465,6 +2593,8 @@ void
 umem_cache_update(umem_cache_t *cp)
 {
 	int update_flags = 0;
+	uint64_t contention;
+	uint_t i;
 
 	ASSERT(MUTEX_HELD(&umem_cache_lock));
 
@@ -2488,10 +2618,14 @@ umem_cache_update(umem_cache_t *cp)
 	umem_depot_ws_update(cp);
 
 	/*
-	 * If there's a lot of contention in the depot,
+	 * If there's a lot of contention in the depots,
 	 * increase the magazine size.
 	 */
-	(void) mutex_lock(&cp->cache_depot_lock);
+	(void) mutex_lock(&cp->cache_depot.dp_lock);
+
+	for (contention = 0, i = 0; i <= cp->cache_lgrp_ndepots; i++)
+		contention += UMEM_DEPOT(cp, i)->dp_contention;
+	cp->cache_depot_contention = contention;
 
 	if (cp->cache_chunksize < cp->cache_magtype->mt_maxbuf &&
 	    (int)(cp->cache_depot_contention -
@@ -2500,7 +2634,7 @@ umem_cache_update(umem_cache_t *cp)
 
 	cp->cache_depot_contention_prev = cp->cache_depot_contention;
 
-	(void) mutex_unlock(&cp->cache_depot_lock);
+	(void) mutex_unlock(&cp->cache_depot.dp_lock);
 
 	if (update_flags)
 		umem_add_update(cp, update_flags);
@@ -2572,6 +2706,7 @@ umem_st_update(void)
 	(void) mutex_unlock(&umem_update_lock);
 
 	vmem_update(NULL);
+	vmem_mmap_defrag();
 	umem_cache_applyall(umem_cache_update);
 
 	(void) mutex_lock(&umem_update_lock);
@@ -2914,13 +3049,34 @@ umem_cache_create(
 	/*
 	 * Initialize the depot.
 	 */
-	(void) mutex_init(&cp->cache_depot_lock, USYNC_THREAD, NULL);
+	(void) mutex_init(&cp->cache_depot.dp_lock, USYNC_THREAD, NULL);
 
 	for (mtp = umem_magtype; chunksize <= mtp->mt_minbuf; mtp++)
 		continue;
 
 	cp->cache_magtype = mtp;
 
+	/*
+	 * Caches backed by the default arena get per-lgroup depots and slab
+	 * arenas if they are enabled.  If we can't allocate the depots, the
+	 * cache just makes do with the process-wide depot and arena.
+	 */
+	if (umem_lgrp_narenas != 0 && vmp == umem_default_arena) {
+		size_t dsize = umem_lgrp_narenas * sizeof (umem_depot_t);
+		uint_t i;
+
+		cp->cache_lgrp_depot = vmem_xalloc(umem_cache_arena, dsize,
+		    UMEM_DEPOT_SIZE, 0, 0, NULL, NULL, VM_NOSLEEP);
+
+		if (cp->cache_lgrp_depot != NULL) {
+			bzero(cp->cache_lgrp_depot, dsize);
+			cp->cache_lgrp_ndepots = umem_lgrp_narenas;
+			for (i = 1; i <= cp->cache_lgrp_ndepots; i++)
+				(void) mutex_init(&UMEM_DEPOT(cp, i)->dp_lock,
+				    USYNC_THREAD, NULL);
+		}
+	}
+
 	/*
 	 * Initialize the CPU layer.
 	 */
@@ -2959,6 +3115,7 @@ void
 umem_cache_destroy(umem_cache_t *cp)
 {
 	int cpu_seqid;
+	uint_t i;
 
 	/*
 	 * Remove the cache from the global cache list so that no new updates
@@ -2996,7 +3153,11 @@ umem_cache_destroy(umem_cache_t *cp)
 	for (cpu_seqid = 0; cpu_seqid < umem_max_ncpus; cpu_seqid++)
 		(void) mutex_destroy(&cp->cache_cpu[cpu_seqid].cc_lock);
 
-	(void) mutex_destroy(&cp->cache_depot_lock);
+	for (i = 0; i <= cp->cache_lgrp_ndepots; i++)
+		(void) mutex_destroy(&UMEM_DEPOT(cp, i)->dp_lock);
+	if (cp->cache_lgrp_depot != NULL)
+		vmem_xfree(umem_cache_arena, cp->cache_lgrp_depot,
+		    cp->cache_lgrp_ndepots * sizeof (umem_depot_t));
 	(void) mutex_destroy(&cp->cache_lock);
 
 	vmem_free(umem_cache_arena, cp, UMEM_CACHE_SIZE(umem_max_ncpus));
@@ -3182,6 +3343,23 @@ umem_cache_init(void)
 	if (umem_default_arena == NULL)
 		return (0);
 
+	/*
+	 * Create the lgroup arenas, if enabled.  See "Lgroup-aware depots
+	 * and slab arenas", above.
+	 */
+	if (umem_lgrp_enable) {
+		for (i = 0; i < umem_lgrp_ndepots; i++) {
+			(void) snprintf(name, sizeof (name), "umem_lgrp_%d", i);
+			umem_lgrp_arena[i] = vmem_create(name,
+			    NULL, 0, pagesize,
+			    umem_lgrp_alloc, heap_free, umem_va_arena,
+			    0, VM_NOSLEEP);
+			if (umem_lgrp_arena[i] == NULL)
+				return (0);
+		}
+		umem_lgrp_narenas = umem_lgrp_ndepots;
+	}
+
 	/*
 	 * make sure the umem_alloc table initializer is correct
 	 */
@@ -3301,6 +3479,7 @@ umem_startup(caddr_t start, size_t len, size_t pagesize, caddr_t minstack,
 	umem_default_arena = NULL;
 	umem_firewall_va_arena = NULL;
 	umem_firewall_arena = NULL;
+	umem_lgrp_narenas = 0;
 	umem_memalign_arena = NULL;
 	umem_transaction_log = NULL;
 	umem_content_log = NULL;
@@ -3414,6 +3593,12 @@ umem_init(void)
 		    sizeof (umem_cpu_cache_t), UMEM_CPU_CACHE_SIZE);
 	}
 
+	/* LINTED constant condition */
+	if (sizeof (umem_depot_t) != UMEM_DEPOT_SIZE) {
+		umem_panic("sizeof (umem_depot_t) = %d, should be %d\n",
+		    sizeof (umem_depot_t), UMEM_DEPOT_SIZE);
+	}
+
 	umem_max_ncpus = umem_get_max_ncpus();
 
 	/*
@@ -3424,6 +3609,10 @@ umem_init(void)
 	if (issetugid())
 		umem_mtbf = 0;
 
+	if (umem_lgrp_ndepots == 0)
+		umem_lgrp_enable = 0;
+	umem_lgrp_ndepots = MIN(umem_lgrp_ndepots, UMEM_LGRP_MAXDEPOTS);
+
 	/*
 	 * set up vmem
 	 */
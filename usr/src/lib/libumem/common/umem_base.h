@@ -101,6 +101,8 @@ extern size_t umem_lite_maxalign;
 extern size_t umem_maxverify;
 extern size_t umem_minfirewall;
 extern size_t umem_ptc_size;
+extern uint_t umem_lgrp_enable;
+extern uint_t umem_lgrp_ndepots;
 
 extern uint32_t umem_flags;
 
@@ -119,6 +121,8 @@ extern void _umem_cache_free(umem_cache_t *cache, void *buffer);
  */
 extern void umem_type_init(caddr_t, size_t, size_t);
 extern int umem_get_max_ncpus(void);
+extern int umem_lgrp_home(void);
+extern void umem_lgrp_advise(void *, size_t);
 extern void umem_process_updates(void);
 extern void umem_cache_applyall(void (*)(umem_cache_t *));
 extern void umem_cache_update(umem_cache_t *);
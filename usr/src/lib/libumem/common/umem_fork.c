@@ -45,7 +45,8 @@ umem_lockup_cache(umem_cache_t *cp)
 	for (idx = 0; idx < ncpus; idx++)
 		(void) mutex_lock(&cp->cache_cpu[idx].cc_lock);
 
-	(void) mutex_lock(&cp->cache_depot_lock);
+	for (idx = 0; idx <= cp->cache_lgrp_ndepots; idx++)
+		(void) mutex_lock(&UMEM_DEPOT(cp, idx)->dp_lock);
 	(void) mutex_lock(&cp->cache_lock);
 }
 
@@ -56,7 +57,8 @@ umem_release_cache(umem_cache_t *cp)
 	int ncpus = cp->cache_cpu_mask + 1;
 
 	(void) mutex_unlock(&cp->cache_lock);
-	(void) mutex_unlock(&cp->cache_depot_lock);
+	for (idx = 0; idx <= cp->cache_lgrp_ndepots; idx++)
+		(void) mutex_unlock(&UMEM_DEPOT(cp, idx)->dp_lock);
 
 	for (idx = 0; idx < ncpus; idx++)
 		(void) mutex_unlock(&cp->cache_cpu[idx].cc_lock);
@@ -204,6 +204,7 @@ typedef struct umem_slab {
 	struct umem_bufctl	*slab_head;	/* first free buffer */
 	long			slab_refcnt;	/* outstanding allocations */
 	long			slab_chunks;	/* chunks (bufs) in this slab */
+	int			slab_lgrp;	/* lgroup arena of this slab */
 } umem_slab_t;
 
 #define	UMEM_HASH_INITIAL	64
@@ -260,6 +261,31 @@ typedef struct umem_maglist {
 	uint64_t	ml_alloc;	/* allocations from this list */
 } umem_maglist_t;
 
+/*
+ * The depot.  Every cache has a process-wide depot; caches backed by the
+ * lgroup arenas (UMEM_OPTIONS=lgrp) also have one depot per lgroup, which
+ * are padded to avoid false sharing between lgroups.
+ */
+#define	UMEM_DEPOT_SIZE		128	/* must be power of 2 */
+#define	UMEM_DEPOT_PAD		(UMEM_DEPOT_SIZE - sizeof (mutex_t) - \
+	2 * sizeof (umem_maglist_t) - 2 * sizeof (uint64_t))
+
+typedef struct umem_depot {
+	mutex_t		dp_lock;	/* protects this depot */
+	umem_maglist_t	dp_full;	/* full magazines */
+	umem_maglist_t	dp_empty;	/* empty magazines */
+	uint64_t	dp_contention;	/* mutex contention count */
+	uint64_t	dp_remote_free;	/* rounds freed from remote slabs */
+	char		dp_pad[UMEM_DEPOT_PAD]; /* for nice alignment */
+} umem_depot_t;
+
+/*
+ * Depot 0 is the process-wide depot, and depots 1 through
+ * cache_lgrp_ndepots are the per-lgroup depots.
+ */
+#define	UMEM_DEPOT(cp, i)	((i) == 0 ? &(cp)->cache_depot : \
+	&(cp)->cache_lgrp_depot[(i) - 1])
+
 #define	UMEM_CACHE_NAMELEN	31
 
 struct umem_cache {
@@ -275,7 +301,7 @@ struct umem_cache {
 	uint64_t	cache_bufmax;		/* max buffers ever */
 	uint64_t	cache_rescale;		/* # of hash table rescales */
 	uint64_t	cache_lookup_depth;	/* hash lookup depth */
-	uint64_t	cache_depot_contention;	/* mutex contention count */
+	uint64_t	cache_depot_contention;	/* contention in all depots */
 	uint64_t	cache_depot_contention_prev; /* previous snapshot */
 
 	/*
@@ -321,10 +347,10 @@ struct umem_cache {
 	/*
 	 * Depot layer
 	 */
-	mutex_t		cache_depot_lock;	/* protects depot */
+	umem_depot_t	cache_depot;		/* process-wide depot */
 	umem_magtype_t	*cache_magtype;		/* magazine type */
-	umem_maglist_t	cache_full;		/* full magazines */
-	umem_maglist_t	cache_empty;		/* empty magazines */
+	umem_depot_t	*cache_lgrp_depot;	/* per-lgroup depots */
+	uint_t		cache_lgrp_ndepots;	/* number of lgroup depots */
 
 	/*
 	 * Per-CPU layer
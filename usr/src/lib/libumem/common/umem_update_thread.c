@@ -84,6 +84,7 @@ umem_update_thread(void *arg)
 			(void) mutex_unlock(&umem_update_lock);
 
 			vmem_update(NULL);
+			vmem_mmap_defrag();
 			/*
 			 * umem_cache_update can use umem_add_update to
 			 * request further work.  The update is not complete
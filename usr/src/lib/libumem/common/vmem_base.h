@@ -53,12 +53,15 @@ extern vmem_t *vmem_sbrk_arena(vmem_alloc_t **, vmem_free_t **);
 extern vmem_t *vmem_mmap_arena(vmem_alloc_t **, vmem_free_t **);
 extern vmem_t *vmem_stand_arena(vmem_alloc_t **, vmem_free_t **);
 
+extern void vmem_mmap_defrag(void);
+
 extern void vmem_update(void *);
 extern void vmem_reap(void);		/* vmem_populate()-safe reap */
 
 extern size_t pagesize;
 extern size_t vmem_sbrk_pagesize;
 extern size_t vmem_sbrk_minalloc;
+extern size_t vmem_mmap_pagesize;
 
 extern uint_t vmem_backend;
 #define	VMEM_BACKEND_SBRK	0x0000001
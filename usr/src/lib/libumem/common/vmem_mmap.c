@@ -26,12 +26,62 @@
 
 #pragma ident	"%Z%%M%	%I%	%E% SMI"
 
+/*
+ * The structure of the mmap backend:
+ *
+ * +-----------+
+ * | mmap_top  |
+ * +-----------+
+ *      | (vmem_mmap_top_alloc(), vmem_free())
+ *      |
+ * +-----------+
+ * | mmap_heap |
+ * +-----------+
+ *   | | ... |  (vmem_mmap_alloc(), vmem_mmap_free())
+ * <other arenas>
+ *
+ * The mmap_top arena holds reserved, PROT_NONE address space.  By default,
+ * each allocation from mmap_heap is mapped in as it is handed out, and
+ * mapped out again when it is freed.
+ *
+ * If the mmap_pagesize option names a supported large page size, the heap
+ * is built out of naturally aligned chunks of that size instead:
+ *
+ * +-----------+
+ * | mmap_top  |		quantum is the large page size
+ * +-----------+
+ *      | (vmem_mmap_lp_alloc(), vmem_mmap_free())
+ *      |
+ * +-----------+
+ * | mmap_heap |
+ * +-----------+
+ *   | | ... |  (vmem_alloc(), vmem_free())
+ * <other arenas>
+ *
+ * Each chunk is mapped in whole, and advised with MC_HAT_ADVISE, when it is
+ * imported into mmap_heap, so that its pages are faulted in as large pages.
+ * Allocations from the heap no longer touch the mappings.  Since imported
+ * spans are never coalesced, a best-fit heap (the default) carves new slabs
+ * out of the holes in partially used chunks before it starts on a free one,
+ * which keeps the large pages densely used.  When every allocation in a
+ * chunk has been freed, the chunk goes back to mmap_top and is mapped out.
+ *
+ * Free memory inside chunks which are still in use stays resident, so
+ * vmem_mmap_defrag() is called from the periodic update to give it back.
+ * Any naturally aligned large page which is entirely free is mapped anew,
+ * which releases its memory and leaves it ready to be faulted in as a large
+ * page again.  Freeing part of a large page forces the kernel to demote it
+ * to base pages, so that is only done once most of the heap is free.
+ */
+
 #include <unistd.h>
 #include <errno.h>
 #include <sys/mman.h>
 #include <sys/sysmacros.h>
 #include "vmem_base.h"
 
+#include "misc.h"
+
 #define	ALLOC_PROT	PROT_READ | PROT_WRITE | PROT_EXEC
 #define	FREE_PROT	PROT_NONE
 
@@ -40,7 +90,22 @@
 
 #define	CHUNKSIZE	(64*1024)	/* 64 kilobytes */
 
+#define	MMAP_DEFRAG_MAX	64	/* free ranges released per defrag pass */
+
+size_t vmem_mmap_pagesize = 0;	/* the preferred page size of the heap */
+
 static vmem_t *mmap_heap;
+static size_t mmap_lpsize;	/* large page size of the heap, or 0 */
+static size_t mmap_defrag_inuse; /* heap usage after the last defrag pass */
+
+typedef struct mmap_defrag {
+	int		md_partial;	/* release parts of large pages, too */
+	uint_t		md_count;
+	struct {
+		uintptr_t	mr_start;
+		uintptr_t	mr_end;
+	} md_range[MMAP_DEFRAG_MAX];
+} mmap_defrag_t;
 
 static void *
 vmem_mmap_alloc(vmem_t *src, size_t size, int vmflags)
@@ -89,8 +154,8 @@ vmem_mmap_top_alloc(vmem_t *src, size_t size, int vmflags)
 	/*
 	 * Need to grow the heap
 	 */
-	buf = mmap((void *)CHUNKSIZE, size, FREE_PROT, FREE_FLAGS | MAP_ALIGN,
-	    -1, 0);
+	buf = mmap((void *)MAX(CHUNKSIZE, mmap_lpsize), size, FREE_PROT,
+	    FREE_FLAGS | MAP_ALIGN, -1, 0);
 
 	if (buf != MAP_FAILED) {
 		ret = _vmem_extend_alloc(src, buf, size, size, vmflags);
@@ -113,22 +178,202 @@ vmem_mmap_top_alloc(vmem_t *src, size_t size, int vmflags)
 	}
 }
 
+/*
+ * Ask for [addr, addr + size), which must be aligned to the large page
+ * size, to be backed by large pages.  This is only advice, so failure is
+ * not fatal.
+ */
+static void
+vmem_mmap_lp_advise(void *addr, size_t size)
+{
+	struct memcntl_mha mha;
+
+	mha.mha_cmd = MHA_MAPSIZE_VA;
+	mha.mha_flags = 0;
+	mha.mha_pagesize = mmap_lpsize;
+
+	(void) memcntl(addr, size, MC_HAT_ADVISE, (caddr_t)&mha, 0, 0);
+}
+
+/*
+ * Imports a run of large page chunks into mmap_heap, mapping it in whole.
+ */
+static void *
+vmem_mmap_lp_alloc(vmem_t *src, size_t size, int vmflags)
+{
+	void *ret;
+	int old_errno = errno;
+
+	ASSERT(IS_P2ALIGNED(size, mmap_lpsize));
+
+	ret = vmem_mmap_top_alloc(src, size, vmflags);
+	if (ret == NULL)
+		return (NULL);
+
+	if (mmap(ret, size, ALLOC_PROT, ALLOC_FLAGS | MAP_FIXED, -1, 0) ==
+	    MAP_FAILED) {
+		vmem_free(src, ret, size);
+		vmem_reap();
+
+		ASSERT((vmflags & VM_NOSLEEP) == VM_NOSLEEP);
+		errno = old_errno;
+		return (NULL);
+	}
+	vmem_mmap_lp_advise(ret, size);
+
+	errno = old_errno;
+	return (ret);
+}
+
+/*
+ * Returns the large page size to build the heap out of, or 0 if
+ * vmem_mmap_pagesize is unset or cannot be used.
+ */
+static size_t
+vmem_mmap_lp_validate(size_t pagesize)
+{
+	size_t sizes[16];
+	size_t lpsize = vmem_mmap_pagesize;
+	int i, n;
+
+	if (lpsize == 0 || issetugid())
+		return (0);
+
+	if (!ISP2(lpsize)) {
+		log_message("ignoring bad pagesize: 0x%p\n", lpsize);
+		return (0);
+	}
+
+	if (lpsize <= pagesize)
+		return (0);
+
+	n = getpagesizes(sizes, sizeof (sizes) / sizeof (sizes[0]));
+	for (i = 0; i < n; i++) {
+		if (sizes[i] == lpsize)
+			return (lpsize);
+	}
+
+	log_message("unsupported pagesize: 0x%p\n", lpsize);
+	return (0);
+}
+
 vmem_t *
 vmem_mmap_arena(vmem_alloc_t **a_out, vmem_free_t **f_out)
 {
 	size_t pagesize = sysconf(_SC_PAGESIZE);
 
 	if (mmap_heap == NULL) {
-		mmap_heap = vmem_init("mmap_top", CHUNKSIZE,
-		    vmem_mmap_top_alloc, vmem_free,
-		    "mmap_heap", NULL, 0, pagesize,
-		    vmem_mmap_alloc, vmem_mmap_free);
+		mmap_lpsize = vmem_mmap_lp_validate(pagesize);
+		vmem_mmap_pagesize = mmap_lpsize;
+
+		if (mmap_lpsize != 0) {
+			mmap_heap = vmem_init("mmap_top", mmap_lpsize,
+			    vmem_mmap_lp_alloc, vmem_mmap_free,
+			    "mmap_heap", NULL, 0, pagesize,
+			    vmem_alloc, vmem_free);
+		} else {
+			mmap_heap = vmem_init("mmap_top", CHUNKSIZE,
+			    vmem_mmap_top_alloc, vmem_free,
+			    "mmap_heap", NULL, 0, pagesize,
+			    vmem_mmap_alloc, vmem_mmap_free);
+		}
 	}
 
-	if (a_out != NULL)
-		*a_out = vmem_mmap_alloc;
-	if (f_out != NULL)
-		*f_out = vmem_mmap_free;
+	if (mmap_lpsize != 0) {
+		if (a_out != NULL)
+			*a_out = vmem_alloc;
+		if (f_out != NULL)
+			*f_out = vmem_free;
+	} else {
+		if (a_out != NULL)
+			*a_out = vmem_mmap_alloc;
+		if (f_out != NULL)
+			*f_out = vmem_mmap_free;
+	}
 
 	return (mmap_heap);
 }
+
+static void
+vmem_mmap_defrag_walk(void *arg, void *addr, size_t size)
+{
+	mmap_defrag_t *mdp = arg;
+	uintptr_t start = (uintptr_t)addr;
+	uintptr_t end = start + size;
+
+	if (mdp->md_count == MMAP_DEFRAG_MAX)
+		return;
+
+	if (!mdp->md_partial) {
+		start = P2ROUNDUP(start, mmap_lpsize);
+		end = P2ALIGN(end, mmap_lpsize);
+		if (start >= end)
+			return;
+	}
+
+	mdp->md_range[mdp->md_count].mr_start = start;
+	mdp->md_range[mdp->md_count].mr_end = end;
+	mdp->md_count++;
+}
+
+/*
+ * Gives the free memory inside the large page chunks of the heap back to
+ * the system.  Each free range is allocated from the heap while it is
+ * mapped anew, so that nobody can be handed it in the meantime; ranges
+ * which have been allocated since the walk are skipped.
+ *
+ * Called from the periodic update; this does nothing unless the heap is
+ * built out of large pages and memory has been freed since the last pass.
+ */
+void
+vmem_mmap_defrag(void)
+{
+	mmap_defrag_t md;
+	size_t inuse, avail;
+	int old_errno = errno;
+	uint_t i;
+
+	if (mmap_heap == NULL || mmap_lpsize == 0)
+		return;
+
+	inuse = vmem_size(mmap_heap, VMEM_ALLOC);
+	avail = vmem_size(mmap_heap, VMEM_FREE);
+	if (inuse >= mmap_defrag_inuse) {
+		mmap_defrag_inuse = inuse;
+		return;
+	}
+
+	md.md_partial = (avail > inuse);
+	md.md_count = 0;
+	vmem_walk(mmap_heap, VMEM_FREE, vmem_mmap_defrag_walk, &md);
+
+	for (i = 0; i < md.md_count; i++) {
+		uintptr_t start = md.md_range[i].mr_start;
+		uintptr_t end = md.md_range[i].mr_end;
+		uintptr_t lpstart = P2ROUNDUP(start, mmap_lpsize);
+		uintptr_t lpend = P2ALIGN(end, mmap_lpsize);
+		void *addr;
+
+		addr = vmem_xalloc(mmap_heap, end - start, 0, 0, 0,
+		    (void *)start, (void *)end, VM_NOSLEEP | VM_BESTFIT);
+		if (addr == NULL)
+			continue;
+		ASSERT((uintptr_t)addr == start);
+
+		/*
+		 * If the new mapping fails, the range may no longer be
+		 * mapped at all; it is safer to leak it than to hand it out.
+		 */
+		if (mmap(addr, end - start, ALLOC_PROT, ALLOC_FLAGS | MAP_FIXED,
+		    -1, 0) == MAP_FAILED)
+			continue;
+
+		if (lpstart < lpend)
+			vmem_mmap_lp_advise((void *)lpstart, lpend - lpstart);
+
+		vmem_xfree(mmap_heap, addr, end - start);
+	}
+
+	mmap_defrag_inuse = vmem_size(mmap_heap, VMEM_ALLOC);
+	errno = old_errno;
+}
@@ -373,16 +373,17 @@ get_recvd_props_ioctl(zfs_handle_t *zhp)
 	return (0);
 }
 
+/*
+ * Stores the given stats and properties in the handle, which takes over the
+ * property nvlist.
+ */
 static int
-put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+put_stats_props(zfs_handle_t *zhp, const dmu_objset_stats_t *stats,
+    nvlist_t *allprops)
 {
-	nvlist_t *allprops, *userprops;
-
-	zhp->zfs_dmustats = zc->zc_objset_stats; /* structure assignment */
+	nvlist_t *userprops;
 
-	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
-		return (-1);
-	}
+	zhp->zfs_dmustats = *stats; /* structure assignment */
 
 	/*
 	 * XXX Why do we store the user props separately, in addition to
@@ -402,6 +403,18 @@ put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+static int
+put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	nvlist_t *allprops;
+
+	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
+		return (-1);
+	}
+
+	return (put_stats_props(zhp, &zc->zc_objset_stats, allprops));
+}
+
 static int
 get_stats(zfs_handle_t *zhp)
 {
@@ -428,19 +441,12 @@ zfs_refresh_properties(zfs_handle_t *zhp)
 }
 
 /*
- * Makes a handle from the given dataset name.  Used by zfs_open() and
- * zfs_iter_* to create child handles on the fly.
+ * We've managed to open the dataset and gather statistics.  Determine the
+ * high-level type.
  */
 static int
-make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+make_dataset_handle_type(zfs_handle_t *zhp)
 {
-	if (put_stats_zhdl(zhp, zc) != 0)
-		return (-1);
-
-	/*
-	 * We've managed to open the dataset and gather statistics.  Determine
-	 * the high-level type.
-	 */
 	if (zhp->zfs_dmustats.dds_type == DMU_OST_ZVOL)
 		zhp->zfs_head_type = ZFS_TYPE_VOLUME;
 	else if (zhp->zfs_dmustats.dds_type == DMU_OST_ZFS)
@@ -465,6 +471,19 @@ make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+/*
+ * Makes a handle from the given dataset name.  Used by zfs_open() and
+ * zfs_iter_* to create child handles on the fly.
+ */
+static int
+make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	if (put_stats_zhdl(zhp, zc) != 0)
+		return (-1);
+
+	return (make_dataset_handle_type(zhp));
+}
+
 zfs_handle_t *
 make_dataset_handle(libzfs_handle_t *hdl, const char *path)
 {
@@ -511,8 +530,47 @@ make_dataset_handle_zc(libzfs_handle_t *hdl, zfs_cmd_t *zc)
 	return (zhp);
 }
 
+/*
+ * Makes a handle from an entry of the batch returned by lzc_list_batch().
+ */
 zfs_handle_t *
-make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
+make_dataset_handle_nvl(libzfs_handle_t *hdl, const char *name,
+    nvlist_t *entry)
+{
+	zfs_handle_t *zhp;
+	dmu_objset_stats_t stats;
+	nvlist_t *props, *allprops;
+	uint8_t *statsp;
+	uint_t statslen;
+
+	if (nvlist_lookup_uint8_array(entry, "stats", &statsp,
+	    &statslen) != 0 || statslen != sizeof (stats) ||
+	    nvlist_lookup_nvlist(entry, "props", &props) != 0)
+		return (NULL);
+	bcopy(statsp, &stats, sizeof (stats));
+
+	if ((zhp = calloc(sizeof (zfs_handle_t), 1)) == NULL)
+		return (NULL);
+
+	zhp->zfs_hdl = hdl;
+	(void) strlcpy(zhp->zfs_name, name, sizeof (zhp->zfs_name));
+	if (nvlist_dup(props, &allprops, 0) != 0 ||
+	    put_stats_props(zhp, &stats, allprops) != 0 ||
+	    make_dataset_handle_type(zhp) != 0) {
+		free(zhp);
+		return (NULL);
+	}
+
+	/*
+	 * The kernel has already pruned the properties against the table
+	 * set with zfs_iter_prune_proplist(), if any.
+	 */
+	zhp->zfs_props_table = hdl->libzfs_props_table;
+	return (zhp);
+}
+
+zfs_handle_t *
+make_dataset_simple_handle(zfs_handle_t *pzhp, const char *name)
 {
 	zfs_handle_t *zhp = calloc(sizeof (zfs_handle_t), 1);
 
@@ -520,7 +578,7 @@ make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
 		return (NULL);
 
 	zhp->zfs_hdl = pzhp->zfs_hdl;
-	(void) strlcpy(zhp->zfs_name, zc->zc_name, sizeof (zhp->zfs_name));
+	(void) strlcpy(zhp->zfs_name, name, sizeof (zhp->zfs_name));
 	zhp->zfs_head_type = pzhp->zfs_type;
 	zhp->zfs_type = ZFS_TYPE_SNAPSHOT;
 	zhp->zpool_hdl = zpool_handle(zhp);
@@ -4653,6 +4711,18 @@ zfs_deleg_share_nfs(libzfs_handle_t *hdl, char *dataset, char *path,
 	return (error);
 }
 
+/*
+ * Have the dataset iterators return handles whose properties are already
+ * pruned against the given table, as by zfs_prune_proplist(); the kernel
+ * then leaves the other native properties out of the listing altogether.
+ * The table must stay valid until it is reset with a NULL one.
+ */
+void
+zfs_iter_prune_proplist(libzfs_handle_t *hdl, uint8_t *props)
+{
+	hdl->libzfs_props_table = props;
+}
+
 void
 zfs_prune_proplist(zfs_handle_t *zhp, uint8_t *props)
 {
@@ -94,6 +94,7 @@ struct libzfs_handle {
 	di_devlink_handle_t libzfs_devlink;
 	regex_t libzfs_urire;
 	uint64_t libzfs_max_nvlist;
+	uint8_t *libzfs_props_table;
 };
 
 struct zfs_handle {
@@ -208,7 +209,9 @@ int zpool_standard_error_fmt(libzfs_handle_t *, int, const char *, ...);
 int get_dependents(libzfs_handle_t *, boolean_t, const char *, char ***,
     size_t *);
 zfs_handle_t *make_dataset_handle_zc(libzfs_handle_t *, zfs_cmd_t *);
-zfs_handle_t *make_dataset_simple_handle_zc(zfs_handle_t *, zfs_cmd_t *);
+zfs_handle_t *make_dataset_handle_nvl(libzfs_handle_t *, const char *,
+    nvlist_t *);
+zfs_handle_t *make_dataset_simple_handle(zfs_handle_t *, const char *);
 
 int zprop_parse_value(libzfs_handle_t *, nvpair_t *, int, zfs_type_t,
     nvlist_t *, char **, uint64_t *, const char *);
@@ -33,6 +33,7 @@
 #include <stddef.h>
 #include <libintl.h>
 #include <libzfs.h>
+#include <libzfs_core.h>
 #include <libzutil.h>
 
 #include "libzfs_impl.h"
@@ -99,6 +100,92 @@ top:
 	return (rc);
 }
 
+/*
+ * Iterate over the child datasets or the snapshots of a dataset a batch at
+ * a time, with ZFS_IOC_LIST_BATCH, rather than with one ioctl per dataset.
+ * If the kernel does not know the batched ioctl, *fallback is set before
+ * any dataset has been visited.
+ */
+static int
+zfs_iter_batch(zfs_handle_t *zhp, boolean_t snapshots, boolean_t simple,
+    zfs_iter_f func, void *data, boolean_t *fallback)
+{
+	libzfs_handle_t *hdl = zhp->zfs_hdl;
+	uint8_t *table = hdl->libzfs_props_table;
+	nvlist_t *opts, *result, *datasets;
+	zfs_handle_t *nzhp;
+	nvpair_t *pair;
+	uint64_t cursor = 0;
+	boolean_t more = B_TRUE;
+	int err, ret = 0;
+
+	opts = fnvlist_alloc();
+	if (snapshots)
+		fnvlist_add_boolean(opts, "snapshots");
+	if (simple) {
+		fnvlist_add_boolean(opts, "simple");
+	} else if (table != NULL) {
+		nvlist_t *props = fnvlist_alloc();
+
+		for (zfs_prop_t prop = 0; prop < ZFS_NUM_PROPS; prop++) {
+			if (table[prop])
+				fnvlist_add_boolean(props,
+				    zfs_prop_to_name(prop));
+		}
+		fnvlist_add_nvlist(opts, "props", props);
+		nvlist_free(props);
+	}
+
+	while (ret == 0 && more) {
+		fnvlist_add_uint64(opts, "cursor", cursor);
+		err = lzc_list_batch(zhp->zfs_name, opts, &result);
+		if (err != 0) {
+			/*
+			 * ENOENT means that the dataset has been removed
+			 * since we obtained the handle; that ends the list.
+			 * A kernel without the ioctl fails it with
+			 * ZFS_ERR_IOC_CMD_UNAVAIL, or an older one with EINVAL.
+			 */
+			if (cursor == 0 && (err == ZFS_ERR_IOC_CMD_UNAVAIL ||
+			    err == EINVAL)) {
+				*fallback = B_TRUE;
+			} else if (err != ENOENT && err != ESRCH) {
+				ret = zfs_standard_error(hdl, err, snapshots ?
+				    dgettext(TEXT_DOMAIN,
+				    "cannot iterate snapshots") :
+				    dgettext(TEXT_DOMAIN,
+				    "cannot iterate filesystems"));
+			}
+			break;
+		}
+
+		more = (nvlist_lookup_uint64(result, "cursor", &cursor) == 0);
+		datasets = fnvlist_lookup_nvlist(result, "datasets");
+		for (pair = nvlist_next_nvpair(datasets, NULL);
+		    ret == 0 && pair != NULL;
+		    pair = nvlist_next_nvpair(datasets, pair)) {
+			/*
+			 * Silently ignore errors, as the only plausible
+			 * explanation is that the pool has since been removed.
+			 */
+			if (simple) {
+				nzhp = make_dataset_simple_handle(zhp,
+				    nvpair_name(pair));
+			} else {
+				nzhp = make_dataset_handle_nvl(hdl,
+				    nvpair_name(pair),
+				    fnvpair_value_nvlist(pair));
+			}
+			if (nzhp != NULL)
+				ret = func(nzhp, data);
+		}
+		nvlist_free(result);
+	}
+
+	nvlist_free(opts);
+	return (ret);
+}
+
 /*
  * Iterate over all child filesystems
  */
@@ -107,11 +194,16 @@ zfs_iter_filesystems(zfs_handle_t *zhp, zfs_iter_f func, void *data)
 {
 	zfs_cmd_t zc = { 0 };
 	zfs_handle_t *nzhp;
+	boolean_t fallback = B_FALSE;
 	int ret;
 
 	if (zhp->zfs_type != ZFS_TYPE_FILESYSTEM)
 		return (0);
 
+	ret = zfs_iter_batch(zhp, B_FALSE, B_FALSE, func, data, &fallback);
+	if (!fallback)
+		return (ret);
+
 	if (zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0) != 0)
 		return (-1);
 
@@ -144,12 +236,17 @@ zfs_iter_snapshots(zfs_handle_t *zhp, boolean_t simple, zfs_iter_f func,
 {
 	zfs_cmd_t zc = { 0 };
 	zfs_handle_t *nzhp;
+	boolean_t fallback = B_FALSE;
 	int ret;
 
 	if (zhp->zfs_type == ZFS_TYPE_SNAPSHOT ||
 	    zhp->zfs_type == ZFS_TYPE_BOOKMARK)
 		return (0);
 
+	ret = zfs_iter_batch(zhp, B_TRUE, simple, func, data, &fallback);
+	if (!fallback)
+		return (ret);
+
 	zc.zc_simple = simple;
 
 	if (zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0) != 0)
@@ -158,7 +255,7 @@ zfs_iter_snapshots(zfs_handle_t *zhp, boolean_t simple, zfs_iter_f func,
 	    &zc)) == 0) {
 
 		if (simple)
-			nzhp = make_dataset_simple_handle_zc(zhp, &zc);
+			nzhp = make_dataset_simple_handle(zhp, zc.zc_name);
 		else
 			nzhp = make_dataset_handle_zc(zhp->zfs_hdl, &zc);
 		if (nzhp == NULL)
@@ -311,6 +311,8 @@ zpool_get_prop(zpool_handle_t *zhp, zpool_prop_t prop, char *buf, size_t len,
 		case ZPOOL_PROP_FREEING:
 		case ZPOOL_PROP_LEAKED:
 		case ZPOOL_PROP_ASHIFT:
+		case ZPOOL_PROP_BCLONEUSED:
+		case ZPOOL_PROP_BCLONESAVED:
 			if (literal) {
 				(void) snprintf(buf, len, "%llu",
 				    (u_longlong_t)intval);
@@ -351,6 +353,7 @@ zpool_get_prop(zpool_handle_t *zhp, zpool_prop_t prop, char *buf, size_t len,
 			}
 			break;
 		case ZPOOL_PROP_DEDUPRATIO:
+		case ZPOOL_PROP_BCLONERATIO:
 			if (literal)
 				(void) snprintf(buf, len, "%llu.%02llu",
 				    (u_longlong_t)(intval / 100),
@@ -954,6 +957,7 @@ zpool_name_valid(libzfs_handle_t *hdl, boolean_t isopen, const char *pool)
 	if (ret == 0 && !isopen &&
 	    (strncmp(pool, "mirror", 6) == 0 ||
 	    strncmp(pool, "raidz", 5) == 0 ||
+	    strncmp(pool, "draid", 5) == 0 ||
 	    strncmp(pool, "spare", 5) == 0 ||
 	    strcmp(pool, "log") == 0)) {
 		if (hdl != NULL)
@@ -2087,6 +2091,17 @@ zpool_translate_vdev_guids(zpool_handle_t *zhp, nvlist_t *vds,
  */
 int
 zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
+{
+	return (zpool_scan_txg(zhp, func, cmd, 0));
+}
+
+/*
+ * Scan the pool.  If txg is not zero, a scrub only verifies the blocks born
+ * in that txg or later.
+ */
+int
+zpool_scan_txg(zpool_handle_t *zhp, pool_scan_func_t func,
+    pool_scrub_cmd_t cmd, uint64_t txg)
 {
 	zfs_cmd_t zc = { 0 };
 	char msg[1024];
@@ -2096,6 +2111,7 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 	(void) strlcpy(zc.zc_name, zhp->zpool_name, sizeof (zc.zc_name));
 	zc.zc_cookie = func;
 	zc.zc_flags = cmd;
+	zc.zc_createtxg = txg;
 
 	if (zfs_ioctl(hdl, ZFS_IOC_POOL_SCAN, &zc) == 0)
 		return (0);
@@ -2141,7 +2157,12 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_SCAN_STATS, (uint64_t **)&ps, &psc);
 		if (ps && ps->pss_func == POOL_SCAN_SCRUB) {
-			if (cmd == POOL_SCRUB_PAUSE)
+			/*
+			 * A paused scrub can only be resumed as it was
+			 * started, not given a new range of txgs.
+			 */
+			if (cmd == POOL_SCRUB_PAUSE ||
+			    (txg != 0 && ps->pss_pass_scrub_pause != 0))
 				return (zfs_error(hdl, EZFS_SCRUB_PAUSED, msg));
 			else
 				return (zfs_error(hdl, EZFS_SCRUBBING, msg));
@@ -2589,12 +2610,32 @@ zpool_find_vdev_by_physpath(zpool_handle_t *zhp, const char *ppath,
 	return (ret);
 }
 
+/*
+ * Returns true if 'name' is that of a distributed spare, which is formed
+ * from the parity, top-level vdev id and spare id of a dRAID vdev.
+ */
+boolean_t
+zpool_is_draid_spare(const char *name)
+{
+	u_longlong_t parity, topid, spareid;
+	int n = -1;
+
+	if (sscanf(name, VDEV_DRAID_SPARE_PATH_FMT "%n", &parity, &topid,
+	    &spareid, &n) != 3 || n < 0)
+		return (B_FALSE);
+
+	return (name[n] == '\0');
+}
+
 /*
  * Determine if we have an "interior" top-level vdev (i.e mirror/raidz).
  */
 static boolean_t
 zpool_vdev_is_interior(const char *name)
 {
+	if (strncmp(name, VDEV_TYPE_DRAID, strlen(VDEV_TYPE_DRAID)) == 0)
+		return (!zpool_is_draid_spare(name));
+
 	if (strncmp(name, VDEV_TYPE_RAIDZ, strlen(VDEV_TYPE_RAIDZ)) == 0 ||
 	    strncmp(name, VDEV_TYPE_SPARE, strlen(VDEV_TYPE_SPARE)) == 0 ||
 	    strncmp(name,
@@ -2620,6 +2661,8 @@ zpool_find_vdev(zpool_handle_t *zhp, const char *path, boolean_t *avail_spare,
 		verify(nvlist_add_uint64(search, ZPOOL_CONFIG_GUID, guid) == 0);
 	} else if (zpool_vdev_is_interior(path)) {
 		verify(nvlist_add_string(search, ZPOOL_CONFIG_TYPE, path) == 0);
+	} else if (zpool_is_draid_spare(path)) {
+		verify(nvlist_add_string(search, ZPOOL_CONFIG_PATH, path) == 0);
 	} else if (path[0] != '/') {
 		(void) snprintf(buf, sizeof (buf), "%s/%s", ZFS_DISK_ROOT,
 		    path);
@@ -2717,6 +2760,7 @@ vdev_get_physpaths(nvlist_t *nv, char *physpath, size_t phypath_size,
 		}
 	} else if (strcmp(type, VDEV_TYPE_MIRROR) == 0 ||
 	    strcmp(type, VDEV_TYPE_RAIDZ) == 0 ||
+	    strcmp(type, VDEV_TYPE_DRAID) == 0 ||
 	    strcmp(type, VDEV_TYPE_REPLACING) == 0 ||
 	    (is_spare = (strcmp(type, VDEV_TYPE_SPARE) == 0))) {
 		nvlist_t **child;
@@ -3058,6 +3102,7 @@ zpool_vdev_attach(zpool_handle_t *zhp,
 	nvlist_t **child;
 	uint_t children;
 	nvlist_t *config_root;
+	char *type;
 	libzfs_handle_t *hdl = zhp->zpool_hdl;
 	boolean_t rootpool = zpool_is_bootable(zhp);
 
@@ -3081,6 +3126,7 @@ zpool_vdev_attach(zpool_handle_t *zhp,
 
 	verify(nvlist_lookup_uint64(tgt, ZPOOL_CONFIG_GUID, &zc.zc_guid) == 0);
 	zc.zc_cookie = replacing;
+	verify(nvlist_lookup_string(tgt, ZPOOL_CONFIG_TYPE, &type) == 0);
 
 	if (nvlist_lookup_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN,
 	    &child, &children) != 0 || children != 1) {
@@ -3156,10 +3202,14 @@ zpool_vdev_attach(zpool_handle_t *zhp,
 			else
 				zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
 				    "cannot replace a replacing device"));
+		} else if (strcmp(type, VDEV_TYPE_RAIDZ) == 0) {
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "raidz expansion requires the raidz_expansion "
+			    "feature, and can't use a hot spare"));
 		} else {
 			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
-			    "can only attach to mirrors and top-level "
-			    "disks"));
+			    "can only attach to mirrors, raidz vdevs and "
+			    "top-level disks"));
 		}
 		(void) zfs_error(hdl, EZFS_BADTARGET, msg);
 		break;
@@ -3174,9 +3224,15 @@ zpool_vdev_attach(zpool_handle_t *zhp,
 		break;
 
 	case EBUSY:
-		zfs_error_aux(hdl, dgettext(TEXT_DOMAIN, "%s is busy, "
-		    "or device removal is in progress"),
-		    new_disk);
+		if (strcmp(type, VDEV_TYPE_RAIDZ) == 0) {
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "cannot expand a raidz vdev while the pool is "
+			    "resilvering"));
+		} else {
+			zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+			    "%s is busy, or device removal is in progress"),
+			    new_disk);
+		}
 		(void) zfs_error(hdl, EZFS_BADDEV, msg);
 		break;
 
@@ -4081,9 +4137,11 @@ after_open:
 		path = type;
 
 		/*
-		 * If it's a raidz device, we need to stick in the parity level.
+		 * If it's a raidz or dRAID device, we need to stick in the
+		 * parity level.
 		 */
-		if (strcmp(path, VDEV_TYPE_RAIDZ) == 0) {
+		if (strcmp(path, VDEV_TYPE_RAIDZ) == 0 ||
+		    strcmp(path, VDEV_TYPE_DRAID) == 0) {
 			verify(nvlist_lookup_uint64(nv, ZPOOL_CONFIG_NPARITY,
 			    &value) == 0);
 			(void) snprintf(buf, sizeof (buf), "%s%llu", path,
@@ -4372,6 +4430,45 @@ zpool_get_history(zpool_handle_t *zhp, nvlist_t **nvhisp, uint64_t *off,
 	return (err);
 }
 
+/*
+ * Finds, in the pool history, a txg no later than any txg that was still
+ * open at the given time: that of the last internal event logged at or
+ * before it.  Blocks written after that time were born in that txg or
+ * later.  Returns 0 in *txgp if the history does not go back that far.
+ */
+int
+zpool_history_txg(zpool_handle_t *zhp, time_t when, uint64_t *txgp)
+{
+	nvlist_t *nvhis, **records;
+	uint_t numrecords, i;
+	uint64_t off = 0, time, txg;
+	boolean_t eof = B_FALSE, done = B_FALSE;
+	int err;
+
+	*txgp = 0;
+	while (!eof && !done) {
+		if ((err = zpool_get_history(zhp, &nvhis, &off, &eof)) != 0)
+			return (err);
+
+		verify(nvlist_lookup_nvlist_array(nvhis, ZPOOL_HIST_RECORD,
+		    &records, &numrecords) == 0);
+		for (i = 0; i < numrecords && !done; i++) {
+			if (nvlist_lookup_uint64(records[i], ZPOOL_HIST_TIME,
+			    &time) != 0 ||
+			    nvlist_lookup_uint64(records[i], ZPOOL_HIST_TXG,
+			    &txg) != 0)
+				continue;
+			if (time > when)
+				done = B_TRUE;
+			else
+				*txgp = txg;
+		}
+		nvlist_free(nvhis);
+	}
+
+	return (0);
+}
+
 void
 zpool_obj_to_path(zpool_handle_t *zhp, uint64_t dsobj, uint64_t obj,
     char *pathname, size_t len)
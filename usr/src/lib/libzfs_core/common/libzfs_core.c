@@ -1028,6 +1028,38 @@ lzc_get_bookmarks(const char *fsname, nvlist_t *props, nvlist_t **bmarks)
 	return (lzc_ioctl(ZFS_IOC_GET_BOOKMARKS, fsname, props, bmarks));
 }
 
+/*
+ * List a batch of the child datasets, or of the snapshots, of the given
+ * dataset.
+ *
+ * The optional opts nvlist may contain:
+ *
+ * "snapshots" - (boolean) list the snapshots rather than the children
+ * "simple" - (boolean) only return the names of the datasets
+ * "cursor" - (uint64) the cursor returned by the previous batch
+ * "count" - (uint64) the maximum number of datasets to return
+ * "props" - (nvlist) names of the native properties to return (with no
+ *     values); user properties are always returned
+ *
+ * The format of the returned nvlist as follows:
+ * "datasets" -> {
+ *     <name of dataset> -> {
+ *         "stats" -> uint8 array, the dmu_objset_stats_t of the dataset
+ *         "props" -> { <name of property> -> { "value", "source" } }
+ *     }
+ * }
+ * "cursor" -> uint64, the cursor to pass for the next batch; absent once
+ *     the list is complete
+ *
+ * The datasets come in the order in which the ZFS_IOC_DATASET_LIST_NEXT
+ * and ZFS_IOC_SNAPSHOT_LIST_NEXT ioctls return them.
+ */
+int
+lzc_list_batch(const char *fsname, nvlist_t *opts, nvlist_t **result)
+{
+	return (lzc_ioctl(ZFS_IOC_LIST_BATCH, fsname, opts, result));
+}
+
 /*
  * Destroys bookmarks.
  *
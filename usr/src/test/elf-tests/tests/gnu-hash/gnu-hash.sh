@@ -0,0 +1,109 @@
+#!/usr/bin/ksh
+#
+# This file and its contents are supplied under the terms of the
+# Common Development and Distribution License ("CDDL"), version 1.0.
+# You may only use this file in accordance with the terms of version
+# 1.0 of the CDDL.
+#
+# A full copy of the text of the CDDL should have accompanied this
+# source.  A copy of the CDDL is also available via the Internet at
+# http://www.illumos.org/license/CDDL.
+#
+
+# Test that ld(1) creates a .gnu.hash section unless -z nognuhash is given,
+# and that ld.so.1 finds every symbol, and only those symbols, through it.
+
+tmpdir=/tmp/test.$$
+mkdir $tmpdir
+cd $tmpdir
+
+cleanup() {
+    cd /
+    rm -fr $tmpdir
+}
+
+trap 'cleanup' EXIT
+
+fail() {
+    print -u2 "$*"
+    exit 1
+}
+
+nsyms=2000
+
+{
+    i=0
+    while (( i < nsyms )); do
+        print "int gh_func$i(void) { return ($i); }"
+        (( i++ ))
+    done
+    print "int gh_data = 42;"
+    print "#pragma weak gh_weak = gh_func1"
+} > lib.c
+
+cat > main.c <<EOF
+#include <stdio.h>
+#include <dlfcn.h>
+
+extern int gh_data;
+extern int gh_func7(void);
+
+int
+main(void)
+{
+	void *hdl;
+	char name[32];
+	int i, (*fn)(void);
+
+	if (gh_func7() != 7 || gh_data != 42)
+		return (1);
+
+	if ((hdl = dlopen("libgh.so", RTLD_LAZY)) == NULL)
+		return (2);
+
+	for (i = 0; i < $nsyms; i++) {
+		(void) snprintf(name, sizeof (name), "gh_func%d", i);
+		if ((fn = (int (*)(void))dlsym(hdl, name)) == NULL ||
+		    fn() != i) {
+			(void) printf("lookup of %s failed\n", name);
+			return (3);
+		}
+		(void) snprintf(name, sizeof (name), "gh_nofunc%d", i);
+		if (dlsym(hdl, name) != NULL) {
+			(void) printf("lookup of %s succeeded\n", name);
+			return (4);
+		}
+	}
+
+	if ((fn = (int (*)(void))dlsym(hdl, "gh_weak")) == NULL || fn() != 1)
+		return (5);
+
+	return (0);
+}
+EOF
+
+# We expect any alternate linker to be in LD_ALTEXEC for us already
+mkdir gnu sysv
+gcc -shared -fPIC -o gnu/libgh.so lib.c || fail "compilation failed"
+gcc -shared -fPIC -o sysv/libgh.so lib.c -Wl,-znognuhash ||
+    fail "compilation with -znognuhash failed"
+gcc -o main main.c -Lgnu -lgh || fail "compilation of main.c failed"
+
+elfdump -d gnu/libgh.so | grep -qw GNU_HASH || fail "DT_GNU_HASH missing"
+elfdump -c gnu/libgh.so | grep -q 'sh_name: \.gnu\.hash$' ||
+    fail ".gnu.hash section missing"
+elfdump -c gnu/libgh.so | grep -q 'sh_name: \.hash$' ||
+    fail ".hash section missing"
+elfdump -d sysv/libgh.so | grep -qw GNU_HASH &&
+    fail "DT_GNU_HASH created with -znognuhash"
+elfdump -c main | grep -q 'sh_name: \.gnu\.hash$' ||
+    fail ".gnu.hash section missing from executable"
+
+for dir in gnu sysv; do
+    LD_LIBRARY_PATH=$tmpdir/$dir ./main ||
+        fail "symbol lookups against the $dir library failed"
+    LD_BIND_NOW=1 LD_LIBRARY_PATH=$tmpdir/$dir ./main ||
+        fail "immediate symbol lookups against the $dir library failed"
+done
+
+exit 0
@@ -0,0 +1,177 @@
+#!/usr/bin/ksh
+#
+# This file and its contents are supplied under the terms of the
+# Common Development and Distribution License ("CDDL"), version 1.0.
+# You may only use this file in accordance with the terms of version
+# 1.0 of the CDDL.
+#
+# A full copy of the text of the CDDL should have accompanied this
+# source.  A copy of the CDDL is also available via the Internet at
+# http://www.illumos.org/license/CDDL.
+#
+
+# Measure the time-to-main of a synthetic application with a large number of
+# shared object dependencies, when its objects are built with and without a
+# .gnu.hash section.
+#
+# The application depends on nlibs libraries, each of which defines nsyms
+# functions and references a function of the next library.  main() references
+# a function from each library, so that with immediate binding ld.so.1 must
+# search, and mostly fail to find the symbol in, half of the dependency list
+# for every reference.  A launcher records gethrtime() before each spawn of
+# the application, and main() reports the time elapsed when it is reached.
+#
+# This is a benchmark rather than a test, and isn't part of the default run.
+
+sb_nlibs=500
+sb_nsyms=200
+sb_iters=20
+sb_arg0=$(basename $0)
+
+tmpdir=/tmp/startup-bench.$$
+
+cleanup() {
+    cd /
+    rm -fr $tmpdir
+}
+
+fatal() {
+    print -u2 "$sb_arg0: $*"
+    exit 1
+}
+
+usage() {
+    print -u2 "Usage: $sb_arg0 [-n libraries] [-s symbols] [-i iterations]"
+    exit 2
+}
+
+while getopts "n:s:i:" c; do
+    case $c in
+    n)  sb_nlibs=$OPTARG ;;
+    s)  sb_nsyms=$OPTARG ;;
+    i)  sb_iters=$OPTARG ;;
+    *)  usage ;;
+    esac
+done
+
+mkdir $tmpdir || fatal "failed to create $tmpdir"
+trap 'cleanup' EXIT
+cd $tmpdir
+
+cat > launch.c <<EOF
+#include <stdio.h>
+#include <stdlib.h>
+#include <spawn.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+int
+main(int argc, char **argv)
+{
+	char start[32];
+	char *args[3];
+	int i, status;
+	pid_t pid;
+
+	args[0] = argv[2];
+	args[1] = start;
+	args[2] = NULL;
+
+	for (i = 0; i < atoi(argv[1]); i++) {
+		(void) snprintf(start, sizeof (start), "%lld",
+		    (long long)gethrtime());
+		if (posix_spawn(&pid, argv[2], NULL, NULL, args,
+		    environ) != 0 || waitpid(pid, &status, 0) != pid ||
+		    status != 0)
+			return (1);
+	}
+	return (0);
+}
+EOF
+
+print "Generating $sb_nlibs libraries of $sb_nsyms functions..."
+
+{
+    print "#include <stdio.h>"
+    print "#include <stdlib.h>"
+    print "#include <sys/time.h>"
+    i=0
+    while (( i < sb_nlibs )); do
+        print "extern int sb${i}_f0(void);"
+        (( i++ ))
+    done
+    print "int"
+    print "main(int argc, char **argv)"
+    print "{"
+    print "\thrtime_t now = gethrtime();"
+    print "\tint sum = 0;"
+    print "\tif (argc == 2) {"
+    print "\t\t(void) printf(\"%lld\\\\n\","
+    print "\t\t    (long long)(now - atoll(argv[1])));"
+    print "\t\treturn (0);"
+    print "\t}"
+    i=0
+    while (( i < sb_nlibs )); do
+        print "\tsum += sb${i}_f0();"
+        (( i++ ))
+    done
+    print "\treturn (sum != 0);"
+    print "}"
+} > main.c
+
+mkdir src gnu sysv
+i=0
+while (( i < sb_nlibs )); do
+    {
+        (( next = (i + 1) % sb_nlibs ))
+        print "extern int sb${next}_f1(void);"
+        j=0
+        while (( j < sb_nsyms )); do
+            print "int sb${i}_f$j(void) { return ($j); }"
+            (( j++ ))
+        done
+        print "int sb${i}_call(void) { return (sb${next}_f1()); }"
+    } > src/lib$i.c
+    (( i++ ))
+done
+
+# We expect any alternate linker to be in LD_ALTEXEC for us already
+gcc -o launch launch.c || fatal "compilation of launch.c failed"
+
+liblist=
+i=0
+while (( i < sb_nlibs )); do
+    liblist="$liblist -lsb$i"
+    (( i++ ))
+done
+
+for variant in gnu sysv; do
+    print "Linking the $variant application..."
+    [[ $variant == sysv ]] && ldflags="-Wl,-znognuhash" || ldflags=
+    i=0
+    while (( i < sb_nlibs )); do
+        gcc -shared -fPIC -o $variant/libsb$i.so src/lib$i.c \
+            -Wl,-h,libsb$i.so $ldflags || fatal "compilation of lib$i failed"
+        (( i++ ))
+    done
+    gcc -o $variant/main main.c -L$variant $liblist \
+        -R$tmpdir/$variant $ldflags || fatal "compilation of main.c failed"
+    $variant/main || fatal "$variant application failed"
+done
+
+print
+printf "%-8s %10s %10s %10s\n" "hash" "min (ms)" "med (ms)" "mean (ms)"
+for variant in gnu sysv; do
+    LD_BIND_NOW=1 ./launch $sb_iters $variant/main > $variant.out ||
+        fatal "$variant application failed"
+    sort -n $variant.out | awk -v name=$variant '
+        { t[NR] = $1; sum += $1 }
+        END {
+            printf("%-8s %10.3f %10.3f %10.3f\n", name, t[1] / 1000000,
+                t[int((NR + 1) / 2)] / 1000000, sum / NR / 1000000)
+        }'
+done
+
+exit 0
@@ -0,0 +1,131 @@
+#!/usr/bin/ksh
+#
+# This file and its contents are supplied under the terms of the
+# Common Development and Distribution License ("CDDL"), version 1.0.
+# You may only use this file in accordance with the terms of version
+# 1.0 of the CDDL.
+#
+# A full copy of the text of the CDDL should have accompanied this
+# source.  A copy of the CDDL is also available via the Internet at
+# http://www.illumos.org/license/CDDL.
+#
+
+# Measure the time ld(1) takes to link a corpus of large relocatable objects,
+# which is dominated by the entry and lookup of global symbols in ld's internal
+# symbol table.
+#
+# The corpus consists of nobjs objects, each of which defines nsyms data
+# symbols and a pointer to a data symbol of the next object, so every object
+# both defines symbols and references symbols that are entered, as undefined,
+# before their definition is processed.  The objects are linked into a shared
+# object and into a relocatable object, niters times each, and the elapsed
+# times reported.
+#
+# Each of the linkers given as arguments is measured in turn, using
+# LD_ALTEXEC.  With no arguments, the default linker is measured.  -t gives
+# the number of threads ld is allowed to use (-z threads).
+#
+# This is a benchmark rather than a test, and isn't part of the default run.
+
+lb_nobjs=100
+lb_nsyms=20000
+lb_iters=5
+lb_threads=
+lb_arg0=$(basename $0)
+
+tmpdir=/tmp/link-bench.$$
+
+cleanup() {
+    cd /
+    rm -fr $tmpdir
+}
+
+fatal() {
+    print -u2 "$lb_arg0: $*"
+    exit 1
+}
+
+usage() {
+    print -u2 "Usage: $lb_arg0 [-n objects] [-s symbols] [-i iterations]" \
+        "[-t threads] [linker ...]"
+    exit 2
+}
+
+while getopts "n:s:i:t:" c; do
+    case $c in
+    n)  lb_nobjs=$OPTARG ;;
+    s)  lb_nsyms=$OPTARG ;;
+    i)  lb_iters=$OPTARG ;;
+    t)  lb_threads=-zthreads=$OPTARG ;;
+    *)  usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+for linker in "$@"; do
+    [[ -x $linker ]] || fatal "$linker is not executable"
+done
+
+mkdir $tmpdir || fatal "failed to create $tmpdir"
+trap 'cleanup' EXIT
+cd $tmpdir
+
+print "Generating $lb_nobjs objects of $lb_nsyms symbols..."
+
+i=0
+while (( i < lb_nobjs )); do
+    awk -v obj=$i -v nxt=$(( (i + 1) % lb_nobjs )) -v nsyms=$lb_nsyms '
+        BEGIN {
+            for (j = 0; j < nsyms; j++) {
+                printf("extern int lb%d_data%d;\n", nxt, j)
+                printf("int lb%d_data%d = %d;\n", obj, j, j)
+                printf("int *lb%d_ptr%d = &lb%d_data%d;\n", obj, j, nxt, j)
+            }
+        }' > lb$i.c
+    gcc -c -fPIC -o lb$i.o lb$i.c || fatal "compilation of lb$i.c failed"
+    rm lb$i.c
+    (( i++ ))
+done
+
+# Run a link niters times, writing the elapsed time of each run in ms.
+bench() {
+    typeset -F6 start
+    typeset -i n=0
+
+    while (( n < lb_iters )); do
+        start=$SECONDS
+        "$@" || return 1
+        print $(( (SECONDS - start) * 1000 ))
+        (( n++ ))
+    done
+}
+
+report() {
+    sort -n | awk -v name="$1" '
+        { t[NR] = $1; sum += $1 }
+        END {
+            printf("%-32s %10.1f %10.1f %10.1f\n", name, t[1],
+                t[int((NR + 1) / 2)], sum / NR)
+        }'
+}
+
+(( $# == 0 )) && set -- default
+
+print
+printf "%-32s %10s %10s %10s\n" "link" "min (ms)" "med (ms)" "mean (ms)"
+for linker in "$@"; do
+    if [[ $linker == default ]]; then
+        unset LD_ALTEXEC
+    else
+        export LD_ALTEXEC=$linker
+    fi
+
+    bench ld -G -o out.so lb*.o $lb_threads > so.out ||
+        fatal "shared object link with $linker failed"
+    report "$linker -G" < so.out
+    bench ld -r -o out.ro lb*.o $lb_threads > rel.out ||
+        fatal "relocatable link with $linker failed"
+    report "$linker -r" < rel.out
+done
+
+exit 0
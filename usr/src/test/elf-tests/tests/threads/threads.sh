@@ -0,0 +1,94 @@
+#!/usr/bin/ksh
+#
+# This file and its contents are supplied under the terms of the
+# Common Development and Distribution License ("CDDL"), version 1.0.
+# You may only use this file in accordance with the terms of version
+# 1.0 of the CDDL.
+#
+# A full copy of the text of the CDDL should have accompanied this
+# source.  A copy of the CDDL is also available via the Internet at
+# http://www.illumos.org/license/CDDL.
+#
+
+# Test that the output of ld(1) doesn't depend on the number of threads given
+# with -z threads, and that invalid thread counts are rejected.
+#
+# The objects are large enough for each of the parallel passes to be used:
+# many global symbols, relocations against several input sections, merged
+# string sections and a DT_CHECKSUM.
+
+tmpdir=/tmp/test.$$
+mkdir $tmpdir
+cd $tmpdir
+
+cleanup() {
+    cd /
+    rm -fr $tmpdir
+}
+
+trap 'cleanup' EXIT
+
+fail() {
+    print -u2 "$*"
+    exit 1
+}
+
+nfiles=8
+nsyms=1000
+
+i=0
+while (( i < nfiles )); do
+    {
+        print "#include <stdio.h>"
+        j=0
+        while (( j < nsyms )); do
+            print "int th${i}_data$j = $j;"
+            print "const char *th${i}_str$j = \"string $j\";"
+            print "int th${i}_func$j(void) { return (th${i}_data$j +"
+            print "    (int)puts(th${i}_str$j)); }"
+            (( j++ ))
+        done
+    } > th$i.c
+    gcc -c -fPIC -o th$i.o th$i.c || fail "compilation of th$i.c failed"
+    (( i++ ))
+done
+
+cat > main.c <<EOF
+extern int th0_func7(void);
+
+int
+main(void)
+{
+	return (th0_func7() >= 7 ? 0 : 1);
+}
+EOF
+
+# We expect any alternate linker to be in LD_ALTEXEC for us already
+for n in 1 2 4 16; do
+    gcc -shared -o libth.$n.so th*.o -Wl,-zthreads=$n ||
+        fail "link of libth.so with -z threads=$n failed"
+    gcc -c -o main.o main.c || fail "compilation of main.c failed"
+    gcc -o main.$n main.o th*.o -Wl,-zthreads=$n ||
+        fail "link of main with -z threads=$n failed"
+    ld -r -o reloc.$n.o th*.o -zthreads=$n ||
+        fail "relocatable link with -z threads=$n failed"
+done
+
+elfdump -d libth.1.so | grep -qw CHECKSUM || fail "DT_CHECKSUM missing"
+
+for n in 2 4 16; do
+    cmp -s libth.1.so libth.$n.so ||
+        fail "shared object differs with -z threads=$n"
+    cmp -s main.1 main.$n || fail "executable differs with -z threads=$n"
+    cmp -s reloc.1.o reloc.$n.o ||
+        fail "relocatable object differs with -z threads=$n"
+done
+
+./main.4 > /dev/null || fail "executable linked with -z threads=4 failed"
+
+for n in 0 -1 65 4x ""; do
+    ld -r -o bad.o th0.o -zthreads=$n 2>/dev/null &&
+        fail "-z threads=$n was accepted"
+done
+
+exit 0
@@ -0,0 +1,351 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Benchmark of qsort(3C) and pqsort(3C) over a range of array sizes, input
+ * distributions and record sizes:
+ *
+ *	qsort_bench [-p] [-d dist] [-r rsiz] [-m min] [-M max] [-i iters]
+ *
+ * The number of records starts at min (default 1000) and is multiplied
+ * by 10 up to max (default 10000000).  Records are 4 byte integers, 8 byte
+ * integers, or larger records with an 8 byte key at their start.  -p also
+ * times pqsort().  Each line of output gives the routine, distribution,
+ * record size and count, the best time of the iterations in ms, the
+ * throughput in millions of records per second, and for qsort() the
+ * number of comparisons per n*log2(n).  It exits with an error if any
+ * array comes out unsorted.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+typedef struct qb_dist {
+	const char	*qd_name;
+	uint64_t	(*qd_key)(size_t, size_t);
+} qb_dist_t;
+
+static uint64_t qb_compares;
+
+static uint64_t
+qb_key_random(size_t i, size_t n)
+{
+	return (((uint64_t)arc4random() << 32) | arc4random());
+}
+
+static uint64_t
+qb_key_sorted(size_t i, size_t n)
+{
+	return (i);
+}
+
+static uint64_t
+qb_key_reversed(size_t i, size_t n)
+{
+	return (n - i);
+}
+
+/* sorted, apart from one record in a hundred */
+static uint64_t
+qb_key_nearly(size_t i, size_t n)
+{
+	return (arc4random_uniform(100) == 0 ? arc4random_uniform(n) : i);
+}
+
+static uint64_t
+qb_key_organ(size_t i, size_t n)
+{
+	return (i < n / 2 ? i : n - i);
+}
+
+static uint64_t
+qb_key_sawtooth(size_t i, size_t n)
+{
+	return (i % 1000);
+}
+
+static uint64_t
+qb_key_few(size_t i, size_t n)
+{
+	return (arc4random_uniform(16));
+}
+
+static uint64_t
+qb_key_equal(size_t i, size_t n)
+{
+	return (42);
+}
+
+static const qb_dist_t qb_dists[] = {
+	{ "random",	qb_key_random },
+	{ "sorted",	qb_key_sorted },
+	{ "reversed",	qb_key_reversed },
+	{ "nearly",	qb_key_nearly },
+	{ "organ",	qb_key_organ },
+	{ "sawtooth",	qb_key_sawtooth },
+	{ "few",	qb_key_few },
+	{ "equal",	qb_key_equal },
+	{ NULL }
+};
+
+static int
+qb_cmp_32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	qb_compares++;
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+static int
+qb_cmp_64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	qb_compares++;
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+/*
+ * pqsort() calls these from several threads at once, so they do not
+ * count comparisons.
+ */
+static int
+qb_pcmp_32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+static int
+qb_pcmp_64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+static void
+qb_fill(uint8_t *buf, const qb_dist_t *qd, size_t n, size_t rsiz)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		uint64_t key = qd->qd_key(i, n);
+		uint8_t *rec = buf + i * rsiz;
+
+		if (rsiz == sizeof (uint32_t)) {
+			*(uint32_t *)rec = (uint32_t)key;
+		} else {
+			*(uint64_t *)rec = key;
+			(void) memset(rec + sizeof (uint64_t), (int)i,
+			    rsiz - sizeof (uint64_t));
+		}
+	}
+}
+
+/*
+ * The benchmark doubles as a check that the sort works, which matters for
+ * pqsort() as the test suite only runs qsort().
+ */
+static void
+qb_check(const uint8_t *buf, size_t n, size_t rsiz, const char *func,
+    const qb_dist_t *qd)
+{
+	size_t i;
+
+	for (i = 1; i < n; i++) {
+		const uint8_t *a = buf + (i - 1) * rsiz;
+		const uint8_t *b = buf + i * rsiz;
+		boolean_t bad;
+
+		if (rsiz == sizeof (uint32_t))
+			bad = *(const uint32_t *)a > *(const uint32_t *)b;
+		else
+			bad = *(const uint64_t *)a > *(const uint64_t *)b;
+
+		if (bad) {
+			errx(EXIT_FAILURE, "%s of %zu %s records of %zu bytes: "
+			    "record %zu is out of order", func, n,
+			    qd->qd_name, rsiz, i);
+		}
+	}
+}
+
+static void
+qb_usage(const char *fmt, ...)
+{
+	if (fmt != NULL) {
+		va_list ap;
+
+		va_start(ap, fmt);
+		vwarnx(fmt, ap);
+		va_end(ap);
+	}
+
+	(void) fprintf(stderr, "Usage: qsort_bench [-p] [-d dist] [-r rsiz] "
+	    "[-m min] [-M max] [-i iters]\n");
+	exit(2);
+}
+
+static size_t
+qb_parse(const char *arg, char opt)
+{
+	char *eptr;
+	unsigned long long v;
+
+	errno = 0;
+	v = strtoull(arg, &eptr, 0);
+	if (errno != 0 || *eptr != '\0' || v == 0)
+		qb_usage("invalid value for -%c: %s", opt, arg);
+
+	return ((size_t)v);
+}
+
+static void
+qb_run(boolean_t par, const qb_dist_t *qd, size_t n, size_t rsiz,
+    uint_t iters, uint8_t *buf)
+{
+	int (*cmp)(const void *, const void *);
+	hrtime_t best = INT64_MAX;
+	uint64_t compares = 0;
+	double nlogn;
+	uint_t i;
+
+	if (rsiz == sizeof (uint32_t))
+		cmp = par ? qb_pcmp_32 : qb_cmp_32;
+	else
+		cmp = par ? qb_pcmp_64 : qb_cmp_64;
+
+	for (i = 0; i < iters; i++) {
+		hrtime_t start, t;
+
+		qb_fill(buf, qd, n, rsiz);
+		qb_compares = 0;
+		start = gethrtime();
+		if (par)
+			pqsort(buf, n, rsiz, cmp);
+		else
+			qsort(buf, n, rsiz, cmp);
+		t = gethrtime() - start;
+
+		if (t < best) {
+			best = t;
+			compares = qb_compares;
+		}
+
+		qb_check(buf, n, rsiz, par ? "pqsort" : "qsort", qd);
+	}
+
+	nlogn = n * log2((double)n);
+	(void) printf("%-6s %-8s %4zu %10zu %10.2f %8.2f", par ? "pqsort" :
+	    "qsort", qd->qd_name, rsiz, n, (double)best / MICROSEC,
+	    (double)n * MILLISEC / best);
+	if (par)
+		(void) printf(" %8s\n", "-");
+	else
+		(void) printf(" %8.3f\n", compares / nlogn);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const size_t rsizes[] = { 4, 8, 24 };
+	const char *dist = NULL;
+	size_t rsiz = 0, min = 1000, max = 10000000, n, r;
+	uint_t iters = 3;
+	boolean_t par = B_FALSE;
+	const qb_dist_t *qd;
+	uint8_t *buf;
+	int c;
+
+	while ((c = getopt(argc, argv, ":d:i:m:M:pr:")) != -1) {
+		switch (c) {
+		case 'd':
+			dist = optarg;
+			break;
+		case 'i':
+			iters = (uint_t)qb_parse(optarg, c);
+			break;
+		case 'm':
+			min = qb_parse(optarg, c);
+			break;
+		case 'M':
+			max = qb_parse(optarg, c);
+			break;
+		case 'p':
+			par = B_TRUE;
+			break;
+		case 'r':
+			rsiz = qb_parse(optarg, c);
+			if (rsiz != sizeof (uint32_t) &&
+			    (rsiz % sizeof (uint64_t)) != 0) {
+				qb_usage("record size must be 4 or a multiple "
+				    "of 8: %s", optarg);
+			}
+			break;
+		case ':':
+			qb_usage("option -%c requires an argument", optopt);
+			break;
+		case '?':
+			qb_usage("unknown option: -%c", optopt);
+			break;
+		}
+	}
+
+	for (qd = qb_dists; dist != NULL && qd->qd_name != NULL; qd++) {
+		if (strcmp(dist, qd->qd_name) == 0)
+			break;
+	}
+	if (dist != NULL && qd->qd_name == NULL)
+		qb_usage("unknown distribution: %s", dist);
+
+	if ((buf = calloc(max, rsiz == 0 ? 24 : rsiz)) == NULL)
+		err(EXIT_FAILURE, "failed to allocate buffer");
+
+	(void) printf("%-6s %-8s %4s %10s %10s %8s %8s\n", "FUNC", "DIST",
+	    "RSIZ", "NREC", "MSEC", "MREC/S", "CMP/NLGN");
+	for (qd = qb_dists; qd->qd_name != NULL; qd++) {
+		if (dist != NULL && strcmp(dist, qd->qd_name) != 0)
+			continue;
+
+		for (r = 0; r < sizeof (rsizes) / sizeof (rsizes[0]); r++) {
+			size_t rs = rsiz != 0 ? rsiz : rsizes[r];
+
+			for (n = min; n <= max; n *= 10) {
+				qb_run(B_FALSE, qd, n, rs, iters, buf);
+				if (par)
+					qb_run(B_TRUE, qd, n, rs, iters, buf);
+			}
+
+			if (rsiz != 0)
+				break;
+		}
+	}
+
+	free(buf);
+	return (EXIT_SUCCESS);
+}
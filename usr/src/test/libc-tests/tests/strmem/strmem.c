@@ -0,0 +1,514 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Correctness tests for memcpy(), memmove(), memset(), memcmp(), strlen(),
+ * strchr() and memchr(), which have several implementations selected by
+ * the hardware capabilities of the system.  Every size up to a few vector
+ * widths is tried at every alignment of the buffers, plus a few larger
+ * sizes which exercise the bulk loops and the rep movsb/stosb paths.
+ *
+ * Buffers are followed by a PROT_NONE page, and data is placed against it,
+ * to catch reads past the end of the buffer.  strmem_hwcap.ksh runs this
+ * program once for each implementation the system supports.
+ */
+
+#include <err.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#define	SM_ALIGN	64	/* alignments tried for each buffer */
+#define	SM_SMALL	300	/* all sizes below this are tried */
+#define	SM_BUFLEN	(64 * 1024)
+#define	SM_CANARY	0x5a
+
+static const size_t sm_large[] = {
+	511, 512, 513, 1000, 2047, 2048, 2049, 4095, 4096, 4097, 8191,
+	8192, 8193, 16000, 32768 + 33, SM_BUFLEN - 2 * SM_ALIGN
+};
+
+#define	SM_NLARGE	(sizeof (sm_large) / sizeof (sm_large[0]))
+
+static uint8_t *sm_src;
+static uint8_t *sm_dst;
+static size_t sm_pgsz;
+static uint_t sm_fails;
+
+static void
+sm_fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void) fprintf(stderr, "TEST FAILED: ");
+	(void) vfprintf(stderr, fmt, ap);
+	(void) fprintf(stderr, "\n");
+	va_end(ap);
+
+	if (++sm_fails > 20)
+		errx(EXIT_FAILURE, "too many failures, giving up");
+}
+
+/*
+ * Allocates a buffer of SM_BUFLEN bytes followed by a PROT_NONE page.
+ */
+static uint8_t *
+sm_alloc(void)
+{
+	uint8_t *addr;
+
+	addr = mmap(NULL, SM_BUFLEN + sm_pgsz, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (addr == MAP_FAILED)
+		err(EXIT_FAILURE, "failed to map buffer");
+	if (mprotect(addr + SM_BUFLEN, sm_pgsz, PROT_NONE) != 0)
+		err(EXIT_FAILURE, "failed to protect guard page");
+
+	return (addr);
+}
+
+static uint8_t
+sm_pattern(size_t i)
+{
+	return ((uint8_t)((i * 7 + (i >> 8) * 13 + 1) & 0xff));
+}
+
+static void
+sm_fill(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = sm_pattern(i);
+}
+
+static void
+sm_clear(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = SM_CANARY;
+}
+
+/*
+ * Checks that buf[off, off + len) holds exp (or the source pattern from
+ * soff, if exp is -1) and that the rest of buf still holds the canary.
+ */
+static boolean_t
+sm_check(const char *name, const uint8_t *buf, size_t off, size_t len,
+    size_t soff, int exp)
+{
+	size_t i;
+
+	for (i = 0; i < SM_BUFLEN; i++) {
+		uint8_t want;
+
+		if (i >= off && i < off + len) {
+			want = exp == -1 ? sm_pattern(soff + i - off) :
+			    (uint8_t)exp;
+		} else {
+			want = SM_CANARY;
+		}
+
+		if (buf[i] != want) {
+			sm_fail("%s: off %zu len %zu: byte %zu is 0x%x, "
+			    "expected 0x%x", name, off, len, i, buf[i], want);
+			return (B_FALSE);
+		}
+	}
+
+	return (B_TRUE);
+}
+
+static void
+sm_memcpy_one(size_t doff, size_t soff, size_t len)
+{
+	void *ret;
+
+	sm_clear(sm_dst, SM_BUFLEN);
+	ret = memcpy(sm_dst + doff, sm_src + soff, len);
+	if (ret != sm_dst + doff)
+		sm_fail("memcpy returned %p, expected %p", ret, sm_dst + doff);
+	(void) sm_check("memcpy", sm_dst, doff, len, soff, -1);
+}
+
+static void
+sm_memcpy(void)
+{
+	size_t doff, soff, len, i;
+
+	sm_fill(sm_src, SM_BUFLEN);
+	for (len = 0; len < SM_SMALL; len++) {
+		for (doff = 0; doff < SM_ALIGN; doff++) {
+			for (soff = 0; soff < SM_ALIGN; soff += 7)
+				sm_memcpy_one(doff, soff, len);
+		}
+	}
+
+	for (i = 0; i < SM_NLARGE; i++) {
+		for (doff = 0; doff < SM_ALIGN; doff += 5) {
+			for (soff = 0; soff < SM_ALIGN; soff += 13)
+				sm_memcpy_one(doff, soff, sm_large[i]);
+		}
+	}
+
+	/* copy right up to the guard page */
+	sm_memcpy_one(SM_BUFLEN - 4099, SM_BUFLEN - 4097, 4097);
+}
+
+/*
+ * memmove() of len bytes from soff to doff within the same buffer.
+ */
+static void
+sm_memmove_one(size_t doff, size_t soff, size_t len)
+{
+	size_t i;
+	void *ret;
+
+	sm_fill(sm_dst, SM_BUFLEN);
+	ret = memmove(sm_dst + doff, sm_dst + soff, len);
+	if (ret != sm_dst + doff)
+		sm_fail("memmove returned %p, expected %p", ret, sm_dst + doff);
+
+	for (i = 0; i < SM_BUFLEN; i++) {
+		uint8_t want;
+
+		if (i >= doff && i < doff + len)
+			want = sm_pattern(soff + i - doff);
+		else
+			want = sm_pattern(i);
+
+		if (sm_dst[i] != want) {
+			sm_fail("memmove: %zu to %zu len %zu: byte %zu is "
+			    "0x%x, expected 0x%x", soff, doff, len, i,
+			    sm_dst[i], want);
+			return;
+		}
+	}
+}
+
+static void
+sm_memmove(void)
+{
+	static const size_t base = 8192;
+	size_t len, i;
+	int delta;
+
+	for (len = 0; len < SM_SMALL; len++) {
+		for (delta = -160; delta <= 160; delta++)
+			sm_memmove_one(base + delta, base, len);
+	}
+
+	for (i = 0; i < SM_NLARGE; i++) {
+		if (base + 70 * 61 + sm_large[i] > SM_BUFLEN)
+			continue;
+		for (delta = -70; delta <= 70; delta++) {
+			sm_memmove_one(base + delta, base, sm_large[i]);
+			sm_memmove_one(base + delta * 61, base, sm_large[i]);
+		}
+	}
+}
+
+static void
+sm_memset_one(size_t off, size_t len, int c)
+{
+	void *ret;
+
+	sm_clear(sm_dst, SM_BUFLEN);
+	ret = memset(sm_dst + off, c, len);
+	if (ret != sm_dst + off)
+		sm_fail("memset returned %p, expected %p", ret, sm_dst + off);
+	(void) sm_check("memset", sm_dst, off, len, 0, (uint8_t)c);
+}
+
+static void
+sm_memset(void)
+{
+	static const int vals[] = { 0, 0xa5, 0x17f };
+	size_t off, len, i, v;
+
+	for (v = 0; v < sizeof (vals) / sizeof (vals[0]); v++) {
+		for (len = 0; len < SM_SMALL; len++) {
+			for (off = 0; off < SM_ALIGN; off++)
+				sm_memset_one(off, len, vals[v]);
+		}
+
+		for (i = 0; i < SM_NLARGE; i++) {
+			for (off = 0; off < SM_ALIGN; off += 3)
+				sm_memset_one(off, sm_large[i], vals[v]);
+		}
+	}
+
+	sm_memset_one(SM_BUFLEN - 4097, 4097, 0xa5);
+}
+
+static int
+sm_sign(int v)
+{
+	return (v < 0 ? -1 : v > 0 ? 1 : 0);
+}
+
+/*
+ * Compares len bytes, first when they are equal and then with a single
+ * difference at each position in turn, in both directions.
+ */
+static void
+sm_memcmp_one(size_t aoff, size_t boff, size_t len, size_t step)
+{
+	uint8_t *a = sm_src + aoff;
+	uint8_t *b = sm_dst + boff;
+	size_t i;
+	int r;
+
+	sm_fill(a, len);
+	sm_fill(b, len);
+
+	if ((r = memcmp(a, b, len)) != 0) {
+		sm_fail("memcmp: %zu equal bytes at %zu/%zu returned %d",
+		    len, aoff, boff, r);
+		return;
+	}
+
+	for (i = 0; i < len; i += step) {
+		uint8_t save = b[i];
+
+		/* 0x80 vs 0x01 also checks that bytes are unsigned */
+		a[i] = 0x80;
+		b[i] = 0x01;
+		if (sm_sign(r = memcmp(a, b, len)) != 1 ||
+		    sm_sign(memcmp(b, a, len)) != -1) {
+			sm_fail("memcmp: %zu bytes at %zu/%zu differing at "
+			    "%zu returned %d", len, aoff, boff, i, r);
+			return;
+		}
+
+		/* a later difference must not matter */
+		if (i + 1 < len) {
+			b[len - 1] = a[len - 1] + 1;
+			if (sm_sign(memcmp(a, b, len)) != 1) {
+				sm_fail("memcmp: %zu bytes at %zu/%zu: "
+				    "difference at %zu not the first", len,
+				    aoff, boff, len - 1);
+				return;
+			}
+			b[len - 1] = a[len - 1];
+		}
+
+		a[i] = b[i] = save;
+	}
+}
+
+static void
+sm_memcmp(void)
+{
+	size_t aoff, boff, len, i;
+
+	for (len = 0; len < SM_SMALL; len++) {
+		for (aoff = 0; aoff < SM_ALIGN; aoff += 3) {
+			for (boff = 0; boff < SM_ALIGN; boff += 11)
+				sm_memcmp_one(aoff, boff, len, 1);
+		}
+	}
+
+	for (i = 0; i < SM_NLARGE; i++) {
+		for (aoff = 0; aoff < SM_ALIGN; aoff += 17)
+			sm_memcmp_one(aoff, 3, sm_large[i], 61);
+	}
+
+	/* buffers which end against the guard pages */
+	for (len = 0; len < SM_SMALL; len++)
+		sm_memcmp_one(SM_BUFLEN - len, SM_BUFLEN - len, len, 1);
+}
+
+/*
+ * Builds a string of len non-null bytes at off in sm_src.
+ */
+static char *
+sm_string(size_t off, size_t len)
+{
+	char *s = (char *)sm_src + off;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		s[i] = 'a' + i % 26;
+	s[len] = '\0';
+
+	return (s);
+}
+
+static void
+sm_strlen(void)
+{
+	size_t off, len, i, n;
+
+	for (len = 0; len < SM_SMALL; len++) {
+		for (off = 0; off < SM_ALIGN; off++) {
+			if ((n = strlen(sm_string(off, len))) != len) {
+				sm_fail("strlen: %zu bytes at %zu returned %zu",
+				    len, off, n);
+			}
+
+			/* terminator in the last byte before the guard */
+			off = SM_BUFLEN - len - 1 - off;
+			if ((n = strlen(sm_string(off, len))) != len) {
+				sm_fail("strlen: %zu bytes at %zu returned %zu",
+				    len, off, n);
+			}
+			off = SM_BUFLEN - len - 1 - off;
+		}
+	}
+
+	for (i = 0; i < SM_NLARGE; i++) {
+		len = sm_large[i];
+		for (off = 0; off < SM_ALIGN; off += 7) {
+			if ((n = strlen(sm_string(off, len))) != len) {
+				sm_fail("strlen: %zu bytes at %zu returned %zu",
+				    len, off, n);
+			}
+		}
+	}
+}
+
+static void
+sm_strchr_one(size_t off, size_t len)
+{
+	char *s = sm_string(off, len);
+	char *r;
+	size_t i;
+
+	/* not there, the terminator, and a character which sign extends */
+	if ((r = strchr(s, 'A')) != NULL)
+		sm_fail("strchr: 'A' in %zu bytes at %zu found at %p", len,
+		    off, r);
+	if ((r = strchr(s, '\0')) != s + len)
+		sm_fail("strchr: '\\0' in %zu bytes at %zu found at %p, "
+		    "expected %p", len, off, r, s + len);
+
+	for (i = 0; i < len; i++) {
+		char save = s[i];
+
+		s[i] = (char)0xe9;
+		if ((r = strchr(s, 0xe9)) != s + i ||
+		    (r = strchr(s, 0x1e9)) != s + i) {
+			sm_fail("strchr: 0xe9 at %zu in %zu bytes at %zu found "
+			    "at %p", i, len, off, r);
+		}
+		s[i] = save;
+	}
+}
+
+static void
+sm_strchr(void)
+{
+	size_t off, len, i;
+
+	for (len = 0; len < SM_SMALL; len++) {
+		for (off = 0; off < SM_ALIGN; off += 3) {
+			sm_strchr_one(off, len);
+			sm_strchr_one(SM_BUFLEN - len - 1 - off, len);
+		}
+	}
+
+	for (i = 0; i < SM_NLARGE; i++) {
+		for (off = 0; off < SM_ALIGN; off += 29)
+			sm_strchr_one(off, sm_large[i]);
+	}
+}
+
+static void
+sm_memchr_one(size_t off, size_t len)
+{
+	uint8_t *s = sm_src + off;
+	void *r;
+	size_t i;
+
+	(void) memset(s, 'a', len);
+	if ((r = memchr(s, 'b', len)) != NULL)
+		sm_fail("memchr: 'b' in %zu bytes at %zu found at %p", len,
+		    off, r);
+
+	for (i = 0; i < len; i++) {
+		s[i] = 0xe9;
+		if ((r = memchr(s, 0x1e9, len)) != s + i)
+			sm_fail("memchr: 0xe9 at %zu in %zu bytes at %zu found "
+			    "at %p", i, len, off, r);
+		/* a match just past the end must be ignored */
+		if ((r = memchr(s, 0xe9, i)) != NULL)
+			sm_fail("memchr: 0xe9 at %zu found in %zu bytes at %zu",
+			    i, i, off);
+		s[i] = 'a';
+	}
+}
+
+static void
+sm_memchr(void)
+{
+	size_t off, len, i;
+
+	for (len = 0; len < SM_SMALL; len++) {
+		for (off = 0; off < SM_ALIGN; off += 3) {
+			sm_memchr_one(off, len);
+			sm_memchr_one(SM_BUFLEN - len - off, len);
+		}
+	}
+
+	for (i = 0; i < SM_NLARGE; i++) {
+		for (off = 0; off < SM_ALIGN; off += 29)
+			sm_memchr_one(off, sm_large[i]);
+	}
+
+	/* an unbounded search must stop at the match */
+	sm_src[SM_BUFLEN - 1] = 0xe9;
+	if (memchr(sm_src + SM_BUFLEN - 100, 0xe9, SIZE_MAX) !=
+	    sm_src + SM_BUFLEN - 1)
+		sm_fail("memchr: unbounded search failed");
+}
+
+static const struct {
+	const char	*st_name;
+	void		(*st_func)(void);
+} sm_tests[] = {
+	{ "memcpy",	sm_memcpy },
+	{ "memmove",	sm_memmove },
+	{ "memset",	sm_memset },
+	{ "memcmp",	sm_memcmp },
+	{ "strlen",	sm_strlen },
+	{ "strchr",	sm_strchr },
+	{ "memchr",	sm_memchr },
+};
+
+int
+main(void)
+{
+	size_t i;
+
+	sm_pgsz = getpagesize();
+	sm_src = sm_alloc();
+	sm_dst = sm_alloc();
+
+	for (i = 0; i < sizeof (sm_tests) / sizeof (sm_tests[0]); i++) {
+		uint_t fails = sm_fails;
+
+		sm_tests[i].st_func();
+		if (sm_fails == fails) {
+			(void) printf("TEST PASSED: %s\n",
+			    sm_tests[i].st_name);
+		}
+	}
+
+	return (sm_fails == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
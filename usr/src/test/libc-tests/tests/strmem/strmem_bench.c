@@ -0,0 +1,254 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Measures the throughput of the string and memory routines for each size
+ * in a range, so that the implementations selected with LD_HWCAP can be
+ * compared:
+ *
+ *	strmem_bench [-r routine] [-m minsize] [-M maxsize] [-t msec]
+ *
+ * Each size is run from a buffer which stays in the cache, at the
+ * alignment malloc gives and again one byte off it.  The output is one
+ * line per routine and size: the routine, the size, the offset, the
+ * throughput in MB/s and the time per call in ns.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+typedef struct sb_routine {
+	const char	*sr_name;
+	void		(*sr_func)(uint8_t *, uint8_t *, size_t);
+} sb_routine_t;
+
+/*
+ * The routines are called through a volatile pointer so that the compiler
+ * can neither inline them nor hoist the calls out of the loop.
+ */
+static void *(*volatile sb_memcpy)(void *, const void *, size_t) = memcpy;
+static void *(*volatile sb_memmove)(void *, const void *, size_t) = memmove;
+static void *(*volatile sb_memset)(void *, int, size_t) = memset;
+static int (*volatile sb_memcmp)(const void *, const void *, size_t) = memcmp;
+static size_t (*volatile sb_strlen)(const char *) = strlen;
+static char *(*volatile sb_strchr)(const char *, int) = strchr;
+static void *(*volatile sb_memchr)(const void *, int, size_t) = memchr;
+
+static volatile uintptr_t sb_sink;
+
+static void
+sb_run_memcpy(uint8_t *dst, uint8_t *src, size_t len)
+{
+	sb_sink = (uintptr_t)sb_memcpy(dst, src, len);
+}
+
+static void
+sb_run_memmove(uint8_t *dst, uint8_t *src, size_t len)
+{
+	/* overlapping, so that half of the calls copy backwards */
+	sb_sink = (uintptr_t)sb_memmove(src + 1, src, len);
+	sb_sink = (uintptr_t)sb_memmove(src, src + 1, len);
+}
+
+static void
+sb_run_memset(uint8_t *dst, uint8_t *src, size_t len)
+{
+	sb_sink = (uintptr_t)sb_memset(dst, 0xa5, len);
+}
+
+static void
+sb_run_memcmp(uint8_t *dst, uint8_t *src, size_t len)
+{
+	sb_sink = (uintptr_t)sb_memcmp(dst, src, len);
+}
+
+static void
+sb_run_strlen(uint8_t *dst, uint8_t *src, size_t len)
+{
+	sb_sink = sb_strlen((char *)src);
+}
+
+static void
+sb_run_strchr(uint8_t *dst, uint8_t *src, size_t len)
+{
+	sb_sink = (uintptr_t)sb_strchr((char *)src, 'Z');
+}
+
+static void
+sb_run_memchr(uint8_t *dst, uint8_t *src, size_t len)
+{
+	sb_sink = (uintptr_t)sb_memchr(src, 'Z', len);
+}
+
+static const sb_routine_t sb_routines[] = {
+	{ "memcpy",	sb_run_memcpy },
+	{ "memmove",	sb_run_memmove },
+	{ "memset",	sb_run_memset },
+	{ "memcmp",	sb_run_memcmp },
+	{ "strlen",	sb_run_strlen },
+	{ "strchr",	sb_run_strchr },
+	{ "memchr",	sb_run_memchr },
+	{ NULL }
+};
+
+static void
+sb_usage(const char *fmt, ...)
+{
+	if (fmt != NULL) {
+		va_list ap;
+
+		va_start(ap, fmt);
+		vwarnx(fmt, ap);
+		va_end(ap);
+	}
+
+	(void) fprintf(stderr, "Usage: strmem_bench [-r routine] "
+	    "[-m minsize] [-M maxsize] [-t msec]\n");
+	exit(2);
+}
+
+static size_t
+sb_parse_size(const char *arg, char opt)
+{
+	char *eptr;
+	unsigned long long v;
+
+	errno = 0;
+	v = strtoull(arg, &eptr, 0);
+	if (errno != 0 || *eptr != '\0' || v == 0 || v > SIZE_MAX / 4)
+		sb_usage("invalid value for -%c: %s", opt, arg);
+
+	return ((size_t)v);
+}
+
+/*
+ * Fills both buffers with the same run of len non-null bytes other than
+ * 'Z', so that memcmp(), strlen(), strchr() and memchr() all have to look
+ * at every byte, and terminates them.
+ */
+static void
+sb_prepare(uint8_t *dst, uint8_t *src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = src[i] = 'a' + i % 25;
+	dst[len] = src[len] = '\0';
+}
+
+static void
+sb_bench(const sb_routine_t *sr, uint8_t *dst, uint8_t *src, size_t len,
+    size_t off, hrtime_t dur)
+{
+	hrtime_t start, elapsed;
+	uint64_t calls, i, batch;
+	double mbps, nspc;
+
+	sb_prepare(dst, src, len + off);
+	src += off;
+	dst += off;
+
+	/* a warm up call, then batches of calls until the time is up */
+	sr->sr_func(dst, src, len);
+	batch = MAX(1, (64 * 1024) / (len + 1));
+	calls = 0;
+	start = gethrtime();
+	do {
+		for (i = 0; i < batch; i++)
+			sr->sr_func(dst, src, len);
+		calls += batch;
+		elapsed = gethrtime() - start;
+	} while (elapsed < dur);
+
+	if (sr->sr_func == sb_run_memmove)
+		calls *= 2;
+
+	mbps = ((double)calls * len * NANOSEC) /
+	    ((double)elapsed * 1024 * 1024);
+	nspc = (double)elapsed / calls;
+	(void) printf("%-8s %9zu %3zu %12.1f %12.2f\n", sr->sr_name, len, off,
+	    mbps, nspc);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *routine = NULL;
+	size_t minsz = 1, maxsz = 1024 * 1024, len, buflen;
+	hrtime_t dur = MSEC2NSEC(100);
+	const sb_routine_t *sr;
+	uint8_t *src, *dst;
+	int c;
+
+	while ((c = getopt(argc, argv, ":r:m:M:t:")) != -1) {
+		switch (c) {
+		case 'r':
+			routine = optarg;
+			break;
+		case 'm':
+			minsz = sb_parse_size(optarg, c);
+			break;
+		case 'M':
+			maxsz = sb_parse_size(optarg, c);
+			break;
+		case 't':
+			dur = MSEC2NSEC(sb_parse_size(optarg, c));
+			break;
+		case ':':
+			sb_usage("option -%c requires an argument", optopt);
+			break;
+		case '?':
+			sb_usage("unknown option: -%c", optopt);
+			break;
+		}
+	}
+
+	for (sr = sb_routines; routine != NULL && sr->sr_name != NULL; sr++) {
+		if (strcmp(routine, sr->sr_name) == 0)
+			break;
+	}
+	if (routine != NULL && sr->sr_name == NULL)
+		sb_usage("unknown routine: %s", routine);
+
+	if (minsz > maxsz)
+		sb_usage("minimum size %zu is above the maximum %zu", minsz,
+		    maxsz);
+
+	buflen = maxsz + 64;
+	if ((src = malloc(buflen)) == NULL || (dst = malloc(buflen)) == NULL)
+		err(EXIT_FAILURE, "failed to allocate %zu byte buffers",
+		    buflen);
+
+	(void) printf("%-8s %9s %3s %12s %12s\n", "ROUTINE", "SIZE", "OFF",
+	    "MB/S", "NS/CALL");
+	for (sr = sb_routines; sr->sr_name != NULL; sr++) {
+		if (routine != NULL && strcmp(routine, sr->sr_name) != 0)
+			continue;
+
+		for (len = minsz; len <= maxsz; len *= 2) {
+			sb_bench(sr, dst, src, len, 0, dur);
+			sb_bench(sr, dst, src, len, 1, dur);
+		}
+	}
+
+	free(src);
+	free(dst);
+	return (EXIT_SUCCESS);
+}
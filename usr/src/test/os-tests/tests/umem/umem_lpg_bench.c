@@ -0,0 +1,153 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Measure the data TLB misses taken by an allocation heavy workload on top
+ * of libumem.  The workload keeps a working set of buffers of assorted
+ * sizes, replacing a random one and touching a few others on every
+ * operation.  Run it once with the default heap and once with a heap built
+ * out of large pages to see the difference, e.g.:
+ *
+ *	UMEM_OPTIONS=backend=mmap umem_lpg_bench
+ *	UMEM_OPTIONS=backend=mmap,mmap_pagesize=2m umem_lpg_bench
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <umem.h>
+#include <libcpc.h>
+#include <sys/time.h>
+
+#define	BENCH_EVENT	"PAPI_tlb_dm"	/* data TLB misses */
+#define	BENCH_NBUFS	(256 * 1024)	/* buffers in the working set */
+#define	BENCH_NOPS	(16 * 1024 * 1024)
+#define	BENCH_TOUCH	4		/* buffers read per operation */
+
+static const size_t bench_sizes[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 2048, 4096
+};
+
+typedef struct bench_buf {
+	uint8_t	*bb_addr;
+	size_t	bb_size;
+} bench_buf_t;
+
+static void
+usage(const char *progname)
+{
+	(void) fprintf(stderr, "Usage: %s [-e event] [-n bufs] [-o ops]\n",
+	    progname);
+	exit(2);
+}
+
+static void
+bench_alloc(bench_buf_t *bb)
+{
+	bb->bb_size = bench_sizes[random() %
+	    (sizeof (bench_sizes) / sizeof (bench_sizes[0]))];
+	bb->bb_addr = umem_alloc(bb->bb_size, UMEM_NOFAIL);
+	(void) memset(bb->bb_addr, 0xa5, bb->bb_size);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *event = BENCH_EVENT;
+	size_t nbufs = BENCH_NBUFS;
+	uint64_t nops = BENCH_NOPS;
+	uint64_t op, sum = 0, before, after;
+	bench_buf_t *bufs;
+	cpc_t *cpc;
+	cpc_set_t *set;
+	cpc_buf_t *start, *end;
+	hrtime_t t;
+	int c, idx;
+	size_t i;
+
+	while ((c = getopt(argc, argv, "e:n:o:")) != -1) {
+		switch (c) {
+		case 'e':
+			event = optarg;
+			break;
+		case 'n':
+			nbufs = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			nops = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (nbufs == 0 || nops == 0)
+		usage(argv[0]);
+
+	if ((cpc = cpc_open(CPC_VER_CURRENT)) == NULL)
+		err(EXIT_FAILURE, "cpc_open failed");
+	if ((set = cpc_set_create(cpc)) == NULL)
+		err(EXIT_FAILURE, "cpc_set_create failed");
+	if ((idx = cpc_set_add_request(cpc, set, event, 0, CPC_COUNT_USER,
+	    0, NULL)) == -1)
+		err(EXIT_FAILURE, "cannot count %s", event);
+	if ((start = cpc_buf_create(cpc, set)) == NULL ||
+	    (end = cpc_buf_create(cpc, set)) == NULL)
+		err(EXIT_FAILURE, "cpc_buf_create failed");
+
+	srandom(1);
+	bufs = umem_zalloc(nbufs * sizeof (bench_buf_t), UMEM_NOFAIL);
+	for (i = 0; i < nbufs; i++)
+		bench_alloc(&bufs[i]);
+
+	if (cpc_bind_curlwp(cpc, set, 0) != 0)
+		err(EXIT_FAILURE, "cpc_bind_curlwp failed");
+	if (cpc_set_sample(cpc, set, start) != 0)
+		err(EXIT_FAILURE, "cpc_set_sample failed");
+	t = gethrtime();
+
+	for (op = 0; op < nops; op++) {
+		bench_buf_t *bb = &bufs[random() % nbufs];
+
+		umem_free(bb->bb_addr, bb->bb_size);
+		bench_alloc(bb);
+
+		for (c = 0; c < BENCH_TOUCH; c++) {
+			bb = &bufs[random() % nbufs];
+			sum += bb->bb_addr[random() % bb->bb_size];
+		}
+	}
+
+	t = gethrtime() - t;
+	if (cpc_set_sample(cpc, set, end) != 0)
+		err(EXIT_FAILURE, "cpc_set_sample failed");
+	(void) cpc_unbind(cpc, set);
+
+	(void) cpc_buf_get(cpc, start, idx, &before);
+	(void) cpc_buf_get(cpc, end, idx, &after);
+
+	(void) printf("UMEM_OPTIONS: %s\n", getenv("UMEM_OPTIONS") != NULL ?
+	    getenv("UMEM_OPTIONS") : "(unset)");
+	(void) printf("%llu ops on %lu buffers in %.3f s (checksum %llx)\n",
+	    (u_longlong_t)nops, (ulong_t)nbufs, (double)t / NANOSEC,
+	    (u_longlong_t)sum);
+	(void) printf("%s: %llu, %.4f per op\n", event,
+	    (u_longlong_t)(after - before), (double)(after - before) / nops);
+
+	for (i = 0; i < nbufs; i++)
+		umem_free(bufs[i].bb_addr, bufs[i].bb_size);
+	umem_free(bufs, nbufs * sizeof (bench_buf_t));
+	cpc_close(cpc);
+
+	return (0);
+}
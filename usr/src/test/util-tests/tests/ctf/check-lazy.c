@@ -0,0 +1,569 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Check that CTF_VERSION_3 containers are loaded lazily.  Names must resolve
+ * through the name index of a parent and a child without the type data being
+ * loaded, the type data must be correct once it is loaded, and a failed load
+ * must leave the container as it was.  CTF_VERSION_2 containers must still
+ * open and resolve as they always have.
+ *
+ * Besides the converted objects given as arguments, we build a parent and a
+ * child container in memory and derive from them buffers in each of the
+ * formats that we want to open.  A buffer whose compressed data has been
+ * overwritten can only be used for as long as nothing loads it, so we use
+ * those to show that a lookup has not loaded the container.
+ */
+
+#include <sys/sysmacros.h>
+#include <sys/time.h>
+#include <zlib.h>
+#include "check-common.h"
+
+/*
+ * The number of types added to the parent, and the number of times that we
+ * time opening it, from which we take the fastest.
+ */
+#define	LAZY_NTYPES	20000
+#define	LAZY_NRUNS	20
+
+typedef struct lazy_ids {
+	ctf_id_t li_int;
+	ctf_id_t li_foo;
+	ctf_id_t li_foo_t;
+	ctf_id_t li_color;
+	ctf_id_t li_last;
+	ctf_id_t li_cfoo_t;
+} lazy_ids_t;
+
+typedef struct lazy_buf {
+	void *lb_data;
+	size_t lb_size;
+} lazy_buf_t;
+
+static check_number_t check_ints[] = {
+	{ "int", CTF_K_INTEGER, CTF_INT_SIGNED, 0, 32 },
+	{ NULL }
+};
+
+static check_member_t check_foo[] = {
+	{ "a", "int", 0 },
+	{ "b", "int", 32 },
+	{ NULL }
+};
+
+static check_enum_t check_color[] = {
+	{ "RED", 1 },
+	{ "GREEN", 2 },
+	{ NULL }
+};
+
+static check_member_t check_lazy[] = {
+	{ "l_a", "int", 0 },
+	{ "l_b", "int", 32 },
+	{ "l_c", "char [4]", 64 },
+	{ NULL }
+};
+
+static check_enum_t check_lazy_state[] = {
+	{ "LAZY_UNLOADED", 0 },
+	{ "LAZY_LOADED", 7 },
+	{ NULL }
+};
+
+static check_size_test_t check_sizes[] = {
+	{ "struct lazy", 12 },
+	{ "lazy_t", 12 },
+	{ NULL }
+};
+
+static void
+lazy_create(ctf_file_t **pfpp, ctf_file_t **cfpp, lazy_ids_t *lip)
+{
+	ctf_encoding_t enc = { CTF_INT_SIGNED, 0, 32 };
+	ctf_file_t *pfp, *cfp;
+	char name[32];
+	int err;
+	uint_t i;
+
+	if ((pfp = ctf_create(&err)) == NULL)
+		errx(EXIT_FAILURE, "failed to create parent: %s",
+		    ctf_errmsg(err));
+
+	/*
+	 * The member types must be committed before members are added.
+	 */
+	if ((lip->li_int = ctf_add_integer(pfp, CTF_ADD_ROOT, "int",
+	    &enc)) == CTF_ERR ||
+	    (lip->li_foo = ctf_add_struct(pfp, CTF_ADD_ROOT, "foo")) ==
+	    CTF_ERR || ctf_update(pfp) != 0 ||
+	    ctf_add_member(pfp, lip->li_foo, "a", lip->li_int, 0) ==
+	    CTF_ERR ||
+	    ctf_add_member(pfp, lip->li_foo, "b", lip->li_int, 32) ==
+	    CTF_ERR ||
+	    (lip->li_foo_t = ctf_add_typedef(pfp, CTF_ADD_ROOT, "foo_t",
+	    lip->li_foo)) == CTF_ERR ||
+	    (lip->li_color = ctf_add_enum(pfp, CTF_ADD_ROOT, "color", 4)) ==
+	    CTF_ERR ||
+	    ctf_add_enumerator(pfp, lip->li_color, "RED", 1) == CTF_ERR ||
+	    ctf_add_enumerator(pfp, lip->li_color, "GREEN", 2) == CTF_ERR) {
+		errx(EXIT_FAILURE, "failed to add parent types: %s",
+		    ctf_errmsg(ctf_errno(pfp)));
+	}
+
+	for (i = 0; i < LAZY_NTYPES; i++) {
+		(void) snprintf(name, sizeof (name), "lazy%u_t", i);
+		if ((lip->li_last = ctf_add_typedef(pfp, CTF_ADD_ROOT, name,
+		    lip->li_int)) == CTF_ERR) {
+			errx(EXIT_FAILURE, "failed to add %s: %s", name,
+			    ctf_errmsg(ctf_errno(pfp)));
+		}
+	}
+
+	if (ctf_update(pfp) != 0)
+		errx(EXIT_FAILURE, "failed to update parent: %s",
+		    ctf_errmsg(ctf_errno(pfp)));
+
+	if ((cfp = ctf_create(&err)) == NULL)
+		errx(EXIT_FAILURE, "failed to create child: %s",
+		    ctf_errmsg(err));
+
+	if (ctf_import(cfp, pfp) != 0 ||
+	    (lip->li_cfoo_t = ctf_add_typedef(cfp, CTF_ADD_ROOT, "cfoo_t",
+	    lip->li_foo)) == CTF_ERR || ctf_update(cfp) != 0) {
+		errx(EXIT_FAILURE, "failed to build child: %s",
+		    ctf_errmsg(ctf_errno(cfp)));
+	}
+
+	*pfpp = pfp;
+	*cfpp = cfp;
+}
+
+/*
+ * Make a copy of a container in the given format.  ctf_update() writes out a
+ * CTF_VERSION_3 container whose data is not compressed.  As the section
+ * offsets are relative to the end of the index, we can make a CTF_VERSION_2
+ * container from it by dropping the index and changing the version.
+ */
+static void
+lazy_mkbuf(ctf_file_t *fp, uchar_t version, boolean_t compress,
+    boolean_t corrupt, lazy_buf_t *lbp)
+{
+	const void *data;
+	const ctf_header_t *hp;
+	const ctf_index_t *cip;
+	ctf_header_t *nhp;
+	size_t size, hdrsz, idxsz, datasz;
+	uLongf zsz;
+	uchar_t *buf;
+
+	ctf_dataptr(fp, &data, &size);
+	hp = data;
+	cip = (const ctf_index_t *)(hp + 1);
+	if (size < sizeof (*hp) + sizeof (*cip) ||
+	    hp->cth_version != CTF_VERSION_3 ||
+	    (hp->cth_flags & CTF_F_COMPRESS) != 0) {
+		errx(EXIT_FAILURE, "unexpected CTF format from ctf_update()");
+	}
+
+	idxsz = cip->cti_len;
+	datasz = size - sizeof (*hp) - idxsz;
+	hdrsz = sizeof (*hp) + (version == CTF_VERSION_3 ? idxsz : 0);
+
+	zsz = compressBound(datasz);
+	if ((buf = malloc(hdrsz + zsz)) == NULL)
+		err(EXIT_FAILURE, "failed to allocate CTF buffer");
+
+	bcopy(data, buf, hdrsz);
+	nhp = (ctf_header_t *)buf;
+	nhp->cth_version = version;
+
+	if (compress) {
+		if (compress2(buf + hdrsz, &zsz, (const uchar_t *)data +
+		    sizeof (*hp) + idxsz, datasz, Z_BEST_COMPRESSION) != Z_OK)
+			errx(EXIT_FAILURE, "failed to compress CTF data");
+		nhp->cth_flags |= CTF_F_COMPRESS;
+		datasz = zsz;
+	} else {
+		bcopy((const uchar_t *)data + sizeof (*hp) + idxsz,
+		    buf + hdrsz, datasz);
+	}
+
+	if (corrupt)
+		(void) memset(buf + hdrsz, 0xa5, datasz);
+
+	lbp->lb_data = buf;
+	lbp->lb_size = hdrsz + datasz;
+}
+
+static ctf_file_t *
+lazy_open(const lazy_buf_t *lbp, int *errp)
+{
+	ctf_sect_t cts;
+
+	bzero(&cts, sizeof (cts));
+	cts.cts_name = ".SUNW_ctf";
+	cts.cts_type = SHT_PROGBITS;
+	cts.cts_data = lbp->lb_data;
+	cts.cts_size = lbp->lb_size;
+	cts.cts_entsize = 1;
+
+	return (ctf_bufopen(&cts, NULL, NULL, errp));
+}
+
+static boolean_t
+lazy_check_id(ctf_file_t *fp, const char *desc, const char *name,
+    ctf_id_t expect)
+{
+	ctf_id_t id;
+
+	if ((id = ctf_lookup_by_name(fp, name)) == CTF_ERR) {
+		warnx("%s: failed to look up %s: %s", desc, name,
+		    ctf_errmsg(ctf_errno(fp)));
+		return (B_FALSE);
+	}
+
+	if (id != expect) {
+		warnx("%s: %s has id %ld, expected %ld", desc, name, id,
+		    expect);
+		return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+static boolean_t
+lazy_check_names(ctf_file_t *fp, const char *desc, const lazy_ids_t *lip)
+{
+	boolean_t ret = B_TRUE;
+
+	if (!lazy_check_id(fp, desc, "int", lip->li_int) ||
+	    !lazy_check_id(fp, desc, "struct foo", lip->li_foo) ||
+	    !lazy_check_id(fp, desc, "foo_t", lip->li_foo_t) ||
+	    !lazy_check_id(fp, desc, "enum color", lip->li_color)) {
+		ret = B_FALSE;
+	}
+
+	if (ctf_lookup_by_name(fp, "struct nope") != CTF_ERR ||
+	    ctf_errno(fp) != ECTF_NOTYPE) {
+		warnx("%s: lookup of a missing type did not fail with "
+		    "ECTF_NOTYPE", desc);
+		ret = B_FALSE;
+	}
+
+	return (ret);
+}
+
+/*
+ * Check the type data of a parent, which will load it if it is lazy.
+ */
+static boolean_t
+lazy_check_types(ctf_file_t *fp, const char *desc, const lazy_ids_t *lip)
+{
+	char name[32], last[32];
+	boolean_t ret = B_TRUE;
+
+	(void) snprintf(last, sizeof (last), "lazy%u_t", LAZY_NTYPES - 1);
+	if (!ctftest_check_numbers(fp, check_ints) ||
+	    !ctftest_check_members("struct foo", fp, CTF_K_STRUCT, 8,
+	    check_foo) ||
+	    !ctftest_check_enum("enum color", fp, check_color) ||
+	    !ctftest_check_size("foo_t", fp, 8)) {
+		warnx("%s: type data is incorrect", desc);
+		ret = B_FALSE;
+	}
+
+	if (ctf_type_resolve(fp, lip->li_last) != lip->li_int ||
+	    ctf_type_name(fp, lip->li_last, name, sizeof (name)) == NULL ||
+	    strcmp(name, last) != 0) {
+		warnx("%s: last typedef is incorrect", desc);
+		ret = B_FALSE;
+	}
+
+	return (ret);
+}
+
+static boolean_t
+lazy_check_child(ctf_file_t *cfp, ctf_file_t *pfp, const char *desc,
+    const lazy_ids_t *lip)
+{
+	const char *parname;
+
+	if ((parname = ctf_parent_name(cfp)) == NULL ||
+	    strcmp(parname, "PARENT") != 0) {
+		warnx("%s: child has wrong parent name", desc);
+		return (B_FALSE);
+	}
+
+	if (ctf_import(cfp, pfp) != 0) {
+		warnx("%s: failed to import parent: %s", desc,
+		    ctf_errmsg(ctf_errno(cfp)));
+		return (B_FALSE);
+	}
+
+	if (!lazy_check_id(cfp, desc, "cfoo_t", lip->li_cfoo_t) ||
+	    !lazy_check_id(cfp, desc, "struct foo", lip->li_foo) ||
+	    !lazy_check_id(cfp, desc, "foo_t", lip->li_foo_t)) {
+		return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Lookups in containers whose type data has been destroyed.  These can only
+ * succeed if nothing is loaded.  Loading must then fail, and leave each
+ * container as it was, so the lookups still succeed and a second load fails
+ * in the same way.
+ */
+static boolean_t
+lazy_check_unloaded(ctf_file_t *pfp, ctf_file_t *cfp, const lazy_ids_t *lip)
+{
+	lazy_buf_t pbuf, cbuf;
+	ctf_file_t *lpfp, *lcfp;
+	boolean_t ret = B_TRUE;
+	char last[32];
+	int err, i;
+
+	(void) snprintf(last, sizeof (last), "lazy%u_t", LAZY_NTYPES - 1);
+	lazy_mkbuf(pfp, CTF_VERSION_3, B_TRUE, B_TRUE, &pbuf);
+	lazy_mkbuf(cfp, CTF_VERSION_3, B_TRUE, B_TRUE, &cbuf);
+
+	if ((lpfp = lazy_open(&pbuf, &err)) == NULL)
+		errx(EXIT_FAILURE, "failed to open unloaded parent: %s",
+		    ctf_errmsg(err));
+	if ((lcfp = lazy_open(&cbuf, &err)) == NULL)
+		errx(EXIT_FAILURE, "failed to open unloaded child: %s",
+		    ctf_errmsg(err));
+
+	if (!lazy_check_names(lpfp, "unloaded parent", lip) ||
+	    !lazy_check_id(lpfp, "unloaded parent", last,
+	    lip->li_last) ||
+	    !lazy_check_child(lcfp, lpfp, "unloaded child", lip)) {
+		ret = B_FALSE;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (ctf_type_size(lpfp, lip->li_foo) != CTF_ERR ||
+		    ctf_errno(lpfp) != ECTF_DECOMPRESS) {
+			warnx("loading parent with bad data did not fail with "
+			    "ECTF_DECOMPRESS");
+			ret = B_FALSE;
+		}
+
+		if (ctf_type_size(lcfp, lip->li_cfoo_t) != CTF_ERR ||
+		    ctf_errno(lcfp) != ECTF_DECOMPRESS) {
+			warnx("loading child with bad data did not fail with "
+			    "ECTF_DECOMPRESS");
+			ret = B_FALSE;
+		}
+
+		if (!lazy_check_names(lpfp, "parent after failed load", lip) ||
+		    !lazy_check_id(lcfp, "child after failed load", "cfoo_t",
+		    lip->li_cfoo_t) ||
+		    !lazy_check_id(lcfp, "child after failed load",
+		    "struct foo", lip->li_foo)) {
+			ret = B_FALSE;
+		}
+	}
+
+	ctf_close(lcfp);
+	ctf_close(lpfp);
+	free(cbuf.lb_data);
+	free(pbuf.lb_data);
+
+	return (ret);
+}
+
+/*
+ * Lookups and type data in intact containers of each version, with and
+ * without compression.
+ */
+static boolean_t
+lazy_check_loaded(ctf_file_t *pfp, ctf_file_t *cfp, const lazy_ids_t *lip,
+    uchar_t version, boolean_t compress)
+{
+	lazy_buf_t pbuf, cbuf;
+	ctf_file_t *lpfp, *lcfp;
+	boolean_t ret = B_TRUE;
+	char desc[64];
+	int err;
+
+	(void) snprintf(desc, sizeof (desc), "v%u%s", version,
+	    compress ? " compressed" : "");
+
+	lazy_mkbuf(pfp, version, compress, B_FALSE, &pbuf);
+	lazy_mkbuf(cfp, version, compress, B_FALSE, &cbuf);
+
+	if ((lpfp = lazy_open(&pbuf, &err)) == NULL)
+		errx(EXIT_FAILURE, "%s: failed to open parent: %s", desc,
+		    ctf_errmsg(err));
+	if ((lcfp = lazy_open(&cbuf, &err)) == NULL)
+		errx(EXIT_FAILURE, "%s: failed to open child: %s", desc,
+		    ctf_errmsg(err));
+
+	if (!lazy_check_names(lpfp, desc, lip) ||
+	    !lazy_check_child(lcfp, lpfp, desc, lip) ||
+	    !ctftest_check_size("cfoo_t", lcfp, 8) ||
+	    ctf_type_resolve(lcfp, lip->li_cfoo_t) != lip->li_foo ||
+	    !lazy_check_types(lpfp, desc, lip) ||
+	    !lazy_check_names(lpfp, desc, lip)) {
+		warnx("%s: checks failed", desc);
+		ret = B_FALSE;
+	}
+
+	ctf_close(lcfp);
+	ctf_close(lpfp);
+	free(cbuf.lb_data);
+	free(pbuf.lb_data);
+
+	/*
+	 * A CTF_VERSION_2 container is loaded when it is opened, so bad data
+	 * must still be reported by ctf_bufopen().
+	 */
+	if (version == CTF_VERSION_2 && compress) {
+		lazy_mkbuf(pfp, version, B_TRUE, B_TRUE, &pbuf);
+		if ((lpfp = lazy_open(&pbuf, &err)) != NULL) {
+			warnx("%s: opened container with bad data", desc);
+			ctf_close(lpfp);
+			ret = B_FALSE;
+		} else if (err != ECTF_DECOMPRESS) {
+			warnx("%s: opening container with bad data failed "
+			    "with %s, expected ECTF_DECOMPRESS", desc,
+			    ctf_errmsg(err));
+			ret = B_FALSE;
+		}
+		free(pbuf.lb_data);
+	}
+
+	return (ret);
+}
+
+static hrtime_t
+lazy_time(const lazy_buf_t *lbp, const lazy_ids_t *lip)
+{
+	hrtime_t start, end, best = INT64_MAX;
+	ctf_file_t *fp;
+	ctf_id_t id;
+	int err, i;
+
+	for (i = 0; i < LAZY_NRUNS; i++) {
+		start = gethrtime();
+		if ((fp = lazy_open(lbp, &err)) == NULL)
+			errx(EXIT_FAILURE, "failed to open container: %s",
+			    ctf_errmsg(err));
+		id = ctf_lookup_by_name(fp, "struct foo");
+		end = gethrtime();
+
+		if (id != lip->li_foo)
+			errx(EXIT_FAILURE, "timed lookup of struct foo failed");
+		ctf_close(fp);
+
+		best = MIN(best, end - start);
+	}
+
+	return (best);
+}
+
+/*
+ * Time opening a large compressed container and looking up one name in it.
+ * Through the index, neither needs the type data, so the v3 container must
+ * be faster than the v2 container, which is loaded when it is opened.
+ */
+static boolean_t
+lazy_check_time(ctf_file_t *pfp, const lazy_ids_t *lip)
+{
+	lazy_buf_t v2buf, v3buf;
+	hrtime_t v2, v3;
+
+	lazy_mkbuf(pfp, CTF_VERSION_2, B_TRUE, B_FALSE, &v2buf);
+	lazy_mkbuf(pfp, CTF_VERSION_3, B_TRUE, B_FALSE, &v3buf);
+
+	v2 = lazy_time(&v2buf, lip);
+	v3 = lazy_time(&v3buf, lip);
+
+	free(v3buf.lb_data);
+	free(v2buf.lb_data);
+
+	(void) printf("open and first lookup of %u types: v2 %lld us, "
+	    "v3 %lld us\n", LAZY_NTYPES, v2 / (NANOSEC / MICROSEC),
+	    v3 / (NANOSEC / MICROSEC));
+
+	if (v3 >= v2) {
+		warnx("opening a v3 container was not faster than v2");
+		return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	ctf_file_t *pfp, *cfp;
+	lazy_ids_t ids;
+	int i, ret = 0;
+	uint_t j;
+
+	if (argc < 2) {
+		errx(EXIT_FAILURE, "missing test files");
+	}
+
+	for (i = 1; i < argc; i++) {
+		ctf_file_t *fp;
+
+		if ((fp = ctf_open(argv[i], &ret)) == NULL) {
+			warnx("failed to open %s: %s", argv[i],
+			    ctf_errmsg(ret));
+			ret = EXIT_FAILURE;
+			continue;
+		}
+
+		if (ctf_lookup_by_name(fp, "lazy_t") == CTF_ERR ||
+		    ctf_lookup_by_name(fp, "enum lazy_state") == CTF_ERR) {
+			warnx("failed to look up types in %s: %s", argv[i],
+			    ctf_errmsg(ctf_errno(fp)));
+			ret = EXIT_FAILURE;
+		}
+
+		if (!ctftest_check_members("struct lazy", fp, CTF_K_STRUCT, 12,
+		    check_lazy) ||
+		    !ctftest_check_enum("enum lazy_state", fp,
+		    check_lazy_state)) {
+			ret = EXIT_FAILURE;
+		}
+
+		for (j = 0; check_sizes[j].cst_name != NULL; j++) {
+			if (!ctftest_check_size(check_sizes[j].cst_name, fp,
+			    check_sizes[j].cst_size)) {
+				ret = EXIT_FAILURE;
+			}
+		}
+
+		ctf_close(fp);
+	}
+
+	lazy_create(&pfp, &cfp, &ids);
+
+	if (!lazy_check_unloaded(pfp, cfp, &ids) ||
+	    !lazy_check_loaded(pfp, cfp, &ids, CTF_VERSION_3, B_FALSE) ||
+	    !lazy_check_loaded(pfp, cfp, &ids, CTF_VERSION_3, B_TRUE) ||
+	    !lazy_check_loaded(pfp, cfp, &ids, CTF_VERSION_2, B_FALSE) ||
+	    !lazy_check_loaded(pfp, cfp, &ids, CTF_VERSION_2, B_TRUE) ||
+	    !lazy_check_time(pfp, &ids)) {
+		ret = EXIT_FAILURE;
+	}
+
+	ctf_close(cfp);
+	ctf_close(pfp);
+
+	return (ret);
+}
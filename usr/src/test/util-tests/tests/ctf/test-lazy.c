@@ -0,0 +1,30 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Types looked up through the name index of a converted object.
+ */
+
+struct lazy {
+	int l_a;
+	int l_b;
+	char l_c[4];
+};
+
+typedef struct lazy lazy_t;
+
+enum lazy_state {
+	LAZY_UNLOADED,
+	LAZY_LOADED = 7
+};
+
+lazy_t lazy;
+enum lazy_state lazy_state;
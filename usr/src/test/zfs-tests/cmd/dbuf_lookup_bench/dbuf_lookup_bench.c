@@ -0,0 +1,260 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Measure the rate of dbuf hash table lookups in libzpool as the number of
+ * threads grows.
+ *
+ * A pool is created on a file vdev in the given directory, and an object of
+ * nblocks blocks is written to it.  Every block is then held, so that all
+ * of its dbufs stay in the hash table, and the threads look up random
+ * blocks of the object for the given number of seconds: through
+ * dmu_buf_hold_by_dnode() by default, or directly with dbuf_find() for
+ * blocks past the end of the object with -m, which measures the cost of
+ * walking a chain and finding nothing.  The run is repeated for 1, 2, 4,
+ * ... up to the given number of threads.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/dmu.h>
+#include <sys/dmu_tx.h>
+#include <sys/dnode.h>
+#include <sys/dbuf.h>
+#include <sys/dsl_pool.h>
+#include <sys/txg.h>
+#include <sys/fs/zfs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define	BENCH_POOL	"dbuf_lookup_bench"
+
+static objset_t *bench_os;
+static dnode_t *bench_dn;
+static uint64_t bench_obj;
+static uint64_t bench_nblocks = 65536;
+static int bench_blksz = 4096;
+static boolean_t bench_miss = B_FALSE;
+static hrtime_t bench_end;
+
+typedef struct bench_thread {
+	pthread_t	bt_tid;
+	uint64_t	bt_seed;
+	uint64_t	bt_ops;
+} bench_thread_t;
+
+static uint64_t
+bench_rand(uint64_t *seed)
+{
+	/* xorshift64 */
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	return (*seed);
+}
+
+static void *
+bench_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+	dmu_buf_impl_t *db;
+	dmu_buf_t *dbuf;
+	uint64_t blkid;
+	int i;
+
+	while (gethrtime() < bench_end) {
+		for (i = 0; i < 1024; i++) {
+			blkid = bench_rand(&bt->bt_seed) % bench_nblocks;
+			if (bench_miss) {
+				db = dbuf_find(bench_os, bench_obj, 0,
+				    bench_nblocks + blkid);
+				VERIFY3P(db, ==, NULL);
+			} else {
+				VERIFY0(dmu_buf_hold_by_dnode(bench_dn,
+				    blkid * bench_blksz, FTAG, &dbuf,
+				    DMU_READ_NO_PREFETCH));
+				dmu_buf_rele(dbuf, FTAG);
+			}
+		}
+		bt->bt_ops += i;
+	}
+
+	return (NULL);
+}
+
+static nvlist_t *
+make_vdev_root(const char *path)
+{
+	nvlist_t *root, *file;
+
+	file = fnvlist_alloc();
+	fnvlist_add_string(file, ZPOOL_CONFIG_TYPE, VDEV_TYPE_FILE);
+	fnvlist_add_string(file, ZPOOL_CONFIG_PATH, path);
+	fnvlist_add_uint64(file, ZPOOL_CONFIG_ASHIFT, SPA_MINBLOCKSHIFT);
+
+	root = fnvlist_alloc();
+	fnvlist_add_string(root, ZPOOL_CONFIG_TYPE, VDEV_TYPE_ROOT);
+	fnvlist_add_nvlist_array(root, ZPOOL_CONFIG_CHILDREN, &file, 1);
+	fnvlist_free(file);
+
+	return (root);
+}
+
+static void
+setup(const char *path)
+{
+	uint64_t off, chunk = 1024 * 1024;
+	nvlist_t *nvroot;
+	dmu_tx_t *tx;
+	char *buf;
+	int fd;
+
+	if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0 ||
+	    ftruncate(fd, MAX(bench_nblocks * bench_blksz * 4,
+	    1024ULL * 1024 * 1024)) != 0) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	(void) close(fd);
+
+	nvroot = make_vdev_root(path);
+	VERIFY0(spa_create(BENCH_POOL, nvroot, NULL, NULL, NULL));
+	nvlist_free(nvroot);
+	VERIFY0(dmu_objset_own(BENCH_POOL, DMU_OST_ANY, B_FALSE, B_TRUE,
+	    FTAG, &bench_os));
+
+	tx = dmu_tx_create(bench_os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	bench_obj = dmu_object_alloc(bench_os, DMU_OT_UINT64_OTHER,
+	    bench_blksz, DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+
+	buf = umem_alloc(chunk, UMEM_NOFAIL);
+	for (off = 0; off < chunk; off += sizeof (uint64_t))
+		*(uint64_t *)(buf + off) = off + 1;
+	for (off = 0; off < bench_nblocks * bench_blksz; off += chunk) {
+		uint64_t len = MIN(chunk, bench_nblocks * bench_blksz - off);
+
+		tx = dmu_tx_create(bench_os);
+		dmu_tx_hold_write(tx, bench_obj, off, len);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		dmu_write(bench_os, bench_obj, off, len, buf, tx);
+		dmu_tx_commit(tx);
+	}
+	umem_free(buf, chunk);
+	txg_wait_synced(dmu_objset_pool(bench_os), 0);
+
+	VERIFY0(dnode_hold(bench_os, bench_obj, FTAG, &bench_dn));
+}
+
+static void
+teardown(const char *path)
+{
+	dnode_rele(bench_dn, FTAG);
+	dmu_objset_disown(bench_os, B_TRUE, FTAG);
+	VERIFY0(spa_destroy(BENCH_POOL));
+	(void) unlink(path);
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: dbuf_lookup_bench [-m] "
+	    "[-b blocksize] [-n nblocks] [-t maxthreads] [-d seconds] "
+	    "<directory>\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char path[MAXPATHLEN];
+	dmu_buf_t **held;
+	bench_thread_t *bt;
+	int maxthreads = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	int duration = 10;
+	int c, i, n;
+	uint64_t b, ops;
+	hrtime_t start;
+
+	while ((c = getopt(argc, argv, "b:d:mn:t:")) != -1) {
+		switch (c) {
+		case 'b':
+			bench_blksz = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'm':
+			bench_miss = B_TRUE;
+			break;
+		case 'n':
+			bench_nblocks = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			maxthreads = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1 || !ISP2(bench_blksz) ||
+	    bench_blksz < SPA_MINBLOCKSIZE ||
+	    bench_blksz > SPA_OLD_MAXBLOCKSIZE ||
+	    bench_nblocks == 0 || maxthreads < 1 || duration < 1)
+		usage();
+	(void) snprintf(path, sizeof (path), "%s/%s.vdev", argv[optind],
+	    BENCH_POOL);
+
+	kernel_init(FREAD | FWRITE);
+	setup(path);
+
+	held = umem_alloc(bench_nblocks * sizeof (dmu_buf_t *), UMEM_NOFAIL);
+	for (b = 0; b < bench_nblocks; b++) {
+		VERIFY0(dmu_buf_hold_by_dnode(bench_dn, b * bench_blksz, FTAG,
+		    &held[b], DMU_READ_NO_PREFETCH));
+	}
+
+	bt = umem_zalloc(maxthreads * sizeof (bench_thread_t), UMEM_NOFAIL);
+	(void) printf("%8s %14s %14s\n", "threads", "lookups/s",
+	    "lookups/s/thr");
+	for (n = 1; n <= maxthreads; n = (n == maxthreads ? n + 1 :
+	    MIN(n * 2, maxthreads))) {
+		start = gethrtime();
+		bench_end = start + (hrtime_t)duration * NANOSEC;
+		for (i = 0; i < n; i++) {
+			bt[i].bt_seed = (uint64_t)start +
+			    i * 0x9e3779b97f4a7c15ULL;
+			bt[i].bt_ops = 0;
+			VERIFY0(pthread_create(&bt[i].bt_tid, NULL,
+			    bench_thread, &bt[i]));
+		}
+		ops = 0;
+		for (i = 0; i < n; i++) {
+			VERIFY0(pthread_join(bt[i].bt_tid, NULL));
+			ops += bt[i].bt_ops;
+		}
+		(void) printf("%8d %14.0f %14.0f\n", n,
+		    ops / (double)duration, ops / (double)duration / n);
+	}
+	umem_free(bt, maxthreads * sizeof (bench_thread_t));
+
+	for (b = 0; b < bench_nblocks; b++)
+		dmu_buf_rele(held[b], FTAG);
+	umem_free(held, bench_nblocks * sizeof (dmu_buf_t *));
+
+	teardown(path);
+	kernel_fini();
+	return (0);
+}
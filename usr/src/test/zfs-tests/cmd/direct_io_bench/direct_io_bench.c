@@ -0,0 +1,207 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Compare the cost of cached and direct (directio(3C)) I/O on a ZFS file.
+ *
+ * The file is written sequentially, fsync'ed and read back, first through
+ * the ARC and then with DIRECTIO_ON.  For each pass the throughput and the
+ * CPU time spent per GB moved are reported, both for this process and for
+ * the whole system (from the cpu:::sys kstats), since much of the work of
+ * a ZFS write is done by the zio taskq threads.  The block size should
+ * match the recordsize of the dataset so that the direct passes really
+ * bypass the ARC.
+ */
+
+/*
+ * The following is defined so the source can use directio(), memalign()
+ * and lrand48().
+ */
+#define	__EXTENSIONS__
+
+#include "../file_common.h"
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <kstat.h>
+#include <string.h>
+
+#define	GB	(1024.0 * 1024.0 * 1024.0)
+
+typedef struct bench_sample {
+	hrtime_t	bs_wall;
+	hrtime_t	bs_proc;	/* user + system time of this process */
+	uint64_t	bs_sys;		/* user + kernel time of all CPUs */
+} bench_sample_t;
+
+static kstat_ctl_t *kc;
+
+static uint64_t
+cpu_nsec(void)
+{
+	kstat_t *ksp;
+	uint64_t total = 0;
+
+	(void) kstat_chain_update(kc);
+	for (ksp = kc->kc_chain; ksp != NULL; ksp = ksp->ks_next) {
+		kstat_named_t *kn;
+
+		if (strcmp(ksp->ks_module, "cpu") != 0 ||
+		    strcmp(ksp->ks_name, "sys") != 0 ||
+		    kstat_read(kc, ksp, NULL) == -1)
+			continue;
+		if ((kn = kstat_data_lookup(ksp, "cpu_nsec_kernel")) != NULL)
+			total += kn->value.ui64;
+		if ((kn = kstat_data_lookup(ksp, "cpu_nsec_user")) != NULL)
+			total += kn->value.ui64;
+	}
+
+	return (total);
+}
+
+static hrtime_t
+tv2ns(struct timeval *tv)
+{
+	return ((hrtime_t)tv->tv_sec * NANOSEC +
+	    (hrtime_t)tv->tv_usec * (NANOSEC / MICROSEC));
+}
+
+static void
+sample(bench_sample_t *bs)
+{
+	struct rusage ru;
+
+	(void) getrusage(RUSAGE_SELF, &ru);
+	bs->bs_proc = tv2ns(&ru.ru_utime) + tv2ns(&ru.ru_stime);
+	bs->bs_sys = cpu_nsec();
+	bs->bs_wall = gethrtime();
+}
+
+static void
+report(const char *mode, const char *op, uint64_t bytes,
+    bench_sample_t *start, bench_sample_t *end)
+{
+	double gb = bytes / GB;
+	double secs = (end->bs_wall - start->bs_wall) / (double)NANOSEC;
+
+	(void) printf("%-6s %-5s %10.1f MB/s %8.3f proc-cpu-s/GB "
+	    "%8.3f sys-cpu-s/GB\n", mode, op,
+	    bytes / (1024.0 * 1024.0) / secs,
+	    (end->bs_proc - start->bs_proc) / (double)NANOSEC / gb,
+	    (end->bs_sys - start->bs_sys) / (double)NANOSEC / gb);
+}
+
+static void
+run(const char *filename, const char *mode, boolean_t direct, char *buf,
+    size_t blksz, uint64_t size)
+{
+	bench_sample_t start, end;
+	uint64_t off;
+	int fd;
+
+	if ((fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	if (directio(fd, direct ? DIRECTIO_ON : DIRECTIO_OFF) != 0) {
+		perror("directio");
+		exit(EXIT_FAILURE);
+	}
+
+	sample(&start);
+	for (off = 0; off < size; off += blksz) {
+		/* make each block unique so nothing compresses away */
+		/*LINTED: E_BAD_PTR_CAST_ALIGN*/
+		((uint64_t *)buf)[0] = off;
+		if (pwrite(fd, buf, blksz, off) != (ssize_t)blksz) {
+			perror("pwrite");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (fsync(fd) != 0) {
+		perror("fsync");
+		exit(EXIT_FAILURE);
+	}
+	sample(&end);
+	report(mode, "write", size, &start, &end);
+
+	sample(&start);
+	for (off = 0; off < size; off += blksz) {
+		if (pread(fd, buf, blksz, off) != (ssize_t)blksz) {
+			perror("pread");
+			exit(EXIT_FAILURE);
+		}
+	}
+	sample(&end);
+	report(mode, "read", size, &start, &end);
+
+	(void) close(fd);
+	(void) unlink(filename);
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: direct_io_bench [-b blocksize] "
+	    "[-s size_mb] [-p passes] <file>\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t blksz = 128 * 1024;
+	uint64_t size = 1024ULL * 1024 * 1024;
+	int passes = 1;
+	char *buf;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "b:s:p:")) != -1) {
+		switch (c) {
+		case 'b':
+			blksz = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoull(optarg, NULL, 0) * 1024 * 1024;
+			break;
+		case 'p':
+			passes = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1 || blksz < sizeof (uint64_t) ||
+	    size < blksz || passes < 1)
+		usage();
+
+	if ((kc = kstat_open()) == NULL) {
+		perror("kstat_open");
+		exit(EXIT_FAILURE);
+	}
+
+	if ((buf = memalign(getpagesize(), blksz)) == NULL) {
+		perror("memalign");
+		exit(EXIT_FAILURE);
+	}
+	srand48(getpid());
+	for (i = 0; i < blksz / sizeof (long); i++)
+		((long *)buf)[i] = lrand48();
+	size -= size % blksz;
+
+	for (i = 0; i < passes; i++) {
+		run(argv[optind], "cached", B_FALSE, buf, blksz, size);
+		run(argv[optind], "direct", B_TRUE, buf, blksz, size);
+	}
+
+	free(buf);
+	(void) kstat_close(kc);
+	return (0);
+}
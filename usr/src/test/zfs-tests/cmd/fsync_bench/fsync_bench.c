@@ -0,0 +1,191 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Measure the rate at which a number of threads can commit small writes
+ * to stable storage, as a database logging to a ZFS file system would.
+ *
+ * Each thread repeatedly writes a block to its own file in the given
+ * directory and fsync()s it, for the given number of seconds.  The total
+ * number of commits per second and the distribution of commit latencies
+ * are reported.  Running this with an increasing number of threads shows
+ * where commit throughput stops scaling.
+ */
+
+#include "../file_common.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define	NBUCKETS	40	/* log2 latency buckets, in usec */
+
+typedef struct bench_thread {
+	pthread_t	bt_tid;
+	int		bt_fd;
+	uint64_t	bt_commits;
+	uint64_t	bt_hist[NBUCKETS];
+} bench_thread_t;
+
+static size_t blksz = 8192;
+static uint64_t filesz = 64 * 1024 * 1024;
+static volatile boolean_t done;
+static pthread_barrier_t start;
+
+static void *
+bench(void *arg)
+{
+	bench_thread_t *bt = arg;
+	char *buf;
+	off_t off = 0;
+
+	if ((buf = malloc(blksz)) == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	(void) memset(buf, 'z', blksz);
+
+	(void) pthread_barrier_wait(&start);
+	while (!done) {
+		hrtime_t begin = gethrtime();
+		uint64_t us;
+		int b;
+
+		if (pwrite(bt->bt_fd, buf, blksz, off) != (ssize_t)blksz) {
+			perror("pwrite");
+			exit(EXIT_FAILURE);
+		}
+		if (fsync(bt->bt_fd) != 0) {
+			perror("fsync");
+			exit(EXIT_FAILURE);
+		}
+		us = (gethrtime() - begin) / (NANOSEC / MICROSEC);
+		for (b = 0; b < NBUCKETS - 1 && (1ULL << (b + 1)) <= us; b++)
+			continue;
+		bt->bt_hist[b]++;
+		bt->bt_commits++;
+
+		if ((off += blksz) + blksz > filesz)
+			off = 0;
+	}
+
+	free(buf);
+	return (NULL);
+}
+
+/*
+ * Return the upper bound, in usec, of the bucket holding the given
+ * fraction (in tenths of a percent) of the commit latencies.
+ */
+static uint64_t
+percentile(uint64_t *hist, uint64_t total, int permille)
+{
+	uint64_t target = (total * permille + 999) / 1000;
+	uint64_t sum = 0;
+	int b;
+
+	for (b = 0; b < NBUCKETS; b++) {
+		if ((sum += hist[b]) >= target)
+			break;
+	}
+	return (1ULL << (b + 1));
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: fsync_bench [-b blocksize] "
+	    "[-s file_size_mb] [-t threads] [-d seconds] <directory>\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bench_thread_t *bts;
+	uint64_t hist[NBUCKETS] = { 0 };
+	uint64_t total = 0;
+	int nthreads = 1;
+	int duration = 10;
+	hrtime_t begin, end;
+	char path[MAXPATHLEN];
+	int c, i, b;
+
+	while ((c = getopt(argc, argv, "b:s:t:d:")) != -1) {
+		switch (c) {
+		case 'b':
+			blksz = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			filesz = strtoull(optarg, NULL, 0) * 1024 * 1024;
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1 || blksz == 0 || filesz < blksz ||
+	    nthreads < 1 || duration < 1)
+		usage();
+
+	if ((bts = calloc(nthreads, sizeof (bench_thread_t))) == NULL) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	(void) pthread_barrier_init(&start, NULL, nthreads + 1);
+
+	for (i = 0; i < nthreads; i++) {
+		(void) snprintf(path, sizeof (path), "%s/fsync_bench.%d",
+		    argv[optind], i);
+		if ((bts[i].bt_fd = open(path, O_RDWR | O_CREAT | O_TRUNC,
+		    0666)) < 0) {
+			perror("open");
+			exit(EXIT_FAILURE);
+		}
+		if (pthread_create(&bts[i].bt_tid, NULL, bench, &bts[i]) != 0) {
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	(void) pthread_barrier_wait(&start);
+	begin = gethrtime();
+	(void) sleep(duration);
+	done = B_TRUE;
+
+	for (i = 0; i < nthreads; i++)
+		(void) pthread_join(bts[i].bt_tid, NULL);
+	end = gethrtime();
+
+	for (i = 0; i < nthreads; i++) {
+		for (b = 0; b < NBUCKETS; b++)
+			hist[b] += bts[i].bt_hist[b];
+		total += bts[i].bt_commits;
+		(void) close(bts[i].bt_fd);
+		(void) snprintf(path, sizeof (path), "%s/fsync_bench.%d",
+		    argv[optind], i);
+		(void) unlink(path);
+	}
+
+	(void) printf("threads %d: %.0f commits/s, latency p50 < %llu us, "
+	    "p99 < %llu us, p99.9 < %llu us\n", nthreads,
+	    total / ((end - begin) / (double)NANOSEC),
+	    (u_longlong_t)percentile(hist, total, 500),
+	    (u_longlong_t)percentile(hist, total, 990),
+	    (u_longlong_t)percentile(hist, total, 999));
+
+	free(bts);
+	return (0);
+}
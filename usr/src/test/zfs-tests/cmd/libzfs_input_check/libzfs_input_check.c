@@ -421,6 +421,25 @@ test_get_bookmarks(const char *dataset)
 	nvlist_free(optional);
 }
 
+static void
+test_list_batch(const char *dataset)
+{
+	nvlist_t *optional = fnvlist_alloc();
+	nvlist_t *props = fnvlist_alloc();
+
+	fnvlist_add_boolean(props, "used");
+	fnvlist_add_boolean(optional, "snapshots");
+	fnvlist_add_boolean(optional, "simple");
+	fnvlist_add_uint64(optional, "cursor", 0);
+	fnvlist_add_uint64(optional, "count", 10);
+	fnvlist_add_nvlist(optional, "props", props);
+
+	IOC_INPUT_TEST(ZFS_IOC_LIST_BATCH, dataset, NULL, optional, 0);
+
+	nvlist_free(props);
+	nvlist_free(optional);
+}
+
 static void
 test_destroy_bookmarks(const char *pool, const char *bookmark)
 {
@@ -790,6 +809,7 @@ zfs_ioc_input_tests(const char *pool)
 
 	test_bookmark(pool, snapshot, bookmark);
 	test_get_bookmarks(dataset);
+	test_list_batch(dataset);
 	test_destroy_bookmarks(pool, bookmark);
 
 	test_hold(pool, snapshot);
@@ -977,6 +997,7 @@ validate_ioc_values(void)
 	CHECK(ZFS_IOC_BASE + 79 == ZFS_IOC_POOL_TRIM);
 	CHECK(ZFS_IOC_BASE + 80 == ZFS_IOC_REDACT);
 	CHECK(ZFS_IOC_BASE + 81 == ZFS_IOC_GET_BOOKMARK_PROPS);
+	CHECK(ZFS_IOC_BASE + 82 == ZFS_IOC_LIST_BATCH);
 #endif
 	CHECK(ZFS_IOC_PLATFORM_BASE + 7 == ZFS_IOC_SET_BOOTENV);
 	CHECK(ZFS_IOC_PLATFORM_BASE + 8 == ZFS_IOC_GET_BOOTENV);
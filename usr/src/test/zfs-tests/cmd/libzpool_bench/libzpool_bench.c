@@ -0,0 +1,844 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Performance regression benchmark for the DMU and SPA, run in userland
+ * over libzpool.
+ *
+ * A pool is created on a file vdev in the given directory, which should be
+ * on tmpfs so that the device is not what gets measured, and the selected
+ * scenarios are run against it in turn:
+ *
+ *	write	dmu_write() throughput, up to the end of the txg sync
+ *	read	dmu_read() throughput from disk and from the ARC
+ *	txg	time to sync a txg of dirty data
+ *	zil	zil_commit() latency of small synchronous writes
+ *	fsync	zil_commit() rate and latency as the number of threads each
+ *		committing writes to a file of its own grows
+ *	alloc	metaslab_alloc() and metaslab_free() rates
+ *	dedup	dedup write throughput as the DDT outgrows the ARC
+ *
+ * All but dedup are run by default.  The ARC is limited to the size given
+ * with -A (128MB by default) so that the results do not depend on the
+ * memory of the host.  dedup writes unique 512-byte blocks until the DDT
+ * on disk is -R times the size of the ARC (10 by default), and reports the
+ * throughput between each step of that growth; this takes room in the
+ * directory for about 25 times as much data as the final DDT.
+ *
+ * Results are printed one to a line as scenario, metric, value and unit.
+ * With -H they are separated by tabs and there is no header, so that the
+ * results of two runs can be compared by a script.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/dmu.h>
+#include <sys/dmu_tx.h>
+#include <sys/dmu_objset.h>
+#include <sys/dsl_pool.h>
+#include <sys/dsl_prop.h>
+#include <sys/metaslab.h>
+#include <sys/arc.h>
+#include <sys/ddt.h>
+#include <sys/zil.h>
+#include <sys/txg.h>
+#include <sys/fs/zfs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define	BENCH_POOL		"libzpool_bench"
+#define	BENCH_CHUNK		(1ULL << 20)	/* bytes written per tx */
+#define	BENCH_TXGS		16		/* txg syncs timed */
+#define	BENCH_TXG_DIRTY		(32ULL << 20)	/* dirty data per txg */
+#define	BENCH_ALLOCS		(1 << 17)	/* allocations per run */
+#define	BENCH_ALLOC_BATCH	1024		/* allocations per tx */
+#define	BENCH_DDT_CHECK		(64ULL << 20)	/* DDT size sampling */
+#define	BENCH_FSYNC_THREADS	64		/* most fsync threads */
+
+extern uint64_t zfs_arc_max;
+
+static objset_t *bench_os;
+static spa_t *bench_spa;
+static uint64_t bench_obj;
+static uint64_t bench_size = 512ULL << 20;
+static int bench_blksz = 128 * 1024;
+static int bench_nthreads = 1;
+static int bench_commits = 1000;
+static uint64_t bench_arc = 128ULL << 20;
+static int bench_ddt_ratio = 10;
+static boolean_t bench_scripted = B_FALSE;
+
+typedef struct bench_thread {
+	pthread_t	bt_tid;
+	int		bt_id;
+	uint64_t	bt_seed;
+	uint64_t	bt_start;	/* first byte or sample of the slice */
+	uint64_t	bt_len;		/* bytes or samples in the slice */
+	uint64_t	bt_ops;
+	hrtime_t	bt_time;	/* time spent in the measured calls */
+	hrtime_t	bt_time2;
+} bench_thread_t;
+
+typedef struct bench_scenario {
+	const char	*bs_name;
+	void		(*bs_func)(void);
+	boolean_t	bs_default;
+	boolean_t	bs_selected;
+} bench_scenario_t;
+
+static uint64_t *bench_lat;	/* zil commit latencies */
+static zilog_t *bench_zilog;
+static uint64_t *bench_zil_objs;	/* fsync objects, one per thread */
+
+static void
+report(const char *scenario, const char *metric, double value,
+    const char *unit)
+{
+	if (bench_scripted) {
+		(void) printf("%s\t%s\t%.3f\t%s\n", scenario, metric, value,
+		    unit);
+	} else {
+		(void) printf("%-8s %-24s %16.3f %s\n", scenario, metric, value,
+		    unit);
+	}
+	(void) fflush(stdout);
+}
+
+static uint64_t
+bench_rand(uint64_t *seed)
+{
+	/* xorshift64 */
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	return (*seed);
+}
+
+/* Incompressible data, and unique for each seed */
+static void
+bench_fill(void *buf, uint64_t len, uint64_t *seed)
+{
+	uint64_t *p = buf;
+
+	for (uint64_t i = 0; i < len / sizeof (uint64_t); i++)
+		p[i] = bench_rand(seed);
+}
+
+static double
+bench_mbps(uint64_t bytes, hrtime_t t)
+{
+	return ((double)bytes / (1024 * 1024) / ((double)t / NANOSEC));
+}
+
+static int
+bench_cmp_u64(const void *a, const void *b)
+{
+	return (TREE_CMP(*(const uint64_t *)a, *(const uint64_t *)b));
+}
+
+/* Percentile of a sorted array */
+static uint64_t
+bench_pct(const uint64_t *v, uint64_t n, int pct)
+{
+	return (v[MIN(n - 1, n * pct / 100)]);
+}
+
+/*
+ * Run func on bench_nthreads threads, dividing total (bytes if align is
+ * not 0, samples otherwise) among them.  Returns the wall clock time.
+ */
+static hrtime_t
+bench_run_threads(void *(*func)(void *), bench_thread_t *bt, uint64_t total,
+    uint64_t align)
+{
+	uint64_t slice = total / bench_nthreads;
+	hrtime_t start;
+	int i;
+
+	if (align != 0)
+		slice = P2ALIGN(slice, align);
+
+	start = gethrtime();
+	for (i = 0; i < bench_nthreads; i++) {
+		bt[i].bt_id = i;
+		bt[i].bt_seed = (uint64_t)start + i * 0x9e3779b97f4a7c15ULL;
+		bt[i].bt_start = i * slice;
+		bt[i].bt_len = (i == bench_nthreads - 1) ?
+		    total - i * slice : slice;
+		bt[i].bt_ops = 0;
+		bt[i].bt_time = bt[i].bt_time2 = 0;
+		VERIFY0(pthread_create(&bt[i].bt_tid, NULL, func, &bt[i]));
+	}
+	for (i = 0; i < bench_nthreads; i++)
+		VERIFY0(pthread_join(bt[i].bt_tid, NULL));
+
+	return (gethrtime() - start);
+}
+
+static void *
+bench_write_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+	uint64_t off, end = bt->bt_start + bt->bt_len;
+	char *buf = umem_alloc(BENCH_CHUNK, UMEM_NOFAIL);
+
+	bench_fill(buf, BENCH_CHUNK, &bt->bt_seed);
+	for (off = bt->bt_start; off < end; off += BENCH_CHUNK) {
+		uint64_t len = MIN(BENCH_CHUNK, end - off);
+		dmu_tx_t *tx = dmu_tx_create(bench_os);
+
+		dmu_tx_hold_write(tx, bench_obj, off, len);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		dmu_write(bench_os, bench_obj, off, len, buf, tx);
+		dmu_tx_commit(tx);
+	}
+	umem_free(buf, BENCH_CHUNK);
+
+	return (NULL);
+}
+
+static void *
+bench_read_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+	uint64_t off, end = bt->bt_start + bt->bt_len;
+	char *buf = umem_alloc(bench_blksz, UMEM_NOFAIL);
+
+	for (off = bt->bt_start; off < end; off += bench_blksz) {
+		VERIFY0(dmu_read(bench_os, bench_obj, off,
+		    MIN(bench_blksz, end - off), buf, DMU_READ_PREFETCH));
+		bt->bt_ops++;
+	}
+	umem_free(buf, bench_blksz);
+
+	return (NULL);
+}
+
+/*
+ * Drop the cached dbufs of the object, and with flush_arc the ARC buffers
+ * as well, so that the next read comes from the ARC or the disk.
+ */
+static void
+bench_evict(boolean_t flush_arc)
+{
+	txg_wait_synced(spa_get_dsl(bench_spa), 0);
+	dmu_objset_evict_dbufs(bench_os);
+	if (flush_arc)
+		arc_flush(bench_spa, B_TRUE);
+}
+
+static void
+bench_write(void)
+{
+	bench_thread_t *bt;
+	hrtime_t t;
+
+	bt = umem_zalloc(bench_nthreads * sizeof (*bt), UMEM_NOFAIL);
+	t = gethrtime();
+	(void) bench_run_threads(bench_write_thread, bt, bench_size,
+	    BENCH_CHUNK);
+	txg_wait_synced(spa_get_dsl(bench_spa), 0);
+	t = gethrtime() - t;
+	umem_free(bt, bench_nthreads * sizeof (*bt));
+
+	report("write", "throughput", bench_mbps(bench_size, t), "MB/s");
+}
+
+static void
+bench_read(void)
+{
+	uint64_t warm = MIN(bench_size, P2ALIGN(bench_arc / 2, bench_blksz));
+	bench_thread_t *bt;
+	hrtime_t t;
+	uint64_t ops;
+	int i;
+
+	bt = umem_zalloc(bench_nthreads * sizeof (*bt), UMEM_NOFAIL);
+
+	bench_evict(B_TRUE);
+	t = bench_run_threads(bench_read_thread, bt, bench_size, bench_blksz);
+	report("read", "throughput_disk", bench_mbps(bench_size, t), "MB/s");
+
+	/* Read a part that fits in the ARC once, then time the hits */
+	bench_evict(B_TRUE);
+	(void) bench_run_threads(bench_read_thread, bt, warm, bench_blksz);
+	bench_evict(B_FALSE);
+	t = bench_run_threads(bench_read_thread, bt, warm, bench_blksz);
+	for (ops = 0, i = 0; i < bench_nthreads; i++)
+		ops += bt[i].bt_ops;
+	report("read", "throughput_arc", bench_mbps(warm, t), "MB/s");
+	report("read", "arc_hits", (double)ops * NANOSEC / t, "ops/s");
+
+	umem_free(bt, bench_nthreads * sizeof (*bt));
+}
+
+static void
+bench_txg(void)
+{
+	dsl_pool_t *dp = spa_get_dsl(bench_spa);
+	uint64_t dirty = MIN(bench_size, BENCH_TXG_DIRTY);
+	uint64_t nblocks = bench_size / bench_blksz;
+	uint64_t lat[BENCH_TXGS], total = 0;
+	uint64_t seed = gethrtime();
+	char *buf = umem_alloc(bench_blksz, UMEM_NOFAIL);
+
+	bench_fill(buf, bench_blksz, &seed);
+	for (int i = 0; i < BENCH_TXGS; i++) {
+		txg_wait_synced(dp, 0);
+
+		/* Overwrite random blocks until there is enough dirty data */
+		for (uint64_t b = 0; b < dirty; b += bench_blksz) {
+			uint64_t off =
+			    (bench_rand(&seed) % nblocks) * bench_blksz;
+			dmu_tx_t *tx = dmu_tx_create(bench_os);
+
+			dmu_tx_hold_write(tx, bench_obj, off, bench_blksz);
+			VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+			dmu_write(bench_os, bench_obj, off, bench_blksz, buf,
+			    tx);
+			dmu_tx_commit(tx);
+		}
+
+		hrtime_t t = gethrtime();
+		txg_wait_synced(dp, 0);
+		lat[i] = gethrtime() - t;
+		total += lat[i];
+	}
+	umem_free(buf, bench_blksz);
+
+	qsort(lat, BENCH_TXGS, sizeof (uint64_t), bench_cmp_u64);
+	report("txg", "sync_avg", (double)total / BENCH_TXGS / MICROSEC, "ms");
+	report("txg", "sync_p50",
+	    (double)bench_pct(lat, BENCH_TXGS, 50) / MICROSEC, "ms");
+	report("txg", "sync_max", (double)lat[BENCH_TXGS - 1] / MICROSEC, "ms");
+}
+
+/* ARGSUSED */
+static int
+bench_get_data(void *arg, lr_write_t *lr, char *buf, struct lwb *lwb,
+    zio_t *zio)
+{
+	/* All of the records are WR_COPIED */
+	return (SET_ERROR(ENOENT));
+}
+
+/*
+ * Write small blocks and commit each one.  For fsync each thread writes to
+ * an object of its own, and only has to commit that object's records.
+ */
+static void *
+bench_zil_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+	uint64_t len = SPA_MINBLOCKSIZE * 8;
+	uint64_t nblocks = bench_size / len;
+	uint64_t obj = bench_obj;
+	char *buf = umem_alloc(len, UMEM_NOFAIL);
+
+	if (bench_zil_objs != NULL) {
+		obj = bench_zil_objs[bt->bt_id];
+		nblocks = MAX(nblocks / bench_nthreads, 1);
+	}
+
+	bench_fill(buf, len, &bt->bt_seed);
+	for (uint64_t i = bt->bt_start; i < bt->bt_start + bt->bt_len; i++) {
+		uint64_t off = (bench_rand(&bt->bt_seed) % nblocks) * len;
+		dmu_tx_t *tx = dmu_tx_create(bench_os);
+		lr_write_t *lr;
+		itx_t *itx;
+
+		dmu_tx_hold_write(tx, obj, off, len);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		dmu_write(bench_os, obj, off, len, buf, tx);
+
+		itx = zil_itx_create(TX_WRITE, sizeof (*lr) + len);
+		lr = (lr_write_t *)&itx->itx_lr;
+		lr->lr_foid = obj;
+		lr->lr_offset = off;
+		lr->lr_length = len;
+		lr->lr_blkoff = 0;
+		BP_ZERO(&lr->lr_blkptr);
+		bcopy(buf, lr + 1, len);
+		itx->itx_wr_state = WR_COPIED;
+		itx->itx_sync = B_TRUE;
+		zil_itx_assign(bench_zilog, itx, tx);
+		dmu_tx_commit(tx);
+
+		hrtime_t t = gethrtime();
+		zil_commit(bench_zilog, obj);
+		bench_lat[i] = gethrtime() - t;
+	}
+	umem_free(buf, len);
+
+	return (NULL);
+}
+
+/*
+ * Report the rate and latencies of the n commits in bench_lat, which took t
+ * in all.  The suffix is added to the name of each metric.
+ */
+static void
+bench_zil_report(const char *scenario, const char *suffix, uint64_t n,
+    hrtime_t t)
+{
+	char metric[32];
+	uint64_t total = 0;
+
+	for (uint64_t i = 0; i < n; i++)
+		total += bench_lat[i];
+	qsort(bench_lat, n, sizeof (uint64_t), bench_cmp_u64);
+
+	(void) snprintf(metric, sizeof (metric), "commits%s", suffix);
+	report(scenario, metric, (double)n * NANOSEC / t, "ops/s");
+	(void) snprintf(metric, sizeof (metric), "commit_avg%s", suffix);
+	report(scenario, metric, (double)total / n / 1000, "us");
+	(void) snprintf(metric, sizeof (metric), "commit_p50%s", suffix);
+	report(scenario, metric, (double)bench_pct(bench_lat, n, 50) / 1000,
+	    "us");
+	(void) snprintf(metric, sizeof (metric), "commit_p99%s", suffix);
+	report(scenario, metric, (double)bench_pct(bench_lat, n, 99) / 1000,
+	    "us");
+}
+
+static void
+bench_zil(void)
+{
+	uint64_t n = bench_commits;
+	bench_thread_t *bt;
+	hrtime_t t;
+
+	bench_zilog = zil_open(bench_os, bench_get_data);
+	bench_lat = umem_zalloc(n * sizeof (uint64_t), UMEM_NOFAIL);
+	bt = umem_zalloc(bench_nthreads * sizeof (*bt), UMEM_NOFAIL);
+
+	t = bench_run_threads(bench_zil_thread, bt, n, 0);
+	bench_zil_report("zil", "", n, t);
+
+	umem_free(bt, bench_nthreads * sizeof (*bt));
+	umem_free(bench_lat, n * sizeof (uint64_t));
+	zil_close(bench_zilog);
+	bench_zilog = NULL;
+}
+
+/*
+ * An fsync-heavy workload: each thread writes to a file of its own and
+ * commits it, so that the commits contend for the itx lists and the lwbs
+ * rather than waiting on each other's records.  This is run with 1, 2, 4
+ * and so on up to BENCH_FSYNC_THREADS threads (or -t, if that is more), and
+ * each metric is suffixed with the thread count.
+ */
+static void
+bench_fsync(void)
+{
+	int maxthreads = MAX(bench_nthreads, BENCH_FSYNC_THREADS);
+	int nthreads = bench_nthreads;
+	bench_thread_t *bt;
+	char suffix[16];
+	dmu_tx_t *tx;
+	hrtime_t t;
+	int i;
+
+	bench_zil_objs = umem_alloc(maxthreads * sizeof (uint64_t),
+	    UMEM_NOFAIL);
+	for (i = 0; i < maxthreads; i++) {
+		tx = dmu_tx_create(bench_os);
+		dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		bench_zil_objs[i] = dmu_object_alloc(bench_os,
+		    DMU_OT_UINT64_OTHER, bench_blksz, DMU_OT_NONE, 0, tx);
+		dmu_tx_commit(tx);
+	}
+	txg_wait_synced(spa_get_dsl(bench_spa), 0);
+
+	bench_zilog = zil_open(bench_os, bench_get_data);
+	bt = umem_zalloc(maxthreads * sizeof (*bt), UMEM_NOFAIL);
+
+	for (bench_nthreads = 1; ; bench_nthreads *= 2) {
+		uint64_t n;
+
+		bench_nthreads = MIN(bench_nthreads, maxthreads);
+		n = MAX(bench_commits, bench_nthreads);
+		bench_lat = umem_zalloc(n * sizeof (uint64_t), UMEM_NOFAIL);
+
+		t = bench_run_threads(bench_zil_thread, bt, n, 0);
+		(void) snprintf(suffix, sizeof (suffix), "_%dt",
+		    bench_nthreads);
+		bench_zil_report("fsync", suffix, n, t);
+
+		umem_free(bench_lat, n * sizeof (uint64_t));
+		if (bench_nthreads == maxthreads)
+			break;
+	}
+	bench_nthreads = nthreads;
+
+	umem_free(bt, maxthreads * sizeof (*bt));
+	zil_close(bench_zilog);
+	bench_zilog = NULL;
+
+	for (i = 0; i < maxthreads; i++) {
+		tx = dmu_tx_create(bench_os);
+		dmu_tx_hold_free(tx, bench_zil_objs[i], 0, DMU_OBJECT_END);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		VERIFY0(dmu_object_free(bench_os, bench_zil_objs[i], tx));
+		dmu_tx_commit(tx);
+	}
+	txg_wait_synced(spa_get_dsl(bench_spa), 0);
+	umem_free(bench_zil_objs, maxthreads * sizeof (uint64_t));
+	bench_zil_objs = NULL;
+}
+
+/*
+ * Allocate batches of blocks of random sizes from 512 bytes to 128K within
+ * a tx, and give them back before it commits.
+ */
+static void *
+bench_alloc_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+	int allocator = bt->bt_id % bench_spa->spa_alloc_count;
+	blkptr_t *bps = umem_alloc(BENCH_ALLOC_BATCH * sizeof (blkptr_t),
+	    UMEM_NOFAIL);
+
+	for (uint64_t done = 0; done < bt->bt_len; ) {
+		dmu_tx_t *tx = dmu_tx_create(bench_os);
+		zio_alloc_list_t zal;
+		uint64_t txg;
+		hrtime_t t;
+		int i, j;
+
+		dmu_tx_hold_bonus(tx, bench_obj);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		txg = dmu_tx_get_txg(tx);
+
+		t = gethrtime();
+		for (i = 0; i < BENCH_ALLOC_BATCH && done < bt->bt_len;
+		    i++, done++) {
+			uint64_t size = SPA_MINBLOCKSIZE <<
+			    (bench_rand(&bt->bt_seed) %
+			    (SPA_OLD_MAXBLOCKSHIFT - SPA_MINBLOCKSHIFT + 1));
+			blkptr_t *bp = &bps[i];
+
+			BP_ZERO(bp);
+			BP_SET_TYPE(bp, DMU_OT_UINT64_OTHER);
+			BP_SET_PSIZE(bp, size);
+			BP_SET_LSIZE(bp, size);
+			BP_SET_LEVEL(bp, 0);
+
+			metaslab_trace_init(&zal);
+			VERIFY0(metaslab_alloc(bench_spa,
+			    spa_normal_class(bench_spa), size, bp, 1, txg,
+			    NULL, 0, &zal, NULL, allocator));
+			metaslab_trace_fini(&zal);
+		}
+		bt->bt_time += gethrtime() - t;
+
+		t = gethrtime();
+		for (j = 0; j < i; j++)
+			metaslab_free(bench_spa, &bps[j], txg, B_TRUE);
+		bt->bt_time2 += gethrtime() - t;
+
+		dmu_tx_commit(tx);
+		bt->bt_ops += i;
+	}
+	umem_free(bps, BENCH_ALLOC_BATCH * sizeof (blkptr_t));
+
+	return (NULL);
+}
+
+static void
+bench_alloc(void)
+{
+	bench_thread_t *bt;
+	hrtime_t talloc = 0, tfree = 0;
+	uint64_t ops = 0;
+
+	bt = umem_zalloc(bench_nthreads * sizeof (*bt), UMEM_NOFAIL);
+	(void) bench_run_threads(bench_alloc_thread, bt, BENCH_ALLOCS, 0);
+	for (int i = 0; i < bench_nthreads; i++) {
+		ops += bt[i].bt_ops;
+		talloc = MAX(talloc, bt[i].bt_time);
+		tfree = MAX(tfree, bt[i].bt_time2);
+	}
+	umem_free(bt, bench_nthreads * sizeof (*bt));
+
+	report("alloc", "metaslab_alloc", (double)ops * NANOSEC / talloc,
+	    "ops/s");
+	report("alloc", "metaslab_free", (double)ops * NANOSEC / tfree,
+	    "ops/s");
+}
+
+/*
+ * Write unique blocks to a dedup object, and report the throughput over
+ * each step of the growth of the DDT relative to the ARC.
+ */
+static void
+bench_dedup(void)
+{
+	static const double marks[] = { 0.5, 1, 2, 5, 10, 20, 50, 100 };
+	uint64_t target = bench_ddt_ratio * bench_arc;
+	uint64_t seed = gethrtime();
+	uint64_t obj, off = 0, mark_off = 0;
+	uint64_t ddt_entries = 0, ddt_bytes = 0;
+	hrtime_t mark_t;
+	char metric[32];
+	dmu_tx_t *tx;
+	char *buf;
+	int m = 0;
+
+	VERIFY0(dsl_prop_set_int(BENCH_POOL,
+	    zfs_prop_to_name(ZFS_PROP_DEDUP), ZPROP_SRC_LOCAL,
+	    ZIO_CHECKSUM_SHA256));
+
+	tx = dmu_tx_create(bench_os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	obj = dmu_object_alloc(bench_os, DMU_OT_UINT64_OTHER,
+	    SPA_MINBLOCKSIZE, DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+
+	buf = umem_alloc(BENCH_CHUNK, UMEM_NOFAIL);
+	mark_t = gethrtime();
+	while (ddt_bytes < target) {
+		bench_fill(buf, BENCH_CHUNK, &seed);
+		tx = dmu_tx_create(bench_os);
+		dmu_tx_hold_write(tx, obj, off, BENCH_CHUNK);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		dmu_write(bench_os, obj, off, BENCH_CHUNK, buf, tx);
+		dmu_tx_commit(tx);
+		off += BENCH_CHUNK;
+
+		if (off % BENCH_DDT_CHECK != 0)
+			continue;
+
+		/* The statistics are those of the last txg synced */
+		ddt_object_t ddo = { 0 };
+		ddt_get_dedup_object_stats(bench_spa, &ddo);
+		ddt_entries = ddo.ddo_count;
+		ddt_bytes = ddo.ddo_count * ddo.ddo_dspace;
+
+		while (m < ARRAY_SIZE(marks) && marks[m] <= bench_ddt_ratio &&
+		    ddt_bytes >= marks[m] * bench_arc) {
+			hrtime_t now = gethrtime();
+
+			(void) snprintf(metric, sizeof (metric),
+			    "write_ddt_%gx_arc", marks[m]);
+			report("dedup", metric,
+			    bench_mbps(off - mark_off, now - mark_t), "MB/s");
+			mark_off = off;
+			mark_t = now;
+			m++;
+		}
+
+		/* Stop short of filling the pool */
+		if (metaslab_class_get_alloc(spa_normal_class(bench_spa)) >
+		    metaslab_class_get_space(spa_normal_class(bench_spa)) /
+		    4 * 3)
+			break;
+	}
+	umem_free(buf, BENCH_CHUNK);
+
+	report("dedup", "ddt_entries", (double)ddt_entries, "entries");
+	report("dedup", "ddt_size", (double)ddt_bytes / (1024 * 1024), "MB");
+	report("dedup", "ddt_arc_ratio", (double)ddt_bytes / bench_arc, "x");
+
+	tx = dmu_tx_create(bench_os);
+	dmu_tx_hold_free(tx, obj, 0, DMU_OBJECT_END);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	VERIFY0(dmu_object_free(bench_os, obj, tx));
+	dmu_tx_commit(tx);
+	VERIFY0(dsl_prop_set_int(BENCH_POOL,
+	    zfs_prop_to_name(ZFS_PROP_DEDUP), ZPROP_SRC_LOCAL,
+	    ZIO_CHECKSUM_OFF));
+	txg_wait_synced(spa_get_dsl(bench_spa), 0);
+}
+
+static bench_scenario_t bench_scenarios[] = {
+	{ "write",	bench_write,	B_TRUE },
+	{ "read",	bench_read,	B_TRUE },
+	{ "txg",	bench_txg,	B_TRUE },
+	{ "zil",	bench_zil,	B_TRUE },
+	{ "fsync",	bench_fsync,	B_TRUE },
+	{ "alloc",	bench_alloc,	B_TRUE },
+	{ "dedup",	bench_dedup,	B_FALSE },
+};
+
+static nvlist_t *
+make_vdev_root(const char *path)
+{
+	nvlist_t *root, *file;
+
+	file = fnvlist_alloc();
+	fnvlist_add_string(file, ZPOOL_CONFIG_TYPE, VDEV_TYPE_FILE);
+	fnvlist_add_string(file, ZPOOL_CONFIG_PATH, path);
+	fnvlist_add_uint64(file, ZPOOL_CONFIG_ASHIFT, SPA_MINBLOCKSHIFT);
+
+	root = fnvlist_alloc();
+	fnvlist_add_string(root, ZPOOL_CONFIG_TYPE, VDEV_TYPE_ROOT);
+	fnvlist_add_nvlist_array(root, ZPOOL_CONFIG_CHILDREN, &file, 1);
+	fnvlist_free(file);
+
+	return (root);
+}
+
+static void
+setup(const char *path)
+{
+	nvlist_t *nvroot;
+	dmu_tx_t *tx;
+	int fd;
+
+	/* The file is sparse; only what is written takes room */
+	if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0 ||
+	    ftruncate(fd, MAX(bench_size * 4, 64ULL << 30)) != 0) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+	(void) close(fd);
+
+	nvroot = make_vdev_root(path);
+	VERIFY0(spa_create(BENCH_POOL, nvroot, NULL, NULL, NULL));
+	nvlist_free(nvroot);
+	VERIFY0(dmu_objset_own(BENCH_POOL, DMU_OST_ANY, B_FALSE, B_TRUE,
+	    FTAG, &bench_os));
+	bench_spa = dmu_objset_spa(bench_os);
+
+	VERIFY0(dsl_prop_set_int(BENCH_POOL,
+	    zfs_prop_to_name(ZFS_PROP_COMPRESSION), ZPROP_SRC_LOCAL,
+	    ZIO_COMPRESS_OFF));
+
+	tx = dmu_tx_create(bench_os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	bench_obj = dmu_object_alloc(bench_os, DMU_OT_UINT64_OTHER,
+	    bench_blksz, DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+	txg_wait_synced(spa_get_dsl(bench_spa), 0);
+}
+
+static void
+teardown(const char *path)
+{
+	dmu_objset_disown(bench_os, B_TRUE, FTAG);
+	VERIFY0(spa_destroy(BENCH_POOL));
+	(void) unlink(path);
+}
+
+static void
+usage(void)
+{
+	(void) fprintf(stderr, "usage: libzpool_bench [-H] [-A arc_mb] "
+	    "[-b blocksize] [-n commits] [-R ddt_ratio]\n"
+	    "\t[-s scenario[,...]] [-S size_mb] [-t threads] <directory>\n"
+	    "scenarios: write, read, txg, zil, fsync, alloc (default); "
+	    "dedup\n");
+	exit(EXIT_FAILURE);
+}
+
+static void
+select_scenarios(char *list)
+{
+	char *name, *last;
+	int i;
+
+	for (name = strtok_r(list, ",", &last); name != NULL;
+	    name = strtok_r(NULL, ",", &last)) {
+		for (i = 0; i < ARRAY_SIZE(bench_scenarios); i++) {
+			if (strcmp(name, bench_scenarios[i].bs_name) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(bench_scenarios)) {
+			(void) fprintf(stderr, "unknown scenario: %s\n", name);
+			usage();
+		}
+		bench_scenarios[i].bs_selected = B_TRUE;
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	char path[MAXPATHLEN];
+	boolean_t selected = B_FALSE;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "A:b:Hn:R:s:S:t:")) != -1) {
+		switch (c) {
+		case 'A':
+			bench_arc = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'b':
+			bench_blksz = atoi(optarg);
+			break;
+		case 'H':
+			bench_scripted = B_TRUE;
+			break;
+		case 'n':
+			bench_commits = atoi(optarg);
+			break;
+		case 'R':
+			bench_ddt_ratio = atoi(optarg);
+			break;
+		case 's':
+			select_scenarios(optarg);
+			selected = B_TRUE;
+			break;
+		case 'S':
+			bench_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 't':
+			bench_nthreads = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1 || !ISP2(bench_blksz) ||
+	    bench_blksz < SPA_MINBLOCKSIZE ||
+	    bench_blksz > SPA_OLD_MAXBLOCKSIZE ||
+	    bench_size < BENCH_CHUNK * bench_nthreads ||
+	    bench_arc <= (64ULL << 20) || bench_commits < bench_nthreads ||
+	    bench_ddt_ratio < 1 || bench_nthreads < 1)
+		usage();
+	if (!selected) {
+		for (i = 0; i < ARRAY_SIZE(bench_scenarios); i++) {
+			bench_scenarios[i].bs_selected =
+			    bench_scenarios[i].bs_default;
+		}
+	}
+	(void) snprintf(path, sizeof (path), "%s/%s.vdev", argv[optind],
+	    BENCH_POOL);
+
+	/* The ARC size has to be set before it is initialized */
+	zfs_arc_max = bench_arc;
+	kernel_init(FREAD | FWRITE);
+	setup(path);
+
+	if (!bench_scripted) {
+		(void) printf("%-8s %-24s %16s %s\n", "SCENARIO", "METRIC",
+		    "VALUE", "UNIT");
+	}
+
+	/* read and txg need the data written by write */
+	if (bench_scenarios[1].bs_selected || bench_scenarios[2].bs_selected)
+		bench_scenarios[0].bs_selected = B_TRUE;
+	for (i = 0; i < ARRAY_SIZE(bench_scenarios); i++) {
+		if (bench_scenarios[i].bs_selected)
+			bench_scenarios[i].bs_func();
+	}
+
+	teardown(path);
+	kernel_fini();
+	return (0);
+}
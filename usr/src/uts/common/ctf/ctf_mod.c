@@ -166,15 +166,23 @@ ctf_modopen(struct module *mp, int *error)
 	if ((fp = ctf_bufopen(&ctfsect, &symsect, &strsect, error)) == NULL)
 		return (NULL);
 
-	if (!ctf_leave_compressed && (caddr_t)fp->ctf_base != mp->ctfdata) {
+	if (!ctf_leave_compressed && (fp->ctf_hflags & CTF_F_COMPRESS)) {
 		/*
-		 * We must have just uncompressed the CTF data.  To avoid
-		 * others having to pay the (substantial) cost of decompressing
-		 * the data, we're going to substitute the uncompressed version
-		 * for the compressed version.  Note that this implies that the
-		 * first CTF consumer will induce memory impact on the system
-		 * (but in the name of performance of future CTF consumers).
+		 * To avoid others having to pay the (substantial) cost of
+		 * decompressing the CTF data, we're going to substitute the
+		 * uncompressed version for the compressed version.  Note that
+		 * this implies that the first CTF consumer will induce memory
+		 * impact on the system (but in the name of performance of
+		 * future CTF consumers).  If the data has a name index,
+		 * ctf_bufopen() will have deferred decompressing it, so we
+		 * must load the container first.
 		 */
+		if (ctf_load(fp) == CTF_ERR) {
+			*error = ctf_errno(fp);
+			ctf_close(fp);
+			return (NULL);
+		}
+
 		kobj_set_ctf(mp, (caddr_t)fp->ctf_base, fp->ctf_size);
 		fp->ctf_data.cts_data = fp->ctf_base;
 		fp->ctf_data.cts_size = fp->ctf_size;
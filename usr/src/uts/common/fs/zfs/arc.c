@@ -326,6 +326,15 @@ static zthr_t		*arc_adjust_zthr;
 static kmutex_t		arc_adjust_lock;
 static kcondvar_t	arc_adjust_waiters_cv;
 static boolean_t	arc_adjust_needed = B_FALSE;
+static uint_t		arc_adjust_waiters = 0;
+
+/*
+ * When arc_adjust() has a lot to evict, arc_evict_state() splits the
+ * sublists of the state among the threads of this taskq, so that the
+ * eviction rate isn't capped by what a single thread can do.
+ */
+static taskq_t		*arc_evict_taskq;
+static int		arc_evict_nthreads;
 
 uint_t arc_reduce_dnlc_percent = 3;
 
@@ -338,6 +347,15 @@ uint_t arc_reduce_dnlc_percent = 3;
  */
 int zfs_arc_evict_batch_limit = 10;
 
+/*
+ * The number of threads that may evict from the ARC in parallel; if zero,
+ * this is a quarter of the CPUs, up to 16.  One thread is added for every
+ * zfs_arc_evict_thread_bytes there is to evict in one go, so eviction
+ * only fans out when the ARC is well over its target.
+ */
+int zfs_arc_evict_threads = 0;
+uint64_t zfs_arc_evict_thread_bytes = 32 << 20;
+
 /* number of seconds before growing cache again */
 int arc_grow_retry = 60;
 
@@ -442,6 +460,12 @@ arc_stats_t arc_stats = {
 	{ "access_skip",		KSTAT_DATA_UINT64 },
 	{ "evict_skip",			KSTAT_DATA_UINT64 },
 	{ "evict_not_enough",		KSTAT_DATA_UINT64 },
+	{ "evict_bytes",		KSTAT_DATA_UINT64 },
+	{ "evict_time",			KSTAT_DATA_UINT64 },
+	{ "evict_parallel",		KSTAT_DATA_UINT64 },
+	{ "evict_tasks",		KSTAT_DATA_UINT64 },
+	{ "evict_waits",		KSTAT_DATA_UINT64 },
+	{ "evict_wait_time",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_cached",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible_mfu",	KSTAT_DATA_UINT64 },
@@ -4027,12 +4051,19 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 			 * If threads are left sleeping, due to not
 			 * using cv_broadcast here, they will be woken
 			 * up via cv_broadcast in arc_adjust_cb() just
-			 * before arc_adjust_zthr sleeps.
+			 * before arc_adjust_zthr sleeps.  The same goes
+			 * for a waiter we miss by checking
+			 * arc_adjust_waiters without the lock, which
+			 * saves the eviction threads from contending on
+			 * arc_adjust_lock for every header when nobody
+			 * is waiting.
 			 */
-			mutex_enter(&arc_adjust_lock);
-			if (!arc_is_overflowing())
-				cv_signal(&arc_adjust_waiters_cv);
-			mutex_exit(&arc_adjust_lock);
+			if (arc_adjust_waiters != 0) {
+				mutex_enter(&arc_adjust_lock);
+				if (!arc_is_overflowing())
+					cv_signal(&arc_adjust_waiters_cv);
+				mutex_exit(&arc_adjust_lock);
+			}
 		} else {
 			ARCSTAT_BUMP(arcstat_mutex_miss);
 		}
@@ -4043,6 +4074,111 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 	return (bytes_evicted);
 }
 
+typedef struct evict_arg {
+	taskq_ent_t	eva_tqent;
+	multilist_t	*eva_ml;
+	arc_buf_hdr_t	**eva_markers;
+	int		eva_idx;
+	int		eva_count;
+	uint64_t	eva_spa;
+	int64_t		eva_bytes;
+	uint64_t	eva_evicted;
+} evict_arg_t;
+
+/*
+ * Evict eva_bytes from the eva_count sublists starting at eva_idx, going
+ * around them as long as we make progress.
+ */
+static void
+arc_evict_task(void *arg)
+{
+	evict_arg_t *eva = arg;
+	int num_sublists = multilist_get_num_sublists(eva->eva_ml);
+	uint64_t scan_evicted;
+
+	do {
+		int idx = eva->eva_idx;
+
+		scan_evicted = 0;
+		for (int i = 0; i < eva->eva_count &&
+		    eva->eva_evicted < eva->eva_bytes; i++) {
+			uint64_t evicted = arc_evict_state_impl(eva->eva_ml,
+			    idx, eva->eva_markers[idx], eva->eva_spa,
+			    eva->eva_bytes - eva->eva_evicted);
+
+			scan_evicted += evicted;
+			eva->eva_evicted += evicted;
+			if (++idx >= num_sublists)
+				idx = 0;
+		}
+	} while (scan_evicted != 0 && eva->eva_evicted < eva->eva_bytes);
+}
+
+/*
+ * The number of threads to evict the given number of bytes from the given
+ * multilist with.
+ */
+static int
+arc_evict_nworkers(multilist_t *ml, int64_t bytes)
+{
+	uint64_t n;
+
+	if (arc_evict_taskq == NULL)
+		return (1);
+
+	n = bytes / MAX(zfs_arc_evict_thread_bytes, 1);
+	n = MIN(n, arc_evict_nthreads);
+	n = MIN(n, multilist_get_num_sublists(ml));
+	return (MAX(n, 1));
+}
+
+/*
+ * Split one scan of the sublists of ml among nworkers tasks, each
+ * evicting its share of bytes from its own range of sublists.  Only
+ * arc_adjust_zthr evicts a given number of bytes (as opposed to
+ * ARC_EVICT_ALL), so we're the only ones using arc_evict_taskq and
+ * taskq_wait() only waits for our own tasks.
+ */
+static uint64_t
+arc_evict_state_parallel(multilist_t *ml, arc_buf_hdr_t **markers,
+    int sublist_idx, uint64_t spa, int64_t bytes, int nworkers)
+{
+	int num_sublists = multilist_get_num_sublists(ml);
+	uint64_t evicted = 0;
+	evict_arg_t *eva;
+
+	ASSERT3S(bytes, >, 0);
+	ASSERT3S(nworkers, >, 1);
+	ASSERT3S(nworkers, <=, num_sublists);
+
+	eva = kmem_zalloc(sizeof (evict_arg_t) * nworkers, KM_SLEEP);
+	for (int w = 0; w < nworkers; w++) {
+		int count = num_sublists / nworkers +
+		    (w < num_sublists % nworkers);
+
+		eva[w].eva_ml = ml;
+		eva[w].eva_markers = markers;
+		eva[w].eva_idx = sublist_idx;
+		eva[w].eva_count = count;
+		eva[w].eva_spa = spa;
+		eva[w].eva_bytes = bytes / nworkers +
+		    (w == 0 ? bytes % nworkers : 0);
+		taskq_dispatch_ent(arc_evict_taskq, arc_evict_task, &eva[w],
+		    0, &eva[w].eva_tqent);
+
+		sublist_idx = (sublist_idx + count) % num_sublists;
+	}
+	taskq_wait(arc_evict_taskq);
+
+	for (int w = 0; w < nworkers; w++)
+		evicted += eva[w].eva_evicted;
+	kmem_free(eva, sizeof (evict_arg_t) * nworkers);
+
+	ARCSTAT_BUMP(arcstat_evict_parallel);
+	ARCSTAT_INCR(arcstat_evict_tasks, nworkers);
+	return (evicted);
+}
+
 /*
  * Evict buffers from the given arc state, until we've removed the
  * specified number of bytes. Move the removed buffers to the
@@ -4106,8 +4242,23 @@ arc_evict_state(arc_state_t *state, uint64_t spa, int64_t bytes,
 		 */
 		int sublist_idx = multilist_get_random_index(ml);
 		uint64_t scan_evicted = 0;
+		int nworkers = 1;
+
+		/*
+		 * If there's enough left to evict, have several threads
+		 * each scan part of the sublists.
+		 */
+		if (bytes != ARC_EVICT_ALL) {
+			nworkers = arc_evict_nworkers(ml,
+			    bytes - total_evicted);
+		}
+		if (nworkers > 1) {
+			scan_evicted = arc_evict_state_parallel(ml, markers,
+			    sublist_idx, spa, bytes - total_evicted, nworkers);
+			total_evicted += scan_evicted;
+		}
 
-		for (int i = 0; i < num_sublists; i++) {
+		for (int i = 0; nworkers == 1 && i < num_sublists; i++) {
 			uint64_t bytes_remaining;
 			uint64_t bytes_evicted;
 
@@ -4755,9 +4906,12 @@ static void
 arc_adjust_cb(void *arg, zthr_t *zthr)
 {
 	uint64_t evicted = 0;
+	hrtime_t start = gethrtime();
 
 	/* Evict from cache */
 	evicted = arc_adjust();
+	ARCSTAT_INCR(arcstat_evict_bytes, evicted);
+	ARCSTAT_INCR(arcstat_evict_time, gethrtime() - start);
 
 	/*
 	 * If evicted is zero, we couldn't evict anything
@@ -5031,10 +5185,17 @@ arc_get_data_impl(arc_buf_hdr_t *hdr, uint64_t size, void *tag,
 		 * shouldn't cause any harm.
 		 */
 		if (arc_is_overflowing()) {
+			hrtime_t start = gethrtime();
+
 			arc_adjust_needed = B_TRUE;
+			arc_adjust_waiters++;
 			zthr_wakeup(arc_adjust_zthr);
 			(void) cv_wait(&arc_adjust_waiters_cv,
 			    &arc_adjust_lock);
+			arc_adjust_waiters--;
+			ARCSTAT_BUMP(arcstat_evict_waits);
+			ARCSTAT_INCR(arcstat_evict_wait_time,
+			    gethrtime() - start);
 		}
 		mutex_exit(&arc_adjust_lock);
 	}
@@ -7214,6 +7375,15 @@ arc_init(void)
 		kstat_install(arc_ksp);
 	}
 
+	arc_evict_nthreads = zfs_arc_evict_threads;
+	if (arc_evict_nthreads <= 0)
+		arc_evict_nthreads = MIN(MAX(boot_ncpus / 4, 1), 16);
+	if (arc_evict_nthreads > 1) {
+		arc_evict_taskq = taskq_create("arc_evict",
+		    arc_evict_nthreads, minclsyspri, arc_evict_nthreads,
+		    arc_evict_nthreads, TASKQ_PREPOPULATE);
+	}
+
 	arc_adjust_zthr = zthr_create(arc_adjust_cb_check,
 	    arc_adjust_cb, NULL);
 	arc_reap_zthr = zthr_create_timer(arc_reap_cb_check,
@@ -7254,6 +7424,11 @@ arc_fini(void)
 	(void) zthr_cancel(arc_adjust_zthr);
 	zthr_destroy(arc_adjust_zthr);
 
+	if (arc_evict_taskq != NULL) {
+		taskq_destroy(arc_evict_taskq);
+		arc_evict_taskq = NULL;
+	}
+
 	(void) zthr_cancel(arc_reap_zthr);
 	zthr_destroy(arc_reap_zthr);
 
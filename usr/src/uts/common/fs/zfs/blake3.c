@@ -0,0 +1,372 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * BLAKE3 tree hashing.
+ *
+ * The input is split into 1 KB chunks, each hashed into a chaining value
+ * (CV), and the CVs are combined pairwise by parent nodes into a binary
+ * tree.  Chunks are independent, so whole subtrees of up to
+ * BLAKE3_MAX_DEGREE chunks are hashed with a single call to the hash_many
+ * method of the selected implementation, which hashes as many of them in
+ * parallel as its SIMD width allows; the parents of a subtree are reduced
+ * the same way.
+ *
+ * A subtree is pushed as the CVs of its two halves, and the CV stack is
+ * merged lazily: a node is only known not to be the root once more input
+ * follows it, and the root has to be compressed with the ROOT flag.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/blake3.h>
+#include <sys/blake3_impl.h>
+
+typedef struct blake3_output {
+	uint32_t	bo_cv[8];
+	uint8_t		bo_block[BLAKE3_BLOCK_LEN];
+	uint64_t	bo_counter;
+	uint8_t		bo_block_len;
+	uint8_t		bo_flags;
+} blake3_output_t;
+
+static void
+blake3_chunk_state_init(blake3_chunk_state_t *cs, const uint32_t key[8],
+    uint64_t counter, uint8_t flags)
+{
+	bcopy(key, cs->cs_cv, sizeof (cs->cs_cv));
+	cs->cs_counter = counter;
+	cs->cs_buf_len = 0;
+	cs->cs_blocks = 0;
+	cs->cs_flags = flags;
+}
+
+static size_t
+blake3_chunk_state_len(const blake3_chunk_state_t *cs)
+{
+	return (BLAKE3_BLOCK_LEN * (size_t)cs->cs_blocks + cs->cs_buf_len);
+}
+
+static uint8_t
+blake3_chunk_state_start_flag(const blake3_chunk_state_t *cs)
+{
+	return (cs->cs_blocks == 0 ? BLAKE3_CHUNK_START : 0);
+}
+
+/*
+ * Add up to the rest of a chunk to the chunk state.  The last block is
+ * always left buffered, since it is compressed with CHUNK_END.
+ */
+static void
+blake3_chunk_state_update(const blake3_impl_ops_t *ops,
+    blake3_chunk_state_t *cs, const uint8_t *input, size_t len)
+{
+	size_t take;
+
+	if (cs->cs_buf_len > 0) {
+		take = MIN(BLAKE3_BLOCK_LEN - cs->cs_buf_len, len);
+		bcopy(input, cs->cs_buf + cs->cs_buf_len, take);
+		cs->cs_buf_len += take;
+		input += take;
+		len -= take;
+		if (len == 0)
+			return;
+
+		ops->compress_in_place(cs->cs_cv, cs->cs_buf, BLAKE3_BLOCK_LEN,
+		    cs->cs_counter,
+		    cs->cs_flags | blake3_chunk_state_start_flag(cs));
+		cs->cs_blocks++;
+		cs->cs_buf_len = 0;
+	}
+
+	while (len > BLAKE3_BLOCK_LEN) {
+		ops->compress_in_place(cs->cs_cv, input, BLAKE3_BLOCK_LEN,
+		    cs->cs_counter,
+		    cs->cs_flags | blake3_chunk_state_start_flag(cs));
+		cs->cs_blocks++;
+		input += BLAKE3_BLOCK_LEN;
+		len -= BLAKE3_BLOCK_LEN;
+	}
+
+	bcopy(input, cs->cs_buf, len);
+	cs->cs_buf_len = len;
+}
+
+static void
+blake3_chunk_state_output(const blake3_chunk_state_t *cs,
+    blake3_output_t *out)
+{
+	bcopy(cs->cs_cv, out->bo_cv, sizeof (out->bo_cv));
+	bcopy(cs->cs_buf, out->bo_block, cs->cs_buf_len);
+	bzero(out->bo_block + cs->cs_buf_len,
+	    BLAKE3_BLOCK_LEN - cs->cs_buf_len);
+	out->bo_counter = cs->cs_counter;
+	out->bo_block_len = cs->cs_buf_len;
+	out->bo_flags = cs->cs_flags | blake3_chunk_state_start_flag(cs) |
+	    BLAKE3_CHUNK_END;
+}
+
+static void
+blake3_parent_output(const uint32_t left[8], const uint32_t right[8],
+    const uint32_t key[8], uint8_t flags, blake3_output_t *out)
+{
+	int i;
+
+	bcopy(key, out->bo_cv, sizeof (out->bo_cv));
+	for (i = 0; i < 8; i++) {
+		blake3_store32(out->bo_block + 4 * i, left[i]);
+		blake3_store32(out->bo_block + 32 + 4 * i, right[i]);
+	}
+	out->bo_counter = 0;
+	out->bo_block_len = BLAKE3_BLOCK_LEN;
+	out->bo_flags = flags | BLAKE3_PARENT;
+}
+
+static void
+blake3_output_cv(const blake3_impl_ops_t *ops, const blake3_output_t *out,
+    uint32_t cv[8])
+{
+	bcopy(out->bo_cv, cv, 8 * sizeof (uint32_t));
+	ops->compress_in_place(cv, out->bo_block, out->bo_block_len,
+	    out->bo_counter, out->bo_flags);
+}
+
+/*
+ * Merge the CV stack down to one entry per complete subtree of the first
+ * total_chunks chunks.
+ */
+static void
+blake3_merge_cv_stack(const blake3_impl_ops_t *ops, BLAKE3_CTX *ctx,
+    uint64_t total_chunks)
+{
+	size_t post_merge_len = 0;
+	blake3_output_t out;
+
+	for (; total_chunks != 0; total_chunks &= total_chunks - 1)
+		post_merge_len++;
+
+	while (ctx->bc_cv_stack_len > post_merge_len) {
+		uint32_t *left = ctx->bc_cv_stack[ctx->bc_cv_stack_len - 2];
+
+		blake3_parent_output(left,
+		    ctx->bc_cv_stack[ctx->bc_cv_stack_len - 1], ctx->bc_key,
+		    ctx->bc_chunk.cs_flags, &out);
+		blake3_output_cv(ops, &out, left);
+		ctx->bc_cv_stack_len--;
+	}
+}
+
+/*
+ * Push the CV of the subtree that starts at chunk counter.
+ */
+static void
+blake3_push_cv(const blake3_impl_ops_t *ops, BLAKE3_CTX *ctx,
+    const uint32_t cv[8], uint64_t counter)
+{
+	blake3_merge_cv_stack(ops, ctx, counter);
+	ASSERT3U(ctx->bc_cv_stack_len, <, BLAKE3_MAX_DEPTH);
+	bcopy(cv, ctx->bc_cv_stack[ctx->bc_cv_stack_len],
+	    sizeof (ctx->bc_cv_stack[0]));
+	ctx->bc_cv_stack_len++;
+}
+
+static void
+blake3_push_cv_bytes(const blake3_impl_ops_t *ops, BLAKE3_CTX *ctx,
+    const uint8_t *bytes, uint64_t counter)
+{
+	uint32_t cv[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		cv[i] = blake3_load32(bytes + 4 * i);
+	blake3_push_cv(ops, ctx, cv, counter);
+}
+
+/*
+ * Hash a power of two number of whole chunks, at least two, and push the
+ * CVs of the two halves of the subtree.
+ */
+static void
+blake3_hash_subtree(const blake3_impl_ops_t *ops, BLAKE3_CTX *ctx,
+    const uint8_t *input, size_t nchunks)
+{
+	const uint8_t *inputs[BLAKE3_MAX_DEGREE];
+	uint8_t cvs[2][BLAKE3_MAX_DEGREE * BLAKE3_OUT_LEN];
+	uint64_t counter = ctx->bc_chunk.cs_counter;
+	uint8_t flags = ctx->bc_chunk.cs_flags;
+	size_t i, n, cur = 0;
+
+	ASSERT(ISP2(nchunks));
+	ASSERT3U(nchunks, >=, 2);
+	ASSERT3U(nchunks, <=, BLAKE3_MAX_DEGREE);
+
+	for (i = 0; i < nchunks; i++)
+		inputs[i] = input + i * BLAKE3_CHUNK_LEN;
+	ops->hash_many(inputs, nchunks, BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN,
+	    ctx->bc_key, counter, B_TRUE, flags, BLAKE3_CHUNK_START,
+	    BLAKE3_CHUNK_END, cvs[cur]);
+
+	/* Reduce pairs of CVs by parent nodes until only two are left */
+	for (n = nchunks / 2; n >= 2; n /= 2) {
+		for (i = 0; i < n; i++)
+			inputs[i] = cvs[cur] + i * 2 * BLAKE3_OUT_LEN;
+		ops->hash_many(inputs, n, 1, ctx->bc_key, 0, B_FALSE,
+		    flags | BLAKE3_PARENT, 0, 0, cvs[cur ^ 1]);
+		cur ^= 1;
+	}
+
+	blake3_push_cv_bytes(ops, ctx, cvs[cur], counter);
+	blake3_push_cv_bytes(ops, ctx, cvs[cur] + BLAKE3_OUT_LEN,
+	    counter + nchunks / 2);
+}
+
+static void
+blake3_init_impl(BLAKE3_CTX *ctx, const uint32_t key[8], uint8_t flags)
+{
+	bcopy(key, ctx->bc_key, sizeof (ctx->bc_key));
+	blake3_chunk_state_init(&ctx->bc_chunk, key, 0, flags);
+	ctx->bc_cv_stack_len = 0;
+}
+
+void
+Blake3_Init(BLAKE3_CTX *ctx)
+{
+	blake3_init_impl(ctx, blake3_iv, 0);
+}
+
+void
+Blake3_InitKeyed(BLAKE3_CTX *ctx, const uint8_t *key)
+{
+	uint32_t key_words[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		key_words[i] = blake3_load32(key + 4 * i);
+	blake3_init_impl(ctx, key_words, BLAKE3_KEYED_HASH);
+}
+
+void
+Blake3_Update(BLAKE3_CTX *ctx, const void *data, size_t len)
+{
+	const blake3_impl_ops_t *ops = blake3_impl_get_ops();
+	blake3_chunk_state_t *cs = &ctx->bc_chunk;
+	const uint8_t *input = data;
+	blake3_output_t out;
+	uint32_t cv[8];
+
+	if (len == 0)
+		return;
+
+	/*
+	 * Finish the chunk in progress.  If more input follows it, it
+	 * cannot be the root and its CV can be pushed.
+	 */
+	if (blake3_chunk_state_len(cs) > 0) {
+		size_t take = MIN(BLAKE3_CHUNK_LEN -
+		    blake3_chunk_state_len(cs), len);
+
+		blake3_chunk_state_update(ops, cs, input, take);
+		input += take;
+		len -= take;
+		if (len == 0)
+			return;
+
+		blake3_chunk_state_output(cs, &out);
+		blake3_output_cv(ops, &out, cv);
+		blake3_push_cv(ops, ctx, cv, cs->cs_counter);
+		blake3_chunk_state_init(cs, ctx->bc_key, cs->cs_counter + 1,
+		    cs->cs_flags);
+	}
+
+	/*
+	 * Hash the largest whole subtrees we can.  A subtree has to be a
+	 * power of two number of chunks and start at a multiple of its size,
+	 * and at least one byte is left for the chunk state, which may be the
+	 * root if this is all the input there is.
+	 */
+	while (len > BLAKE3_CHUNK_LEN) {
+		size_t nchunks = BLAKE3_MAX_DEGREE;
+
+		while (nchunks * BLAKE3_CHUNK_LEN > len ||
+		    (cs->cs_counter & (nchunks - 1)) != 0)
+			nchunks /= 2;
+
+		if (nchunks == 1) {
+			blake3_chunk_state_update(ops, cs, input,
+			    BLAKE3_CHUNK_LEN);
+			blake3_chunk_state_output(cs, &out);
+			blake3_output_cv(ops, &out, cv);
+			blake3_push_cv(ops, ctx, cv, cs->cs_counter);
+		} else {
+			blake3_hash_subtree(ops, ctx, input, nchunks);
+		}
+		blake3_chunk_state_init(cs, ctx->bc_key,
+		    cs->cs_counter + nchunks, cs->cs_flags);
+		input += nchunks * BLAKE3_CHUNK_LEN;
+		len -= nchunks * BLAKE3_CHUNK_LEN;
+	}
+
+	if (len > 0) {
+		blake3_chunk_state_update(ops, cs, input, len);
+		blake3_merge_cv_stack(ops, ctx, cs->cs_counter);
+	}
+}
+
+/*
+ * Compute the 32-byte hash.  The context is not modified, so more input
+ * could still be added to it.
+ */
+void
+Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *digest)
+{
+	const blake3_impl_ops_t *ops = blake3_impl_get_ops();
+	blake3_output_t out;
+	uint32_t cv[8];
+	size_t remaining = 0;
+	int i;
+
+	if (ctx->bc_cv_stack_len == 0) {
+		/* The current chunk is the root */
+		blake3_chunk_state_output(&ctx->bc_chunk, &out);
+	} else if (blake3_chunk_state_len(&ctx->bc_chunk) > 0) {
+		/*
+		 * The stack was merged at the end of the last update, so
+		 * roll the current chunk up through every entry of it.
+		 */
+		remaining = ctx->bc_cv_stack_len;
+		blake3_chunk_state_output(&ctx->bc_chunk, &out);
+	} else {
+		/*
+		 * The update ended on a subtree boundary, so the top two
+		 * entries are the unmerged halves of the last subtree.
+		 */
+		ASSERT3U(ctx->bc_cv_stack_len, >=, 2);
+		remaining = ctx->bc_cv_stack_len - 2;
+		blake3_parent_output(ctx->bc_cv_stack[remaining],
+		    ctx->bc_cv_stack[remaining + 1], ctx->bc_key,
+		    ctx->bc_chunk.cs_flags, &out);
+	}
+
+	if (ctx->bc_cv_stack_len != 0) {
+		while (remaining > 0) {
+			remaining--;
+			blake3_output_cv(ops, &out, cv);
+			blake3_parent_output(ctx->bc_cv_stack[remaining], cv,
+			    ctx->bc_key, ctx->bc_chunk.cs_flags, &out);
+		}
+	}
+
+	/* The first block of root output; counter 0 */
+	bcopy(out.bo_cv, cv, sizeof (cv));
+	ops->compress_in_place(cv, out.bo_block, out.bo_block_len, 0,
+	    out.bo_flags | BLAKE3_ROOT);
+	for (i = 0; i < 8; i++)
+		blake3_store32(digest + 4 * i, cv[i]);
+}
@@ -0,0 +1,43 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * AVX-512 BLAKE3 implementation, hashing 16 chunks at a time.
+ */
+
+#include <sys/isa_defs.h>
+
+#if defined(__amd64)
+
+#define	BLAKE3_SIMD_LANES	16
+#define	BLAKE3_SIMD_TARGET	"avx512f"
+#define	BLAKE3_SIMD_FALLBACK	blake3_avx2_impl
+#define	BLAKE3_SIMD_IMPL	avx512
+
+#include "blake3_simd_impl.h"
+
+static boolean_t
+blake3_avx512_will_work(void)
+{
+	return (kfpu_allowed() && zfs_sse4_1_available() &&
+	    zfs_avx_available() && zfs_avx2_available() &&
+	    zfs_avx512f_available());
+}
+
+const blake3_impl_ops_t blake3_avx512_impl = {
+	.compress_in_place = blake3_generic_compress_in_place,
+	.hash_many = blake3_avx512_hash_many,
+	.is_supported = blake3_avx512_will_work,
+	.degree = BLAKE3_SIMD_LANES,
+	.name = "avx512"
+};
+
+#endif /* defined(__amd64) */
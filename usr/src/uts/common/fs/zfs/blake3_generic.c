@@ -0,0 +1,138 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Portable BLAKE3 compression function.  This is always supported and is
+ * also used by the SIMD implementations for single blocks.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/blake3_impl.h>
+
+const uint32_t blake3_iv[8] = {
+	0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+	0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+const uint8_t blake3_msg_schedule[7][16] = {
+	{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+	{2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+	{3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+	{10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+	{12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+	{9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+	{11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+#define	ROTR32(w, c)	(((w) >> (c)) | ((w) << (32 - (c))))
+
+#define	G(s, a, b, c, d, x, y) {			\
+	s[a] = s[a] + s[b] + (x);			\
+	s[d] = ROTR32(s[d] ^ s[a], 16);			\
+	s[c] = s[c] + s[d];				\
+	s[b] = ROTR32(s[b] ^ s[c], 12);			\
+	s[a] = s[a] + s[b] + (y);			\
+	s[d] = ROTR32(s[d] ^ s[a], 8);			\
+	s[c] = s[c] + s[d];				\
+	s[b] = ROTR32(s[b] ^ s[c], 7);			\
+}
+
+static void
+blake3_round(uint32_t s[16], const uint32_t m[16], size_t r)
+{
+	const uint8_t *sc = blake3_msg_schedule[r];
+
+	/* Mix the columns */
+	G(s, 0, 4, 8, 12, m[sc[0]], m[sc[1]]);
+	G(s, 1, 5, 9, 13, m[sc[2]], m[sc[3]]);
+	G(s, 2, 6, 10, 14, m[sc[4]], m[sc[5]]);
+	G(s, 3, 7, 11, 15, m[sc[6]], m[sc[7]]);
+
+	/* Mix the diagonals */
+	G(s, 0, 5, 10, 15, m[sc[8]], m[sc[9]]);
+	G(s, 1, 6, 11, 12, m[sc[10]], m[sc[11]]);
+	G(s, 2, 7, 8, 13, m[sc[12]], m[sc[13]]);
+	G(s, 3, 4, 9, 14, m[sc[14]], m[sc[15]]);
+}
+
+void
+blake3_generic_compress_in_place(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags)
+{
+	uint32_t m[16], s[16];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		m[i] = blake3_load32(block + 4 * i);
+
+	for (i = 0; i < 8; i++)
+		s[i] = cv[i];
+	s[8] = blake3_iv[0];
+	s[9] = blake3_iv[1];
+	s[10] = blake3_iv[2];
+	s[11] = blake3_iv[3];
+	s[12] = (uint32_t)counter;
+	s[13] = (uint32_t)(counter >> 32);
+	s[14] = block_len;
+	s[15] = flags;
+
+	for (i = 0; i < 7; i++)
+		blake3_round(s, m, i);
+
+	for (i = 0; i < 8; i++)
+		cv[i] = s[i] ^ s[i + 8];
+}
+
+void
+blake3_generic_hash_many(const uint8_t * const *inputs, size_t ninputs,
+    size_t blocks, const uint32_t key[8], uint64_t counter,
+    boolean_t increment, uint8_t flags, uint8_t flags_start,
+    uint8_t flags_end, uint8_t *out)
+{
+	uint32_t cv[8];
+	size_t i, b;
+
+	for (i = 0; i < ninputs; i++) {
+		const uint8_t *input = inputs[i];
+		uint8_t block_flags = flags | flags_start;
+
+		bcopy(key, cv, sizeof (cv));
+		for (b = 0; b < blocks; b++) {
+			if (b + 1 == blocks)
+				block_flags |= flags_end;
+			blake3_generic_compress_in_place(cv, input,
+			    BLAKE3_BLOCK_LEN, counter, block_flags);
+			input += BLAKE3_BLOCK_LEN;
+			block_flags = flags;
+		}
+
+		for (b = 0; b < 8; b++)
+			blake3_store32(out + 4 * b, cv[b]);
+		out += BLAKE3_OUT_LEN;
+		if (increment)
+			counter++;
+	}
+}
+
+static boolean_t
+blake3_generic_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const blake3_impl_ops_t blake3_generic_impl = {
+	.compress_in_place = blake3_generic_compress_in_place,
+	.hash_many = blake3_generic_hash_many,
+	.is_supported = blake3_generic_will_work,
+	.degree = 1,
+	.name = "generic"
+};
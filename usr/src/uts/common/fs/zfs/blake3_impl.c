@@ -0,0 +1,250 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+/*
+ * Selection of the BLAKE3 implementation, in the same way as for the
+ * raidz parity math: all supported implementations are benchmarked when
+ * the module is loaded and the fastest is used, unless another one is
+ * selected with blake3_impl_set().
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/blake3.h>
+#include <sys/blake3_impl.h>
+#include <sys/simd.h>
+
+#ifndef isspace
+#define	isspace(c)	((c) == ' ' || (c) == '\t' || (c) == '\n' || \
+			(c) == '\r' || (c) == '\f' || (c) == '\013')
+#endif
+
+/* All compiled in implementations, from the slowest to the fastest */
+static const blake3_impl_ops_t *blake3_all_impls[] = {
+	&blake3_generic_impl,
+#if defined(__amd64)
+	&blake3_sse41_impl,
+	&blake3_avx2_impl,
+	&blake3_avx512_impl,
+#endif
+};
+
+/* Indicate that benchmark has been completed */
+static boolean_t blake3_impl_initialized = B_FALSE;
+
+/* Select BLAKE3 implementation */
+#define	IMPL_FASTEST	(UINT32_MAX)
+#define	IMPL_CYCLE	(UINT32_MAX - 1)
+
+#define	BLAKE3_IMPL_READ(i)	(*(volatile uint32_t *) &(i))
+
+static uint32_t zfs_blake3_impl = IMPL_FASTEST;
+static uint32_t user_sel_impl = IMPL_FASTEST;
+
+/* Hold all supported implementations */
+static size_t blake3_supp_impl_cnt = 0;
+static const blake3_impl_ops_t *blake3_supp_impl[ARRAY_SIZE(blake3_all_impls)];
+static const blake3_impl_ops_t *blake3_fastest_impl = &blake3_generic_impl;
+
+#if defined(_KERNEL)
+/*
+ * Throughput of each supported implementation in B/s, as measured by the
+ * benchmark.  Like the raidz math statistics this is not a kstat; it can
+ * be inspected with mdb.
+ */
+static uint64_t blake3_impl_speed[ARRAY_SIZE(blake3_all_impls)];
+#endif
+
+/*
+ * Returns the implementation to use.  When SIMD is not allowed in the
+ * current context, fall back to the generic implementation.
+ */
+const blake3_impl_ops_t *
+blake3_impl_get_ops(void)
+{
+	const blake3_impl_ops_t *ops = &blake3_generic_impl;
+	const uint32_t impl = BLAKE3_IMPL_READ(zfs_blake3_impl);
+
+	if (!kfpu_allowed() || !blake3_impl_initialized)
+		return (&blake3_generic_impl);
+
+	switch (impl) {
+	case IMPL_FASTEST:
+		ops = blake3_fastest_impl;
+		break;
+	case IMPL_CYCLE: {
+		/* Cycle through all supported implementations */
+		static size_t cycle_impl_idx = 0;
+		size_t idx = (++cycle_impl_idx) % blake3_supp_impl_cnt;
+		ops = blake3_supp_impl[idx];
+		break;
+	}
+	default:
+		ASSERT3U(impl, <, blake3_supp_impl_cnt);
+		if (impl < blake3_supp_impl_cnt)
+			ops = blake3_supp_impl[impl];
+		break;
+	}
+
+	return (ops);
+}
+
+const char *
+blake3_impl_name(void)
+{
+	return (blake3_impl_get_ops()->name);
+}
+
+#if defined(_KERNEL)
+
+#define	BENCH_SIZE	(1ULL << SPA_OLD_MAXBLOCKSHIFT)	/* 128 kiB */
+#define	BENCH_NS	MSEC2NSEC(10)			/* 10ms */
+
+static void
+benchmark_blake3(void)
+{
+	BLAKE3_CTX *ctx;
+	uint8_t digest[BLAKE3_OUT_LEN];
+	uint64_t run_cnt, speed, best_speed = 0;
+	hrtime_t t_start, t_diff;
+	uint8_t *buf;
+	size_t i;
+
+	ctx = kmem_alloc(sizeof (*ctx), KM_SLEEP);
+	buf = kmem_alloc(BENCH_SIZE, KM_SLEEP);
+	for (i = 0; i < BENCH_SIZE; i++)
+		buf[i] = (uint8_t)(i % 251);
+
+	for (i = 0; i < blake3_supp_impl_cnt; i++) {
+		/* set an implementation to benchmark */
+		atomic_swap_32(&zfs_blake3_impl, i);
+
+		run_cnt = 0;
+		t_start = gethrtime();
+		do {
+			Blake3_Init(ctx);
+			Blake3_Update(ctx, buf, BENCH_SIZE);
+			Blake3_Final(ctx, digest);
+			run_cnt++;
+			t_diff = gethrtime() - t_start;
+		} while (t_diff < BENCH_NS);
+
+		speed = run_cnt * BENCH_SIZE * NANOSEC / t_diff;
+		blake3_impl_speed[i] = speed;
+
+		/* Update fastest implementation method */
+		if (speed > best_speed) {
+			best_speed = speed;
+			blake3_fastest_impl = blake3_supp_impl[i];
+		}
+	}
+
+	kmem_free(buf, BENCH_SIZE);
+	kmem_free(ctx, sizeof (*ctx));
+}
+#endif
+
+void
+blake3_impl_init(void)
+{
+	const blake3_impl_ops_t *curr_impl;
+	size_t i, c;
+
+	/* Move supported impl into blake3_supp_impl */
+	for (i = 0, c = 0; i < ARRAY_SIZE(blake3_all_impls); i++) {
+		curr_impl = blake3_all_impls[i];
+		if (curr_impl->is_supported())
+			blake3_supp_impl[c++] = curr_impl;
+	}
+	membar_producer();		/* complete blake3_supp_impl[] init */
+	blake3_supp_impl_cnt = c;	/* number of supported impl */
+	blake3_impl_initialized = B_TRUE;
+
+#if defined(_KERNEL)
+	/* Determine the fastest available implementation. */
+	benchmark_blake3();
+#else
+	/*
+	 * Skip the benchmark in user space to avoid impacting libzpool
+	 * consumers (zdb, zhack, zinject, ztest).  The last implementation
+	 * is assumed to be the fastest and used by default.
+	 */
+	blake3_fastest_impl = blake3_supp_impl[blake3_supp_impl_cnt - 1];
+#endif
+
+	/* Finish initialization */
+	atomic_swap_32(&zfs_blake3_impl, user_sel_impl);
+}
+
+static const struct {
+	char *name;
+	uint32_t sel;
+} blake3_impl_opts[] = {
+		{ "cycle",	IMPL_CYCLE },
+		{ "fastest",	IMPL_FASTEST },
+};
+
+/*
+ * Function sets desired BLAKE3 implementation.
+ *
+ * If we are called before init(), user preference will be saved in
+ * user_sel_impl, and applied in later init() call.  Otherwise, directly
+ * update zfs_blake3_impl.
+ *
+ * @val		Name of BLAKE3 implementation to use
+ */
+int
+blake3_impl_set(const char *val)
+{
+	int err = EINVAL;
+	char req_name[BLAKE3_IMPL_NAME_MAX];
+	uint32_t impl = BLAKE3_IMPL_READ(user_sel_impl);
+	size_t i;
+
+	/* sanitize input */
+	i = strnlen(val, BLAKE3_IMPL_NAME_MAX);
+	if (i == 0 || i == BLAKE3_IMPL_NAME_MAX)
+		return (err);
+
+	(void) strlcpy(req_name, val, BLAKE3_IMPL_NAME_MAX);
+	while (i > 0 && !!isspace(req_name[i-1]))
+		i--;
+	req_name[i] = '\0';
+
+	/* Check mandatory options */
+	for (i = 0; i < ARRAY_SIZE(blake3_impl_opts); i++) {
+		if (strcmp(req_name, blake3_impl_opts[i].name) == 0) {
+			impl = blake3_impl_opts[i].sel;
+			err = 0;
+			break;
+		}
+	}
+
+	/* check all supported impl if init() was already called */
+	if (err != 0 && blake3_impl_initialized) {
+		for (i = 0; i < blake3_supp_impl_cnt; i++) {
+			if (strcmp(req_name, blake3_supp_impl[i]->name) == 0) {
+				impl = i;
+				err = 0;
+				break;
+			}
+		}
+	}
+
+	if (err == 0) {
+		if (blake3_impl_initialized)
+			atomic_swap_32(&zfs_blake3_impl, impl);
+		else
+			atomic_swap_32(&user_sel_impl, impl);
+	}
+
+	return (err);
+}
@@ -0,0 +1,179 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef _BLAKE3_SIMD_IMPL_H
+#define	_BLAKE3_SIMD_IMPL_H
+
+/*
+ * Template for the SIMD BLAKE3 implementations.  Each lane of a vector
+ * holds one word of the state of a different input, so BLAKE3_SIMD_LANES
+ * inputs are compressed at once with exactly the instruction sequence of
+ * the scalar code; the only shuffling is the transposition of the message
+ * words on the way in and of the chaining values on the way out.
+ *
+ * The including file defines:
+ *	BLAKE3_SIMD_LANES	number of 32-bit lanes in a vector
+ *	BLAKE3_SIMD_TARGET	ISA for the target attribute, e.g. "avx2"
+ *	BLAKE3_SIMD_IMPL	name prefix, e.g. avx2
+ *	BLAKE3_SIMD_FALLBACK	optionally, the narrower implementation used
+ *				for the inputs left over after the last full
+ *				group of lanes
+ *
+ * and gets blake3_<impl>_hash_many().  The code is written with the GCC
+ * vector extensions, so the compiler picks the instructions for the target
+ * ISA; the function attribute confines them to the code between
+ * kfpu_begin() and kfpu_end().
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/blake3_impl.h>
+#include <sys/simd.h>
+
+#define	_B3_CAT(a, b)		a##b
+#define	B3_CAT(a, b)		_B3_CAT(a, b)
+#define	B3_FN(fn)		B3_CAT(B3_CAT(blake3_, BLAKE3_SIMD_IMPL), fn)
+
+#define	B3_TARGET	__attribute__((target(BLAKE3_SIMD_TARGET)))
+
+typedef uint32_t b3v_t __attribute__((vector_size(4 * BLAKE3_SIMD_LANES),
+    aligned(4 * BLAKE3_SIMD_LANES)));
+
+/* Words of 16 vectors, to transpose through memory */
+typedef union b3_xpose {
+	b3v_t		v[16];
+	uint32_t	w[16][BLAKE3_SIMD_LANES];
+} b3_xpose_t;
+
+#define	B3_ROTR(w, c)	(((w) >> (c)) | ((w) << (32 - (c))))
+
+#define	B3_G(a, b, c, d, x, y) {				\
+	v[a] = v[a] + v[b] + (x);				\
+	v[d] = B3_ROTR(v[d] ^ v[a], 16);			\
+	v[c] = v[c] + v[d];					\
+	v[b] = B3_ROTR(v[b] ^ v[c], 12);			\
+	v[a] = v[a] + v[b] + (y);				\
+	v[d] = B3_ROTR(v[d] ^ v[a], 8);				\
+	v[c] = v[c] + v[d];					\
+	v[b] = B3_ROTR(v[b] ^ v[c], 7);				\
+}
+
+#define	B3_ROUND(r) {						\
+	const uint8_t *sc = blake3_msg_schedule[r];		\
+	B3_G(0, 4, 8, 12, m[sc[0]], m[sc[1]]);			\
+	B3_G(1, 5, 9, 13, m[sc[2]], m[sc[3]]);			\
+	B3_G(2, 6, 10, 14, m[sc[4]], m[sc[5]]);			\
+	B3_G(3, 7, 11, 15, m[sc[6]], m[sc[7]]);			\
+	B3_G(0, 5, 10, 15, m[sc[8]], m[sc[9]]);			\
+	B3_G(1, 6, 11, 12, m[sc[10]], m[sc[11]]);		\
+	B3_G(2, 7, 8, 13, m[sc[12]], m[sc[13]]);		\
+	B3_G(3, 4, 9, 14, m[sc[14]], m[sc[15]]);		\
+}
+
+/*
+ * Hash BLAKE3_SIMD_LANES inputs of the given number of blocks in parallel.
+ */
+static B3_TARGET void
+B3_FN(_hash_lanes)(const uint8_t * const *inputs, size_t blocks,
+    const uint32_t key[8], uint64_t counter, boolean_t increment,
+    uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t *out)
+{
+	b3_xpose_t t;
+	b3v_t h[8], v[16], m[16], ctr_lo, ctr_hi, zero = { 0 };
+	uint8_t block_flags = flags | flags_start;
+	size_t i, l, b;
+
+	for (i = 0; i < 8; i++)
+		h[i] = zero + key[i];
+	for (l = 0; l < BLAKE3_SIMD_LANES; l++) {
+		uint64_t c = counter + (increment ? l : 0);
+
+		t.w[0][l] = (uint32_t)c;
+		t.w[1][l] = (uint32_t)(c >> 32);
+	}
+	ctr_lo = t.v[0];
+	ctr_hi = t.v[1];
+
+	for (b = 0; b < blocks; b++) {
+		if (b + 1 == blocks)
+			block_flags |= flags_end;
+
+		/* Transpose the message words of this block */
+		for (l = 0; l < BLAKE3_SIMD_LANES; l++) {
+			const uint8_t *p = inputs[l] + b * BLAKE3_BLOCK_LEN;
+
+			for (i = 0; i < 16; i++)
+				t.w[i][l] = blake3_load32(p + 4 * i);
+		}
+		for (i = 0; i < 16; i++)
+			m[i] = t.v[i];
+
+		for (i = 0; i < 8; i++)
+			v[i] = h[i];
+		for (i = 0; i < 4; i++)
+			v[i + 8] = zero + blake3_iv[i];
+		v[12] = ctr_lo;
+		v[13] = ctr_hi;
+		v[14] = zero + BLAKE3_BLOCK_LEN;
+		v[15] = zero + block_flags;
+
+		B3_ROUND(0);
+		B3_ROUND(1);
+		B3_ROUND(2);
+		B3_ROUND(3);
+		B3_ROUND(4);
+		B3_ROUND(5);
+		B3_ROUND(6);
+
+		for (i = 0; i < 8; i++)
+			h[i] = v[i] ^ v[i + 8];
+		block_flags = flags;
+	}
+
+	/* Transpose the chaining values back */
+	for (i = 0; i < 8; i++)
+		t.v[i] = h[i];
+	for (l = 0; l < BLAKE3_SIMD_LANES; l++) {
+		for (i = 0; i < 8; i++)
+			blake3_store32(out + l * BLAKE3_OUT_LEN + 4 * i,
+			    t.w[i][l]);
+	}
+}
+
+static void
+B3_FN(_hash_many)(const uint8_t * const *inputs, size_t ninputs,
+    size_t blocks, const uint32_t key[8], uint64_t counter,
+    boolean_t increment, uint8_t flags, uint8_t flags_start,
+    uint8_t flags_end, uint8_t *out)
+{
+	if (ninputs >= BLAKE3_SIMD_LANES) {
+		kfpu_begin();
+		while (ninputs >= BLAKE3_SIMD_LANES) {
+			B3_FN(_hash_lanes)(inputs, blocks, key, counter,
+			    increment, flags, flags_start, flags_end, out);
+			if (increment)
+				counter += BLAKE3_SIMD_LANES;
+			inputs += BLAKE3_SIMD_LANES;
+			ninputs -= BLAKE3_SIMD_LANES;
+			out += BLAKE3_SIMD_LANES * BLAKE3_OUT_LEN;
+		}
+		kfpu_end();
+	}
+
+#if defined(BLAKE3_SIMD_FALLBACK)
+	BLAKE3_SIMD_FALLBACK.hash_many(inputs, ninputs, blocks, key, counter,
+	    increment, flags, flags_start, flags_end, out);
+#else
+	blake3_generic_hash_many(inputs, ninputs, blocks, key, counter,
+	    increment, flags, flags_start, flags_end, out);
+#endif
+}
+
+#endif /* _BLAKE3_SIMD_IMPL_H */
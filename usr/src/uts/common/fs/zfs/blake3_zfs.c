@@ -0,0 +1,119 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/zio.h>
+#include <sys/blake3.h>
+#include <sys/blake3_impl.h>
+#include <sys/abd.h>
+
+/*
+ * The chunks of a scattered ABD are a page each, which would limit the
+ * hasher to four BLAKE3 chunks at a time.  Their data is copied into a
+ * bounce buffer instead, so that the wider implementations get whole
+ * subtrees; the copy costs much less than the hashing it speeds up.
+ */
+#define	BLAKE3_BOUNCE_LEN	(BLAKE3_MAX_DEGREE * BLAKE3_CHUNK_LEN)
+
+typedef struct blake3_zfs_ctx {
+	BLAKE3_CTX	bz_ctx;
+	uint8_t		bz_bounce[BLAKE3_BOUNCE_LEN];
+} blake3_zfs_ctx_t;
+
+static int
+blake3_incremental(void *buf, size_t size, void *arg)
+{
+	BLAKE3_CTX *ctx = arg;
+	Blake3_Update(ctx, buf, size);
+	return (0);
+}
+
+/*
+ * Computes a native 256-bit BLAKE3 MAC checksum, keyed with the pool's
+ * checksum salt.  The ctx_template must have been allocated using
+ * abd_checksum_blake3_tmpl_init.  The context is too large for the stack
+ * of the zio threads, so it is allocated.
+ */
+/*ARGSUSED*/
+void
+abd_checksum_blake3_native(abd_t *abd, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	blake3_zfs_ctx_t	*bz;
+	BLAKE3_CTX		*ctx;
+
+	ASSERT(ctx_template != NULL);
+	if (abd_is_linear(abd)) {
+		ctx = kmem_alloc(sizeof (*ctx), KM_SLEEP);
+		bcopy(ctx_template, ctx, sizeof (*ctx));
+		(void) abd_iterate_func(abd, 0, size, blake3_incremental, ctx);
+		Blake3_Final(ctx, (uint8_t *)zcp);
+		bzero(ctx, sizeof (*ctx));
+		kmem_free(ctx, sizeof (*ctx));
+		return;
+	}
+
+	bz = kmem_alloc(sizeof (*bz), KM_SLEEP);
+	bcopy(ctx_template, &bz->bz_ctx, sizeof (bz->bz_ctx));
+	for (uint64_t off = 0; off < size; off += BLAKE3_BOUNCE_LEN) {
+		size_t len = MIN(size - off, BLAKE3_BOUNCE_LEN);
+
+		abd_copy_to_buf_off(bz->bz_bounce, abd, off, len);
+		Blake3_Update(&bz->bz_ctx, bz->bz_bounce, len);
+	}
+	Blake3_Final(&bz->bz_ctx, (uint8_t *)zcp);
+	bzero(&bz->bz_ctx, sizeof (bz->bz_ctx));
+	kmem_free(bz, sizeof (*bz));
+}
+
+/*
+ * Byteswapped version of abd_checksum_blake3_native.  BLAKE3 produces a
+ * byte string, so this just byteswaps the words of the native checksum.
+ */
+void
+abd_checksum_blake3_byteswap(abd_t *abd, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp)
+{
+	zio_cksum_t	tmp;
+
+	abd_checksum_blake3_native(abd, size, ctx_template, &tmp);
+	zcp->zc_word[0] = BSWAP_64(tmp.zc_word[0]);
+	zcp->zc_word[1] = BSWAP_64(tmp.zc_word[1]);
+	zcp->zc_word[2] = BSWAP_64(tmp.zc_word[2]);
+	zcp->zc_word[3] = BSWAP_64(tmp.zc_word[3]);
+}
+
+/*
+ * Allocates a keyed BLAKE3 context template for the given salt.
+ */
+void *
+abd_checksum_blake3_tmpl_init(const zio_cksum_salt_t *salt)
+{
+	BLAKE3_CTX	*ctx;
+
+	CTASSERT(sizeof (salt->zcs_bytes) == BLAKE3_KEY_LEN);
+	ctx = kmem_zalloc(sizeof (*ctx), KM_SLEEP);
+	Blake3_InitKeyed(ctx, salt->zcs_bytes);
+	return (ctx);
+}
+
+/*
+ * Frees a BLAKE3 context template previously allocated using
+ * abd_checksum_blake3_tmpl_init.
+ */
+void
+abd_checksum_blake3_tmpl_free(void *ctx_template)
+{
+	BLAKE3_CTX	*ctx = ctx_template;
+
+	bzero(ctx, sizeof (*ctx));
+	kmem_free(ctx, sizeof (*ctx));
+}
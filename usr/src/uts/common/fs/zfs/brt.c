@@ -0,0 +1,852 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/zio.h>
+#include <sys/brt.h>
+#include <sys/ddt.h>
+#include <sys/zap.h>
+#include <sys/dmu_tx.h>
+#include <sys/dsl_pool.h>
+#include <sys/vdev_impl.h>
+#include <sys/zfeature.h>
+
+/*
+ * Block Reference Table (BRT)
+ *
+ * Block cloning lets a file refer to data blocks that are already owned by
+ * another file, or by another range of the same file, without copying
+ * them.  A cloned block pointer is identical to the original except for its
+ * logical birth, which is set to the txg of the clone; its physical birth
+ * still names the txg in which the data was written.  Because the logical
+ * birth is new, snapshots, deadlists and dataset destruction all treat the
+ * clone exactly like a freshly written block, and every path that stops
+ * referencing it ends up in zio_free().
+ *
+ * The BRT records how many extra references exist for every block that has
+ * been cloned.  It is keyed by the first DVA of the block.  When a block
+ * with a BRT entry is freed, zio_brt_free() drops one reference instead of
+ * freeing the DVAs; the space is released only once no entry remains.
+ * Dedup blocks are cloned by taking another DDT reference instead.
+ *
+ * On disk, each top-level vdev that holds cloned blocks has a ZAP mapping
+ * DVA offset to reference count, and an array of 16-bit counters giving
+ * the number of entries in each BRT_RANGESIZE region of the vdev.  The
+ * counters are kept in core so that brt_maybe_exists(), which is consulted
+ * for every free, can rule out almost every block without reading the
+ * ZAP.  A counter that reaches UINT16_MAX stays there.
+ *
+ * Clones are recorded from open context in a per-txg pending tree.
+ * brt_pending_apply() folds them into the table at the start of spa_sync(),
+ * before any free of that txg is processed, and brt_sync() writes the
+ * modified entries out.  A clone that is overwritten within the txg it was
+ * made in is taken out of the pending tree again (see dbuf_unoverride()).
+ */
+
+typedef struct brt_entry {
+	uint64_t	bre_offset;
+	uint64_t	bre_refcount;
+	boolean_t	bre_ondisk;	/* present in the vdev's ZAP */
+	avl_node_t	bre_node;
+} brt_entry_t;
+
+typedef struct brt_pending_entry {
+	blkptr_t	bpe_bp;
+	uint64_t	bpe_count;
+	avl_node_t	bpe_node;
+} brt_pending_entry_t;
+
+typedef struct brt_vdev {
+	uint64_t	bv_vdevid;
+	uint64_t	bv_mos_brtvdev;	/* entry counts, 0 if not created */
+	uint64_t	bv_mos_entries;	/* entry ZAP, 0 if not created */
+	uint16_t	*bv_entcount;	/* entries per region */
+	uint64_t	bv_size;	/* number of regions */
+	uint64_t	bv_totalcount;
+	uint64_t	bv_usedspace;
+	uint64_t	bv_savedspace;
+	uint64_t	bv_gen;		/* bumped whenever bv_tree is synced */
+	uint64_t	bv_dirty_min;	/* dirty range of bv_entcount */
+	uint64_t	bv_dirty_max;
+	boolean_t	bv_dirty;
+	avl_tree_t	bv_tree;	/* entries changed in this txg */
+} brt_vdev_t;
+
+struct brt {
+	spa_t		*brt_spa;
+	krwlock_t	brt_lock;
+	uint64_t	brt_rangesize;
+	uint64_t	brt_nvdevs;
+	brt_vdev_t	**brt_vdevs;
+	kmutex_t	brt_pending_lock[TXG_SIZE];
+	avl_tree_t	brt_pending_tree[TXG_SIZE];
+};
+
+int brt_zap_leaf_blockshift = 12;
+int brt_zap_indirect_blockshift = 12;
+
+static kmem_cache_t *brt_entry_cache;
+static kmem_cache_t *brt_pending_entry_cache;
+
+static int
+brt_entry_compare(const void *x1, const void *x2)
+{
+	const brt_entry_t *bre1 = x1;
+	const brt_entry_t *bre2 = x2;
+
+	return (TREE_CMP(bre1->bre_offset, bre2->bre_offset));
+}
+
+static int
+brt_pending_entry_compare(const void *x1, const void *x2)
+{
+	const brt_pending_entry_t *bpe1 = x1;
+	const brt_pending_entry_t *bpe2 = x2;
+	const dva_t *dva1 = &bpe1->bpe_bp.blk_dva[0];
+	const dva_t *dva2 = &bpe2->bpe_bp.blk_dva[0];
+
+	int cmp = TREE_CMP(DVA_GET_VDEV(dva1), DVA_GET_VDEV(dva2));
+	if (cmp == 0)
+		cmp = TREE_CMP(DVA_GET_OFFSET(dva1), DVA_GET_OFFSET(dva2));
+
+	return (cmp);
+}
+
+static void
+brt_vdev_name(uint64_t vdevid, char *buf, size_t len)
+{
+	(void) snprintf(buf, len, "%s%llu", DMU_POOL_BRT_VDEV_PREFIX,
+	    (u_longlong_t)vdevid);
+}
+
+/*
+ * Return the in-core state of the given top-level vdev, creating it if
+ * "alloc" is set.  The caller must hold brt_lock, as writer if allocating.
+ */
+static brt_vdev_t *
+brt_vdev(brt_t *brt, uint64_t vdevid, boolean_t alloc)
+{
+	ASSERT(RW_LOCK_HELD(&brt->brt_lock));
+
+	if (vdevid >= brt->brt_nvdevs) {
+		if (!alloc)
+			return (NULL);
+
+		ASSERT(RW_WRITE_HELD(&brt->brt_lock));
+		uint64_t nvdevs = vdevid + 1;
+		brt_vdev_t **vdevs = kmem_zalloc(nvdevs * sizeof (*vdevs),
+		    KM_SLEEP);
+		if (brt->brt_nvdevs != 0) {
+			bcopy(brt->brt_vdevs, vdevs,
+			    brt->brt_nvdevs * sizeof (*vdevs));
+			kmem_free(brt->brt_vdevs,
+			    brt->brt_nvdevs * sizeof (*vdevs));
+		}
+		brt->brt_vdevs = vdevs;
+		brt->brt_nvdevs = nvdevs;
+	}
+
+	brt_vdev_t *bv = brt->brt_vdevs[vdevid];
+	if (bv == NULL && alloc) {
+		ASSERT(RW_WRITE_HELD(&brt->brt_lock));
+		bv = kmem_zalloc(sizeof (*bv), KM_SLEEP);
+		bv->bv_vdevid = vdevid;
+		bv->bv_dirty_min = UINT64_MAX;
+		avl_create(&bv->bv_tree, brt_entry_compare,
+		    sizeof (brt_entry_t), offsetof(brt_entry_t, bre_node));
+		brt->brt_vdevs[vdevid] = bv;
+	}
+
+	return (bv);
+}
+
+static void
+brt_vdev_realloc(brt_vdev_t *bv, uint64_t size)
+{
+	uint16_t *entcount;
+
+	if (size <= bv->bv_size)
+		return;
+
+	entcount = kmem_zalloc(size * sizeof (uint16_t), KM_SLEEP);
+	if (bv->bv_entcount != NULL) {
+		bcopy(bv->bv_entcount, entcount,
+		    bv->bv_size * sizeof (uint16_t));
+		kmem_free(bv->bv_entcount, bv->bv_size * sizeof (uint16_t));
+	}
+	bv->bv_entcount = entcount;
+	bv->bv_size = size;
+}
+
+static void
+brt_vdev_entcount_dirty(brt_vdev_t *bv, uint64_t idx)
+{
+	bv->bv_dirty_min = MIN(bv->bv_dirty_min, idx);
+	bv->bv_dirty_max = MAX(bv->bv_dirty_max, idx);
+	bv->bv_dirty = B_TRUE;
+}
+
+static void
+brt_vdev_entcount_inc(brt_t *brt, brt_vdev_t *bv, uint64_t offset)
+{
+	uint64_t idx = offset / brt->brt_rangesize;
+
+	if (idx >= bv->bv_size) {
+		vdev_t *vd = vdev_lookup_top(brt->brt_spa, bv->bv_vdevid);
+		uint64_t size = (vd != NULL) ?
+		    howmany(vd->vdev_asize, brt->brt_rangesize) : 0;
+		brt_vdev_realloc(bv, MAX(idx + 1, size));
+	}
+
+	if (bv->bv_entcount[idx] < UINT16_MAX)
+		bv->bv_entcount[idx]++;
+	brt_vdev_entcount_dirty(bv, idx);
+}
+
+static void
+brt_vdev_entcount_dec(brt_t *brt, brt_vdev_t *bv, uint64_t offset)
+{
+	uint64_t idx = offset / brt->brt_rangesize;
+
+	ASSERT3U(idx, <, bv->bv_size);
+	ASSERT3U(bv->bv_entcount[idx], >, 0);
+
+	if (bv->bv_entcount[idx] < UINT16_MAX)
+		bv->bv_entcount[idx]--;
+	brt_vdev_entcount_dirty(bv, idx);
+}
+
+static boolean_t
+brt_vdev_region_used(brt_t *brt, brt_vdev_t *bv, uint64_t offset)
+{
+	uint64_t idx = offset / brt->brt_rangesize;
+
+	return (idx < bv->bv_size && bv->bv_entcount[idx] != 0);
+}
+
+/*
+ * Find the entry for the block at the given offset, reading it from the
+ * vdev's ZAP if it is not in core yet.  If there is no entry and "create"
+ * is set, a new one with a zero refcount is added.  Called and returns with
+ * brt_lock held as writer, but drops it while reading the ZAP.
+ */
+static brt_entry_t *
+brt_entry_hold(brt_t *brt, brt_vdev_t *bv, uint64_t offset, boolean_t create)
+{
+	objset_t *mos = spa_meta_objset(brt->brt_spa);
+	brt_entry_t search, *bre;
+	avl_index_t where;
+	uint64_t refcount = 0;
+	int error;
+
+	ASSERT(RW_WRITE_HELD(&brt->brt_lock));
+
+	search.bre_offset = offset;
+again:
+	bre = avl_find(&bv->bv_tree, &search, &where);
+	if (bre != NULL)
+		return (bre);
+
+	error = ENOENT;
+	if (bv->bv_mos_entries != 0 && brt_vdev_region_used(brt, bv, offset)) {
+		uint64_t mos_entries = bv->bv_mos_entries;
+		uint64_t gen = bv->bv_gen;
+
+		rw_exit(&brt->brt_lock);
+		error = zap_lookup_uint64(mos, mos_entries, &offset, 1,
+		    sizeof (uint64_t), 1, &refcount);
+		rw_enter(&brt->brt_lock, RW_WRITER);
+		VERIFY(error == 0 || error == ENOENT);
+
+		/*
+		 * If the table was synced while we were looking, what we
+		 * read may already be stale.
+		 */
+		if (bv->bv_gen != gen)
+			goto again;
+
+		bre = avl_find(&bv->bv_tree, &search, &where);
+		if (bre != NULL)
+			return (bre);
+	}
+
+	if (error == ENOENT && !create)
+		return (NULL);
+
+	bre = kmem_cache_alloc(brt_entry_cache, KM_SLEEP);
+	bre->bre_offset = offset;
+	bre->bre_refcount = (error == 0) ? refcount : 0;
+	bre->bre_ondisk = (error == 0);
+	avl_insert(&bv->bv_tree, bre, where);
+
+	return (bre);
+}
+
+static void
+brt_entry_addref(brt_t *brt, const blkptr_t *bp)
+{
+	uint64_t vdevid = DVA_GET_VDEV(&bp->blk_dva[0]);
+	uint64_t offset = DVA_GET_OFFSET(&bp->blk_dva[0]);
+	uint64_t dsize = bp_get_dsize_sync(brt->brt_spa, bp);
+	brt_vdev_t *bv;
+	brt_entry_t *bre;
+
+	rw_enter(&brt->brt_lock, RW_WRITER);
+	bv = brt_vdev(brt, vdevid, B_TRUE);
+	bre = brt_entry_hold(brt, bv, offset, B_TRUE);
+	if (bre->bre_refcount++ == 0) {
+		brt_vdev_entcount_inc(brt, bv, offset);
+		bv->bv_usedspace += dsize;
+	}
+	bv->bv_totalcount++;
+	bv->bv_savedspace += dsize;
+	bv->bv_dirty = B_TRUE;
+	rw_exit(&brt->brt_lock);
+}
+
+/*
+ * Drop a reference to a block that is being freed.  Returns B_TRUE if the
+ * block had no BRT entry, in which case the caller must go on to free its
+ * DVAs; returns B_FALSE if another reference remains.
+ */
+boolean_t
+brt_entry_decref(spa_t *spa, const blkptr_t *bp)
+{
+	brt_t *brt = spa->spa_brt;
+	uint64_t vdevid = DVA_GET_VDEV(&bp->blk_dva[0]);
+	uint64_t offset = DVA_GET_OFFSET(&bp->blk_dva[0]);
+	boolean_t freeblk = B_TRUE;
+	brt_vdev_t *bv;
+	brt_entry_t *bre;
+
+	ASSERT(dsl_pool_sync_context(spa_get_dsl(spa)));
+
+	rw_enter(&brt->brt_lock, RW_WRITER);
+	bv = brt_vdev(brt, vdevid, B_FALSE);
+	if (bv != NULL &&
+	    (bre = brt_entry_hold(brt, bv, offset, B_FALSE)) != NULL &&
+	    bre->bre_refcount > 0) {
+		uint64_t dsize = bp_get_dsize_sync(spa, bp);
+
+		if (--bre->bre_refcount == 0) {
+			brt_vdev_entcount_dec(brt, bv, offset);
+			bv->bv_usedspace -= dsize;
+		}
+		bv->bv_totalcount--;
+		bv->bv_savedspace -= dsize;
+		bv->bv_dirty = B_TRUE;
+		freeblk = B_FALSE;
+	}
+	rw_exit(&brt->brt_lock);
+
+	return (freeblk);
+}
+
+/*
+ * Cheap check, used on every free, of whether the block may have a BRT
+ * entry.  A false positive only costs a ZAP lookup in zio_brt_free().
+ */
+boolean_t
+brt_maybe_exists(spa_t *spa, const blkptr_t *bp)
+{
+	brt_t *brt = spa->spa_brt;
+	boolean_t exists = B_FALSE;
+	brt_vdev_t *bv;
+
+	if (brt == NULL || BP_IS_EMBEDDED(bp) || BP_IS_HOLE(bp))
+		return (B_FALSE);
+
+	rw_enter(&brt->brt_lock, RW_READER);
+	bv = brt_vdev(brt, DVA_GET_VDEV(&bp->blk_dva[0]), B_FALSE);
+	if (bv != NULL) {
+		exists = brt_vdev_region_used(brt, bv,
+		    DVA_GET_OFFSET(&bp->blk_dva[0]));
+	}
+	rw_exit(&brt->brt_lock);
+
+	return (exists);
+}
+
+/*
+ * Return the number of extra references the BRT holds on the block, as of
+ * the last synced txg plus any changes already applied in this one.  Used
+ * by zdb to claim each cloned block only once.
+ */
+uint64_t
+brt_entry_get_refcount(spa_t *spa, const blkptr_t *bp)
+{
+	brt_t *brt = spa->spa_brt;
+	uint64_t offset = DVA_GET_OFFSET(&bp->blk_dva[0]);
+	uint64_t refcount = 0;
+	brt_entry_t search, *bre;
+	brt_vdev_t *bv;
+
+	rw_enter(&brt->brt_lock, RW_READER);
+	bv = brt_vdev(brt, DVA_GET_VDEV(&bp->blk_dva[0]), B_FALSE);
+	if (bv != NULL) {
+		search.bre_offset = offset;
+		bre = avl_find(&bv->bv_tree, &search, NULL);
+		if (bre != NULL) {
+			refcount = bre->bre_refcount;
+		} else if (bv->bv_mos_entries != 0 &&
+		    brt_vdev_region_used(brt, bv, offset)) {
+			int error = zap_lookup_uint64(spa_meta_objset(spa),
+			    bv->bv_mos_entries, &offset, 1, sizeof (uint64_t),
+			    1, &refcount);
+			VERIFY(error == 0 || error == ENOENT);
+		}
+	}
+	rw_exit(&brt->brt_lock);
+
+	return (refcount);
+}
+
+/*
+ * Record, from open context, that the block has been cloned in the given
+ * transaction.
+ */
+void
+brt_pending_add(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	brt_t *brt = spa->spa_brt;
+	uint64_t txg = dmu_tx_get_txg(tx);
+	brt_pending_entry_t *bpe, *newbpe;
+	avl_index_t where;
+
+	ASSERT(!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp));
+
+	newbpe = kmem_cache_alloc(brt_pending_entry_cache, KM_SLEEP);
+	newbpe->bpe_bp = *bp;
+	newbpe->bpe_count = 1;
+
+	mutex_enter(&brt->brt_pending_lock[txg & TXG_MASK]);
+	bpe = avl_find(&brt->brt_pending_tree[txg & TXG_MASK], newbpe, &where);
+	if (bpe == NULL) {
+		avl_insert(&brt->brt_pending_tree[txg & TXG_MASK], newbpe,
+		    where);
+		newbpe = NULL;
+	} else {
+		bpe->bpe_count++;
+	}
+	mutex_exit(&brt->brt_pending_lock[txg & TXG_MASK]);
+
+	if (newbpe != NULL)
+		kmem_cache_free(brt_pending_entry_cache, newbpe);
+}
+
+/*
+ * Undo a brt_pending_add() for a clone that was overwritten before its txg
+ * synced.
+ */
+void
+brt_pending_remove(spa_t *spa, const blkptr_t *bp, uint64_t txg)
+{
+	brt_t *brt = spa->spa_brt;
+	brt_pending_entry_t *bpe, search;
+
+	search.bpe_bp = *bp;
+
+	mutex_enter(&brt->brt_pending_lock[txg & TXG_MASK]);
+	bpe = avl_find(&brt->brt_pending_tree[txg & TXG_MASK], &search, NULL);
+	VERIFY3P(bpe, !=, NULL);
+	if (--bpe->bpe_count == 0) {
+		avl_remove(&brt->brt_pending_tree[txg & TXG_MASK], bpe);
+		kmem_cache_free(brt_pending_entry_cache, bpe);
+	}
+	mutex_exit(&brt->brt_pending_lock[txg & TXG_MASK]);
+}
+
+/*
+ * Take the references recorded by brt_pending_add() for the syncing txg.
+ * This must happen before any free of the txg is processed.
+ */
+void
+brt_pending_apply(spa_t *spa, uint64_t txg)
+{
+	brt_t *brt = spa->spa_brt;
+	avl_tree_t *tree = &brt->brt_pending_tree[txg & TXG_MASK];
+	brt_pending_entry_t *bpe;
+	void *cookie = NULL;
+
+	ASSERT3U(spa_syncing_txg(spa), ==, txg);
+
+	mutex_enter(&brt->brt_pending_lock[txg & TXG_MASK]);
+	while ((bpe = avl_destroy_nodes(tree, &cookie)) != NULL) {
+		const blkptr_t *bp = &bpe->bpe_bp;
+
+		for (uint64_t i = 0; i < bpe->bpe_count; i++) {
+			if (BP_GET_DEDUP(bp) && ddt_addref(spa, bp))
+				continue;
+			brt_entry_addref(brt, bp);
+		}
+		kmem_cache_free(brt_pending_entry_cache, bpe);
+	}
+	mutex_exit(&brt->brt_pending_lock[txg & TXG_MASK]);
+}
+
+static void
+brt_vdev_create(brt_t *brt, brt_vdev_t *bv, dmu_tx_t *tx)
+{
+	spa_t *spa = brt->brt_spa;
+	objset_t *mos = spa_meta_objset(spa);
+	char name[64];
+
+	ASSERT0(bv->bv_mos_brtvdev);
+	ASSERT0(bv->bv_mos_entries);
+
+	bv->bv_mos_entries = zap_create_flags(mos, 0,
+	    ZAP_FLAG_HASH64 | ZAP_FLAG_UINT64_KEY, DMU_OTN_ZAP_METADATA,
+	    brt_zap_leaf_blockshift, brt_zap_indirect_blockshift,
+	    DMU_OT_NONE, 0, tx);
+	bv->bv_mos_brtvdev = dmu_object_alloc(mos, DMU_OTN_UINT16_METADATA,
+	    SPA_OLD_MAXBLOCKSIZE, DMU_OTN_UINT64_METADATA,
+	    sizeof (brt_vdev_phys_t), tx);
+
+	brt_vdev_name(bv->bv_vdevid, name, sizeof (name));
+	VERIFY0(zap_add(mos, DMU_POOL_DIRECTORY_OBJECT, name,
+	    sizeof (uint64_t), 1, &bv->bv_mos_brtvdev, tx));
+
+	/* The whole entry count array must be written out. */
+	bv->bv_dirty_min = 0;
+	bv->bv_dirty_max = bv->bv_size - 1;
+
+	spa_feature_incr(spa, SPA_FEATURE_BLOCK_CLONING, tx);
+}
+
+static void
+brt_vdev_destroy(brt_t *brt, brt_vdev_t *bv, dmu_tx_t *tx)
+{
+	spa_t *spa = brt->brt_spa;
+	objset_t *mos = spa_meta_objset(spa);
+	char name[64];
+
+	ASSERT0(bv->bv_totalcount);
+	ASSERT0(bv->bv_usedspace);
+	ASSERT0(bv->bv_savedspace);
+
+	VERIFY0(zap_destroy(mos, bv->bv_mos_entries, tx));
+	VERIFY0(dmu_object_free(mos, bv->bv_mos_brtvdev, tx));
+
+	brt_vdev_name(bv->bv_vdevid, name, sizeof (name));
+	VERIFY0(zap_remove(mos, DMU_POOL_DIRECTORY_OBJECT, name, tx));
+
+	bv->bv_mos_entries = 0;
+	bv->bv_mos_brtvdev = 0;
+
+	/* Forget any counters that had saturated. */
+	if (bv->bv_entcount != NULL)
+		bzero(bv->bv_entcount, bv->bv_size * sizeof (uint16_t));
+
+	spa_feature_decr(spa, SPA_FEATURE_BLOCK_CLONING, tx);
+}
+
+static void
+brt_vdev_sync(brt_t *brt, brt_vdev_t *bv, dmu_tx_t *tx)
+{
+	objset_t *mos = spa_meta_objset(brt->brt_spa);
+	brt_entry_t *bre;
+	void *cookie = NULL;
+
+	ASSERT(RW_WRITE_HELD(&brt->brt_lock));
+
+	if (bv->bv_mos_brtvdev == 0) {
+		if (bv->bv_totalcount == 0) {
+			/* Every entry made in this txg is already gone. */
+			while ((bre = avl_destroy_nodes(&bv->bv_tree,
+			    &cookie)) != NULL) {
+				ASSERT0(bre->bre_refcount);
+				kmem_cache_free(brt_entry_cache, bre);
+			}
+			goto out;
+		}
+		brt_vdev_create(brt, bv, tx);
+	}
+
+	while ((bre = avl_destroy_nodes(&bv->bv_tree, &cookie)) != NULL) {
+		if (bre->bre_refcount == 0) {
+			if (bre->bre_ondisk) {
+				VERIFY0(zap_remove_uint64(mos,
+				    bv->bv_mos_entries, &bre->bre_offset, 1,
+				    tx));
+			}
+		} else {
+			VERIFY0(zap_update_uint64(mos, bv->bv_mos_entries,
+			    &bre->bre_offset, 1, sizeof (uint64_t), 1,
+			    &bre->bre_refcount, tx));
+		}
+		kmem_cache_free(brt_entry_cache, bre);
+	}
+
+	if (bv->bv_totalcount == 0) {
+		brt_vdev_destroy(brt, bv, tx);
+		goto out;
+	}
+
+	if (bv->bv_dirty_min <= bv->bv_dirty_max) {
+		dmu_write(mos, bv->bv_mos_brtvdev,
+		    bv->bv_dirty_min * sizeof (uint16_t),
+		    (bv->bv_dirty_max - bv->bv_dirty_min + 1) *
+		    sizeof (uint16_t), &bv->bv_entcount[bv->bv_dirty_min], tx);
+	}
+
+	dmu_buf_t *db;
+	VERIFY0(dmu_bonus_hold(mos, bv->bv_mos_brtvdev, FTAG, &db));
+	dmu_buf_will_dirty(db, tx);
+	brt_vdev_phys_t *bvp = db->db_data;
+	bvp->bvp_mos_entries = bv->bv_mos_entries;
+	bvp->bvp_size = bv->bv_size;
+	bvp->bvp_rangesize = brt->brt_rangesize;
+	bvp->bvp_totalcount = bv->bv_totalcount;
+	bvp->bvp_usedspace = bv->bv_usedspace;
+	bvp->bvp_savedspace = bv->bv_savedspace;
+	dmu_buf_rele(db, FTAG);
+
+out:
+	bv->bv_gen++;
+	bv->bv_dirty_min = UINT64_MAX;
+	bv->bv_dirty_max = 0;
+	bv->bv_dirty = B_FALSE;
+}
+
+/*
+ * Write out the entries changed in this txg.  Called from every sync pass
+ * after the frees of the pass have been issued.
+ */
+void
+brt_sync(spa_t *spa, uint64_t txg)
+{
+	brt_t *brt = spa->spa_brt;
+	dmu_tx_t *tx = NULL;
+
+	ASSERT3U(spa_syncing_txg(spa), ==, txg);
+
+	rw_enter(&brt->brt_lock, RW_WRITER);
+	for (uint64_t vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		brt_vdev_t *bv = brt->brt_vdevs[vdevid];
+
+		if (bv == NULL || !bv->bv_dirty)
+			continue;
+		if (tx == NULL)
+			tx = dmu_tx_create_assigned(spa->spa_dsl_pool, txg);
+		brt_vdev_sync(brt, bv, tx);
+	}
+	rw_exit(&brt->brt_lock);
+
+	if (tx != NULL)
+		dmu_tx_commit(tx);
+}
+
+static int
+brt_vdev_load(brt_t *brt, uint64_t vdevid)
+{
+	objset_t *mos = spa_meta_objset(brt->brt_spa);
+	brt_vdev_phys_t bvp;
+	brt_vdev_t *bv;
+	dmu_buf_t *db;
+	uint64_t obj;
+	char name[64];
+	int error;
+
+	brt_vdev_name(vdevid, name, sizeof (name));
+	error = zap_lookup(mos, DMU_POOL_DIRECTORY_OBJECT, name,
+	    sizeof (uint64_t), 1, &obj);
+	if (error == ENOENT)
+		return (0);
+	if (error != 0)
+		return (error);
+
+	error = dmu_bonus_hold(mos, obj, FTAG, &db);
+	if (error != 0)
+		return (error);
+	bcopy(db->db_data, &bvp, sizeof (bvp));
+	dmu_buf_rele(db, FTAG);
+
+	if (bvp.bvp_rangesize != brt->brt_rangesize)
+		return (SET_ERROR(EINVAL));
+
+	rw_enter(&brt->brt_lock, RW_WRITER);
+	bv = brt_vdev(brt, vdevid, B_TRUE);
+	bv->bv_mos_brtvdev = obj;
+	bv->bv_mos_entries = bvp.bvp_mos_entries;
+	bv->bv_totalcount = bvp.bvp_totalcount;
+	bv->bv_usedspace = bvp.bvp_usedspace;
+	bv->bv_savedspace = bvp.bvp_savedspace;
+	brt_vdev_realloc(bv, bvp.bvp_size);
+	error = dmu_read(mos, obj, 0, bv->bv_size * sizeof (uint16_t),
+	    bv->bv_entcount, DMU_READ_PREFETCH);
+	rw_exit(&brt->brt_lock);
+
+	return (error);
+}
+
+void
+brt_create(spa_t *spa)
+{
+	brt_t *brt;
+
+	ASSERT3P(spa->spa_brt, ==, NULL);
+
+	brt = kmem_zalloc(sizeof (brt_t), KM_SLEEP);
+	brt->brt_spa = spa;
+	brt->brt_rangesize = BRT_RANGESIZE;
+	rw_init(&brt->brt_lock, NULL, RW_DEFAULT, NULL);
+	for (int t = 0; t < TXG_SIZE; t++) {
+		mutex_init(&brt->brt_pending_lock[t], NULL, MUTEX_DEFAULT,
+		    NULL);
+		avl_create(&brt->brt_pending_tree[t],
+		    brt_pending_entry_compare, sizeof (brt_pending_entry_t),
+		    offsetof(brt_pending_entry_t, bpe_node));
+	}
+
+	spa->spa_brt = brt;
+}
+
+int
+brt_load(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+	int error = 0;
+
+	brt_create(spa);
+
+	for (uint64_t c = 0; c < rvd->vdev_children && error == 0; c++)
+		error = brt_vdev_load(spa->spa_brt, c);
+
+	return (error);
+}
+
+void
+brt_unload(spa_t *spa)
+{
+	brt_t *brt = spa->spa_brt;
+	void *cookie;
+
+	if (brt == NULL)
+		return;
+
+	for (uint64_t vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		brt_vdev_t *bv = brt->brt_vdevs[vdevid];
+		brt_entry_t *bre;
+
+		if (bv == NULL)
+			continue;
+
+		cookie = NULL;
+		while ((bre = avl_destroy_nodes(&bv->bv_tree, &cookie)) != NULL)
+			kmem_cache_free(brt_entry_cache, bre);
+		avl_destroy(&bv->bv_tree);
+		if (bv->bv_entcount != NULL) {
+			kmem_free(bv->bv_entcount,
+			    bv->bv_size * sizeof (uint16_t));
+		}
+		kmem_free(bv, sizeof (*bv));
+	}
+	if (brt->brt_nvdevs != 0) {
+		kmem_free(brt->brt_vdevs,
+		    brt->brt_nvdevs * sizeof (brt_vdev_t *));
+	}
+
+	for (int t = 0; t < TXG_SIZE; t++) {
+		brt_pending_entry_t *bpe;
+
+		cookie = NULL;
+		while ((bpe = avl_destroy_nodes(&brt->brt_pending_tree[t],
+		    &cookie)) != NULL)
+			kmem_cache_free(brt_pending_entry_cache, bpe);
+		avl_destroy(&brt->brt_pending_tree[t]);
+		mutex_destroy(&brt->brt_pending_lock[t]);
+	}
+	rw_destroy(&brt->brt_lock);
+	kmem_free(brt, sizeof (brt_t));
+
+	spa->spa_brt = NULL;
+}
+
+uint64_t
+brt_get_used(spa_t *spa)
+{
+	brt_t *brt = spa->spa_brt;
+	uint64_t used = 0;
+
+	if (brt == NULL)
+		return (0);
+
+	rw_enter(&brt->brt_lock, RW_READER);
+	for (uint64_t vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		if (brt->brt_vdevs[vdevid] != NULL)
+			used += brt->brt_vdevs[vdevid]->bv_usedspace;
+	}
+	rw_exit(&brt->brt_lock);
+
+	return (used);
+}
+
+uint64_t
+brt_get_saved(spa_t *spa)
+{
+	brt_t *brt = spa->spa_brt;
+	uint64_t saved = 0;
+
+	if (brt == NULL)
+		return (0);
+
+	rw_enter(&brt->brt_lock, RW_READER);
+	for (uint64_t vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		if (brt->brt_vdevs[vdevid] != NULL)
+			saved += brt->brt_vdevs[vdevid]->bv_savedspace;
+	}
+	rw_exit(&brt->brt_lock);
+
+	return (saved);
+}
+
+/*
+ * Ratio of the space referenced through cloned blocks to the space they
+ * occupy, times 100, in the style of ddt_get_pool_dedup_ratio().
+ */
+uint64_t
+brt_get_ratio(spa_t *spa)
+{
+	uint64_t used = brt_get_used(spa);
+
+	if (used == 0)
+		return (100);
+
+	return ((used + brt_get_saved(spa)) * 100 / used);
+}
+
+void
+brt_init(void)
+{
+	brt_entry_cache = kmem_cache_create("brt_entry_cache",
+	    sizeof (brt_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+	brt_pending_entry_cache = kmem_cache_create("brt_pending_entry_cache",
+	    sizeof (brt_pending_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+}
+
+void
+brt_fini(void)
+{
+	kmem_cache_destroy(brt_pending_entry_cache);
+	kmem_cache_destroy(brt_entry_cache);
+}
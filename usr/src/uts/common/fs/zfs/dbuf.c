@@ -50,6 +50,7 @@
 #include <sys/vdev.h>
 #include <sys/cityhash.h>
 #include <sys/spa_impl.h>
+#include <sys/brt.h>
 
 static boolean_t dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx);
 static void dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx);
@@ -198,11 +199,64 @@ dbuf_dest(void *vdb, void *unused)
 
 /*
  * dbuf hash table routines
+ *
+ * Lookups walk the hash chains without taking any lock; only inserts and
+ * removals take the writer lock of the bucket's group (DBUF_HASH_LOCK).
+ * For this to be safe, a dbuf removed from the table keeps its
+ * db_hash_next and isn't freed until every lookup that might have reached
+ * it has finished, and the same goes for a bucket array that has been
+ * replaced.  Lookups announce themselves in a per-CPU counter for the
+ * current epoch; dbuf_hash_synchronize() moves to the next epoch and
+ * waits for the counters of the previous one to drain.  A lookup that
+ * finds its dbuf always checks it under db_mtx before returning it, so
+ * only a lookup that finds nothing needs to care about what writers were
+ * doing meanwhile.
+ *
+ * The table is resized online by dbuf_hash_resize(), which moves the
+ * chains to the new bucket array one lock group at a time, so inserts and
+ * removals in the other groups are never held up.  A lookup that finds
+ * nothing while its group was being moved retries with the group's lock
+ * held.
  */
 static dbuf_hash_table_t dbuf_hash_table;
 
 static uint64_t dbuf_hash_count;
 
+/*
+ * The hash table grows once the average chain is longer than this, and
+ * shrinks once it's shorter than a quarter of it.  It never gets smaller
+ * than its initial size, nor bigger than one bucket for every 4K of
+ * physical memory.
+ */
+int dbuf_hash_max_load = 2;
+static uint64_t dbuf_hash_min_size;
+static uint64_t dbuf_hash_max_size;
+
+/*
+ * Per-CPU state of the hash table: the lookups in progress in each
+ * epoch, and the dbufs removed from the table that are waiting to be
+ * freed.
+ */
+typedef struct dbuf_hash_cpu {
+	volatile uint64_t dhc_readers[2];
+	kmutex_t dhc_lock;
+	dmu_buf_impl_t *dhc_free;
+	uint64_t dhc_nfree;
+	uint64_t dhc_pad[3];	/* pad out to cache line (64 bytes) */
+} dbuf_hash_cpu_t;
+
+static dbuf_hash_cpu_t *dbuf_hash_cpus;
+static volatile uint32_t dbuf_hash_epoch;
+static kmutex_t dbuf_hash_sync_lock;
+static taskq_t *dbuf_hash_taskq;
+static volatile uint32_t dbuf_hash_maintain_pending;
+
+/*
+ * Number of dbufs waiting to be freed on a CPU before we go and free
+ * them.  Until then they are simply left on the list.
+ */
+#define	DBUF_HASH_FREE_BATCH	256
+
 /*
  * We use Cityhash for this. It's fast, and has good hash properties without
  * requiring any large static buffers.
@@ -219,29 +273,128 @@ dbuf_hash(void *os, uint64_t obj, uint8_t lvl, uint64_t blkid)
 	(dbuf)->db_level == (level) &&			\
 	(dbuf)->db_blkid == (blkid))
 
-dmu_buf_impl_t *
-dbuf_find(objset_t *os, uint64_t obj, uint8_t level, uint64_t blkid)
+static dbuf_hash_cpu_t *
+dbuf_hash_read_enter(uint_t *epochp)
 {
-	dbuf_hash_table_t *h = &dbuf_hash_table;
-	uint64_t hv = dbuf_hash(os, obj, level, blkid);
-	uint64_t idx = hv & h->hash_table_mask;
-	dmu_buf_impl_t *db;
+	dbuf_hash_cpu_t *dhc = &dbuf_hash_cpus[CPU_SEQID];
+	uint_t e;
+
+	/*
+	 * If the epoch changes under us, dbuf_hash_synchronize() may
+	 * already have looked at our counter, so try again in the new one.
+	 */
+	for (;;) {
+		e = dbuf_hash_epoch & 1;
+		atomic_inc_64(&dhc->dhc_readers[e]);
+		membar_enter();
+		if ((dbuf_hash_epoch & 1) == e)
+			break;
+		atomic_dec_64(&dhc->dhc_readers[e]);
+	}
+
+	*epochp = e;
+	return (dhc);
+}
+
+static void
+dbuf_hash_read_exit(dbuf_hash_cpu_t *dhc, uint_t e)
+{
+	membar_exit();
+	atomic_dec_64(&dhc->dhc_readers[e]);
+}
+
+/*
+ * Wait for all the lookups that are in progress to finish.
+ */
+static void
+dbuf_hash_synchronize(void)
+{
+	uint_t e;
+
+	mutex_enter(&dbuf_hash_sync_lock);
+	e = dbuf_hash_epoch & 1;
+	atomic_inc_32(&dbuf_hash_epoch);
+	membar_enter();
+	for (int i = 0; i < max_ncpus; i++) {
+		while (dbuf_hash_cpus[i].dhc_readers[e] != 0)
+			delay(1);
+	}
+	mutex_exit(&dbuf_hash_sync_lock);
+}
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	for (db = h->hash_table[idx]; db != NULL; db = db->db_hash_next) {
+/*
+ * Return the bucket array holding the chains of the group of dhl.  Unless
+ * the caller holds the group's lock, it must check dhl_seq afterward.
+ */
+static dbuf_hash_buckets_t *
+dbuf_hash_buckets(dbuf_hash_table_t *h, dbuf_hash_lock_t *dhl)
+{
+	dbuf_hash_buckets_t *dhb;
+
+	if (dhl->dhl_migrated && (dhb = h->hash_new_buckets) != NULL)
+		return (dhb);
+	membar_consumer();
+	return (h->hash_buckets);
+}
+
+/*
+ * Find the dbuf in the chain starting at db, and return it with its db_mtx
+ * held.
+ */
+static dmu_buf_impl_t *
+dbuf_hash_chain_find(dmu_buf_impl_t *db, objset_t *os, uint64_t obj,
+    uint8_t level, uint64_t blkid)
+{
+	for (; db != NULL; db = db->db_hash_next) {
 		if (DBUF_EQUAL(db, os, obj, level, blkid)) {
 			mutex_enter(&db->db_mtx);
-			if (db->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
+			if (db->db_state != DB_EVICTING)
 				return (db);
-			}
 			mutex_exit(&db->db_mtx);
 		}
 	}
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
 	return (NULL);
 }
 
+dmu_buf_impl_t *
+dbuf_find(objset_t *os, uint64_t obj, uint8_t level, uint64_t blkid)
+{
+	dbuf_hash_table_t *h = &dbuf_hash_table;
+	uint64_t hv = dbuf_hash(os, obj, level, blkid);
+	dbuf_hash_lock_t *dhl = DBUF_HASH_LOCK(h, hv);
+	dbuf_hash_buckets_t *dhb;
+	dbuf_hash_cpu_t *dhc;
+	dmu_buf_impl_t *db;
+	uint64_t seq;
+	uint_t e;
+
+	dhc = dbuf_hash_read_enter(&e);
+	seq = dhl->dhl_seq;
+	if ((seq & 1) == 0) {
+		membar_consumer();
+		dhb = dbuf_hash_buckets(h, dhl);
+		db = dbuf_hash_chain_find(dhb->dhb_table[hv & dhb->dhb_mask],
+		    os, obj, level, blkid);
+		membar_consumer();
+		if (db != NULL || dhl->dhl_seq == seq) {
+			dbuf_hash_read_exit(dhc, e);
+			return (db);
+		}
+	}
+	dbuf_hash_read_exit(dhc, e);
+
+	/*
+	 * The chains of this group were being moved to a new table, so
+	 * we may have missed the dbuf.  Look again with the lock held.
+	 */
+	mutex_enter(&dhl->dhl_lock);
+	dhb = dbuf_hash_buckets(h, dhl);
+	db = dbuf_hash_chain_find(dhb->dhb_table[hv & dhb->dhb_mask],
+	    os, obj, level, blkid);
+	mutex_exit(&dhl->dhl_lock);
+	return (db);
+}
+
 static dmu_buf_impl_t *
 dbuf_find_bonus(objset_t *os, uint64_t object)
 {
@@ -260,6 +413,20 @@ dbuf_find_bonus(objset_t *os, uint64_t object)
 	return (db);
 }
 
+static void dbuf_hash_maintain(void *unused);
+
+static void
+dbuf_hash_maintain_dispatch(void)
+{
+	if (dbuf_hash_maintain_pending != 0 ||
+	    atomic_cas_32(&dbuf_hash_maintain_pending, 0, 1) != 0)
+		return;
+
+	if (taskq_dispatch(dbuf_hash_taskq, dbuf_hash_maintain, NULL,
+	    TQ_NOSLEEP) == TASKQID_INVALID)
+		dbuf_hash_maintain_pending = 0;
+}
+
 /*
  * Insert an entry into the hash table.  If there is already an element
  * equal to elem in the hash table, then the already existing element
@@ -275,32 +442,39 @@ dbuf_hash_insert(dmu_buf_impl_t *db)
 	int level = db->db_level;
 	uint64_t blkid = db->db_blkid;
 	uint64_t hv = dbuf_hash(os, obj, level, blkid);
-	uint64_t idx = hv & h->hash_table_mask;
-	dmu_buf_impl_t *dbf;
-
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	for (dbf = h->hash_table[idx]; dbf != NULL; dbf = dbf->db_hash_next) {
-		if (DBUF_EQUAL(dbf, os, obj, level, blkid)) {
-			mutex_enter(&dbf->db_mtx);
-			if (dbf->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
-				return (dbf);
-			}
-			mutex_exit(&dbf->db_mtx);
-		}
+	dbuf_hash_lock_t *dhl = DBUF_HASH_LOCK(h, hv);
+	dbuf_hash_buckets_t *dhb;
+	dmu_buf_impl_t *dbf, **dbp;
+	uint64_t nbuckets, count;
+
+	mutex_enter(&dhl->dhl_lock);
+	dhb = dbuf_hash_buckets(h, dhl);
+	dbp = &dhb->dhb_table[hv & dhb->dhb_mask];
+	dbf = dbuf_hash_chain_find(*dbp, os, obj, level, blkid);
+	if (dbf != NULL) {
+		mutex_exit(&dhl->dhl_lock);
+		return (dbf);
 	}
 
 	mutex_enter(&db->db_mtx);
-	db->db_hash_next = h->hash_table[idx];
-	h->hash_table[idx] = db;
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
-	atomic_inc_64(&dbuf_hash_count);
+	db->db_hash_next = *dbp;
+	membar_producer();
+	*dbp = db;
+	nbuckets = dhb->dhb_mask + 1;
+	mutex_exit(&dhl->dhl_lock);
+
+	count = atomic_inc_64_nv(&dbuf_hash_count);
+	if (count > nbuckets * dbuf_hash_max_load &&
+	    nbuckets < dbuf_hash_max_size)
+		dbuf_hash_maintain_dispatch();
 
 	return (NULL);
 }
 
 /*
  * Remove an entry from the hash table.  It must be in the EVICTING state.
+ * Lookups may still be walking through it, so its db_hash_next is left
+ * alone, and it must be freed with dbuf_hash_free().
  */
 static void
 dbuf_hash_remove(dmu_buf_impl_t *db)
@@ -308,8 +482,10 @@ dbuf_hash_remove(dmu_buf_impl_t *db)
 	dbuf_hash_table_t *h = &dbuf_hash_table;
 	uint64_t hv = dbuf_hash(db->db_objset, db->db.db_object,
 	    db->db_level, db->db_blkid);
-	uint64_t idx = hv & h->hash_table_mask;
+	dbuf_hash_lock_t *dhl = DBUF_HASH_LOCK(h, hv);
+	dbuf_hash_buckets_t *dhb;
 	dmu_buf_impl_t *dbf, **dbp;
+	uint64_t nbuckets, count;
 
 	/*
 	 * We mustn't hold db_mtx to maintain lock ordering:
@@ -319,16 +495,174 @@ dbuf_hash_remove(dmu_buf_impl_t *db)
 	ASSERT(db->db_state == DB_EVICTING);
 	ASSERT(!MUTEX_HELD(&db->db_mtx));
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	dbp = &h->hash_table[idx];
+	mutex_enter(&dhl->dhl_lock);
+	dhb = dbuf_hash_buckets(h, dhl);
+	dbp = &dhb->dhb_table[hv & dhb->dhb_mask];
 	while ((dbf = *dbp) != db) {
 		dbp = &dbf->db_hash_next;
 		ASSERT(dbf != NULL);
 	}
 	*dbp = db->db_hash_next;
-	db->db_hash_next = NULL;
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
-	atomic_dec_64(&dbuf_hash_count);
+	nbuckets = dhb->dhb_mask + 1;
+	mutex_exit(&dhl->dhl_lock);
+
+	count = atomic_dec_64_nv(&dbuf_hash_count);
+	if (count * 4 < nbuckets * dbuf_hash_max_load &&
+	    nbuckets > dbuf_hash_min_size)
+		dbuf_hash_maintain_dispatch();
+}
+
+/*
+ * Free a dbuf that has been removed from the hash table, once no lookup
+ * can be looking at it any more.
+ */
+static void
+dbuf_hash_free(dmu_buf_impl_t *db)
+{
+	dbuf_hash_cpu_t *dhc = &dbuf_hash_cpus[CPU_SEQID];
+	uint64_t nfree;
+
+	ASSERT(db->db_state == DB_EVICTING);
+	ASSERT3P(db->db_hash_free_next, ==, NULL);
+
+	mutex_enter(&dhc->dhc_lock);
+	db->db_hash_free_next = dhc->dhc_free;
+	dhc->dhc_free = db;
+	nfree = ++dhc->dhc_nfree;
+	mutex_exit(&dhc->dhc_lock);
+
+	if (nfree >= DBUF_HASH_FREE_BATCH)
+		dbuf_hash_maintain_dispatch();
+}
+
+static void
+dbuf_hash_reclaim(void)
+{
+	dmu_buf_impl_t *db, *free = NULL;
+
+	for (int i = 0; i < max_ncpus; i++) {
+		dbuf_hash_cpu_t *dhc = &dbuf_hash_cpus[i];
+
+		mutex_enter(&dhc->dhc_lock);
+		while ((db = dhc->dhc_free) != NULL) {
+			dhc->dhc_free = db->db_hash_free_next;
+			db->db_hash_free_next = free;
+			free = db;
+		}
+		dhc->dhc_nfree = 0;
+		mutex_exit(&dhc->dhc_lock);
+	}
+	if (free == NULL)
+		return;
+
+	dbuf_hash_synchronize();
+
+	while ((db = free) != NULL) {
+		free = db->db_hash_free_next;
+		db->db_hash_free_next = NULL;
+		db->db_hash_next = NULL;
+		kmem_cache_free(dbuf_kmem_cache, db);
+	}
+}
+
+/*
+ * Move all the dbufs to a new bucket array of the given size.
+ */
+static void
+dbuf_hash_resize(uint64_t nbuckets)
+{
+	dbuf_hash_table_t *h = &dbuf_hash_table;
+	dbuf_hash_buckets_t *odhb = h->hash_buckets;
+	dbuf_hash_buckets_t *ndhb;
+	dmu_buf_impl_t *db;
+	uint64_t b, idx;
+	int i;
+
+	ASSERT(ISP2(nbuckets));
+	ASSERT3U(nbuckets, >=, DBUF_MUTEXES);
+
+	ndhb = kmem_zalloc(DBUF_HASH_BUCKETS_SIZE(nbuckets), KM_NOSLEEP);
+	if (ndhb == NULL)
+		return;
+	ndhb->dhb_mask = nbuckets - 1;
+	membar_producer();
+	h->hash_new_buckets = ndhb;
+
+	/*
+	 * Both arrays have at least DBUF_MUTEXES buckets, so the chains
+	 * of a group only ever move to buckets of the same group.
+	 */
+	for (i = 0; i < DBUF_MUTEXES; i++) {
+		dbuf_hash_lock_t *dhl = &h->hash_locks[i];
+
+		mutex_enter(&dhl->dhl_lock);
+		dhl->dhl_seq++;
+		membar_producer();
+		for (b = i; b <= odhb->dhb_mask; b += DBUF_MUTEXES) {
+			while ((db = odhb->dhb_table[b]) != NULL) {
+				idx = dbuf_hash(db->db_objset,
+				    db->db.db_object, db->db_level,
+				    db->db_blkid) & ndhb->dhb_mask;
+				odhb->dhb_table[b] = db->db_hash_next;
+				db->db_hash_next = ndhb->dhb_table[idx];
+				membar_producer();
+				ndhb->dhb_table[idx] = db;
+			}
+		}
+		dhl->dhl_migrated = B_TRUE;
+		membar_producer();
+		dhl->dhl_seq++;
+		mutex_exit(&dhl->dhl_lock);
+	}
+
+	/*
+	 * Every group now uses the new array, so it can become the
+	 * current one.  The order matters to dbuf_hash_buckets(): anyone
+	 * who sees hash_new_buckets cleared or dhl_migrated unset must
+	 * also see the new hash_buckets.
+	 */
+	h->hash_buckets = ndhb;
+	membar_producer();
+	h->hash_new_buckets = NULL;
+	membar_producer();
+	for (i = 0; i < DBUF_MUTEXES; i++)
+		h->hash_locks[i].dhl_migrated = B_FALSE;
+
+	dbuf_hash_synchronize();
+	kmem_free(odhb, DBUF_HASH_BUCKETS_SIZE(odhb->dhb_mask + 1));
+}
+
+/*
+ * Resize the hash table if its load is out of bounds, and free the dbufs
+ * that have been removed from it.  Runs from dbuf_hash_taskq, so there is
+ * only ever one resize at a time.
+ */
+/* ARGSUSED */
+static void
+dbuf_hash_maintain(void *unused)
+{
+	dbuf_hash_table_t *h = &dbuf_hash_table;
+	uint64_t nbuckets = h->hash_buckets->dhb_mask + 1;
+	uint64_t count, target;
+	int load = MAX(dbuf_hash_max_load, 1);
+
+	dbuf_hash_maintain_pending = 0;
+	membar_producer();
+
+	/*
+	 * Aim for an average chain of half the maximum, so that we don't
+	 * flip between two sizes.
+	 */
+	count = dbuf_hash_count;
+	if (count > nbuckets * load || count * 4 < nbuckets * load) {
+		target = dbuf_hash_min_size;
+		while (target < dbuf_hash_max_size && count * 2 > target * load)
+			target <<= 1;
+		if (target != nbuckets)
+			dbuf_hash_resize(target);
+	}
+
+	dbuf_hash_reclaim();
 }
 
 typedef enum {
@@ -619,29 +953,54 @@ dbuf_init(void)
 	int i;
 
 	/*
-	 * The hash table is big enough to fill all of physical memory
-	 * with an average 4K block size.  The table will take up
-	 * totalmem*sizeof(void*)/4K (i.e. 2MB/GB with 8-byte pointers).
+	 * The hash table is never bigger than what it takes to fill all of
+	 * physical memory with an average 4K block size, which would take
+	 * up totalmem*sizeof(void*)/4K (i.e. 2MB/GB with 8-byte pointers).
+	 * Since it grows as needed, start with 1/16th of that.
 	 */
 	while (hsize * 4096 < physmem * PAGESIZE)
 		hsize <<= 1;
+	dbuf_hash_max_size = hsize;
+	hsize = MAX(hsize >> 4, 1ULL << 16);
 
 retry:
-	h->hash_table_mask = hsize - 1;
-	h->hash_table = kmem_zalloc(hsize * sizeof (void *), KM_NOSLEEP);
-	if (h->hash_table == NULL) {
+	h->hash_buckets = kmem_zalloc(DBUF_HASH_BUCKETS_SIZE(hsize),
+	    KM_NOSLEEP);
+	if (h->hash_buckets == NULL) {
 		/* XXX - we should really return an error instead of assert */
 		ASSERT(hsize > (1ULL << 10));
 		hsize >>= 1;
 		goto retry;
 	}
+	h->hash_buckets->dhb_mask = hsize - 1;
+	h->hash_new_buckets = NULL;
+	dbuf_hash_min_size = hsize;
+	dbuf_hash_max_size = MAX(dbuf_hash_max_size, hsize);
 
 	dbuf_kmem_cache = kmem_cache_create("dmu_buf_impl_t",
 	    sizeof (dmu_buf_impl_t),
 	    0, dbuf_cons, dbuf_dest, NULL, NULL, NULL, 0);
 
-	for (i = 0; i < DBUF_MUTEXES; i++)
-		mutex_init(&h->hash_mutexes[i], NULL, MUTEX_DEFAULT, NULL);
+	for (i = 0; i < DBUF_MUTEXES; i++) {
+		mutex_init(&h->hash_locks[i].dhl_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
+		h->hash_locks[i].dhl_seq = 0;
+		h->hash_locks[i].dhl_migrated = B_FALSE;
+	}
+
+	dbuf_hash_cpus = kmem_zalloc(max_ncpus * sizeof (dbuf_hash_cpu_t),
+	    KM_SLEEP);
+	for (i = 0; i < max_ncpus; i++) {
+		mutex_init(&dbuf_hash_cpus[i].dhc_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
+	}
+	mutex_init(&dbuf_hash_sync_lock, NULL, MUTEX_DEFAULT, NULL);
+	dbuf_hash_maintain_pending = 0;
+
+	/*
+	 * Resizing relies on there being only one thread in this taskq.
+	 */
+	dbuf_hash_taskq = taskq_create("dbuf_hash", 1, minclsyspri, 0, 0, 0);
 
 	/*
 	 * Setup the parameters for the dbuf caches. We set the sizes of the
@@ -687,9 +1046,18 @@ dbuf_fini(void)
 	dbuf_hash_table_t *h = &dbuf_hash_table;
 	int i;
 
+	taskq_destroy(dbuf_hash_taskq);
+	dbuf_hash_reclaim();
+	ASSERT3P(h->hash_new_buckets, ==, NULL);
+
+	for (i = 0; i < max_ncpus; i++)
+		mutex_destroy(&dbuf_hash_cpus[i].dhc_lock);
+	kmem_free(dbuf_hash_cpus, max_ncpus * sizeof (dbuf_hash_cpu_t));
+	mutex_destroy(&dbuf_hash_sync_lock);
 	for (i = 0; i < DBUF_MUTEXES; i++)
-		mutex_destroy(&h->hash_mutexes[i]);
-	kmem_free(h->hash_table, (h->hash_table_mask + 1) * sizeof (void *));
+		mutex_destroy(&h->hash_locks[i].dhl_lock);
+	kmem_free(h->hash_buckets,
+	    DBUF_HASH_BUCKETS_SIZE(h->hash_buckets->dhb_mask + 1));
 	kmem_cache_destroy(dbuf_kmem_cache);
 	taskq_destroy(dbu_evict_taskq);
 
@@ -1307,6 +1675,86 @@ dbuf_fix_old_data(dmu_buf_impl_t *db, uint64_t txg)
 	}
 }
 
+static void
+dbuf_read_direct_done(zio_t *zio)
+{
+	abd_put(zio->io_abd);
+}
+
+/*
+ * A dbuf left in the NOFILL state by dmu_write_direct() or dmu_brt_clone()
+ * has no data in memory, but the block holding its contents is known.
+ * Once the direct write or clone has synced the dbuf can simply be read
+ * again; until then, read the block that was written or cloned into a new
+ * buffer, which leaves the dbuf just as dmu_sync() would have: cached,
+ * with the data already on disk.  Any other NOFILL dbuf cannot be read.
+ */
+static int
+dbuf_read_direct(dmu_buf_impl_t *db, uint32_t flags)
+{
+	spa_t *spa = db->db_objset->os_spa;
+	arc_buf_t *buf = NULL;
+	blkptr_t bp;
+	int err = 0;
+
+	ASSERT(db->db_level == 0);
+
+	mutex_enter(&db->db_mtx);
+	while (db->db_state == DB_NOFILL && db->db_diowrite) {
+		dbuf_dirty_record_t *dr = db->db_last_dirty;
+		zbookmark_phys_t zb;
+
+		if (dr == NULL) {
+			db->db_state = DB_UNCACHED;
+			db->db_diowrite = FALSE;
+			break;
+		}
+		if (!dr->dt.dl.dr_diowrite && !dr->dt.dl.dr_brtwrite)
+			break;
+		ASSERT(dr->dt.dl.dr_brtwrite || dr->dr_next == NULL);
+
+		if (buf != NULL && BP_EQUAL(&bp, &dr->dt.dl.dr_overridden_by)) {
+			dbuf_set_data(db, buf);
+			buf = NULL;
+			db->db_state = DB_CACHED;
+			db->db_diowrite = FALSE;
+			dr->dt.dl.dr_data = db->db_buf;
+			break;
+		}
+
+		bp = dr->dt.dl.dr_overridden_by;
+		mutex_exit(&db->db_mtx);
+
+		if (buf == NULL) {
+			buf = arc_alloc_buf(spa, db, DBUF_GET_BUFC_TYPE(db),
+			    db->db.db_size);
+		}
+		if (BP_IS_HOLE(&bp)) {
+			bzero(buf->b_data, db->db.db_size);
+		} else {
+			SET_BOOKMARK(&zb, dmu_objset_id(db->db_objset),
+			    db->db.db_object, db->db_level, db->db_blkid);
+			err = zio_wait(zio_read(NULL, spa, &bp,
+			    abd_get_from_buf(buf->b_data, db->db.db_size),
+			    db->db.db_size, dbuf_read_direct_done, NULL,
+			    ZIO_PRIORITY_SYNC_READ, (flags & DB_RF_CANFAIL) ?
+			    ZIO_FLAG_CANFAIL : ZIO_FLAG_MUSTSUCCEED, &zb));
+		}
+
+		mutex_enter(&db->db_mtx);
+		if (err != 0)
+			break;
+	}
+	if (err == 0 && db->db_state == DB_NOFILL)
+		err = SET_ERROR(EIO);
+	mutex_exit(&db->db_mtx);
+
+	if (buf != NULL)
+		arc_buf_destroy(buf, db);
+
+	return (err);
+}
+
 int
 dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 {
@@ -1320,8 +1768,11 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 	 */
 	ASSERT(!zfs_refcount_is_zero(&db->db_holds));
 
-	if (db->db_state == DB_NOFILL)
-		return (SET_ERROR(EIO));
+	if (db->db_state == DB_NOFILL) {
+		err = dbuf_read_direct(db, flags);
+		if (err != 0)
+			return (err);
+	}
 
 	DB_DNODE_ENTER(db);
 	dn = DB_DNODE(db);
@@ -1473,6 +1924,22 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 
 	ASSERT(db->db_data_pending != dr);
 
+	if (dr->dt.dl.dr_brtwrite) {
+		/*
+		 * The block was cloned rather than written; drop the
+		 * reference that was going to be taken on it.  Unless the
+		 * clone was read back, the dbuf stays in the NOFILL state
+		 * dmu_buf_will_clone() put it in.
+		 */
+		if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp))
+			brt_pending_remove(db->db_objset->os_spa, bp, txg);
+		dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
+		dr->dt.dl.dr_brtwrite = B_FALSE;
+		if (db->db_state != DB_NOFILL)
+			arc_release(dr->dt.dl.dr_data, db);
+		return;
+	}
+
 	/* free this block */
 	if (!BP_IS_HOLE(bp) && !dr->dt.dl.dr_nopwrite)
 		zio_free(db->db_objset->os_spa, txg, bp);
@@ -1481,6 +1948,16 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	dr->dt.dl.dr_nopwrite = B_FALSE;
 	dr->dt.dl.dr_has_raw_params = B_FALSE;
 
+	if (dr->dt.dl.dr_diowrite) {
+		dr->dt.dl.dr_diowrite = B_FALSE;
+		/*
+		 * A direct write that was never read back has no buffer;
+		 * the dbuf stays NOFILL until its caller fills it.
+		 */
+		if (db->db_state == DB_NOFILL)
+			return;
+	}
+
 	/*
 	 * Release the already-written buffer, so we leave it in
 	 * a consistent dirty state.  Note that all callers are
@@ -2049,6 +2526,8 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 		ASSERT(dr->dt.dl.dr_data != NULL);
 		if (dr->dt.dl.dr_data != db->db_buf)
 			arc_buf_destroy(dr->dt.dl.dr_data, db);
+	} else if (dr->dt.dl.dr_brtwrite || dr->dt.dl.dr_diowrite) {
+		dbuf_unoverride(dr);
 	}
 
 	kmem_free(dr, sizeof (dbuf_dirty_record_t));
@@ -2122,6 +2601,73 @@ dmu_buf_will_not_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	dmu_buf_will_fill(db_fake, tx);
 }
 
+/*
+ * Prepare a level-0 dbuf to have a cloned block pointer installed by
+ * dmu_brt_clone().  Any change made to the block in this txg is discarded,
+ * and the dbuf is left dirty in the NOFILL state.
+ */
+void
+dmu_buf_will_clone(dmu_buf_t *db_fake, dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT(db->db_level == 0);
+	ASSERT(tx->tx_txg != 0);
+
+	mutex_enter(&db->db_mtx);
+	while (db->db_state == DB_READ || db->db_state == DB_FILL)
+		cv_wait(&db->db_changed, &db->db_mtx);
+	VERIFY(!dbuf_undirty(db, tx));
+	if (db->db_buf != NULL) {
+		/*
+		 * Leave the data of any earlier dirty record alone; it is
+		 * still to be written out by its own txg.
+		 */
+		dbuf_fix_old_data(db, tx->tx_txg);
+		if (db->db_buf != NULL) {
+			arc_buf_destroy(db->db_buf, db);
+			db->db_buf = NULL;
+		}
+		dbuf_clear_data(db);
+	}
+	db->db_state = DB_NOFILL;
+	db->db_diowrite = FALSE;
+	mutex_exit(&db->db_mtx);
+
+	dmu_buf_will_fill(db_fake, tx);
+}
+
+/*
+ * Prepare a level-0 dbuf that is neither dirty nor being read to have the
+ * block written by dmu_write_direct() installed.  Any cached copy of the
+ * old contents is dropped, and the dbuf is left dirty in the NOFILL state
+ * until the data is read back through dbuf_read().
+ */
+void
+dmu_buf_will_direct_write(dmu_buf_t *db_fake, dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT(db->db_level == 0);
+	ASSERT(tx->tx_txg != 0);
+
+	mutex_enter(&db->db_mtx);
+	ASSERT3P(db->db_last_dirty, ==, NULL);
+	ASSERT(db->db_state != DB_READ && db->db_state != DB_FILL);
+	if (db->db_buf != NULL) {
+		arc_buf_destroy(db->db_buf, db);
+		db->db_buf = NULL;
+		dbuf_clear_data(db);
+	}
+	db->db_state = DB_NOFILL;
+	db->db_diowrite = TRUE;
+	mutex_exit(&db->db_mtx);
+
+	(void) dbuf_dirty(db, tx);
+}
+
 void
 dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 {
@@ -2135,6 +2681,26 @@ dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	ASSERT(db->db.db_object != DMU_META_DNODE_OBJECT ||
 	    dmu_tx_private_ok(tx));
 
+	mutex_enter(&db->db_mtx);
+	if (db->db_state == DB_NOFILL && db->db_diowrite &&
+	    (db->db_last_dirty == NULL ||
+	    db->db_last_dirty->dr_txg == tx->tx_txg)) {
+		/*
+		 * The whole block is about to be overwritten, so there is
+		 * no need to read back what a direct write put there; just
+		 * drop this txg's direct write, if any, and fill the dbuf
+		 * as though it had never been read.
+		 */
+		VERIFY(!dbuf_undirty(db, tx));
+		if (db->db_last_dirty == NULL) {
+			db->db_state = DB_UNCACHED;
+			db->db_diowrite = FALSE;
+		}
+	}
+	mutex_exit(&db->db_mtx);
+	if (db->db_state == DB_NOFILL && db->db_diowrite)
+		(void) dbuf_read(db, NULL, DB_RF_MUST_SUCCEED);
+
 	dbuf_noread(db);
 	(void) dbuf_dirty(db, tx);
 }
@@ -2395,13 +2961,17 @@ dbuf_destroy(dmu_buf_impl_t *db)
 
 	ASSERT(db->db_buf == NULL);
 	ASSERT(db->db.db_data == NULL);
-	ASSERT(db->db_hash_next == NULL);
 	ASSERT(db->db_blkptr == NULL);
 	ASSERT(db->db_data_pending == NULL);
 	ASSERT3U(db->db_caching_status, ==, DB_NO_CACHE);
 	ASSERT(!multilist_link_active(&db->db_cache_link));
 
-	kmem_cache_free(dbuf_kmem_cache, db);
+	if (db->db_blkid != DMU_BONUS_BLKID) {
+		dbuf_hash_free(db);
+	} else {
+		ASSERT(db->db_hash_next == NULL);
+		kmem_cache_free(dbuf_kmem_cache, db);
+	}
 	arc_space_return(sizeof (dmu_buf_impl_t), ARC_SPACE_OTHER);
 
 	/*
@@ -2533,6 +3103,7 @@ dbuf_create(dnode_t *dn, uint8_t level, uint64_t blkid,
 	db->db_user_immediate_evict = FALSE;
 	db->db_freed_in_flight = FALSE;
 	db->db_pending_evict = FALSE;
+	db->db_diowrite = FALSE;
 
 	if (blkid == DMU_BONUS_BLKID) {
 		ASSERT3P(parent, ==, dn->dn_dbuf);
@@ -4016,6 +4587,13 @@ dbuf_remap_impl(dnode_t *dn, blkptr_t *bp, krwlock_t *rw, dmu_tx_t *tx)
 
 	ASSERT(dsl_pool_sync_context(spa_get_dsl(spa)));
 
+	/*
+	 * The BRT tracks cloned blocks by their DVA, so a block that may be
+	 * referenced from elsewhere must keep it.
+	 */
+	if (brt_maybe_exists(spa, bp))
+		return;
+
 	drica.drica_os = dn->dn_objset;
 	drica.drica_blk_birth = bp->blk_birth;
 	drica.drica_tx = tx;
@@ -4193,6 +4771,14 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 	if (db->db_blkid == DMU_SPILL_BLKID)
 		wp_flag = WP_SPILL;
 	wp_flag |= (db->db_state == DB_NOFILL) ? WP_NOFILL : 0;
+	/*
+	 * A direct write's or clone's dbuf may be read back, and so leave
+	 * the NOFILL state, while it is being synced; its block was written
+	 * or cloned with the NOFILL policy either way.
+	 */
+	if (db->db_level == 0 &&
+	    (dr->dt.dl.dr_diowrite || dr->dt.dl.dr_brtwrite))
+		wp_flag |= WP_NOFILL;
 
 	dmu_write_policy(os, dn, db->db_level, wp_flag, &zp);
 
@@ -4210,7 +4796,8 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 	    dr->dt.dl.dr_override_state == DR_OVERRIDDEN) {
 		/*
 		 * The BP for this block has been provided by open context
-		 * (by dmu_sync() or dmu_buf_write_embedded()).
+		 * (by dmu_sync(), dmu_buf_write_embedded() or
+		 * dmu_brt_clone()).
 		 */
 		abd_t *contents = (data != NULL) ?
 		    abd_get_from_buf(data->b_data, arc_buf_size(data)) : NULL;
@@ -4223,7 +4810,8 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 		mutex_enter(&db->db_mtx);
 		dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
 		zio_write_override(dr->dr_zio, &dr->dt.dl.dr_overridden_by,
-		    dr->dt.dl.dr_copies, dr->dt.dl.dr_nopwrite);
+		    dr->dt.dl.dr_copies, dr->dt.dl.dr_nopwrite,
+		    dr->dt.dl.dr_brtwrite);
 		mutex_exit(&db->db_mtx);
 	} else if (db->db_state == DB_NOFILL) {
 		ASSERT(zp.zp_checksum == ZIO_CHECKSUM_OFF ||
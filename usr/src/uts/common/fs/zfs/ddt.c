@@ -37,12 +37,25 @@
 #include <sys/zio_compress.h>
 #include <sys/dsl_scan.h>
 #include <sys/abd.h>
+#include <sys/zfeature.h>
 
 /*
  * Enable/disable prefetching of dedup-ed blocks which are going to be freed.
  */
 int zfs_dedup_prefetch = 1;
 
+/*
+ * Dedup log tunables (see the comment above ddt_log_record_t).  Each txg
+ * moves at least zfs_dedup_log_flush_entries_min entries, and at least as
+ * many as were logged in that txg, from the flushing log to the DDT
+ * objects.  The active log starts being flushed once the flushing log is
+ * empty and the active log is zfs_dedup_log_txg_max txgs old, or has
+ * reached zfs_dedup_log_entries_max entries.
+ */
+int zfs_dedup_log_flush_entries_min = 1000;
+int zfs_dedup_log_txg_max = 8;
+int zfs_dedup_log_entries_max = 1 << 18;
+
 static const ddt_ops_t *ddt_ops[DDT_TYPES] = {
 	&ddt_zap_ops,
 };
@@ -357,6 +370,27 @@ ddt_phys_total_refcnt(const ddt_entry_t *dde)
 	return (refcnt);
 }
 
+/*
+ * Class of a synced entry, as ddt_sync_entry() assigns it; DDT_CLASSES if
+ * the entry has no references left.
+ */
+static enum ddt_class
+ddt_phys_class(const ddt_phys_t *ddp)
+{
+	uint64_t refcnt = 0;
+
+	for (int p = DDT_PHYS_SINGLE; p <= DDT_PHYS_TRIPLE; p++)
+		refcnt += ddp[p].ddp_refcnt;
+
+	if (refcnt == 0)
+		return (DDT_CLASSES);
+	if (ddp[DDT_PHYS_DITTO].ddp_phys_birth != 0)
+		return (DDT_CLASS_DITTO);
+	if (refcnt > 1)
+		return (DDT_CLASS_DUPLICATE);
+	return (DDT_CLASS_UNIQUE);
+}
+
 static void
 ddt_stat_generate(ddt_t *ddt, ddt_entry_t *dde, ddt_stat_t *dds)
 {
@@ -710,6 +744,24 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 	if (dde->dde_loaded)
 		return (dde);
 
+	/*
+	 * A logged entry is newer than anything in the DDT objects.
+	 */
+	ddt_log_entry_t *ddle = ddt_log_find(ddt, &dde->dde_key);
+	if (ddle != NULL) {
+		class = ddt_phys_class(ddle->ddle_phys);
+		bcopy(ddle->ddle_phys, dde->dde_phys, sizeof (dde->dde_phys));
+		dde->dde_type = (class == DDT_CLASSES) ?
+		    DDT_TYPES : DDT_TYPE_CURRENT;
+		dde->dde_class = class;
+		dde->dde_obj_type = ddle->ddle_type;
+		dde->dde_obj_class = ddle->ddle_class;
+		dde->dde_loaded = B_TRUE;
+		if (class != DDT_CLASSES)
+			ddt_stat_update(ddt, dde, -1ULL);
+		return (dde);
+	}
+
 	dde->dde_loading = B_TRUE;
 
 	ddt_exit(ddt);
@@ -735,6 +787,8 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 
 	dde->dde_type = type;	/* will be DDT_TYPES if no entry found */
 	dde->dde_class = class;	/* will be DDT_CLASSES if no entry found */
+	dde->dde_obj_type = type;
+	dde->dde_obj_class = class;
 	dde->dde_loaded = B_TRUE;
 	dde->dde_loading = B_FALSE;
 
@@ -746,6 +800,33 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 	return (dde);
 }
 
+/*
+ * Take another reference on a dedup block that is being cloned.  Returns
+ * B_FALSE if the block has no DDT entry, in which case the caller should
+ * record the reference in the BRT instead.
+ */
+boolean_t
+ddt_addref(spa_t *spa, const blkptr_t *bp)
+{
+	ddt_t *ddt = ddt_select(spa, bp);
+	ddt_entry_t *dde;
+	ddt_phys_t *ddp;
+	boolean_t found = B_FALSE;
+
+	ASSERT(BP_GET_DEDUP(bp));
+
+	ddt_enter(ddt);
+	dde = ddt_lookup(ddt, bp, B_TRUE);
+	ddp = ddt_phys_select(dde, bp);
+	if (ddp != NULL) {
+		ddt_phys_addref(ddp);
+		found = B_TRUE;
+	}
+	ddt_exit(ddt);
+
+	return (found);
+}
+
 void
 ddt_prefetch(spa_t *spa, const blkptr_t *bp)
 {
@@ -780,12 +861,10 @@ typedef struct ddt_key_cmp {
 } ddt_key_cmp_t;
 
 int
-ddt_entry_compare(const void *x1, const void *x2)
+ddt_key_compare(const ddt_key_t *ddk1, const ddt_key_t *ddk2)
 {
-	const ddt_entry_t *dde1 = x1;
-	const ddt_entry_t *dde2 = x2;
-	const ddt_key_cmp_t *k1 = (const ddt_key_cmp_t *)&dde1->dde_key;
-	const ddt_key_cmp_t *k2 = (const ddt_key_cmp_t *)&dde2->dde_key;
+	const ddt_key_cmp_t *k1 = (const ddt_key_cmp_t *)ddk1;
+	const ddt_key_cmp_t *k2 = (const ddt_key_cmp_t *)ddk2;
 	int32_t cmp = 0;
 
 	for (int i = 0; i < DDT_KEY_CMP_LEN; i++) {
@@ -797,6 +876,15 @@ ddt_entry_compare(const void *x1, const void *x2)
 	return (TREE_ISIGN(cmp));
 }
 
+int
+ddt_entry_compare(const void *x1, const void *x2)
+{
+	const ddt_entry_t *dde1 = x1;
+	const ddt_entry_t *dde2 = x2;
+
+	return (ddt_key_compare(&dde1->dde_key, &dde2->dde_key));
+}
+
 static ddt_t *
 ddt_table_alloc(spa_t *spa, enum zio_checksum c)
 {
@@ -812,6 +900,7 @@ ddt_table_alloc(spa_t *spa, enum zio_checksum c)
 	ddt->ddt_checksum = c;
 	ddt->ddt_spa = spa;
 	ddt->ddt_os = spa->spa_meta_objset;
+	ddt_log_alloc(ddt);
 
 	return (ddt);
 }
@@ -821,6 +910,7 @@ ddt_table_free(ddt_t *ddt)
 {
 	ASSERT(avl_numnodes(&ddt->ddt_tree) == 0);
 	ASSERT(avl_numnodes(&ddt->ddt_repair_tree) == 0);
+	ddt_log_free(ddt);
 	avl_destroy(&ddt->ddt_tree);
 	avl_destroy(&ddt->ddt_repair_tree);
 	mutex_destroy(&ddt->ddt_lock);
@@ -861,6 +951,10 @@ ddt_load(spa_t *spa)
 			}
 		}
 
+		error = ddt_log_load(ddt);
+		if (error != 0)
+			return (error);
+
 		/*
 		 * Seed the cached histograms.
 		 */
@@ -916,6 +1010,22 @@ ddt_repair_start(ddt_t *ddt, const blkptr_t *bp)
 
 	dde = ddt_alloc(&ddk);
 
+	/*
+	 * The DDT objects may still hold copies that the log has since
+	 * freed; never repair from those.
+	 */
+	ddt_enter(ddt);
+	ddt_log_entry_t *ddle = ddt_log_find(ddt, &ddk);
+	if (ddle != NULL) {
+		if (ddt_phys_class(ddle->ddle_phys) < DDT_CLASS_UNIQUE) {
+			bcopy(ddle->ddle_phys, dde->dde_phys,
+			    sizeof (dde->dde_phys));
+		}
+		ddt_exit(ddt);
+		return (dde);
+	}
+	ddt_exit(ddt);
+
 	for (enum ddt_type type = 0; type < DDT_TYPES; type++) {
 		for (enum ddt_class class = 0; class < DDT_CLASSES; class++) {
 			/*
@@ -1049,42 +1159,145 @@ ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, dmu_tx_t *tx, uint64_t txg)
 	else
 		nclass = DDT_CLASS_UNIQUE;
 
-	if (otype != DDT_TYPES &&
-	    (otype != ntype || oclass != nclass || total_refcnt == 0)) {
-		VERIFY(ddt_object_remove(ddt, otype, oclass, dde, tx) == 0);
-		ASSERT(ddt_object_lookup(ddt, otype, oclass, dde) == ENOENT);
+	if (ddt->ddt_log_active != NULL) {
+		/*
+		 * Log the entry, tombstone or not, and leave the objects
+		 * alone for now.  The object for the new class is created
+		 * right away, so that the histogram has a home.
+		 */
+		if (total_refcnt != 0) {
+			dde->dde_type = ntype;
+			dde->dde_class = nclass;
+			ddt_stat_update(ddt, dde, 0);
+			if (!ddt_object_exists(ddt, ntype, nclass))
+				ddt_object_create(ddt, ntype, nclass, tx);
+		}
+		ddt_log_append(ddt, dde);
+	} else {
+		if (otype != DDT_TYPES && (otype != ntype ||
+		    oclass != nclass || total_refcnt == 0)) {
+			VERIFY(ddt_object_remove(ddt, otype, oclass,
+			    dde, tx) == 0);
+			ASSERT(ddt_object_lookup(ddt, otype, oclass,
+			    dde) == ENOENT);
+		}
+
+		if (total_refcnt != 0) {
+			dde->dde_type = ntype;
+			dde->dde_class = nclass;
+			ddt_stat_update(ddt, dde, 0);
+			if (!ddt_object_exists(ddt, ntype, nclass))
+				ddt_object_create(ddt, ntype, nclass, tx);
+			VERIFY(ddt_object_update(ddt, ntype, nclass,
+			    dde, tx) == 0);
+		}
 	}
 
-	if (total_refcnt != 0) {
-		dde->dde_type = ntype;
-		dde->dde_class = nclass;
-		ddt_stat_update(ddt, dde, 0);
-		if (!ddt_object_exists(ddt, ntype, nclass))
-			ddt_object_create(ddt, ntype, nclass, tx);
-		VERIFY(ddt_object_update(ddt, ntype, nclass, dde, tx) == 0);
+	/*
+	 * If the class changes, the order that we scan this bp
+	 * changes.  If it decreases, we could miss it, so
+	 * scan it right now.  (This covers both class changing
+	 * while we are doing ddt_walk(), and when we are
+	 * traversing.)
+	 */
+	if (total_refcnt != 0 && nclass < oclass)
+		dsl_scan_ddt_entry(dp->dp_scan, ddt->ddt_checksum, dde, tx);
+}
+
+/*
+ * Move a logged entry into the DDT object for its class.
+ */
+static void
+ddt_sync_flush_entry(ddt_t *ddt, ddt_log_entry_t *ddle, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = ddt->ddt_spa->spa_dsl_pool;
+	enum ddt_type otype = ddle->ddle_type;
+	enum ddt_type ntype = DDT_TYPE_CURRENT;
+	enum ddt_class oclass = ddle->ddle_class;
+	enum ddt_class nclass = ddt_phys_class(ddle->ddle_phys);
+	ddt_entry_t dde;
+
+	bzero(&dde, sizeof (dde));
+	dde.dde_key = ddle->ddle_key;
+	bcopy(ddle->ddle_phys, dde.dde_phys, sizeof (dde.dde_phys));
+
+	if (otype != DDT_TYPES && (otype != ntype || oclass != nclass))
+		VERIFY0(ddt_object_remove(ddt, otype, oclass, &dde, tx));
+
+	if (nclass != DDT_CLASSES) {
+		ASSERT(ddt_object_exists(ddt, ntype, nclass));
+		VERIFY0(ddt_object_update(ddt, ntype, nclass, &dde, tx));
 
 		/*
-		 * If the class changes, the order that we scan this bp
-		 * changes.  If it decreases, we could miss it, so
-		 * scan it right now.  (This covers both class changing
-		 * while we are doing ddt_walk(), and when we are
-		 * traversing.)
+		 * ddt_walk() and ddt_class_contains() go by the object an
+		 * entry is in, so moving it to a lower class is a class
+		 * change as far as the scan is concerned.
 		 */
 		if (nclass < oclass) {
-			dsl_scan_ddt_entry(dp->dp_scan,
-			    ddt->ddt_checksum, dde, tx);
+			dsl_scan_ddt_entry(dp->dp_scan, ddt->ddt_checksum,
+			    &dde, tx);
 		}
 	}
 }
 
+/*
+ * Per-txg dedup log maintenance: move entries from the flushing log into
+ * the DDT objects, in key order so that consecutive updates tend to hit
+ * the same ZAP leaves, and swap the logs once the flushing one is drained.
+ * Only done in the first sync pass.  Returns B_TRUE if it dirtied anything.
+ */
+static boolean_t
+ddt_sync_flush_log(ddt_t *ddt, uint64_t nlogged, dmu_tx_t *tx)
+{
+	ddt_log_t *flushing = ddt->ddt_log_flushing;
+	ddt_log_t *active = ddt->ddt_log_active;
+	uint64_t txg = dmu_tx_get_txg(tx);
+	uint64_t nflush;
+	ddt_log_entry_t *ddle;
+
+	if (avl_numnodes(&flushing->ddl_tree) == 0) {
+		boolean_t swap = avl_numnodes(&active->ddl_tree) != 0 &&
+		    (txg - active->ddl_first_txg >= zfs_dedup_log_txg_max ||
+		    avl_numnodes(&active->ddl_tree) >=
+		    zfs_dedup_log_entries_max);
+
+		if (flushing->ddl_length == 0 && !swap)
+			return (B_FALSE);
+
+		if (flushing->ddl_length != 0)
+			ddt_log_truncate(ddt, flushing, tx);
+		if (swap)
+			ddt_log_swap(ddt, tx);
+		flushing = ddt->ddt_log_flushing;
+	}
+
+	nflush = MAX(zfs_dedup_log_flush_entries_min, nlogged);
+	if (avl_numnodes(&ddt->ddt_log_active->ddl_tree) >=
+	    zfs_dedup_log_entries_max)
+		nflush = UINT64_MAX;
+
+	for (uint64_t n = 0; n < nflush &&
+	    (ddle = avl_first(&flushing->ddl_tree)) != NULL; n++) {
+		ddt_sync_flush_entry(ddt, ddle, tx);
+		ddt_log_flushed(ddt, ddle);
+	}
+	ddt_log_checkpoint(ddt, tx);
+
+	return (B_TRUE);
+}
+
 static void
 ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 {
 	spa_t *spa = ddt->ddt_spa;
 	ddt_entry_t *dde;
 	void *cookie = NULL;
+	uint64_t nlogged = avl_numnodes(&ddt->ddt_tree);
+	boolean_t flushed = B_FALSE;
+	boolean_t exists = B_FALSE;
 
-	if (avl_numnodes(&ddt->ddt_tree) == 0)
+	if (nlogged == 0 &&
+	    (ddt->ddt_log_active == NULL || spa_sync_pass(spa) > 1))
 		return;
 
 	ASSERT(spa->spa_uberblock.ub_version >= SPA_VERSION_DEDUP);
@@ -1095,11 +1308,27 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 		    DMU_POOL_DDT_STATS, tx);
 	}
 
+	if (ddt->ddt_log_active == NULL &&
+	    spa_feature_is_enabled(spa, SPA_FEATURE_DEDUP_LOG))
+		ddt_log_create(ddt, tx);
+
+	if (ddt->ddt_log_active != NULL && nlogged != 0)
+		ddt_log_begin(ddt, nlogged);
+
 	while ((dde = avl_destroy_nodes(&ddt->ddt_tree, &cookie)) != NULL) {
 		ddt_sync_entry(ddt, dde, tx, txg);
 		ddt_free(dde);
 	}
 
+	if (ddt->ddt_log_active != NULL) {
+		if (nlogged != 0)
+			ddt_log_commit(ddt, tx);
+		if (spa_sync_pass(spa) == 1)
+			flushed = ddt_sync_flush_log(ddt, nlogged, tx);
+		if (nlogged == 0 && !flushed)
+			return;
+	}
+
 	for (enum ddt_type type = 0; type < DDT_TYPES; type++) {
 		uint64_t count = 0;
 		for (enum ddt_class class = 0; class < DDT_CLASSES; class++) {
@@ -1108,12 +1337,22 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 				count += ddt_object_count(ddt, type, class);
 			}
 		}
+		/*
+		 * Entries that are only in the log are not counted yet.
+		 */
+		if (ddt->ddt_log_active != NULL && !ddt_log_empty(ddt))
+			count++;
 		for (enum ddt_class class = 0; class < DDT_CLASSES; class++) {
 			if (count == 0 && ddt_object_exists(ddt, type, class))
 				ddt_object_destroy(ddt, type, class, tx);
+			if (ddt_object_exists(ddt, type, class))
+				exists = B_TRUE;
 		}
 	}
 
+	if (ddt->ddt_log_active != NULL && !exists && ddt_log_empty(ddt))
+		ddt_log_destroy(ddt, tx);
+
 	bcopy(ddt->ddt_histogram, &ddt->ddt_histogram_cache,
 	    sizeof (ddt->ddt_histogram));
 }
@@ -1155,6 +1394,28 @@ ddt_sync(spa_t *spa, uint64_t txg)
 	dmu_tx_commit(tx);
 }
 
+/*
+ * Replace an entry read from a DDT object with its logged state, if it
+ * has one.  Returns B_FALSE if the log says the entry is gone, in which
+ * case ddt_walk() moves on to the next one.
+ */
+static boolean_t
+ddt_walk_log(ddt_t *ddt, ddt_entry_t *dde)
+{
+	ddt_log_entry_t *ddle;
+	boolean_t exists = B_TRUE;
+
+	ddt_enter(ddt);
+	ddle = ddt_log_find(ddt, &dde->dde_key);
+	if (ddle != NULL) {
+		bcopy(ddle->ddle_phys, dde->dde_phys, sizeof (dde->dde_phys));
+		exists = (ddt_phys_class(dde->dde_phys) != DDT_CLASSES);
+	}
+	ddt_exit(ddt);
+
+	return (exists);
+}
+
 int
 ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde)
 {
@@ -1165,9 +1426,13 @@ ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde)
 				int error = ENOENT;
 				if (ddt_object_exists(ddt, ddb->ddb_type,
 				    ddb->ddb_class)) {
-					error = ddt_object_walk(ddt,
-					    ddb->ddb_type, ddb->ddb_class,
-					    &ddb->ddb_cursor, dde);
+					do {
+						error = ddt_object_walk(ddt,
+						    ddb->ddb_type,
+						    ddb->ddb_class,
+						    &ddb->ddb_cursor, dde);
+					} while (error == 0 &&
+					    !ddt_walk_log(ddt, dde));
 				}
 				dde->dde_type = ddb->ddb_type;
 				dde->dde_class = ddb->ddb_class;
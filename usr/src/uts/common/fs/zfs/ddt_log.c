@@ -0,0 +1,453 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/ddt.h>
+#include <sys/zap.h>
+#include <sys/dmu_tx.h>
+#include <sys/zio_checksum.h>
+#include <sys/zfeature.h>
+
+/*
+ * Storage for the dedup log; see the comment above ddt_log_record_t.
+ * The policy deciding when entries are flushed lives in ddt.c.
+ *
+ * The in-core trees are only modified from syncing context, but are
+ * read by ddt_lookup() and ddt_repair_start() from other threads, so all
+ * access to them is under ddt_lock.
+ */
+
+/*
+ * Number of records read at a time when loading a log.
+ */
+int ddt_log_load_chunk = 4096;
+
+static void
+ddt_log_name(ddt_t *ddt, uint_t n, char *name)
+{
+	(void) sprintf(name, DMU_POOL_DDT_LOG,
+	    zio_checksum_table[ddt->ddt_checksum].ci_name, n);
+}
+
+static int
+ddt_log_entry_compare(const void *x1, const void *x2)
+{
+	const ddt_log_entry_t *ddle1 = x1;
+	const ddt_log_entry_t *ddle2 = x2;
+
+	return (ddt_key_compare(&ddle1->ddle_key, &ddle2->ddle_key));
+}
+
+static void
+ddt_log_tree_clear(ddt_log_t *ddl)
+{
+	ddt_log_entry_t *ddle;
+	void *cookie = NULL;
+
+	while ((ddle = avl_destroy_nodes(&ddl->ddl_tree, &cookie)) != NULL)
+		kmem_free(ddle, sizeof (*ddle));
+}
+
+static void
+ddt_log_tree_remove(ddt_log_t *ddl, const ddt_key_t *ddk)
+{
+	ddt_log_entry_t search, *ddle;
+
+	search.ddle_key = *ddk;
+	ddle = avl_find(&ddl->ddl_tree, &search, NULL);
+	if (ddle != NULL) {
+		avl_remove(&ddl->ddl_tree, ddle);
+		kmem_free(ddle, sizeof (*ddle));
+	}
+}
+
+/*
+ * Make the record the latest state of its key in the log's tree.
+ */
+static void
+ddt_log_tree_update(ddt_log_t *ddl, const ddt_log_record_t *ddlr)
+{
+	ddt_log_entry_t search, *ddle;
+	avl_index_t where;
+
+	search.ddle_key = ddlr->ddlr_key;
+	ddle = avl_find(&ddl->ddl_tree, &search, &where);
+	if (ddle == NULL) {
+		ddle = kmem_zalloc(sizeof (*ddle), KM_SLEEP);
+		ddle->ddle_key = ddlr->ddlr_key;
+		avl_insert(&ddl->ddl_tree, ddle, where);
+	}
+	bcopy(ddlr->ddlr_phys, ddle->ddle_phys, sizeof (ddle->ddle_phys));
+	ddle->ddle_type = DDLR_GET_TYPE(ddlr);
+	ddle->ddle_class = DDLR_GET_CLASS(ddlr);
+}
+
+static void
+ddt_log_sync_phys(ddt_t *ddt, ddt_log_t *ddl, dmu_tx_t *tx)
+{
+	ddt_log_phys_t *ddlp;
+	dmu_buf_t *db;
+
+	VERIFY0(dmu_bonus_hold(ddt->ddt_os, ddl->ddl_object, FTAG, &db));
+	dmu_buf_will_dirty(db, tx);
+	ddlp = db->db_data;
+	ddlp->ddlp_length = ddl->ddl_length;
+	ddlp->ddlp_first_txg = ddl->ddl_first_txg;
+	ddlp->ddlp_flags = ddl->ddl_flags;
+	ddlp->ddlp_flush_key = ddl->ddl_flush_key;
+	dmu_buf_rele(db, FTAG);
+}
+
+void
+ddt_log_alloc(ddt_t *ddt)
+{
+	for (int n = 0; n < 2; n++) {
+		avl_create(&ddt->ddt_log[n].ddl_tree, ddt_log_entry_compare,
+		    sizeof (ddt_log_entry_t),
+		    offsetof(ddt_log_entry_t, ddle_node));
+	}
+}
+
+void
+ddt_log_free(ddt_t *ddt)
+{
+	ASSERT3P(ddt->ddt_log_buf, ==, NULL);
+
+	for (int n = 0; n < 2; n++) {
+		ddt_log_tree_clear(&ddt->ddt_log[n]);
+		avl_destroy(&ddt->ddt_log[n].ddl_tree);
+	}
+}
+
+static int
+ddt_log_load_one(ddt_t *ddt, uint_t n)
+{
+	ddt_log_t *ddl = &ddt->ddt_log[n];
+	ddt_log_record_t *buf;
+	ddt_log_phys_t ddlp;
+	dmu_buf_t *db;
+	char name[DDT_NAMELEN];
+	uint64_t chunk, off;
+	int error;
+
+	ddt_log_name(ddt, n, name);
+	error = zap_lookup(ddt->ddt_os, DMU_POOL_DIRECTORY_OBJECT, name,
+	    sizeof (uint64_t), 1, &ddl->ddl_object);
+	if (error != 0)
+		return (error);
+
+	error = dmu_bonus_hold(ddt->ddt_os, ddl->ddl_object, FTAG, &db);
+	if (error != 0)
+		return (error);
+	bcopy(db->db_data, &ddlp, sizeof (ddlp));
+	dmu_buf_rele(db, FTAG);
+
+	ddl->ddl_length = ddlp.ddlp_length;
+	ddl->ddl_first_txg = ddlp.ddlp_first_txg;
+	ddl->ddl_flags = ddlp.ddlp_flags;
+	ddl->ddl_flush_key = ddlp.ddlp_flush_key;
+
+	if (ddl->ddl_length % sizeof (ddt_log_record_t) != 0)
+		return (SET_ERROR(ECKSUM));
+
+	/*
+	 * Replay the records in order, so that the last record for each key
+	 * wins.  Records of a flushing log at or below the flush cursor
+	 * have already made it into the DDT objects.
+	 */
+	chunk = ddt_log_load_chunk * sizeof (ddt_log_record_t);
+	buf = kmem_alloc(chunk, KM_SLEEP);
+	for (off = 0; off < ddl->ddl_length; off += chunk) {
+		uint64_t len = MIN(chunk, ddl->ddl_length - off);
+
+		error = dmu_read(ddt->ddt_os, ddl->ddl_object, off, len, buf,
+		    DMU_READ_PREFETCH);
+		if (error != 0)
+			break;
+
+		for (int i = 0; i < len / sizeof (ddt_log_record_t); i++) {
+			ddt_log_record_t *ddlr = &buf[i];
+
+			if ((ddl->ddl_flags & DDL_FLAG_CURSOR) &&
+			    ddt_key_compare(&ddlr->ddlr_key,
+			    &ddl->ddl_flush_key) <= 0)
+				continue;
+			ddt_log_tree_update(ddl, ddlr);
+		}
+	}
+	kmem_free(buf, chunk);
+
+	return (error);
+}
+
+int
+ddt_log_load(ddt_t *ddt)
+{
+	ddt_log_t *active, *flushing;
+	ddt_log_entry_t *ddle;
+	int error;
+
+	for (uint_t n = 0; n < 2; n++) {
+		error = ddt_log_load_one(ddt, n);
+		if (error == ENOENT && n == 0)
+			return (0);
+		if (error != 0)
+			return (error);
+	}
+
+	if (ddt->ddt_log[0].ddl_flags & DDL_FLAG_FLUSHING) {
+		flushing = &ddt->ddt_log[0];
+		active = &ddt->ddt_log[1];
+	} else {
+		active = &ddt->ddt_log[0];
+		flushing = &ddt->ddt_log[1];
+	}
+	if (active->ddl_flags & DDL_FLAG_FLUSHING)
+		return (SET_ERROR(EINVAL));
+
+	/*
+	 * The active log is newer; forget anything it supersedes.
+	 */
+	for (ddle = avl_first(&active->ddl_tree); ddle != NULL;
+	    ddle = AVL_NEXT(&active->ddl_tree, ddle))
+		ddt_log_tree_remove(flushing, &ddle->ddle_key);
+
+	ddt->ddt_log_active = active;
+	ddt->ddt_log_flushing = flushing;
+
+	return (0);
+}
+
+void
+ddt_log_create(ddt_t *ddt, dmu_tx_t *tx)
+{
+	spa_t *spa = ddt->ddt_spa;
+	char name[DDT_NAMELEN];
+
+	ASSERT3P(ddt->ddt_log_active, ==, NULL);
+
+	for (uint_t n = 0; n < 2; n++) {
+		ddt_log_t *ddl = &ddt->ddt_log[n];
+
+		ddl->ddl_object = dmu_object_alloc(ddt->ddt_os,
+		    DMU_OTN_UINT64_METADATA, SPA_OLD_MAXBLOCKSIZE,
+		    DMU_OTN_UINT64_METADATA, sizeof (ddt_log_phys_t), tx);
+		ddl->ddl_length = 0;
+		ddl->ddl_first_txg = dmu_tx_get_txg(tx);
+		ddl->ddl_flags = (n == 0) ? 0 : DDL_FLAG_FLUSHING;
+		bzero(&ddl->ddl_flush_key, sizeof (ddt_key_t));
+		ddt_log_sync_phys(ddt, ddl, tx);
+
+		ddt_log_name(ddt, n, name);
+		VERIFY0(zap_add(ddt->ddt_os, DMU_POOL_DIRECTORY_OBJECT, name,
+		    sizeof (uint64_t), 1, &ddl->ddl_object, tx));
+	}
+
+	ddt->ddt_log_active = &ddt->ddt_log[0];
+	ddt->ddt_log_flushing = &ddt->ddt_log[1];
+
+	spa_feature_incr(spa, SPA_FEATURE_DEDUP_LOG, tx);
+}
+
+void
+ddt_log_destroy(ddt_t *ddt, dmu_tx_t *tx)
+{
+	spa_t *spa = ddt->ddt_spa;
+	char name[DDT_NAMELEN];
+
+	ASSERT(ddt_log_empty(ddt));
+
+	for (uint_t n = 0; n < 2; n++) {
+		ddt_log_t *ddl = &ddt->ddt_log[n];
+
+		ddt_log_name(ddt, n, name);
+		VERIFY0(zap_remove(ddt->ddt_os, DMU_POOL_DIRECTORY_OBJECT,
+		    name, tx));
+		VERIFY0(dmu_object_free(ddt->ddt_os, ddl->ddl_object, tx));
+		ddl->ddl_object = 0;
+		ddl->ddl_length = 0;
+	}
+
+	ddt->ddt_log_active = NULL;
+	ddt->ddt_log_flushing = NULL;
+
+	spa_feature_decr(spa, SPA_FEATURE_DEDUP_LOG, tx);
+}
+
+boolean_t
+ddt_log_empty(ddt_t *ddt)
+{
+	return (avl_numnodes(&ddt->ddt_log[0].ddl_tree) == 0 &&
+	    avl_numnodes(&ddt->ddt_log[1].ddl_tree) == 0);
+}
+
+/*
+ * Return the latest logged state of the key, or NULL if the key is not in
+ * either log.
+ */
+ddt_log_entry_t *
+ddt_log_find(ddt_t *ddt, const ddt_key_t *ddk)
+{
+	ddt_log_entry_t search, *ddle;
+
+	ASSERT(MUTEX_HELD(&ddt->ddt_lock));
+
+	if (ddt->ddt_log_active == NULL)
+		return (NULL);
+
+	search.ddle_key = *ddk;
+	ddle = avl_find(&ddt->ddt_log_active->ddl_tree, &search, NULL);
+	if (ddle == NULL)
+		ddle = avl_find(&ddt->ddt_log_flushing->ddl_tree, &search,
+		    NULL);
+
+	return (ddle);
+}
+
+/*
+ * Prepare to append up to nrecords entries in this sync pass.
+ */
+void
+ddt_log_begin(ddt_t *ddt, uint64_t nrecords)
+{
+	ASSERT3P(ddt->ddt_log_active, !=, NULL);
+	ASSERT3P(ddt->ddt_log_buf, ==, NULL);
+
+	ddt->ddt_log_buf = kmem_alloc(nrecords * sizeof (ddt_log_record_t),
+	    KM_SLEEP);
+	ddt->ddt_log_nrecords = 0;
+	ddt->ddt_log_maxrecords = nrecords;
+}
+
+void
+ddt_log_append(ddt_t *ddt, const ddt_entry_t *dde)
+{
+	ddt_log_record_t *ddlr;
+
+	ASSERT3U(ddt->ddt_log_nrecords, <, ddt->ddt_log_maxrecords);
+
+	ddlr = &ddt->ddt_log_buf[ddt->ddt_log_nrecords++];
+	ddlr->ddlr_key = dde->dde_key;
+	bcopy(dde->dde_phys, ddlr->ddlr_phys, sizeof (ddlr->ddlr_phys));
+	ddlr->ddlr_info = 0;
+	DDLR_SET_TYPE(ddlr, dde->dde_obj_type);
+	DDLR_SET_CLASS(ddlr, dde->dde_obj_class);
+
+	ddt_enter(ddt);
+	ddt_log_tree_remove(ddt->ddt_log_flushing, &ddlr->ddlr_key);
+	ddt_log_tree_update(ddt->ddt_log_active, ddlr);
+	ddt_exit(ddt);
+}
+
+/*
+ * Write out the records appended since ddt_log_begin().
+ */
+void
+ddt_log_commit(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_t *ddl = ddt->ddt_log_active;
+	uint64_t len = ddt->ddt_log_nrecords * sizeof (ddt_log_record_t);
+
+	if (len != 0) {
+		dmu_write(ddt->ddt_os, ddl->ddl_object, ddl->ddl_length, len,
+		    ddt->ddt_log_buf, tx);
+		ddl->ddl_length += len;
+		ddt_log_sync_phys(ddt, ddl, tx);
+	}
+
+	kmem_free(ddt->ddt_log_buf,
+	    ddt->ddt_log_maxrecords * sizeof (ddt_log_record_t));
+	ddt->ddt_log_buf = NULL;
+	ddt->ddt_log_nrecords = 0;
+	ddt->ddt_log_maxrecords = 0;
+}
+
+/*
+ * The entry, which must be the first in the flushing log, has been written
+ * to the DDT objects.  Advance the flush cursor past it.
+ */
+void
+ddt_log_flushed(ddt_t *ddt, ddt_log_entry_t *ddle)
+{
+	ddt_log_t *ddl = ddt->ddt_log_flushing;
+
+	ASSERT3P(avl_first(&ddl->ddl_tree), ==, ddle);
+
+	ddt_enter(ddt);
+	ddl->ddl_flush_key = ddle->ddle_key;
+	ddl->ddl_flags |= DDL_FLAG_CURSOR;
+	avl_remove(&ddl->ddl_tree, ddle);
+	ddt_exit(ddt);
+
+	kmem_free(ddle, sizeof (*ddle));
+}
+
+/*
+ * Persist the flush cursor along with the DDT object updates of this txg.
+ */
+void
+ddt_log_checkpoint(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_sync_phys(ddt, ddt->ddt_log_flushing, tx);
+}
+
+void
+ddt_log_truncate(ddt_t *ddt, ddt_log_t *ddl, dmu_tx_t *tx)
+{
+	ASSERT0(avl_numnodes(&ddl->ddl_tree));
+
+	VERIFY0(dmu_free_range(ddt->ddt_os, ddl->ddl_object, 0,
+	    DMU_OBJECT_END, tx));
+	ddl->ddl_length = 0;
+	ddl->ddl_flags &= ~DDL_FLAG_CURSOR;
+	bzero(&ddl->ddl_flush_key, sizeof (ddt_key_t));
+	ddt_log_sync_phys(ddt, ddl, tx);
+}
+
+/*
+ * Start flushing the active log, and start a new active log in the
+ * (truncated) object of the old flushing log.
+ */
+void
+ddt_log_swap(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_t *active = ddt->ddt_log_flushing;
+	ddt_log_t *flushing = ddt->ddt_log_active;
+
+	ASSERT0(avl_numnodes(&active->ddl_tree));
+	ASSERT0(active->ddl_length);
+
+	active->ddl_flags &= ~(DDL_FLAG_FLUSHING | DDL_FLAG_CURSOR);
+	active->ddl_first_txg = dmu_tx_get_txg(tx);
+	flushing->ddl_flags |= DDL_FLAG_FLUSHING;
+	flushing->ddl_flags &= ~DDL_FLAG_CURSOR;
+	bzero(&flushing->ddl_flush_key, sizeof (ddt_key_t));
+
+	ddt_enter(ddt);
+	ddt->ddt_log_active = active;
+	ddt->ddt_log_flushing = flushing;
+	ddt_exit(ddt);
+
+	ddt_log_sync_phys(ddt, active, tx);
+	ddt_log_sync_phys(ddt, flushing, tx);
+}
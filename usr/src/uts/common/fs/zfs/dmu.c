@@ -50,6 +50,7 @@
 #include <sys/sa.h>
 #include <sys/zfeature.h>
 #include <sys/abd.h>
+#include <sys/brt.h>
 #ifdef _KERNEL
 #include <sys/vmsystm.h>
 #include <sys/zfs_znode.h>
@@ -1287,6 +1288,378 @@ dmu_write_embedded(objset_t *os, uint64_t object, uint64_t offset,
 	dmu_buf_rele(db, FTAG);
 }
 
+/*
+ * Return the level-0 block pointers covering the given range of the
+ * object, for use by dmu_brt_clone().  The range must be block aligned.
+ * Fails with EAGAIN if any of the blocks has changes that have not been
+ * synced yet, in which case the caller should wait for the txg to sync
+ * and try again.
+ */
+int
+dmu_read_l0_bps(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t length, blkptr_t *bps, size_t *nbpsp)
+{
+	dmu_buf_t **dbp;
+	dnode_t *dn;
+	int numbufs, error;
+
+	error = dnode_hold(os, object, FTAG, &dn);
+	if (error != 0)
+		return (error);
+
+	error = dmu_buf_hold_array_by_dnode(dn, offset, length, FALSE, FTAG,
+	    &numbufs, &dbp, DMU_READ_NO_PREFETCH);
+	if (error != 0) {
+		dnode_rele(dn, FTAG);
+		return (error);
+	}
+
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		blkptr_t *bp = &bps[i];
+
+		ASSERT3U(db->db.db_object, !=, DMU_META_DNODE_OBJECT);
+		ASSERT(db->db_level == 0);
+
+		mutex_enter(&db->db_mtx);
+		if (db->db_last_dirty != NULL ||
+		    dnode_block_freed(dn, db->db_blkid)) {
+			mutex_exit(&db->db_mtx);
+			error = SET_ERROR(EAGAIN);
+			break;
+		}
+		mutex_exit(&db->db_mtx);
+
+		db_lock_type_t dblt = dmu_buf_lock_parent(db, RW_READER, FTAG);
+		if (db->db_blkptr == NULL) {
+			BP_ZERO(bp);
+		} else {
+			*bp = *db->db_blkptr;
+		}
+		dmu_buf_unlock_parent(db, dblt, FTAG);
+	}
+	*nbpsp = numbufs;
+
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+	dnode_rele(dn, FTAG);
+
+	return (error);
+}
+
+/*
+ * Make the given range of the object refer to the blocks returned by
+ * dmu_read_l0_bps() for a range of the same size, without copying any
+ * data.  The blocks gain a reference in the BRT (or DDT) when the txg
+ * syncs.
+ */
+void
+dmu_brt_clone(objset_t *os, uint64_t object, uint64_t offset, uint64_t length,
+    dmu_tx_t *tx, const blkptr_t *bps, size_t nbps)
+{
+	spa_t *spa = dmu_objset_spa(os);
+	uint64_t txg = dmu_tx_get_txg(tx);
+	dmu_buf_t **dbp;
+	dnode_t *dn;
+	int numbufs;
+
+	VERIFY0(dnode_hold(os, object, FTAG, &dn));
+	VERIFY0(dmu_buf_hold_array_by_dnode(dn, offset, length, FALSE, FTAG,
+	    &numbufs, &dbp, DMU_READ_NO_PREFETCH));
+	VERIFY3U(nbps, ==, numbufs);
+
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		const blkptr_t *bp = &bps[i];
+		dbuf_dirty_record_t *dr;
+		blkptr_t *nbp;
+		boolean_t older;
+
+		ASSERT(db->db_level == 0);
+
+		dmu_buf_will_clone(dbp[i], tx);
+
+		mutex_enter(&db->db_mtx);
+		dr = db->db_last_dirty;
+		ASSERT3P(dr, !=, NULL);
+		ASSERT3U(dr->dr_txg, ==, txg);
+
+		nbp = &dr->dt.dl.dr_overridden_by;
+		if (BP_IS_HOLE(bp)) {
+			/*
+			 * Give the hole a birth time, so that incremental
+			 * sends see the range was changed.
+			 */
+			BP_ZERO(nbp);
+			if (spa_feature_is_active(spa,
+			    SPA_FEATURE_HOLE_BIRTH)) {
+				BP_SET_LSIZE(nbp, db->db.db_size);
+				BP_SET_TYPE(nbp, dn->dn_type);
+				BP_SET_LEVEL(nbp, 0);
+				BP_SET_BIRTH(nbp, txg, 0);
+			}
+		} else if (BP_IS_EMBEDDED(bp)) {
+			*nbp = *bp;
+			nbp->blk_birth = txg;
+		} else {
+			*nbp = *bp;
+			BP_SET_BIRTH(nbp, txg, BP_PHYSICAL_BIRTH(bp));
+		}
+		dr->dt.dl.dr_override_state = DR_OVERRIDDEN;
+		dr->dt.dl.dr_copies = BP_IS_HOLE(bp) ? 1 : BP_GET_NDVAS(bp);
+		dr->dt.dl.dr_brtwrite = B_TRUE;
+		/* Let readers find the cloned block until it has synced. */
+		db->db_diowrite = TRUE;
+		older = (dr->dr_next != NULL);
+		mutex_exit(&db->db_mtx);
+
+		/*
+		 * If an earlier txg's dirty record is still being synced,
+		 * undoing the clone would leave a NOFILL dbuf that cannot be
+		 * read, so read the clone back now.
+		 */
+		if (older) {
+			(void) dbuf_read(db, NULL,
+			    DB_RF_MUST_SUCCEED | DB_RF_NOPREFETCH);
+		}
+
+		if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp))
+			brt_pending_add(spa, bp, tx);
+	}
+
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+	dnode_rele(dn, FTAG);
+}
+
+/*
+ * Direct I/O reads and writes whole blocks straight between the caller's
+ * buffer and disk, without caching the data in the ARC.  It is only used
+ * for datasets whose blocks the zio pipeline can transform on its own
+ * (no encryption, which is done by the ARC, and no dedup, which would
+ * have to be done in syncing context), and only for block-aligned
+ * requests.  The caller must hold a range lock that keeps any other
+ * writer away from the blocks.
+ */
+static boolean_t
+dmu_direct_io_ok_dnode(dnode_t *dn, uint64_t offset, uint64_t size)
+{
+	objset_t *os = dn->dn_objset;
+
+	if (os->os_encrypted || os->os_dedup_checksum != ZIO_CHECKSUM_OFF)
+		return (B_FALSE);
+	if (dn->dn_datablkshift == 0 || size == 0)
+		return (B_FALSE);
+
+	return (P2PHASE(offset, dn->dn_datablksz) == 0 &&
+	    P2PHASE(size, dn->dn_datablksz) == 0);
+}
+
+boolean_t
+dmu_direct_io_ok(dmu_buf_t *zdb, uint64_t offset, uint64_t size)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	boolean_t ok;
+
+	DB_DNODE_ENTER(db);
+	ok = dmu_direct_io_ok_dnode(DB_DNODE(db), offset, size);
+	DB_DNODE_EXIT(db);
+
+	return (ok);
+}
+
+typedef struct {
+	dbuf_dirty_record_t	*dda_dr;
+	blkptr_t		dda_bp;
+} dmu_direct_arg_t;
+
+static void
+dmu_write_direct_ready(zio_t *zio)
+{
+	dmu_direct_arg_t *dda = zio->io_private;
+	blkptr_t *bp = zio->io_bp;
+
+	if (zio->io_error == 0) {
+		if (BP_IS_HOLE(bp)) {
+			BP_SET_LSIZE(bp, dda->dda_dr->dr_dbuf->db.db_size);
+		} else if (!BP_IS_EMBEDDED(bp)) {
+			ASSERT(BP_GET_LEVEL(bp) == 0);
+			BP_SET_FILL(bp, 1);
+		}
+	}
+}
+
+static void
+dmu_write_direct_done(zio_t *zio)
+{
+	dmu_direct_arg_t *dda = zio->io_private;
+	dbuf_dirty_record_t *dr = dda->dda_dr;
+	dmu_buf_impl_t *db = dr->dr_dbuf;
+
+	mutex_enter(&db->db_mtx);
+	ASSERT(dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC);
+	if (zio->io_error == 0) {
+		dr->dt.dl.dr_nopwrite = !!(zio->io_flags & ZIO_FLAG_NOPWRITE);
+		if (dr->dt.dl.dr_nopwrite)
+			VERIFY(BP_EQUAL(zio->io_bp, db->db_blkptr));
+		dr->dt.dl.dr_overridden_by = *zio->io_bp;
+		dr->dt.dl.dr_override_state = DR_OVERRIDDEN;
+		dr->dt.dl.dr_copies = zio->io_prop.zp_copies;
+		dr->dt.dl.dr_diowrite = B_TRUE;
+
+		/* See the comment in dmu_sync_done() about old style holes. */
+		if (BP_IS_HOLE(&dr->dt.dl.dr_overridden_by) &&
+		    dr->dt.dl.dr_overridden_by.blk_birth == 0)
+			BP_ZERO(&dr->dt.dl.dr_overridden_by);
+	} else {
+		dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
+	}
+	cv_broadcast(&db->db_changed);
+	mutex_exit(&db->db_mtx);
+
+	abd_put(zio->io_abd);
+}
+
+/*
+ * Returns true if the block of the given dbuf can be written directly:
+ * it must be neither dirty nor in flight, and no one else may be using
+ * its cached contents, which are about to go stale.
+ */
+static boolean_t
+dmu_direct_write_ok(dmu_buf_impl_t *db)
+{
+	boolean_t ok;
+
+	mutex_enter(&db->db_mtx);
+	ok = db->db_last_dirty == NULL &&
+	    (db->db_state == DB_UNCACHED ||
+	    (db->db_state == DB_NOFILL && db->db_diowrite) ||
+	    (db->db_state == DB_CACHED &&
+	    zfs_refcount_count(&db->db_holds) == 1));
+	mutex_exit(&db->db_mtx);
+
+	return (ok);
+}
+
+/*
+ * Write whole blocks from buf straight to disk and make the range refer
+ * to them, as dmu_sync() does for a block that is already dirty.  Blocks
+ * with changes in memory, and any whose direct write fails, are written
+ * through the dbuf cache instead.  The data is checksummed (and maybe
+ * compressed) as it is written, so buf must not change until we return.
+ */
+static void
+dmu_write_direct_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
+    const void *buf, dmu_tx_t *tx)
+{
+	objset_t *os = dn->dn_objset;
+	spa_t *spa = os->os_spa;
+	uint64_t txg = dmu_tx_get_txg(tx);
+	dmu_direct_arg_t *dda;
+	dmu_buf_t **dbp;
+	zio_t *pio;
+	int numbufs;
+
+	ASSERT(dmu_direct_io_ok_dnode(dn, offset, size));
+
+	VERIFY0(dmu_buf_hold_array_by_dnode(dn, offset, size, FALSE, FTAG,
+	    &numbufs, &dbp, DMU_READ_NO_PREFETCH));
+
+	dda = kmem_zalloc(numbufs * sizeof (dmu_direct_arg_t), KM_SLEEP);
+	pio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		const char *data = (const char *)buf + i * db->db.db_size;
+		dbuf_dirty_record_t *dr;
+		zbookmark_phys_t zb;
+		zio_prop_t zp;
+
+		ASSERT3U(db->db.db_offset, ==, offset + i * db->db.db_size);
+
+		if (!dmu_direct_write_ok(db)) {
+			dmu_buf_will_fill(dbp[i], tx);
+			bcopy(data, db->db.db_data, db->db.db_size);
+			dmu_buf_fill_done(dbp[i], tx);
+			continue;
+		}
+
+		/*
+		 * As in dmu_sync(), nopwrite is safe as long as the block
+		 * pointer cannot change before this txg syncs.
+		 */
+		dmu_write_policy(os, dn, 0, WP_DMU_SYNC, &zp);
+		if (dnode_block_freed(dn, db->db_blkid))
+			zp.zp_nopwrite = B_FALSE;
+		db_lock_type_t dblt = dmu_buf_lock_parent(db, RW_READER, FTAG);
+		if (db->db_blkptr != NULL)
+			dda[i].dda_bp = *db->db_blkptr;
+		dmu_buf_unlock_parent(db, dblt, FTAG);
+
+		dmu_buf_will_direct_write(dbp[i], tx);
+
+		mutex_enter(&db->db_mtx);
+		dr = db->db_last_dirty;
+		ASSERT3P(dr, !=, NULL);
+		ASSERT3U(dr->dr_txg, ==, txg);
+		ASSERT(dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN);
+		dr->dt.dl.dr_override_state = DR_IN_DMU_SYNC;
+		mutex_exit(&db->db_mtx);
+		dda[i].dda_dr = dr;
+
+		SET_BOOKMARK(&zb, dmu_objset_id(os), dn->dn_object, 0,
+		    db->db_blkid);
+		zio_nowait(zio_write(pio, spa, txg, &dda[i].dda_bp,
+		    abd_get_from_buf((void *)data, db->db.db_size),
+		    db->db.db_size, db->db.db_size, &zp,
+		    dmu_write_direct_ready, NULL, NULL, dmu_write_direct_done,
+		    &dda[i], ZIO_PRIORITY_SYNC_WRITE, ZIO_FLAG_CANFAIL, &zb));
+	}
+
+	if (zio_wait(pio) != 0) {
+		/*
+		 * A NOFILL dbuf without an override would be synced as
+		 * garbage, so hand the blocks that failed to the dbuf cache;
+		 * dmu_buf_will_fill() drops the failed direct write.
+		 */
+		for (int i = 0; i < numbufs; i++) {
+			dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+			dbuf_dirty_record_t *dr = dda[i].dda_dr;
+			boolean_t failed;
+
+			if (dr == NULL)
+				continue;
+			mutex_enter(&db->db_mtx);
+			failed = (dr->dt.dl.dr_override_state ==
+			    DR_NOT_OVERRIDDEN);
+			mutex_exit(&db->db_mtx);
+			if (!failed)
+				continue;
+
+			dmu_buf_will_fill(dbp[i], tx);
+			bcopy((const char *)buf + i * db->db.db_size,
+			    db->db.db_data, db->db.db_size);
+			dmu_buf_fill_done(dbp[i], tx);
+		}
+	}
+
+	kmem_free(dda, numbufs * sizeof (dmu_direct_arg_t));
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+}
+
+/*
+ * Write to the object of the given dbuf (e.g. its bonus buffer) with
+ * dmu_write_direct_dnode().
+ */
+void
+dmu_write_direct(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    const void *buf, dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+
+	DB_DNODE_ENTER(db);
+	dmu_write_direct_dnode(DB_DNODE(db), offset, size, buf, tx);
+	DB_DNODE_EXIT(db);
+}
+
 /*
  * DMU support for xuio
  */
@@ -1520,6 +1893,136 @@ dmu_read_uio(objset_t *os, uint64_t object, uio_t *uio, uint64_t size)
 	return (err);
 }
 
+/*
+ * Returns true if the block of the given dbuf can be read directly from
+ * disk, and if so the block pointer to read.  Blocks that are cached,
+ * dirty or in flight are read through the dbuf cache instead, which has
+ * their current contents.
+ */
+static boolean_t
+dmu_direct_read_bp(dnode_t *dn, dmu_buf_impl_t *db, blkptr_t *bp)
+{
+	boolean_t ok;
+
+	mutex_enter(&db->db_mtx);
+	ok = db->db_state == DB_UNCACHED && db->db_last_dirty == NULL &&
+	    !dnode_block_freed(dn, db->db_blkid);
+	mutex_exit(&db->db_mtx);
+	if (!ok)
+		return (B_FALSE);
+
+	db_lock_type_t dblt = dmu_buf_lock_parent(db, RW_READER, FTAG);
+	if (db->db_blkptr == NULL) {
+		BP_ZERO(bp);
+	} else {
+		*bp = *db->db_blkptr;
+	}
+	dmu_buf_unlock_parent(db, dblt, FTAG);
+
+	return (B_TRUE);
+}
+
+/*
+ * Read whole blocks straight from disk into the uio, without caching
+ * them; see dmu_direct_io_ok_dnode().  The blocks are read in parallel, each
+ * into a buffer of its own, and the ones that are not on disk yet are
+ * read through the dbuf cache.
+ */
+static int
+dmu_read_uio_direct_dnode(dnode_t *dn, uio_t *uio, uint64_t size)
+{
+	spa_t *spa = dn->dn_objset->os_spa;
+	dmu_buf_t **dbp;
+	abd_t **abds;
+	zio_t *rio;
+	int numbufs, err, rerr = 0;
+
+	ASSERT(dmu_direct_io_ok_dnode(dn, uio->uio_loffset, size));
+
+	err = dmu_buf_hold_array_by_dnode(dn, uio->uio_loffset, size,
+	    FALSE, FTAG, &numbufs, &dbp, DMU_READ_NO_PREFETCH);
+	if (err != 0)
+		return (err);
+
+	abds = kmem_zalloc(numbufs * sizeof (abd_t *), KM_SLEEP);
+	rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		zbookmark_phys_t zb;
+		blkptr_t bp;
+
+		if (!dmu_direct_read_bp(dn, db, &bp)) {
+			err = dbuf_read(db, rio, DB_RF_CANFAIL |
+			    DB_RF_NEVERWAIT | DB_RF_NOPREFETCH);
+			if (rerr == 0)
+				rerr = err;
+			continue;
+		}
+
+		abds[i] = abd_alloc_linear(db->db.db_size, B_FALSE);
+		if (BP_IS_HOLE(&bp)) {
+			abd_zero(abds[i], db->db.db_size);
+			continue;
+		}
+		SET_BOOKMARK(&zb, dmu_objset_id(dn->dn_objset), dn->dn_object,
+		    0, db->db_blkid);
+		zio_nowait(zio_read(rio, spa, &bp, abds[i], db->db.db_size,
+		    NULL, NULL, ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL, &zb));
+	}
+
+	err = zio_wait(rio);
+	if (err == 0)
+		err = rerr;
+
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		void *data;
+
+		if (abds[i] == NULL) {
+			/* wait for any other reader of the cached block */
+			mutex_enter(&db->db_mtx);
+			while (db->db_state == DB_READ ||
+			    db->db_state == DB_FILL)
+				cv_wait(&db->db_changed, &db->db_mtx);
+			if (db->db_state != DB_CACHED && err == 0)
+				err = SET_ERROR(EIO);
+			mutex_exit(&db->db_mtx);
+			data = db->db.db_data;
+		} else {
+			data = abd_to_buf(abds[i]);
+		}
+
+		if (err == 0)
+			err = uiomove(data, db->db.db_size, UIO_READ, uio);
+
+		if (abds[i] != NULL)
+			abd_free(abds[i]);
+	}
+
+	kmem_free(abds, numbufs * sizeof (abd_t *));
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (err);
+}
+
+/*
+ * Read from the object of the given dbuf (e.g. its bonus buffer) with
+ * dmu_read_uio_direct_dnode().
+ */
+int
+dmu_read_uio_direct(dmu_buf_t *zdb, uio_t *uio, uint64_t size)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	int err;
+
+	DB_DNODE_ENTER(db);
+	err = dmu_read_uio_direct_dnode(DB_DNODE(db), uio, size);
+	DB_DNODE_EXIT(db);
+
+	return (err);
+}
+
 int
 dmu_write_uio_dnode(dnode_t *dn, uio_t *uio, uint64_t size, dmu_tx_t *tx)
 {
@@ -2022,7 +2525,9 @@ dmu_sync_late_arrival(zio_t *pio, objset_t *os, dmu_sync_cb_t *done, zgd_t *zgd,
  *		The caller should log this blkptr in the done callback.
  *		It is possible that the I/O will fail, in which case
  *		the error will be reported to the done callback and
- *		propagated to pio from zio_done().
+ *		propagated to pio from zio_done().  If the block was
+ *		written by dmu_write_direct(), no I/O is needed and the
+ *		done callback is called before we return.
  */
 int
 dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
@@ -2035,10 +2540,37 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	zbookmark_phys_t zb;
 	zio_prop_t zp;
 	dnode_t *dn;
+	int err;
 
 	ASSERT(pio != NULL);
 	ASSERT(txg != 0);
 
+	/*
+	 * A block written by dmu_write_direct() is already on disk, so just
+	 * log where it is.  Its block pointer stays valid for as long as the
+	 * dirty record exists, even once the txg has started syncing.
+	 */
+	mutex_enter(&db->db_mtx);
+	dr = db->db_last_dirty;
+	while (dr != NULL && dr->dr_txg > txg)
+		dr = dr->dr_next;
+	if (dr != NULL && dr->dr_txg == txg && dr->dt.dl.dr_diowrite) {
+		*zgd->zgd_bp = dr->dt.dl.dr_overridden_by;
+		mutex_exit(&db->db_mtx);
+		zil_lwb_add_block(zgd->zgd_lwb, zgd->zgd_bp);
+		done(zgd, 0);
+		return (0);
+	}
+	mutex_exit(&db->db_mtx);
+
+	/*
+	 * Everything else needs the buffer's contents, which the caller
+	 * may not have read in.
+	 */
+	err = dbuf_read(db, NULL, DB_RF_CANFAIL | DB_RF_NOPREFETCH);
+	if (err != 0)
+		return (err);
+
 	SET_BOOKMARK(&zb, ds->ds_object,
 	    db->db.db_object, db->db_level, db->db_blkid);
 
@@ -2386,6 +2918,7 @@ dmu_write_policy(objset_t *os, dnode_t *dn, int level, int wp, zio_prop_t *zp)
 	zp->zp_dedup = dedup;
 	zp->zp_dedup_verify = dedup && dedup_verify;
 	zp->zp_nopwrite = nopwrite;
+	zp->zp_brtwrite = B_FALSE;
 	zp->zp_zpl_smallblk = DMU_OT_IS_FILE(zp->zp_type) ?
 	    os->os_zpl_special_smallblock : 0;
 	zp->zp_encrypt = encrypt;
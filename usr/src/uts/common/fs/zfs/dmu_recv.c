@@ -57,6 +57,11 @@
 #include <sys/bqueue.h>
 
 int zfs_recv_queue_length = SPA_MAXBLOCKSIZE;
+/*
+ * Number of threads applying the records of a receive to the pool.  Records
+ * are divided among them by dnode block; see receive_writer_for_record().
+ */
+int zfs_recv_writer_threads = 4;
 
 static char *dmu_recv_tag = "dmu_recv_tag";
 const char *recv_clone_name = "%recv";
@@ -800,13 +805,51 @@ struct receive_record_arg {
 	int payload_size;
 	uint64_t bytes_read; /* bytes read from stream when record created */
 	boolean_t eos_marker; /* Marks the end of the stream */
+	struct receive_inflight *inflight; /* Resume tracking, if resumable */
 	bqueue_node_t node;
 };
 
+/*
+ * For resumable receives, each record handed to a writer is tracked in
+ * stream order until it has been applied; the resume state may only move
+ * past a record once it, and everything before it, will be on disk when
+ * the txg the state is saved in has synced.
+ */
+struct receive_inflight {
+	list_node_t ri_node;
+	uint64_t ri_object;
+	uint64_t ri_offset;
+	uint64_t ri_bytes_read;
+	uint64_t ri_txg;	/* Last txg holding this record's changes */
+	boolean_t ri_done;
+	boolean_t ri_resume_point; /* A write record we can resume from */
+};
+
+/*
+ * State shared by all the writer threads of a receive.
+ */
+struct receive_writers {
+	int rws_nwriters;
+	struct receive_writer_arg *rws_writers;
+
+	kmutex_t rws_lock;
+	kcondvar_t rws_cv;
+	uint64_t rws_pending;	/* Records handed out but not yet applied */
+	int rws_err;		/* First error hit by any writer */
+	uint64_t rws_last_object; /* Position of the last DRR_WRITE record */
+	uint64_t rws_last_offset;
+
+	list_t rws_inflight;	/* struct receive_inflight, in stream order */
+	uint64_t rws_inflight_txg; /* Highest txg of a retired record */
+};
+
 struct receive_writer_arg {
 	objset_t *os;
 	boolean_t byteswap;
 	bqueue_t q;
+	struct receive_writers *rws;
+	/* The tracking state of the record being applied, if resumable */
+	struct receive_inflight *inflight;
 
 	/*
 	 * These three args are used to signal to the main thread that we're
@@ -822,8 +865,6 @@ struct receive_writer_arg {
 	boolean_t resumable;
 	boolean_t raw;		/* DMU_BACKUP_FEATURE_RAW set */
 	boolean_t spill;	/* DRR_FLAG_SPILL_BLOCK set */
-	uint64_t last_object;
-	uint64_t last_offset;
 	uint64_t max_object; /* highest object ID referenced in stream */
 	uint64_t bytes_read; /* bytes read when current record created */
 
@@ -1057,11 +1098,46 @@ deduce_nblkptr(dmu_object_type_t bonus_type, uint64_t bonus_size)
 	}
 }
 
+/*
+ * Retire the applied records at the head of the in-flight list whose
+ * changes are all in txgs up to and including txg, and return the last
+ * record we can resume from among them, if any.  Passing UINT64_MAX for
+ * txg retires only records which are not resume points, to keep the list
+ * short while no write records are being applied.
+ */
+static struct receive_inflight *
+receive_inflight_retire(struct receive_writers *rws, uint64_t txg)
+{
+	struct receive_inflight *ri, *last = NULL;
+
+	ASSERT(MUTEX_HELD(&rws->rws_lock));
+
+	while ((ri = list_head(&rws->rws_inflight)) != NULL && ri->ri_done &&
+	    MAX(ri->ri_txg, rws->rws_inflight_txg) <= txg) {
+		if (txg == UINT64_MAX && ri->ri_resume_point)
+			break;
+		list_remove(&rws->rws_inflight, ri);
+		rws->rws_inflight_txg = MAX(rws->rws_inflight_txg, ri->ri_txg);
+		if (ri->ri_resume_point) {
+			if (last != NULL)
+				kmem_free(last, sizeof (*last));
+			last = ri;
+		} else {
+			kmem_free(ri, sizeof (*ri));
+		}
+	}
+	return (last);
+}
+
 static void
 save_resume_state(struct receive_writer_arg *rwa,
     uint64_t object, uint64_t offset, dmu_tx_t *tx)
 {
-	int txgoff = dmu_tx_get_txg(tx) & TXG_MASK;
+	struct receive_writers *rws = rwa->rws;
+	struct receive_inflight *ri = rwa->inflight;
+	uint64_t txg = dmu_tx_get_txg(tx);
+	int txgoff = txg & TXG_MASK;
+	dsl_dataset_t *ds = rwa->os->os_dsl_dataset;
 
 	if (!rwa->resumable)
 		return;
@@ -1077,21 +1153,42 @@ save_resume_state(struct receive_writer_arg *rwa,
 	 * (non-meta-dnode) object number.
 	 */
 	ASSERT(object != 0);
+	ASSERT3U(ri->ri_object, ==, object);
+	ASSERT3U(ri->ri_offset, ==, offset);
+	ASSERT(ri->ri_resume_point);
 
 	/*
-	 * For resuming to work correctly, we must receive records in order,
-	 * sorted by object,offset.  This is checked by the callers, but
-	 * assert it here for good measure.
+	 * Other writers may still be applying records which precede this
+	 * one in the stream, so we may only record the position of the
+	 * last record up to which everything has been applied in this txg
+	 * or an earlier one.  Since the in-flight list is in stream order,
+	 * records are retired (by whichever writer gets there first) in
+	 * order, and the resume state only ever moves forward.
 	 */
-	ASSERT3U(object, >=, rwa->os->os_dsl_dataset->ds_resume_object[txgoff]);
-	ASSERT(object != rwa->os->os_dsl_dataset->ds_resume_object[txgoff] ||
-	    offset >= rwa->os->os_dsl_dataset->ds_resume_offset[txgoff]);
-	ASSERT3U(rwa->bytes_read, >=,
-	    rwa->os->os_dsl_dataset->ds_resume_bytes[txgoff]);
-
-	rwa->os->os_dsl_dataset->ds_resume_object[txgoff] = object;
-	rwa->os->os_dsl_dataset->ds_resume_offset[txgoff] = offset;
-	rwa->os->os_dsl_dataset->ds_resume_bytes[txgoff] = rwa->bytes_read;
+	mutex_enter(&rws->rws_lock);
+	ri->ri_txg = txg;
+	ri->ri_done = B_TRUE;
+	rwa->inflight = NULL;
+	struct receive_inflight *last = receive_inflight_retire(rws, txg);
+	if (last != NULL) {
+		/*
+		 * For resuming to work correctly, we must receive records in
+		 * order, sorted by object,offset.  This is checked by
+		 * receive_writers_dispatch(), but assert it here for good
+		 * measure.
+		 */
+		ASSERT3U(last->ri_object, >=, ds->ds_resume_object[txgoff]);
+		ASSERT(last->ri_object != ds->ds_resume_object[txgoff] ||
+		    last->ri_offset >= ds->ds_resume_offset[txgoff]);
+		ASSERT3U(last->ri_bytes_read, >=,
+		    ds->ds_resume_bytes[txgoff]);
+
+		ds->ds_resume_object[txgoff] = last->ri_object;
+		ds->ds_resume_offset[txgoff] = last->ri_offset;
+		ds->ds_resume_bytes[txgoff] = last->ri_bytes_read;
+		kmem_free(last, sizeof (*last));
+	}
+	mutex_exit(&rws->rws_lock);
 }
 
 int receive_object_delay_frac = 0;
@@ -1486,20 +1583,9 @@ receive_write(struct receive_writer_arg *rwa, struct drr_write *drrw,
 	    !DMU_OT_IS_VALID(drrw->drr_type))
 		return (SET_ERROR(EINVAL));
 
-	/*
-	 * For resuming to work, records must be in increasing order
-	 * by (object, offset).
-	 */
-	if (drrw->drr_object < rwa->last_object ||
-	    (drrw->drr_object == rwa->last_object &&
-	    drrw->drr_offset < rwa->last_offset)) {
-		return (SET_ERROR(EINVAL));
-	}
-	rwa->last_object = drrw->drr_object;
-	rwa->last_offset = drrw->drr_offset;
-
-	if (rwa->last_object > rwa->max_object)
-		rwa->max_object = rwa->last_object;
+	/* The order of the records is checked by receive_writers_dispatch(). */
+	if (drrw->drr_object > rwa->max_object)
+		rwa->max_object = drrw->drr_object;
 
 	if (dmu_object_info(rwa->os, drrw->drr_object, NULL) != 0)
 		return (SET_ERROR(EINVAL));
@@ -2271,23 +2357,56 @@ receive_process_record(struct receive_writer_arg *rwa,
 }
 
 /*
- * dmu_recv_stream's worker thread; pull records off the queue, and then call
+ * Note that the record being applied by this writer is complete, for a
+ * record that has not saved the resume state itself.  Its changes were made
+ * in transactions that have all been assigned by now, so they are in the
+ * open txg or an earlier one.
+ */
+static void
+receive_inflight_applied(struct receive_writer_arg *rwa)
+{
+	struct receive_writers *rws = rwa->rws;
+	struct receive_inflight *ri = rwa->inflight;
+	uint64_t txg = spa_last_synced_txg(dmu_objset_spa(rwa->os)) +
+	    TXG_CONCURRENT_STATES;
+
+	mutex_enter(&rws->rws_lock);
+	ri->ri_txg = txg;
+	ri->ri_done = B_TRUE;
+	rwa->inflight = NULL;
+	VERIFY3P(receive_inflight_retire(rws, UINT64_MAX), ==, NULL);
+	mutex_exit(&rws->rws_lock);
+}
+
+/*
+ * dmu_recv_stream's worker threads; pull records off the queue, and then call
  * receive_process_record  When we're done, signal the main thread and exit.
  */
 static void
 receive_writer_thread(void *arg)
 {
 	struct receive_writer_arg *rwa = arg;
+	struct receive_writers *rws = rwa->rws;
 	struct receive_record_arg *rrd;
 	for (rrd = bqueue_dequeue(&rwa->q); !rrd->eos_marker;
 	    rrd = bqueue_dequeue(&rwa->q)) {
 		/*
-		 * If there's an error, the main thread will stop putting things
-		 * on the queue, but we need to clear everything in it before we
-		 * can exit.
+		 * If there's an error, in this writer or any other, the main
+		 * thread will stop putting things on the queues, but we need
+		 * to clear everything in ours before we can exit.
 		 */
-		if (rwa->err == 0) {
+		if (rwa->err == 0 && rws->rws_err == 0) {
+			rwa->inflight = rrd->inflight;
 			rwa->err = receive_process_record(rwa, rrd);
+			if (rwa->err != 0) {
+				mutex_enter(&rws->rws_lock);
+				if (rws->rws_err == 0)
+					rws->rws_err = rwa->err;
+				mutex_exit(&rws->rws_lock);
+			} else if (rwa->inflight != NULL) {
+				receive_inflight_applied(rwa);
+			}
+			rwa->inflight = NULL;
 		} else if (rrd->arc_buf != NULL) {
 			dmu_return_arcbuf(rrd->arc_buf);
 			rrd->arc_buf = NULL;
@@ -2297,6 +2416,12 @@ receive_writer_thread(void *arg)
 			rrd->payload = NULL;
 		}
 		kmem_free(rrd, sizeof (*rrd));
+
+		mutex_enter(&rws->rws_lock);
+		ASSERT3U(rws->rws_pending, >, 0);
+		if (--rws->rws_pending == 0)
+			cv_broadcast(&rws->rws_cv);
+		mutex_exit(&rws->rws_lock);
 	}
 	kmem_free(rrd, sizeof (*rrd));
 	mutex_enter(&rwa->mutex);
@@ -2306,6 +2431,157 @@ receive_writer_thread(void *arg)
 	thread_exit();
 }
 
+/*
+ * Pick the writer that applies a record.  Records are divided among the
+ * writers by the block of dnodes holding the object they refer to.  This
+ * keeps the records of each object in stream order, and keeps together
+ * the things that must be applied in order across objects: a
+ * DRR_OBJECT_RANGE and the objects it describes, and a multi-slot dnode and
+ * the objects whose slots it takes over, are all within one dnode block.
+ * Returns NULL for records which must be applied while no other records
+ * are: DRR_FREEOBJECTS records spanning more than one dnode block.
+ */
+static struct receive_writer_arg *
+receive_writer_for_record(struct receive_writers *rws,
+    struct receive_record_arg *rrd)
+{
+	dmu_replay_record_t *drr = &rrd->header;
+	uint64_t object;
+
+	if (rws->rws_nwriters == 1)
+		return (&rws->rws_writers[0]);
+
+	switch (drr->drr_type) {
+	case DRR_OBJECT:
+		object = drr->drr_u.drr_object.drr_object;
+		break;
+	case DRR_FREEOBJECTS:
+	{
+		struct drr_freeobjects *drrfo = &drr->drr_u.drr_freeobjects;
+		uint64_t last = drrfo->drr_firstobj +
+		    MAX(drrfo->drr_numobjs, 1) - 1;
+
+		object = drrfo->drr_firstobj;
+		if (last < object || (object >> DNODES_PER_BLOCK_SHIFT) !=
+		    (last >> DNODES_PER_BLOCK_SHIFT))
+			return (NULL);
+		break;
+	}
+	case DRR_WRITE:
+		object = drr->drr_u.drr_write.drr_object;
+		break;
+	case DRR_WRITE_BYREF:
+		object = drr->drr_u.drr_write_byref.drr_object;
+		break;
+	case DRR_WRITE_EMBEDDED:
+		object = drr->drr_u.drr_write_embedded.drr_object;
+		break;
+	case DRR_FREE:
+		object = drr->drr_u.drr_free.drr_object;
+		break;
+	case DRR_SPILL:
+		object = drr->drr_u.drr_spill.drr_object;
+		break;
+	case DRR_OBJECT_RANGE:
+		object = drr->drr_u.drr_object_range.drr_firstobj;
+		break;
+	default:
+		return (NULL);
+	}
+
+	return (&rws->rws_writers[(object >> DNODES_PER_BLOCK_SHIFT) %
+	    rws->rws_nwriters]);
+}
+
+/*
+ * Wait until every record handed to the writers has been applied.
+ */
+static void
+receive_writers_wait(struct receive_writers *rws)
+{
+	mutex_enter(&rws->rws_lock);
+	while (rws->rws_pending != 0)
+		cv_wait(&rws->rws_cv, &rws->rws_lock);
+	mutex_exit(&rws->rws_lock);
+}
+
+/*
+ * Hand a record to the writer that applies it.  Records that cannot be
+ * applied concurrently with others are applied by the first writer while
+ * the others are idle.
+ */
+static void
+receive_writers_dispatch(struct receive_writers *rws,
+    struct receive_record_arg *rrd)
+{
+	struct receive_writer_arg *rwa = receive_writer_for_record(rws, rrd);
+	boolean_t barrier = (rwa == NULL);
+
+	if (barrier) {
+		receive_writers_wait(rws);
+		rwa = &rws->rws_writers[0];
+	}
+
+	mutex_enter(&rws->rws_lock);
+
+	/*
+	 * For resuming to work, records must be in increasing order
+	 * by (object, offset).  The writers skip everything once an
+	 * error has been set, including this record.
+	 */
+	if (rrd->header.drr_type == DRR_WRITE) {
+		struct drr_write *drrw = &rrd->header.drr_u.drr_write;
+
+		if (drrw->drr_object < rws->rws_last_object ||
+		    (drrw->drr_object == rws->rws_last_object &&
+		    drrw->drr_offset < rws->rws_last_offset)) {
+			if (rws->rws_err == 0)
+				rws->rws_err = SET_ERROR(EINVAL);
+		}
+		rws->rws_last_object = drrw->drr_object;
+		rws->rws_last_offset = drrw->drr_offset;
+	}
+
+	if (rwa->resumable) {
+		struct receive_inflight *ri = kmem_zalloc(sizeof (*ri),
+		    KM_SLEEP);
+		dmu_replay_record_t *drr = &rrd->header;
+
+		ri->ri_bytes_read = rrd->bytes_read;
+		switch (drr->drr_type) {
+		case DRR_WRITE:
+			ri->ri_object = drr->drr_u.drr_write.drr_object;
+			ri->ri_offset = drr->drr_u.drr_write.drr_offset;
+			ri->ri_resume_point = B_TRUE;
+			break;
+		case DRR_WRITE_BYREF:
+			ri->ri_object = drr->drr_u.drr_write_byref.drr_object;
+			ri->ri_offset = drr->drr_u.drr_write_byref.drr_offset;
+			ri->ri_resume_point = B_TRUE;
+			break;
+		case DRR_WRITE_EMBEDDED:
+			ri->ri_object =
+			    drr->drr_u.drr_write_embedded.drr_object;
+			ri->ri_offset =
+			    drr->drr_u.drr_write_embedded.drr_offset;
+			ri->ri_resume_point = B_TRUE;
+			break;
+		default:
+			break;
+		}
+		list_insert_tail(&rws->rws_inflight, ri);
+		rrd->inflight = ri;
+	}
+	rws->rws_pending++;
+	mutex_exit(&rws->rws_lock);
+
+	bqueue_enqueue(&rwa->q, rrd,
+	    sizeof (struct receive_record_arg) + rrd->payload_size);
+
+	if (barrier)
+		receive_writers_wait(rws);
+}
+
 static int
 resume_check(struct receive_arg *ra, nvlist_t *begin_nvl)
 {
@@ -2333,14 +2609,16 @@ resume_check(struct receive_arg *ra, nvlist_t *begin_nvl)
 }
 
 /*
- * Read in the stream's records, one by one, and apply them to the pool.  There
- * are two threads involved; the thread that calls this function will spin up a
- * worker thread, read the records off the stream one by one, and issue
- * prefetches for any necessary indirect blocks.  It will then push the records
- * onto an internal blocking queue.  The worker thread will pull the records off
- * the queue, and actually write the data into the DMU.  This way, the worker
- * thread doesn't have to wait for reads to complete, since everything it needs
- * (the indirect blocks) will be prefetched.
+ * Read in the stream's records, one by one, and apply them to the pool.  The
+ * thread that calls this function will spin up zfs_recv_writer_threads worker
+ * threads, read the records off the stream one by one, and issue prefetches
+ * for any necessary indirect blocks.  It will then push each record onto the
+ * blocking queue of the worker that applies it (see
+ * receive_writer_for_record()).  The worker threads will pull the records off
+ * their queues, and actually write the data into the DMU.  This way, the
+ * workers don't have to wait for reads to complete, since everything they
+ * need (the indirect blocks) will be prefetched, and records for unrelated
+ * objects are applied concurrently.
  *
  * NB: callers *must* call dmu_recv_end() if this succeeds.
  */
@@ -2351,6 +2629,7 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 	int err = 0;
 	struct receive_arg ra = { 0 };
 	struct receive_writer_arg rwa = { 0 };
+	struct receive_writers rws = { 0 };
 	int featureflags;
 	nvlist_t *begin_nvl = NULL;
 
@@ -2477,11 +2756,6 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 			goto out;
 	}
 
-	(void) bqueue_init(&rwa.q,
-	    MAX(zfs_recv_queue_length, 2 * zfs_max_recordsize),
-	    offsetof(struct receive_record_arg, node));
-	cv_init(&rwa.cv, NULL, CV_DEFAULT, NULL);
-	mutex_init(&rwa.mutex, NULL, MUTEX_DEFAULT, NULL);
 	rwa.os = ra.os;
 	rwa.byteswap = drc->drc_byteswap;
 	rwa.resumable = drc->drc_resumable;
@@ -2489,24 +2763,52 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 	rwa.spill = drc->drc_spill;
 	rwa.os->os_raw_receive = drc->drc_raw;
 
-	(void) thread_create(NULL, 0, receive_writer_thread, &rwa, 0, curproc,
-	    TS_RUN, minclsyspri);
 	/*
-	 * We're reading rwa.err without locks, which is safe since we are the
-	 * only reader, and the worker thread is the only writer.  It's ok if we
-	 * miss a write for an iteration or two of the loop, since the writer
-	 * thread will keep freeing records we send it until we send it an eos
+	 * A DRR_WRITE_BYREF record may refer to a block written by any
+	 * earlier record of the stream, so dedup'ed streams are applied by a
+	 * single writer.
+	 */
+	rws.rws_nwriters = MAX(zfs_recv_writer_threads, 1);
+	if (featureflags & DMU_BACKUP_FEATURE_DEDUP)
+		rws.rws_nwriters = 1;
+	rws.rws_writers = kmem_zalloc(rws.rws_nwriters *
+	    sizeof (struct receive_writer_arg), KM_SLEEP);
+	mutex_init(&rws.rws_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&rws.rws_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&rws.rws_inflight, sizeof (struct receive_inflight),
+	    offsetof(struct receive_inflight, ri_node));
+
+	for (int i = 0; i < rws.rws_nwriters; i++) {
+		struct receive_writer_arg *w = &rws.rws_writers[i];
+
+		*w = rwa;
+		(void) bqueue_init(&w->q,
+		    MAX(zfs_recv_queue_length / rws.rws_nwriters,
+		    2 * zfs_max_recordsize),
+		    offsetof(struct receive_record_arg, node));
+		cv_init(&w->cv, NULL, CV_DEFAULT, NULL);
+		mutex_init(&w->mutex, NULL, MUTEX_DEFAULT, NULL);
+		w->rws = &rws;
+
+		(void) thread_create(NULL, 0, receive_writer_thread, w, 0,
+		    curproc, TS_RUN, minclsyspri);
+	}
+	/*
+	 * We're reading rws.rws_err without locks, which is safe since it's
+	 * only ever set once, from zero to an error.  It's ok if we miss a
+	 * write for an iteration or two of the loop, since the writer threads
+	 * will keep freeing records we send them until we send them an eos
 	 * marker.
 	 *
-	 * We can leave this loop in 3 ways:  First, if rwa.err is
-	 * non-zero.  In that case, the writer thread will free the rrd we just
-	 * pushed.  Second, if  we're interrupted; in that case, either it's the
-	 * first loop and ra.rrd was never allocated, or it's later, and ra.rrd
-	 * has been handed off to the writer thread who will free it.  Finally,
-	 * if receive_read_record fails or we're at the end of the stream, then
-	 * we free ra.rrd and exit.
+	 * We can leave this loop in 3 ways:  First, if rws.rws_err is
+	 * non-zero.  In that case, the writer threads will free the rrd we
+	 * just pushed.  Second, if  we're interrupted; in that case, either
+	 * it's the first loop and ra.rrd was never allocated, or it's later,
+	 * and ra.rrd has been handed off to a writer thread who will free it.
+	 * Finally, if receive_read_record fails or we're at the end of the
+	 * stream, then we free ra.rrd and exit.
 	 */
-	while (rwa.err == 0) {
+	while (rws.rws_err == 0) {
 		if (issig(JUSTLOOKING) && issig(FORREAL)) {
 			err = SET_ERROR(EINTR);
 			break;
@@ -2524,20 +2826,31 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 			break;
 		}
 
-		bqueue_enqueue(&rwa.q, ra.rrd,
-		    sizeof (struct receive_record_arg) + ra.rrd->payload_size);
+		receive_writers_dispatch(&rws, ra.rrd);
 		ra.rrd = NULL;
 	}
 	ASSERT3P(ra.rrd, ==, NULL);
-	ra.rrd = kmem_zalloc(sizeof (*ra.rrd), KM_SLEEP);
-	ra.rrd->eos_marker = B_TRUE;
-	bqueue_enqueue(&rwa.q, ra.rrd, 1);
+	for (int i = 0; i < rws.rws_nwriters; i++) {
+		struct receive_writer_arg *w = &rws.rws_writers[i];
+		struct receive_record_arg *eos;
+
+		eos = kmem_zalloc(sizeof (*eos), KM_SLEEP);
+		eos->eos_marker = B_TRUE;
+		bqueue_enqueue(&w->q, eos, 1);
+	}
 
-	mutex_enter(&rwa.mutex);
-	while (!rwa.done) {
-		cv_wait(&rwa.cv, &rwa.mutex);
+	for (int i = 0; i < rws.rws_nwriters; i++) {
+		struct receive_writer_arg *w = &rws.rws_writers[i];
+
+		mutex_enter(&w->mutex);
+		while (!w->done) {
+			cv_wait(&w->cv, &w->mutex);
+		}
+		mutex_exit(&w->mutex);
+
+		if (w->max_object > rwa.max_object)
+			rwa.max_object = w->max_object;
 	}
-	mutex_exit(&rwa.mutex);
 
 	/*
 	 * If we are receiving a full stream as a clone, all object IDs which
@@ -2574,11 +2887,25 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, vnode_t *vp, offset_t *voffp,
 		}
 	}
 
-	cv_destroy(&rwa.cv);
-	mutex_destroy(&rwa.mutex);
-	bqueue_destroy(&rwa.q);
+	for (int i = 0; i < rws.rws_nwriters; i++) {
+		struct receive_writer_arg *w = &rws.rws_writers[i];
+
+		cv_destroy(&w->cv);
+		mutex_destroy(&w->mutex);
+		bqueue_destroy(&w->q);
+	}
+	kmem_free(rws.rws_writers,
+	    rws.rws_nwriters * sizeof (struct receive_writer_arg));
+
+	struct receive_inflight *ri;
+	while ((ri = list_remove_head(&rws.rws_inflight)) != NULL)
+		kmem_free(ri, sizeof (*ri));
+	list_destroy(&rws.rws_inflight);
+	cv_destroy(&rws.rws_cv);
+	mutex_destroy(&rws.rws_lock);
+
 	if (err == 0)
-		err = rwa.err;
+		err = rws.rws_err;
 
 out:
 	/*
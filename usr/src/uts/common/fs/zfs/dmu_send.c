@@ -59,6 +59,15 @@
 /* Set this tunable to TRUE to replace corrupt data with 0x2f5baddb10c */
 int zfs_send_corrupt_data = B_FALSE;
 int zfs_send_queue_length = SPA_MAXBLOCKSIZE;
+/*
+ * Number of threads that traverse disjoint ranges of objects for each send.
+ */
+int zfs_send_traverse_threads = 4;
+/*
+ * Bytes of block data for which reads are issued ahead of the thread writing
+ * the stream.  Set to 0 to rely on the prefetching done by the traversal.
+ */
+int zfs_send_prefetch_queue_length = 16 * 1024 * 1024;
 /* Set this tunable to FALSE to disable setting of DRR_FLAG_FREERECORDS */
 int zfs_send_set_freerecords_bit = B_TRUE;
 /* Set this tunable to FALSE is disable sending unmodified spill blocks. */
@@ -81,6 +90,18 @@ struct send_thread_arg {
 	int		error_code;
 	boolean_t	cancel;
 	zbookmark_phys_t resume;
+	uint64_t	obj_start;	/* First object of this range */
+	uint64_t	obj_end;	/* End (exclusive) of this range */
+};
+
+struct send_prefetch_thread_arg {
+	bqueue_t	q;
+	spa_t		*spa;
+	struct send_thread_arg *ranges;	/* Traversal ranges, in order */
+	int		nranges;
+	boolean_t	issue_reads;	/* Prefetch data ahead of do_dump */
+	boolean_t	rawok;
+	boolean_t	cancel;
 };
 
 struct send_block_record {
@@ -695,10 +716,11 @@ send_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 }
 
 /*
- * This function kicks off the traverse_dataset.  It also handles setting the
- * error code of the thread in case something goes wrong, and pushes the End of
- * Stream record when the traverse_dataset call has finished.  If there is no
- * dataset to traverse, the thread immediately pushes End of Stream marker.
+ * This function kicks off the traversal of one range of objects.  It also
+ * handles setting the error code of the thread in case something goes wrong,
+ * and pushes the End of Stream record when the traversal has finished.  If
+ * there is no dataset to traverse, the thread immediately pushes End of
+ * Stream marker.
  */
 static void
 send_traverse_thread(void *arg)
@@ -708,9 +730,9 @@ send_traverse_thread(void *arg)
 	struct send_block_record *data;
 
 	if (st_arg->ds != NULL) {
-		err = traverse_dataset_resume(st_arg->ds,
-		    st_arg->fromtxg, &st_arg->resume,
-		    st_arg->flags, send_cb, st_arg);
+		err = traverse_dataset_range(st_arg->ds,
+		    st_arg->fromtxg, &st_arg->resume, st_arg->obj_start,
+		    st_arg->obj_end, st_arg->flags, send_cb, st_arg);
 
 		if (err != EINTR)
 			st_arg->error_code = err;
@@ -721,6 +743,80 @@ send_traverse_thread(void *arg)
 	thread_exit();
 }
 
+/*
+ * Issue an asynchronous read for the block do_dump() will need for this
+ * record, so that by the time the record reaches do_dump() the block is
+ * (hopefully) in the ARC.  Dnode blocks have already been read by the
+ * traversal.
+ */
+static void
+send_prefetch_block(struct send_prefetch_thread_arg *spta,
+    struct send_block_record *data)
+{
+	const blkptr_t *bp = &data->bp;
+	const zbookmark_phys_t *zb = &data->zb;
+	int zioflags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE;
+	arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH |
+	    ARC_FLAG_PRESCIENT_PREFETCH;
+
+	if (zb->zb_level != 0 || BP_IS_HOLE(bp) || BP_IS_EMBEDDED(bp) ||
+	    BP_GET_TYPE(bp) == DMU_OT_DNODE ||
+	    (zb->zb_object != DMU_META_DNODE_OBJECT &&
+	    DMU_OBJECT_IS_SPECIAL(zb->zb_object)))
+		return;
+
+	if (spta->rawok && BP_IS_PROTECTED(bp))
+		zioflags |= ZIO_FLAG_RAW;
+
+	(void) arc_read(NULL, spta->spa, bp, NULL, NULL,
+	    ZIO_PRIORITY_ASYNC_READ, zioflags, &aflags, zb);
+}
+
+/*
+ * This thread sits between the traversal threads and do_dump().  It consumes
+ * the records of each range in turn, which yields them in the order a single
+ * traversal of the dataset would, issues reads for the blocks they refer to,
+ * and passes them on to the thread writing the stream.  The size of the
+ * queue to that thread bounds how much data is read ahead.  If a range fails
+ * to be traversed, the records of all later ranges are discarded, so that
+ * the stream stops where a single traversal would have.
+ */
+static void
+send_prefetch_thread(void *arg)
+{
+	struct send_prefetch_thread_arg *spta = arg;
+	struct send_block_record *data;
+
+	for (int i = 0; i < spta->nranges; i++) {
+		struct send_thread_arg *range = &spta->ranges[i];
+
+		data = bqueue_dequeue(&range->q);
+		while (!data->eos_marker) {
+			if (spta->cancel) {
+				kmem_free(data, sizeof (*data));
+			} else {
+				if (spta->issue_reads)
+					send_prefetch_block(spta, data);
+				bqueue_enqueue(&spta->q, data,
+				    data->datablkszsec << SPA_MINBLOCKSHIFT);
+			}
+			data = bqueue_dequeue(&range->q);
+		}
+		kmem_free(data, sizeof (*data));
+
+		if (range->error_code != 0 && !spta->cancel) {
+			spta->cancel = B_TRUE;
+			for (int j = i + 1; j < spta->nranges; j++)
+				spta->ranges[j].cancel = B_TRUE;
+		}
+	}
+
+	data = kmem_zalloc(sizeof (*data), KM_SLEEP);
+	data->eos_marker = B_TRUE;
+	bqueue_enqueue(&spta->q, data, 1);
+	thread_exit();
+}
+
 /*
  * This function actually handles figuring out what kind of record needs to be
  * dumped, reading the data (which has hopefully been prefetched), and calling
@@ -961,7 +1057,10 @@ dmu_send_impl(void *tag, dsl_pool_t *dp, dsl_dataset_t *to_ds,
 	int err;
 	uint64_t fromtxg = 0;
 	uint64_t featureflags = 0;
-	struct send_thread_arg to_arg = { 0 };
+	struct send_thread_arg *ranges = NULL;
+	struct send_prefetch_thread_arg spta = { 0 };
+	zbookmark_phys_t resume = { 0 };
+	int nranges = 0;
 
 	err = dmu_objset_from_ds(to_ds, &os);
 	if (err != 0) {
@@ -1106,7 +1205,7 @@ dmu_send_impl(void *tag, dsl_pool_t *dp, dsl_dataset_t *to_ds,
 				goto out;
 			}
 
-			SET_BOOKMARK(&to_arg.resume, to_ds->ds_object,
+			SET_BOOKMARK(&resume, to_ds->ds_object,
 			    resumeobj, 0,
 			    resumeoff / to_doi.doi_data_block_size);
 
@@ -1143,41 +1242,95 @@ dmu_send_impl(void *tag, dsl_pool_t *dp, dsl_dataset_t *to_ds,
 		goto out;
 	}
 
-	err = bqueue_init(&to_arg.q,
-	    MAX(zfs_send_queue_length, 2 * zfs_max_recordsize),
-	    offsetof(struct send_block_record, ln));
-	to_arg.error_code = 0;
-	to_arg.cancel = B_FALSE;
-	to_arg.ds = to_ds;
-	to_arg.fromtxg = fromtxg;
-	to_arg.flags = TRAVERSE_PRE | TRAVERSE_PREFETCH;
+	/*
+	 * Divide the objects of the dataset into ranges which are traversed
+	 * concurrently.  The ranges start on dnode block boundaries, so each
+	 * block of the meta-dnode is reported by exactly one of them (see
+	 * traverse_dataset_range()), and consuming the ranges in order
+	 * produces exactly the records a single traversal would.
+	 */
+	dnode_t *mdn = DMU_META_DNODE(os);
+	rw_enter(&mdn->dn_struct_rwlock, RW_READER);
+	uint64_t maxobj = (mdn->dn_maxblkid + 1) * DNODES_PER_BLOCK;
+	rw_exit(&mdn->dn_struct_rwlock);
+
+	uint64_t firstobj = P2ALIGN(resumeobj, DNODES_PER_BLOCK);
+	uint64_t nblocks = maxobj > firstobj ?
+	    (maxobj - firstobj) / DNODES_PER_BLOCK : 1;
+	nranges = MAX(zfs_send_traverse_threads, 1);
+	if (nranges > nblocks)
+		nranges = nblocks;
+	uint64_t stride = howmany(nblocks, nranges) * DNODES_PER_BLOCK;
+
+	int flags = TRAVERSE_PRE | TRAVERSE_PREFETCH;
+	if (zfs_send_prefetch_queue_length != 0)
+		flags = TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA;
 	if (rawok)
-		to_arg.flags |= TRAVERSE_NO_DECRYPT;
-	(void) thread_create(NULL, 0, send_traverse_thread, &to_arg, 0, curproc,
+		flags |= TRAVERSE_NO_DECRYPT;
+
+	ranges = kmem_zalloc(nranges * sizeof (*ranges), KM_SLEEP);
+	for (int i = 0; i < nranges; i++) {
+		struct send_thread_arg *range = &ranges[i];
+
+		(void) bqueue_init(&range->q,
+		    MAX(zfs_send_queue_length, 2 * zfs_max_recordsize),
+		    offsetof(struct send_block_record, ln));
+		range->error_code = 0;
+		range->cancel = B_FALSE;
+		range->ds = to_ds;
+		range->fromtxg = fromtxg;
+		range->flags = flags;
+		range->obj_start = (i == 0) ? 0 : firstobj + i * stride;
+		range->obj_end = (i == nranges - 1) ? DMU_OBJECT_END :
+		    firstobj + (i + 1) * stride;
+		if (i == 0)
+			range->resume = resume;
+	}
+
+	(void) bqueue_init(&spta.q,
+	    MAX(zfs_send_prefetch_queue_length, 2 * zfs_max_recordsize),
+	    offsetof(struct send_block_record, ln));
+	spta.spa = dp->dp_spa;
+	spta.ranges = ranges;
+	spta.nranges = nranges;
+	spta.issue_reads = (zfs_send_prefetch_queue_length != 0);
+	spta.rawok = rawok;
+	spta.cancel = B_FALSE;
+
+	for (int i = 0; i < nranges; i++) {
+		(void) thread_create(NULL, 0, send_traverse_thread, &ranges[i],
+		    0, curproc, TS_RUN, minclsyspri);
+	}
+	(void) thread_create(NULL, 0, send_prefetch_thread, &spta, 0, curproc,
 	    TS_RUN, minclsyspri);
 
 	struct send_block_record *to_data;
-	to_data = bqueue_dequeue(&to_arg.q);
+	to_data = bqueue_dequeue(&spta.q);
 
 	while (!to_data->eos_marker && err == 0) {
 		err = do_dump(dsp, to_data);
-		to_data = get_next_record(&to_arg.q, to_data);
+		to_data = get_next_record(&spta.q, to_data);
 		if (issig(JUSTLOOKING) && issig(FORREAL))
 			err = EINTR;
 	}
 
 	if (err != 0) {
-		to_arg.cancel = B_TRUE;
+		spta.cancel = B_TRUE;
+		for (int i = 0; i < nranges; i++)
+			ranges[i].cancel = B_TRUE;
 		while (!to_data->eos_marker) {
-			to_data = get_next_record(&to_arg.q, to_data);
+			to_data = get_next_record(&spta.q, to_data);
 		}
 	}
 	kmem_free(to_data, sizeof (*to_data));
 
-	bqueue_destroy(&to_arg.q);
-
-	if (err == 0 && to_arg.error_code != 0)
-		err = to_arg.error_code;
+	bqueue_destroy(&spta.q);
+	for (int i = 0; i < nranges; i++) {
+		if (err == 0 && ranges[i].error_code != 0)
+			err = ranges[i].error_code;
+		bqueue_destroy(&ranges[i].q);
+	}
+	kmem_free(ranges, nranges * sizeof (*ranges));
 
 	if (err != 0)
 		goto out;
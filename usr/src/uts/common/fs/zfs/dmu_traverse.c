@@ -65,6 +65,8 @@ typedef struct traverse_data {
 	blkptr_cb_t *td_func;
 	void *td_arg;
 	boolean_t td_realloc_possible;
+	uint64_t td_obj_start;
+	uint64_t td_obj_end;
 } traverse_data_t;
 
 static int traverse_dnode(traverse_data_t *td, const dnode_phys_t *dnp,
@@ -174,6 +176,22 @@ resume_skip_check(traverse_data_t *td, const dnode_phys_t *dnp,
 	return (RESUME_SKIP_NONE);
 }
 
+/*
+ * Returns B_TRUE if the given object lies outside of the range of objects
+ * this traversal is restricted to (see traverse_dataset_range()).  The
+ * special accounting objects are visited only by the traversal whose range
+ * extends to DMU_OBJECT_END.
+ */
+static boolean_t
+traverse_object_excluded(traverse_data_t *td, uint64_t object)
+{
+	if (object == DMU_META_DNODE_OBJECT)
+		return (B_FALSE);
+	if (DMU_OBJECT_IS_SPECIAL(object))
+		return (td->td_obj_end != DMU_OBJECT_END);
+	return (object < td->td_obj_start || object >= td->td_obj_end);
+}
+
 static void
 traverse_prefetch_metadata(traverse_data_t *td,
     const blkptr_t *bp, const zbookmark_phys_t *zb)
@@ -221,6 +239,7 @@ traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
 	arc_buf_t *buf = NULL;
 	prefetch_data_t *pd = td->td_pfd;
 	boolean_t hard = td->td_flags & TRAVERSE_HARD;
+	boolean_t report = B_TRUE;
 
 	switch (resume_skip_check(td, dnp, zb)) {
 	case RESUME_SKIP_ALL:
@@ -233,6 +252,34 @@ traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
 		ASSERT(0);
 	}
 
+	/*
+	 * When the traversal is restricted to a range of objects, skip the
+	 * blocks of the meta-dnode that hold no dnodes in that range.  A
+	 * block which straddles the start of the range is still descended
+	 * into, but it is reported only by the traversal whose range holds
+	 * the first dnode it covers, so that disjoint ranges visited one
+	 * after the other report exactly what a full traversal would.
+	 */
+	if (zb->zb_object == DMU_META_DNODE_OBJECT && zb->zb_level >= 0 &&
+	    (td->td_obj_start != 0 || td->td_obj_end != DMU_OBJECT_END)) {
+		uint64_t span = ((uint64_t)dnp->dn_datablkszsec <<
+		    (SPA_MINBLOCKSHIFT - DNODE_SHIFT)) << (zb->zb_level *
+		    (dnp->dn_indblkshift - SPA_BLKPTRSHIFT));
+		uint64_t first = zb->zb_blkid * span;
+
+		if (first >= td->td_obj_end ||
+		    first + span - 1 < td->td_obj_start)
+			return (0);
+		report = (first >= td->td_obj_start);
+	}
+
+	/*
+	 * Likewise the objset's root block is reported only by the
+	 * traversal whose range starts at the first object.
+	 */
+	if (zb->zb_level == ZB_ROOT_LEVEL && td->td_obj_start != 0)
+		report = B_FALSE;
+
 	if (bp->blk_birth == 0) {
 		/*
 		 * Since this block has a birth time of 0 it must be one of
@@ -265,7 +312,8 @@ traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
 		return (0);
 	}
 
-	if (pd != NULL && !pd->pd_exited && prefetch_needed(pd, bp)) {
+	if (report && pd != NULL && !pd->pd_exited &&
+	    prefetch_needed(pd, bp)) {
 		uint64_t size = BP_GET_LSIZE(bp);
 		mutex_enter(&pd->pd_mtx);
 		ASSERT(pd->pd_bytes_fetched >= 0);
@@ -277,13 +325,15 @@ traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
 	}
 
 	if (BP_IS_HOLE(bp)) {
+		if (!report)
+			return (0);
 		err = td->td_func(td->td_spa, NULL, bp, zb, dnp, td->td_arg);
 		if (err != 0)
 			goto post;
 		return (0);
 	}
 
-	if (td->td_flags & TRAVERSE_PRE) {
+	if (report && (td->td_flags & TRAVERSE_PRE)) {
 		err = td->td_func(td->td_spa, NULL, bp, zb, dnp,
 		    td->td_arg);
 		if (err == TRAVERSE_VISIT_NO_CHILDREN)
@@ -409,7 +459,7 @@ traverse_visitbp(traverse_data_t *td, const dnode_phys_t *dnp,
 		arc_buf_destroy(buf, &buf);
 
 post:
-	if (err == 0 && (td->td_flags & TRAVERSE_POST))
+	if (err == 0 && report && (td->td_flags & TRAVERSE_POST))
 		err = td->td_func(td->td_spa, NULL, bp, zb, dnp, td->td_arg);
 
 	if (hard && (err == EIO || err == ECKSUM)) {
@@ -455,6 +505,9 @@ prefetch_dnode_metadata(traverse_data_t *td, const dnode_phys_t *dnp,
 	int j;
 	zbookmark_phys_t czb;
 
+	if (traverse_object_excluded(td, object))
+		return;
+
 	for (j = 0; j < dnp->dn_nblkptr; j++) {
 		SET_BOOKMARK(&czb, objset, object, dnp->dn_nlevels - 1, j);
 		traverse_prefetch_metadata(td, &dnp->dn_blkptr[j], &czb);
@@ -477,6 +530,9 @@ traverse_dnode(traverse_data_t *td, const dnode_phys_t *dnp,
 	    object < td->td_resume->zb_object)
 		return (0);
 
+	if (traverse_object_excluded(td, object))
+		return (0);
+
 	if (td->td_flags & TRAVERSE_PRE) {
 		SET_BOOKMARK(&czb, objset, object, ZB_DNODE_LEVEL,
 		    ZB_DNODE_BLKID);
@@ -576,8 +632,8 @@ traverse_prefetch_thread(void *arg)
  */
 static int
 traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
-    uint64_t txg_start, zbookmark_phys_t *resume, int flags,
-    blkptr_cb_t func, void *arg)
+    uint64_t txg_start, zbookmark_phys_t *resume, uint64_t obj_start,
+    uint64_t obj_end, int flags, blkptr_cb_t func, void *arg)
 {
 	traverse_data_t td;
 	prefetch_data_t pd = { 0 };
@@ -598,6 +654,8 @@ traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
 	td.td_flags = flags;
 	td.td_paused = B_FALSE;
 	td.td_realloc_possible = (txg_start == 0 ? B_FALSE : B_TRUE);
+	td.td_obj_start = obj_start;
+	td.td_obj_end = obj_end;
 
 	if (spa_feature_is_active(spa, SPA_FEATURE_HOLE_BIRTH)) {
 		VERIFY(spa_feature_enabled_txg(spa,
@@ -616,7 +674,8 @@ traverse_impl(spa_t *spa, dsl_dataset_t *ds, uint64_t objset, blkptr_t *rootbp,
 	    ZB_ROOT_OBJECT, ZB_ROOT_LEVEL, ZB_ROOT_BLKID);
 
 	/* See comment on ZIL traversal in dsl_scan_visitds. */
-	if (ds != NULL && !ds->ds_is_snapshot && !BP_IS_HOLE(rootbp)) {
+	if (ds != NULL && !ds->ds_is_snapshot && !BP_IS_HOLE(rootbp) &&
+	    obj_start == 0) {
 		enum zio_flag zio_flags = ZIO_FLAG_CANFAIL;
 		arc_flags_t flags = ARC_FLAG_WAIT;
 		objset_phys_t *osp;
@@ -666,7 +725,32 @@ traverse_dataset_resume(dsl_dataset_t *ds, uint64_t txg_start,
     int flags, blkptr_cb_t func, void *arg)
 {
 	return (traverse_impl(ds->ds_dir->dd_pool->dp_spa, ds, ds->ds_object,
-	    &dsl_dataset_phys(ds)->ds_bp, txg_start, resume, flags, func, arg));
+	    &dsl_dataset_phys(ds)->ds_bp, txg_start, resume, 0, DMU_OBJECT_END,
+	    flags, func, arg));
+}
+
+/*
+ * Traverse only the objects in [obj_start, obj_end) of the dataset, along
+ * with the blocks of the meta-dnode that cover the first dnode of a block
+ * in that range.  Traversing a set of disjoint ranges that together span
+ * all objects, in order, visits the same blocks in the same order as a
+ * single traversal of the whole dataset, which allows several threads to
+ * divide the work of one traversal.  The ZIL and the special accounting
+ * objects are visited only by the ranges starting at object 0 and ending
+ * at DMU_OBJECT_END respectively.
+ *
+ * NB: dataset must not be changing on-disk (eg, is a snapshot or we are
+ * in syncing context).
+ */
+int
+traverse_dataset_range(dsl_dataset_t *ds, uint64_t txg_start,
+    zbookmark_phys_t *resume, uint64_t obj_start, uint64_t obj_end,
+    int flags, blkptr_cb_t func, void *arg)
+{
+	ASSERT3U(obj_start, <, obj_end);
+	return (traverse_impl(ds->ds_dir->dd_pool->dp_spa, ds, ds->ds_object,
+	    &dsl_dataset_phys(ds)->ds_bp, txg_start, resume, obj_start,
+	    obj_end, flags, func, arg));
 }
 
 int
@@ -682,7 +766,21 @@ traverse_dataset_destroyed(spa_t *spa, blkptr_t *blkptr,
     blkptr_cb_t func, void *arg)
 {
 	return (traverse_impl(spa, NULL, ZB_DESTROYED_OBJSET,
-	    blkptr, txg_start, resume, flags, func, arg));
+	    blkptr, txg_start, resume, 0, DMU_OBJECT_END, flags, func, arg));
+}
+
+/*
+ * Traverse the MOS alone; traverse_pool() does this before it visits each
+ * dataset, and callers that divide the datasets among threads do the same.
+ *
+ * NB: pool must not be changing on-disk (eg, from zdb or sync context).
+ */
+int
+traverse_pool_mos(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void *arg)
+{
+	return (traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
+	    txg_start, NULL, 0, DMU_OBJECT_END, flags, func, arg));
 }
 
 /*
@@ -698,8 +796,7 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 	boolean_t hard = (flags & TRAVERSE_HARD);
 
 	/* visit the MOS */
-	err = traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
-	    txg_start, NULL, flags, func, arg);
+	err = traverse_pool_mos(spa, txg_start, flags, func, arg);
 	if (err != 0)
 		return (err);
 
@@ -334,6 +334,37 @@ dmu_tx_hold_write_by_dnode(dmu_tx_t *tx, dnode_t *dn, uint64_t off, int len)
 	}
 }
 
+/*
+ * Hold a range of an object that dmu_brt_clone() will point at existing
+ * blocks.  No data is written, only the indirect blocks above the range.
+ */
+void
+dmu_tx_hold_clone(dmu_tx_t *tx, uint64_t object, uint64_t off, uint64_t len)
+{
+	dmu_tx_hold_t *txh;
+
+	ASSERT0(tx->tx_txg);
+	ASSERT3U(len, <=, DMU_MAX_ACCESS);
+	ASSERT(len == 0 || UINT64_MAX - off >= len - 1);
+
+	txh = dmu_tx_hold_object_impl(tx, tx->tx_objset,
+	    object, THT_CLONE, off, len);
+	if (txh == NULL)
+		return;
+
+	dnode_t *dn = txh->txh_dnode;
+	if (dn != NULL && len != 0) {
+		int epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+		uint64_t start = off / dn->dn_datablksz;
+		uint64_t end = (off + len - 1) / dn->dn_datablksz;
+		uint64_t nl1 = (end >> epbs) - (start >> epbs) + 1;
+
+		(void) zfs_refcount_add_many(&txh->txh_space_towrite,
+		    nl1 << dn->dn_indblkshift, FTAG);
+	}
+	dmu_tx_count_dnode(txh);
+}
+
 /*
  * This function marks the transaction as being a "net free".  The end
  * result is that refquotas will be disabled for this transaction, and
@@ -650,6 +681,16 @@ dmu_tx_dirty_buf(dmu_tx_t *tx, dmu_buf_impl_t *db)
 				    txh->txh_arg2 == DMU_OBJECT_END))
 					match_offset = TRUE;
 				break;
+			case THT_CLONE:
+				if (blkid >= beginblk && blkid <= endblk)
+					match_offset = TRUE;
+				/*
+				 * The block size of an empty destination
+				 * may be changed to match the source.
+				 */
+				if (blkid == 0)
+					match_offset = TRUE;
+				break;
 			case THT_SPILL:
 				if (blkid == DMU_SPILL_BLKID)
 					match_offset = TRUE;
@@ -53,6 +53,14 @@ uint32_t	zfetch_max_distance = 8 * 1024 * 1024;
 uint32_t	zfetch_max_idistance = 64 * 1024 * 1024;
 /* max number of bytes in an array_read in which we allow prefetching (1MB) */
 uint64_t	zfetch_array_rd_sz = 1024 * 1024;
+/* max bytes between the accesses of a strided stream (default 64MB) */
+uint32_t	zfetch_max_stride = 64 * 1024 * 1024;
+/* scale the prefetch distance to each stream's latency and access rate */
+boolean_t	zfetch_adaptive_distance = B_TRUE;
+/* min bytes to prefetch per stream when adapting (default 2MB) */
+uint32_t	zfetch_min_distance = 2 * 1024 * 1024;
+/* prefetch completions remembered per stream when adapting */
+uint32_t	zfetch_adapt_window = 256;
 
 typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_hits;
@@ -61,6 +69,13 @@ typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_max_completion_us;
 	kstat_named_t zfetchstat_last_completion_us;
 	kstat_named_t zfetchstat_io_issued;
+	kstat_named_t zfetchstat_strides_detected;
+	kstat_named_t zfetchstat_sequential_hits;
+	kstat_named_t zfetchstat_sequential_misses;
+	kstat_named_t zfetchstat_strided_hits;
+	kstat_named_t zfetchstat_strided_misses;
+	kstat_named_t zfetchstat_backward_hits;
+	kstat_named_t zfetchstat_backward_misses;
 } zfetch_stats_t;
 
 static zfetch_stats_t zfetch_stats = {
@@ -70,6 +85,13 @@ static zfetch_stats_t zfetch_stats = {
 	{ "max_completion_us",		KSTAT_DATA_UINT64 },
 	{ "last_completion_us",		KSTAT_DATA_UINT64 },
 	{ "io_issued",		KSTAT_DATA_UINT64 },
+	{ "strides_detected",		KSTAT_DATA_UINT64 },
+	{ "sequential_hits",		KSTAT_DATA_UINT64 },
+	{ "sequential_misses",		KSTAT_DATA_UINT64 },
+	{ "strided_hits",		KSTAT_DATA_UINT64 },
+	{ "strided_misses",		KSTAT_DATA_UINT64 },
+	{ "backward_hits",		KSTAT_DATA_UINT64 },
+	{ "backward_misses",		KSTAT_DATA_UINT64 },
 };
 
 #define	ZFETCHSTAT_BUMP(stat) \
@@ -81,6 +103,22 @@ static zfetch_stats_t zfetch_stats = {
 #define	ZFETCHSTAT_GET(stat)					\
 	zfetch_stats.stat.value.ui64
 
+/*
+ * The per-pattern statistics count, for the streams of each access
+ * pattern, the accesses that hit the stream ("hits") and the prefetched
+ * blocks that were never accessed before the stream went away ("misses").
+ */
+#define	ZFETCHSTAT_PATTERN_ADD(stride, seq, strided, backward, val)	\
+	atomic_add_64((stride) == 0 ? &zfetch_stats.seq.value.ui64 :	\
+	    (stride) > 0 ? &zfetch_stats.strided.value.ui64 :		\
+	    &zfetch_stats.backward.value.ui64, val)
+#define	ZFETCHSTAT_PATTERN_HIT(stride)				\
+	ZFETCHSTAT_PATTERN_ADD(stride, zfetchstat_sequential_hits,	\
+	    zfetchstat_strided_hits, zfetchstat_backward_hits, 1)
+#define	ZFETCHSTAT_PATTERN_MISSES(stride, val)			\
+	ZFETCHSTAT_PATTERN_ADD(stride, zfetchstat_sequential_misses,	\
+	    zfetchstat_strided_misses, zfetchstat_backward_misses, val)
+
 
 kstat_t		*zfetch_ksp;
 
@@ -118,6 +156,8 @@ dmu_zfetch_init(zfetch_t *zf, dnode_t *dno)
 		return;
 	zf->zf_dnode = dno;
 	zf->zf_numstreams = 0;
+	zf->zf_hist_next = 0;
+	zf->zf_hist_count = 0;
 
 	list_create(&zf->zf_stream, sizeof (zstream_t),
 	    offsetof(zstream_t, zs_node));
@@ -132,10 +172,30 @@ dmu_zfetch_stream_fini(zstream_t *zs)
 	kmem_free(zs, sizeof (*zs));
 }
 
+/*
+ * Account for the blocks this stream prefetched beyond its last access,
+ * which will never be used by it.
+ */
+static void
+dmu_zfetch_stream_unused(zstream_t *zs)
+{
+	int64_t unused;
+
+	if (zs->zs_stride == 0) {
+		unused = zs->zs_pf_blkid - zs->zs_blkid;
+	} else {
+		unused = ((int64_t)zs->zs_pf_blkid - (int64_t)zs->zs_blkid) /
+		    zs->zs_stride * zs->zs_nblks;
+	}
+	if (unused > 0)
+		ZFETCHSTAT_PATTERN_MISSES(zs->zs_stride, unused);
+}
+
 static void
 dmu_zfetch_stream_remove(zfetch_t *zf, zstream_t *zs)
 {
 	ASSERT(RW_WRITE_HELD(&zf->zf_rwlock));
+	dmu_zfetch_stream_unused(zs);
 	list_remove(&zf->zf_stream, zs);
 	dmu_zfetch_stream_fini(zs);
 	zf->zf_numstreams--;
@@ -145,6 +205,7 @@ static void
 dmu_zfetch_stream_orphan(zfetch_t *zf, zstream_t *zs)
 {
 	ASSERT(RW_WRITE_HELD(&zf->zf_rwlock));
+	dmu_zfetch_stream_unused(zs);
 	list_remove(&zf->zf_stream, zs);
 	zs->zs_fetch = NULL;
 	zf->zf_numstreams--;
@@ -174,11 +235,13 @@ dmu_zfetch_fini(zfetch_t *zf)
 /*
  * If there aren't too many streams already, create a new stream.
  * The "blkid" argument is the next block that we expect this stream to access.
- * While we're here, clean up old streams (which haven't been
+ * A non-zero "stride" makes it a strided stream whose accesses are "nblks"
+ * blocks long.  While we're here, clean up old streams (which haven't been
  * accessed for at least zfetch_min_sec_reap seconds).
  */
 static void
-dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
+dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid, int64_t stride,
+    uint64_t nblks)
 {
 	zstream_t *zs_next;
 	hrtime_t now = gethrtime();
@@ -221,6 +284,8 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 	zs->zs_blkid = blkid;
 	zs->zs_pf_blkid = blkid;
 	zs->zs_ipf_blkid = blkid;
+	zs->zs_stride = stride;
+	zs->zs_nblks = nblks;
 	zs->zs_atime = now;
 	zs->zs_fetch = zf;
 	zfs_refcount_create(&zs->zs_blocks);
@@ -236,13 +301,20 @@ dmu_zfetch_stream_done(void *arg, boolean_t io_issued)
 
 	if (zs->zs_start_time && io_issued) {
 		hrtime_t now = gethrtime();
-		hrtime_t delta = NSEC2USEC(now - zs->zs_start_time);
+		hrtime_t latency = now - zs->zs_start_time;
+		hrtime_t delta = NSEC2USEC(latency);
 
 		zs->zs_start_time = 0;
+		zs->zs_latency = zs->zs_latency == 0 ? latency :
+		    (7 * zs->zs_latency + latency) / 8;
 		ZFETCHSTAT_SET(zfetchstat_last_completion_us, delta);
 		if (delta > ZFETCHSTAT_GET(zfetchstat_max_completion_us))
 			ZFETCHSTAT_SET(zfetchstat_max_completion_us, delta);
 	}
+	if (io_issued)
+		atomic_inc_32(&zs->zs_pf_issued);
+	else
+		atomic_inc_32(&zs->zs_pf_cached);
 
 	if (zfs_refcount_remove(&zs->zs_blocks, NULL) != 0)
 		return;
@@ -254,10 +326,173 @@ dmu_zfetch_stream_done(void *arg, boolean_t io_issued)
 		dmu_zfetch_stream_fini(zs);
 }
 
+/*
+ * Note an access to the stream, updating the average time between its
+ * accesses and ageing its record of how its prefetches completed.
+ */
+static void
+dmu_zfetch_stream_access(zstream_t *zs, hrtime_t now)
+{
+	hrtime_t interval = now - zs->zs_atime;
+
+	ASSERT(MUTEX_HELD(&zs->zs_lock));
+
+	zs->zs_interval = zs->zs_interval == 0 ? interval :
+	    (7 * zs->zs_interval + interval) / 8;
+	if (zs->zs_pf_issued + zs->zs_pf_cached > zfetch_adapt_window) {
+		zs->zs_pf_issued /= 2;
+		zs->zs_pf_cached /= 2;
+	}
+	zs->zs_atime = now;
+}
+
+/*
+ * Work out how far ahead of the reader this stream should prefetch, in
+ * blocks, given accesses of "nblks" blocks.  To hide the latency of the
+ * prefetches, enough accesses must be in flight to cover the time one
+ * prefetch takes at the rate the stream is read; we aim for twice that.
+ * A stream whose prefetches nearly always find their blocks already
+ * cached gains nothing from reading far ahead, so it gets the minimum.
+ * Until the stream has been timed, it may use the full distance.
+ */
+static uint64_t
+dmu_zfetch_distance(zstream_t *zs, uint64_t nblks, uint64_t max_blks,
+    int datablkshift)
+{
+	uint64_t min_blks, want;
+	uint32_t issued = zs->zs_pf_issued;
+	uint32_t cached = zs->zs_pf_cached;
+
+	if (!zfetch_adaptive_distance)
+		return (max_blks);
+
+	min_blks = MIN(max_blks,
+	    MAX(nblks, zfetch_min_distance >> datablkshift));
+	if (issued + cached >= zfetch_adapt_window / 4 &&
+	    cached > 7 * issued)
+		return (min_blks);
+	if (zs->zs_interval == 0 || zs->zs_latency == 0)
+		return (max_blks);
+
+	want = (2 * zs->zs_latency / zs->zs_interval + 1) * nblks;
+	return (MIN(max_blks, MAX(min_blks, want)));
+}
+
+/*
+ * Look for a constant stride among the recent accesses that matched no
+ * stream: if this access continues an arithmetic progression of two of
+ * them (which may have been interleaved with other accesses), the reader
+ * is walking the object forwards or backwards with that stride.  Plain
+ * sequential access is left to the sequential streams.  The access is
+ * remembered either way.  Returns the stride found, or 0.
+ */
+static int64_t
+dmu_zfetch_stride_detect(zfetch_t *zf, uint64_t blkid, uint64_t nblks)
+{
+	int64_t max_stride =
+	    zfetch_max_stride >> zf->zf_dnode->dn_datablkshift;
+	int64_t stride = 0;
+
+	ASSERT(RW_WRITE_HELD(&zf->zf_rwlock));
+
+	for (int i = 0; i < zf->zf_hist_count && stride == 0; i++) {
+		int64_t delta = blkid - zf->zf_hist[i];
+
+		if (delta == 0 || delta == (int64_t)nblks ||
+		    delta > max_stride || -delta > max_stride)
+			continue;
+		for (int j = 0; j < zf->zf_hist_count; j++) {
+			if (zf->zf_hist[i] - zf->zf_hist[j] == delta) {
+				stride = delta;
+				break;
+			}
+		}
+	}
+
+	zf->zf_hist[zf->zf_hist_next] = blkid;
+	zf->zf_hist_next = (zf->zf_hist_next + 1) % ZFETCH_HIST_SIZE;
+	if (zf->zf_hist_count < ZFETCH_HIST_SIZE)
+		zf->zf_hist_count++;
+
+	return (stride);
+}
+
+/*
+ * Issue further prefetches for a strided stream that has just been accessed
+ * at "blkid".  Like the sequential case, the number of accesses prefetched
+ * ahead of the reader doubles on each hit, up to the stream's distance.
+ * If "fetch_data" is not set the stream only follows the reader, since
+ * the indirect blocks of a strided stream are read along with its data.
+ * Called with zs_lock and zf_rwlock held, and drops them.  Returns the
+ * number of prefetch i/os issued.
+ */
+static int
+dmu_zfetch_stride(zfetch_t *zf, zstream_t *zs, uint64_t blkid,
+    boolean_t fetch_data, hrtime_t now)
+{
+	dnode_t *dn = zf->zf_dnode;
+	int64_t stride = zs->zs_stride;
+	int64_t nblks = zs->zs_nblks;
+	int64_t ahead, want, pf_start, pf_naccess;
+	uint64_t dist_blks;
+	int issued = 0;
+
+	ASSERT(MUTEX_HELD(&zs->zs_lock));
+	ASSERT3S(stride, !=, 0);
+	ASSERT3S(nblks, >, 0);
+
+	dist_blks = dmu_zfetch_distance(zs, nblks,
+	    MAX(nblks, zfetch_max_distance >> dn->dn_datablkshift),
+	    dn->dn_datablkshift);
+
+	/*
+	 * Count the accesses we prefetched beyond this one last time; if
+	 * the reader has caught up, start with the next access.
+	 */
+	ahead = ((int64_t)zs->zs_pf_blkid - (int64_t)blkid) / stride - 1;
+	if (ahead < 0) {
+		ahead = 0;
+		zs->zs_pf_blkid = blkid + stride;
+	}
+	want = fetch_data ? MIN(dist_blks / nblks, MAX(2, 2 * ahead)) : 0;
+	pf_start = zs->zs_pf_blkid;
+
+	/* Don't run off either end of the object. */
+	for (pf_naccess = 0; pf_naccess < want - ahead; pf_naccess++) {
+		int64_t start = pf_start + pf_naccess * stride;
+
+		if (start < 0 || start > (int64_t)dn->dn_maxblkid)
+			break;
+	}
+
+	zs->zs_pf_blkid = pf_start + pf_naccess * stride;
+	zs->zs_blkid = blkid + stride;
+	dmu_zfetch_stream_access(zs, now);
+	/* no prior reads in progress */
+	if (zfs_refcount_count(&zs->zs_blocks) == 0)
+		zs->zs_start_time = now;
+	zfs_refcount_add_many(&zs->zs_blocks, pf_naccess * nblks, NULL);
+	mutex_exit(&zs->zs_lock);
+	rw_exit(&zf->zf_rwlock);
+
+	for (int64_t i = 0; i < pf_naccess; i++) {
+		for (int64_t j = 0; j < nblks; j++) {
+			issued += dbuf_prefetch_impl(dn, 0,
+			    pf_start + i * stride + j, ZIO_PRIORITY_ASYNC_READ,
+			    ARC_FLAG_PREDICTIVE_PREFETCH,
+			    dmu_zfetch_stream_done, zs);
+		}
+	}
+
+	return (issued);
+}
+
 /*
  * This is the predictive prefetch entry point.  It associates dnode access
  * specified with blkid and nblks arguments with prefetch stream, predicts
  * further accesses based on that stats and initiates speculative prefetch.
+ * Besides sequential streams, forward or backward streams with a fixed
+ * stride between accesses are recognized (see dmu_zfetch_stride_detect()).
  * fetch_data argument specifies whether actual data blocks should be fetched:
  *   FALSE -- prefetch only indirect blocks for predicted data blocks;
  *   TRUE -- prefetch predicted data blocks plus following indirect blocks.
@@ -315,6 +550,16 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data,
 	 */
 	for (zs = list_head(&zf->zf_stream); zs != NULL;
 	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_stride != 0) {
+			/* strided streams must match exactly */
+			if (blkid == zs->zs_blkid) {
+				mutex_enter(&zs->zs_lock);
+				if (blkid == zs->zs_blkid)
+					break;
+				mutex_exit(&zs->zs_lock);
+			}
+			continue;
+		}
 		if (blkid == zs->zs_blkid || blkid + 1 == zs->zs_blkid) {
 			mutex_enter(&zs->zs_lock);
 			/*
@@ -348,14 +593,39 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data,
 		 * a new stream for it.
 		 */
 		ZFETCHSTAT_BUMP(zfetchstat_misses);
-		if (rw_tryupgrade(&zf->zf_rwlock))
-			dmu_zfetch_stream_create(zf, end_of_access_blkid);
+		if (rw_tryupgrade(&zf->zf_rwlock)) {
+			int64_t stride = dmu_zfetch_stride_detect(zf, blkid,
+			    nblks);
+
+			if (stride != 0) {
+				ZFETCHSTAT_BUMP(zfetchstat_strides_detected);
+				dmu_zfetch_stream_create(zf, blkid + stride,
+				    stride, nblks);
+			} else {
+				dmu_zfetch_stream_create(zf,
+				    end_of_access_blkid, 0, 0);
+			}
+		}
 		rw_exit(&zf->zf_rwlock);
 		if (!have_lock)
 			rw_exit(&zf->zf_dnode->dn_struct_rwlock);
 		return;
 	}
 
+	if (zs->zs_stride != 0) {
+		int64_t stride = zs->zs_stride;
+
+		issued = dmu_zfetch_stride(zf, zs, blkid, fetch_data,
+		    gethrtime());
+		if (!have_lock)
+			rw_exit(&zf->zf_dnode->dn_struct_rwlock);
+		ZFETCHSTAT_BUMP(zfetchstat_hits);
+		ZFETCHSTAT_PATTERN_HIT(stride);
+		if (issued)
+			ZFETCHSTAT_ADD(zfetchstat_io_issued, issued);
+		return;
+	}
+
 	/*
 	 * This access was to a block that we issued a prefetch for on
 	 * behalf of this stream. Issue further prefetches for this stream.
@@ -370,11 +640,13 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data,
 
 	/*
 	 * Double our amount of prefetched data, but don't let the
-	 * prefetch get further ahead than zfetch_max_distance.
+	 * prefetch get further ahead than zfetch_max_distance, or than
+	 * this stream needs (see dmu_zfetch_distance()).
 	 */
 	if (fetch_data) {
-		max_dist_blks =
-		    zfetch_max_distance >> zf->zf_dnode->dn_datablkshift;
+		max_dist_blks = dmu_zfetch_distance(zs, nblks,
+		    zfetch_max_distance >> zf->zf_dnode->dn_datablkshift,
+		    zf->zf_dnode->dn_datablkshift);
 		/*
 		 * Previously, we were (zs_pf_blkid - blkid) ahead.  We
 		 * want to now be double that, so read that amount again,
@@ -413,7 +685,7 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data,
 	ipf_istart = P2ROUNDUP(ipf_start, 1 << epbs) >> epbs;
 	ipf_iend = P2ROUNDUP(zs->zs_ipf_blkid, 1 << epbs) >> epbs;
 
-	zs->zs_atime = gethrtime();
+	dmu_zfetch_stream_access(zs, gethrtime());
 	/* no prior reads in progress */
 	if (zfs_refcount_count(&zs->zs_blocks) == 0)
 		zs->zs_start_time = zs->zs_atime;
@@ -443,6 +715,7 @@ dmu_zfetch(zfetch_t *zf, uint64_t blkid, uint64_t nblks, boolean_t fetch_data,
 	if (!have_lock)
 		rw_exit(&zf->zf_dnode->dn_struct_rwlock);
 	ZFETCHSTAT_BUMP(zfetchstat_hits);
+	ZFETCHSTAT_BUMP(zfetchstat_sequential_hits);
 
 	if (issued)
 		ZFETCHSTAT_ADD(zfetchstat_io_issued, issued);
@@ -704,15 +704,23 @@ dsl_scan_sync_state(dsl_scan_t *scn, dmu_tx_t *tx, state_sync_type_t sync_type)
 	}
 }
 
-/* ARGSUSED */
+typedef struct dsl_scan_setup_arg {
+	pool_scan_func_t	dssa_func;
+	uint64_t		dssa_min_txg;	/* scan blocks born after it */
+} dsl_scan_setup_arg_t;
+
 static int
 dsl_scan_setup_check(void *arg, dmu_tx_t *tx)
 {
+	dsl_scan_setup_arg_t *dssa = arg;
 	dsl_scan_t *scn = dmu_tx_pool(tx)->dp_scan;
 
 	if (dsl_scan_is_running(scn))
 		return (SET_ERROR(EBUSY));
 
+	if (dssa->dssa_min_txg >= tx->tx_txg)
+		return (SET_ERROR(EINVAL));
+
 	return (0);
 }
 
@@ -720,13 +728,15 @@ static void
 dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
 {
 	dsl_scan_t *scn = dmu_tx_pool(tx)->dp_scan;
-	pool_scan_func_t *funcp = arg;
+	dsl_scan_setup_arg_t *dssa = arg;
+	pool_scan_func_t *funcp = &dssa->dssa_func;
 	dmu_object_type_t ot = 0;
 	dsl_pool_t *dp = scn->scn_dp;
 	spa_t *spa = dp->dp_spa;
 
 	ASSERT(!dsl_scan_is_running(scn));
 	ASSERT(*funcp > POOL_SCAN_NONE && *funcp < POOL_SCAN_FUNCS);
+	ASSERT(dssa->dssa_min_txg == 0 || *funcp == POOL_SCAN_SCRUB);
 	bzero(&scn->scn_phys, sizeof (scn->scn_phys));
 	scn->scn_phys.scn_func = *funcp;
 	scn->scn_phys.scn_state = DSS_SCANNING;
@@ -754,6 +764,16 @@ dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
 			spa_event_notify(spa, NULL, NULL,
 			    ESC_ZFS_RESILVER_START);
 		} else {
+			/*
+			 * An incremental scrub only verifies the blocks born
+			 * after the given txg.  Like a resilver, it prunes
+			 * the traversal at the older block pointers, all of
+			 * whose children are older still.  A scrub that
+			 * finds DTLs to repair covers their range instead.
+			 */
+			scn->scn_phys.scn_min_txg = dssa->dssa_min_txg;
+			if (dssa->dssa_min_txg != 0)
+				scn->scn_phys.scn_flags |= DSF_INCREMENTAL;
 			spa_event_notify(spa, NULL, NULL, ESC_ZFS_SCRUB_START);
 		}
 
@@ -795,13 +815,16 @@ dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
 
 /*
  * Called by the ZFS_IOC_POOL_SCAN ioctl to start a scrub or resilver.
- * Can also be called to resume a paused scrub.
+ * Can also be called to resume a paused scrub, which then carries on over
+ * the range of txgs it was started with.  A non-zero min_txg limits a scrub
+ * to the blocks born after that txg.
  */
 int
-dsl_scan(dsl_pool_t *dp, pool_scan_func_t func)
+dsl_scan(dsl_pool_t *dp, pool_scan_func_t func, uint64_t min_txg)
 {
 	spa_t *spa = dp->dp_spa;
 	dsl_scan_t *scn = dp->dp_scan;
+	dsl_scan_setup_arg_t dssa;
 
 	/*
 	 * Purge all vdev caches and probe all devices.  We do this here
@@ -822,6 +845,13 @@ dsl_scan(dsl_pool_t *dp, pool_scan_func_t func)
 	}
 
 	if (func == POOL_SCAN_SCRUB && dsl_scan_is_paused_scrub(scn)) {
+		/*
+		 * A paused scrub resumes over the range it was started with,
+		 * so it cannot take on a new bound.
+		 */
+		if (min_txg != 0)
+			return (SET_ERROR(EBUSY));
+
 		/* got scrub start cmd, resume paused scrub */
 		int err = dsl_scrub_set_pause_resume(scn->scn_dp,
 		    POOL_SCRUB_NORMAL);
@@ -832,8 +862,10 @@ dsl_scan(dsl_pool_t *dp, pool_scan_func_t func)
 		return (SET_ERROR(err));
 	}
 
+	dssa.dssa_func = func;
+	dssa.dssa_min_txg = min_txg;
 	return (dsl_sync_task(spa_name(spa), dsl_scan_setup_check,
-	    dsl_scan_setup_sync, &func, 0, ZFS_SPACE_CHECK_EXTRA_RESERVED));
+	    dsl_scan_setup_sync, &dssa, 0, ZFS_SPACE_CHECK_EXTRA_RESERVED));
 }
 
 /* ARGSUSED */
@@ -903,6 +935,12 @@ dsl_scan_done(dsl_scan_t *scn, boolean_t complete, dmu_tx_t *tx)
 		    "errors=%llu", spa_get_errlog_size(spa));
 
 	if (DSL_SCAN_IS_SCRUB_RESILVER(scn)) {
+		boolean_t incremental =
+		    (scn->scn_phys.scn_flags & DSF_INCREMENTAL) != 0;
+		boolean_t resilver = !incremental &&
+		    (scn->scn_phys.scn_func == POOL_SCAN_RESILVER ||
+		    scn->scn_phys.scn_min_txg != 0);
+
 		spa->spa_scrub_active = B_FALSE;
 
 		/*
@@ -913,19 +951,20 @@ dsl_scan_done(dsl_scan_t *scn, boolean_t complete, dmu_tx_t *tx)
 		 * As the scrub does not currently support traversing
 		 * data that have been freed but are part of a checkpoint,
 		 * we don't mark the scrub as done in the DTLs as faults
-		 * may still exist in those vdevs.
+		 * may still exist in those vdevs.  Nor does an incremental
+		 * scrub, which skipped the blocks born before scn_min_txg.
 		 */
 		if (complete &&
 		    !spa_feature_is_active(spa, SPA_FEATURE_POOL_CHECKPOINT)) {
 			vdev_dtl_reassess(spa->spa_root_vdev, tx->tx_txg,
-			    scn->scn_phys.scn_max_txg, B_TRUE);
+			    incremental ? 0 : scn->scn_phys.scn_max_txg, B_TRUE,
+			    B_FALSE);
 
-			spa_event_notify(spa, NULL, NULL,
-			    scn->scn_phys.scn_min_txg ?
+			spa_event_notify(spa, NULL, NULL, resilver ?
 			    ESC_ZFS_RESILVER_FINISH : ESC_ZFS_SCRUB_FINISH);
 		} else {
 			vdev_dtl_reassess(spa->spa_root_vdev, tx->tx_txg,
-			    0, B_TRUE);
+			    0, B_TRUE, B_FALSE);
 		}
 		spa_errlog_rotate(spa);
 
@@ -3399,13 +3438,13 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 	 */
 	if (dsl_scan_restarting(scn, tx) ||
 	    (spa->spa_resilver_deferred && zfs_resilver_disable_defer)) {
-		pool_scan_func_t func = POOL_SCAN_SCRUB;
+		dsl_scan_setup_arg_t dssa = { POOL_SCAN_SCRUB, 0 };
 		dsl_scan_done(scn, B_FALSE, tx);
 		if (vdev_resilver_needed(spa->spa_root_vdev, NULL, NULL))
-			func = POOL_SCAN_RESILVER;
+			dssa.dssa_func = POOL_SCAN_RESILVER;
 		zfs_dbgmsg("restarting scan func=%u txg=%llu",
-		    func, (longlong_t)tx->tx_txg);
-		dsl_scan_setup_sync(&func, tx);
+		    dssa.dssa_func, (longlong_t)tx->tx_txg);
+		dsl_scan_setup_sync(&dssa, tx);
 	}
 
 	/*
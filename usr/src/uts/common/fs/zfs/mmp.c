@@ -316,7 +316,10 @@ mmp_next_leaf(spa_t *spa)
 		if (leaf == NULL)
 			leaf = list_head(&spa->spa_leaf_list);
 
-		if (!vdev_writeable(leaf)) {
+		if (leaf->vdev_ops == &vdev_draid_spare_ops) {
+			/* Distributed spares have no uberblocks of their own */
+			continue;
+		} else if (!vdev_writeable(leaf)) {
 			fail_mask |= MMP_FAIL_NOT_WRITABLE;
 		} else if (leaf->vdev_mmp_pending != 0) {
 			fail_mask |= MMP_FAIL_WRITE_PENDING;
@@ -52,12 +52,16 @@
 #include <sys/zap.h>
 #include <sys/zil.h>
 #include <sys/ddt.h>
+#include <sys/brt.h>
 #include <sys/vdev_impl.h>
 #include <sys/vdev_removal.h>
 #include <sys/vdev_indirect_mapping.h>
 #include <sys/vdev_indirect_births.h>
 #include <sys/vdev_initialize.h>
 #include <sys/vdev_trim.h>
+#include <sys/vdev_draid.h>
+#include <sys/vdev_rebuild.h>
+#include <sys/vdev_raidz.h>
 #include <sys/metaslab.h>
 #include <sys/metaslab_impl.h>
 #include <sys/mmp.h>
@@ -313,6 +317,12 @@ spa_prop_get_config(spa_t *spa, nvlist_t **nvp)
 
 		spa_prop_add_list(*nvp, ZPOOL_PROP_DEDUPRATIO, NULL,
 		    ddt_get_pool_dedup_ratio(spa), src);
+		spa_prop_add_list(*nvp, ZPOOL_PROP_BCLONEUSED, NULL,
+		    brt_get_used(spa), src);
+		spa_prop_add_list(*nvp, ZPOOL_PROP_BCLONESAVED, NULL,
+		    brt_get_saved(spa), src);
+		spa_prop_add_list(*nvp, ZPOOL_PROP_BCLONERATIO, NULL,
+		    brt_get_ratio(spa), src);
 
 		spa_prop_add_list(*nvp, ZPOOL_PROP_HEALTH, NULL,
 		    rvd->vdev_state, src);
@@ -1451,6 +1461,7 @@ spa_unload(spa_t *spa)
 		vdev_initialize_stop_all(root_vdev, VDEV_INITIALIZE_ACTIVE);
 		vdev_trim_stop_all(root_vdev, VDEV_TRIM_ACTIVE);
 		vdev_autotrim_stop_all(spa);
+		vdev_rebuild_stop_all(spa);
 	}
 
 	/*
@@ -1501,6 +1512,11 @@ spa_unload(spa_t *spa)
 		spa->spa_checkpoint_discard_zthr = NULL;
 	}
 
+	if (spa->spa_raidz_expand_zthr != NULL) {
+		zthr_destroy(spa->spa_raidz_expand_zthr);
+		spa->spa_raidz_expand_zthr = NULL;
+	}
+
 	spa_condense_fini(spa);
 
 	bpobj_close(&spa->spa_deferred_bpobj);
@@ -1523,7 +1539,10 @@ spa_unload(spa_t *spa)
 		spa->spa_meta_objset = NULL;
 	}
 
+	vdev_raidz_expand_fini(spa);
+
 	ddt_unload(spa);
+	brt_unload(spa);
 	spa_unload_log_sm_metadata(spa);
 
 	/*
@@ -2289,6 +2308,8 @@ spa_spawn_aux_threads(spa_t *spa)
 	spa->spa_checkpoint_discard_zthr =
 	    zthr_create(spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa);
+
+	vdev_raidz_expand_start_thread(spa);
 }
 
 /*
@@ -2951,6 +2972,14 @@ spa_ld_select_uberblock_done(spa_t *spa, uberblock_t *ub)
 	    spa->spa_last_ubsync_txg : spa_last_synced_txg(spa) + 1;
 	spa->spa_claim_max_txg = spa->spa_first_txg;
 	spa->spa_prev_software_version = ub->ub_software_version;
+
+	/*
+	 * If a raidz expansion is in progress, we need to know how far it has
+	 * got before we can read anything from the expanding vdev.
+	 */
+	vdev_raidz_expand_fini(spa);
+	if (RRSS_GET_ACTIVE(ub))
+		vdev_raidz_expand_init(spa, RRSS_GET_OFFSET(ub));
 }
 
 static int
@@ -3731,6 +3760,13 @@ spa_ld_load_vdev_metadata(spa_t *spa)
 		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, error));
 	}
 
+	error = vdev_raidz_expand_load(spa);
+	if (error != 0) {
+		spa_load_failed(spa, "vdev_raidz_expand_load failed "
+		    "[error=%d]", error);
+		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, error));
+	}
+
 	error = spa_ld_log_spacemaps(spa);
 	if (error != 0) {
 		spa_load_failed(spa, "spa_ld_log_sm_data failed [error=%d]",
@@ -3742,7 +3778,7 @@ spa_ld_load_vdev_metadata(spa_t *spa)
 	 * Propagate the leaf DTLs we just loaded all the way up the vdev tree.
 	 */
 	spa_config_enter(spa, SCL_ALL, FTAG, RW_WRITER);
-	vdev_dtl_reassess(rvd, 0, 0, B_FALSE);
+	vdev_dtl_reassess(rvd, 0, 0, B_FALSE, B_FALSE);
 	spa_config_exit(spa, SCL_ALL, FTAG);
 
 	return (0);
@@ -3760,6 +3796,12 @@ spa_ld_load_dedup_tables(spa_t *spa)
 		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
 	}
 
+	error = brt_load(spa);
+	if (error != 0) {
+		spa_load_failed(spa, "brt_load failed [error=%d]", error);
+		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
+	}
+
 	return (0);
 }
 
@@ -4367,6 +4409,7 @@ spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport)
 		vdev_initialize_restart(spa->spa_root_vdev);
 		vdev_trim_restart(spa->spa_root_vdev);
 		vdev_autotrim_restart(spa);
+		vdev_rebuild_restart(spa);
 		spa_config_exit(spa, SCL_CONFIG, FTAG);
 	}
 
@@ -4942,6 +4985,18 @@ spa_validate_aux_devs(spa_t *spa, nvlist_t *nvroot, uint64_t crtxg, int mode,
 
 		vd->vdev_top = vd;
 
+		/*
+		 * A distributed spare is backed by the children of a dRAID
+		 * vdev which may not be part of the pool yet, so it can't be
+		 * opened here; it also has no label to initialize.
+		 */
+		if (vd->vdev_ops == &vdev_draid_spare_ops) {
+			VERIFY(nvlist_add_uint64(dev[i], ZPOOL_CONFIG_GUID,
+			    vd->vdev_guid) == 0);
+			vdev_free(vd);
+			continue;
+		}
+
 		if ((error = vdev_open(vd)) == 0 &&
 		    (error = vdev_label_init(vd, crtxg, label)) == 0) {
 			VERIFY(nvlist_add_uint64(dev[i], ZPOOL_CONFIG_GUID,
@@ -5083,6 +5138,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	uint_t nspares, nl2cache;
 	uint64_t version, obj;
 	boolean_t has_features;
+	boolean_t has_draid;
 	char *poolname;
 	nvlist_t *nvl;
 	boolean_t has_encryption;
@@ -5129,6 +5185,7 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 
 	has_features = B_FALSE;
 	has_encryption = B_FALSE;
+	has_draid = B_FALSE;
 	for (nvpair_t *elem = nvlist_next_nvpair(props, NULL);
 	    elem != NULL; elem = nvlist_next_nvpair(props, elem)) {
 		if (zpool_prop_feature(nvpair_name(elem))) {
@@ -5137,6 +5194,8 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 			VERIFY0(zfeature_lookup_name(feat_name, &feat));
 			if (feat == SPA_FEATURE_ENCRYPTION)
 				has_encryption = B_TRUE;
+			if (feat == SPA_FEATURE_DRAID)
+				has_draid = B_TRUE;
 		}
 	}
 
@@ -5191,6 +5250,15 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	if (error == 0 && !zfs_allocatable_devs(nvroot))
 		error = SET_ERROR(EINVAL);
 
+	/*
+	 * dRAID vdevs can only be created if the feature will be enabled.
+	 */
+	for (int c = 0; error == 0 && !has_draid &&
+	    c < rvd->vdev_children; c++) {
+		if (rvd->vdev_child[c]->vdev_ops == &vdev_draid_ops)
+			error = SET_ERROR(ENOTSUP);
+	}
+
 	if (error == 0 &&
 	    (error = vdev_create(rvd, txg, B_FALSE)) == 0 &&
 	    (error = spa_validate_aux(spa, nvroot, txg,
@@ -5252,9 +5320,10 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	spa->spa_is_initializing = B_FALSE;
 
 	/*
-	 * Create DDTs (dedup tables).
+	 * Create DDTs (dedup tables) and the BRT (block reference table).
 	 */
 	ddt_create(spa);
+	brt_create(spa);
 
 	spa_update_dspace(spa);
 
@@ -5990,6 +6059,7 @@ spa_export_common(char *pool, int new_state, nvlist_t **oldconfig,
 			vdev_initialize_stop_all(rvd, VDEV_INITIALIZE_ACTIVE);
 			vdev_trim_stop_all(rvd, VDEV_TRIM_ACTIVE);
 			vdev_autotrim_stop_all(spa);
+			vdev_rebuild_stop_all(spa);
 		}
 
 		/*
@@ -6195,6 +6265,10 @@ spa_vdev_add(spa_t *spa, nvlist_t *nvroot)
  * in the mirror, and the nvroot for the new device.  If the path specifies
  * a device that is not mirrored, we automatically insert the mirror vdev.
  *
+ * A device can also be attached to a raidz vdev, given the raidz vdev's
+ * guid.  That starts an expansion of the vdev across the new device, which
+ * is not resilvered: the expansion moves existing data onto it.
+ *
  * If 'replacing' is specified, the new device is intended to replace the
  * existing device; in this case the two devices are made into their own
  * mirror using the 'replacing' vdev, which is functionally identical to
@@ -6213,6 +6287,7 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 	char *oldvdpath, *newvdpath;
 	int newvd_isspare;
 	int error;
+	boolean_t raidz;
 
 	ASSERT(spa_writeable(spa));
 
@@ -6233,10 +6308,48 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 	if (oldvd == NULL)
 		return (spa_vdev_exit(spa, NULL, txg, ENODEV));
 
-	if (!oldvd->vdev_ops->vdev_op_leaf)
-		return (spa_vdev_exit(spa, NULL, txg, ENOTSUP));
+	raidz = (oldvd->vdev_ops == &vdev_raidz_ops);
+
+	if (raidz) {
+		if (!spa_feature_is_enabled(spa, SPA_FEATURE_RAIDZ_EXPANSION))
+			return (spa_vdev_exit(spa, NULL, txg, ENOTSUP));
+
+		/*
+		 * Only one raidz vdev can be expanded at a time, and it must
+		 * be healthy: the expansion can't reconstruct missing data.
+		 */
+		for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+			if (rvd->vdev_child[c]->vdev_rz_expanding) {
+				return (spa_vdev_exit(spa, NULL, txg,
+				    ZFS_ERR_RAIDZ_EXPAND_IN_PROGRESS));
+			}
+		}
+		if (dsl_scan_resilvering(spa_get_dsl(spa)))
+			return (spa_vdev_exit(spa, NULL, txg, EBUSY));
 
-	pvd = oldvd->vdev_parent;
+		if (replacing || oldvd != oldvd->vdev_top ||
+		    oldvd->vdev_islog)
+			return (spa_vdev_exit(spa, NULL, txg, ENOTSUP));
+
+		/*
+		 * Initializing and TRIM work out where free space is on the
+		 * children from the vdev's current width, so they can't run
+		 * during the expansion.  Stop them but leave them "active",
+		 * so that they resume once it has completed.
+		 */
+		spa_vdev_config_exit(spa, NULL, txg, 0, FTAG);
+		vdev_initialize_stop_all(oldvd, VDEV_INITIALIZE_ACTIVE);
+		vdev_trim_stop_all(oldvd, VDEV_TRIM_ACTIVE);
+		vdev_autotrim_stop_wait(oldvd);
+		txg = spa_vdev_config_enter(spa);
+
+		pvd = oldvd;
+	} else {
+		if (!oldvd->vdev_ops->vdev_op_leaf)
+			return (spa_vdev_exit(spa, NULL, txg, ENOTSUP));
+
+		pvd = oldvd->vdev_parent;
+	}
 
 	if ((error = spa_config_parse(spa, &newrootvd, nvroot, NULL, 0,
 	    VDEV_ALLOC_ATTACH)) != 0)
@@ -6253,13 +6366,29 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 	if ((error = vdev_create(newrootvd, txg, replacing)) != 0)
 		return (spa_vdev_exit(spa, newrootvd, txg, error));
 
+	/*
+	 * A distributed spare can only replace a child of the dRAID vdev
+	 * whose capacity it is carved out of.
+	 */
+	if (newvd->vdev_ops == &vdev_draid_spare_ops &&
+	    vdev_draid_spare_get_parent(newvd) != oldvd->vdev_top)
+		return (spa_vdev_exit(spa, newrootvd, txg, ENOTSUP));
+
 	/*
 	 * Spares can't replace logs
 	 */
 	if (oldvd->vdev_top->vdev_islog && newvd->vdev_isspare)
 		return (spa_vdev_exit(spa, newrootvd, txg, ENOTSUP));
 
-	if (!replacing) {
+	if (raidz) {
+		/*
+		 * A hot spare can't become a permanent part of a raidz vdev.
+		 */
+		if (newvd->vdev_isspare)
+			return (spa_vdev_exit(spa, newrootvd, txg, ENOTSUP));
+
+		pvops = &vdev_raidz_ops;
+	} else if (!replacing) {
 		/*
 		 * For attach, the only allowable parent is a mirror or the root
 		 * vdev.
@@ -6304,7 +6433,8 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 	/*
 	 * Make sure the new device is big enough.
 	 */
-	if (newvd->vdev_asize < vdev_get_min_asize(oldvd))
+	if (newvd->vdev_asize <
+	    vdev_get_min_asize(raidz ? oldvd->vdev_child[0] : oldvd))
 		return (spa_vdev_exit(spa, newrootvd, txg, EOVERFLOW));
 
 	/*
@@ -6318,7 +6448,7 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 	 * If this is an in-place replacement, update oldvd's path and devid
 	 * to make it distinguishable from newvd, and unopenable from now on.
 	 */
-	if (strcmp(oldvd->vdev_path, newvd->vdev_path) == 0) {
+	if (!raidz && strcmp(oldvd->vdev_path, newvd->vdev_path) == 0) {
 		spa_strfree(oldvd->vdev_path);
 		oldvd->vdev_path = kmem_alloc(strlen(newvd->vdev_path) + 5,
 		    KM_SLEEP);
@@ -6331,7 +6461,8 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 	}
 
 	/* mark the device being resilvered */
-	newvd->vdev_resilver_txg = txg;
+	if (!raidz)
+		newvd->vdev_resilver_txg = txg;
 
 	/*
 	 * If the parent is not a mirror, or if we're replacing, insert the new
@@ -6358,41 +6489,59 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 
 	vdev_config_dirty(tvd);
 
-	/*
-	 * Set newvd's DTL to [TXG_INITIAL, dtl_max_txg) so that we account
-	 * for any dmu_sync-ed blocks.  It will propagate upward when
-	 * spa_vdev_exit() calls vdev_dtl_reassess().
-	 */
 	dtl_max_txg = txg + TXG_CONCURRENT_STATES;
 
-	vdev_dtl_dirty(newvd, DTL_MISSING, TXG_INITIAL,
-	    dtl_max_txg - TXG_INITIAL);
-
-	if (newvd->vdev_isspare) {
-		spa_spare_activate(newvd);
-		spa_event_notify(spa, newvd, NULL, ESC_ZFS_VDEV_SPARE);
-	}
-
-	oldvdpath = spa_strdup(oldvd->vdev_path);
+	oldvdpath = spa_strdup(raidz ? VDEV_TYPE_RAIDZ : oldvd->vdev_path);
 	newvdpath = spa_strdup(newvd->vdev_path);
 	newvd_isspare = newvd->vdev_isspare;
 
-	/*
-	 * Mark newvd's DTL dirty in this txg.
-	 */
-	vdev_dirty(tvd, VDD_DTL, newvd, txg);
+	if (raidz) {
+		/*
+		 * Like device removal, the expansion is started by a sync
+		 * task in this txg, so that it is committed along with the
+		 * config that has the new child.
+		 */
+		dmu_tx_t *tx = dmu_tx_create_assigned(spa->spa_dsl_pool, txg);
+		vdev_raidz_expand_start(tvd, tx);
+		dmu_tx_commit(tx);
+	} else {
+		/*
+		 * Set newvd's DTL to [TXG_INITIAL, dtl_max_txg) so that we
+		 * account for any dmu_sync-ed blocks.  It will propagate
+		 * upward when spa_vdev_exit() calls vdev_dtl_reassess().
+		 */
+		vdev_dtl_dirty(newvd, DTL_MISSING, TXG_INITIAL,
+		    dtl_max_txg - TXG_INITIAL);
 
-	/*
-	 * Schedule the resilver to restart in the future. We do this to
-	 * ensure that dmu_sync-ed blocks have been stitched into the
-	 * respective datasets. We do not do this if resilvers have been
-	 * deferred.
-	 */
-	if (dsl_scan_resilvering(spa_get_dsl(spa)) &&
-	    spa_feature_is_enabled(spa, SPA_FEATURE_RESILVER_DEFER))
-		vdev_defer_resilver(newvd);
-	else
-		dsl_scan_restart_resilver(spa->spa_dsl_pool, dtl_max_txg);
+		if (newvd->vdev_isspare) {
+			spa_spare_activate(newvd);
+			spa_event_notify(spa, newvd, NULL, ESC_ZFS_VDEV_SPARE);
+		}
+
+		/*
+		 * Mark newvd's DTL dirty in this txg.
+		 */
+		vdev_dirty(tvd, VDD_DTL, newvd, txg);
+
+		/*
+		 * A distributed spare is populated by a sequential rebuild of
+		 * its dRAID vdev, which reads from all of the surviving
+		 * children at once.
+		 *
+		 * Otherwise, schedule the resilver to restart in the future.
+		 * We do this to ensure that dmu_sync-ed blocks have been
+		 * stitched into the respective datasets. We do not do this if
+		 * resilvers have been deferred.
+		 */
+		if (newvd->vdev_ops == &vdev_draid_spare_ops)
+			vdev_rebuild(tvd);
+		else if (dsl_scan_resilvering(spa_get_dsl(spa)) &&
+		    spa_feature_is_enabled(spa, SPA_FEATURE_RESILVER_DEFER))
+			vdev_defer_resilver(newvd);
+		else
+			dsl_scan_restart_resilver(spa->spa_dsl_pool,
+			    dtl_max_txg);
+	}
 
 	if (spa->spa_bootfs)
 		spa_event_notify(spa, newvd, NULL, ESC_ZFS_BOOTFS_VDEV_ATTACH);
@@ -6404,6 +6553,9 @@ spa_vdev_attach(spa_t *spa, uint64_t guid, nvlist_t *nvroot, int replacing)
 	 */
 	(void) spa_vdev_exit(spa, newrootvd, dtl_max_txg, 0);
 
+	if (raidz)
+		zthr_wakeup(spa->spa_raidz_expand_zthr);
+
 	spa_history_log_internal(spa, "vdev attach", NULL,
 	    "%s vdev=%s %s vdev=%s",
 	    replacing && newvd_isspare ? "spare in" :
@@ -6692,6 +6844,9 @@ spa_vdev_initialize_impl(spa_t *spa, uint64_t guid, uint64_t cmd_type,
 	} else if (!vd->vdev_ops->vdev_op_leaf || !vdev_is_concrete(vd)) {
 		spa_config_exit(spa, SCL_CONFIG | SCL_STATE, FTAG);
 		return (SET_ERROR(EINVAL));
+	} else if (vd->vdev_ops == &vdev_draid_spare_ops) {
+		spa_config_exit(spa, SCL_CONFIG | SCL_STATE, FTAG);
+		return (SET_ERROR(ENOTSUP));
 	} else if (!vdev_writeable(vd)) {
 		spa_config_exit(spa, SCL_CONFIG | SCL_STATE, FTAG);
 		return (SET_ERROR(EROFS));
@@ -6708,7 +6863,7 @@ spa_vdev_initialize_impl(spa_t *spa, uint64_t guid, uint64_t cmd_type,
 	 */
 	if (cmd_type == POOL_INITIALIZE_START &&
 	    (vd->vdev_initialize_thread != NULL ||
-	    vd->vdev_top->vdev_removing)) {
+	    vd->vdev_top->vdev_removing || vd->vdev_top->vdev_rz_expanding)) {
 		mutex_exit(&vd->vdev_initialize_lock);
 		return (SET_ERROR(EBUSY));
 	} else if (cmd_type == POOL_INITIALIZE_CANCEL &&
@@ -6803,6 +6958,9 @@ spa_vdev_trim_impl(spa_t *spa, uint64_t guid, uint64_t cmd_type,
 	} else if (!vd->vdev_ops->vdev_op_leaf || !vdev_is_concrete(vd)) {
 		spa_config_exit(spa, SCL_CONFIG | SCL_STATE, FTAG);
 		return (SET_ERROR(EINVAL));
+	} else if (vd->vdev_ops == &vdev_draid_spare_ops) {
+		spa_config_exit(spa, SCL_CONFIG | SCL_STATE, FTAG);
+		return (SET_ERROR(ENOTSUP));
 	} else if (!vdev_writeable(vd)) {
 		spa_config_exit(spa, SCL_CONFIG | SCL_STATE, FTAG);
 		return (SET_ERROR(EROFS));
@@ -6823,7 +6981,8 @@ spa_vdev_trim_impl(spa_t *spa, uint64_t guid, uint64_t cmd_type,
 	 * which has completed but the thread is not exited.
 	 */
 	if (cmd_type == POOL_TRIM_START &&
-	    (vd->vdev_trim_thread != NULL || vd->vdev_top->vdev_removing)) {
+	    (vd->vdev_trim_thread != NULL || vd->vdev_top->vdev_removing ||
+	    vd->vdev_top->vdev_rz_expanding)) {
 		mutex_exit(&vd->vdev_trim_lock);
 		return (SET_ERROR(EBUSY));
 	} else if (cmd_type == POOL_TRIM_CANCEL &&
@@ -7448,12 +7607,25 @@ spa_scan_stop(spa_t *spa)
 
 int
 spa_scan(spa_t *spa, pool_scan_func_t func)
+{
+	return (spa_scan_txg(spa, func, 0));
+}
+
+/*
+ * Start a scan.  If txg is not zero, a scrub only verifies the blocks born
+ * in that txg or later.
+ */
+int
+spa_scan_txg(spa_t *spa, pool_scan_func_t func, uint64_t txg)
 {
 	ASSERT(spa_config_held(spa, SCL_ALL, RW_WRITER) == 0);
 
 	if (func >= POOL_SCAN_FUNCS || func == POOL_SCAN_NONE)
 		return (SET_ERROR(ENOTSUP));
 
+	if (txg != 0 && func != POOL_SCAN_SCRUB)
+		return (SET_ERROR(EINVAL));
+
 	if (func == POOL_SCAN_RESILVER &&
 	    !spa_feature_is_enabled(spa, SPA_FEATURE_RESILVER_DEFER))
 		return (SET_ERROR(ENOTSUP));
@@ -7468,7 +7640,7 @@ spa_scan(spa_t *spa, pool_scan_func_t func)
 		return (0);
 	}
 
-	return (dsl_scan(spa->spa_dsl_pool, func));
+	return (dsl_scan(spa->spa_dsl_pool, func, txg == 0 ? 0 : txg - 1));
 }
 
 /*
@@ -7695,6 +7867,10 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *discard_thread = spa->spa_checkpoint_discard_zthr;
 	if (discard_thread != NULL)
 		zthr_cancel(discard_thread);
+
+	zthr_t *raidz_expand_thread = spa->spa_raidz_expand_zthr;
+	if (raidz_expand_thread != NULL)
+		zthr_cancel(raidz_expand_thread);
 }
 
 void
@@ -7713,6 +7889,10 @@ spa_async_resume(spa_t *spa)
 	zthr_t *discard_thread = spa->spa_checkpoint_discard_zthr;
 	if (discard_thread != NULL)
 		zthr_resume(discard_thread);
+
+	zthr_t *raidz_expand_thread = spa->spa_raidz_expand_zthr;
+	if (raidz_expand_thread != NULL)
+		zthr_resume(raidz_expand_thread);
 }
 
 static boolean_t
@@ -8433,6 +8613,7 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 		}
 
 		ddt_sync(spa, txg);
+		brt_sync(spa, txg);
 		dsl_scan_sync(dp, tx);
 		svr_sync(spa, tx);
 		spa_sync_upgrades(spa, tx);
@@ -8627,6 +8808,12 @@ spa_sync(spa_t *spa, uint64_t txg)
 
 	spa_sync_condense_indirect(spa, tx);
 
+	/*
+	 * Blocks cloned in this txg must be referenced in the BRT before any
+	 * of the txg's frees are processed.
+	 */
+	brt_pending_apply(spa, txg);
+
 	spa_sync_iterate_to_convergence(spa, tx);
 
 #ifdef ZFS_DEBUG
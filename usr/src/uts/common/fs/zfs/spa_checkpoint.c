@@ -461,6 +461,10 @@ spa_checkpoint_check(void *arg, dmu_tx_t *tx)
 	if (spa->spa_vdev_removal != NULL)
 		return (SET_ERROR(ZFS_ERR_DEVRM_IN_PROGRESS));
 
+	if (spa->spa_raidz_expand != NULL &&
+	    spa->spa_raidz_expand->vre_phys.vrep_state == DSS_SCANNING)
+		return (SET_ERROR(ZFS_ERR_RAIDZ_EXPAND_IN_PROGRESS));
+
 	if (spa->spa_checkpoint_txg != 0)
 		return (SET_ERROR(ZFS_ERR_CHECKPOINT_EXISTS));
 
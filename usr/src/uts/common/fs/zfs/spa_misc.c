@@ -58,6 +58,8 @@
 #include <sys/metaslab_impl.h>
 #include <sys/arc.h>
 #include <sys/ddt.h>
+#include <sys/brt.h>
+#include <sys/blake3.h>
 #include "zfs_prop.h"
 #include <sys/btree.h>
 #include <sys/zfeature.h>
@@ -1250,7 +1252,7 @@ spa_vdev_config_exit(spa_t *spa, vdev_t *vd, uint64_t txg, int error, char *tag)
 	/*
 	 * Reassess the DTLs.
 	 */
-	vdev_dtl_reassess(spa->spa_root_vdev, 0, 0, B_FALSE);
+	vdev_dtl_reassess(spa->spa_root_vdev, 0, 0, B_FALSE, B_FALSE);
 
 	if (error == 0 && !list_is_empty(&spa->spa_config_dirty_list)) {
 		config_changed = B_TRUE;
@@ -1368,7 +1370,7 @@ spa_vdev_state_exit(spa_t *spa, vdev_t *vd, int error)
 
 	if (vd != NULL || error == 0)
 		vdev_dtl_reassess(vd ? vd->vdev_top : spa->spa_root_vdev,
-		    0, 0, B_FALSE);
+		    0, 0, B_FALSE, B_FALSE);
 
 	if (vd != NULL) {
 		vdev_state_dirty(vd->vdev_top);
@@ -2262,9 +2264,11 @@ spa_init(int mode)
 	zio_init();
 	dmu_init();
 	zil_init();
+	brt_init();
 	vdev_cache_stat_init();
 	vdev_mirror_stat_init();
 	vdev_raidz_math_init();
+	blake3_impl_init();
 	zfs_prop_init();
 	zpool_prop_init();
 	zpool_feature_init();
@@ -2284,6 +2288,7 @@ spa_fini(void)
 	vdev_cache_stat_fini();
 	vdev_mirror_stat_fini();
 	vdev_raidz_math_fini();
+	brt_fini();
 	zil_fini();
 	dmu_fini();
 	zio_fini();
@@ -2423,6 +2428,7 @@ spa_scan_get_stats(spa_t *spa, pool_scan_stat_t *ps)
 	ps->pss_issued =
 	    scn->scn_issued_before_pass + spa->spa_scan_pass_issued;
 	ps->pss_state = scn->scn_phys.scn_state;
+	ps->pss_min_txg = scn->scn_phys.scn_min_txg;
 
 	/* data not stored on disk */
 	ps->pss_pass_start = spa->spa_scan_pass_start;
@@ -532,6 +532,27 @@ typedef struct arc_stats {
 	 * buffers to reach its target amount.
 	 */
 	kstat_named_t arcstat_evict_not_enough;
+	/*
+	 * Number of bytes evicted by arc_adjust(), and the time it spent
+	 * doing so, in nanoseconds.  Their ratio is the rate at which the
+	 * ARC evicts while it is over its target size.
+	 */
+	kstat_named_t arcstat_evict_bytes;
+	kstat_named_t arcstat_evict_time;
+	/*
+	 * Number of passes of arc_evict_state() that were split among the
+	 * eviction taskq threads, and the number of tasks they were split
+	 * into.
+	 */
+	kstat_named_t arcstat_evict_parallel;
+	kstat_named_t arcstat_evict_tasks;
+	/*
+	 * Number of allocations that had to wait for eviction to bring the
+	 * ARC back under its limit, and the total time they waited, in
+	 * nanoseconds.
+	 */
+	kstat_named_t arcstat_evict_waits;
+	kstat_named_t arcstat_evict_wait_time;
 	kstat_named_t arcstat_evict_l2_cached;
 	kstat_named_t arcstat_evict_l2_eligible;
 	kstat_named_t arcstat_evict_l2_eligible_mfu;
@@ -0,0 +1,67 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef	_SYS_BLAKE3_H
+#define	_SYS_BLAKE3_H
+
+#include <sys/types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#define	BLAKE3_KEY_LEN		32
+#define	BLAKE3_OUT_LEN		32
+#define	BLAKE3_BLOCK_LEN	64
+#define	BLAKE3_CHUNK_LEN	1024
+#define	BLAKE3_MAX_DEPTH	54
+
+/*
+ * State of the chunk currently being hashed.  Full blocks are compressed
+ * as soon as more input arrives; the last block is kept in cs_buf since it
+ * has to be compressed with the CHUNK_END (and possibly ROOT) flag.
+ */
+typedef struct blake3_chunk_state {
+	uint32_t	cs_cv[8];
+	uint64_t	cs_counter;
+	uint8_t		cs_buf[BLAKE3_BLOCK_LEN];
+	uint8_t		cs_buf_len;
+	uint8_t		cs_blocks;
+	uint8_t		cs_flags;
+} blake3_chunk_state_t;
+
+/*
+ * Incremental BLAKE3 hasher.  The chaining values of completed subtrees
+ * are kept on bc_cv_stack and merged eagerly, which is safe because a
+ * chunk is only pushed once more input is known to follow it.
+ */
+typedef struct blake3_ctx {
+	uint32_t		bc_key[8];
+	blake3_chunk_state_t	bc_chunk;
+	uint8_t			bc_cv_stack_len;
+	uint32_t		bc_cv_stack[BLAKE3_MAX_DEPTH][8];
+} BLAKE3_CTX;
+
+extern void Blake3_Init(BLAKE3_CTX *);
+extern void Blake3_InitKeyed(BLAKE3_CTX *, const uint8_t *);
+extern void Blake3_Update(BLAKE3_CTX *, const void *, size_t);
+extern void Blake3_Final(const BLAKE3_CTX *, uint8_t *);
+
+/* Implementation selection, see blake3_impl.c */
+extern void blake3_impl_init(void);
+extern int blake3_impl_set(const char *);
+extern const char *blake3_impl_name(void);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_BLAKE3_H */
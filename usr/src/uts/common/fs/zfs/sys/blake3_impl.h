@@ -0,0 +1,108 @@
+/*
+ * This file and its contents are supplied under the terms of the
+ * Common Development and Distribution License ("CDDL"), version 1.0.
+ * You may only use this file in accordance with the terms of version
+ * 1.0 of the CDDL.
+ *
+ * A full copy of the text of the CDDL should have accompanied this
+ * source.  A copy of the CDDL is also available via the Internet at
+ * http://www.illumos.org/license/CDDL.
+ */
+
+#ifndef	_SYS_BLAKE3_IMPL_H
+#define	_SYS_BLAKE3_IMPL_H
+
+#include <sys/types.h>
+#include <sys/blake3.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* Domain separation flags */
+#define	BLAKE3_CHUNK_START	(1 << 0)
+#define	BLAKE3_CHUNK_END	(1 << 1)
+#define	BLAKE3_PARENT		(1 << 2)
+#define	BLAKE3_ROOT		(1 << 3)
+#define	BLAKE3_KEYED_HASH	(1 << 4)
+
+/* The most inputs any implementation hashes at once (AVX-512) */
+#define	BLAKE3_MAX_DEGREE	16
+
+#define	BLAKE3_IMPL_NAME_MAX	16
+
+extern const uint32_t blake3_iv[8];
+extern const uint8_t blake3_msg_schedule[7][16];
+
+/*
+ * Methods used to define a BLAKE3 implementation
+ *
+ * @compress_in_place	Compress one block into the chaining value cv
+ * @hash_many		Hash ninputs inputs of blocks full blocks each, all
+ *			with the same key, and store their chaining values
+ *			consecutively in out.  The counter of input i is
+ *			counter + i when increment is set.  flags_start is
+ *			added for the first block and flags_end for the last.
+ * @is_supported	Returns B_TRUE if the implementation can be used
+ * @degree		Number of inputs hashed in parallel
+ */
+typedef void (*blake3_compress_f)(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags);
+typedef void (*blake3_hash_many_f)(const uint8_t * const *inputs,
+    size_t ninputs, size_t blocks, const uint32_t key[8], uint64_t counter,
+    boolean_t increment, uint8_t flags, uint8_t flags_start,
+    uint8_t flags_end, uint8_t *out);
+typedef boolean_t (*blake3_will_work_f)(void);
+
+typedef struct blake3_impl_ops {
+	blake3_compress_f	compress_in_place;
+	blake3_hash_many_f	hash_many;
+	blake3_will_work_f	is_supported;
+	uint_t			degree;
+	char			name[BLAKE3_IMPL_NAME_MAX];
+} blake3_impl_ops_t;
+
+extern const blake3_impl_ops_t blake3_generic_impl;
+#if defined(__amd64)
+extern const blake3_impl_ops_t blake3_sse41_impl;
+extern const blake3_impl_ops_t blake3_avx2_impl;
+extern const blake3_impl_ops_t blake3_avx512_impl;
+#endif
+
+/*
+ * The portable routines, which the SIMD implementations use for single
+ * blocks and for inputs left over after the last full group of lanes.
+ */
+extern void blake3_generic_compress_in_place(uint32_t cv[8],
+    const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+    uint64_t counter, uint8_t flags);
+extern void blake3_generic_hash_many(const uint8_t * const *inputs,
+    size_t ninputs, size_t blocks, const uint32_t key[8], uint64_t counter,
+    boolean_t increment, uint8_t flags, uint8_t flags_start,
+    uint8_t flags_end, uint8_t *out);
+
+/* Returns the implementation to use in the current context */
+extern const blake3_impl_ops_t *blake3_impl_get_ops(void);
+
+static inline uint32_t
+blake3_load32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline void
+blake3_store32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_BLAKE3_IMPL_H */
@@ -0,0 +1,84 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_BRT_H
+#define	_SYS_BRT_H
+
+#include <sys/spa.h>
+#include <sys/dmu_tx.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Prefix of the MOS directory entries naming the per-vdev BRT objects.
+ * The top-level vdev id is appended in decimal.
+ */
+#define	DMU_POOL_BRT_VDEV_PREFIX	"org.illumos:brt:vdev:"
+
+/*
+ * Granularity of the in-core "may this region contain BRT entries" map
+ * kept for each top-level vdev.
+ */
+#define	BRT_RANGESIZE			(64ULL * 1024 * 1024)
+
+/*
+ * On-disk summary of a vdev's BRT, stored in the bonus buffer of the
+ * object holding the per-region entry counts.  New fields may only be
+ * appended.
+ */
+typedef struct brt_vdev_phys {
+	uint64_t	bvp_mos_entries;	/* ZAP: offset -> refcount */
+	uint64_t	bvp_size;		/* number of regions */
+	uint64_t	bvp_rangesize;		/* bytes per region */
+	uint64_t	bvp_totalcount;		/* sum of all refcounts */
+	uint64_t	bvp_usedspace;		/* space of cloned blocks */
+	uint64_t	bvp_savedspace;		/* space saved by cloning */
+} brt_vdev_phys_t;
+
+typedef struct brt brt_t;
+
+extern void brt_init(void);
+extern void brt_fini(void);
+
+extern void brt_create(spa_t *spa);
+extern int brt_load(spa_t *spa);
+extern void brt_unload(spa_t *spa);
+
+extern boolean_t brt_maybe_exists(spa_t *spa, const blkptr_t *bp);
+extern boolean_t brt_entry_decref(spa_t *spa, const blkptr_t *bp);
+extern uint64_t brt_entry_get_refcount(spa_t *spa, const blkptr_t *bp);
+
+extern void brt_pending_add(spa_t *spa, const blkptr_t *bp, dmu_tx_t *tx);
+extern void brt_pending_remove(spa_t *spa, const blkptr_t *bp, uint64_t txg);
+extern void brt_pending_apply(spa_t *spa, uint64_t txg);
+extern void brt_sync(spa_t *spa, uint64_t txg);
+
+extern uint64_t brt_get_used(spa_t *spa);
+extern uint64_t brt_get_saved(spa_t *spa);
+extern uint64_t brt_get_ratio(spa_t *spa);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_BRT_H */
@@ -160,6 +160,8 @@ typedef struct dbuf_dirty_record {
 			override_states_t dr_override_state;
 			uint8_t dr_copies;
 			boolean_t dr_nopwrite;
+			boolean_t dr_brtwrite;
+			boolean_t dr_diowrite;
 			boolean_t dr_has_raw_params;
 
 			/*
@@ -206,6 +208,12 @@ typedef struct dmu_buf_impl {
 	 */
 	struct dmu_buf_impl *db_hash_next;
 
+	/*
+	 * link for the list of dbufs removed from the hash table, which
+	 * are freed once no lock-free lookup can still be looking at them
+	 */
+	struct dmu_buf_impl *db_hash_free_next;
+
 	/* our block number */
 	uint64_t db_blkid;
 
@@ -296,16 +304,54 @@ typedef struct dmu_buf_impl {
 	 */
 	uint8_t db_pending_evict;
 
+	/*
+	 * The dbuf was put in the NOFILL state by dmu_write_direct() or
+	 * dmu_brt_clone(), so its contents can be recovered from the block
+	 * that was written or cloned.
+	 */
+	uint8_t db_diowrite;
+
 	uint8_t db_dirtycnt;
 } dmu_buf_impl_t;
 
 /* Note: the dbuf hash table is exposed only for the mdb module */
 #define	DBUF_MUTEXES 256
-#define	DBUF_HASH_MUTEX(h, idx) (&(h)->hash_mutexes[(idx) & (DBUF_MUTEXES-1)])
+#define	DBUF_HASH_LOCK(h, hv) (&(h)->hash_locks[(hv) & (DBUF_MUTEXES-1)])
+#define	DBUF_HASH_MUTEX(h, hv) (&DBUF_HASH_LOCK(h, hv)->dhl_lock)
+
+/*
+ * An array of hash buckets, together with its size.  The two are allocated
+ * as one so that lock-free readers always see a matching pair.
+ */
+typedef struct dbuf_hash_buckets {
+	uint64_t dhb_mask;
+	dmu_buf_impl_t *dhb_table[1];	/* actually dhb_mask + 1 entries */
+} dbuf_hash_buckets_t;
+
+#define	DBUF_HASH_BUCKETS_SIZE(nbuckets) \
+	(offsetof(dbuf_hash_buckets_t, dhb_table) + \
+	(nbuckets) * sizeof (dmu_buf_impl_t *))
+
+/*
+ * Writer lock for the group of buckets whose index is congruent to its
+ * own index modulo DBUF_MUTEXES.  The table never has fewer buckets than
+ * there are locks, so a dbuf always maps to the same lock whatever the
+ * current size of the table.  dhl_seq is odd while the group is being
+ * moved to a new table, and is changed whenever a chain of the group may
+ * have been rearranged, so that lock-free readers can tell that they
+ * need to look again.
+ */
+typedef struct dbuf_hash_lock {
+	kmutex_t dhl_lock;
+	volatile uint64_t dhl_seq;
+	boolean_t dhl_migrated;	/* moved to hash_new_buckets */
+	uint64_t dhl_pad[5];	/* pad out to cache line (64 bytes) */
+} dbuf_hash_lock_t;
+
 typedef struct dbuf_hash_table {
-	uint64_t hash_table_mask;
-	dmu_buf_impl_t **hash_table;
-	kmutex_t hash_mutexes[DBUF_MUTEXES];
+	dbuf_hash_buckets_t *hash_buckets;
+	dbuf_hash_buckets_t *hash_new_buckets;	/* only while resizing */
+	dbuf_hash_lock_t hash_locks[DBUF_MUTEXES];
 } dbuf_hash_table_t;
 
 typedef void (*dbuf_prefetch_fn)(void *, boolean_t);
@@ -345,6 +391,8 @@ dmu_buf_impl_t *dbuf_find(struct objset *os, uint64_t object, uint8_t level,
 
 int dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags);
 void dmu_buf_will_not_fill(dmu_buf_t *db, dmu_tx_t *tx);
+void dmu_buf_will_clone(dmu_buf_t *db, dmu_tx_t *tx);
+void dmu_buf_will_direct_write(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_will_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_fill_done(dmu_buf_t *db, dmu_tx_t *tx);
 void dbuf_assign_arcbuf(dmu_buf_impl_t *db, arc_buf_t *buf, dmu_tx_t *tx);
@@ -121,12 +121,74 @@ struct ddt_entry {
 	struct abd	*dde_repair_abd;
 	enum ddt_type	dde_type;
 	enum ddt_class	dde_class;
+	enum ddt_type	dde_obj_type;	/* object holding the entry; may */
+	enum ddt_class	dde_obj_class;	/* lag dde_type/class if logged */
 	uint8_t		dde_loading;
 	uint8_t		dde_loaded;
 	kcondvar_t	dde_cv;
 	avl_node_t	dde_node;
 };
 
+/*
+ * Dedup log.
+ *
+ * When the dedup_log feature is enabled, the changes ddt_sync() makes to
+ * a DDT are appended to a log object instead of being applied to the
+ * DDT's ZAP objects, and are moved into those objects a bounded number
+ * at a time, in key order, by later txgs.  Each DDT has two logs: the
+ * active log receives new changes, while the flushing log is being
+ * drained.  Once the flushing log is empty, and the active log has
+ * aged enough, the two swap roles.  The complete contents of both logs
+ * are kept in core, so the latest state of a logged entry never has to
+ * be read from disk.
+ *
+ * A log record holds the whole entry as of the txg it was logged in,
+ * plus the type and class of the object that held the entry on disk at
+ * that time.  Entries with no physical copies left are tombstones.
+ */
+typedef struct ddt_log_record {
+	ddt_key_t	ddlr_key;
+	ddt_phys_t	ddlr_phys[DDT_PHYS_TYPES];
+	uint64_t	ddlr_info;	/* object type and class */
+} ddt_log_record_t;
+
+#define	DDLR_GET_TYPE(ddlr)		BF64_GET((ddlr)->ddlr_info, 0, 8)
+#define	DDLR_SET_TYPE(ddlr, x)		BF64_SET((ddlr)->ddlr_info, 0, 8, x)
+#define	DDLR_GET_CLASS(ddlr)		BF64_GET((ddlr)->ddlr_info, 8, 8)
+#define	DDLR_SET_CLASS(ddlr, x)		BF64_SET((ddlr)->ddlr_info, 8, 8, x)
+
+/*
+ * Bonus buffer of a log object.  Entries of a flushing log whose keys
+ * sort at or below ddlp_flush_key have already been written to the DDT
+ * objects.
+ */
+typedef struct ddt_log_phys {
+	uint64_t	ddlp_length;		/* bytes of records */
+	uint64_t	ddlp_first_txg;		/* txg the log was started in */
+	uint64_t	ddlp_flags;
+	ddt_key_t	ddlp_flush_key;
+} ddt_log_phys_t;
+
+#define	DDL_FLAG_FLUSHING	(1ULL << 0)	/* this is the flushing log */
+#define	DDL_FLAG_CURSOR		(1ULL << 1)	/* ddlp_flush_key is valid */
+
+typedef struct ddt_log_entry {
+	ddt_key_t	ddle_key;
+	ddt_phys_t	ddle_phys[DDT_PHYS_TYPES];
+	enum ddt_type	ddle_type;	/* object holding the entry */
+	enum ddt_class	ddle_class;
+	avl_node_t	ddle_node;
+} ddt_log_entry_t;
+
+typedef struct ddt_log {
+	avl_tree_t	ddl_tree;	/* latest state of each logged key */
+	uint64_t	ddl_object;
+	uint64_t	ddl_length;
+	uint64_t	ddl_first_txg;
+	uint64_t	ddl_flags;
+	ddt_key_t	ddl_flush_key;
+} ddt_log_t;
+
 /*
  * In-core ddt
  */
@@ -142,6 +204,12 @@ struct ddt {
 	ddt_histogram_t	ddt_histogram[DDT_TYPES][DDT_CLASSES];
 	ddt_histogram_t	ddt_histogram_cache[DDT_TYPES][DDT_CLASSES];
 	ddt_object_t	ddt_object_stats[DDT_TYPES][DDT_CLASSES];
+	ddt_log_t	ddt_log[2];
+	ddt_log_t	*ddt_log_active;	/* NULL if not logging */
+	ddt_log_t	*ddt_log_flushing;
+	ddt_log_record_t *ddt_log_buf;		/* records of this sync */
+	uint64_t	ddt_log_nrecords;
+	uint64_t	ddt_log_maxrecords;
 	avl_node_t	ddt_node;
 };
 
@@ -228,6 +296,7 @@ extern void ddt_enter(ddt_t *ddt);
 extern void ddt_exit(ddt_t *ddt);
 extern ddt_entry_t *ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add);
 extern void ddt_prefetch(spa_t *spa, const blkptr_t *bp);
+extern boolean_t ddt_addref(spa_t *spa, const blkptr_t *bp);
 extern void ddt_remove(ddt_t *ddt, ddt_entry_t *dde);
 
 extern boolean_t ddt_class_contains(spa_t *spa, enum ddt_class max_class,
@@ -236,6 +305,7 @@ extern boolean_t ddt_class_contains(spa_t *spa, enum ddt_class max_class,
 extern ddt_entry_t *ddt_repair_start(ddt_t *ddt, const blkptr_t *bp);
 extern void ddt_repair_done(ddt_t *ddt, ddt_entry_t *dde);
 
+extern int ddt_key_compare(const ddt_key_t *k1, const ddt_key_t *k2);
 extern int ddt_entry_compare(const void *x1, const void *x2);
 
 extern void ddt_create(spa_t *spa);
@@ -246,6 +316,21 @@ extern int ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde);
 extern int ddt_object_update(ddt_t *ddt, enum ddt_type type,
     enum ddt_class class, ddt_entry_t *dde, dmu_tx_t *tx);
 
+extern void ddt_log_alloc(ddt_t *ddt);
+extern void ddt_log_free(ddt_t *ddt);
+extern int ddt_log_load(ddt_t *ddt);
+extern void ddt_log_create(ddt_t *ddt, dmu_tx_t *tx);
+extern void ddt_log_destroy(ddt_t *ddt, dmu_tx_t *tx);
+extern boolean_t ddt_log_empty(ddt_t *ddt);
+extern ddt_log_entry_t *ddt_log_find(ddt_t *ddt, const ddt_key_t *ddk);
+extern void ddt_log_begin(ddt_t *ddt, uint64_t nrecords);
+extern void ddt_log_append(ddt_t *ddt, const ddt_entry_t *dde);
+extern void ddt_log_commit(ddt_t *ddt, dmu_tx_t *tx);
+extern void ddt_log_flushed(ddt_t *ddt, ddt_log_entry_t *ddle);
+extern void ddt_log_checkpoint(ddt_t *ddt, dmu_tx_t *tx);
+extern void ddt_log_truncate(ddt_t *ddt, ddt_log_t *ddl, dmu_tx_t *tx);
+extern void ddt_log_swap(ddt_t *ddt, dmu_tx_t *tx);
+
 extern const ddt_ops_t ddt_zap_ops;
 
 #ifdef	__cplusplus
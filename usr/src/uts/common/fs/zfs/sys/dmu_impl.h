@@ -118,11 +118,13 @@ extern "C" {
  * hash_mutexes (global)
  *   must be held before:
  *	db_mtx
- *   protects dbuf_hash_table (global) and db_hash_next
+ *   protects dbuf_hash_table (global) and db_hash_next against other
+ *   writers; lookups don't take it unless the table is being resized
  *   held from:
  *	dbuf_find: db_mtx
  *	dbuf_hash_insert: db_mtx
  *	dbuf_hash_remove: db_mtx
+ *	dbuf_hash_resize: (dbuf_hash_table, db_hash_next)
  *
  * db_mtx (meta-leaf)
  *   must be held before:
@@ -40,17 +40,33 @@ extern uint64_t	zfetch_array_rd_sz;
 
 struct dnode;				/* so we can reference dnode */
 
+/* number of unmatched accesses searched for a stride */
+#define	ZFETCH_HIST_SIZE	8
+
 typedef struct zfetch {
 	krwlock_t	zf_rwlock;	/* protects zfetch structure */
 	list_t		zf_stream;	/* list of zstream_t's */
 	struct dnode	*zf_dnode;	/* dnode that owns this zfetch */
 	int		zf_numstreams;	/* number of zstream_t's */
+	uint64_t	zf_hist[ZFETCH_HIST_SIZE]; /* recent unmatched blkids */
+	int		zf_hist_next;	/* next zf_hist slot to fill */
+	int		zf_hist_count;	/* number of valid zf_hist slots */
 } zfetch_t;
 
 typedef struct zstream {
 	uint64_t	zs_blkid;	/* expect next access at this blkid */
 	uint64_t	zs_pf_blkid;	/* next block to prefetch */
 
+	/*
+	 * A strided stream (forward or backward) expects each access to
+	 * start zs_stride blocks after the previous one, and to be
+	 * zs_nblks blocks long.  zs_pf_blkid is then the first block of
+	 * the next access to prefetch.  Sequential streams have a zero
+	 * stride.
+	 */
+	int64_t		zs_stride;
+	uint64_t	zs_nblks;
+
 	/*
 	 * We will next prefetch the L1 indirect block of this level-0
 	 * block id.
@@ -63,6 +79,10 @@ typedef struct zstream {
 	list_node_t	zs_node;	/* link for zf_stream */
 	zfetch_t	*zs_fetch;	/* parent fetch */
 	zfs_refcount_t	zs_blocks; /* number of pending blocks in the stream */
+	hrtime_t	zs_interval;	/* average time between accesses */
+	hrtime_t	zs_latency;	/* average prefetch completion time */
+	uint32_t	zs_pf_issued;	/* recent prefetches that did i/o */
+	uint32_t	zs_pf_cached;	/* recent prefetches already cached */
 } zstream_t;
 
 void		zfetch_init(void);
@@ -88,6 +88,12 @@ zfs_ssse3_available(void)
 	return (is_x86_feature(x86_featureset, X86FSET_SSSE3));
 }
 
+static inline boolean_t
+zfs_sse4_1_available(void)
+{
+	return (is_x86_feature(x86_featureset, X86FSET_SSE4_1));
+}
+
 static inline boolean_t
 zfs_avx_available(void)
 {
@@ -100,6 +106,12 @@ zfs_avx2_available(void)
 	return (is_x86_feature(x86_featureset, X86FSET_AVX2));
 }
 
+static inline boolean_t
+zfs_avx512f_available(void)
+{
+	return (is_x86_feature(x86_featureset, X86FSET_AVX512F));
+}
+
 #else	/* ! _KERNEL */
 
 #include <sys/auxv.h>
@@ -149,6 +161,15 @@ zfs_ssse3_available(void)
 	return ((u & AV_386_SSSE3) != 0);
 }
 
+static inline boolean_t
+zfs_sse4_1_available(void)
+{
+	uint32_t u = 0;
+
+	(void) getisax(&u, 1);
+	return ((u & AV_386_SSE4_1) != 0);
+}
+
 static inline boolean_t
 zfs_avx_available(void)
 {
@@ -167,6 +188,15 @@ zfs_avx2_available(void)
 	return ((u[1] & AV_386_2_AVX2) != 0);
 }
 
+static inline boolean_t
+zfs_avx512f_available(void)
+{
+	uint32_t u[2] = { 0 };
+
+	(void) getisax((uint32_t *)&u, 2);
+	return ((u[1] & AV_386_2_AVX512F) != 0);
+}
+
 #endif	/* _KERNEL */
 
 
@@ -136,8 +136,33 @@ struct uberblock {
 	 * the ZIL block is not allocated [see uses of spa_min_claim_txg()].
 	 */
 	uint64_t	ub_checkpoint_txg;
+
+	/*
+	 * ub_raidz_reflow_info records the progress of a raidz expansion.
+	 * It has to live in the uberblock because the MOS itself may be
+	 * stored on the vdev being expanded, and we must know which of its
+	 * sectors have already been moved before we can read it.
+	 *
+	 *   64      56      48      40      32      24      16      8       0
+	 *   +-------+-------+-------+-------+-------+-------+-------+-------+
+	 * 0 | S |          Reflow offset (in units of SPA_MINBLOCKSIZE)     |
+	 *   +-------+-------+-------+-------+-------+-------+-------+-------+
+	 *
+	 * S is set while an expansion is in progress.  Sectors of the
+	 * expanding vdev below the reflow offset use the new, wider layout.
+	 */
+	uint64_t	ub_raidz_reflow_info;
 };
 
+#define	RRSS_GET_OFFSET(ub) \
+	BF64_GET_SB((ub)->ub_raidz_reflow_info, 0, 63, SPA_MINBLOCKSHIFT, 0)
+#define	RRSS_SET_OFFSET(ub, x) \
+	BF64_SET_SB((ub)->ub_raidz_reflow_info, 0, 63, SPA_MINBLOCKSHIFT, 0, x)
+#define	RRSS_GET_ACTIVE(ub) \
+	BF64_GET((ub)->ub_raidz_reflow_info, 63, 1)
+#define	RRSS_SET_ACTIVE(ub, x) \
+	BF64_SET((ub)->ub_raidz_reflow_info, 63, 1, x)
+
 #ifdef	__cplusplus
 }
 #endif
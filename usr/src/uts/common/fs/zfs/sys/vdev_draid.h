@@ -0,0 +1,84 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_VDEV_DRAID_H
+#define	_SYS_VDEV_DRAID_H
+
+#include <sys/types.h>
+#include <sys/range_tree.h>
+#include <sys/vdev.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every group occupies VDEV_DRAID_ROWHEIGHT bytes on each of the children
+ * it is mapped to.  A "slice" is the set of ngroups groups that share a
+ * single permutation; each child contributes vdc_devslicesz bytes to it.
+ */
+#define	VDEV_DRAID_ROWHEIGHT	(1ULL << 24)
+
+/*
+ * Number of distinct base permutations.  Slices beyond the first
+ * VDEV_DRAID_NPERMS reuse a base permutation rotated by the slice's
+ * iteration count, so the table stays small regardless of vdev size.
+ */
+#define	VDEV_DRAID_NPERMS	64
+
+/*
+ * Seed for the permutation generator.  This is part of the on-disk format
+ * and must never change.
+ */
+#define	VDEV_DRAID_SEED		0xd7a1d5eedULL
+
+typedef struct vdev_draid_config {
+	uint64_t	vdc_ndata;	/* data sectors per row */
+	uint64_t	vdc_nparity;	/* parity sectors per row */
+	uint64_t	vdc_nspares;	/* distributed spares */
+	uint64_t	vdc_children;	/* total children */
+	uint64_t	vdc_ngroups;	/* redundancy groups per slice */
+	uint64_t	vdc_groupwidth;	/* ndata + nparity */
+	uint64_t	vdc_ndisks;	/* children - nspares */
+	uint64_t	vdc_groupsz;	/* logical bytes in one group */
+	uint64_t	vdc_devslicesz;	/* bytes per child per slice */
+	uint64_t	vdc_nperms;	/* rows in vdc_perms */
+	uint8_t		*vdc_perms;	/* nperms x children permutations */
+} vdev_draid_config_t;
+
+extern int vdev_draid_config_create(uint64_t children, uint64_t nparity,
+    uint64_t ndata, uint64_t nspares, uint64_t ngroups,
+    vdev_draid_config_t **vdcp);
+extern void vdev_draid_config_free(vdev_draid_config_t *vdc);
+extern boolean_t vdev_draid_spare_parse(const char *path, uint64_t *parityp,
+    uint64_t *topidp, uint64_t *spareidp);
+extern vdev_t *vdev_draid_spare_get_parent(vdev_t *vd);
+extern uint64_t vdev_draid_alloc_offset(vdev_t *vd, range_tree_t *rt,
+    uint64_t start, uint64_t size);
+extern uint64_t vdev_draid_group_size(vdev_t *vd);
+extern uint64_t vdev_draid_row_size(vdev_t *vd);
+extern uint64_t vdev_draid_asize_to_psize(vdev_t *vd, uint64_t asize);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_VDEV_DRAID_H */
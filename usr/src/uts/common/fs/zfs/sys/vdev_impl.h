@@ -41,6 +41,7 @@
 #include <sys/vdev_indirect_mapping.h>
 #include <sys/vdev_indirect_births.h>
 #include <sys/vdev_removal.h>
+#include <sys/vdev_rebuild.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -141,6 +142,22 @@ typedef struct vdev_queue_class {
 	 * LBA-ordered vs FIFO.
 	 */
 	avl_tree_t	vqc_queued_tree;
+
+	/*
+	 * State of the adaptive queue depth controller (see
+	 * vdev_queue_adapt()).  The device latencies of the i/os completed
+	 * since vqc_window_start are kept in the same log2 buckets as the
+	 * vdev_stat_ex_t latency histograms.
+	 */
+	uint32_t	vqc_max_active;	/* current limit on vqc_active */
+	boolean_t	vqc_limited;	/* i/os waited on vqc_max_active */
+	uint32_t	vqc_peak_active; /* most vqc_active in the window */
+	hrtime_t	vqc_window_start;
+	uint32_t	vqc_window_ios;
+	uint32_t	vqc_lat_histo[VDEV_L_HISTO_BUCKETS];
+	uint64_t	vqc_latency;	/* last measured latency (ns) */
+	uint64_t	vqc_increases;	/* times vqc_max_active was raised */
+	uint64_t	vqc_decreases;	/* times vqc_max_active was lowered */
 } vdev_queue_class_t;
 
 struct vdev_queue {
@@ -153,6 +170,7 @@ struct vdev_queue {
 	uint64_t	vq_last_offset;
 	hrtime_t	vq_io_complete_ts; /* time last i/o completed */
 	kmutex_t	vq_lock;
+	kstat_t		*vq_ksp;	/* adaptive queue depth kstats */
 };
 
 typedef enum vdev_alloc_bias {
@@ -309,6 +327,25 @@ struct vdev {
 	kcondvar_t	vdev_trim_io_cv;
 	uint64_t	vdev_trim_inflight[2];
 
+	/* Sequential rebuild related (top-level vdevs only) */
+	boolean_t	vdev_rebuilding;
+	boolean_t	vdev_rebuild_exit_wanted;
+	boolean_t	vdev_rebuild_reset_wanted;
+	kthread_t	*vdev_rebuild_thread;
+	/* Protects vdev_rebuild_thread and vdev_rebuild_config. */
+	kmutex_t	vdev_rebuild_lock;
+	kcondvar_t	vdev_rebuild_cv;
+	vdev_rebuild_t	vdev_rebuild_config;
+
+	/*
+	 * RAID-Z expansion (top-level raidz vdevs only).  vdev_rz_expand_txgs
+	 * holds, for each child attached after creation, the first txg whose
+	 * blocks are laid out across it; UINT64_MAX while it is being added.
+	 */
+	boolean_t	vdev_rz_expanding;
+	uint_t		vdev_rz_nexpand;
+	uint64_t	*vdev_rz_expand_txgs;
+
 	/*
 	 * Values stored in the config for an indirect or removing vdev.
 	 */
@@ -539,6 +576,8 @@ extern vdev_ops_t vdev_root_ops;
 extern vdev_ops_t vdev_mirror_ops;
 extern vdev_ops_t vdev_replacing_ops;
 extern vdev_ops_t vdev_raidz_ops;
+extern vdev_ops_t vdev_draid_ops;
+extern vdev_ops_t vdev_draid_spare_ops;
 extern vdev_ops_t vdev_disk_ops;
 extern vdev_ops_t vdev_file_ops;
 extern vdev_ops_t vdev_missing_ops;
@@ -27,6 +27,9 @@
 #define	_SYS_VDEV_RAIDZ_H
 
 #include <sys/types.h>
+#include <sys/fs/zfs.h>
+#include <sys/txg.h>
+#include <sys/zfs_rlock.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -34,6 +37,9 @@ extern "C" {
 
 struct zio;
 struct raidz_map;
+struct vdev;
+struct spa;
+struct dmu_tx;
 #if !defined(_KERNEL)
 struct kernel_param {};
 #endif
@@ -46,6 +52,57 @@ struct raidz_map *	vdev_raidz_map_alloc(struct zio *, uint64_t,
 void		vdev_raidz_map_free(struct raidz_map *);
 void 		vdev_raidz_generate_parity(struct raidz_map *);
 int 		vdev_raidz_reconstruct(struct raidz_map *, const int *, int);
+void		vdev_raidz_io_start_impl(struct zio *, struct raidz_map *);
+void		vdev_raidz_io_done(struct zio *);
+void		vdev_raidz_state_change(struct vdev *, int, int);
+uint64_t	vdev_raidz_logical_width(struct vdev *, uint64_t);
+uint64_t	vdev_raidz_asize_txg(struct vdev *, uint64_t, uint64_t);
+
+/*
+ * On-disk state of a raidz expansion, stored as an array of uint64_t in the
+ * expanding vdev's top-level ZAP under VDEV_TOP_ZAP_RAIDZ_EXPAND_PHYS.
+ * The reflow offset itself lives in the uberblock (ub_raidz_reflow_info).
+ * New fields may only be appended.
+ */
+typedef struct vdev_raidz_expand_phys {
+	uint64_t	vrep_state;		/* dsl_scan_state_t */
+	uint64_t	vrep_start_time;	/* start time */
+	uint64_t	vrep_end_time;		/* end time */
+	uint64_t	vrep_bytes_to_reflow;	/* allocated bytes at start */
+	uint64_t	vrep_bytes_reflowed;	/* bytes copied so far */
+} vdev_raidz_expand_phys_t;
+
+#define	RAIDZ_EXPAND_PHYS_ENTRIES	\
+	(sizeof (vdev_raidz_expand_phys_t) / sizeof (uint64_t))
+
+/*
+ * In-core state of a raidz expansion.  At most one expansion may be in
+ * progress per pool; spa_raidz_expand points to it.
+ *
+ * vre_offset is the reflow progress in the expanding vdev's (parent) offset
+ * space: sectors below it have been moved to the new, wider layout, and
+ * sectors at or above it are still in the old layout.  It is protected by
+ * vre_lock, and may only advance while the copied range is write-locked in
+ * vre_rangelock; I/O to the vdev read-locks the range it touches.
+ */
+typedef struct vdev_raidz_expand {
+	uint64_t	vre_vdev_id;
+	kmutex_t	vre_lock;
+	rangelock_t	vre_rangelock;
+	uint64_t	vre_offset;
+	uint64_t	vre_offset_pertxg[TXG_SIZE];
+	uint64_t	vre_bytes_reflowed_pertxg[TXG_SIZE];
+	boolean_t	vre_waiting_for_resilver;
+	int		vre_io_error;		/* error copying a chunk */
+	vdev_raidz_expand_phys_t vre_phys;	/* on-disk state */
+} vdev_raidz_expand_t;
+
+void	vdev_raidz_expand_init(struct spa *, uint64_t);
+void	vdev_raidz_expand_fini(struct spa *);
+void	vdev_raidz_expand_start(struct vdev *, struct dmu_tx *);
+int	vdev_raidz_expand_load(struct spa *);
+void	vdev_raidz_expand_start_thread(struct spa *);
+int	vdev_raidz_expand_get_stats(struct spa *, pool_raidz_expand_stat_t *);
 
 /*
  * vdev_raidz_math interface
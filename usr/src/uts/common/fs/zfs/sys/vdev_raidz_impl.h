@@ -108,6 +108,7 @@ typedef struct raidz_col {
 	abd_t *rc_abd;			/* I/O data */
 	void *rc_gdata;			/* used to store the "good" version */
 	int rc_error;			/* I/O error for this device */
+	int rc_skip_error;		/* I/O error writing its padding */
 	unsigned int rc_tried;		/* Did we attempt this I/O column? */
 	unsigned int rc_skipped;	/* Did we skip this I/O column? */
 } raidz_col_t;
@@ -123,10 +124,17 @@ typedef struct raidz_map {
 	size_t rm_nskip;		/* Skipped sectors for padding */
 	size_t rm_skipstart;		/* Column index of padding start */
 	void *rm_abd_copy;		/* rm_asize-buffer of copied data */
+	abd_t *rm_skip_abd;		/* zeroed padding sector, if written */
 	size_t rm_reports;		/* # of referencing checksum reports */
 	unsigned int rm_freed;		/* map no longer has referencing ZIO */
 	unsigned int rm_ecksuminjected;	/* checksum error was injected */
 	const raidz_impl_ops_t *rm_ops;	/* RAIDZ math operations */
+	boolean_t rm_reflow;		/* columns not contiguous on disk */
+	size_t rm_lcols;		/* Width the block was laid out for */
+	size_t rm_pcols;		/* Physical width below reflow offset */
+	uint64_t rm_reflow_offset;	/* Sector where the old layout begins */
+	uint64_t rm_ashift;		/* Sector size shift */
+	struct locked_range *rm_lr;	/* Held while vdev is expanding */
 	raidz_col_t rm_col[1];		/* Flexible array of I/O columns */
 } raidz_map_t;
 
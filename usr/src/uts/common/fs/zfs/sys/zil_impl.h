@@ -44,36 +44,55 @@ extern "C" {
  * transitioning from "closed" to "opened" the zilog's "zl_issuer_lock"
  * must be held.
  *
- * After the lwb is "opened", it can transition into the "issued" state
- * via zil_lwb_write_issue(). Again, the zilog's "zl_issuer_lock" must
- * be held when making this transition.
+ * While the lwb is "opened", itxs are assigned to it via
+ * zil_lwb_assign(): space is reserved in the lwb's buffer and the itx
+ * is linked onto the lwb's "lwb_itxs" list, but the log records aren't
+ * copied into the buffer yet. Once the lwb is full (or a commit
+ * waiter's timeout expires), zil_lwb_write_close() allocates the next
+ * block in the chain, and the lwb transitions into the "ready" state.
+ * Both of these happen with the zilog's "zl_issuer_lock" held.
+ *
+ * A "ready" lwb belongs to the thread that closed it. That thread drops
+ * the "zl_issuer_lock", copies the log records of the lwb's itxs into
+ * its buffer (calling the zilog's "zl_get_data" callback as needed),
+ * and then transitions the lwb into the "issued" state via
+ * zil_lwb_write_issue(). As the "zl_issuer_lock" isn't held for this,
+ * several threads may be filling and issuing lwbs at the same time;
+ * since the next block was allocated when the lwb was closed, the
+ * on-disk chain is the same regardless of the order they're issued in.
  *
  * After the lwb's write zio completes, it transitions into the "write
  * done" state via zil_lwb_write_done(); and then into the "flush done"
  * state via zil_lwb_flush_vdevs_done(). When transitioning from
- * "issued" to "write done", and then from "write done" to "flush done",
- * the zilog's "zl_lock" must be held, *not* the "zl_issuer_lock".
+ * "opened" to "ready", the zilog's "zl_lock" must be held in addition
+ * to the "zl_issuer_lock". When transitioning from "ready" to "issued",
+ * from "issued" to "write done", and then from "write done" to "flush
+ * done", the zilog's "zl_lock" must be held, *not* the
+ * "zl_issuer_lock".
  *
  * The zilog's "zl_issuer_lock" can become heavily contended in certain
  * workloads, so we specifically avoid acquiring that lock when
- * transitioning an lwb from "issued" to "done". This allows us to avoid
+ * transitioning an lwb from "ready" to "done". This allows us to avoid
  * having to acquire the "zl_issuer_lock" for each lwb ZIO completion,
  * which would have added more lock contention on an already heavily
  * contended lock.
  *
  * Additionally, correctness when reading an lwb's state is often
  * acheived by exploiting the fact that these state transitions occur in
- * this specific order; i.e. "closed" to "opened" to "issued" to "done".
+ * this specific order; i.e. "closed" to "opened" to "ready" to "issued"
+ * to "done".
  *
  * Thus, if an lwb is in the "closed" or "opened" state, holding the
  * "zl_issuer_lock" will prevent a concurrent thread from transitioning
- * that lwb to the "issued" state. Likewise, if an lwb is already in the
- * "issued" state, holding the "zl_lock" will prevent a concurrent
- * thread from transitioning that lwb to the "write done" state.
+ * that lwb to the "ready" state. Likewise, if an lwb is already in the
+ * "ready" or "issued" state, holding the "zl_lock" will prevent a
+ * concurrent thread from transitioning that lwb to the "write done"
+ * state.
  */
 typedef enum {
     LWB_STATE_CLOSED,
     LWB_STATE_OPENED,
+    LWB_STATE_READY,
     LWB_STATE_ISSUED,
     LWB_STATE_WRITE_DONE,
     LWB_STATE_FLUSH_DONE,
@@ -83,17 +102,20 @@ typedef enum {
 /*
  * Log write block (lwb)
  *
- * Prior to an lwb being issued to disk via zil_lwb_write_issue(), it
- * will be protected by the zilog's "zl_issuer_lock". Basically, prior
- * to it being issued, it will only be accessed by the thread that's
- * holding the "zl_issuer_lock". After the lwb is issued, the zilog's
- * "zl_lock" is used to protect the lwb against concurrent access.
+ * Prior to an lwb being closed via zil_lwb_write_close(), it will be
+ * protected by the zilog's "zl_issuer_lock". Basically, prior to it
+ * being closed, it will only be accessed by the thread that's holding
+ * the "zl_issuer_lock". A closed ("ready") lwb is only accessed by the
+ * thread that closed it, until it is issued via zil_lwb_write_issue().
+ * After the lwb is issued, the zilog's "zl_lock" is used to protect the
+ * lwb against concurrent access.
  */
 typedef struct lwb {
 	zilog_t		*lwb_zilog;	/* back pointer to log struct */
 	blkptr_t	lwb_blk;	/* on disk address of this log blk */
 	boolean_t	lwb_slog;	/* lwb_blk is on SLOG device */
-	int		lwb_nused;	/* # used bytes in buffer */
+	int		lwb_nused;	/* # used (reserved) bytes in buffer */
+	int		lwb_nfilled;	/* # filled bytes in buffer */
 	int		lwb_sz;		/* size of block and buffer */
 	lwb_state_t	lwb_state;	/* the state of this lwb */
 	char		*lwb_buf;	/* log write buffer */
@@ -101,7 +123,10 @@ typedef struct lwb {
 	zio_t		*lwb_root_zio;	/* root zio for lwb write and flushes */
 	dmu_tx_t	*lwb_tx;	/* tx for log block allocation */
 	uint64_t	lwb_max_txg;	/* highest txg in this lwb */
+	uint64_t	lwb_wait_txg;	/* txg to sync for dropped records */
 	list_node_t	lwb_node;	/* zilog->zl_lwb_list linkage */
+	list_node_t	lwb_issue_node;	/* linkage on list of lwbs to issue */
+	list_t		lwb_itxs;	/* list of itx's to fill the lwb with */
 	list_t		lwb_waiters;	/* list of zil_commit_waiter's */
 	avl_tree_t	lwb_vdev_tree;	/* vdevs to flush after lwb write */
 	kmutex_t	lwb_vdev_lock;	/* protects lwb_vdev_tree */
@@ -131,10 +156,20 @@ typedef struct zil_commit_waiter {
 	lwb_t		*zcw_lwb;	/* back pointer to lwb when linked */
 	boolean_t	zcw_done;	/* B_TRUE when "done", else B_FALSE */
 	int		zcw_zio_error;	/* contains the zio io_error value */
+	uint64_t	zcw_wait_txg;	/* txg to sync before returning */
 } zil_commit_waiter_t;
 
 /*
  * Intent log transaction lists
+ *
+ * To keep threads on different CPUs from contending on a single lock
+ * when assigning itxs, each zilog keeps "zl_itx_nsublists" independent
+ * sets of itx lists for every txg, and zil_itx_assign() picks one based
+ * on the current CPU. Every itx is stamped with a sequence number, taken
+ * from "zl_itx_seq" while holding its sublist's "itxg_lock", so each
+ * sublist's i_sync_list is sorted by that number, and the sublists can
+ * be merged back into the order the itxs were assigned in; see
+ * zil_get_commit_list().
  */
 typedef struct itxs {
 	list_t		i_sync_list;	/* list of synchronous itxs */
@@ -196,7 +231,10 @@ struct zilog {
 	uint64_t	zl_parse_lr_seq; /* highest lr seq on last parse */
 	uint64_t	zl_parse_blk_count; /* number of blocks parsed */
 	uint64_t	zl_parse_lr_count; /* number of log records parsed */
-	itxg_t		zl_itxg[TXG_SIZE]; /* intent log txg chains */
+	itxg_t		*zl_itxg;	/* intent log txg chains, per sublist */
+	uint_t		zl_itx_nsublists; /* number of itxg sublists */
+	uint64_t	zl_itx_seq;	/* last itx sequence number assigned */
+	uint64_t	zl_wait_txg;	/* highest lwb_wait_txg completed */
 	list_t		zl_itx_commit_list; /* itx list to be committed */
 	uint64_t	zl_cur_used;	/* current commit log size used */
 	list_t		zl_lwb_list;	/* in-flight log write list */
@@ -210,6 +248,17 @@ struct zilog {
 	uint64_t	zl_dirty_max_txg; /* highest txg used to dirty zilog */
 };
 
+/*
+ * The itxg for a given txg in a given sublist of a zilog.
+ */
+#define	ZIL_ITXG(zilog, s, txg)	\
+	(&(zilog)->zl_itxg[(s) * TXG_SIZE + ((txg) & TXG_MASK)])
+
+/*
+ * Upper bound on the number of itxg sublists of a zilog.
+ */
+#define	ZIL_ITX_SUBLISTS_MAX	64
+
 typedef struct zil_bp_node {
 	dva_t		zn_dva;
 	avl_node_t	zn_node;
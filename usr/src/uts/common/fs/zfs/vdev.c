@@ -53,6 +53,9 @@
 #include <sys/abd.h>
 #include <sys/vdev_initialize.h>
 #include <sys/vdev_trim.h>
+#include <sys/vdev_draid.h>
+#include <sys/vdev_rebuild.h>
+#include <sys/vdev_raidz.h>
 
 /*
  * Virtual device management.
@@ -61,6 +64,8 @@
 static vdev_ops_t *vdev_ops_table[] = {
 	&vdev_root_ops,
 	&vdev_raidz_ops,
+	&vdev_draid_ops,
+	&vdev_draid_spare_ops,
 	&vdev_mirror_ops,
 	&vdev_replacing_ops,
 	&vdev_spare_ops,
@@ -273,11 +278,26 @@ vdev_get_min_asize(vdev_t *vd)
 
 	/*
 	 * The allocatable space for a raidz vdev is N * sizeof(smallest child),
-	 * so each child must provide at least 1/Nth of its asize.
+	 * so each child must provide at least 1/Nth of its asize.  While an
+	 * expansion is in progress the new child doesn't count yet.
 	 */
-	if (pvd->vdev_ops == &vdev_raidz_ops)
-		return ((pvd->vdev_min_asize + pvd->vdev_children - 1) /
-		    pvd->vdev_children);
+	if (pvd->vdev_ops == &vdev_raidz_ops) {
+		uint64_t width = pvd->vdev_children - pvd->vdev_rz_expanding;
+
+		return ((pvd->vdev_min_asize + width - 1) / width);
+	}
+
+	/*
+	 * A dRAID vdev only uses whole slices, each of which takes the same
+	 * amount of space from every child.
+	 */
+	if (pvd->vdev_ops == &vdev_draid_ops) {
+		vdev_draid_config_t *vdc = pvd->vdev_tsd;
+		uint64_t slicesz = vdc->vdc_ngroups * vdc->vdc_groupsz;
+
+		return (((pvd->vdev_min_asize + slicesz - 1) / slicesz) *
+		    vdc->vdc_devslicesz);
+	}
 
 	return (pvd->vdev_min_asize);
 }
@@ -523,6 +543,11 @@ vdev_alloc_common(spa_t *spa, uint_t id, uint64_t guid, vdev_ops_t *ops)
 	cv_init(&vd->vdev_trim_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&vd->vdev_autotrim_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&vd->vdev_trim_io_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&vd->vdev_rebuild_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&vd->vdev_rebuild_cv, NULL, CV_DEFAULT, NULL);
+	mutex_init(&vd->vdev_rebuild_config.vr_io_lock, NULL, MUTEX_DEFAULT,
+	    NULL);
+	cv_init(&vd->vdev_rebuild_config.vr_io_cv, NULL, CV_DEFAULT, NULL);
 
 	for (int t = 0; t < DTL_TYPES; t++) {
 		vd->vdev_dtl[t] = range_tree_create(NULL, RANGE_SEG64, NULL, 0,
@@ -553,6 +578,7 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 	uint64_t guid = 0, islog, nparity;
 	vdev_t *vd;
 	vdev_indirect_config_t *vic;
+	vdev_draid_config_t *vdc = NULL;
 	vdev_alloc_bias_t alloc_bias = VDEV_BIAS_NONE;
 	boolean_t top_level = (parent && !parent->vdev_parent);
 
@@ -605,11 +631,48 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 	if (ops == &vdev_hole_ops && spa_version(spa) < SPA_VERSION_HOLES)
 		return (SET_ERROR(ENOTSUP));
 
+	if (ops == &vdev_draid_spare_ops) {
+		char *path;
+
+		if (nvlist_lookup_string(nv, ZPOOL_CONFIG_PATH, &path) != 0 ||
+		    !vdev_draid_spare_parse(path, NULL, NULL, NULL))
+			return (SET_ERROR(EINVAL));
+	}
+
 	/*
 	 * Set the nparity property for RAID-Z vdevs.
 	 */
 	nparity = -1ULL;
-	if (ops == &vdev_raidz_ops) {
+	if (ops == &vdev_draid_ops) {
+		uint64_t ndata, nspares = 0, ngroups = 0;
+		nvlist_t **child;
+		uint_t children;
+		int error;
+
+		if (!top_level ||
+		    nvlist_lookup_uint64(nv, ZPOOL_CONFIG_NPARITY,
+		    &nparity) != 0 ||
+		    nvlist_lookup_uint64(nv, ZPOOL_CONFIG_DRAID_NDATA,
+		    &ndata) != 0 ||
+		    nvlist_lookup_nvlist_array(nv, ZPOOL_CONFIG_CHILDREN,
+		    &child, &children) != 0)
+			return (SET_ERROR(EINVAL));
+		(void) nvlist_lookup_uint64(nv, ZPOOL_CONFIG_DRAID_NSPARES,
+		    &nspares);
+		(void) nvlist_lookup_uint64(nv, ZPOOL_CONFIG_DRAID_NGROUPS,
+		    &ngroups);
+
+		/* spa_vdev_add() expects feature to be enabled */
+		if (spa->spa_load_state != SPA_LOAD_CREATE &&
+		    alloctype == VDEV_ALLOC_ADD &&
+		    !spa_feature_is_enabled(spa, SPA_FEATURE_DRAID))
+			return (SET_ERROR(ENOTSUP));
+
+		error = vdev_draid_config_create(children, nparity, ndata,
+		    nspares, ngroups, &vdc);
+		if (error != 0)
+			return (error);
+	} else if (ops == &vdev_raidz_ops) {
 		if (nvlist_lookup_uint64(nv, ZPOOL_CONFIG_NPARITY,
 		    &nparity) == 0) {
 			if (nparity == 0 || nparity > VDEV_RAIDZ_MAXPARITY)
@@ -656,6 +719,8 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 			    spa->spa_load_state != SPA_LOAD_CREATE &&
 			    !spa_feature_is_enabled(spa,
 			    SPA_FEATURE_ALLOCATION_CLASSES)) {
+				if (vdc != NULL)
+					vdev_draid_config_free(vdc);
 				return (SET_ERROR(ENOTSUP));
 			}
 		}
@@ -666,6 +731,25 @@ vdev_alloc(spa_t *spa, vdev_t **vdp, nvlist_t *nv, vdev_t *parent, uint_t id,
 
 	vd->vdev_islog = islog;
 	vd->vdev_nparity = nparity;
+	if (vdc != NULL)
+		vd->vdev_tsd = vdc;
+
+	if (ops == &vdev_raidz_ops && top_level) {
+		uint64_t *txgs;
+		uint_t ntxgs;
+
+		if (nvlist_lookup_uint64_array(nv,
+		    ZPOOL_CONFIG_RAIDZ_EXPAND_TXGS, &txgs, &ntxgs) == 0 &&
+		    ntxgs != 0) {
+			vd->vdev_rz_expand_txgs =
+			    kmem_alloc(ntxgs * sizeof (uint64_t), KM_SLEEP);
+			bcopy(txgs, vd->vdev_rz_expand_txgs,
+			    ntxgs * sizeof (uint64_t));
+			vd->vdev_rz_nexpand = ntxgs;
+			vd->vdev_rz_expanding =
+			    (txgs[ntxgs - 1] == UINT64_MAX);
+		}
+	}
 	if (top_level && alloc_bias != VDEV_BIAS_NONE)
 		vd->vdev_alloc_bias = alloc_bias;
 
@@ -826,6 +910,7 @@ vdev_free(vdev_t *vd)
 	ASSERT3P(vd->vdev_initialize_thread, ==, NULL);
 	ASSERT3P(vd->vdev_trim_thread, ==, NULL);
 	ASSERT3P(vd->vdev_autotrim_thread, ==, NULL);
+	ASSERT3P(vd->vdev_rebuild_thread, ==, NULL);
 
 	/*
 	 * Scan queues are normally destroyed at the end of a scan. If the
@@ -898,6 +983,18 @@ vdev_free(vdev_t *vd)
 	if (vd->vdev_isl2cache)
 		spa_l2cache_remove(vd);
 
+	if (vd->vdev_ops == &vdev_draid_ops && vd->vdev_tsd != NULL) {
+		vdev_draid_config_free(vd->vdev_tsd);
+		vd->vdev_tsd = NULL;
+	}
+
+	if (vd->vdev_rz_expand_txgs != NULL) {
+		kmem_free(vd->vdev_rz_expand_txgs,
+		    vd->vdev_rz_nexpand * sizeof (uint64_t));
+		vd->vdev_rz_expand_txgs = NULL;
+		vd->vdev_rz_nexpand = 0;
+	}
+
 	txg_list_destroy(&vd->vdev_ms_list);
 	txg_list_destroy(&vd->vdev_dtl_list);
 
@@ -940,6 +1037,10 @@ vdev_free(vdev_t *vd)
 	cv_destroy(&vd->vdev_trim_cv);
 	cv_destroy(&vd->vdev_autotrim_cv);
 	cv_destroy(&vd->vdev_trim_io_cv);
+	mutex_destroy(&vd->vdev_rebuild_lock);
+	cv_destroy(&vd->vdev_rebuild_cv);
+	mutex_destroy(&vd->vdev_rebuild_config.vr_io_lock);
+	cv_destroy(&vd->vdev_rebuild_config.vr_io_cv);
 
 	if (vd == spa->spa_root_vdev)
 		spa->spa_root_vdev = NULL;
@@ -1504,8 +1605,12 @@ vdev_uses_zvols(vdev_t *vd)
 	return (B_FALSE);
 }
 
+/*
+ * Open the children of vd for which open_func returns B_TRUE, or all of
+ * them if open_func is NULL.
+ */
 void
-vdev_open_children(vdev_t *vd)
+vdev_open_children_subset(vdev_t *vd, boolean_t (*open_func)(vdev_t *))
 {
 	taskq_t *tq;
 	int children = vd->vdev_children;
@@ -1517,18 +1622,27 @@ vdev_open_children(vdev_t *vd)
 	 */
 	if (vdev_uses_zvols(vd)) {
 retry_sync:
-		for (int c = 0; c < children; c++)
-			vd->vdev_child[c]->vdev_open_error =
-			    vdev_open(vd->vdev_child[c]);
+		for (int c = 0; c < children; c++) {
+			vdev_t *cvd = vd->vdev_child[c];
+
+			if (open_func != NULL && !open_func(cvd))
+				continue;
+			cvd->vdev_open_error = vdev_open(cvd);
+		}
 	} else {
 		tq = taskq_create("vdev_open", children, minclsyspri,
 		    children, children, TASKQ_PREPOPULATE);
 		if (tq == NULL)
 			goto retry_sync;
 
-		for (int c = 0; c < children; c++)
+		for (int c = 0; c < children; c++) {
+			vdev_t *cvd = vd->vdev_child[c];
+
+			if (open_func != NULL && !open_func(cvd))
+				continue;
 			VERIFY(taskq_dispatch(tq, vdev_open_child,
-			    vd->vdev_child[c], TQ_SLEEP) != TASKQID_INVALID);
+			    cvd, TQ_SLEEP) != TASKQID_INVALID);
+		}
 
 		taskq_destroy(tq);
 	}
@@ -1539,6 +1653,12 @@ retry_sync:
 		vd->vdev_nonrot &= vd->vdev_child[c]->vdev_nonrot;
 }
 
+void
+vdev_open_children(vdev_t *vd)
+{
+	vdev_open_children_subset(vd, NULL);
+}
+
 /*
  * Compute the raidz-deflation ratio.  Note, we hard-code
  * in 128k (1 << 17) because it is the "typical" blocksize.
@@ -1550,7 +1670,8 @@ vdev_set_deflate_ratio(vdev_t *vd)
 {
 	if (vd == vd->vdev_top && !vd->vdev_ishole && vd->vdev_ashift != 0) {
 		vd->vdev_deflate_ratio = (1 << 17) /
-		    (vdev_psize_to_asize(vd, 1 << 17) >> SPA_MINBLOCKSHIFT);
+		    (vdev_psize_to_asize_txg(vd, 1 << 17, 0) >>
+		    SPA_MINBLOCKSHIFT);
 	}
 }
 
@@ -1817,6 +1938,12 @@ vdev_validate(vdev_t *vd)
 	if (!vd->vdev_ops->vdev_op_leaf || !vdev_readable(vd))
 		return (0);
 
+	/*
+	 * Distributed spares have no label of their own.
+	 */
+	if (vd->vdev_ops == &vdev_draid_spare_ops)
+		return (0);
+
 	/*
 	 * If we are performing an extreme rewind, we allow for a label that
 	 * was modified at a point after the current txg.
@@ -2480,7 +2607,7 @@ vdev_dtl_max(vdev_t *vd)
  * excise the DTLs.
  */
 static boolean_t
-vdev_dtl_should_excise(vdev_t *vd)
+vdev_dtl_should_excise(vdev_t *vd, boolean_t rebuild_done)
 {
 	spa_t *spa = vd->vdev_spa;
 	dsl_scan_t *scn = spa->spa_dsl_pool->dp_scan;
@@ -2493,6 +2620,20 @@ vdev_dtl_should_excise(vdev_t *vd)
 	if (vd->vdev_resilver_deferred)
 		return (B_FALSE);
 
+	/*
+	 * A sequential rebuild only reconstructs children whose DTL covered
+	 * every txg when it started, i.e. those attached before it began.
+	 * Other DTLs, such as those from a transient outage, are left for
+	 * a resilver to repair.
+	 */
+	if (rebuild_done) {
+		vdev_rebuild_phys_t *vrp =
+		    &vd->vdev_top->vdev_rebuild_config.vr_rebuild_phys;
+
+		return (vd->vdev_resilver_txg != 0 &&
+		    vd->vdev_resilver_txg <= vrp->vrp_max_txg);
+	}
+
 	if (vd->vdev_resilver_txg == 0 ||
 	    range_tree_is_empty(vd->vdev_dtl[DTL_MISSING]))
 		return (B_TRUE);
@@ -2514,10 +2655,13 @@ vdev_dtl_should_excise(vdev_t *vd)
 }
 
 /*
- * Reassess DTLs after a config change or scrub completion.
+ * Reassess DTLs after a config change or scrub completion.  If
+ * rebuild_done is set, scrub_txg is the last txg covered by a completed
+ * sequential rebuild of vd's top-level vdev rather than by a scan.
  */
 void
-vdev_dtl_reassess(vdev_t *vd, uint64_t txg, uint64_t scrub_txg, int scrub_done)
+vdev_dtl_reassess(vdev_t *vd, uint64_t txg, uint64_t scrub_txg,
+    int scrub_done, boolean_t rebuild_done)
 {
 	spa_t *spa = vd->vdev_spa;
 	avl_tree_t reftree;
@@ -2527,7 +2671,7 @@ vdev_dtl_reassess(vdev_t *vd, uint64_t txg, uint64_t scrub_txg, int scrub_done)
 
 	for (int c = 0; c < vd->vdev_children; c++)
 		vdev_dtl_reassess(vd->vdev_child[c], txg,
-		    scrub_txg, scrub_done);
+		    scrub_txg, scrub_done, rebuild_done);
 
 	if (vd == spa->spa_root_vdev || !vdev_is_concrete(vd) || vd->vdev_aux)
 		return;
@@ -2562,10 +2706,18 @@ vdev_dtl_reassess(vdev_t *vd, uint64_t txg, uint64_t scrub_txg, int scrub_done)
 		 * excise regions on vdevs that were available during
 		 * the entire duration of this scan.
 		 */
-		if (scrub_txg != 0 &&
-		    (spa->spa_scrub_started ||
-		    (scn != NULL && scn->scn_phys.scn_errors == 0)) &&
-		    vdev_dtl_should_excise(vd)) {
+		boolean_t check_excise = B_FALSE;
+		if (rebuild_done) {
+			vdev_rebuild_phys_t *vrp =
+			    &vd->vdev_top->vdev_rebuild_config.vr_rebuild_phys;
+			check_excise = (vrp->vrp_errors == 0);
+		} else if (spa->spa_scrub_started ||
+		    (scn != NULL && scn->scn_phys.scn_errors == 0)) {
+			check_excise = B_TRUE;
+		}
+
+		if (scrub_txg != 0 && check_excise &&
+		    vdev_dtl_should_excise(vd, rebuild_done)) {
 			/*
 			 * We completed a scrub up to scrub_txg.  If we
 			 * did it without rebooting, then the scrub dtl
@@ -2587,8 +2739,10 @@ vdev_dtl_reassess(vdev_t *vd, uint64_t txg, uint64_t scrub_txg, int scrub_done)
 			space_reftree_add_map(&reftree,
 			    vd->vdev_dtl[DTL_MISSING], 1);
 			space_reftree_add_seg(&reftree, 0, scrub_txg, -1);
-			space_reftree_add_map(&reftree,
-			    vd->vdev_dtl[DTL_SCRUB], 2);
+			if (!rebuild_done) {
+				space_reftree_add_map(&reftree,
+				    vd->vdev_dtl[DTL_SCRUB], 2);
+			}
 			space_reftree_generate_map(&reftree,
 			    vd->vdev_dtl[DTL_MISSING], 1);
 			space_reftree_destroy(&reftree);
@@ -2749,6 +2903,12 @@ vdev_construct_zaps(vdev_t *vd, dmu_tx_t *tx)
 			vd->vdev_top_zap = vdev_create_link_zap(vd, tx);
 			if (vd->vdev_alloc_bias != VDEV_BIAS_NONE)
 				vdev_zap_allocation_data(vd, tx);
+			if (vd->vdev_ops == &vdev_draid_ops) {
+				ASSERT(spa_feature_is_enabled(vd->vdev_spa,
+				    SPA_FEATURE_DRAID));
+				spa_feature_incr(vd->vdev_spa,
+				    SPA_FEATURE_DRAID, tx);
+			}
 		}
 	}
 
@@ -2855,10 +3015,10 @@ vdev_dtl_required(vdev_t *vd)
 	 * If not, we can safely offline/detach/remove the device.
 	 */
 	vd->vdev_cant_read = B_TRUE;
-	vdev_dtl_reassess(tvd, 0, 0, B_FALSE);
+	vdev_dtl_reassess(tvd, 0, 0, B_FALSE, B_FALSE);
 	required = !vdev_dtl_empty(tvd, DTL_OUTAGE);
 	vd->vdev_cant_read = cant_read;
-	vdev_dtl_reassess(tvd, 0, 0, B_FALSE);
+	vdev_dtl_reassess(tvd, 0, 0, B_FALSE, B_FALSE);
 
 	if (!required && zio_injection_enabled)
 		required = !!zio_handle_device_injection(vd, NULL, ECHILD);
@@ -3237,6 +3397,31 @@ vdev_psize_to_asize(vdev_t *vd, uint64_t psize)
 	return (vd->vdev_ops->vdev_op_asize(vd, psize));
 }
 
+/*
+ * Like vdev_psize_to_asize(), but for a block born in the given txg.  This
+ * only differs for a raidz vdev that has been expanded, where blocks keep
+ * the width they were written at.
+ */
+uint64_t
+vdev_psize_to_asize_txg(vdev_t *vd, uint64_t psize, uint64_t txg)
+{
+	if (vd->vdev_ops == &vdev_raidz_ops)
+		return (vdev_raidz_asize_txg(vd, psize, txg));
+
+	return (vdev_psize_to_asize(vd, psize));
+}
+
+/*
+ * The size of a gang header isn't recorded in its DVA, so it must not depend
+ * on when the header was written.  Use the vdev's original width, which
+ * gives the largest asize.
+ */
+uint64_t
+vdev_gang_header_asize(vdev_t *vd)
+{
+	return (vdev_psize_to_asize_txg(vd, SPA_GANGBLOCKSIZE, 0));
+}
+
 /*
  * Mark the given vdev faulted.  A faulted vdev behaves as if the device could
  * not be opened, and no I/O is attempted.
@@ -3840,6 +4025,12 @@ vdev_get_stats_ex(vdev_t *vd, vdev_stat_t *vs, vdev_stat_ex_t *vsx)
 		}
 		if (vd->vdev_ops->vdev_op_leaf)
 			vs->vs_resilver_deferred = vd->vdev_resilver_deferred;
+
+		/*
+		 * Report sequential rebuild progress on top-level vdevs.
+		 */
+		if (vd->vdev_aux == NULL && vd == vd->vdev_top)
+			vdev_rebuild_get_stats(vd, vs);
 	}
 
 	vdev_get_stats_ex_impl(vd, vs, vsx);
@@ -0,0 +1,801 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/vdev_impl.h>
+#include <sys/vdev_draid.h>
+#include <sys/vdev_raidz.h>
+#include <sys/vdev_raidz_impl.h>
+#include <sys/zio.h>
+#include <sys/abd.h>
+#include <sys/fs/zfs.h>
+
+/*
+ * Virtual device vector for declustered RAID (dRAID).
+ *
+ * A dRAID vdev stores fixed-width RAID-Z style stripes of ndata data and
+ * nparity parity sectors ("groups" of width d+p) on a larger set of
+ * children, and reserves the equivalent of nspares children worth of space
+ * as distributed spare capacity.  When a child fails, its contents can be
+ * rebuilt onto a distributed spare ("dspare") whose space is spread across
+ * every surviving child, so the rebuild is not limited by the write
+ * bandwidth of a single replacement disk.
+ *
+ * Layout
+ *
+ * The vdev's address space is divided into slices.  Each slice holds
+ * ngroups groups, and each group is VDEV_DRAID_ROWHEIGHT bytes tall on each
+ * of its d+p columns.  Within a slice the groups are laid out back to back
+ * over the first ndisks (children - nspares) slots of a permutation of the
+ * children; the remaining nspares slots hold the spare capacity for that
+ * slice.  Every slice uses a different permutation, so both the stripes of
+ * a failed child and the spare space that replaces it are spread evenly
+ * over the surviving children.
+ *
+ *	slice p, permutation P:	slot 0 .. ndisks-1	ndisks .. children-1
+ *				[ g0 | g0 | g1 | ... ]	[ spare 0 | spare 1 ]
+ *
+ * Column j of group g in slice p lives on child P[(g * gw + j) % ndisks],
+ * in physical row (g * gw + j) / ndisks of that slice.
+ *
+ * Unlike RAID-Z, the stripe width is fixed: every block occupies a whole
+ * number of rows of d+p sectors and starts at the beginning of a row.  Any
+ * unused data sectors in the final row are written as zeros.  Parity is
+ * therefore valid for every allocated row without reference to the block
+ * pointers, which is what allows a failed child to be rebuilt sequentially
+ * (see vdev_rebuild.c).  The allocator is told about these constraints via
+ * vdev_draid_alloc_offset().
+ *
+ * The per-block I/O, parity and reconstruction logic is shared with RAID-Z;
+ * this file only supplies the mapping from logical offsets to columns.
+ */
+
+/*
+ * Simple xorshift generator used to build the permutations.  The output
+ * only needs to be well mixed and stable across platforms and releases.
+ */
+static uint64_t
+vdev_draid_rand(uint64_t *s)
+{
+	uint64_t x = *s;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*s = x;
+
+	return (x);
+}
+
+static uint64_t
+vdev_draid_gcd(uint64_t a, uint64_t b)
+{
+	while (b != 0) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return (a);
+}
+
+static void
+vdev_draid_generate_perms(vdev_draid_config_t *vdc)
+{
+	uint64_t children = vdc->vdc_children;
+	uint64_t seed = VDEV_DRAID_SEED + children;
+
+	for (uint64_t i = 0; i < vdc->vdc_nperms; i++) {
+		uint8_t *perm = &vdc->vdc_perms[i * children];
+
+		for (uint64_t j = 0; j < children; j++)
+			perm[j] = j;
+
+		/* Fisher-Yates shuffle */
+		for (uint64_t j = children - 1; j > 0; j--) {
+			uint64_t k = vdev_draid_rand(&seed) % (j + 1);
+			uint8_t tmp = perm[j];
+
+			perm[j] = perm[k];
+			perm[k] = tmp;
+		}
+	}
+}
+
+/*
+ * Construct the in-core description of a dRAID layout.  ngroups may be
+ * zero, in which case the smallest number of groups that fills a whole
+ * number of rows on every child is used.
+ */
+int
+vdev_draid_config_create(uint64_t children, uint64_t nparity, uint64_t ndata,
+    uint64_t nspares, uint64_t ngroups, vdev_draid_config_t **vdcp)
+{
+	vdev_draid_config_t *vdc;
+	uint64_t groupwidth = ndata + nparity;
+	uint64_t ndisks;
+
+	if (nparity == 0 || nparity > VDEV_DRAID_MAXPARITY || ndata == 0 ||
+	    nspares > VDEV_DRAID_MAX_SPARES ||
+	    children > VDEV_DRAID_MAX_CHILDREN || children <= nspares)
+		return (SET_ERROR(EINVAL));
+
+	ndisks = children - nspares;
+	if (groupwidth > ndisks)
+		return (SET_ERROR(EINVAL));
+
+	if (ngroups == 0)
+		ngroups = ndisks / vdev_draid_gcd(groupwidth, ndisks);
+
+	/*
+	 * The groups of a slice must fill a whole number of rows on every
+	 * child so that each slice is the same size on every child.
+	 */
+	if ((ngroups * groupwidth) % ndisks != 0)
+		return (SET_ERROR(EINVAL));
+
+	vdc = kmem_zalloc(sizeof (*vdc), KM_SLEEP);
+	vdc->vdc_ndata = ndata;
+	vdc->vdc_nparity = nparity;
+	vdc->vdc_nspares = nspares;
+	vdc->vdc_children = children;
+	vdc->vdc_ngroups = ngroups;
+	vdc->vdc_groupwidth = groupwidth;
+	vdc->vdc_ndisks = ndisks;
+	vdc->vdc_groupsz = groupwidth * VDEV_DRAID_ROWHEIGHT;
+	vdc->vdc_devslicesz = (ngroups * groupwidth / ndisks) *
+	    VDEV_DRAID_ROWHEIGHT;
+	vdc->vdc_nperms = VDEV_DRAID_NPERMS;
+	vdc->vdc_perms = kmem_alloc(vdc->vdc_nperms * children, KM_SLEEP);
+	vdev_draid_generate_perms(vdc);
+
+	*vdcp = vdc;
+	return (0);
+}
+
+void
+vdev_draid_config_free(vdev_draid_config_t *vdc)
+{
+	kmem_free(vdc->vdc_perms, vdc->vdc_nperms * vdc->vdc_children);
+	kmem_free(vdc, sizeof (*vdc));
+}
+
+/*
+ * Return the child holding the given permutation slot of a slice.  Slices
+ * past the end of the permutation table reuse a base permutation rotated
+ * by the number of times the table has wrapped.
+ */
+static uint64_t
+vdev_draid_slot_to_child(const vdev_draid_config_t *vdc, uint64_t slice,
+    uint64_t slot)
+{
+	const uint8_t *perm =
+	    &vdc->vdc_perms[(slice % vdc->vdc_nperms) * vdc->vdc_children];
+	uint64_t iter = slice / vdc->vdc_nperms;
+
+	ASSERT3U(slot, <, vdc->vdc_children);
+
+	return ((perm[slot] + iter) % vdc->vdc_children);
+}
+
+/*
+ * Logical bytes covered by one slice.
+ */
+static uint64_t
+vdev_draid_slice_size(const vdev_draid_config_t *vdc)
+{
+	return (vdc->vdc_ngroups * vdc->vdc_groupsz);
+}
+
+uint64_t
+vdev_draid_group_size(vdev_t *vd)
+{
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+
+	ASSERT3P(vd->vdev_ops, ==, &vdev_draid_ops);
+	return (vdc->vdc_groupsz);
+}
+
+uint64_t
+vdev_draid_row_size(vdev_t *vd)
+{
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+
+	ASSERT3P(vd->vdev_ops, ==, &vdev_draid_ops);
+	return (vdc->vdc_groupwidth << vd->vdev_top->vdev_ashift);
+}
+
+/*
+ * Return the amount of data held in asize bytes of whole rows.
+ */
+uint64_t
+vdev_draid_asize_to_psize(vdev_t *vd, uint64_t asize)
+{
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+
+	ASSERT0(asize % vdev_draid_row_size(vd));
+	return ((asize / vdc->vdc_groupwidth) * vdc->vdc_ndata);
+}
+
+/*
+ * A block must start on a row boundary and must not straddle groups.
+ * Given an offset chosen by the metaslab allocator, return the nearest
+ * offset at or after it that satisfies both constraints, provided the
+ * segment is still free in rt.  Returns -1ULL if there is none.
+ */
+uint64_t
+vdev_draid_alloc_offset(vdev_t *vd, range_tree_t *rt, uint64_t start,
+    uint64_t size)
+{
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+	uint64_t rowsz = vdev_draid_row_size(vd);
+	uint64_t gstart = start - (start % vdc->vdc_groupsz);
+	uint64_t offset;
+
+	ASSERT3P(vd->vdev_ops, ==, &vdev_draid_ops);
+	ASSERT0(size % rowsz);
+	ASSERT3U(size, <=, vdc->vdc_groupsz);
+
+	offset = gstart + roundup(start - gstart, rowsz);
+	if (offset + size > gstart + vdc->vdc_groupsz)
+		offset = gstart + vdc->vdc_groupsz;
+
+	if (offset != start && !range_tree_contains(rt, offset, size))
+		return (-1ULL);
+
+	return (offset);
+}
+
+static raidz_map_t *
+vdev_draid_map_alloc(zio_t *zio)
+{
+	vdev_t *vd = zio->io_vd;
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+	uint64_t ashift = vd->vdev_top->vdev_ashift;
+	uint64_t ndata = vdc->vdc_ndata;
+	uint64_t nparity = vdc->vdc_nparity;
+	uint64_t gw = vdc->vdc_groupwidth;
+	raidz_map_t *rm;
+
+	/* Locate the group and the row within it. */
+	uint64_t gidx = zio->io_offset / vdc->vdc_groupsz;
+	uint64_t slice = gidx / vdc->vdc_ngroups;
+	uint64_t group = gidx % vdc->vdc_ngroups;
+	uint64_t gsector = (zio->io_offset % vdc->vdc_groupsz) >> ashift;
+	uint64_t row = gsector / gw;
+	uint64_t base = slice * vdc->vdc_devslicesz + (row << ashift);
+
+	/* The zio's size in units of the vdev's minimum sector size. */
+	uint64_t s = zio->io_size >> ashift;
+	uint64_t q, r, bc, acols, rows, off;
+
+	ASSERT0(gsector % gw);
+
+	q = s / ndata;
+	r = s - q * ndata;
+	bc = (r == 0 ? 0 : r + nparity);
+	acols = (q == 0 ? bc : gw);
+	rows = q + (r == 0 ? 0 : 1);
+
+	ASSERT3U(row + rows, <=, VDEV_DRAID_ROWHEIGHT >> ashift);
+
+	rm = kmem_alloc(offsetof(raidz_map_t, rm_col[gw]), KM_SLEEP);
+
+	rm->rm_cols = acols;
+	rm->rm_scols = gw;
+	rm->rm_bigcols = bc;
+	rm->rm_skipstart = bc;
+	rm->rm_missingdata = 0;
+	rm->rm_missingparity = 0;
+	rm->rm_firstdatacol = nparity;
+	rm->rm_abd_copy = NULL;
+	rm->rm_skip_abd = NULL;
+	rm->rm_reports = 0;
+	rm->rm_freed = 0;
+	rm->rm_ecksuminjected = 0;
+	rm->rm_reflow = B_FALSE;
+	rm->rm_lr = NULL;
+	rm->rm_asize = (rows * gw) << ashift;
+	rm->rm_nskip = rows * ndata - s;
+
+	for (uint64_t c = 0; c < gw; c++) {
+		raidz_col_t *rc = &rm->rm_col[c];
+		uint64_t x = group * gw + c;
+
+		rc->rc_devidx = vdev_draid_slot_to_child(vdc, slice,
+		    x % vdc->vdc_ndisks);
+		rc->rc_offset = base + (x / vdc->vdc_ndisks) *
+		    VDEV_DRAID_ROWHEIGHT;
+		rc->rc_abd = NULL;
+		rc->rc_gdata = NULL;
+		rc->rc_error = 0;
+		rc->rc_skip_error = 0;
+		rc->rc_tried = 0;
+		rc->rc_skipped = 0;
+
+		if (c >= acols)
+			rc->rc_size = 0;
+		else if (c < bc)
+			rc->rc_size = (q + 1) << ashift;
+		else
+			rc->rc_size = q << ashift;
+	}
+
+	ASSERT3U(rm->rm_nskip, ==, (r == 0 ? 0 : gw - bc));
+
+	for (uint64_t c = 0; c < nparity; c++) {
+		rm->rm_col[c].rc_abd =
+		    abd_alloc_linear(rm->rm_col[c].rc_size, B_FALSE);
+	}
+
+	off = 0;
+	for (uint64_t c = nparity; c < acols; c++) {
+		rm->rm_col[c].rc_abd = abd_get_offset_size(zio->io_abd, off,
+		    rm->rm_col[c].rc_size);
+		off += rm->rm_col[c].rc_size;
+	}
+	ASSERT3U(off, ==, zio->io_size);
+
+	/*
+	 * The padding at the end of a short final row is written as zeros so
+	 * that parity is correct for the whole row.
+	 */
+	if (rm->rm_nskip != 0) {
+		rm->rm_skip_abd = abd_alloc_linear(1ULL << ashift, B_TRUE);
+		abd_zero(rm->rm_skip_abd, 1ULL << ashift);
+	}
+
+	/* init RAIDZ parity ops */
+	rm->rm_ops = vdev_raidz_math_get_ops();
+
+	return (rm);
+}
+
+/*
+ * Children holding a distributed spare must be opened after the rest,
+ * since the size of a distributed spare is derived from its siblings.
+ */
+static boolean_t
+vdev_draid_open_spares(vdev_t *vd)
+{
+	if (vd->vdev_ops == &vdev_draid_spare_ops)
+		return (B_TRUE);
+
+	for (int c = 0; c < vd->vdev_children; c++) {
+		if (vdev_draid_open_spares(vd->vdev_child[c]))
+			return (B_TRUE);
+	}
+
+	return (B_FALSE);
+}
+
+static boolean_t
+vdev_draid_open_children(vdev_t *vd)
+{
+	return (!vdev_draid_open_spares(vd));
+}
+
+/*
+ * Return the smallest allocatable size of the children that are open.
+ * Children which have never been opened have an asize of zero and are
+ * ignored.
+ */
+static uint64_t
+vdev_draid_min_child_asize(vdev_t *vd, uint64_t *max_asizep)
+{
+	uint64_t asize = 0, max_asize = 0;
+
+	for (int c = 0; c < vd->vdev_children; c++) {
+		vdev_t *cvd = vd->vdev_child[c];
+
+		asize = MIN(asize - 1, cvd->vdev_asize - 1) + 1;
+		max_asize = MIN(max_asize - 1, cvd->vdev_max_asize - 1) + 1;
+	}
+
+	if (max_asizep != NULL)
+		*max_asizep = max_asize;
+
+	return (asize);
+}
+
+static int
+vdev_draid_open(vdev_t *vd, uint64_t *asize, uint64_t *max_asize,
+    uint64_t *ashift)
+{
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+	uint64_t nparity = vd->vdev_nparity;
+	uint64_t slicesz, nslices;
+	int lasterror = 0;
+	int numerrors = 0;
+
+	ASSERT(nparity > 0);
+
+	if (vdc == NULL || nparity > VDEV_DRAID_MAXPARITY ||
+	    vd->vdev_children != vdc->vdc_children ||
+	    nparity != vdc->vdc_nparity) {
+		vd->vdev_stat.vs_aux = VDEV_AUX_BAD_LABEL;
+		return (SET_ERROR(EINVAL));
+	}
+
+	vdev_open_children_subset(vd, vdev_draid_open_children);
+	vdev_open_children_subset(vd, vdev_draid_open_spares);
+
+	for (int c = 0; c < vd->vdev_children; c++) {
+		vdev_t *cvd = vd->vdev_child[c];
+
+		if (cvd->vdev_open_error != 0) {
+			lasterror = cvd->vdev_open_error;
+			numerrors++;
+			continue;
+		}
+
+		*asize = MIN(*asize - 1, cvd->vdev_asize - 1) + 1;
+		*max_asize = MIN(*max_asize - 1, cvd->vdev_max_asize - 1) + 1;
+		*ashift = MAX(*ashift, cvd->vdev_ashift);
+	}
+
+	if (numerrors > nparity) {
+		vd->vdev_stat.vs_aux = VDEV_AUX_NO_REPLICAS;
+		return (lasterror);
+	}
+
+	/*
+	 * Only whole slices are usable.  Every child contributes
+	 * vdc_devslicesz bytes to each slice.
+	 */
+	slicesz = vdev_draid_slice_size(vdc);
+	nslices = *asize / vdc->vdc_devslicesz;
+	if (nslices == 0) {
+		vd->vdev_stat.vs_aux = VDEV_AUX_TOO_SMALL;
+		return (SET_ERROR(EOVERFLOW));
+	}
+
+	*asize = nslices * slicesz;
+	*max_asize = (*max_asize / vdc->vdc_devslicesz) * slicesz;
+
+	return (0);
+}
+
+static void
+vdev_draid_close(vdev_t *vd)
+{
+	for (int c = 0; c < vd->vdev_children; c++)
+		vdev_close(vd->vdev_child[c]);
+}
+
+/*
+ * Every block is padded out to a whole number of d+p rows.
+ */
+static uint64_t
+vdev_draid_asize(vdev_t *vd, uint64_t psize)
+{
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+	uint64_t ashift = vd->vdev_top->vdev_ashift;
+	uint64_t sectors = ((psize - 1) >> ashift) + 1;
+	uint64_t rows = (sectors + vdc->vdc_ndata - 1) / vdc->vdc_ndata;
+
+	return ((rows * vdc->vdc_groupwidth) << ashift);
+}
+
+static void
+vdev_draid_io_start(zio_t *zio)
+{
+	vdev_raidz_io_start_impl(zio, vdev_draid_map_alloc(zio));
+}
+
+/*
+ * Determine if any column of the group holding the block resides on a
+ * child with a dirty DTL.  Parity covers the whole row, so every column is
+ * checked, including those holding only padding.
+ */
+static boolean_t
+vdev_draid_need_resilver(vdev_t *vd, uint64_t offset, size_t psize)
+{
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+	uint64_t gw = vdc->vdc_groupwidth;
+	uint64_t gidx = offset / vdc->vdc_groupsz;
+	uint64_t slice = gidx / vdc->vdc_ngroups;
+	uint64_t group = gidx % vdc->vdc_ngroups;
+
+	for (uint64_t c = 0; c < gw; c++) {
+		uint64_t devidx = vdev_draid_slot_to_child(vdc, slice,
+		    (group * gw + c) % vdc->vdc_ndisks);
+
+		/*
+		 * dsl_scan_need_resilver() already checked vd with
+		 * vdev_dtl_contains(). So here just check cvd with
+		 * vdev_dtl_empty(), cheaper and a good approximation.
+		 */
+		if (!vdev_dtl_empty(vd->vdev_child[devidx], DTL_PARTIAL))
+			return (B_TRUE);
+	}
+
+	return (B_FALSE);
+}
+
+/*
+ * Translate a logical range to the physical range on a child.  Because
+ * the groups of a slice are scattered over all children, only slices that
+ * are entirely contained in the logical range are reported; each of them
+ * occupies the same contiguous extent on every child.  If no whole slice
+ * is covered an empty range is returned.
+ */
+static void
+vdev_draid_xlate(vdev_t *cvd, const range_seg64_t *in, range_seg64_t *res)
+{
+	vdev_t *vd = cvd->vdev_parent;
+	vdev_draid_config_t *vdc = vd->vdev_tsd;
+	uint64_t slicesz = vdev_draid_slice_size(vdc);
+
+	ASSERT(vd->vdev_ops == &vdev_draid_ops);
+
+	uint64_t start = (in->rs_start + slicesz - 1) / slicesz;
+	uint64_t end = in->rs_end / slicesz;
+
+	if (end < start)
+		end = start;
+
+	res->rs_start = start * vdc->vdc_devslicesz;
+	res->rs_end = end * vdc->vdc_devslicesz;
+
+	ASSERT3U(res->rs_end - res->rs_start, <=, in->rs_end - in->rs_start);
+}
+
+vdev_ops_t vdev_draid_ops = {
+	.vdev_op_open = vdev_draid_open,
+	.vdev_op_close = vdev_draid_close,
+	.vdev_op_asize = vdev_draid_asize,
+	.vdev_op_io_start = vdev_draid_io_start,
+	.vdev_op_io_done = vdev_raidz_io_done,
+	.vdev_op_state_change = vdev_raidz_state_change,
+	.vdev_op_need_resilver = vdev_draid_need_resilver,
+	.vdev_op_hold = NULL,
+	.vdev_op_rele = NULL,
+	.vdev_op_remap = NULL,
+	.vdev_op_xlate = vdev_draid_xlate,
+	.vdev_op_dumpio = NULL,
+	.vdev_op_type = VDEV_TYPE_DRAID,	/* name of this vdev type */
+	.vdev_op_leaf = B_FALSE			/* not a leaf vdev */
+};
+
+/*
+ * Distributed spares.
+ *
+ * A distributed spare is a leaf vdev with no media of its own.  Its
+ * address space mirrors that of a single dRAID child; I/O to it is
+ * redirected, slice by slice, to whichever child holds the corresponding
+ * spare slot of that slice's permutation.  Distributed spares have no
+ * labels; they are described entirely by the pool configuration.
+ */
+typedef struct vdev_draid_spare {
+	vdev_t		*vds_draid_vdev;	/* top-level dRAID vdev */
+	uint64_t	vds_spare_id;		/* spare slot within a slice */
+} vdev_draid_spare_t;
+
+boolean_t
+vdev_draid_spare_parse(const char *path, uint64_t *parityp, uint64_t *topidp,
+    uint64_t *spareidp)
+{
+	u_longlong_t parity, topid, spareid;
+	char *end;
+
+	if (path == NULL || strncmp(path, VDEV_TYPE_DRAID,
+	    strlen(VDEV_TYPE_DRAID)) != 0)
+		return (B_FALSE);
+	path += strlen(VDEV_TYPE_DRAID);
+
+	if (ddi_strtoull(path, &end, 10, &parity) != 0 || *end != '-')
+		return (B_FALSE);
+	if (ddi_strtoull(end + 1, &end, 10, &topid) != 0 || *end != '-')
+		return (B_FALSE);
+	if (ddi_strtoull(end + 1, &end, 10, &spareid) != 0 || *end != '\0')
+		return (B_FALSE);
+
+	if (parityp != NULL)
+		*parityp = parity;
+	if (topidp != NULL)
+		*topidp = topid;
+	if (spareidp != NULL)
+		*spareidp = spareid;
+
+	return (B_TRUE);
+}
+
+/*
+ * Return the top-level dRAID vdev that backs a distributed spare, or NULL
+ * if the spare's name does not refer to a compatible dRAID vdev.
+ */
+vdev_t *
+vdev_draid_spare_get_parent(vdev_t *vd)
+{
+	vdev_t *rvd = vd->vdev_spa->spa_root_vdev;
+	uint64_t parity, topid, spareid;
+	vdev_t *tvd;
+
+	ASSERT3P(vd->vdev_ops, ==, &vdev_draid_spare_ops);
+
+	if (!vdev_draid_spare_parse(vd->vdev_path, &parity, &topid, &spareid))
+		return (NULL);
+
+	if (rvd == NULL || topid >= rvd->vdev_children)
+		return (NULL);
+
+	tvd = rvd->vdev_child[topid];
+	if (tvd->vdev_ops != &vdev_draid_ops || tvd->vdev_tsd == NULL ||
+	    tvd->vdev_nparity != parity ||
+	    spareid >= ((vdev_draid_config_t *)tvd->vdev_tsd)->vdc_nspares)
+		return (NULL);
+
+	return (tvd);
+}
+
+static int
+vdev_draid_spare_open(vdev_t *vd, uint64_t *psize, uint64_t *max_psize,
+    uint64_t *ashift)
+{
+	vdev_draid_spare_t *vds;
+	vdev_draid_config_t *vdc;
+	uint64_t spareid, asize, max_asize;
+	vdev_t *tvd;
+
+	tvd = vdev_draid_spare_get_parent(vd);
+	if (tvd == NULL) {
+		vd->vdev_stat.vs_aux = VDEV_AUX_BAD_LABEL;
+		return (SET_ERROR(EINVAL));
+	}
+	vdc = tvd->vdev_tsd;
+	VERIFY(vdev_draid_spare_parse(vd->vdev_path, NULL, NULL, &spareid));
+
+	/*
+	 * The dRAID vdev may still be in the middle of opening, so derive
+	 * the size from its children rather than from its own asize.
+	 */
+	asize = vdev_draid_min_child_asize(tvd, &max_asize);
+	asize = (asize / vdc->vdc_devslicesz) * vdc->vdc_devslicesz;
+	max_asize = (max_asize / vdc->vdc_devslicesz) * vdc->vdc_devslicesz;
+	if (asize == 0) {
+		vd->vdev_stat.vs_aux = VDEV_AUX_OPEN_FAILED;
+		return (SET_ERROR(ENXIO));
+	}
+
+	if (vd->vdev_tsd == NULL)
+		vd->vdev_tsd = kmem_zalloc(sizeof (vdev_draid_spare_t),
+		    KM_SLEEP);
+	vds = vd->vdev_tsd;
+	vds->vds_draid_vdev = tvd;
+	vds->vds_spare_id = spareid;
+
+	*psize = asize + VDEV_LABEL_START_SIZE + VDEV_LABEL_END_SIZE;
+	*max_psize = max_asize + VDEV_LABEL_START_SIZE + VDEV_LABEL_END_SIZE;
+	*ashift = tvd->vdev_ashift;
+
+	return (0);
+}
+
+static void
+vdev_draid_spare_close(vdev_t *vd)
+{
+	if (vd->vdev_tsd == NULL)
+		return;
+
+	kmem_free(vd->vdev_tsd, sizeof (vdev_draid_spare_t));
+	vd->vdev_tsd = NULL;
+}
+
+static void
+vdev_draid_spare_child_done(zio_t *zio)
+{
+	zio_t *pio = zio->io_private;
+
+	pio->io_error = zio->io_error;
+}
+
+static void
+vdev_draid_spare_io_start(zio_t *zio)
+{
+	vdev_t *vd = zio->io_vd;
+	vdev_draid_spare_t *vds = vd->vdev_tsd;
+	vdev_draid_config_t *vdc;
+	uint64_t offset, slice;
+	vdev_t *tvd, *cvd;
+
+	if (vds == NULL) {
+		zio->io_error = SET_ERROR(ENXIO);
+		zio_interrupt(zio);
+		return;
+	}
+	tvd = vds->vds_draid_vdev;
+	vdc = tvd->vdev_tsd;
+
+	switch (zio->io_type) {
+	case ZIO_TYPE_IOCTL:
+		/* The children are flushed directly as part of the tree. */
+		zio->io_error = 0;
+		break;
+
+	case ZIO_TYPE_TRIM:
+		zio->io_error = SET_ERROR(ENOTSUP);
+		break;
+
+	case ZIO_TYPE_READ:
+	case ZIO_TYPE_WRITE:
+		/*
+		 * There are no labels; probes of the label area succeed
+		 * without touching any media.
+		 */
+		if (zio->io_offset < VDEV_LABEL_START_SIZE ||
+		    zio->io_offset + zio->io_size >
+		    vd->vdev_psize - VDEV_LABEL_END_SIZE) {
+			if (zio->io_flags & ZIO_FLAG_PROBE) {
+				if (zio->io_type == ZIO_TYPE_READ)
+					abd_zero(zio->io_abd, zio->io_size);
+				zio->io_error = 0;
+			} else {
+				zio->io_error = SET_ERROR(EINVAL);
+			}
+			break;
+		}
+
+		offset = zio->io_offset - VDEV_LABEL_START_SIZE;
+		slice = offset / vdc->vdc_devslicesz;
+		ASSERT3U((offset + zio->io_size - 1) / vdc->vdc_devslicesz,
+		    ==, slice);
+
+		cvd = tvd->vdev_child[vdev_draid_slot_to_child(vdc, slice,
+		    vdc->vdc_ndisks + vds->vds_spare_id)];
+
+		zio_nowait(zio_vdev_child_io(zio, NULL, cvd, offset,
+		    zio->io_abd, zio->io_size, zio->io_type, zio->io_priority,
+		    0, vdev_draid_spare_child_done, zio));
+		break;
+
+	default:
+		zio->io_error = SET_ERROR(ENOTSUP);
+		break;
+	}
+
+	zio_execute(zio);
+}
+
+/* ARGSUSED */
+static void
+vdev_draid_spare_io_done(zio_t *zio)
+{
+}
+
+vdev_ops_t vdev_draid_spare_ops = {
+	.vdev_op_open = vdev_draid_spare_open,
+	.vdev_op_close = vdev_draid_spare_close,
+	.vdev_op_asize = vdev_default_asize,
+	.vdev_op_io_start = vdev_draid_spare_io_start,
+	.vdev_op_io_done = vdev_draid_spare_io_done,
+	.vdev_op_state_change = NULL,
+	.vdev_op_need_resilver = NULL,
+	.vdev_op_hold = NULL,
+	.vdev_op_rele = NULL,
+	.vdev_op_remap = NULL,
+	.vdev_op_xlate = vdev_default_xlate,
+	.vdev_op_dumpio = NULL,
+	.vdev_op_type = VDEV_TYPE_DRAID_SPARE,	/* name of this vdev type */
+	.vdev_op_leaf = B_TRUE			/* leaf vdev */
+};
@@ -143,6 +143,8 @@
 #include <sys/zap.h>
 #include <sys/vdev.h>
 #include <sys/vdev_impl.h>
+#include <sys/vdev_draid.h>
+#include <sys/vdev_raidz.h>
 #include <sys/uberblock_impl.h>
 #include <sys/metaslab.h>
 #include <sys/metaslab_impl.h>
@@ -399,6 +401,13 @@ root_vdev_actions_getprogress(vdev_t *vd, nvlist_t *nvl)
 		    sizeof (prs) / sizeof (uint64_t));
 	}
 
+	pool_raidz_expand_stat_t pres;
+	if (vdev_raidz_expand_get_stats(spa, &pres) == 0) {
+		fnvlist_add_uint64_array(nvl,
+		    ZPOOL_CONFIG_RAIDZ_EXPAND_STATS, (uint64_t *)&pres,
+		    sizeof (pres) / sizeof (uint64_t));
+	}
+
 	pool_checkpoint_stat_t pcs;
 	if (spa_checkpoint_get_stats(spa, &pcs) == 0) {
 		fnvlist_add_uint64_array(nvl,
@@ -438,8 +447,8 @@ vdev_config_generate(spa_t *spa, vdev_t *vd, boolean_t getstats,
 		fnvlist_add_string(nv, ZPOOL_CONFIG_FRU, vd->vdev_fru);
 
 	if (vd->vdev_nparity != 0) {
-		ASSERT(strcmp(vd->vdev_ops->vdev_op_type,
-		    VDEV_TYPE_RAIDZ) == 0);
+		ASSERT(vd->vdev_ops == &vdev_raidz_ops ||
+		    vd->vdev_ops == &vdev_draid_ops);
 
 		/*
 		 * Make sure someone hasn't managed to sneak a fancy new vdev
@@ -459,6 +468,22 @@ vdev_config_generate(spa_t *spa, vdev_t *vd, boolean_t getstats,
 		fnvlist_add_uint64(nv, ZPOOL_CONFIG_NPARITY, vd->vdev_nparity);
 	}
 
+	if (vd->vdev_ops == &vdev_draid_ops) {
+		vdev_draid_config_t *vdc = vd->vdev_tsd;
+
+		fnvlist_add_uint64(nv, ZPOOL_CONFIG_DRAID_NDATA,
+		    vdc->vdc_ndata);
+		fnvlist_add_uint64(nv, ZPOOL_CONFIG_DRAID_NSPARES,
+		    vdc->vdc_nspares);
+		fnvlist_add_uint64(nv, ZPOOL_CONFIG_DRAID_NGROUPS,
+		    vdc->vdc_ngroups);
+	}
+
+	if (vd->vdev_rz_nexpand != 0) {
+		fnvlist_add_uint64_array(nv, ZPOOL_CONFIG_RAIDZ_EXPAND_TXGS,
+		    vd->vdev_rz_expand_txgs, vd->vdev_rz_nexpand);
+	}
+
 	if (vd->vdev_wholedisk != -1ULL)
 		fnvlist_add_uint64(nv, ZPOOL_CONFIG_WHOLE_DISK,
 		    vd->vdev_wholedisk);
@@ -965,6 +990,13 @@ vdev_label_init(vdev_t *vd, uint64_t crtxg, vdev_labeltype_t reason)
 	if (!vd->vdev_ops->vdev_op_leaf || !spa_writeable(spa))
 		return (0);
 
+	/*
+	 * Distributed spares are carved out of the dRAID children, whose
+	 * labels describe them; they have no label of their own.
+	 */
+	if (vd->vdev_ops == &vdev_draid_spare_ops)
+		return (0);
+
 	/*
 	 * Dead vdevs cannot be initialized.
 	 */
@@ -1313,7 +1345,7 @@ vdev_label_write_bootenv(vdev_t *vd, nvlist_t *env)
 	}
 
 	if (!vd->vdev_ops->vdev_op_leaf || vdev_is_dead(vd) ||
-	    !vdev_writeable(vd)) {
+	    !vdev_writeable(vd) || vd->vdev_ops == &vdev_draid_spare_ops) {
 		return (error);
 	}
 	ASSERT3U(sizeof (*bootenv), ==, VDEV_PAD_SIZE);
@@ -1462,7 +1494,8 @@ vdev_uberblock_load_impl(zio_t *zio, vdev_t *vd, int flags,
 	for (int c = 0; c < vd->vdev_children; c++)
 		vdev_uberblock_load_impl(zio, vd->vdev_child[c], flags, cbp);
 
-	if (vd->vdev_ops->vdev_op_leaf && vdev_readable(vd)) {
+	if (vd->vdev_ops->vdev_op_leaf && vdev_readable(vd) &&
+	    vd->vdev_ops != &vdev_draid_spare_ops) {
 		for (int l = 0; l < VDEV_LABELS; l++) {
 			for (int n = 0; n < VDEV_UBERBLOCK_COUNT(vd); n++) {
 				vdev_label_read(zio, vd, l,
@@ -1558,6 +1591,9 @@ vdev_uberblock_sync(zio_t *zio, uint64_t *good_writes,
 	if (!vdev_writeable(vd))
 		return;
 
+	if (vd->vdev_ops == &vdev_draid_spare_ops)
+		return;
+
 	int m = spa_multihost(vd->vdev_spa) ? MMP_BLOCKS_PER_LABEL : 0;
 	int n = ub->ub_txg % (VDEV_UBERBLOCK_COUNT(vd) - m);
 
@@ -1667,6 +1703,9 @@ vdev_label_sync(zio_t *zio, uint64_t *good_writes,
 	if (!vdev_writeable(vd))
 		return;
 
+	if (vd->vdev_ops == &vdev_draid_spare_ops)
+		return;
+
 	/*
 	 * Generate a label describing the top-level config to which we belong.
 	 */
@@ -114,6 +114,35 @@
  * maximum percentage, this indicates that the rate of incoming data is
  * greater than the rate that the backend storage can handle. In this case, we
  * must further throttle incoming writes (see dmu_tx_delay() for details).
+ *
+ * Adaptive Queue Depth
+ *
+ * No fixed set of max_active values suits every device: flash devices keep
+ * their latency low with many concurrent operations, while disks (and SMR
+ * disks in particular) only do so with few.  With
+ * zfs_vdev_adaptive_queue_depth set (it is off by default, as the target
+ * latencies below are only starting points that have to be matched to the
+ * pool's devices), each leaf vdev therefore adjusts the
+ * max_active of each I/O class to the device.  The device latency of the
+ * class's completed operations is recorded in a histogram with the same
+ * log2 buckets as the vdev's latency histograms (see vdev_stat_ex_t).
+ * Every zfs_vdev_adaptive_interval_ms (once enough operations have
+ * completed), the zfs_vdev_adaptive_latency_pct percentile of that
+ * latency is compared with the class's target latency:
+ *
+ *  - if it misses the target while the class was at, or within a quarter
+ *    of, its max_active, max_active is cut by a quarter, but never below
+ *    the class's min_active.  A class that was far from its limit is left
+ *    alone, as its own depth is not what made the device slow;
+ *  - if it is within three quarters of the target, and operations of the
+ *    class had to wait because max_active was reached, max_active is
+ *    raised by one, up to zfs_vdev_adaptive_max_active.
+ *
+ * The zfs_vdev_*_max_active tunables are the starting points, and the
+ * min_active of a class never exceeds its adaptive max_active.  The dirty
+ * data scaling of async writes described above applies below the async
+ * write class's adaptive max_active.  Each leaf vdev reports its limits,
+ * measured latencies and adjustments in the zfs:0:vdevq_<guid> kstat.
  */
 
 /*
@@ -156,6 +185,24 @@ uint32_t zfs_vdev_initializing_max_active = 1;
 uint32_t zfs_vdev_trim_min_active = 1;
 uint32_t zfs_vdev_trim_max_active = 2;
 
+/*
+ * Adaptive queue depth controller (see "Adaptive Queue Depth" above), and
+ * the device latency each I/O class aims for, in microseconds.
+ */
+boolean_t zfs_vdev_adaptive_queue_depth = B_FALSE;
+uint32_t zfs_vdev_adaptive_max_active = 128;
+uint32_t zfs_vdev_adaptive_latency_pct = 90;
+uint32_t zfs_vdev_adaptive_interval_ms = 100;
+uint32_t zfs_vdev_adaptive_min_ios = 32;
+uint32_t zfs_vdev_sync_read_target_us = 10000;
+uint32_t zfs_vdev_sync_write_target_us = 10000;
+uint32_t zfs_vdev_async_read_target_us = 25000;
+uint32_t zfs_vdev_async_write_target_us = 50000;
+uint32_t zfs_vdev_scrub_target_us = 50000;
+uint32_t zfs_vdev_removal_target_us = 50000;
+uint32_t zfs_vdev_initializing_target_us = 100000;
+uint32_t zfs_vdev_trim_target_us = 100000;
+
 /*
  * When the pool has less than zfs_vdev_async_write_active_min_dirty_percent
  * dirty data, use zfs_vdev_async_write_min_active.  When it has more than
@@ -254,6 +301,134 @@ vdev_queue_timestamp_compare(const void *x1, const void *x2)
 	return (TREE_PCMP(z1, z2));
 }
 
+/*
+ * The configured max_active of each class, which is where the adaptive
+ * max_active starts.
+ */
+static uint32_t
+vdev_queue_class_max_tunable(zio_priority_t p)
+{
+	switch (p) {
+	case ZIO_PRIORITY_SYNC_READ:
+		return (zfs_vdev_sync_read_max_active);
+	case ZIO_PRIORITY_SYNC_WRITE:
+		return (zfs_vdev_sync_write_max_active);
+	case ZIO_PRIORITY_ASYNC_READ:
+		return (zfs_vdev_async_read_max_active);
+	case ZIO_PRIORITY_ASYNC_WRITE:
+		return (zfs_vdev_async_write_max_active);
+	case ZIO_PRIORITY_SCRUB:
+		return (zfs_vdev_scrub_max_active);
+	case ZIO_PRIORITY_REMOVAL:
+		return (zfs_vdev_removal_max_active);
+	case ZIO_PRIORITY_INITIALIZING:
+		return (zfs_vdev_initializing_max_active);
+	case ZIO_PRIORITY_TRIM:
+		return (zfs_vdev_trim_max_active);
+	default:
+		panic("invalid priority %u", p);
+	}
+}
+
+static uint32_t
+vdev_queue_class_target_us(zio_priority_t p)
+{
+	switch (p) {
+	case ZIO_PRIORITY_SYNC_READ:
+		return (zfs_vdev_sync_read_target_us);
+	case ZIO_PRIORITY_SYNC_WRITE:
+		return (zfs_vdev_sync_write_target_us);
+	case ZIO_PRIORITY_ASYNC_READ:
+		return (zfs_vdev_async_read_target_us);
+	case ZIO_PRIORITY_ASYNC_WRITE:
+		return (zfs_vdev_async_write_target_us);
+	case ZIO_PRIORITY_SCRUB:
+		return (zfs_vdev_scrub_target_us);
+	case ZIO_PRIORITY_REMOVAL:
+		return (zfs_vdev_removal_target_us);
+	case ZIO_PRIORITY_INITIALIZING:
+		return (zfs_vdev_initializing_target_us);
+	case ZIO_PRIORITY_TRIM:
+		return (zfs_vdev_trim_target_us);
+	default:
+		panic("invalid priority %u", p);
+	}
+}
+
+static const char *vdev_queue_class_name[ZIO_PRIORITY_NUM_QUEUEABLE] = {
+	"sync_read",
+	"sync_write",
+	"async_read",
+	"async_write",
+	"scrub",
+	"removal",
+	"initializing",
+	"trim",
+};
+
+/*
+ * For each class: max_active, latency_us, increases and decreases.
+ */
+#define	VDEV_QUEUE_KSTATS_PER_CLASS	4
+
+static int
+vdev_queue_kstat_update(kstat_t *ksp, int rw)
+{
+	vdev_queue_t *vq = ksp->ks_private;
+	kstat_named_t *kn = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		vdev_queue_class_t *vqc = &vq->vq_class[p];
+
+		kn[0].value.ui64 = vqc->vqc_max_active;
+		kn[1].value.ui64 = NSEC2USEC(vqc->vqc_latency);
+		kn[2].value.ui64 = vqc->vqc_increases;
+		kn[3].value.ui64 = vqc->vqc_decreases;
+		kn += VDEV_QUEUE_KSTATS_PER_CLASS;
+	}
+
+	return (0);
+}
+
+static void
+vdev_queue_kstat_init(vdev_queue_t *vq)
+{
+	char name[KSTAT_STRLEN];
+	kstat_named_t *kn;
+	kstat_t *ksp;
+
+	(void) snprintf(name, sizeof (name), "vdevq_%llx",
+	    (u_longlong_t)vq->vq_vdev->vdev_guid);
+	ksp = kstat_create("zfs", 0, name, "vdev_queue", KSTAT_TYPE_NAMED,
+	    ZIO_PRIORITY_NUM_QUEUEABLE * VDEV_QUEUE_KSTATS_PER_CLASS, 0);
+	if (ksp == NULL)
+		return;
+
+	kn = ksp->ks_data;
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		const char *cname = vdev_queue_class_name[p];
+
+		(void) snprintf(name, sizeof (name), "%s_max_active", cname);
+		kstat_named_init(&kn[0], name, KSTAT_DATA_UINT64);
+		(void) snprintf(name, sizeof (name), "%s_latency_us", cname);
+		kstat_named_init(&kn[1], name, KSTAT_DATA_UINT64);
+		(void) snprintf(name, sizeof (name), "%s_increases", cname);
+		kstat_named_init(&kn[2], name, KSTAT_DATA_UINT64);
+		(void) snprintf(name, sizeof (name), "%s_decreases", cname);
+		kstat_named_init(&kn[3], name, KSTAT_DATA_UINT64);
+		kn += VDEV_QUEUE_KSTATS_PER_CLASS;
+	}
+
+	ksp->ks_update = vdev_queue_kstat_update;
+	ksp->ks_private = vq;
+	ksp->ks_lock = &vq->vq_lock;
+	kstat_install(ksp);
+	vq->vq_ksp = ksp;
+}
+
 void
 vdev_queue_init(vdev_t *vd)
 {
@@ -292,9 +467,16 @@ vdev_queue_init(vdev_t *vd)
 
 		avl_create(vdev_queue_class_tree(vq, p), compfn,
 		    sizeof (zio_t), offsetof(struct zio, io_queue_node));
+
+		vq->vq_class[p].vqc_max_active =
+		    MAX(1, vdev_queue_class_max_tunable(p));
+		vq->vq_class[p].vqc_window_start = gethrtime();
 	}
 
 	vq->vq_last_offset = 0;
+
+	if (vd->vdev_ops->vdev_op_leaf)
+		vdev_queue_kstat_init(vq);
 }
 
 void
@@ -302,6 +484,11 @@ vdev_queue_fini(vdev_t *vd)
 {
 	vdev_queue_t *vq = &vd->vdev_queue;
 
+	if (vq->vq_ksp != NULL) {
+		kstat_delete(vq->vq_ksp);
+		vq->vq_ksp = NULL;
+	}
+
 	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
 		avl_destroy(vdev_queue_class_tree(vq, p));
 	avl_destroy(&vq->vq_active_tree);
@@ -349,9 +536,12 @@ static void
 vdev_queue_pending_add(vdev_queue_t *vq, zio_t *zio)
 {
 	spa_t *spa = zio->io_spa;
+	vdev_queue_class_t *vqc = &vq->vq_class[zio->io_priority];
+
 	ASSERT(MUTEX_HELD(&vq->vq_lock));
 	ASSERT3U(zio->io_priority, <, ZIO_PRIORITY_NUM_QUEUEABLE);
-	vq->vq_class[zio->io_priority].vqc_active++;
+	vqc->vqc_active++;
+	vqc->vqc_peak_active = MAX(vqc->vqc_peak_active, vqc->vqc_active);
 	avl_add(&vq->vq_active_tree, zio);
 
 	mutex_enter(&spa->spa_iokstat_lock);
@@ -404,7 +594,7 @@ vdev_queue_agg_io_done(zio_t *aio)
 }
 
 static int
-vdev_queue_class_min_active(zio_priority_t p)
+vdev_queue_class_min_tunable(zio_priority_t p)
 {
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
@@ -429,9 +619,24 @@ vdev_queue_class_min_active(zio_priority_t p)
 }
 
 static int
-vdev_queue_max_async_writes(spa_t *spa)
+vdev_queue_class_min_active(vdev_queue_t *vq, zio_priority_t p)
+{
+	int min_active = vdev_queue_class_min_tunable(p);
+
+	if (zfs_vdev_adaptive_queue_depth)
+		min_active = MIN(min_active, vq->vq_class[p].vqc_max_active);
+	return (min_active);
+}
+
+/*
+ * Scale the number of active async writes, up to "max_active", to the
+ * amount of dirty data in the pool.
+ */
+static int
+vdev_queue_max_async_writes(spa_t *spa, int max_active)
 {
 	int writes;
+	int min_active = MIN(zfs_vdev_async_write_min_active, max_active);
 	uint64_t dirty = spa->spa_dsl_pool->dp_dirty_total;
 	uint64_t min_bytes = zfs_dirty_data_max *
 	    zfs_vdev_async_write_active_min_dirty_percent / 100;
@@ -443,13 +648,13 @@ vdev_queue_max_async_writes(spa_t *spa)
 	 * execution time of those actions we push data out as fast as possible.
 	 */
 	if (spa_has_pending_synctask(spa)) {
-		return (zfs_vdev_async_write_max_active);
+		return (max_active);
 	}
 
 	if (dirty < min_bytes)
-		return (zfs_vdev_async_write_min_active);
+		return (min_active);
 	if (dirty > max_bytes)
-		return (zfs_vdev_async_write_max_active);
+		return (max_active);
 
 	/*
 	 * linear interpolation:
@@ -457,39 +662,101 @@ vdev_queue_max_async_writes(spa_t *spa)
 	 * move right by min_bytes
 	 * move up by min_writes
 	 */
-	writes = (dirty - min_bytes) *
-	    (zfs_vdev_async_write_max_active -
-	    zfs_vdev_async_write_min_active) /
-	    (max_bytes - min_bytes) +
-	    zfs_vdev_async_write_min_active;
-	ASSERT3U(writes, >=, zfs_vdev_async_write_min_active);
-	ASSERT3U(writes, <=, zfs_vdev_async_write_max_active);
+	writes = (dirty - min_bytes) * (max_active - min_active) /
+	    (max_bytes - min_bytes) + min_active;
+	ASSERT3U(writes, >=, min_active);
+	ASSERT3U(writes, <=, max_active);
 	return (writes);
 }
 
 static int
-vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
+vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 {
-	switch (p) {
-	case ZIO_PRIORITY_SYNC_READ:
-		return (zfs_vdev_sync_read_max_active);
-	case ZIO_PRIORITY_SYNC_WRITE:
-		return (zfs_vdev_sync_write_max_active);
-	case ZIO_PRIORITY_ASYNC_READ:
-		return (zfs_vdev_async_read_max_active);
-	case ZIO_PRIORITY_ASYNC_WRITE:
-		return (vdev_queue_max_async_writes(spa));
-	case ZIO_PRIORITY_SCRUB:
-		return (zfs_vdev_scrub_max_active);
-	case ZIO_PRIORITY_REMOVAL:
-		return (zfs_vdev_removal_max_active);
-	case ZIO_PRIORITY_INITIALIZING:
-		return (zfs_vdev_initializing_max_active);
-	case ZIO_PRIORITY_TRIM:
-		return (zfs_vdev_trim_max_active);
-	default:
-		panic("invalid priority %u", p);
+	int max_active;
+
+	if (zfs_vdev_adaptive_queue_depth)
+		max_active = vq->vq_class[p].vqc_max_active;
+	else
+		max_active = vdev_queue_class_max_tunable(p);
+
+	if (p == ZIO_PRIORITY_ASYNC_WRITE)
+		return (vdev_queue_max_async_writes(vq->vq_vdev->vdev_spa,
+		    max_active));
+	return (max_active);
+}
+
+/*
+ * Find the latency below which zfs_vdev_adaptive_latency_pct percent of
+ * the class's i/os in the current window completed, interpolating within
+ * the histogram bucket it falls in.
+ */
+static uint64_t
+vdev_queue_class_latency(vdev_queue_class_t *vqc)
+{
+	uint64_t rank = ((uint64_t)vqc->vqc_window_ios *
+	    zfs_vdev_adaptive_latency_pct + 99) / 100;
+	uint64_t seen = 0;
+
+	for (int b = 0; b < VDEV_L_HISTO_BUCKETS; b++) {
+		uint64_t n = vqc->vqc_lat_histo[b];
+
+		if (seen + n >= rank && n != 0) {
+			uint64_t lo = 1ULL << b;
+			return (lo + lo * (rank - seen) / n);
+		}
+		seen += n;
 	}
+
+	return (1ULL << VDEV_L_HISTO_BUCKETS);
+}
+
+/*
+ * Record the device latency of a completed i/o, and at the end of each
+ * window adjust the max_active of its class to the class's target latency
+ * (see "Adaptive Queue Depth" above).
+ */
+static void
+vdev_queue_adapt(vdev_queue_t *vq, zio_t *zio, hrtime_t now)
+{
+	vdev_queue_class_t *vqc = &vq->vq_class[zio->io_priority];
+	uint64_t latency, target;
+	uint32_t min_active;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	if (!zfs_vdev_adaptive_queue_depth || zio->io_delay == 0)
+		return;
+
+	vqc->vqc_lat_histo[L_HISTO(zio->io_delay)]++;
+	vqc->vqc_window_ios++;
+	if (vqc->vqc_window_ios < zfs_vdev_adaptive_min_ios ||
+	    now - vqc->vqc_window_start <
+	    MSEC2NSEC(zfs_vdev_adaptive_interval_ms))
+		return;
+
+	latency = vdev_queue_class_latency(vqc);
+	target = USEC2NSEC((uint64_t)vdev_queue_class_target_us(
+	    zio->io_priority));
+	min_active = MAX(1, vdev_queue_class_min_tunable(zio->io_priority));
+
+	if (latency > target && vqc->vqc_max_active > min_active &&
+	    (vqc->vqc_limited ||
+	    vqc->vqc_peak_active >= vqc->vqc_max_active / 4 * 3)) {
+		vqc->vqc_max_active = MAX(min_active, vqc->vqc_max_active -
+		    MAX(1, vqc->vqc_max_active / 4));
+		vqc->vqc_decreases++;
+	} else if (vqc->vqc_limited && latency < target / 4 * 3 &&
+	    vqc->vqc_max_active < zfs_vdev_adaptive_max_active) {
+		vqc->vqc_max_active++;
+		vqc->vqc_increases++;
+	}
+
+	vqc->vqc_latency = latency;
+	vqc->vqc_limited = B_FALSE;
+	vqc->vqc_peak_active = vqc->vqc_active;
+	vqc->vqc_window_ios = 0;
+	vqc->vqc_window_start = now;
+	bzero(vqc->vqc_lat_histo, sizeof (vqc->vqc_lat_histo));
 }
 
 /*
@@ -499,7 +766,6 @@ vdev_queue_class_max_active(spa_t *spa, zio_priority_t p)
 static zio_priority_t
 vdev_queue_class_to_issue(vdev_queue_t *vq)
 {
-	spa_t *spa = vq->vq_vdev->vdev_spa;
 	zio_priority_t p;
 
 	if (avl_numnodes(&vq->vq_active_tree) >= zfs_vdev_max_active)
@@ -509,7 +775,7 @@ vdev_queue_class_to_issue(vdev_queue_t *vq)
 	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
 		if (avl_numnodes(vdev_queue_class_tree(vq, p)) > 0 &&
 		    vq->vq_class[p].vqc_active <
-		    vdev_queue_class_min_active(p))
+		    vdev_queue_class_min_active(vq, p))
 			return (p);
 	}
 
@@ -518,10 +784,14 @@ vdev_queue_class_to_issue(vdev_queue_t *vq)
 	 * maximum # outstanding i/os.
 	 */
 	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
-		if (avl_numnodes(vdev_queue_class_tree(vq, p)) > 0 &&
-		    vq->vq_class[p].vqc_active <
-		    vdev_queue_class_max_active(spa, p))
+		if (avl_numnodes(vdev_queue_class_tree(vq, p)) == 0)
+			continue;
+		if (vq->vq_class[p].vqc_active <
+		    vdev_queue_class_max_active(vq, p))
 			return (p);
+		if (vq->vq_class[p].vqc_active >=
+		    vq->vq_class[p].vqc_max_active)
+			vq->vq_class[p].vqc_limited = B_TRUE;
 	}
 
 	/* No eligible queued i/os */
@@ -831,6 +1101,7 @@ vdev_queue_io_done(zio_t *zio)
 
 	zio->io_delta = gethrtime() - zio->io_timestamp;
 	vq->vq_io_complete_ts = gethrtime();
+	vdev_queue_adapt(vq, zio, vq->vq_io_complete_ts);
 
 	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
 		mutex_exit(&vq->vq_lock);
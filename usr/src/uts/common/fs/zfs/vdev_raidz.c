@@ -38,6 +38,12 @@
 #include <sys/fm/fs/zfs.h>
 #include <sys/vdev_raidz.h>
 #include <sys/vdev_raidz_impl.h>
+#include <sys/spa_impl.h>
+#include <sys/metaslab_impl.h>
+#include <sys/dmu_tx.h>
+#include <sys/dsl_synctask.h>
+#include <sys/zap.h>
+#include <sys/zfeature.h>
 
 #ifdef ZFS_DEBUG
 #include <sys/vdev.h>	/* For vdev_xlate() in vdev_raidz_io_verify() */
@@ -137,6 +143,18 @@
 	VDEV_RAIDZ_64MUL_2((x), mask); \
 }
 
+/*
+ * Maximum amount of data moved by one step of a raidz expansion.  Each step
+ * holds its range of the vdev locked against other I/O while it runs.
+ */
+uint64_t zfs_raidz_expand_max_copy_bytes = 16 * 1024 * 1024;
+
+/*
+ * For testing only: pause a raidz expansion once it has reflowed this many
+ * bytes.  Zero means no limit.
+ */
+uint64_t zfs_raidz_expand_max_reflow_bytes = 0;
+
 void
 vdev_raidz_map_free(raidz_map_t *rm)
 {
@@ -155,6 +173,9 @@ vdev_raidz_map_free(raidz_map_t *rm)
 	if (rm->rm_abd_copy != NULL)
 		abd_free(rm->rm_abd_copy);
 
+	if (rm->rm_skip_abd != NULL)
+		abd_free(rm->rm_skip_abd);
+
 	kmem_free(rm, offsetof(raidz_map_t, rm_col[rm->rm_scols]));
 }
 
@@ -166,6 +187,11 @@ vdev_raidz_map_free_vsd(zio_t *zio)
 	ASSERT0(rm->rm_freed);
 	rm->rm_freed = 1;
 
+	if (rm->rm_lr != NULL) {
+		rangelock_exit(rm->rm_lr);
+		rm->rm_lr = NULL;
+	}
+
 	if (rm->rm_reports == 0)
 		vdev_raidz_map_free(rm);
 }
@@ -394,9 +420,16 @@ vdev_raidz_map_alloc(zio_t *zio, uint64_t ashift, uint64_t dcols,
 	rm->rm_missingparity = 0;
 	rm->rm_firstdatacol = nparity;
 	rm->rm_abd_copy = NULL;
+	rm->rm_skip_abd = NULL;
 	rm->rm_reports = 0;
 	rm->rm_freed = 0;
 	rm->rm_ecksuminjected = 0;
+	rm->rm_reflow = B_FALSE;
+	rm->rm_lcols = dcols;
+	rm->rm_pcols = dcols;
+	rm->rm_reflow_offset = UINT64_MAX;
+	rm->rm_ashift = ashift;
+	rm->rm_lr = NULL;
 
 	asize = 0;
 
@@ -412,6 +445,7 @@ vdev_raidz_map_alloc(zio_t *zio, uint64_t ashift, uint64_t dcols,
 		rm->rm_col[c].rc_abd = NULL;
 		rm->rm_col[c].rc_gdata = NULL;
 		rm->rm_col[c].rc_error = 0;
+		rm->rm_col[c].rc_skip_error = 0;
 		rm->rm_col[c].rc_tried = 0;
 		rm->rm_col[c].rc_skipped = 0;
 
@@ -1595,8 +1629,12 @@ vdev_raidz_open(vdev_t *vd, uint64_t *asize, uint64_t *max_asize,
 		*ashift = MAX(*ashift, cvd->vdev_ashift);
 	}
 
-	*asize *= vd->vdev_children;
-	*max_asize *= vd->vdev_children;
+	/*
+	 * The space on an attached child can't be used until the expansion
+	 * that added it has reflowed the existing data.
+	 */
+	*asize *= vd->vdev_children - vd->vdev_rz_expanding;
+	*max_asize *= vd->vdev_children - vd->vdev_rz_expanding;
 
 	if (numerrors > nparity) {
 		vd->vdev_stat.vs_aux = VDEV_AUX_NO_REPLICAS;
@@ -1691,6 +1729,13 @@ vdev_raidz_dumpio(vdev_t *vd, caddr_t data, size_t size,
 
 #ifdef	_KERNEL
 
+	/*
+	 * The dump device's blocks may have been moved by an expansion of
+	 * this vdev, which this simple mapping doesn't account for.
+	 */
+	if (vd->vdev_rz_nexpand != 0)
+		return (SET_ERROR(ENOTSUP));
+
 	/*
 	 * Don't write past the end of the block
 	 */
@@ -1768,12 +1813,33 @@ vdev_raidz_dumpio(vdev_t *vd, caddr_t data, size_t size,
 	return (err);
 }
 
+/*
+ * Return the number of children that blocks born in the given txg are laid
+ * out across.  Every expansion records the first txg to allocate at the new
+ * width (UINT64_MAX while the expansion is still in progress), and a block
+ * keeps the width it was written at for as long as it exists.
+ */
+uint64_t
+vdev_raidz_logical_width(vdev_t *vd, uint64_t txg)
+{
+	uint64_t width = vd->vdev_children;
+
+	ASSERT3U(vd->vdev_rz_nexpand, <, width);
+
+	for (int i = vd->vdev_rz_nexpand - 1; i >= 0; i--) {
+		if (vd->vdev_rz_expand_txgs[i] <= txg)
+			break;
+		width--;
+	}
+
+	return (width);
+}
+
 static uint64_t
-vdev_raidz_asize(vdev_t *vd, uint64_t psize)
+vdev_raidz_asize_width(vdev_t *vd, uint64_t psize, uint64_t cols)
 {
 	uint64_t asize;
 	uint64_t ashift = vd->vdev_top->vdev_ashift;
-	uint64_t cols = vd->vdev_children;
 	uint64_t nparity = vd->vdev_nparity;
 
 	asize = ((psize - 1) >> ashift) + 1;
@@ -1783,6 +1849,24 @@ vdev_raidz_asize(vdev_t *vd, uint64_t psize)
 	return (asize);
 }
 
+uint64_t
+vdev_raidz_asize_txg(vdev_t *vd, uint64_t psize, uint64_t txg)
+{
+	return (vdev_raidz_asize_width(vd, psize,
+	    vdev_raidz_logical_width(vd, txg)));
+}
+
+/*
+ * The asize of a block allocated now: if an expansion is in progress, new
+ * blocks are still written at the old width.
+ */
+static uint64_t
+vdev_raidz_asize(vdev_t *vd, uint64_t psize)
+{
+	return (vdev_raidz_asize_width(vd, psize,
+	    vd->vdev_children - vd->vdev_rz_expanding));
+}
+
 static void
 vdev_raidz_child_done(zio_t *zio)
 {
@@ -1793,6 +1877,118 @@ vdev_raidz_child_done(zio_t *zio)
 	rc->rc_skipped = 0;
 }
 
+/*
+ * The padding sector written after a column (dRAID) is kept apart from the
+ * column's own write, whose done callback may run at the same time.
+ */
+static void
+vdev_raidz_skip_done(zio_t *zio)
+{
+	raidz_col_t *rc = zio->io_private;
+
+	rc->rc_skip_error = zio->io_error;
+}
+
+/*
+ * Find where a sector of a reflowed column lives.  The map's columns then
+ * describe the block as it was laid out at rm_lcols wide, and the sector's
+ * index in the vdev's sector space tells us where it has since been moved:
+ * sectors below the reflow offset are rm_pcols wide, the rest one narrower.
+ */
+static void
+vdev_raidz_reflow_sector(raidz_map_t *rm, raidz_col_t *rc, uint64_t row,
+    uint64_t *devidxp, uint64_t *offsetp)
+{
+	uint64_t sector = rc->rc_devidx +
+	    rm->rm_lcols * ((rc->rc_offset >> rm->rm_ashift) + row);
+	uint64_t width = (sector < rm->rm_reflow_offset) ?
+	    rm->rm_pcols : rm->rm_pcols - 1;
+
+	*devidxp = sector % width;
+	*offsetp = (sector / width) << rm->rm_ashift;
+}
+
+static void
+vdev_raidz_sector_done(zio_t *zio)
+{
+	raidz_col_t *rc = zio->io_private;
+
+	abd_put(zio->io_abd);
+
+	if (rc != NULL) {
+		if (zio->io_error != 0)
+			rc->rc_error = zio->io_error;
+		rc->rc_tried = 1;
+		rc->rc_skipped = 0;
+	}
+}
+
+/*
+ * Issue the child I/O for one column of the map.  Normally that is a single
+ * I/O to the column's child, but the sectors of a reflowed column are spread
+ * over several children and must be issued one at a time.  A reflowed
+ * column is failed if any of its sectors fails.
+ */
+static void
+vdev_raidz_col_io(zio_t *zio, raidz_map_t *rm, raidz_col_t *rc,
+    zio_type_t type, zio_priority_t priority, enum zio_flag flags,
+    zio_done_func_t *done)
+{
+	vdev_t *vd = zio->io_vd;
+	uint64_t sectorsz = 1ULL << rm->rm_ashift;
+
+	if (!rm->rm_reflow) {
+		zio_nowait(zio_vdev_child_io(zio, NULL,
+		    vd->vdev_child[rc->rc_devidx], rc->rc_offset, rc->rc_abd,
+		    rc->rc_size, type, priority, flags, done, rc));
+		return;
+	}
+
+	if (done != NULL)
+		rc->rc_error = 0;
+
+	for (uint64_t off = 0; off < rc->rc_size; off += sectorsz) {
+		uint64_t devidx, offset;
+
+		vdev_raidz_reflow_sector(rm, rc, off >> rm->rm_ashift,
+		    &devidx, &offset);
+		zio_nowait(zio_vdev_child_io(zio, NULL, vd->vdev_child[devidx],
+		    offset, abd_get_offset_size(rc->rc_abd, off, sectorsz),
+		    sectorsz, type, priority, flags, vdev_raidz_sector_done,
+		    done != NULL ? rc : NULL));
+	}
+}
+
+/*
+ * Determine whether a column can be read: ENXIO if a child holding it is
+ * unreadable, ESTALE if one is missing data from this txg.
+ */
+static int
+vdev_raidz_col_missing(zio_t *zio, raidz_map_t *rm, raidz_col_t *rc)
+{
+	vdev_t *vd = zio->io_vd;
+	uint64_t rows = rm->rm_reflow ? rc->rc_size >> rm->rm_ashift : 1;
+	int error = 0;
+
+	for (uint64_t r = 0; r < rows; r++) {
+		uint64_t devidx = rc->rc_devidx;
+		uint64_t offset;
+		vdev_t *cvd;
+
+		if (rm->rm_reflow)
+			vdev_raidz_reflow_sector(rm, rc, r, &devidx, &offset);
+		cvd = vd->vdev_child[devidx];
+
+		if (!vdev_readable(cvd))
+			return (SET_ERROR(ENXIO));
+		if (error == 0 &&
+		    vdev_dtl_contains(cvd, DTL_MISSING, zio->io_txg, 1))
+			error = SET_ERROR(ESTALE);
+	}
+
+	return (error);
+}
+
 static void
 vdev_raidz_io_verify(zio_t *zio, raidz_map_t *rm, int col)
 {
@@ -1827,7 +2023,8 @@ vdev_raidz_io_verify(zio_t *zio, raidz_map_t *rm, int col)
 }
 
 /*
- * Start an IO operation on a RAIDZ VDev
+ * Start an IO operation on a RAIDZ VDev, given its column map.  This is
+ * shared with dRAID, which differs only in how the map is constructed.
  *
  * Outline:
  * - For write operations:
@@ -1843,52 +2040,66 @@ vdev_raidz_io_verify(zio_t *zio, raidz_map_t *rm, int col)
  *      vdevs have had errors, then create zio read operations to the parity
  *      columns' VDevs as well.
  */
-static void
-vdev_raidz_io_start(zio_t *zio)
+void
+vdev_raidz_io_start_impl(zio_t *zio, raidz_map_t *rm)
 {
 	vdev_t *vd = zio->io_vd;
 	vdev_t *tvd = vd->vdev_top;
 	vdev_t *cvd;
-	raidz_map_t *rm;
 	raidz_col_t *rc;
 	int c, i;
 
-	rm = vdev_raidz_map_alloc(zio, tvd->vdev_ashift, vd->vdev_children,
-	    vd->vdev_nparity);
-
 	zio->io_vsd = rm;
 	zio->io_vsd_ops = &vdev_raidz_vsd_ops;
 
-	ASSERT3U(rm->rm_asize, ==, vdev_psize_to_asize(vd, zio->io_size));
+	/*
+	 * Blocks written before a raidz expansion completed are smaller than
+	 * the vdev's current width would make them, but never larger than
+	 * its original width would.
+	 */
+	ASSERT3U(rm->rm_asize, <=,
+	    vdev_psize_to_asize_txg(vd, zio->io_size, 0));
 
 	if (zio->io_type == ZIO_TYPE_WRITE) {
 		vdev_raidz_generate_parity(rm);
 
 		for (c = 0; c < rm->rm_cols; c++) {
 			rc = &rm->rm_col[c];
-			cvd = vd->vdev_child[rc->rc_devidx];
 
 			/*
 			 * Verify physical to logical translation.
 			 */
-			vdev_raidz_io_verify(zio, rm, c);
+			if (vd->vdev_ops == &vdev_raidz_ops && !rm->rm_reflow &&
+			    rm->rm_lcols == vd->vdev_children)
+				vdev_raidz_io_verify(zio, rm, c);
 
-			zio_nowait(zio_vdev_child_io(zio, NULL, cvd,
-			    rc->rc_offset, rc->rc_abd, rc->rc_size,
-			    zio->io_type, zio->io_priority, 0,
-			    vdev_raidz_child_done, rc));
+			vdev_raidz_col_io(zio, rm, rc, zio->io_type,
+			    zio->io_priority, 0, vdev_raidz_child_done);
 		}
 
 		/*
 		 * Generate optional I/Os for any skipped sectors to improve
-		 * aggregation contiguity.
+		 * aggregation contiguity.  If the map supplies padding data
+		 * (dRAID), the skipped sectors are part of the on-disk stripe
+		 * and must really be written, and a failure to write one is
+		 * a failure of that child.  The sectors of a reflowed map
+		 * aren't contiguous anyway.
 		 */
-		for (c = rm->rm_skipstart, i = 0; i < rm->rm_nskip; c++, i++) {
+		for (c = rm->rm_skipstart, i = 0;
+		    !rm->rm_reflow && i < rm->rm_nskip; c++, i++) {
 			ASSERT(c <= rm->rm_scols);
 			if (c == rm->rm_scols)
 				c = 0;
 			rc = &rm->rm_col[c];
 			cvd = vd->vdev_child[rc->rc_devidx];
+			if (rm->rm_skip_abd != NULL) {
+				zio_nowait(zio_vdev_child_io(zio, NULL, cvd,
+				    rc->rc_offset + rc->rc_size,
+				    rm->rm_skip_abd, 1 << tvd->vdev_ashift,
+				    zio->io_type, zio->io_priority, 0,
+				    vdev_raidz_skip_done, rc));
+				continue;
+			}
 			zio_nowait(zio_vdev_child_io(zio, NULL, cvd,
 			    rc->rc_offset + rc->rc_size, NULL,
 			    1 << tvd->vdev_ashift,
@@ -1907,39 +2118,93 @@ vdev_raidz_io_start(zio_t *zio)
 	 * last -- any errors along the way will force us to read the parity.
 	 */
 	for (c = rm->rm_cols - 1; c >= 0; c--) {
+		int error;
+
 		rc = &rm->rm_col[c];
-		cvd = vd->vdev_child[rc->rc_devidx];
-		if (!vdev_readable(cvd)) {
+		if ((error = vdev_raidz_col_missing(zio, rm, rc)) != 0) {
 			if (c >= rm->rm_firstdatacol)
 				rm->rm_missingdata++;
 			else
 				rm->rm_missingparity++;
-			rc->rc_error = SET_ERROR(ENXIO);
-			rc->rc_tried = 1;	/* don't even try */
-			rc->rc_skipped = 1;
-			continue;
-		}
-		if (vdev_dtl_contains(cvd, DTL_MISSING, zio->io_txg, 1)) {
-			if (c >= rm->rm_firstdatacol)
-				rm->rm_missingdata++;
-			else
-				rm->rm_missingparity++;
-			rc->rc_error = SET_ERROR(ESTALE);
+			rc->rc_error = error;
+			if (error == ENXIO)
+				rc->rc_tried = 1;	/* don't even try */
 			rc->rc_skipped = 1;
 			continue;
 		}
 		if (c >= rm->rm_firstdatacol || rm->rm_missingdata > 0 ||
 		    (zio->io_flags & (ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER))) {
-			zio_nowait(zio_vdev_child_io(zio, NULL, cvd,
-			    rc->rc_offset, rc->rc_abd, rc->rc_size,
-			    zio->io_type, zio->io_priority, 0,
-			    vdev_raidz_child_done, rc));
+			vdev_raidz_col_io(zio, rm, rc, zio->io_type,
+			    zio->io_priority, 0, vdev_raidz_child_done);
 		}
 	}
 
 	zio_execute(zio);
 }
 
+/*
+ * Work out whether the block's columns still lie contiguously on the
+ * children.  They don't if the block was written before an expansion of the
+ * vdev completed, or if an expansion's reflow is passing through it.  While
+ * an expansion is in progress the block's range is read-locked so that the
+ * reflow can't move it under us; the lock is dropped when the map is freed.
+ */
+static void
+vdev_raidz_map_reflow(zio_t *zio, raidz_map_t *rm)
+{
+	vdev_t *vd = zio->io_vd;
+	vdev_raidz_expand_t *vre = vd->vdev_spa->spa_raidz_expand;
+	uint64_t start = zio->io_offset >> rm->rm_ashift;
+	uint64_t end = start + (rm->rm_asize >> rm->rm_ashift);
+	uint64_t width = vd->vdev_children;
+
+	rm->rm_pcols = vd->vdev_children;
+
+	if (vd->vdev_rz_expanding) {
+		if (vre != NULL) {
+			rm->rm_lr = rangelock_enter(&vre->vre_rangelock,
+			    zio->io_offset, rm->rm_asize, RL_READER);
+			mutex_enter(&vre->vre_lock);
+			rm->rm_reflow_offset = vre->vre_offset >> rm->rm_ashift;
+			mutex_exit(&vre->vre_lock);
+		} else {
+			rm->rm_reflow_offset = 0;
+		}
+
+		if (start >= rm->rm_reflow_offset) {
+			width--;
+		} else if (end > rm->rm_reflow_offset) {
+			rm->rm_reflow = B_TRUE;
+			return;
+		}
+	}
+
+	rm->rm_reflow = (rm->rm_lcols != width);
+}
+
+static void
+vdev_raidz_io_start(zio_t *zio)
+{
+	vdev_t *vd = zio->io_vd;
+	raidz_map_t *rm;
+	uint64_t txg = zio->io_txg;
+
+	/*
+	 * The layout of a block depends on the width of the vdev when it was
+	 * born, which only the block pointer knows for certain.
+	 */
+	if (zio->io_bp != NULL && vd->vdev_rz_nexpand != 0)
+		txg = BP_PHYSICAL_BIRTH(zio->io_bp);
+
+	rm = vdev_raidz_map_alloc(zio, vd->vdev_top->vdev_ashift,
+	    vdev_raidz_logical_width(vd, txg), vd->vdev_nparity);
+
+	if (vd->vdev_rz_nexpand != 0)
+		vdev_raidz_map_reflow(zio, rm);
+
+	vdev_raidz_io_start_impl(zio, rm);
+}
+
 
 /*
  * Report a checksum error for a child of a RAID-Z device.
@@ -2221,7 +2486,7 @@ done:
  *   3. If there were unexpected errors or this is a resilver operation,
  *      rewrite the vdevs that had errors.
  */
-static void
+void
 vdev_raidz_io_done(zio_t *zio)
 {
 	vdev_t *vd = zio->io_vd;
@@ -2263,6 +2528,25 @@ vdev_raidz_io_done(zio_t *zio)
 	}
 
 	if (zio->io_type == ZIO_TYPE_WRITE) {
+		int skip_error = 0;
+
+		/*
+		 * A child whose padding sector couldn't be written has failed
+		 * this write just as if its column couldn't be, including the
+		 * children that hold nothing but padding for this block.
+		 */
+		for (c = 0; rm->rm_skip_abd != NULL && c < rm->rm_scols; c++) {
+			rc = &rm->rm_col[c];
+
+			if (rc->rc_skip_error == 0 ||
+			    (c < rm->rm_cols && rc->rc_error != 0))
+				continue;
+
+			skip_error = zio_worst_error(skip_error,
+			    rc->rc_skip_error);
+			total_errors++;
+		}
+
 		/*
 		 * XXX -- for now, treat partial writes as a success.
 		 * (If we couldn't write enough columns to reconstruct
@@ -2274,8 +2558,10 @@ vdev_raidz_io_done(zio_t *zio)
 		 * if we intend to reallocate.
 		 */
 		/* XXPOLICY */
-		if (total_errors > rm->rm_firstdatacol)
-			zio->io_error = vdev_raidz_worst_error(rm);
+		if (total_errors > rm->rm_firstdatacol) {
+			zio->io_error = zio_worst_error(
+			    vdev_raidz_worst_error(rm), skip_error);
+		}
 
 		return;
 	}
@@ -2393,11 +2679,8 @@ vdev_raidz_io_done(zio_t *zio)
 			rc = &rm->rm_col[c];
 			if (rc->rc_tried)
 				continue;
-			zio_nowait(zio_vdev_child_io(zio, NULL,
-			    vd->vdev_child[rc->rc_devidx],
-			    rc->rc_offset, rc->rc_abd, rc->rc_size,
-			    zio->io_type, zio->io_priority, 0,
-			    vdev_raidz_child_done, rc));
+			vdev_raidz_col_io(zio, rm, rc, zio->io_type,
+			    zio->io_priority, 0, vdev_raidz_child_done);
 		} while (++c < rm->rm_cols);
 
 		return;
@@ -2470,13 +2753,34 @@ done:
 		 */
 		for (c = 0; c < rm->rm_cols; c++) {
 			rc = &rm->rm_col[c];
-			cvd = vd->vdev_child[rc->rc_devidx];
 
 			if (rc->rc_error == 0)
 				continue;
 
+			vdev_raidz_col_io(zio, rm, rc, ZIO_TYPE_WRITE,
+			    ZIO_PRIORITY_ASYNC_WRITE,
+			    ZIO_FLAG_IO_REPAIR | (unexpected_errors ?
+			    ZIO_FLAG_SELF_HEAL : 0), NULL);
+		}
+
+		/*
+		 * If the padding is part of the on-disk format (dRAID),
+		 * repair it too on any child that needs it, including
+		 * children that hold nothing but padding for this block.
+		 */
+		for (c = rm->rm_skipstart, n = 0;
+		    rm->rm_skip_abd != NULL && n < rm->rm_nskip; c++, n++) {
+			rc = &rm->rm_col[c];
+			cvd = vd->vdev_child[rc->rc_devidx];
+
+			if (c < rm->rm_cols ? rc->rc_error == 0 :
+			    !vdev_dtl_contains(cvd, DTL_PARTIAL,
+			    zio->io_txg, 1))
+				continue;
+
 			zio_nowait(zio_vdev_child_io(zio, NULL, cvd,
-			    rc->rc_offset, rc->rc_abd, rc->rc_size,
+			    rc->rc_offset + rc->rc_size, rm->rm_skip_abd,
+			    1ULL << vd->vdev_top->vdev_ashift,
 			    ZIO_TYPE_WRITE, ZIO_PRIORITY_ASYNC_WRITE,
 			    ZIO_FLAG_IO_REPAIR | (unexpected_errors ?
 			    ZIO_FLAG_SELF_HEAL : 0), NULL, NULL));
@@ -2484,7 +2788,7 @@ done:
 	}
 }
 
-static void
+void
 vdev_raidz_state_change(vdev_t *vd, int faulted, int degraded)
 {
 	if (faulted > vd->vdev_nparity)
@@ -2515,7 +2819,11 @@ vdev_raidz_need_resilver(vdev_t *vd, uint64_t offset, size_t psize)
 	/* The first column for this stripe. */
 	uint64_t f = b % dcols;
 
-	if (s + nparity >= dcols)
+	/*
+	 * Without the block's birth txg we can't tell how an expanded vdev
+	 * has laid it out.
+	 */
+	if (s + nparity >= dcols || vd->vdev_rz_nexpand != 0)
 		return (B_TRUE);
 
 	for (uint64_t c = 0; c < s + nparity; c++) {
@@ -2565,6 +2873,748 @@ vdev_raidz_xlate(vdev_t *cvd, const range_seg64_t *in, range_seg64_t *res)
 	ASSERT3U(res->rs_end - res->rs_start, <=, in->rs_end - in->rs_start);
 }
 
+/*
+ * RAID-Z expansion
+ *
+ * A new child can be attached to an existing raidz vdev (zpool attach).  The
+ * vdev's existing data is then reflowed across the new width in the
+ * background, by the spa_raidz_expand_zthr.  Consider the vdev's sector
+ * space, the parent offset divided by the sector size.  Before the expansion
+ * sector l lives at row l / (n - 1) of child l % (n - 1), where n is the new
+ * number of children; afterwards it lives at row l / n of child l % n.  The
+ * reflow moves sectors from the old layout to the new one in increasing
+ * order, so at any time the sectors below the reflow offset (vre_offset) are
+ * in the new layout and the rest are in the old one.
+ *
+ * Block pointers are not changed: a block keeps the logical width (and so
+ * the parity layout) that it was written at, and vdev_raidz_io_start() finds
+ * each of its sectors wherever the reflow has left it.  The txg in which
+ * each expansion completed is recorded in the vdev's config
+ * (ZPOOL_CONFIG_RAIDZ_EXPAND_TXGS) so the logical width of any block can be
+ * worked out from its birth txg.  New blocks are written at the old width
+ * until the expansion completes, and the space on the new child is not made
+ * available until then either.
+ *
+ * Crash safety: the copy of sector l overwrites the old location of sector
+ * (l / n) * (n - 1) + l % n, which is at or below l.  We only make such a
+ * copy once that sector's own copy is known to be on stable storage, i.e. it
+ * is below the reflow offset in the last synced uberblock.  The offset is
+ * recorded in the uberblock (not the MOS) because the MOS may itself be on
+ * the expanding vdev.  After a crash the reflow resumes from the synced
+ * offset, and copying the sectors above it again is harmless.
+ *
+ * Each metaslab is disabled (so no new blocks are allocated in it) while it
+ * is being reflowed, and only its allocated space is copied.  Reads and
+ * writes to the vdev hold a rangelock for the range they cover, and each
+ * step of the reflow holds the range it is moving exclusively, so I/O sees
+ * either the old or the new layout of every sector.  The reflow uses the
+ * same I/O priority as device removal, which the vdev queue limits in favor
+ * of other I/O.
+ */
+
+/*
+ * Return the number of sectors below sector l that a w-wide layout places on
+ * child c: this is also the row of child c where the first sector at or above
+ * l is placed.
+ */
+static uint64_t
+raidz_reflow_row(uint64_t l, uint64_t c, uint64_t w)
+{
+	return (l > c ? (l - c - 1) / w + 1 : 0);
+}
+
+/*
+ * Return the sector below which the reflow may copy, given that all sectors
+ * below `synced' have been copied and the copies synced.  The new location of
+ * sector l is the old location of sector (l / ncols) * ocols + l % ncols (or
+ * of no sector, if l % ncols is the new child), so l may be copied once that
+ * sector is below `synced'.  Sectors in the first row don't move, so they can
+ * always be copied.
+ */
+static uint64_t
+raidz_reflow_maxend(uint64_t synced, uint64_t ocols, uint64_t ncols)
+{
+	if (synced == 0)
+		return (ncols);
+
+	uint64_t q = (synced - 1) / ocols;
+	uint64_t r = (synced - 1) % ocols;
+
+	return (MAX(ncols, q * ncols + r + 1));
+}
+
+/*
+ * The reflow has to stop if any child can't be read or written, or is
+ * missing data (i.e. is being resilvered): we read sectors without any
+ * knowledge of the blocks they belong to, so can't reconstruct them.
+ */
+static boolean_t
+raidz_reflow_blocked(vdev_t *vd)
+{
+	for (uint64_t c = 0; c < vd->vdev_children; c++) {
+		vdev_t *cvd = vd->vdev_child[c];
+
+		if (!vdev_readable(cvd) || !vdev_writeable(cvd) ||
+		    !vdev_dtl_empty(cvd, DTL_MISSING))
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+static void
+raidz_expand_update_zap(vdev_t *vd, vdev_raidz_expand_t *vre, dmu_tx_t *tx)
+{
+	ASSERT(MUTEX_HELD(&vre->vre_lock));
+
+	if (vd->vdev_top_zap == 0)
+		return;
+
+	VERIFY0(zap_update(vd->vdev_spa->spa_meta_objset, vd->vdev_top_zap,
+	    VDEV_TOP_ZAP_RAIDZ_EXPAND_PHYS, sizeof (uint64_t),
+	    RAIDZ_EXPAND_PHYS_ENTRIES, &vre->vre_phys, tx));
+}
+
+/*
+ * Record the progress made by the reflow in this txg.
+ */
+static void
+raidz_reflow_sync(void *arg, dmu_tx_t *tx)
+{
+	spa_t *spa = arg;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	int txgoff = dmu_tx_get_txg(tx) & TXG_MASK;
+	vdev_t *vd = vdev_lookup_top(spa, vre->vre_vdev_id);
+
+	mutex_enter(&vre->vre_lock);
+	uint64_t offset = vre->vre_offset_pertxg[txgoff];
+	ASSERT3U(offset, !=, 0);
+	ASSERT3U(offset, <=, vre->vre_offset);
+	vre->vre_offset_pertxg[txgoff] = 0;
+
+	vre->vre_phys.vrep_bytes_reflowed +=
+	    vre->vre_bytes_reflowed_pertxg[txgoff];
+	vre->vre_bytes_reflowed_pertxg[txgoff] = 0;
+
+	RRSS_SET_OFFSET(&spa->spa_uberblock, offset);
+	RRSS_SET_ACTIVE(&spa->spa_uberblock, 1);
+
+	raidz_expand_update_zap(vd, vre, tx);
+	mutex_exit(&vre->vre_lock);
+}
+
+static void
+raidz_expand_initiate_sync(void *arg, dmu_tx_t *tx)
+{
+	spa_t *spa = arg;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	vdev_t *vd = vdev_lookup_top(spa, vre->vre_vdev_id);
+	uint64_t to_reflow = 0;
+
+	for (uint64_t i = 0; i < vd->vdev_ms_count; i++)
+		to_reflow += metaslab_allocated_space(vd->vdev_ms[i]);
+
+	mutex_enter(&vre->vre_lock);
+	bzero(&vre->vre_phys, sizeof (vre->vre_phys));
+	vre->vre_phys.vrep_state = DSS_SCANNING;
+	vre->vre_phys.vrep_start_time = gethrestime_sec();
+	vre->vre_phys.vrep_bytes_to_reflow = to_reflow;
+	raidz_expand_update_zap(vd, vre, tx);
+	mutex_exit(&vre->vre_lock);
+
+	RRSS_SET_OFFSET(&spa->spa_uberblock, 0);
+	RRSS_SET_ACTIVE(&spa->spa_uberblock, 1);
+
+	spa_feature_incr(spa, SPA_FEATURE_RAIDZ_EXPANSION, tx);
+
+	spa_history_log_internal(spa, "raidz expand", tx,
+	    "vdev_id=%llu vdev_guid=%llu started",
+	    (u_longlong_t)vd->vdev_id, (u_longlong_t)vd->vdev_guid);
+}
+
+/*
+ * Once everything has been reflowed, the new width takes effect for blocks
+ * born after any txg that might already have allocated at the old one.
+ * The feature remains active: blocks written at the old width are still
+ * laid out in a way that older software can't read.
+ */
+static void
+raidz_expand_complete_sync(void *arg, dmu_tx_t *tx)
+{
+	spa_t *spa = arg;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	vdev_t *vd = vdev_lookup_top(spa, vre->vre_vdev_id);
+	uint64_t txg = dmu_tx_get_txg(tx);
+
+	ASSERT(vd->vdev_rz_expanding);
+	ASSERT3U(vd->vdev_rz_expand_txgs[vd->vdev_rz_nexpand - 1], ==,
+	    UINT64_MAX);
+
+	mutex_enter(&vre->vre_lock);
+	for (int i = 0; i < TXG_SIZE; i++) {
+		ASSERT0(vre->vre_offset_pertxg[i]);
+		vre->vre_phys.vrep_bytes_reflowed +=
+		    vre->vre_bytes_reflowed_pertxg[i];
+		vre->vre_bytes_reflowed_pertxg[i] = 0;
+	}
+	vre->vre_offset = UINT64_MAX;
+	vre->vre_phys.vrep_state = DSS_FINISHED;
+	vre->vre_phys.vrep_end_time = gethrestime_sec();
+	raidz_expand_update_zap(vd, vre, tx);
+	mutex_exit(&vre->vre_lock);
+
+	vd->vdev_rz_expand_txgs[vd->vdev_rz_nexpand - 1] =
+	    txg + TXG_CONCURRENT_STATES;
+	vd->vdev_rz_expanding = B_FALSE;
+	vdev_config_dirty(vd);
+
+	spa->spa_uberblock.ub_raidz_reflow_info = 0;
+
+	spa_history_log_internal(spa, "raidz expand", tx,
+	    "vdev_id=%llu vdev_guid=%llu completed, width=%llu",
+	    (u_longlong_t)vd->vdev_id, (u_longlong_t)vd->vdev_guid,
+	    (u_longlong_t)vd->vdev_children);
+}
+
+static void
+raidz_reflow_io_done(zio_t *zio)
+{
+	vdev_raidz_expand_t *vre = zio->io_private;
+
+	if (zio->io_error != 0) {
+		mutex_enter(&vre->vre_lock);
+		vre->vre_io_error = zio->io_error;
+		mutex_exit(&vre->vre_lock);
+	}
+}
+
+/*
+ * Move sectors [s, e) from the old layout to the new one: read the runs of
+ * them on each old child, shuffle them into the runs they form on each new
+ * child, write those and flush the children's caches.
+ */
+static int
+raidz_reflow_copy(vdev_t *vd, uint64_t s, uint64_t e)
+{
+	spa_t *spa = vd->vdev_spa;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	uint64_t ashift = vd->vdev_ashift;
+	uint64_t ncols = vd->vdev_children;
+	uint64_t ocols = ncols - 1;
+	abd_t **oabd = kmem_zalloc(ocols * sizeof (abd_t *), KM_SLEEP);
+	abd_t **nabd = kmem_zalloc(ncols * sizeof (abd_t *), KM_SLEEP);
+	zio_t *rio;
+	int error;
+
+	mutex_enter(&vre->vre_lock);
+	vre->vre_io_error = 0;
+	mutex_exit(&vre->vre_lock);
+
+	rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	for (uint64_t c = 0; c < ocols; c++) {
+		uint64_t first = raidz_reflow_row(s, c, ocols);
+		uint64_t rows = raidz_reflow_row(e, c, ocols) - first;
+
+		if (rows == 0)
+			continue;
+		oabd[c] = abd_alloc_for_io(rows << ashift, B_FALSE);
+		zio_nowait(zio_vdev_child_io(rio, NULL, vd->vdev_child[c],
+		    first << ashift, oabd[c], rows << ashift, ZIO_TYPE_READ,
+		    ZIO_PRIORITY_REMOVAL, ZIO_FLAG_CANFAIL,
+		    raidz_reflow_io_done, vre));
+	}
+	(void) zio_wait(rio);
+
+	error = vre->vre_io_error;
+	if (error != 0)
+		goto out;
+
+	for (uint64_t c = 0; c < ncols; c++) {
+		uint64_t rows = raidz_reflow_row(e, c, ncols) -
+		    raidz_reflow_row(s, c, ncols);
+
+		if (rows != 0)
+			nabd[c] = abd_alloc_for_io(rows << ashift, B_FALSE);
+	}
+
+	for (uint64_t l = s; l < e; l++) {
+		uint64_t oc = l % ocols;
+		uint64_t nc = l % ncols;
+
+		abd_copy_off(nabd[nc], oabd[oc],
+		    (l / ncols - raidz_reflow_row(s, nc, ncols)) << ashift,
+		    (l / ocols - raidz_reflow_row(s, oc, ocols)) << ashift,
+		    1ULL << ashift);
+	}
+
+	rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	for (uint64_t c = 0; c < ncols; c++) {
+		uint64_t first = raidz_reflow_row(s, c, ncols);
+		uint64_t rows = raidz_reflow_row(e, c, ncols) - first;
+
+		if (rows == 0)
+			continue;
+		zio_nowait(zio_vdev_child_io(rio, NULL, vd->vdev_child[c],
+		    first << ashift, nabd[c], rows << ashift,
+		    ZIO_TYPE_WRITE, ZIO_PRIORITY_REMOVAL, ZIO_FLAG_CANFAIL,
+		    raidz_reflow_io_done, vre));
+	}
+	(void) zio_wait(rio);
+
+	error = vre->vre_io_error;
+	if (error != 0)
+		goto out;
+
+	/*
+	 * The copies must be on stable storage before the reflow offset that
+	 * covers them is synced.
+	 */
+	rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	zio_flush(rio, vd);
+	(void) zio_wait(rio);
+
+out:
+	for (uint64_t c = 0; c < ocols; c++) {
+		if (oabd[c] != NULL)
+			abd_free(oabd[c]);
+	}
+	for (uint64_t c = 0; c < ncols; c++) {
+		if (nabd[c] != NULL)
+			abd_free(nabd[c]);
+	}
+	kmem_free(oabd, ocols * sizeof (abd_t *));
+	kmem_free(nabd, ncols * sizeof (abd_t *));
+
+	return (error);
+}
+
+/*
+ * Advance the reflow offset to `end', copying the range [start, end) if
+ * `copy' is set.  Otherwise the range is known to be free, and there is
+ * nothing to move.
+ */
+static int
+raidz_reflow_chunk(vdev_t *vd, uint64_t start, uint64_t end, boolean_t copy)
+{
+	spa_t *spa = vd->vdev_spa;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	locked_range_t *lr;
+	int error = 0;
+
+	ASSERT3U(start, <, end);
+
+	dmu_tx_t *tx = dmu_tx_create_dd(spa_get_dsl(spa)->dp_mos_dir);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	uint64_t txg = dmu_tx_get_txg(tx);
+
+	lr = rangelock_enter(&vre->vre_rangelock, start, end - start,
+	    RL_WRITER);
+
+	if (copy) {
+		spa_config_enter(spa, SCL_STATE_ALL, FTAG, RW_READER);
+		if (raidz_reflow_blocked(vd)) {
+			error = SET_ERROR(EAGAIN);
+		} else {
+			error = raidz_reflow_copy(vd, start >> vd->vdev_ashift,
+			    end >> vd->vdev_ashift);
+		}
+		spa_config_exit(spa, SCL_STATE_ALL, FTAG);
+	}
+
+	if (error == 0) {
+		mutex_enter(&vre->vre_lock);
+		ASSERT3U(vre->vre_offset, ==, start);
+		if (vre->vre_offset_pertxg[txg & TXG_MASK] == 0) {
+			/* This is the first chunk of this txg. */
+			dsl_sync_task_nowait(spa_get_dsl(spa),
+			    raidz_reflow_sync, spa, 0, ZFS_SPACE_CHECK_NONE,
+			    tx);
+		}
+		vre->vre_offset = end;
+		vre->vre_offset_pertxg[txg & TXG_MASK] = end;
+		if (copy)
+			vre->vre_bytes_reflowed_pertxg[txg & TXG_MASK] +=
+			    end - start;
+		mutex_exit(&vre->vre_lock);
+	}
+
+	rangelock_exit(lr);
+	dmu_tx_commit(tx);
+
+	return (error);
+}
+
+static boolean_t
+raidz_reflow_paused(spa_t *spa, zthr_t *zthr)
+{
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+
+	return (zthr_iscancelled(zthr) ||
+	    (zfs_raidz_expand_max_reflow_bytes != 0 &&
+	    vre->vre_phys.vrep_bytes_reflowed >=
+	    zfs_raidz_expand_max_reflow_bytes));
+}
+
+/*
+ * Reflow the allocated range [start, end) of a metaslab, in chunks of at
+ * most zfs_raidz_expand_max_copy_bytes, waiting for txgs to sync whenever
+ * the next sectors can't be copied yet.
+ */
+static int
+raidz_reflow_range(vdev_t *vd, uint64_t start, uint64_t end, zthr_t *zthr)
+{
+	spa_t *spa = vd->vdev_spa;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	uint64_t ashift = vd->vdev_ashift;
+	uint64_t maxcopy = MAX(P2ALIGN(zfs_raidz_expand_max_copy_bytes,
+	    1ULL << ashift), 1ULL << ashift);
+	uint64_t cur = start;
+	int error;
+
+	if (vre->vre_offset < start) {
+		error = raidz_reflow_chunk(vd, vre->vre_offset, start, B_FALSE);
+		if (error != 0)
+			return (error);
+	}
+
+	while (cur < end) {
+		if (raidz_reflow_paused(spa, zthr))
+			return (SET_ERROR(EINTR));
+
+		uint64_t synced = RRSS_GET_OFFSET(&spa->spa_ubsync) >> ashift;
+		uint64_t limit = raidz_reflow_maxend(synced,
+		    vd->vdev_children - 1, vd->vdev_children) << ashift;
+		uint64_t e = MIN(end, MIN(cur + maxcopy, limit));
+
+		if (e <= cur) {
+			txg_wait_synced(spa_get_dsl(spa), 0);
+			continue;
+		}
+
+		error = raidz_reflow_chunk(vd, cur, e, B_TRUE);
+		if (error != 0)
+			return (error);
+		cur = e;
+	}
+
+	return (0);
+}
+
+static int
+raidz_reflow_metaslab(vdev_t *vd, metaslab_t *msp, zthr_t *zthr)
+{
+	spa_t *spa = vd->vdev_spa;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	uint64_t ms_end = msp->ms_start + msp->ms_size;
+	boolean_t unload_when_done = B_FALSE;
+	int error = 0;
+
+	/*
+	 * Once the metaslab is disabled nothing more can be allocated from
+	 * it; wait for the blocks already allocated from it to be written.
+	 */
+	metaslab_disable(msp);
+	txg_wait_synced(spa_get_dsl(spa), 0);
+
+	mutex_enter(&msp->ms_lock);
+	if (!msp->ms_loaded && !msp->ms_loading)
+		unload_when_done = B_TRUE;
+	VERIFY0(metaslab_load(msp));
+
+	/*
+	 * Copy everything that isn't allocatable.  That includes space that
+	 * is being freed, which is harmless.
+	 */
+	range_tree_t *rt = range_tree_create(NULL, RANGE_SEG64, NULL, 0, 0);
+	range_tree_add(rt, msp->ms_start, msp->ms_size);
+	range_tree_walk(msp->ms_allocatable, range_tree_remove, rt);
+	mutex_exit(&msp->ms_lock);
+
+	if (vre->vre_offset > msp->ms_start)
+		range_tree_clear(rt, msp->ms_start,
+		    vre->vre_offset - msp->ms_start);
+
+	zfs_btree_t *bt = &rt->rt_root;
+	zfs_btree_index_t where;
+	for (range_seg_t *rs = zfs_btree_first(bt, &where); rs != NULL;
+	    rs = zfs_btree_next(bt, &where, &where)) {
+		error = raidz_reflow_range(vd, rs_get_start(rs, rt),
+		    rs_get_end(rs, rt), zthr);
+		if (error != 0)
+			break;
+	}
+	range_tree_vacate(rt, NULL, NULL);
+	range_tree_destroy(rt);
+
+	/*
+	 * Take the offset past any free space at the end of the metaslab, so
+	 * that blocks allocated there once it is enabled again are written in
+	 * the new layout.  The offset must be synced before that can happen.
+	 */
+	if (error == 0 && vre->vre_offset < ms_end) {
+		error = raidz_reflow_chunk(vd, vre->vre_offset, ms_end,
+		    B_FALSE);
+	}
+
+	metaslab_enable(msp, B_TRUE, unload_when_done);
+
+	return (error);
+}
+
+static boolean_t
+spa_raidz_expand_thread_check(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	boolean_t blocked;
+
+	if (vre == NULL || vre->vre_phys.vrep_state != DSS_SCANNING ||
+	    raidz_reflow_paused(spa, zthr))
+		return (B_FALSE);
+
+	spa_config_enter(spa, SCL_STATE, FTAG, RW_READER);
+	blocked = raidz_reflow_blocked(vdev_lookup_top(spa, vre->vre_vdev_id));
+	spa_config_exit(spa, SCL_STATE, FTAG);
+
+	mutex_enter(&vre->vre_lock);
+	vre->vre_waiting_for_resilver = blocked;
+	mutex_exit(&vre->vre_lock);
+
+	return (!blocked);
+}
+
+static void
+spa_raidz_expand_thread(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+	vdev_t *vd;
+	uint64_t i;
+	int error = 0;
+
+	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+	vd = vdev_lookup_top(spa, vre->vre_vdev_id);
+	ASSERT(vd->vdev_rz_expanding);
+
+	for (i = vre->vre_offset >> vd->vdev_ms_shift;
+	    i < vd->vdev_ms_count && error == 0; i++) {
+		metaslab_t *msp = vd->vdev_ms[i];
+
+		spa_config_exit(spa, SCL_CONFIG, FTAG);
+		error = raidz_reflow_metaslab(vd, msp, zthr);
+		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+	}
+	spa_config_exit(spa, SCL_CONFIG, FTAG);
+
+	if (error != 0) {
+		/*
+		 * If a child failed, raidz_reflow_blocked() will see it the
+		 * next time we are checked; don't spin retrying meanwhile.
+		 */
+		if (error != EINTR && error != EAGAIN) {
+			zfs_dbgmsg("raidz expand of vdev %llu paused at "
+			    "offset %llu, error %d",
+			    (u_longlong_t)vre->vre_vdev_id,
+			    (u_longlong_t)vre->vre_offset, error);
+			delay(SEC_TO_TICK(1));
+		}
+		return;
+	}
+
+	VERIFY0(dsl_sync_task(spa_name(spa), NULL, raidz_expand_complete_sync,
+	    spa, 0, ZFS_SPACE_CHECK_NONE));
+
+	/*
+	 * Reopen the vdev so that it picks up the space on the new child,
+	 * and have metaslabs created for it.
+	 */
+	spa_vdev_state_enter(spa, SCL_NONE);
+	vd->vdev_expanding = B_TRUE;
+	vdev_reopen(vd);
+	vd->vdev_expanding = B_FALSE;
+	(void) spa_vdev_state_exit(spa, vd, 0);
+
+	spa_async_request(spa, SPA_ASYNC_CONFIG_UPDATE);
+	spa_async_request(spa, SPA_ASYNC_INITIALIZE_RESTART);
+	spa_async_request(spa, SPA_ASYNC_TRIM_RESTART);
+	spa_async_request(spa, SPA_ASYNC_AUTOTRIM_RESTART);
+}
+
+void
+vdev_raidz_expand_start_thread(spa_t *spa)
+{
+	ASSERT3P(spa->spa_raidz_expand_zthr, ==, NULL);
+	spa->spa_raidz_expand_zthr = zthr_create_timer(
+	    spa_raidz_expand_thread_check, spa_raidz_expand_thread, spa,
+	    SEC2NSEC(5));
+}
+
+/*
+ * Set up (or reset) the in-core state of an expansion whose reflow has
+ * reached `offset'.
+ */
+void
+vdev_raidz_expand_init(spa_t *spa, uint64_t offset)
+{
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+
+	if (vre == NULL) {
+		vre = kmem_zalloc(sizeof (*vre), KM_SLEEP);
+		mutex_init(&vre->vre_lock, NULL, MUTEX_DEFAULT, NULL);
+		rangelock_init(&vre->vre_rangelock, NULL, NULL);
+		spa->spa_raidz_expand = vre;
+	}
+
+	mutex_enter(&vre->vre_lock);
+	vre->vre_vdev_id = UINT64_MAX;
+	vre->vre_offset = offset;
+	bzero(vre->vre_offset_pertxg, sizeof (vre->vre_offset_pertxg));
+	bzero(vre->vre_bytes_reflowed_pertxg,
+	    sizeof (vre->vre_bytes_reflowed_pertxg));
+	vre->vre_waiting_for_resilver = B_FALSE;
+	vre->vre_io_error = 0;
+	bzero(&vre->vre_phys, sizeof (vre->vre_phys));
+	mutex_exit(&vre->vre_lock);
+}
+
+void
+vdev_raidz_expand_fini(spa_t *spa)
+{
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+
+	if (vre == NULL)
+		return;
+
+	rangelock_fini(&vre->vre_rangelock);
+	mutex_destroy(&vre->vre_lock);
+	kmem_free(vre, sizeof (*vre));
+	spa->spa_raidz_expand = NULL;
+}
+
+/*
+ * Begin expanding vd, to which a new child has just been attached.  Called
+ * from spa_vdev_attach() with all config locks held.
+ */
+void
+vdev_raidz_expand_start(vdev_t *vd, dmu_tx_t *tx)
+{
+	spa_t *spa = vd->vdev_spa;
+	uint64_t *txgs;
+
+	ASSERT(spa_config_held(spa, SCL_ALL, RW_WRITER) == SCL_ALL);
+	ASSERT3P(vd->vdev_ops, ==, &vdev_raidz_ops);
+	ASSERT3P(vd, ==, vd->vdev_top);
+	ASSERT(!vd->vdev_rz_expanding);
+
+	txgs = kmem_alloc((vd->vdev_rz_nexpand + 1) * sizeof (uint64_t),
+	    KM_SLEEP);
+	if (vd->vdev_rz_nexpand != 0) {
+		bcopy(vd->vdev_rz_expand_txgs, txgs,
+		    vd->vdev_rz_nexpand * sizeof (uint64_t));
+		kmem_free(vd->vdev_rz_expand_txgs,
+		    vd->vdev_rz_nexpand * sizeof (uint64_t));
+	}
+	txgs[vd->vdev_rz_nexpand++] = UINT64_MAX;
+	vd->vdev_rz_expand_txgs = txgs;
+	vd->vdev_rz_expanding = B_TRUE;
+
+	vdev_raidz_expand_init(spa, 0);
+	spa->spa_raidz_expand->vre_vdev_id = vd->vdev_id;
+
+	dsl_sync_task_nowait(spa_get_dsl(spa), raidz_expand_initiate_sync,
+	    spa, 0, ZFS_SPACE_CHECK_NONE, tx);
+}
+
+/*
+ * Called when the pool is loaded, after vdev_raidz_expand_init() has been
+ * called with the offset from the uberblock (if an expansion is in
+ * progress).  Load the expansion's on-disk state, or that of the last one
+ * to finish, for its statistics.
+ */
+int
+vdev_raidz_expand_load(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+	vdev_raidz_expand_t *vre;
+	vdev_raidz_expand_phys_t phys;
+	int error;
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *tvd = rvd->vdev_child[c];
+
+		if (tvd->vdev_ops != &vdev_raidz_ops || !tvd->vdev_rz_expanding)
+			continue;
+
+		/* The uberblock may predate the expansion's first sync. */
+		if (spa->spa_raidz_expand == NULL)
+			vdev_raidz_expand_init(spa, 0);
+		vre = spa->spa_raidz_expand;
+		vre->vre_vdev_id = tvd->vdev_id;
+		vre->vre_phys.vrep_state = DSS_SCANNING;
+
+		if (tvd->vdev_top_zap == 0)
+			return (0);
+		error = zap_lookup(spa->spa_meta_objset, tvd->vdev_top_zap,
+		    VDEV_TOP_ZAP_RAIDZ_EXPAND_PHYS, sizeof (uint64_t),
+		    RAIDZ_EXPAND_PHYS_ENTRIES, &vre->vre_phys);
+		return (error == ENOENT ? 0 : error);
+	}
+
+	/*
+	 * Nothing is being expanded: keep the statistics of the expansion
+	 * that finished most recently.
+	 */
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		vdev_t *tvd = rvd->vdev_child[c];
+
+		if (tvd->vdev_ops != &vdev_raidz_ops ||
+		    tvd->vdev_rz_nexpand == 0 || tvd->vdev_top_zap == 0)
+			continue;
+
+		error = zap_lookup(spa->spa_meta_objset, tvd->vdev_top_zap,
+		    VDEV_TOP_ZAP_RAIDZ_EXPAND_PHYS, sizeof (uint64_t),
+		    RAIDZ_EXPAND_PHYS_ENTRIES, &phys);
+		if (error == ENOENT)
+			continue;
+		if (error != 0)
+			return (error);
+
+		vre = spa->spa_raidz_expand;
+		if (vre == NULL ||
+		    phys.vrep_end_time >= vre->vre_phys.vrep_end_time) {
+			vdev_raidz_expand_init(spa, UINT64_MAX);
+			vre = spa->spa_raidz_expand;
+			vre->vre_vdev_id = tvd->vdev_id;
+			vre->vre_phys = phys;
+		}
+	}
+
+	return (0);
+}
+
+int
+vdev_raidz_expand_get_stats(spa_t *spa, pool_raidz_expand_stat_t *pres)
+{
+	vdev_raidz_expand_t *vre = spa->spa_raidz_expand;
+
+	if (vre == NULL || vre->vre_phys.vrep_state == DSS_NONE)
+		return (SET_ERROR(ENOENT));
+
+	bzero(pres, sizeof (*pres));
+	mutex_enter(&vre->vre_lock);
+	pres->pres_state = vre->vre_phys.vrep_state;
+	pres->pres_expanding_vdev = vre->vre_vdev_id;
+	pres->pres_start_time = vre->vre_phys.vrep_start_time;
+	pres->pres_end_time = vre->vre_phys.vrep_end_time;
+	pres->pres_to_reflow = vre->vre_phys.vrep_bytes_to_reflow;
+	pres->pres_reflowed = vre->vre_phys.vrep_bytes_reflowed;
+	for (int i = 0; i < TXG_SIZE; i++)
+		pres->pres_reflowed += vre->vre_bytes_reflowed_pertxg[i];
+	pres->pres_waiting_for_resilver = vre->vre_waiting_for_resilver;
+	mutex_exit(&vre->vre_lock);
+
+	return (0);
+}
+
 vdev_ops_t vdev_raidz_ops = {
 	.vdev_op_open = vdev_raidz_open,
 	.vdev_op_close = vdev_raidz_close,
@@ -0,0 +1,695 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/spa.h>
+#include <sys/spa_impl.h>
+#include <sys/txg.h>
+#include <sys/vdev_impl.h>
+#include <sys/vdev_draid.h>
+#include <sys/vdev_rebuild.h>
+#include <sys/metaslab_impl.h>
+#include <sys/dsl_synctask.h>
+#include <sys/zap.h>
+#include <sys/dmu_tx.h>
+#include <sys/abd.h>
+
+/*
+ * Sequential rebuild of a dRAID vdev.
+ *
+ * A resilver walks the block pointer tree and so issues its I/O in
+ * logical order, one block at a time.  When a dRAID child is replaced by
+ * a distributed spare we instead walk the allocated space of every
+ * metaslab in offset order and rebuild it a full redundancy-group row at
+ * a time.  Each rebuild I/O is a read of a fabricated, unchecksummed
+ * block pointer covering whole rows; the dRAID I/O path reconstructs the
+ * missing columns from parity and, because the read is flagged as a
+ * resilver, writes them to the spare.  The spare's columns are spread
+ * across all surviving children, so the rebuild proceeds at the aggregate
+ * bandwidth of the vdev rather than that of a single replacement disk.
+ *
+ * Because no checksums are verified, a completed rebuild should be
+ * followed by a scrub.  Progress is recorded in the top-level vdev's ZAP
+ * so an interrupted rebuild resumes where it left off when the pool is
+ * next imported.
+ */
+
+/* maximum size of a single rebuild I/O; default 1MiB */
+uint64_t zfs_rebuild_max_segment = 1024 * 1024;
+
+/* bytes of rebuild I/O allowed in flight, per child of the top-level vdev */
+uint64_t zfs_rebuild_vdev_limit = 32 << 20;
+
+static boolean_t
+vdev_rebuild_should_stop(vdev_t *vd)
+{
+	return (vd->vdev_rebuild_exit_wanted ||
+	    vd->vdev_rebuild_reset_wanted || vdev_is_dead(vd));
+}
+
+static uint64_t
+vdev_rebuild_estimate(vdev_t *vd)
+{
+	uint64_t est = 0;
+
+	for (uint64_t i = 0; i < vd->vdev_ms_count; i++) {
+		metaslab_t *msp = vd->vdev_ms[i];
+
+		mutex_enter(&msp->ms_lock);
+		est += metaslab_allocated_space(msp);
+		mutex_exit(&msp->ms_lock);
+	}
+
+	return (est);
+}
+
+/*
+ * Write the in-core rebuild state to the top-level vdev's ZAP.  Caller
+ * must hold vdev_rebuild_lock.
+ */
+static void
+vdev_rebuild_update_zap(vdev_t *vd, dmu_tx_t *tx)
+{
+	vdev_rebuild_phys_t *vrp = &vd->vdev_rebuild_config.vr_rebuild_phys;
+
+	ASSERT(MUTEX_HELD(&vd->vdev_rebuild_lock));
+	ASSERT(vd->vdev_top_zap != 0);
+
+	VERIFY0(zap_update(vd->vdev_spa->spa_meta_objset, vd->vdev_top_zap,
+	    VDEV_TOP_ZAP_REBUILD_PHYS, sizeof (uint64_t),
+	    REBUILD_PHYS_ENTRIES, vrp, tx));
+}
+
+static void
+vdev_rebuild_zap_update_sync(void *arg, dmu_tx_t *tx)
+{
+	/*
+	 * As with vdev_initialize, pass the guid rather than the vdev_t in
+	 * case the vdev has been freed by the time the sync task runs.
+	 */
+	uint64_t guid = *(uint64_t *)arg;
+	uint64_t txg = dmu_tx_get_txg(tx);
+	kmem_free(arg, sizeof (uint64_t));
+
+	vdev_t *vd = spa_lookup_by_guid(tx->tx_pool->dp_spa, guid, B_FALSE);
+	if (vd == NULL || vd->vdev_top_zap == 0)
+		return;
+
+	vdev_rebuild_t *vr = &vd->vdev_rebuild_config;
+
+	mutex_enter(&vd->vdev_rebuild_lock);
+	if (vr->vr_scan_offset[txg & TXG_MASK] > 0) {
+		vr->vr_rebuild_phys.vrp_last_offset =
+		    vr->vr_scan_offset[txg & TXG_MASK];
+		vr->vr_scan_offset[txg & TXG_MASK] = 0;
+	}
+	vdev_rebuild_update_zap(vd, tx);
+	mutex_exit(&vd->vdev_rebuild_lock);
+}
+
+/*
+ * Reset the on-disk state to cover a rebuild starting in this txg.
+ */
+static void
+vdev_rebuild_reset_phys(vdev_t *vd, dmu_tx_t *tx)
+{
+	vdev_rebuild_t *vr = &vd->vdev_rebuild_config;
+	vdev_rebuild_phys_t *vrp = &vr->vr_rebuild_phys;
+
+	ASSERT(MUTEX_HELD(&vd->vdev_rebuild_lock));
+
+	bzero(vrp, sizeof (*vrp));
+	bzero(vr->vr_scan_offset, sizeof (vr->vr_scan_offset));
+	vrp->vrp_rebuild_state = VDEV_REBUILD_ACTIVE;
+	vrp->vrp_max_txg = dmu_tx_get_txg(tx);
+	vrp->vrp_start_time = gethrestime_sec();
+	vrp->vrp_bytes_est = vdev_rebuild_estimate(vd);
+
+	vdev_rebuild_update_zap(vd, tx);
+}
+
+static void vdev_rebuild_thread(void *arg);
+
+static void
+vdev_rebuild_initiate_sync(void *arg, dmu_tx_t *tx)
+{
+	vdev_t *vd = arg;
+	spa_t *spa = vd->vdev_spa;
+
+	mutex_enter(&vd->vdev_rebuild_lock);
+	vdev_rebuild_reset_phys(vd, tx);
+
+	spa_history_log_internal(spa, "rebuild", tx,
+	    "vdev_id=%llu vdev_guid=%llu started",
+	    (u_longlong_t)vd->vdev_id, (u_longlong_t)vd->vdev_guid);
+
+	ASSERT3P(vd->vdev_rebuild_thread, ==, NULL);
+	vd->vdev_rebuild_thread = thread_create(NULL, 0,
+	    vdev_rebuild_thread, vd, 0, &p0, TS_RUN, maxclsyspri);
+	mutex_exit(&vd->vdev_rebuild_lock);
+}
+
+static void
+vdev_rebuild_reset_sync(void *arg, dmu_tx_t *tx)
+{
+	vdev_t *vd = arg;
+
+	mutex_enter(&vd->vdev_rebuild_lock);
+	vdev_rebuild_reset_phys(vd, tx);
+
+	spa_history_log_internal(vd->vdev_spa, "rebuild", tx,
+	    "vdev_id=%llu vdev_guid=%llu restarted",
+	    (u_longlong_t)vd->vdev_id, (u_longlong_t)vd->vdev_guid);
+	mutex_exit(&vd->vdev_rebuild_lock);
+}
+
+static void
+vdev_rebuild_complete_sync(void *arg, dmu_tx_t *tx)
+{
+	uint64_t guid = *(uint64_t *)arg;
+	kmem_free(arg, sizeof (uint64_t));
+
+	spa_t *spa = tx->tx_pool->dp_spa;
+	vdev_t *vd = spa_lookup_by_guid(spa, guid, B_FALSE);
+	if (vd == NULL || vd->vdev_top_zap == 0)
+		return;
+
+	vdev_rebuild_phys_t *vrp = &vd->vdev_rebuild_config.vr_rebuild_phys;
+
+	mutex_enter(&vd->vdev_rebuild_lock);
+	vrp->vrp_rebuild_state = VDEV_REBUILD_COMPLETE;
+	vrp->vrp_end_time = gethrestime_sec();
+	vdev_rebuild_update_zap(vd, tx);
+
+	/*
+	 * Every txg up to the point where the rebuild started scanning has
+	 * been rebuilt, and everything written since went to the new
+	 * children as well, so their DTLs may be excised.
+	 */
+	vdev_dtl_reassess(vd, tx->tx_txg,
+	    vrp->vrp_max_txg + TXG_CONCURRENT_STATES, B_FALSE, B_TRUE);
+
+	spa_history_log_internal(spa, "rebuild", tx,
+	    "vdev_id=%llu vdev_guid=%llu complete, errors=%llu",
+	    (u_longlong_t)vd->vdev_id, (u_longlong_t)vd->vdev_guid,
+	    (u_longlong_t)vrp->vrp_errors);
+	mutex_exit(&vd->vdev_rebuild_lock);
+
+	/* Detach any replaced devices that are now fully rebuilt. */
+	spa_async_request(spa, SPA_ASYNC_RESILVER_DONE);
+}
+
+static void
+vdev_rebuild_cb(zio_t *zio)
+{
+	vdev_rebuild_t *vr = zio->io_private;
+	vdev_rebuild_phys_t *vrp = &vr->vr_rebuild_phys;
+	vdev_t *vd = vr->vr_top_vdev;
+	uint64_t start = DVA_GET_OFFSET(&zio->io_bp->blk_dva[0]);
+	uint64_t asize = DVA_GET_ASIZE(&zio->io_bp->blk_dva[0]);
+
+	mutex_enter(&vd->vdev_rebuild_lock);
+	if (zio->io_error != 0) {
+		/*
+		 * Don't let the recorded progress move past a range that
+		 * could not be rebuilt.  This works because spa_sync waits
+		 * on spa_txg_zio before it runs sync tasks.
+		 */
+		for (int t = 0; t < TXG_SIZE; t++) {
+			if (vr->vr_scan_offset[t] != 0)
+				vr->vr_scan_offset[t] =
+				    MIN(vr->vr_scan_offset[t], start);
+		}
+		if (zio->io_error != ENXIO || vdev_writeable(vd))
+			vrp->vrp_errors++;
+	} else {
+		vrp->vrp_bytes_rebuilt += asize;
+	}
+	mutex_exit(&vd->vdev_rebuild_lock);
+
+	abd_free(zio->io_abd);
+
+	mutex_enter(&vr->vr_io_lock);
+	ASSERT3U(vr->vr_bytes_inflight, >=, asize);
+	vr->vr_bytes_inflight -= asize;
+	cv_broadcast(&vr->vr_io_cv);
+	mutex_exit(&vr->vr_io_lock);
+
+	spa_config_exit(vd->vdev_spa, SCL_STATE_ALL, vd);
+}
+
+/*
+ * Issue a rebuild read for [start, start + asize), which must be made up
+ * of whole rows of a single redundancy group.
+ */
+static int
+vdev_rebuild_range(vdev_rebuild_t *vr, uint64_t start, uint64_t asize)
+{
+	vdev_t *vd = vr->vr_top_vdev;
+	spa_t *spa = vd->vdev_spa;
+	uint64_t psize = vdev_draid_asize_to_psize(vd, asize);
+	blkptr_t blk, *bp = &blk;
+
+	/* Limit inflight rebuild I/O */
+	mutex_enter(&vr->vr_io_lock);
+	while (vr->vr_bytes_inflight >= vr->vr_bytes_inflight_max)
+		cv_wait(&vr->vr_io_cv, &vr->vr_io_lock);
+	vr->vr_bytes_inflight += asize;
+	mutex_exit(&vr->vr_io_lock);
+
+	dmu_tx_t *tx = dmu_tx_create_dd(spa_get_dsl(spa)->dp_mos_dir);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	uint64_t txg = dmu_tx_get_txg(tx);
+
+	spa_config_enter(spa, SCL_STATE_ALL, vd, RW_READER);
+	mutex_enter(&vd->vdev_rebuild_lock);
+
+	if (vr->vr_scan_offset[txg & TXG_MASK] == 0) {
+		uint64_t *guid = kmem_zalloc(sizeof (uint64_t), KM_SLEEP);
+		*guid = vd->vdev_guid;
+
+		/* This is the first I/O of this txg. */
+		dsl_sync_task_nowait(spa_get_dsl(spa),
+		    vdev_rebuild_zap_update_sync, guid, 2,
+		    ZFS_SPACE_CHECK_RESERVED, tx);
+	}
+
+	/*
+	 * We know the vdev struct will still be around since all
+	 * consumers of vdev_free must stop the rebuild first.
+	 */
+	if (vdev_rebuild_should_stop(vd)) {
+		mutex_enter(&vr->vr_io_lock);
+		vr->vr_bytes_inflight -= asize;
+		mutex_exit(&vr->vr_io_lock);
+		spa_config_exit(spa, SCL_STATE_ALL, vd);
+		mutex_exit(&vd->vdev_rebuild_lock);
+		dmu_tx_commit(tx);
+		return (SET_ERROR(EINTR));
+	}
+
+	vr->vr_scan_offset[txg & TXG_MASK] = start + asize;
+	mutex_exit(&vd->vdev_rebuild_lock);
+
+	/*
+	 * The block pointer only exists to route the read through the
+	 * normal I/O pipeline; it covers whole rows, carries no checksum,
+	 * and its birth txg is contained in the DTL of every newly attached
+	 * child so that those columns are reconstructed and rewritten.
+	 */
+	BP_ZERO(bp);
+	DVA_SET_VDEV(&bp->blk_dva[0], vd->vdev_id);
+	DVA_SET_OFFSET(&bp->blk_dva[0], start);
+	DVA_SET_GANG(&bp->blk_dva[0], 0);
+	DVA_SET_ASIZE(&bp->blk_dva[0], asize);
+	BP_SET_BIRTH(bp, TXG_INITIAL, TXG_INITIAL);
+	BP_SET_LSIZE(bp, psize);
+	BP_SET_PSIZE(bp, psize);
+	BP_SET_COMPRESS(bp, ZIO_COMPRESS_OFF);
+	BP_SET_CHECKSUM(bp, ZIO_CHECKSUM_OFF);
+	BP_SET_TYPE(bp, DMU_OT_NONE);
+	BP_SET_LEVEL(bp, 0);
+	BP_SET_DEDUP(bp, 0);
+	BP_SET_BYTEORDER(bp, ZFS_HOST_BYTEORDER);
+
+	zio_nowait(zio_read(spa->spa_txg_zio[txg & TXG_MASK], spa, bp,
+	    abd_alloc(psize, B_FALSE), psize, vdev_rebuild_cb, vr,
+	    ZIO_PRIORITY_SCRUB, ZIO_FLAG_RAW | ZIO_FLAG_CANFAIL |
+	    ZIO_FLAG_RESILVER, NULL));
+	/* vdev_rebuild_cb releases SCL_STATE_ALL */
+
+	dmu_tx_commit(tx);
+
+	return (0);
+}
+
+/*
+ * Rebuild the ranges in vr_scan_tree.  Each range is widened to whole
+ * rows and split at redundancy group boundaries, since a dRAID I/O may
+ * not span two groups.
+ */
+static int
+vdev_rebuild_ranges(vdev_rebuild_t *vr)
+{
+	vdev_t *vd = vr->vr_top_vdev;
+	range_tree_t *rt = vr->vr_scan_tree;
+	zfs_btree_t *bt = &rt->rt_root;
+	zfs_btree_index_t where;
+	uint64_t rowsz = vdev_draid_row_size(vd);
+	uint64_t groupsz = vdev_draid_group_size(vd);
+	uint64_t chunksz = MAX(rowsz,
+	    zfs_rebuild_max_segment - (zfs_rebuild_max_segment % rowsz));
+
+	for (range_seg_t *rs = zfs_btree_first(bt, &where); rs != NULL;
+	    rs = zfs_btree_next(bt, &where, &where)) {
+		uint64_t start = rs_get_start(rs, rt);
+		uint64_t end = rs_get_end(rs, rt);
+
+		start -= start % rowsz;
+		end = roundup(end, rowsz);
+
+		while (start < end) {
+			uint64_t gend = start - (start % groupsz) + groupsz;
+			uint64_t size = MIN(MIN(end - start, chunksz),
+			    gend - start);
+			int error;
+
+			error = vdev_rebuild_range(vr, start, size);
+			if (error != 0)
+				return (error);
+			start += size;
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Restart the rebuild from the beginning so that it also covers children
+ * attached since it started.  Called by the rebuild thread without the
+ * config lock held.
+ */
+static void
+vdev_rebuild_reset(vdev_t *vd)
+{
+	vdev_rebuild_t *vr = &vd->vdev_rebuild_config;
+	spa_t *spa = vd->vdev_spa;
+
+	mutex_enter(&vr->vr_io_lock);
+	while (vr->vr_bytes_inflight > 0)
+		cv_wait(&vr->vr_io_cv, &vr->vr_io_lock);
+	mutex_exit(&vr->vr_io_lock);
+
+	mutex_enter(&vd->vdev_rebuild_lock);
+	vd->vdev_rebuild_reset_wanted = B_FALSE;
+	mutex_exit(&vd->vdev_rebuild_lock);
+
+	dmu_tx_t *tx = dmu_tx_create_dd(spa_get_dsl(spa)->dp_mos_dir);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	uint64_t txg = dmu_tx_get_txg(tx);
+	dsl_sync_task_nowait(spa_get_dsl(spa), vdev_rebuild_reset_sync,
+	    vd, 2, ZFS_SPACE_CHECK_NONE, tx);
+	dmu_tx_commit(tx);
+
+	/* See the comment at the top of vdev_rebuild_thread(). */
+	txg_wait_synced(spa_get_dsl(spa), txg + TXG_CONCURRENT_STATES);
+}
+
+/*
+ * Return B_TRUE if blocks have been allocated from the metaslab in any of
+ * the txgs that have yet to sync.
+ */
+static boolean_t
+vdev_rebuild_ms_allocating(metaslab_t *msp)
+{
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+
+	for (int t = 0; t < TXG_SIZE; t++) {
+		if (range_tree_space(msp->ms_allocating[t]) != 0)
+			return (B_TRUE);
+	}
+	return (B_FALSE);
+}
+
+static void
+vdev_rebuild_thread(void *arg)
+{
+	vdev_t *vd = arg;
+	spa_t *spa = vd->vdev_spa;
+	vdev_rebuild_t *vr = &vd->vdev_rebuild_config;
+	vdev_rebuild_phys_t *vrp = &vr->vr_rebuild_phys;
+	int error = 0;
+
+	ASSERT3P(vd->vdev_ops, ==, &vdev_draid_ops);
+
+	/*
+	 * Wait for the new children's DTLs, and for any blocks that were
+	 * dmu_sync()ed before they were attached, to reach disk; the
+	 * allocated space we scan below then includes every block they
+	 * are missing.
+	 */
+	txg_wait_synced(spa_get_dsl(spa), vrp->vrp_max_txg +
+	    TXG_CONCURRENT_STATES);
+
+	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+
+	vr->vr_top_vdev = vd;
+	vr->vr_scan_tree = range_tree_create(NULL, RANGE_SEG64, NULL, 0, 0);
+	vr->vr_bytes_inflight_max = MAX(zfs_rebuild_max_segment,
+	    zfs_rebuild_vdev_limit * vd->vdev_children);
+
+	for (uint64_t i = 0; i < vd->vdev_ms_count; i++) {
+		boolean_t unload_when_done = B_FALSE;
+
+		if (vd->vdev_rebuild_exit_wanted || vdev_is_dead(vd)) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+
+		if (vd->vdev_rebuild_reset_wanted) {
+			spa_config_exit(spa, SCL_CONFIG, FTAG);
+			vdev_rebuild_reset(vd);
+			spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+			i = 0;
+		}
+
+		metaslab_t *msp = vd->vdev_ms[i];
+
+		/* Skip metaslabs rebuilt before the pool was exported. */
+		if (msp->ms_start + msp->ms_size <= vrp->vrp_last_offset)
+			continue;
+
+		spa_config_exit(spa, SCL_CONFIG, FTAG);
+		metaslab_disable(msp);
+		mutex_enter(&msp->ms_lock);
+
+		/*
+		 * Disabling the metaslab stops any further allocations from
+		 * it, but blocks allocated from it in the open txgs may not
+		 * have been written yet.  Wait for those txgs to sync before
+		 * copying the metaslab, so that we don't copy the space
+		 * before the blocks in it reach the existing children.
+		 */
+		while (vdev_rebuild_ms_allocating(msp)) {
+			mutex_exit(&msp->ms_lock);
+			txg_wait_synced(spa_get_dsl(spa), 0);
+			mutex_enter(&msp->ms_lock);
+		}
+
+		if (!msp->ms_loaded && !msp->ms_loading)
+			unload_when_done = B_TRUE;
+		VERIFY0(metaslab_load(msp));
+
+		/* Everything that isn't free needs to be rebuilt. */
+		range_tree_add(vr->vr_scan_tree, msp->ms_start, msp->ms_size);
+		range_tree_walk(msp->ms_allocatable, range_tree_remove,
+		    vr->vr_scan_tree);
+		mutex_exit(&msp->ms_lock);
+
+		if (vrp->vrp_last_offset > msp->ms_start) {
+			range_tree_clear(vr->vr_scan_tree, msp->ms_start,
+			    vrp->vrp_last_offset - msp->ms_start);
+		}
+
+		error = vdev_rebuild_ranges(vr);
+		metaslab_enable(msp, B_FALSE, unload_when_done);
+		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+
+		range_tree_vacate(vr->vr_scan_tree, NULL, NULL);
+
+		/* A reset is handled at the top of the next iteration. */
+		if (error != 0 && vd->vdev_rebuild_reset_wanted) {
+			error = 0;
+			continue;
+		}
+		if (error != 0)
+			break;
+	}
+
+	spa_config_exit(spa, SCL_CONFIG, FTAG);
+
+	mutex_enter(&vr->vr_io_lock);
+	while (vr->vr_bytes_inflight > 0)
+		cv_wait(&vr->vr_io_cv, &vr->vr_io_lock);
+	mutex_exit(&vr->vr_io_lock);
+
+	range_tree_destroy(vr->vr_scan_tree);
+	vr->vr_scan_tree = NULL;
+
+	if (error == 0 && !vd->vdev_rebuild_exit_wanted) {
+		uint64_t *guid = kmem_zalloc(sizeof (uint64_t), KM_SLEEP);
+		*guid = vd->vdev_guid;
+
+		dmu_tx_t *tx = dmu_tx_create_dd(spa_get_dsl(spa)->dp_mos_dir);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		dsl_sync_task_nowait(spa_get_dsl(spa),
+		    vdev_rebuild_complete_sync, guid, 2,
+		    ZFS_SPACE_CHECK_NONE, tx);
+		dmu_tx_commit(tx);
+	}
+
+	/*
+	 * As in vdev_initialize_thread(), don't hold vdev_rebuild_lock
+	 * while the final state is synced out.
+	 */
+	txg_wait_synced(spa_get_dsl(spa), 0);
+
+	mutex_enter(&vd->vdev_rebuild_lock);
+	vd->vdev_rebuilding = B_FALSE;
+	vd->vdev_rebuild_thread = NULL;
+	cv_broadcast(&vd->vdev_rebuild_cv);
+	mutex_exit(&vd->vdev_rebuild_lock);
+}
+
+/*
+ * Start a sequential rebuild of the top-level dRAID vdev tvd, or restart
+ * the one in progress so that it covers a newly attached child.  Called
+ * from spa_vdev_attach() with the new child's DTL already set.
+ */
+void
+vdev_rebuild(vdev_t *tvd)
+{
+	spa_t *spa = tvd->vdev_spa;
+
+	ASSERT(MUTEX_HELD(&spa_namespace_lock));
+	ASSERT3P(tvd, ==, tvd->vdev_top);
+	ASSERT3P(tvd->vdev_ops, ==, &vdev_draid_ops);
+
+	mutex_enter(&tvd->vdev_rebuild_lock);
+	if (tvd->vdev_rebuilding) {
+		tvd->vdev_rebuild_reset_wanted = B_TRUE;
+		mutex_exit(&tvd->vdev_rebuild_lock);
+		return;
+	}
+	tvd->vdev_rebuilding = B_TRUE;
+	mutex_exit(&tvd->vdev_rebuild_lock);
+
+	dmu_tx_t *tx = dmu_tx_create_dd(spa_get_dsl(spa)->dp_mos_dir);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	dsl_sync_task_nowait(spa_get_dsl(spa), vdev_rebuild_initiate_sync,
+	    tvd, 2, ZFS_SPACE_CHECK_NONE, tx);
+	dmu_tx_commit(tx);
+}
+
+boolean_t
+vdev_rebuild_active(vdev_t *tvd)
+{
+	boolean_t ret;
+
+	mutex_enter(&tvd->vdev_rebuild_lock);
+	ret = tvd->vdev_rebuilding;
+	mutex_exit(&tvd->vdev_rebuild_lock);
+
+	return (ret);
+}
+
+/*
+ * Stop all rebuild threads, leaving their on-disk state active so that
+ * they are restarted by vdev_rebuild_restart() on the next import.
+ */
+void
+vdev_rebuild_stop_all(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	ASSERT(MUTEX_HELD(&spa_namespace_lock));
+
+	for (uint64_t i = 0; i < rvd->vdev_children; i++) {
+		vdev_t *tvd = rvd->vdev_child[i];
+
+		mutex_enter(&tvd->vdev_rebuild_lock);
+		if (tvd->vdev_rebuilding) {
+			tvd->vdev_rebuild_exit_wanted = B_TRUE;
+			while (tvd->vdev_rebuilding)
+				cv_wait(&tvd->vdev_rebuild_cv,
+				    &tvd->vdev_rebuild_lock);
+			tvd->vdev_rebuild_exit_wanted = B_FALSE;
+		}
+		mutex_exit(&tvd->vdev_rebuild_lock);
+	}
+
+	if (spa->spa_sync_on) {
+		/* Make sure that our state has been synced to disk */
+		txg_wait_synced(spa_get_dsl(spa), 0);
+	}
+}
+
+/*
+ * Load the rebuild state of every top-level vdev and resume any rebuild
+ * that was active when the pool was last exported.
+ */
+void
+vdev_rebuild_restart(spa_t *spa)
+{
+	vdev_t *rvd = spa->spa_root_vdev;
+
+	ASSERT(MUTEX_HELD(&spa_namespace_lock));
+
+	for (uint64_t i = 0; i < rvd->vdev_children; i++) {
+		vdev_t *tvd = rvd->vdev_child[i];
+		vdev_rebuild_phys_t *vrp =
+		    &tvd->vdev_rebuild_config.vr_rebuild_phys;
+
+		if (tvd->vdev_top_zap == 0 || tvd->vdev_ops != &vdev_draid_ops)
+			continue;
+
+		mutex_enter(&tvd->vdev_rebuild_lock);
+		int err = zap_lookup(spa->spa_meta_objset, tvd->vdev_top_zap,
+		    VDEV_TOP_ZAP_REBUILD_PHYS, sizeof (uint64_t),
+		    REBUILD_PHYS_ENTRIES, vrp);
+		ASSERT(err == 0 || err == ENOENT);
+		if (err != 0)
+			bzero(vrp, sizeof (*vrp));
+
+		if (vrp->vrp_rebuild_state == VDEV_REBUILD_ACTIVE &&
+		    spa_writeable(spa) && !vdev_is_dead(tvd) &&
+		    tvd->vdev_rebuild_thread == NULL) {
+			tvd->vdev_rebuilding = B_TRUE;
+			tvd->vdev_rebuild_thread = thread_create(NULL, 0,
+			    vdev_rebuild_thread, tvd, 0, &p0, TS_RUN,
+			    maxclsyspri);
+		}
+		mutex_exit(&tvd->vdev_rebuild_lock);
+	}
+}
+
+/*
+ * Report rebuild progress for a top-level vdev.  Caller holds
+ * vdev_stat_lock.
+ */
+void
+vdev_rebuild_get_stats(vdev_t *tvd, vdev_stat_t *vs)
+{
+	vdev_rebuild_phys_t *vrp = &tvd->vdev_rebuild_config.vr_rebuild_phys;
+
+	ASSERT3P(tvd, ==, tvd->vdev_top);
+
+	if (tvd->vdev_ops != &vdev_draid_ops)
+		return;
+
+	mutex_enter(&tvd->vdev_rebuild_lock);
+	vs->vs_rebuild_state = vrp->vrp_rebuild_state;
+	vs->vs_rebuild_bytes_done = vrp->vrp_bytes_rebuilt;
+	vs->vs_rebuild_bytes_est = vrp->vrp_bytes_est;
+	vs->vs_rebuild_action_time =
+	    vrp->vrp_rebuild_state == VDEV_REBUILD_COMPLETE ?
+	    vrp->vrp_end_time : vrp->vrp_start_time;
+	mutex_exit(&tvd->vdev_rebuild_lock);
+}
@@ -1796,6 +1796,7 @@ zfs_ioc_pool_tryimport(zfs_cmd_t *zc)
  * zc_name              name of the pool
  * zc_cookie            scan func (pool_scan_func_t)
  * zc_flags             scrub pause/resume flag (pool_scrub_cmd_t)
+ * zc_createtxg         if not zero, only scrub blocks born in or after it
  */
 static int
 zfs_ioc_pool_scan(zfs_cmd_t *zc)
@@ -1814,7 +1815,7 @@ zfs_ioc_pool_scan(zfs_cmd_t *zc)
 	else if (zc->zc_cookie == POOL_SCAN_NONE)
 		error = spa_scan_stop(spa);
 	else
-		error = spa_scan(spa, zc->zc_cookie);
+		error = spa_scan_txg(spa, zc->zc_cookie, zc->zc_createtxg);
 
 	spa_close(spa, FTAG);
 
@@ -2451,6 +2452,192 @@ zfs_ioc_snapshot_list_next(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Limits on one ZFS_IOC_LIST_BATCH call.  The pool configuration lock is
+ * held for the whole batch, so it must stay short; and the packed output is
+ * kept within the destination buffer that libzfs_core allocates by default,
+ * so that a batch rarely has to be redone with a larger one.
+ */
+#define	ZFS_LIST_BATCH_MAX	1024
+#define	ZFS_LIST_BATCH_BYTES	(96 * 1024)
+
+/*
+ * Gathers the objset stats and the properties of one dataset for
+ * ZFS_IOC_LIST_BATCH, as ZFS_IOC_OBJSET_STATS would.  If "wanted" is given,
+ * the native properties not named in it are left out; user properties are
+ * always returned, as zfs_prune_proplist() keeps them too.
+ */
+static int
+zfs_list_batch_stats(objset_t *os, nvlist_t *wanted, nvlist_t *entry)
+{
+	dmu_objset_stats_t stats;
+	nvpair_t *pair, *next;
+	nvlist_t *nv;
+	int error;
+
+	dmu_objset_fast_stat(os, &stats);
+	if ((error = dsl_prop_get_all(os, &nv)) != 0)
+		return (error);
+	dmu_objset_stats(os, nv);
+
+	/* See the comment in zfs_ioc_objset_stats_impl() */
+	if (!stats.dds_inconsistent && dmu_objset_type(os) == DMU_OST_ZVOL &&
+	    (wanted == NULL ||
+	    nvlist_exists(wanted, zfs_prop_to_name(ZFS_PROP_VOLSIZE)) ||
+	    nvlist_exists(wanted, zfs_prop_to_name(ZFS_PROP_VOLBLOCKSIZE)))) {
+		error = zvol_get_stats(os, nv);
+		if (error == EIO) {
+			nvlist_free(nv);
+			return (error);
+		}
+		VERIFY0(error);
+	}
+
+	for (pair = nvlist_next_nvpair(nv, NULL); wanted != NULL &&
+	    pair != NULL; pair = next) {
+		next = nvlist_next_nvpair(nv, pair);
+		if (zfs_name_to_prop(nvpair_name(pair)) != ZPROP_INVAL &&
+		    !nvlist_exists(wanted, nvpair_name(pair)))
+			fnvlist_remove_nvpair(nv, pair);
+	}
+
+	fnvlist_add_uint8_array(entry, "stats", (uint8_t *)&stats,
+	    sizeof (stats));
+	fnvlist_add_nvlist(entry, "props", nv);
+	nvlist_free(nv);
+	return (0);
+}
+
+/*
+ * innvl: {
+ *     "snapshots" -> (optional) list the snapshots rather than the children
+ *     "simple" -> (optional) only return the names
+ *     "cursor" -> (optional) uint64, where a previous batch stopped
+ *     "count" -> (optional) uint64, maximum number of datasets to return
+ *     "props" -> (optional) { property 1, property 2, ... }
+ * }
+ *
+ * outnvl: {
+ *     "datasets" -> {
+ *         dataset name 1 -> {
+ *             "stats" -> uint8 array (dmu_objset_stats_t)
+ *             "props" -> { property 1, property 2, ... }
+ *         },
+ *         dataset name 2 -> ...
+ *     }
+ *     "cursor" -> uint64, absent once the list is complete
+ * }
+ *
+ * Returns a batch of the child datasets or the snapshots of the dataset, in
+ * the order in which ZFS_IOC_DATASET_LIST_NEXT or ZFS_IOC_SNAPSHOT_LIST_NEXT
+ * would return them one by one, each with what ZFS_IOC_OBJSET_STATS returns.
+ * The batch stops at the limits above; the caller passes the cursor back
+ * to get the next one.
+ */
+static const zfs_ioc_key_t zfs_keys_list_batch[] = {
+	{"snapshots",	DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{"simple",	DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{"cursor",	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{"count",	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{"props",	DATA_TYPE_NVLIST,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_list_batch(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	boolean_t snapshots = nvlist_exists(innvl, "snapshots");
+	boolean_t simple = nvlist_exists(innvl, "simple");
+	uint64_t cursor = 0, count = ZFS_LIST_BATCH_MAX;
+	char name[ZFS_MAX_DATASET_NAME_LEN];
+	nvlist_t *wanted = NULL, *datasets;
+	size_t len, bytes = 0;
+	dsl_pool_t *dp;
+	objset_t *os;
+	int error;
+
+	(void) nvlist_lookup_uint64(innvl, "cursor", &cursor);
+	(void) nvlist_lookup_uint64(innvl, "count", &count);
+	(void) nvlist_lookup_nvlist(innvl, "props", &wanted);
+	if (count == 0)
+		return (SET_ERROR(EINVAL));
+	count = MIN(count, ZFS_LIST_BATCH_MAX);
+
+	error = dmu_objset_hold(fsname, FTAG, &os);
+	if (error != 0)
+		return (error);
+	dp = dmu_objset_pool(os);
+
+	/*
+	 * A dataset name of maximum length cannot have any children or
+	 * snapshots; the list is empty.
+	 */
+	(void) strlcpy(name, fsname, sizeof (name));
+	len = strlcat(name, snapshots ? "@" : "/", sizeof (name));
+	error = (len >= sizeof (name)) ? SET_ERROR(ENOENT) : 0;
+
+	datasets = fnvlist_alloc();
+	while (error == 0 && count > 0 && bytes < ZFS_LIST_BATCH_BYTES) {
+		nvlist_t *entry;
+		dsl_dataset_t *ds;
+		objset_t *osnext;
+		uint64_t obj;
+
+		if (snapshots) {
+			error = dmu_snapshot_list_next(os, sizeof (name) - len,
+			    name + len, &obj, &cursor, NULL);
+		} else {
+			error = dmu_dir_list_next(os, sizeof (name) - len,
+			    name + len, NULL, &cursor);
+			if (error == 0 && dataset_name_hidden(name))
+				continue;
+		}
+		if (error != 0)
+			break;
+
+		entry = fnvlist_alloc();
+		if (!simple) {
+			if (snapshots) {
+				error = dsl_dataset_hold_obj(dp, obj, FTAG,
+				    &ds);
+			} else {
+				error = dsl_dataset_hold(dp, name, FTAG, &ds);
+			}
+			if (error == 0) {
+				error = dmu_objset_from_ds(ds, &osnext);
+				if (error == 0) {
+					error = zfs_list_batch_stats(osnext,
+					    wanted, entry);
+				}
+				dsl_dataset_rele(ds, FTAG);
+			}
+			if (error == ENOENT) {
+				/* We lost a race with destroy, skip it. */
+				nvlist_free(entry);
+				error = 0;
+				continue;
+			}
+		}
+		if (error == 0) {
+			bytes += fnvlist_size(entry) + strlen(name);
+			fnvlist_add_nvlist(datasets, name, entry);
+			count--;
+		}
+		nvlist_free(entry);
+	}
+	dmu_objset_rele(os, FTAG);
+
+	if (error == ENOENT) {
+		/* The end of the list */
+		error = 0;
+	} else if (error == 0) {
+		fnvlist_add_uint64(outnvl, "cursor", cursor);
+	}
+	if (error == 0)
+		fnvlist_add_nvlist(outnvl, "datasets", datasets);
+	nvlist_free(datasets);
+	return (error);
+}
+
 static int
 zfs_prop_set_userquota(const char *dsname, nvpair_t *pair)
 {
@@ -6759,6 +6946,11 @@ zfs_ioctl_init(void)
 	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
 	    zfs_keys_get_bookmarks, ARRAY_SIZE(zfs_keys_get_bookmarks));
 
+	zfs_ioctl_register("list_batch", ZFS_IOC_LIST_BATCH,
+	    zfs_ioc_list_batch, zfs_secpolicy_read, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_list_batch, ARRAY_SIZE(zfs_keys_list_batch));
+
 	zfs_ioctl_register("destroy_bookmarks", ZFS_IOC_DESTROY_BOOKMARKS,
 	    zfs_ioc_destroy_bookmarks, zfs_secpolicy_destroy_bookmarks,
 	    POOL_NAME,
@@ -488,7 +488,12 @@ zfs_log_write(zilog_t *zilog, dmu_tx_t *tx, int txtype,
 	if (zil_replaying(zilog, tx) || zp->z_unlinked)
 		return;
 
-	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT)
+	/*
+	 * A direct write (FDIRECT) has already put its blocks on disk, so
+	 * logging them indirectly costs nothing; see dmu_sync().
+	 */
+	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT ||
+	    (ioflag & FDIRECT))
 		write_state = WR_INDIRECT;
 	else if (!spa_has_slogs(zilog->zl_spa) &&
 	    resid >= zfs_immediate_write_sz)
@@ -567,6 +572,47 @@ zfs_log_truncate(zilog_t *zilog, dmu_tx_t *tx, int txtype,
 	zil_itx_assign(zilog, itx, tx);
 }
 
+/*
+ * Handles TX_CLONE_RANGE transactions.  The range is split into as many
+ * records as needed to keep each one within a log block.
+ */
+void
+zfs_log_clone_range(zilog_t *zilog, dmu_tx_t *tx, int txtype, znode_t *zp,
+    uint64_t off, uint64_t len, uint64_t blksz, const blkptr_t *bps,
+    size_t nbps)
+{
+	size_t maxnbps = (ZIL_MAX_LOG_DATA - sizeof (lr_clone_range_t)) /
+	    sizeof (blkptr_t);
+	itx_t *itx;
+	lr_clone_range_t *lr;
+
+	if (zil_replaying(zilog, tx) || zp->z_unlinked)
+		return;
+
+	while (nbps > 0) {
+		size_t partnbps = MIN(nbps, maxnbps);
+		uint64_t partlen = MIN(partnbps * blksz, len);
+
+		itx = zil_itx_create(txtype, sizeof (*lr) +
+		    partnbps * sizeof (blkptr_t));
+		lr = (lr_clone_range_t *)&itx->itx_lr;
+		lr->lr_foid = zp->z_id;
+		lr->lr_offset = off;
+		lr->lr_length = partlen;
+		lr->lr_blksz = blksz;
+		lr->lr_nbps = partnbps;
+		bcopy(bps, lr->lr_bps, partnbps * sizeof (blkptr_t));
+
+		itx->itx_sync = (zp->z_sync_cnt != 0);
+		zil_itx_assign(zilog, itx, tx);
+
+		bps += partnbps;
+		nbps -= partnbps;
+		off += partlen;
+		len -= partlen;
+	}
+}
+
 /*
  * Handles TX_SETATTR transactions.
  */
@@ -385,6 +385,14 @@ vscan_changed_cb(void *arg, uint64_t newval)
 	zfsvfs->z_vscan = newval;
 }
 
+static void
+direct_changed_cb(void *arg, uint64_t newval)
+{
+	zfsvfs_t *zfsvfs = arg;
+
+	zfsvfs->z_direct = newval;
+}
+
 static void
 acl_mode_changed_cb(void *arg, uint64_t newval)
 {
@@ -538,6 +546,8 @@ zfs_register_callbacks(vfs_t *vfsp)
 	    zfsvfs);
 	error = error ? error : dsl_prop_register(ds,
 	    zfs_prop_to_name(ZFS_PROP_VSCAN), vscan_changed_cb, zfsvfs);
+	error = error ? error : dsl_prop_register(ds,
+	    zfs_prop_to_name(ZFS_PROP_DIRECT), direct_changed_cb, zfsvfs);
 	dsl_pool_config_exit(dmu_objset_pool(os), FTAG);
 	if (error)
 		goto unregister;
@@ -63,6 +63,7 @@
 #include <sys/fs/zfs.h>
 #include <sys/dmu.h>
 #include <sys/dmu_objset.h>
+#include <sys/dmu_impl.h>
 #include <sys/spa.h>
 #include <sys/txg.h>
 #include <sys/dbuf.h>
@@ -86,6 +87,7 @@
 #include <sys/zil.h>
 #include <sys/sa_impl.h>
 #include <sys/zfs_project.h>
+#include <sys/zfeature.h>
 
 /*
  * Programming rules.
@@ -380,41 +382,40 @@ zfs_ioctl(vnode_t *vp, int com, intptr_t data, int flag, cred_t *cred,
 	case _FIODIRECTIO:
 	{
 		/*
-		 * ZFS inherently provides the basic semantics for directio.
-		 * This is the summary from the ZFS on Linux support for
-		 * O_DIRECT, which is the common form of directio, and required
-		 * no changes to ZFS.
+		 * directio(3C) and O_DIRECT ask for I/O that bypasses the
+		 * ARC.  With DIRECTIO_ON set, reads and writes of whole,
+		 * aligned blocks go straight between a single kernel copy of
+		 * the data and the disk (see dmu_read_uio_direct() and
+		 * dmu_write_direct()); the copy cannot be avoided because the
+		 * data must stay stable while it is checksummed, compressed
+		 * and written.  Everything else, including any request that
+		 * is not block aligned, is served from the ARC as usual.
 		 *
-		 * 1. Minimize cache effects of the I/O.
-		 *
-		 *    By design the ARC is already scan-resistant, which helps
-		 *    mitigate the need for special O_DIRECT handling.
-		 *
-		 * 2. O_DIRECT _MAY_ impose restrictions on IO alignment and
-		 *    length.
-		 *
-		 *    No additional alignment or length restrictions are
-		 *    imposed by ZFS.
-		 *
-		 * 3. O_DIRECT _MAY_ perform unbuffered IO operations directly
-		 *    between user memory and block device.
-		 *
-		 *    No unbuffered IO operations are currently supported. In
-		 *    order to support features such as compression, encryption,
-		 *    and checksumming a copy must be made to transform the
-		 *    data.
-		 *
-		 * 4. O_DIRECT _MAY_ imply O_DSYNC (XFS).
-		 *
-		 *    O_DIRECT does not imply O_DSYNC for ZFS.
-		 *
-		 * 5. O_DIRECT _MAY_ disable file locking that serializes IO
-		 *    operations.
-		 *
-		 *    All I/O in ZFS is locked for correctness and this locking
-		 *    is not disabled by O_DIRECT.
+		 * Direct I/O does not imply O_DSYNC, and all the usual range
+		 * locking still applies.  The "direct" dataset property can
+		 * force the behavior on or off for every file.
 		 */
-		return (0);
+		zp = VTOZ(vp);
+		zfsvfs = zp->z_zfsvfs;
+		ZFS_ENTER(zfsvfs);
+		ZFS_VERIFY_ZP(zp);
+
+		switch (data) {
+		case DIRECTIO_ON:
+			zp->z_directio = 1;
+			error = 0;
+			break;
+		case DIRECTIO_OFF:
+			zp->z_directio = 0;
+			error = 0;
+			break;
+		default:
+			error = SET_ERROR(EINVAL);
+			break;
+		}
+
+		ZFS_EXIT(zfsvfs);
+		return (error);
 	}
 
 	case _FIO_SEEK_DATA:
@@ -476,6 +477,34 @@ zfs_ioctl(vnode_t *vp, int com, intptr_t data, int flag, cred_t *cred,
 			return (SET_ERROR(EFAULT));
 		return (0);
 	}
+	case _FIO_CLONE_RANGE:
+	{
+		fio_clone_range_t fcr;
+		file_t *fp;
+
+		if (ddi_copyin((void *)data, &fcr, sizeof (fcr), flag))
+			return (SET_ERROR(EFAULT));
+		if ((flag & FWRITE) == 0)
+			return (SET_ERROR(EBADF));
+		if (fcr.fcr_src_fd < 0 || fcr.fcr_src_fd > INT_MAX)
+			return (SET_ERROR(EBADF));
+
+		if ((fp = getf((int)fcr.fcr_src_fd)) == NULL)
+			return (SET_ERROR(EBADF));
+		if ((fp->f_flag & FREAD) == 0) {
+			error = SET_ERROR(EBADF);
+		} else if (fp->f_vnode->v_type != VREG || vp->v_type != VREG) {
+			error = SET_ERROR(EINVAL);
+		} else if (vn_getops(fp->f_vnode) != vn_getops(vp)) {
+			error = SET_ERROR(EXDEV);
+		} else {
+			error = zfs_clone_range(VTOZ(fp->f_vnode),
+			    fcr.fcr_src_offset, VTOZ(vp), fcr.fcr_dest_offset,
+			    fcr.fcr_src_length, cred);
+		}
+		releasef((int)fcr.fcr_src_fd);
+		return (error);
+	}
 	case ZFS_IOC_FSGETXATTR:
 		return (zfs_ioctl_getxattr(vp, data, flag, cred, ct));
 	case ZFS_IOC_FSSETXATTR:
@@ -585,6 +614,25 @@ mappedread(vnode_t *vp, int nbytes, uio_t *uio)
 
 offset_t zfs_read_chunk_size = 1024 * 1024; /* Tunable */
 
+/*
+ * Should I/O to this file bypass the ARC where it can?  That is the case
+ * if the "direct" property says so, or if the file was opened with
+ * O_DIRECT or directio(3C) was enabled on it.  Files that are mapped are
+ * always served from the page cache and the ARC, so that the pages stay
+ * coherent with the file.
+ */
+static boolean_t
+zfs_use_direct(znode_t *zp)
+{
+	zfsvfs_t *zfsvfs = zp->z_zfsvfs;
+
+	if (zfsvfs->z_direct == ZFS_DIRECT_DISABLED ||
+	    vn_has_cached_data(ZTOV(zp)))
+		return (B_FALSE);
+
+	return (zfsvfs->z_direct == ZFS_DIRECT_ALWAYS || zp->z_directio);
+}
+
 /*
  * Read bytes from specified file into supplied buffer.
  *
@@ -717,6 +765,11 @@ zfs_read(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 
 		if (vn_has_cached_data(vp)) {
 			error = mappedread(vp, nbytes, uio);
+		} else if (xuio == NULL && zfs_use_direct(zp) &&
+		    dmu_direct_io_ok(sa_get_db(zp->z_sa_hdl),
+		    uio->uio_loffset, nbytes)) {
+			error = dmu_read_uio_direct(sa_get_db(zp->z_sa_hdl),
+			    uio, nbytes);
 		} else {
 			error = dmu_read_uio_dbuf(sa_get_db(zp->z_sa_hdl),
 			    uio, nbytes);
@@ -922,6 +975,7 @@ zfs_write(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 		}
 
 		arc_buf_t *abuf = NULL;
+		boolean_t direct = B_FALSE;
 		if (xuio) {
 			ASSERT(i_iov < iovcnt);
 			aiov = &iovp[i_iov];
@@ -933,6 +987,27 @@ zfs_write(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 			    ((char *)aiov->iov_base - (char *)abuf->b_data +
 			    aiov->iov_len == arc_buf_size(abuf)));
 			i_iov++;
+		} else if (n >= max_blksz && P2PHASE(woff, max_blksz) == 0 &&
+		    zp->z_blksz == max_blksz && zfs_use_direct(zp) &&
+		    dmu_direct_io_ok(sa_get_db(zp->z_sa_hdl), woff,
+		    max_blksz)) {
+			/*
+			 * Direct write of a full block.  The data is copied
+			 * into a borrowed buffer before entering the
+			 * transaction, as below, but is then written straight
+			 * to disk instead of being handed to the ARC.
+			 */
+			size_t cbytes;
+
+			abuf = dmu_request_arcbuf(sa_get_db(zp->z_sa_hdl),
+			    max_blksz);
+			if (error = uiocopy(abuf->b_data, max_blksz,
+			    UIO_WRITE, uio, &cbytes)) {
+				dmu_return_arcbuf(abuf);
+				break;
+			}
+			ASSERT(cbytes == max_blksz);
+			direct = B_TRUE;
 		} else if (n >= max_blksz && woff >= zp->z_size &&
 		    P2PHASE(woff, max_blksz) == 0 &&
 		    zp->z_blksz == max_blksz) {
@@ -1003,7 +1078,14 @@ zfs_write(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 		 */
 		nbytes = MIN(n, max_blksz - P2PHASE(woff, max_blksz));
 
-		if (abuf == NULL) {
+		if (direct) {
+			tx_bytes = nbytes;
+			ASSERT3S(tx_bytes, ==, max_blksz);
+			dmu_write_direct(sa_get_db(zp->z_sa_hdl), woff,
+			    tx_bytes, abuf->b_data, tx);
+			dmu_return_arcbuf(abuf);
+			uioskip(uio, tx_bytes);
+		} else if (abuf == NULL) {
 			tx_bytes = uio->uio_resid;
 			error = dmu_write_uio_dbuf(sa_get_db(zp->z_sa_hdl),
 			    uio, nbytes, tx);
@@ -1100,7 +1182,8 @@ zfs_write(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 		prev_error = error;
 		error = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
 
-		zfs_log_write(zilog, tx, TX_WRITE, zp, woff, tx_bytes, ioflag);
+		zfs_log_write(zilog, tx, TX_WRITE, zp, woff, tx_bytes,
+		    direct ? (ioflag | FDIRECT) : ioflag);
 		dmu_tx_commit(tx);
 
 		if (prev_error != 0 || error != 0)
@@ -1131,6 +1214,342 @@ zfs_write(vnode_t *vp, uio_t *uio, int ioflag, cred_t *cr, caller_context_t *ct)
 	return (0);
 }
 
+/*
+ * Lock the source range of a clone for reading and the destination range
+ * for writing, or the whole destination file if its block size is to be
+ * changed.  Two files are always locked in the same order, by object
+ * number, so that clones running in opposite directions cannot deadlock;
+ * a clone within one file takes a single lock spanning both ranges.
+ */
+static void
+zfs_clone_range_lock(znode_t *inzp, uint64_t inoff, znode_t *outzp,
+    uint64_t outoff, uint64_t len, boolean_t whole, locked_range_t **inlrp,
+    locked_range_t **outlrp)
+{
+	uint64_t off, end, outlen;
+
+	if (inzp == outzp) {
+		off = whole ? 0 : MIN(inoff, outoff);
+		end = whole ? UINT64_MAX : MAX(inoff, outoff) + len;
+		*inlrp = NULL;
+		*outlrp = rangelock_enter(&outzp->z_rangelock, off, end - off,
+		    RL_WRITER);
+		return;
+	}
+
+	off = whole ? 0 : outoff;
+	outlen = whole ? UINT64_MAX : len;
+	if (inzp->z_id < outzp->z_id ||
+	    (inzp->z_id == outzp->z_id && (uintptr_t)inzp < (uintptr_t)outzp)) {
+		*inlrp = rangelock_enter(&inzp->z_rangelock, inoff, len,
+		    RL_READER);
+		*outlrp = rangelock_enter(&outzp->z_rangelock, off, outlen,
+		    RL_WRITER);
+	} else {
+		*outlrp = rangelock_enter(&outzp->z_rangelock, off, outlen,
+		    RL_WRITER);
+		*inlrp = rangelock_enter(&inzp->z_rangelock, inoff, len,
+		    RL_READER);
+	}
+}
+
+static void
+zfs_clone_range_unlock(locked_range_t *inlr, locked_range_t *outlr)
+{
+	rangelock_exit(outlr);
+	if (inlr != NULL)
+		rangelock_exit(inlr);
+}
+
+/*
+ * Clone a range of one file into another (or into a different range of
+ * the same file) by making the destination refer to the source's blocks.
+ * No data is copied; the blocks are shared through the pool's block
+ * reference table until either copy is overwritten or freed.
+ *
+ * Both files must live in the same pool, and in the same dataset if it is
+ * encrypted.  The offsets and length must be multiples of the source's
+ * block size, except that the length may end at the source's EOF if that
+ * does not leave data of the destination beyond the cloned range.  The
+ * destination's block size must match, or be changeable because it holds
+ * at most one block.
+ */
+int
+zfs_clone_range(znode_t *inzp, uint64_t inoff, znode_t *outzp,
+    uint64_t outoff, uint64_t len, cred_t *cr)
+{
+	zfsvfs_t	*inzfsvfs = inzp->z_zfsvfs;
+	zfsvfs_t	*outzfsvfs = outzp->z_zfsvfs;
+	objset_t	*inos, *outos;
+	zilog_t		*zilog;
+	locked_range_t	*inlr, *outlr;
+	dmu_tx_t	*tx;
+	blkptr_t	*bps;
+	size_t		maxblocks, nbps;
+	uint64_t	inblksz, size, outsize;
+	uint64_t	mtime[2], ctime[2];
+	boolean_t	whole = B_FALSE;
+	sa_bulk_attr_t	bulk[3];
+	int		count = 0;
+	int		error = 0;
+
+	ZFS_ENTER(inzfsvfs);
+	ZFS_VERIFY_ZP(inzp);
+	if (outzfsvfs != inzfsvfs) {
+		rrm_enter_read(&outzfsvfs->z_teardown_lock, FTAG);
+		if (outzfsvfs->z_unmounted) {
+			ZFS_EXIT(outzfsvfs);
+			ZFS_EXIT(inzfsvfs);
+			return (SET_ERROR(EIO));
+		}
+	}
+	if (outzp->z_sa_hdl == NULL) {
+		error = SET_ERROR(EIO);
+		goto out;
+	}
+
+	inos = inzfsvfs->z_os;
+	outos = outzfsvfs->z_os;
+	zilog = outzfsvfs->z_log;
+
+	if (dmu_objset_spa(inos) != dmu_objset_spa(outos)) {
+		error = SET_ERROR(EXDEV);
+		goto out;
+	}
+	if (!spa_feature_is_enabled(dmu_objset_spa(outos),
+	    SPA_FEATURE_BLOCK_CLONING)) {
+		error = SET_ERROR(ENOTSUP);
+		goto out;
+	}
+	/*
+	 * Encrypted blocks can only be read with the key of the dataset
+	 * that wrote them.
+	 */
+	if (inos != outos && (inos->os_encrypted || outos->os_encrypted)) {
+		error = SET_ERROR(EXDEV);
+		goto out;
+	}
+	if (outzfsvfs->z_vfs->vfs_flag & VFS_RDONLY) {
+		error = SET_ERROR(EROFS);
+		goto out;
+	}
+	if (outzp->z_pflags & (ZFS_IMMUTABLE | ZFS_APPENDONLY)) {
+		error = SET_ERROR(EPERM);
+		goto out;
+	}
+	if (len == 0)
+		goto out;
+	if (inoff + len < inoff || outoff + len < outoff ||
+	    outoff + len > MAXOFFSET_T) {
+		error = SET_ERROR(EFBIG);
+		goto out;
+	}
+	if (inzp == outzp && inoff < outoff + len && outoff < inoff + len) {
+		error = SET_ERROR(EINVAL);
+		goto out;
+	}
+
+	/*
+	 * Push any dirty mapped pages of the source into the DMU, and get
+	 * rid of the destination's pages, which are about to go stale.
+	 */
+	if (vn_has_cached_data(ZTOV(inzp)))
+		(void) VOP_PUTPAGE(ZTOV(inzp), inoff, len, 0, cr, NULL);
+	if (vn_has_cached_data(ZTOV(outzp)))
+		(void) VOP_PUTPAGE(ZTOV(outzp), outoff, len, B_INVAL, cr, NULL);
+
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(outzfsvfs), NULL,
+	    &mtime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(outzfsvfs), NULL,
+	    &ctime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_SIZE(outzfsvfs), NULL,
+	    &outzp->z_size, 8);
+
+top:
+	zfs_clone_range_lock(inzp, inoff, outzp, outoff, len, whole, &inlr,
+	    &outlr);
+
+	inblksz = inzp->z_blksz;
+	if (outzp->z_blksz != inblksz && !whole) {
+		/* Changing the block size requires the whole file. */
+		zfs_clone_range_unlock(inlr, outlr);
+		whole = B_TRUE;
+		goto top;
+	}
+
+	if (inoff >= inzp->z_size)
+		goto unlock;
+	len = MIN(len, inzp->z_size - inoff);
+
+	if (outzp->z_blksz != inblksz &&
+	    (outzp->z_size > outzp->z_blksz || outzp->z_size > inblksz)) {
+		error = SET_ERROR(EINVAL);
+		goto unlock;
+	}
+	if (inoff % inblksz != 0 || outoff % inblksz != 0) {
+		error = SET_ERROR(EINVAL);
+		goto unlock;
+	}
+	if (len % inblksz != 0 &&
+	    (inoff + len != inzp->z_size || outoff + len < outzp->z_size)) {
+		error = SET_ERROR(EINVAL);
+		goto unlock;
+	}
+
+	maxblocks = DMU_MAX_ACCESS / inblksz;
+	bps = kmem_alloc(sizeof (blkptr_t) * maxblocks, KM_SLEEP);
+
+	while (len > 0) {
+		if (zfs_id_overblockquota(outzfsvfs, DMU_USERUSED_OBJECT,
+		    outzp->z_uid) ||
+		    zfs_id_overblockquota(outzfsvfs, DMU_GROUPUSED_OBJECT,
+		    outzp->z_gid) ||
+		    (outzp->z_projid != ZFS_DEFAULT_PROJID &&
+		    zfs_id_overblockquota(outzfsvfs, DMU_PROJECTUSED_OBJECT,
+		    outzp->z_projid))) {
+			error = SET_ERROR(EDQUOT);
+			break;
+		}
+
+		size = MIN(inblksz * maxblocks, len);
+		error = dmu_read_l0_bps(inos, inzp->z_id, inoff, size, bps,
+		    &nbps);
+		if (error == EAGAIN) {
+			/*
+			 * Some of the source blocks have not been written
+			 * out yet; only blocks on disk can be cloned.  Don't
+			 * hold up anyone else's I/O to the two ranges while
+			 * waiting for them, and start over afterwards.
+			 */
+			kmem_free(bps, sizeof (blkptr_t) * maxblocks);
+			zfs_clone_range_unlock(inlr, outlr);
+			txg_wait_synced(dmu_objset_pool(inos), 0);
+			goto top;
+		}
+		if (error != 0)
+			break;
+
+		tx = dmu_tx_create(outos);
+		dmu_tx_hold_sa(tx, outzp->z_sa_hdl, B_FALSE);
+		dmu_tx_hold_clone(tx, outzp->z_id, outoff, size);
+		zfs_sa_upgrade_txholds(tx, outzp);
+		error = dmu_tx_assign(tx, TXG_WAIT);
+		if (error != 0) {
+			dmu_tx_abort(tx);
+			break;
+		}
+
+		if (outzp->z_blksz != inblksz) {
+			error = dmu_object_set_blocksize(outos, outzp->z_id,
+			    inblksz, 0, tx);
+			if (error != 0) {
+				dmu_tx_commit(tx);
+				break;
+			}
+			outzp->z_blksz = inblksz;
+		}
+
+		dmu_brt_clone(outos, outzp->z_id, outoff, size, tx, bps, nbps);
+
+		zfs_tstamp_update_setup(outzp, CONTENT_MODIFIED, mtime, ctime,
+		    B_TRUE);
+		while ((outsize = outzp->z_size) < outoff + size) {
+			(void) atomic_cas_64(&outzp->z_size, outsize,
+			    outoff + size);
+		}
+		error = sa_bulk_update(outzp->z_sa_hdl, bulk, count, tx);
+
+		zfs_log_clone_range(zilog, tx, TX_CLONE_RANGE, outzp, outoff,
+		    size, inblksz, bps, nbps);
+
+		dmu_tx_commit(tx);
+		if (error != 0)
+			break;
+
+		inoff += size;
+		outoff += size;
+		len -= size;
+	}
+
+	kmem_free(bps, sizeof (blkptr_t) * maxblocks);
+
+unlock:
+	zfs_clone_range_unlock(inlr, outlr);
+out:
+	if (outzfsvfs != inzfsvfs)
+		ZFS_EXIT(outzfsvfs);
+	ZFS_EXIT(inzfsvfs);
+
+	return (error);
+}
+
+/*
+ * Replay a TX_CLONE_RANGE record.  The blocks are known to still be
+ * allocated because zil_claim() took a reference on them.
+ */
+int
+zfs_clone_range_replay(znode_t *zp, uint64_t off, uint64_t len,
+    uint64_t blksz, const blkptr_t *bps, size_t nbps)
+{
+	zfsvfs_t	*zfsvfs = zp->z_zfsvfs;
+	dmu_tx_t	*tx;
+	uint64_t	size;
+	uint64_t	mtime[2], ctime[2];
+	sa_bulk_attr_t	bulk[3];
+	int		count = 0;
+	int		error;
+
+	ASSERT(zfsvfs->z_replay);
+
+	ZFS_ENTER(zfsvfs);
+	ZFS_VERIFY_ZP(zp);
+
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(zfsvfs), NULL, &mtime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(zfsvfs), NULL, &ctime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_SIZE(zfsvfs), NULL,
+	    &zp->z_size, 8);
+
+	tx = dmu_tx_create(zfsvfs->z_os);
+	dmu_tx_hold_sa(tx, zp->z_sa_hdl, B_FALSE);
+	dmu_tx_hold_clone(tx, zp->z_id, off, len);
+	zfs_sa_upgrade_txholds(tx, zp);
+	error = dmu_tx_assign(tx, TXG_WAIT);
+	if (error != 0) {
+		dmu_tx_abort(tx);
+		ZFS_EXIT(zfsvfs);
+		return (error);
+	}
+
+	if (zp->z_blksz != blksz) {
+		error = dmu_object_set_blocksize(zfsvfs->z_os, zp->z_id,
+		    blksz, 0, tx);
+		if (error != 0) {
+			dmu_tx_commit(tx);
+			ZFS_EXIT(zfsvfs);
+			return (error);
+		}
+		zp->z_blksz = blksz;
+	}
+
+	dmu_brt_clone(zfsvfs->z_os, zp->z_id, off, len, tx, bps, nbps);
+
+	zfs_tstamp_update_setup(zp, CONTENT_MODIFIED, mtime, ctime, B_TRUE);
+	size = off + len;
+	if (zp->z_size < size)
+		zp->z_size = size;
+	error = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
+
+	/* Marks the record as replayed. */
+	zfs_log_clone_range(zfsvfs->z_log, tx, TX_CLONE_RANGE, zp, off, len,
+	    blksz, bps, nbps);
+
+	dmu_tx_commit(tx);
+
+	ZFS_EXIT(zfsvfs);
+
+	return (error);
+}
+
 /* ARGSUSED */
 void
 zfs_get_done(zgd_t *zgd, int error)
@@ -1241,9 +1660,13 @@ zfs_get_data(void *arg, lr_write_t *lr, char *buf, struct lwb *lwb, zio_t *zio)
 			zil_fault_io = 0;
 		}
 #endif
+		/*
+		 * dmu_sync() reads the block itself if it has to, which
+		 * a block written by dmu_write_direct() does not.
+		 */
 		if (error == 0)
-			error = dmu_buf_hold(os, object, offset, zgd, &db,
-			    DMU_READ_NO_PREFETCH);
+			error = dmu_buf_hold_noread(os, object, offset, zgd,
+			    &db);
 
 		if (error == 0) {
 			blkptr_t *bp = &lr->lr_blkptr;
@@ -41,6 +41,7 @@
 #include <sys/dmu_tx.h>
 #include <sys/dsl_pool.h>
 #include <sys/abd.h>
+#include <sys/brt.h>
 
 /*
  * The ZFS Intent Log (ZIL) saves "transaction records" (itxs) of system
@@ -109,10 +110,20 @@ boolean_t zil_nocacheflush = B_FALSE;
  */
 uint64_t zil_slog_bulk = 768 * 1024;
 
+/*
+ * Number of independent lists of itxs each zilog keeps per txg. Threads
+ * assigning itxs pick a list based on the CPU they're running on, so
+ * that they don't all contend on a single lock. This is capped at the
+ * number of CPUs and ZIL_ITX_SUBLISTS_MAX, and is only read when a zilog
+ * is allocated.
+ */
+int zil_itx_sublists = 16;
+
 static kmem_cache_t *zil_lwb_cache;
 static kmem_cache_t *zil_zcw_cache;
 
 static void zil_async_to_sync(zilog_t *zilog, uint64_t foid);
+static void zil_lwb_commit(zilog_t *zilog, lwb_t *lwb, itx_t *itx);
 
 #define	LWB_EMPTY(lwb) ((BP_GET_LSIZE(&lwb->lwb_blk) - \
     sizeof (zil_chain_t)) == (lwb->lwb_sz - lwb->lwb_nused))
@@ -452,12 +463,60 @@ zil_claim_log_block(zilog_t *zilog, blkptr_t *bp, void *tx, uint64_t first_txg)
 	    ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE | ZIO_FLAG_SCRUB)));
 }
 
+/*
+ * A clone record that may be replayed refers to blocks owned by other
+ * files.  Take a reference on them, so that they stay allocated until the
+ * record has been replayed (which takes its own reference) or discarded
+ * (see zil_free_log_record()).
+ */
+static int
+zil_claim_clone_range(zilog_t *zilog, lr_t *lrc, void *tx, uint64_t first_txg)
+{
+	lr_clone_range_t *lr = (lr_clone_range_t *)lrc;
+	spa_t *spa = zilog->zl_spa;
+
+	if (lrc->lrc_txg < first_txg)
+		return (0);
+
+	if (lrc->lrc_reclen < sizeof (*lr) ||
+	    lrc->lrc_reclen < sizeof (*lr) + lr->lr_nbps * sizeof (blkptr_t))
+		return (SET_ERROR(EINVAL));
+
+	/*
+	 * Only blocks that were already on disk can have been cloned, so a
+	 * record referring to anything newer than the last synced txg
+	 * cannot have been committed.
+	 */
+	for (uint64_t i = 0; i < lr->lr_nbps; i++) {
+		blkptr_t *bp = &lr->lr_bps[i];
+
+		if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp) &&
+		    BP_PHYSICAL_BIRTH(bp) >= first_txg)
+			return (SET_ERROR(EINVAL));
+	}
+
+	if (tx == NULL)
+		return (0);
+
+	for (uint64_t i = 0; i < lr->lr_nbps; i++) {
+		blkptr_t *bp = &lr->lr_bps[i];
+
+		if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp))
+			brt_pending_add(spa, bp, tx);
+	}
+
+	return (0);
+}
+
 static int
 zil_claim_log_record(zilog_t *zilog, lr_t *lrc, void *tx, uint64_t first_txg)
 {
 	lr_write_t *lr = (lr_write_t *)lrc;
 	int error;
 
+	if (lrc->lrc_txtype == TX_CLONE_RANGE)
+		return (zil_claim_clone_range(zilog, lrc, tx, first_txg));
+
 	if (lrc->lrc_txtype != TX_WRITE)
 		return (0);
 
@@ -493,6 +552,22 @@ zil_free_log_record(zilog_t *zilog, lr_t *lrc, void *tx, uint64_t claim_txg)
 	lr_write_t *lr = (lr_write_t *)lrc;
 	blkptr_t *bp = &lr->lr_blkptr;
 
+	/*
+	 * Drop the references taken by zil_claim_clone_range().
+	 */
+	if (claim_txg != 0 && lrc->lrc_txtype == TX_CLONE_RANGE &&
+	    lrc->lrc_txg >= claim_txg) {
+		lr_clone_range_t *lrcr = (lr_clone_range_t *)lrc;
+
+		for (uint64_t i = 0; i < lrcr->lr_nbps; i++) {
+			bp = &lrcr->lr_bps[i];
+			if (!BP_IS_HOLE(bp) && !BP_IS_EMBEDDED(bp))
+				zio_free(zilog->zl_spa, dmu_tx_get_txg(tx),
+				    bp);
+		}
+		return (0);
+	}
+
 	/*
 	 * If we previously claimed it, we need to free it.
 	 */
@@ -525,6 +600,7 @@ zil_alloc_lwb(zilog_t *zilog, blkptr_t *bp, boolean_t slog, uint64_t txg)
 	lwb->lwb_state = LWB_STATE_CLOSED;
 	lwb->lwb_buf = zio_buf_alloc(BP_GET_LSIZE(bp));
 	lwb->lwb_max_txg = txg;
+	lwb->lwb_wait_txg = 0;
 	lwb->lwb_write_zio = NULL;
 	lwb->lwb_root_zio = NULL;
 	lwb->lwb_tx = NULL;
@@ -536,6 +612,7 @@ zil_alloc_lwb(zilog_t *zilog, blkptr_t *bp, boolean_t slog, uint64_t txg)
 		lwb->lwb_nused = 0;
 		lwb->lwb_sz = BP_GET_LSIZE(bp) - sizeof (zil_chain_t);
 	}
+	lwb->lwb_nfilled = lwb->lwb_nused;
 
 	mutex_enter(&zilog->zl_lock);
 	list_insert_tail(&zilog->zl_lwb_list, lwb);
@@ -544,6 +621,7 @@ zil_alloc_lwb(zilog_t *zilog, blkptr_t *bp, boolean_t slog, uint64_t txg)
 	ASSERT(!MUTEX_HELD(&lwb->lwb_vdev_lock));
 	ASSERT(avl_is_empty(&lwb->lwb_vdev_tree));
 	VERIFY(list_is_empty(&lwb->lwb_waiters));
+	VERIFY(list_is_empty(&lwb->lwb_itxs));
 
 	return (lwb);
 }
@@ -554,6 +632,7 @@ zil_free_lwb(zilog_t *zilog, lwb_t *lwb)
 	ASSERT(MUTEX_HELD(&zilog->zl_lock));
 	ASSERT(!MUTEX_HELD(&lwb->lwb_vdev_lock));
 	VERIFY(list_is_empty(&lwb->lwb_waiters));
+	VERIFY(list_is_empty(&lwb->lwb_itxs));
 	ASSERT(avl_is_empty(&lwb->lwb_vdev_tree));
 	ASSERT3P(lwb->lwb_write_zio, ==, NULL);
 	ASSERT3P(lwb->lwb_root_zio, ==, NULL);
@@ -974,6 +1053,7 @@ zil_commit_waiter_link_lwb(zil_commit_waiter_t *zcw, lwb_t *lwb)
 	ASSERT3P(zcw->zcw_lwb, ==, NULL);
 	ASSERT3P(lwb, !=, NULL);
 	ASSERT(lwb->lwb_state == LWB_STATE_OPENED ||
+	    lwb->lwb_state == LWB_STATE_READY ||
 	    lwb->lwb_state == LWB_STATE_ISSUED ||
 	    lwb->lwb_state == LWB_STATE_WRITE_DONE);
 
@@ -1121,6 +1201,17 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 		zilog->zl_commit_lr_seq = zilog->zl_lr_seq;
 	}
 
+	/*
+	 * If any of the records of this lwb had to be dropped (see
+	 * zil_lwb_commit()), the waiters of this lwb, and of every lwb
+	 * after it, must wait for the txg of those records to sync
+	 * before returning from zil_commit(). Since the lwbs complete
+	 * in order, tracking the highest such txg in the zilog is
+	 * enough to cover the later lwbs.
+	 */
+	if (lwb->lwb_wait_txg > zilog->zl_wait_txg)
+		zilog->zl_wait_txg = lwb->lwb_wait_txg;
+
 	while ((zcw = list_head(&lwb->lwb_waiters)) != NULL) {
 		mutex_enter(&zcw->zcw_lock);
 
@@ -1131,6 +1222,7 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 		zcw->zcw_lwb = NULL;
 
 		zcw->zcw_zio_error = zio->io_error;
+		zcw->zcw_wait_txg = zilog->zl_wait_txg;
 
 		ASSERT3B(zcw->zcw_done, ==, B_FALSE);
 		zcw->zcw_done = B_TRUE;
@@ -1262,6 +1354,7 @@ zil_lwb_set_zio_dependency(zilog_t *zilog, lwb_t *lwb)
 	if (last_lwb_opened != NULL &&
 	    last_lwb_opened->lwb_state != LWB_STATE_FLUSH_DONE) {
 		ASSERT(last_lwb_opened->lwb_state == LWB_STATE_OPENED ||
+		    last_lwb_opened->lwb_state == LWB_STATE_READY ||
 		    last_lwb_opened->lwb_state == LWB_STATE_ISSUED ||
 		    last_lwb_opened->lwb_state == LWB_STATE_WRITE_DONE);
 
@@ -1294,6 +1387,7 @@ zil_lwb_set_zio_dependency(zilog_t *zilog, lwb_t *lwb)
 		 */
 		if (last_lwb_opened->lwb_state != LWB_STATE_WRITE_DONE) {
 			ASSERT(last_lwb_opened->lwb_state == LWB_STATE_OPENED ||
+			    last_lwb_opened->lwb_state == LWB_STATE_READY ||
 			    last_lwb_opened->lwb_state == LWB_STATE_ISSUED);
 
 			ASSERT3P(last_lwb_opened->lwb_write_zio, !=, NULL);
@@ -1373,11 +1467,14 @@ uint64_t zil_block_buckets[] = {
 };
 
 /*
- * Start a log block write and advance to the next log block.
+ * Close the lwb to further itxs, and allocate the next block in the log
+ * chain, saving its address in this block's chain header. The lwb's
+ * records are filled in, and its zio issued, by the caller via
+ * zil_lwb_write_issue(), once it has dropped the zl_issuer_lock.
  * Calls are serialized.
  */
 static lwb_t *
-zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
+zil_lwb_write_close(zilog_t *zilog, lwb_t *lwb)
 {
 	lwb_t *nlwb = NULL;
 	zil_chain_t *zilc;
@@ -1385,7 +1482,7 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 	blkptr_t *bp;
 	dmu_tx_t *tx;
 	uint64_t txg;
-	uint64_t zil_blksz, wsz;
+	uint64_t zil_blksz;
 	int i, error;
 	boolean_t slog;
 
@@ -1473,13 +1570,58 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 		nlwb = zil_alloc_lwb(zilog, bp, slog, txg);
 	}
 
+	mutex_enter(&zilog->zl_lock);
+	lwb->lwb_state = LWB_STATE_READY;
+	mutex_exit(&zilog->zl_lock);
+
+	/*
+	 * If there was an allocation failure then nlwb will be null which
+	 * forces a txg_wait_synced().
+	 */
+	return (nlwb);
+}
+
+/*
+ * Fill in the records of the itxs assigned to a closed lwb, and start
+ * its write. This is called without the zl_issuer_lock, so several
+ * threads may be filling and issuing lwbs at the same time; the zios of
+ * each lwb were made to depend on those of the previous lwb when it was
+ * opened, so the lwbs still complete in the order they were created.
+ */
+static void
+zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
+{
+	zil_chain_t *zilc;
+	uint64_t wsz;
+	itx_t *itx;
+
+	ASSERT(!MUTEX_HELD(&zilog->zl_lock));
+	ASSERT3P(lwb->lwb_root_zio, !=, NULL);
+	ASSERT3P(lwb->lwb_write_zio, !=, NULL);
+	ASSERT3S(lwb->lwb_state, ==, LWB_STATE_READY);
+
+	while ((itx = list_remove_head(&lwb->lwb_itxs)) != NULL) {
+		zil_lwb_commit(zilog, lwb, itx);
+		zil_itx_destroy(itx);
+	}
+
+	/*
+	 * Records whose data couldn't be retrieved were left out, so only
+	 * write what was actually filled in.
+	 */
+	ASSERT3S(lwb->lwb_nfilled, <=, lwb->lwb_nused);
+	lwb->lwb_nused = lwb->lwb_nfilled;
+
 	if (BP_GET_CHECKSUM(&lwb->lwb_blk) == ZIO_CHECKSUM_ZILOG2) {
+		zilc = (zil_chain_t *)lwb->lwb_buf;
+
 		/* For Slim ZIL only write what is used. */
 		wsz = P2ROUNDUP_TYPED(lwb->lwb_nused, ZIL_MIN_BLKSZ, uint64_t);
 		ASSERT3U(wsz, <=, lwb->lwb_sz);
 		zio_shrink(lwb->lwb_write_zio, wsz);
 
 	} else {
+		zilc = (zil_chain_t *)(lwb->lwb_buf + lwb->lwb_sz);
 		wsz = lwb->lwb_sz;
 	}
 
@@ -1496,24 +1638,58 @@ zil_lwb_write_issue(zilog_t *zilog, lwb_t *lwb)
 
 	zil_lwb_add_block(lwb, &lwb->lwb_blk);
 	lwb->lwb_issued_timestamp = gethrtime();
+
+	mutex_enter(&zilog->zl_lock);
 	lwb->lwb_state = LWB_STATE_ISSUED;
+	mutex_exit(&zilog->zl_lock);
 
 	zio_nowait(lwb->lwb_root_zio);
 	zio_nowait(lwb->lwb_write_zio);
+}
 
-	/*
-	 * If there was an allocation failure then nlwb will be null which
-	 * forces a txg_wait_synced().
-	 */
-	return (nlwb);
+/*
+ * Issue the lwbs closed by this thread, in the order they were closed.
+ */
+static void
+zil_lwb_write_issue_list(zilog_t *zilog, list_t *ilwbs)
+{
+	lwb_t *lwb;
+
+	while ((lwb = list_remove_head(ilwbs)) != NULL)
+		zil_lwb_write_issue(zilog, lwb);
 }
 
+/*
+ * Duplicate an itx, so that a WR_NEED_COPY write that doesn't fit in a
+ * single lwb can be split up between several of them.
+ */
+static itx_t *
+zil_itx_clone(itx_t *oitx)
+{
+	size_t itxsize = offsetof(itx_t, itx_lr) + oitx->itx_lr.lrc_reclen;
+	itx_t *itx;
+
+	itx = kmem_alloc(itxsize, KM_SLEEP);
+	bcopy(oitx, itx, itxsize);
+	list_link_init(&itx->itx_node);
+
+	return (itx);
+}
+
+/*
+ * Assign an itx to the given lwb, or to a new one if it doesn't fit,
+ * reserving space for its log record and giving the record its log
+ * sequence number. The record itself is filled in later, by
+ * zil_lwb_commit(), when the lwb is issued. Any lwbs that are closed in
+ * the process are added to "ilwbs", for the caller to issue once it has
+ * dropped the zl_issuer_lock. The itx is consumed.
+ */
 static lwb_t *
-zil_lwb_commit(zilog_t *zilog, itx_t *itx, lwb_t *lwb)
+zil_lwb_assign(zilog_t *zilog, lwb_t *lwb, itx_t *itx, list_t *ilwbs)
 {
-	lr_t *lrcb, *lrc;
-	lr_write_t *lrwb, *lrw;
-	char *lr_buf;
+	itx_t *citx;
+	lr_t *lrc;
+	lr_write_t *lrw;
 	uint64_t dlen, dnow, lwb_sp, reclen, txg;
 
 	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
@@ -1542,6 +1718,7 @@ zil_lwb_commit(zilog_t *zilog, itx_t *itx, lwb_t *lwb)
 		zil_commit_waiter_link_lwb(itx->itx_private, lwb);
 		itx->itx_private = NULL;
 		mutex_exit(&zilog->zl_lock);
+		zil_itx_destroy(itx);
 		return (lwb);
 	}
 
@@ -1557,6 +1734,17 @@ zil_lwb_commit(zilog_t *zilog, itx_t *itx, lwb_t *lwb)
 
 	ASSERT3U(zilog->zl_cur_used, <, UINT64_MAX - (reclen + dlen));
 
+	/*
+	 * When the pool is frozen (ztest), the write's txg must have
+	 * synced before its data is retrieved. The lwbs closed so far
+	 * hold a tx open, so they have to be issued before we can wait.
+	 */
+	if (lrc->lrc_txtype == TX_WRITE &&
+	    txg > spa_freeze_txg(zilog->zl_spa)) {
+		zil_lwb_write_issue_list(zilog, ilwbs);
+		txg_wait_synced(zilog->zl_dmu_pool, txg);
+	}
+
 cont:
 	/*
 	 * If this record won't fit in the current log block, start a new one.
@@ -1566,81 +1754,45 @@ cont:
 	if (reclen > lwb_sp || (reclen + dlen > lwb_sp &&
 	    lwb_sp < ZIL_MAX_WASTE_SPACE && (dlen % ZIL_MAX_LOG_DATA == 0 ||
 	    lwb_sp < reclen + dlen % ZIL_MAX_LOG_DATA))) {
-		lwb = zil_lwb_write_issue(zilog, lwb);
-		if (lwb == NULL)
+		list_insert_tail(ilwbs, lwb);
+		lwb = zil_lwb_write_close(zilog, lwb);
+		if (lwb == NULL) {
+			zil_itx_destroy(itx);
 			return (NULL);
+		}
 		zil_lwb_write_open(zilog, lwb);
 		ASSERT(LWB_EMPTY(lwb));
 		lwb_sp = lwb->lwb_sz - lwb->lwb_nused;
 		ASSERT3U(reclen + MIN(dlen, sizeof (uint64_t)), <=, lwb_sp);
 	}
 
-	dnow = MIN(dlen, lwb_sp - reclen);
-	lr_buf = lwb->lwb_buf + lwb->lwb_nused;
-	bcopy(lrc, lr_buf, reclen);
-	lrcb = (lr_t *)lr_buf;		/* Like lrc, but inside lwb. */
-	lrwb = (lr_write_t *)lrcb;	/* Like lrw, but inside lwb. */
-
 	/*
-	 * If it's a write, fetch the data or get its blkptr as appropriate.
+	 * If the rest of a WR_NEED_COPY write doesn't fit in this lwb,
+	 * split off a copy of the itx covering the part that does.
 	 */
-	if (lrc->lrc_txtype == TX_WRITE) {
-		if (txg > spa_freeze_txg(zilog->zl_spa))
-			txg_wait_synced(zilog->zl_dmu_pool, txg);
-		if (itx->itx_wr_state != WR_COPIED) {
-			char *dbuf;
-			int error;
-
-			if (itx->itx_wr_state == WR_NEED_COPY) {
-				dbuf = lr_buf + reclen;
-				lrcb->lrc_reclen += dnow;
-				if (lrwb->lr_length > dnow)
-					lrwb->lr_length = dnow;
-				lrw->lr_offset += dnow;
-				lrw->lr_length -= dnow;
-			} else {
-				ASSERT(itx->itx_wr_state == WR_INDIRECT);
-				dbuf = NULL;
-			}
-
-			/*
-			 * We pass in the "lwb_write_zio" rather than
-			 * "lwb_root_zio" so that the "lwb_write_zio"
-			 * becomes the parent of any zio's created by
-			 * the "zl_get_data" callback. The vdevs are
-			 * flushed after the "lwb_write_zio" completes,
-			 * so we want to make sure that completion
-			 * callback waits for these additional zio's,
-			 * such that the vdevs used by those zio's will
-			 * be included in the lwb's vdev tree, and those
-			 * vdevs will be properly flushed. If we passed
-			 * in "lwb_root_zio" here, then these additional
-			 * vdevs may not be flushed; e.g. if these zio's
-			 * completed after "lwb_write_zio" completed.
-			 */
-			error = zilog->zl_get_data(itx->itx_private,
-			    lrwb, dbuf, lwb, lwb->lwb_write_zio);
-
-			if (error == EIO) {
-				txg_wait_synced(zilog->zl_dmu_pool, txg);
-				return (lwb);
-			}
-			if (error != 0) {
-				ASSERT(error == ENOENT || error == EEXIST ||
-				    error == EALREADY);
-				return (lwb);
-			}
-		}
+	dnow = MIN(dlen, lwb_sp - reclen);
+	if (dlen > dnow) {
+		ASSERT3U(lrc->lrc_txtype, ==, TX_WRITE);
+		ASSERT3U(itx->itx_wr_state, ==, WR_NEED_COPY);
+		citx = zil_itx_clone(itx);
+		((lr_write_t *)&citx->itx_lr)->lr_length = dnow;
+		lrw->lr_offset += dnow;
+		lrw->lr_length -= dnow;
+	} else {
+		citx = itx;
 	}
 
 	/*
-	 * We're actually making an entry, so update lrc_seq to be the
+	 * We're going to make an entry, so update lrc_seq to be the
 	 * log record sequence number.  Note that this is generally not
 	 * equal to the itx sequence number because not all transactions
 	 * are synchronous, and sometimes spa_sync() gets there first.
+	 * The entry may still be left out if its data can't be
+	 * retrieved; see zil_lwb_commit().
 	 */
-	lrcb->lrc_seq = ++zilog->zl_lr_seq;
+	citx->itx_lr.lrc_seq = ++zilog->zl_lr_seq;
 	lwb->lwb_nused += reclen + dnow;
+	list_insert_tail(&lwb->lwb_itxs, citx);
 
 	zil_lwb_add_txg(lwb, txg);
 
@@ -1656,6 +1808,101 @@ cont:
 	return (lwb);
 }
 
+/*
+ * Copy the log record of an itx that was assigned to this lwb into its
+ * buffer, retrieving the data or block pointer of a write as needed.
+ * This is done by the thread issuing the lwb, without holding the
+ * zl_issuer_lock.
+ */
+static void
+zil_lwb_commit(zilog_t *zilog, lwb_t *lwb, itx_t *itx)
+{
+	lr_t *lrcb, *lrc;
+	lr_write_t *lrwb, *lrw;
+	char *lr_buf;
+	uint64_t dlen, reclen, txg;
+
+	ASSERT3S(lwb->lwb_state, ==, LWB_STATE_READY);
+	ASSERT3P(lwb->lwb_buf, !=, NULL);
+
+	lrc = &itx->itx_lr;
+	lrw = (lr_write_t *)lrc;
+
+	/* commit itxs are never assigned to an lwb's list of itxs. */
+	ASSERT3U(lrc->lrc_txtype, !=, TX_COMMIT);
+
+	if (lrc->lrc_txtype == TX_WRITE && itx->itx_wr_state == WR_NEED_COPY) {
+		dlen = P2ROUNDUP_TYPED(
+		    lrw->lr_length, sizeof (uint64_t), uint64_t);
+	} else {
+		dlen = 0;
+	}
+	reclen = lrc->lrc_reclen;
+	txg = lrc->lrc_txg;
+
+	ASSERT3U(lwb->lwb_nfilled + reclen + dlen, <=, lwb->lwb_nused);
+
+	lr_buf = lwb->lwb_buf + lwb->lwb_nfilled;
+	bcopy(lrc, lr_buf, reclen);
+	lrcb = (lr_t *)lr_buf;		/* Like lrc, but inside lwb. */
+	lrwb = (lr_write_t *)lrcb;	/* Like lrw, but inside lwb. */
+
+	/*
+	 * If it's a write, fetch the data or get its blkptr as appropriate.
+	 */
+	if (lrc->lrc_txtype == TX_WRITE && itx->itx_wr_state != WR_COPIED) {
+		char *dbuf;
+		int error;
+
+		if (itx->itx_wr_state == WR_NEED_COPY) {
+			dbuf = lr_buf + reclen;
+			lrcb->lrc_reclen += dlen;
+		} else {
+			ASSERT(itx->itx_wr_state == WR_INDIRECT);
+			dbuf = NULL;
+		}
+
+		/*
+		 * We pass in the "lwb_write_zio" rather than
+		 * "lwb_root_zio" so that the "lwb_write_zio"
+		 * becomes the parent of any zio's created by
+		 * the "zl_get_data" callback. The vdevs are
+		 * flushed after the "lwb_write_zio" completes,
+		 * so we want to make sure that completion
+		 * callback waits for these additional zio's,
+		 * such that the vdevs used by those zio's will
+		 * be included in the lwb's vdev tree, and those
+		 * vdevs will be properly flushed. If we passed
+		 * in "lwb_root_zio" here, then these additional
+		 * vdevs may not be flushed; e.g. if these zio's
+		 * completed after "lwb_write_zio" completed.
+		 */
+		error = zilog->zl_get_data(itx->itx_private,
+		    lrwb, dbuf, lwb, lwb->lwb_write_zio);
+
+		if (error == EIO) {
+			/*
+			 * The record is left out, so whoever waits on
+			 * this lwb has to wait for its txg to sync
+			 * instead. We can't wait for that here, since
+			 * this lwb holds a tx open until it's done.
+			 */
+			lwb->lwb_wait_txg = MAX(lwb->lwb_wait_txg, txg);
+			return;
+		}
+		if (error != 0) {
+			ASSERT(error == ENOENT || error == EEXIST ||
+			    error == EALREADY);
+			return;
+		}
+	}
+
+	lwb->lwb_nfilled += reclen + dlen;
+
+	ASSERT3S(lwb->lwb_nfilled, <=, lwb->lwb_nused);
+	ASSERT0(P2PHASE(lwb->lwb_nfilled, sizeof (uint64_t)));
+}
+
 itx_t *
 zil_itx_create(uint64_t txtype, size_t lrsize)
 {
@@ -1667,6 +1914,7 @@ zil_itx_create(uint64_t txtype, size_t lrsize)
 	itx->itx_lr.lrc_txtype = txtype;
 	itx->itx_lr.lrc_reclen = lrsize;
 	itx->itx_lr.lrc_seq = 0;	/* defensive */
+	itx->itx_seq = 0;
 	itx->itx_sync = B_TRUE;		/* default is synchronous */
 
 	return (itx);
@@ -1696,7 +1944,7 @@ zil_itxg_clean(itxs_t *itxs)
 		/*
 		 * In the general case, commit itxs will not be found
 		 * here, as they'll be committed to an lwb via
-		 * zil_lwb_commit(), and free'd in that function. Having
+		 * zil_lwb_assign(), and free'd in that function. Having
 		 * said that, it is still possible for commit itxs to be
 		 * found here, due to the following race:
 		 *
@@ -1768,22 +2016,24 @@ zil_remove_async(zilog_t *zilog, uint64_t oid)
 		otxg = spa_last_synced_txg(zilog->zl_spa) + 1;
 
 	for (txg = otxg; txg < (otxg + TXG_CONCURRENT_STATES); txg++) {
-		itxg_t *itxg = &zilog->zl_itxg[txg & TXG_MASK];
+		for (uint_t s = 0; s < zilog->zl_itx_nsublists; s++) {
+			itxg_t *itxg = ZIL_ITXG(zilog, s, txg);
 
-		mutex_enter(&itxg->itxg_lock);
-		if (itxg->itxg_txg != txg) {
+			mutex_enter(&itxg->itxg_lock);
+			if (itxg->itxg_txg != txg) {
+				mutex_exit(&itxg->itxg_lock);
+				continue;
+			}
+
+			/*
+			 * Locate the object node and append its list.
+			 */
+			t = &itxg->itxg_itxs->i_async_tree;
+			ian = avl_find(t, &oid, &where);
+			if (ian != NULL)
+				list_move_tail(&clean_list, &ian->ia_list);
 			mutex_exit(&itxg->itxg_lock);
-			continue;
 		}
-
-		/*
-		 * Locate the object node and append its list.
-		 */
-		t = &itxg->itxg_itxs->i_async_tree;
-		ian = avl_find(t, &oid, &where);
-		if (ian != NULL)
-			list_move_tail(&clean_list, &ian->ia_list);
-		mutex_exit(&itxg->itxg_lock);
 	}
 	while ((itx = list_head(&clean_list)) != NULL) {
 		list_remove(&clean_list, itx);
@@ -1812,7 +2062,7 @@ zil_itx_assign(zilog_t *zilog, itx_t *itx, dmu_tx_t *tx)
 	else
 		txg = dmu_tx_get_txg(tx);
 
-	itxg = &zilog->zl_itxg[txg & TXG_MASK];
+	itxg = ZIL_ITXG(zilog, CPU_SEQID % zilog->zl_itx_nsublists, txg);
 	mutex_enter(&itxg->itxg_lock);
 	itxs = itxg->itxg_itxs;
 	if (itxg->itxg_txg != txg) {
@@ -1835,6 +2085,14 @@ zil_itx_assign(zilog_t *zilog, itx_t *itx, dmu_tx_t *tx)
 		    sizeof (itx_async_node_t),
 		    offsetof(itx_async_node_t, ia_node));
 	}
+
+	/*
+	 * The sequence number is taken while holding the itxg_lock, so
+	 * that the itxs on each of the sublists' sync lists are in
+	 * sequence number order; see zil_get_commit_list().
+	 */
+	itx->itx_seq = atomic_inc_64_nv(&zilog->zl_itx_seq);
+
 	if (itx->itx_sync) {
 		list_insert_tail(&itxs->i_sync_list, itx);
 	} else {
@@ -1881,34 +2139,101 @@ zil_itx_assign(zilog_t *zilog, itx_t *itx, dmu_tx_t *tx)
 void
 zil_clean(zilog_t *zilog, uint64_t synced_txg)
 {
-	itxg_t *itxg = &zilog->zl_itxg[synced_txg & TXG_MASK];
-	itxs_t *clean_me;
-
 	ASSERT3U(synced_txg, <, ZILTEST_TXG);
 
-	mutex_enter(&itxg->itxg_lock);
-	if (itxg->itxg_itxs == NULL || itxg->itxg_txg == ZILTEST_TXG) {
+	for (uint_t s = 0; s < zilog->zl_itx_nsublists; s++) {
+		itxg_t *itxg = ZIL_ITXG(zilog, s, synced_txg);
+		itxs_t *clean_me;
+
+		mutex_enter(&itxg->itxg_lock);
+		if (itxg->itxg_itxs == NULL || itxg->itxg_txg == ZILTEST_TXG) {
+			mutex_exit(&itxg->itxg_lock);
+			continue;
+		}
+		ASSERT3U(itxg->itxg_txg, <=, synced_txg);
+		ASSERT3U(itxg->itxg_txg, !=, 0);
+		clean_me = itxg->itxg_itxs;
+		itxg->itxg_itxs = NULL;
+		itxg->itxg_txg = 0;
 		mutex_exit(&itxg->itxg_lock);
-		return;
+		/*
+		 * Preferably start a task queue to free up the old itxs but
+		 * if taskq_dispatch can't allocate resources to do that then
+		 * free it in-line. This should be rare. Note, using TQ_SLEEP
+		 * created a bad performance problem.
+		 */
+		ASSERT3P(zilog->zl_dmu_pool, !=, NULL);
+		ASSERT3P(zilog->zl_dmu_pool->dp_zil_clean_taskq, !=, NULL);
+		if (taskq_dispatch(zilog->zl_dmu_pool->dp_zil_clean_taskq,
+		    (void (*)(void *))zil_itxg_clean, clean_me, TQ_NOSLEEP) ==
+		    TASKQID_INVALID)
+			zil_itxg_clean(clean_me);
+	}
+}
+
+/*
+ * Acquire the itxg_lock of every sublist for the given txg, in sublist
+ * order, and return the itxs of the sublists that have any for that txg
+ * in "itxs". Returns the number of such sublists.
+ */
+static int
+zil_itxg_enter_all(zilog_t *zilog, uint64_t txg, itxs_t **itxs)
+{
+	int n = 0;
+
+	for (uint_t s = 0; s < zilog->zl_itx_nsublists; s++) {
+		itxg_t *itxg = ZIL_ITXG(zilog, s, txg);
+
+		mutex_enter(&itxg->itxg_lock);
+		if (itxg->itxg_txg == txg) {
+			ASSERT3P(itxg->itxg_itxs, !=, NULL);
+			itxs[n++] = itxg->itxg_itxs;
+		}
+	}
+
+	return (n);
+}
+
+static void
+zil_itxg_exit_all(zilog_t *zilog, uint64_t txg)
+{
+	for (uint_t s = 0; s < zilog->zl_itx_nsublists; s++)
+		mutex_exit(&ZIL_ITXG(zilog, s, txg)->itxg_lock);
+}
+
+/*
+ * Move the itxs on the given lists, each of which is sorted by itx_seq,
+ * onto the tail of "dst" in itx_seq order.
+ */
+static void
+zil_itx_merge(list_t *dst, list_t **srcs, int nsrcs)
+{
+	for (;;) {
+		list_t *src = NULL;
+		itx_t *next = NULL;
+		int nonempty = 0;
+
+		for (int i = 0; i < nsrcs; i++) {
+			itx_t *itx = list_head(srcs[i]);
+
+			if (itx == NULL)
+				continue;
+			nonempty++;
+			if (next == NULL || itx->itx_seq < next->itx_seq) {
+				next = itx;
+				src = srcs[i];
+			}
+		}
+
+		if (nonempty <= 1) {
+			if (src != NULL)
+				list_move_tail(dst, src);
+			return;
+		}
+
+		list_remove(src, next);
+		list_insert_tail(dst, next);
 	}
-	ASSERT3U(itxg->itxg_txg, <=, synced_txg);
-	ASSERT3U(itxg->itxg_txg, !=, 0);
-	clean_me = itxg->itxg_itxs;
-	itxg->itxg_itxs = NULL;
-	itxg->itxg_txg = 0;
-	mutex_exit(&itxg->itxg_lock);
-	/*
-	 * Preferably start a task queue to free up the old itxs but
-	 * if taskq_dispatch can't allocate resources to do that then
-	 * free it in-line. This should be rare. Note, using TQ_SLEEP
-	 * created a bad performance problem.
-	 */
-	ASSERT3P(zilog->zl_dmu_pool, !=, NULL);
-	ASSERT3P(zilog->zl_dmu_pool->dp_zil_clean_taskq, !=, NULL);
-	if (taskq_dispatch(zilog->zl_dmu_pool->dp_zil_clean_taskq,
-	    (void (*)(void *))zil_itxg_clean, clean_me, TQ_NOSLEEP) ==
-	    TASKQID_INVALID)
-		zil_itxg_clean(clean_me);
 }
 
 /*
@@ -1934,13 +2259,17 @@ zil_get_commit_list(zilog_t *zilog)
 	 * only commit things in the future.
 	 */
 	for (txg = otxg; txg < (otxg + TXG_CONCURRENT_STATES); txg++) {
-		itxg_t *itxg = &zilog->zl_itxg[txg & TXG_MASK];
+		itxs_t *itxs[ZIL_ITX_SUBLISTS_MAX];
+		list_t *lists[ZIL_ITX_SUBLISTS_MAX];
+		int n;
 
-		mutex_enter(&itxg->itxg_lock);
-		if (itxg->itxg_txg != txg) {
-			mutex_exit(&itxg->itxg_lock);
-			continue;
-		}
+		/*
+		 * All of the sublists are locked at once, so that we see
+		 * every itx that was assigned before any itx that we take.
+		 * Merging the sublists by sequence number then gives us
+		 * the itxs in the order they were assigned.
+		 */
+		n = zil_itxg_enter_all(zilog, txg, itxs);
 
 		/*
 		 * If we're adding itx records to the zl_itx_commit_list,
@@ -1950,11 +2279,59 @@ zil_get_commit_list(zilog_t *zilog)
 		 * to the zl_itx_commit_list we must commit it to disk even
 		 * if it's unnecessary (i.e. the txg was synced).
 		 */
-		ASSERT(zilog_is_dirty_in_txg(zilog, txg) ||
+		ASSERT(n == 0 || zilog_is_dirty_in_txg(zilog, txg) ||
 		    spa_freeze_txg(zilog->zl_spa) != UINT64_MAX);
-		list_move_tail(commit_list, &itxg->itxg_itxs->i_sync_list);
+		for (int i = 0; i < n; i++)
+			lists[i] = &itxs[i]->i_sync_list;
+		zil_itx_merge(commit_list, lists, n);
 
-		mutex_exit(&itxg->itxg_lock);
+		zil_itxg_exit_all(zilog, txg);
+	}
+}
+
+/*
+ * Move the async itxs for the given object, from every sublist, onto the
+ * end of the first sublist's sync list. The caller holds the itxg_lock
+ * of all of the sublists, so the itxs are merged in the order they were
+ * assigned and then given new sequence numbers, which keeps the sync
+ * list sorted. If "destroy" is set, the object's nodes are removed from
+ * the async trees.
+ */
+static void
+zil_async_foid_to_sync(zilog_t *zilog, itxs_t **itxs, int n, uint64_t foid,
+    boolean_t destroy)
+{
+	list_t *lists[ZIL_ITX_SUBLISTS_MAX];
+	list_t moved;
+	itx_async_node_t *ian;
+	itx_t *itx;
+	int nlists = 0;
+
+	for (int i = 0; i < n; i++) {
+		ian = avl_find(&itxs[i]->i_async_tree, &foid, NULL);
+		if (ian != NULL)
+			lists[nlists++] = &ian->ia_list;
+	}
+
+	list_create(&moved, sizeof (itx_t), offsetof(itx_t, itx_node));
+	zil_itx_merge(&moved, lists, nlists);
+	for (itx = list_head(&moved); itx != NULL;
+	    itx = list_next(&moved, itx))
+		itx->itx_seq = atomic_inc_64_nv(&zilog->zl_itx_seq);
+	if (n > 0)
+		list_move_tail(&itxs[0]->i_sync_list, &moved);
+	list_destroy(&moved);
+
+	if (!destroy)
+		return;
+
+	for (int i = 0; i < n; i++) {
+		ian = avl_find(&itxs[i]->i_async_tree, &foid, NULL);
+		if (ian == NULL)
+			continue;
+		avl_remove(&itxs[i]->i_async_tree, ian);
+		list_destroy(&ian->ia_list);
+		kmem_free(ian, sizeof (itx_async_node_t));
 	}
 }
 
@@ -1965,9 +2342,6 @@ static void
 zil_async_to_sync(zilog_t *zilog, uint64_t foid)
 {
 	uint64_t otxg, txg;
-	itx_async_node_t *ian;
-	avl_tree_t *t;
-	avl_index_t where;
 
 	if (spa_freeze_txg(zilog->zl_spa) != UINT64_MAX) /* ziltest support */
 		otxg = ZILTEST_TXG;
@@ -1979,38 +2353,31 @@ zil_async_to_sync(zilog_t *zilog, uint64_t foid)
 	 * the last synced txg from changing.
 	 */
 	for (txg = otxg; txg < (otxg + TXG_CONCURRENT_STATES); txg++) {
-		itxg_t *itxg = &zilog->zl_itxg[txg & TXG_MASK];
+		itxs_t *itxs[ZIL_ITX_SUBLISTS_MAX];
+		itx_async_node_t *ian;
+		int n;
 
-		mutex_enter(&itxg->itxg_lock);
-		if (itxg->itxg_txg != txg) {
-			mutex_exit(&itxg->itxg_lock);
-			continue;
-		}
+		n = zil_itxg_enter_all(zilog, txg, itxs);
 
 		/*
 		 * If a foid is specified then find that node and append its
-		 * list. Otherwise walk the tree appending all the lists
+		 * list. Otherwise walk the trees appending all the lists
 		 * to the sync list. We add to the end rather than the
 		 * beginning to ensure the create has happened.
 		 */
-		t = &itxg->itxg_itxs->i_async_tree;
 		if (foid != 0) {
-			ian = avl_find(t, &foid, &where);
-			if (ian != NULL) {
-				list_move_tail(&itxg->itxg_itxs->i_sync_list,
-				    &ian->ia_list);
-			}
+			zil_async_foid_to_sync(zilog, itxs, n, foid, B_FALSE);
 		} else {
-			void *cookie = NULL;
-
-			while ((ian = avl_destroy_nodes(t, &cookie)) != NULL) {
-				list_move_tail(&itxg->itxg_itxs->i_sync_list,
-				    &ian->ia_list);
-				list_destroy(&ian->ia_list);
-				kmem_free(ian, sizeof (itx_async_node_t));
+			for (int i = 0; i < n; i++) {
+				while ((ian = avl_first(
+				    &itxs[i]->i_async_tree)) != NULL) {
+					zil_async_foid_to_sync(zilog, itxs, n,
+					    ian->ia_foid, B_TRUE);
+				}
 			}
 		}
-		mutex_exit(&itxg->itxg_lock);
+
+		zil_itxg_exit_all(zilog, txg);
 	}
 }
 
@@ -2046,7 +2413,10 @@ zil_prune_commit_list(zilog_t *zilog)
 			 * never any itx's for it to wait on), so it's
 			 * safe to skip this waiter and mark it done.
 			 */
-			zil_commit_waiter_skip(itx->itx_private);
+			zil_commit_waiter_t *zcw = itx->itx_private;
+
+			zcw->zcw_wait_txg = zilog->zl_wait_txg;
+			zil_commit_waiter_skip(zcw);
 		} else {
 			zil_commit_waiter_link_lwb(itx->itx_private, last_lwb);
 			itx->itx_private = NULL;
@@ -2083,6 +2453,11 @@ zil_commit_writer_stall(zilog_t *zilog)
 	 * ensure no new threads enter zil_process_commit_list() until
 	 * all lwb's in the zl_lwb_list have been synced and freed
 	 * (which is achieved via the txg_wait_synced() call).
+	 *
+	 * Any lwbs closed by this thread must have been issued before
+	 * calling this, as each of them holds a tx open until it is
+	 * done. Lwbs closed by other threads will be issued by those
+	 * threads, without needing the zl_issuer_lock.
 	 */
 	ASSERT(MUTEX_HELD(&zilog->zl_issuer_lock));
 	txg_wait_synced(zilog->zl_dmu_pool, 0);
@@ -2091,12 +2466,14 @@ zil_commit_writer_stall(zilog_t *zilog)
 
 /*
  * This function will traverse the commit list, creating new lwbs as
- * needed, and committing the itxs from the commit list to these newly
+ * needed, and assigning the itxs from the commit list to these newly
  * created lwbs. Additionally, as a new lwb is created, the previous
- * lwb will be issued to the zio layer to be written to disk.
+ * lwb is closed and added to "ilwbs"; the caller must issue those lwbs
+ * to the zio layer (via zil_lwb_write_issue_list()) once it has dropped
+ * the zl_issuer_lock.
  */
 static void
-zil_process_commit_list(zilog_t *zilog)
+zil_process_commit_list(zilog_t *zilog, list_t *ilwbs)
 {
 	spa_t *spa = zilog->zl_spa;
 	list_t nolwb_waiters;
@@ -2119,6 +2496,7 @@ zil_process_commit_list(zilog_t *zilog)
 	if (lwb == NULL) {
 		lwb = zil_create(zilog);
 	} else {
+		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_READY);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_ISSUED);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_WRITE_DONE);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_FLUSH_DONE);
@@ -2185,17 +2563,19 @@ zil_process_commit_list(zilog_t *zilog)
 		 * data; i.e.  when the pool is frozen, the last synced txg
 		 * value can't be trusted.
 		 */
+		list_remove(&zilog->zl_itx_commit_list, itx);
+
 		if (frozen || !synced || lrc->lrc_txtype == TX_COMMIT) {
 			if (lwb != NULL) {
-				lwb = zil_lwb_commit(zilog, itx, lwb);
-			} else if (lrc->lrc_txtype == TX_COMMIT) {
-				ASSERT3P(lwb, ==, NULL);
+				lwb = zil_lwb_assign(zilog, lwb, itx, ilwbs);
+				continue;
+			}
+			if (lrc->lrc_txtype == TX_COMMIT) {
 				zil_commit_waiter_link_nolwb(
 				    itx->itx_private, &nolwb_waiters);
 			}
 		}
 
-		list_remove(&zilog->zl_itx_commit_list, itx);
 		zil_itx_destroy(itx);
 	}
 
@@ -2206,6 +2586,7 @@ zil_process_commit_list(zilog_t *zilog)
 		 * the ZIL write pipeline; see the comment within
 		 * zil_commit_writer_stall() for more details.
 		 */
+		zil_lwb_write_issue_list(zilog, ilwbs);
 		zil_commit_writer_stall(zilog);
 
 		/*
@@ -2222,6 +2603,7 @@ zil_process_commit_list(zilog_t *zilog)
 	} else {
 		ASSERT(list_is_empty(&nolwb_waiters));
 		ASSERT3P(lwb, !=, NULL);
+		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_READY);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_ISSUED);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_WRITE_DONE);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_FLUSH_DONE);
@@ -2245,7 +2627,7 @@ zil_process_commit_list(zilog_t *zilog)
 		 * on the system, such that this function will be
 		 * immediately called again (not necessarily by the same
 		 * thread) and this lwb's zio will be issued via
-		 * zil_lwb_commit(). This way, the lwb is guaranteed to
+		 * zil_lwb_assign(). This way, the lwb is guaranteed to
 		 * be "full" when it is issued to disk, and we'll make
 		 * use of the lwb's size the best we can.
 		 *
@@ -2293,9 +2675,12 @@ zil_process_commit_list(zilog_t *zilog)
 static void
 zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
 {
+	list_t ilwbs;
+
 	ASSERT(!MUTEX_HELD(&zilog->zl_lock));
 	ASSERT(spa_writeable(zilog->zl_spa));
 
+	list_create(&ilwbs, sizeof (lwb_t), offsetof(lwb_t, lwb_issue_node));
 	mutex_enter(&zilog->zl_issuer_lock);
 
 	if (zcw->zcw_lwb != NULL || zcw->zcw_done) {
@@ -2320,10 +2705,20 @@ zil_commit_writer(zilog_t *zilog, zil_commit_waiter_t *zcw)
 
 	zil_get_commit_list(zilog);
 	zil_prune_commit_list(zilog);
-	zil_process_commit_list(zilog);
+	zil_process_commit_list(zilog, &ilwbs);
 
 out:
 	mutex_exit(&zilog->zl_issuer_lock);
+
+	/*
+	 * Fill in and issue the lwbs we closed, now that other threads
+	 * can assign itxs to the following lwbs. This is where the data
+	 * of WR_NEED_COPY and WR_INDIRECT writes gets retrieved, so doing
+	 * it outside of the zl_issuer_lock lets several committing
+	 * threads do that work in parallel.
+	 */
+	zil_lwb_write_issue_list(zilog, &ilwbs);
+	list_destroy(&ilwbs);
 }
 
 static void
@@ -2338,19 +2733,20 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	ASSERT3S(lwb->lwb_state, !=, LWB_STATE_CLOSED);
 
 	/*
-	 * If the lwb has already been issued by another thread, we can
+	 * If the lwb has already been closed by another thread, we can
 	 * immediately return since there's no work to be done (the
 	 * point of this function is to issue the lwb). Additionally, we
 	 * do this prior to acquiring the zl_issuer_lock, to avoid
 	 * acquiring it when it's not necessary to do so.
 	 */
-	if (lwb->lwb_state == LWB_STATE_ISSUED ||
+	if (lwb->lwb_state == LWB_STATE_READY ||
+	    lwb->lwb_state == LWB_STATE_ISSUED ||
 	    lwb->lwb_state == LWB_STATE_WRITE_DONE ||
 	    lwb->lwb_state == LWB_STATE_FLUSH_DONE)
 		return;
 
 	/*
-	 * In order to call zil_lwb_write_issue() we must hold the
+	 * In order to call zil_lwb_write_close() we must hold the
 	 * zilog's "zl_issuer_lock". We can't simply acquire that lock,
 	 * since we're already holding the commit waiter's "zcw_lock",
 	 * and those two locks are aquired in the opposite order
@@ -2379,21 +2775,22 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	 * second time while holding the lock.
 	 *
 	 * We don't need to hold the zl_lock since the lwb cannot transition
-	 * from OPENED to ISSUED while we hold the zl_issuer_lock. The lwb
-	 * _can_ transition from ISSUED to DONE, but it's OK to race with
-	 * that transition since we treat the lwb the same, whether it's in
-	 * the ISSUED or DONE states.
+	 * from OPENED to READY while we hold the zl_issuer_lock. The lwb
+	 * _can_ transition from READY to ISSUED to DONE, but it's OK to
+	 * race with those transitions since we treat the lwb the same,
+	 * whether it's in the READY, ISSUED or DONE states.
 	 *
 	 * The important thing, is we treat the lwb differently depending on
-	 * if it's ISSUED or OPENED, and block any other threads that might
-	 * attempt to issue this lwb. For that reason we hold the
+	 * if it's READY or OPENED, and block any other threads that might
+	 * attempt to close this lwb. For that reason we hold the
 	 * zl_issuer_lock when checking the lwb_state; we must not call
-	 * zil_lwb_write_issue() if the lwb had already been issued.
+	 * zil_lwb_write_close() if the lwb had already been closed.
 	 *
 	 * See the comment above the lwb_state_t structure definition for
 	 * more details on the lwb states, and locking requirements.
 	 */
-	if (lwb->lwb_state == LWB_STATE_ISSUED ||
+	if (lwb->lwb_state == LWB_STATE_READY ||
+	    lwb->lwb_state == LWB_STATE_ISSUED ||
 	    lwb->lwb_state == LWB_STATE_WRITE_DONE ||
 	    lwb->lwb_state == LWB_STATE_FLUSH_DONE)
 		goto out;
@@ -2406,9 +2803,9 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	 * since we've reached the commit waiter's timeout and it still
 	 * hasn't been issued.
 	 */
-	lwb_t *nlwb = zil_lwb_write_issue(zilog, lwb);
+	lwb_t *nlwb = zil_lwb_write_close(zilog, lwb);
 
-	IMPLY(nlwb != NULL, lwb->lwb_state != LWB_STATE_OPENED);
+	ASSERT3S(lwb->lwb_state, ==, LWB_STATE_READY);
 
 	/*
 	 * Since the lwb's zio hadn't been issued by the time this thread
@@ -2424,9 +2821,16 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 	 */
 	zilog->zl_cur_used = 0;
 
+	/*
+	 * We must drop the commit waiter's lock prior to filling in and
+	 * issuing the lwb; see below. Until the lwb is issued, the waiter
+	 * can't be marked "done", so the lwb remains valid.
+	 */
+	mutex_exit(&zcw->zcw_lock);
+
 	if (nlwb == NULL) {
 		/*
-		 * When zil_lwb_write_issue() returns NULL, this
+		 * When zil_lwb_write_close() returns NULL, this
 		 * indicates zio_alloc_zil() failed to allocate the
 		 * "next" lwb on-disk. When this occurs, the ZIL write
 		 * pipeline must be stalled; see the comment within the
@@ -2446,12 +2850,21 @@ zil_commit_waiter_timeout(zilog_t *zilog, zil_commit_waiter_t *zcw)
 		 * - The lwb's zio callback can't call dmu_tx_commit()
 		 *   because it's blocked trying to acquire the waiter's
 		 *   lock, which occurs prior to calling dmu_tx_commit()
+		 *
+		 * The lwb itself holds a tx open, so it must be issued
+		 * before we stall.
 		 */
-		mutex_exit(&zcw->zcw_lock);
+		zil_lwb_write_issue(zilog, lwb);
 		zil_commit_writer_stall(zilog);
-		mutex_enter(&zcw->zcw_lock);
+		mutex_exit(&zilog->zl_issuer_lock);
+	} else {
+		mutex_exit(&zilog->zl_issuer_lock);
+		zil_lwb_write_issue(zilog, lwb);
 	}
 
+	mutex_enter(&zcw->zcw_lock);
+	return;
+
 out:
 	mutex_exit(&zilog->zl_issuer_lock);
 	ASSERT(MUTEX_HELD(&zcw->zcw_lock));
@@ -2556,9 +2969,10 @@ zil_commit_waiter(zilog_t *zilog, zil_commit_waiter_t *zcw)
 		} else {
 			/*
 			 * If the lwb isn't open, then it must have already
-			 * been issued. In that case, there's no need to
-			 * use a timeout when waiting for the lwb to
-			 * complete.
+			 * been closed, and will be (or has been) issued by
+			 * the thread that closed it. In that case, there's
+			 * no need to use a timeout when waiting for the lwb
+			 * to complete.
 			 *
 			 * Additionally, if the lwb is NULL, the waiter
 			 * will soon be signalled and marked done via
@@ -2567,6 +2981,7 @@ zil_commit_waiter(zilog_t *zilog, zil_commit_waiter_t *zcw)
 			 */
 
 			IMPLY(lwb != NULL,
+			    lwb->lwb_state == LWB_STATE_READY ||
 			    lwb->lwb_state == LWB_STATE_ISSUED ||
 			    lwb->lwb_state == LWB_STATE_WRITE_DONE ||
 			    lwb->lwb_state == LWB_STATE_FLUSH_DONE);
@@ -2588,6 +3003,7 @@ zil_alloc_commit_waiter()
 	zcw->zcw_lwb = NULL;
 	zcw->zcw_done = B_FALSE;
 	zcw->zcw_zio_error = 0;
+	zcw->zcw_wait_txg = 0;
 
 	return (zcw);
 }
@@ -2728,14 +3144,17 @@ zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw)
  *      much of the underlying storage performance as possible, we rely
  *      on two fundamental concepts:
  *
- *          1. The creation and issuance of lwb zio's is protected by
- *             the zilog's "zl_issuer_lock", which ensures only a single
- *             thread is creating and/or issuing lwb's at a time
+ *          1. The creation of lwb zio's, the assignment of itxs to
+ *             lwbs, and the allocation of each lwb's "next" block are
+ *             protected by the zilog's "zl_issuer_lock", which ensures
+ *             only a single thread is building the chain of lwb's at a
+ *             time
  *          2. The "previous" lwb is a child of the "current" lwb
  *             (leveraging the zio parent-child depenency graph)
  *
  *      By relying on this parent-child zio relationship, we can have
  *      many lwb zio's concurrently issued to the underlying storage,
+ *      by several threads and in any order (see zil_lwb_write_issue()),
  *      but the order in which they complete will be the same order in
  *      which they were created.
  */
@@ -2770,7 +3189,7 @@ zil_commit(zilog_t *zilog, uint64_t foid)
 		 */
 		ASSERT(list_is_empty(&zilog->zl_lwb_list));
 		ASSERT3P(zilog->zl_last_lwb_opened, ==, NULL);
-		for (int i = 0; i < TXG_SIZE; i++)
+		for (int i = 0; i < zilog->zl_itx_nsublists * TXG_SIZE; i++)
 			ASSERT3P(zilog->zl_itxg[i].itxg_itxs, ==, NULL);
 		return;
 	}
@@ -2837,6 +3256,13 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 		DTRACE_PROBE2(zil__commit__io__error,
 		    zilog_t *, zilog, zil_commit_waiter_t *, zcw);
 		txg_wait_synced(zilog->zl_dmu_pool, 0);
+	} else if (zcw->zcw_wait_txg > spa_last_synced_txg(zilog->zl_spa)) {
+		/*
+		 * Some of the records this thread is waiting on had to
+		 * be left out of the lwbs (see zil_lwb_commit()), so we
+		 * have to wait for their txg to sync instead.
+		 */
+		txg_wait_synced(zilog->zl_dmu_pool, zcw->zcw_wait_txg);
 	}
 
 	zil_free_commit_waiter(zcw);
@@ -2918,6 +3344,7 @@ static int
 zil_lwb_cons(void *vbuf, void *unused, int kmflag)
 {
 	lwb_t *lwb = vbuf;
+	list_create(&lwb->lwb_itxs, sizeof (itx_t), offsetof(itx_t, itx_node));
 	list_create(&lwb->lwb_waiters, sizeof (zil_commit_waiter_t),
 	    offsetof(zil_commit_waiter_t, zcw_node));
 	avl_create(&lwb->lwb_vdev_tree, zil_lwb_vdev_compare,
@@ -2934,6 +3361,7 @@ zil_lwb_dest(void *vbuf, void *unused)
 	mutex_destroy(&lwb->lwb_vdev_lock);
 	avl_destroy(&lwb->lwb_vdev_tree);
 	list_destroy(&lwb->lwb_waiters);
+	list_destroy(&lwb->lwb_itxs);
 }
 
 void
@@ -2986,7 +3414,19 @@ zil_alloc(objset_t *os, zil_header_t *zh_phys)
 	mutex_init(&zilog->zl_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&zilog->zl_issuer_lock, NULL, MUTEX_DEFAULT, NULL);
 
-	for (int i = 0; i < TXG_SIZE; i++) {
+	/*
+	 * Snapshots never have any itxs assigned, so don't bother giving
+	 * them more than one sublist.
+	 */
+	if (dmu_objset_is_snapshot(os)) {
+		zilog->zl_itx_nsublists = 1;
+	} else {
+		zilog->zl_itx_nsublists = MAX(1, MIN(MIN(zil_itx_sublists,
+		    ZIL_ITX_SUBLISTS_MAX), boot_ncpus));
+	}
+	zilog->zl_itxg = kmem_zalloc(zilog->zl_itx_nsublists * TXG_SIZE *
+	    sizeof (itxg_t), KM_SLEEP);
+	for (int i = 0; i < zilog->zl_itx_nsublists * TXG_SIZE; i++) {
 		mutex_init(&zilog->zl_itxg[i].itxg_lock, NULL,
 		    MUTEX_DEFAULT, NULL);
 	}
@@ -3016,7 +3456,7 @@ zil_free(zilog_t *zilog)
 	ASSERT(list_is_empty(&zilog->zl_itx_commit_list));
 	list_destroy(&zilog->zl_itx_commit_list);
 
-	for (int i = 0; i < TXG_SIZE; i++) {
+	for (int i = 0; i < zilog->zl_itx_nsublists * TXG_SIZE; i++) {
 		/*
 		 * It's possible for an itx to be generated that doesn't dirty
 		 * a txg (e.g. ztest TX_TRUNCATE). So there's no zil_clean()
@@ -3028,6 +3468,8 @@ zil_free(zilog_t *zilog)
 			zil_itxg_clean(zilog->zl_itxg[i].itxg_itxs);
 		mutex_destroy(&zilog->zl_itxg[i].itxg_lock);
 	}
+	kmem_free(zilog->zl_itxg,
+	    zilog->zl_itx_nsublists * TXG_SIZE * sizeof (itxg_t));
 
 	mutex_destroy(&zilog->zl_issuer_lock);
 	mutex_destroy(&zilog->zl_lock);
@@ -3101,6 +3543,7 @@ zil_close(zilog_t *zilog)
 	lwb = list_head(&zilog->zl_lwb_list);
 	if (lwb != NULL) {
 		ASSERT3P(lwb, ==, list_tail(&zilog->zl_lwb_list));
+		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_READY);
 		ASSERT3S(lwb->lwb_state, !=, LWB_STATE_ISSUED);
 		list_remove(&zilog->zl_lwb_list, lwb);
 		zio_buf_free(lwb->lwb_buf, lwb->lwb_sz);
@@ -3223,9 +3666,10 @@ zil_suspend(const char *osname, void **cookiep)
 
 	/*
 	 * We need to use zil_commit_impl to ensure we wait for all
-	 * LWB_STATE_OPENED and LWB_STATE_ISSUED lwb's to be committed
-	 * to disk before proceeding. If we used zil_commit instead, it
-	 * would just call txg_wait_synced(), because zl_suspend is set.
+	 * LWB_STATE_OPENED, LWB_STATE_READY and LWB_STATE_ISSUED lwb's
+	 * to be committed to disk before proceeding. If we used
+	 * zil_commit instead, it would just call txg_wait_synced(),
+	 * because zl_suspend is set.
 	 * txg_wait_synced() doesn't wait for these lwb's to be
 	 * LWB_STATE_FLUSH_DONE before returning.
 	 */
@@ -41,6 +41,7 @@
 #include <sys/dmu_objset.h>
 #include <sys/arc.h>
 #include <sys/ddt.h>
+#include <sys/brt.h>
 #include <sys/blkptr.h>
 #include <sys/zfeature.h>
 #include <sys/time.h>
@@ -887,7 +888,7 @@ zfs_blkptr_verify(spa_t *spa, const blkptr_t *bp)
 		uint64_t offset = DVA_GET_OFFSET(&bp->blk_dva[i]);
 		uint64_t asize = DVA_GET_ASIZE(&bp->blk_dva[i]);
 		if (BP_IS_GANG(bp))
-			asize = vdev_psize_to_asize(vd, SPA_GANGBLOCKSIZE);
+			asize = vdev_gang_header_asize(vd);
 		if (offset + asize > vd->vdev_asize) {
 			zfs_panic_recover("blkptr at %p DVA %u has invalid "
 			    "OFFSET %llu",
@@ -919,7 +920,7 @@ zfs_dva_valid(spa_t *spa, const dva_t *dva, const blkptr_t *bp)
 	uint64_t asize = DVA_GET_ASIZE(dva);
 
 	if (BP_IS_GANG(bp))
-		asize = vdev_psize_to_asize(vd, SPA_GANGBLOCKSIZE);
+		asize = vdev_gang_header_asize(vd);
 	if (offset + asize > vd->vdev_asize)
 		return (B_FALSE);
 
@@ -1004,7 +1005,8 @@ zio_rewrite(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp, abd_t *data,
 }
 
 void
-zio_write_override(zio_t *zio, blkptr_t *bp, int copies, boolean_t nopwrite)
+zio_write_override(zio_t *zio, blkptr_t *bp, int copies, boolean_t nopwrite,
+    boolean_t brtwrite)
 {
 	ASSERT(zio->io_type == ZIO_TYPE_WRITE);
 	ASSERT(zio->io_child_type == ZIO_CHILD_LOGICAL);
@@ -1014,10 +1016,12 @@ zio_write_override(zio_t *zio, blkptr_t *bp, int copies, boolean_t nopwrite)
 	/*
 	 * We must reset the io_prop to match the values that existed
 	 * when the bp was first written by dmu_sync() keeping in mind
-	 * that nopwrite and dedup are mutually exclusive.
+	 * that nopwrite and dedup are mutually exclusive.  A cloned block
+	 * keeps whatever dedup bit its source had.
 	 */
 	zio->io_prop.zp_dedup = nopwrite ? B_FALSE : zio->io_prop.zp_dedup;
 	zio->io_prop.zp_nopwrite = nopwrite;
+	zio->io_prop.zp_brtwrite = brtwrite;
 	zio->io_prop.zp_copies = copies;
 	zio->io_bp_override = bp;
 }
@@ -1039,9 +1043,9 @@ zio_free(spa_t *spa, uint64_t txg, const blkptr_t *bp)
 
 	/*
 	 * Frees that are for the currently-syncing txg, are not going to be
-	 * deferred, and which will not need to do a read (i.e. not GANG or
-	 * DEDUP), can be processed immediately.  Otherwise, put them on the
-	 * in-memory list for later processing.
+	 * deferred, and which will not need to do a read (i.e. not GANG,
+	 * DEDUP or possibly cloned), can be processed immediately.
+	 * Otherwise, put them on the in-memory list for later processing.
 	 *
 	 * Note that we only defer frees after zfs_sync_pass_deferred_free
 	 * when the log space map feature is disabled. [see relevant comment
@@ -1049,6 +1053,7 @@ zio_free(spa_t *spa, uint64_t txg, const blkptr_t *bp)
 	 */
 	if (BP_IS_GANG(bp) ||
 	    BP_GET_DEDUP(bp) ||
+	    brt_maybe_exists(spa, bp) ||
 	    txg != spa->spa_syncing_txg ||
 	    (spa_sync_pass(spa) >= zfs_sync_pass_deferred_free &&
 	    !spa_feature_is_active(spa, SPA_FEATURE_LOG_SPACEMAP))) {
@@ -1076,12 +1081,14 @@ zio_free_sync(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 	dsl_scan_freed(spa, bp);
 
 	/*
-	 * GANG and DEDUP blocks can induce a read (for the gang block header,
-	 * or the DDT), so issue them asynchronously so that this thread is
-	 * not tied up.
+	 * GANG, DEDUP and cloned blocks can induce a read (for the gang block
+	 * header, the DDT or the BRT), so issue them asynchronously so that
+	 * this thread is not tied up.
 	 */
 	if (BP_IS_GANG(bp) || BP_GET_DEDUP(bp))
 		stage |= ZIO_STAGE_ISSUE_ASYNC;
+	if (!BP_GET_DEDUP(bp) && brt_maybe_exists(spa, bp))
+		stage |= ZIO_STAGE_ISSUE_ASYNC | ZIO_STAGE_BRT_FREE;
 
 	zio = zio_create(pio, spa, txg, bp, NULL, BP_GET_PSIZE(bp),
 	    BP_GET_PSIZE(bp), NULL, NULL, ZIO_TYPE_FREE, ZIO_PRIORITY_NOW,
@@ -1414,12 +1421,17 @@ zio_write_bp_init(zio_t *zio)
 		zio_prop_t *zp = &zio->io_prop;
 
 		ASSERT(bp->blk_birth != zio->io_txg);
-		ASSERT(BP_GET_DEDUP(zio->io_bp_override) == 0);
+		ASSERT(zp->zp_brtwrite ||
+		    BP_GET_DEDUP(zio->io_bp_override) == 0);
 
 		*bp = *zio->io_bp_override;
 		zio->io_pipeline = ZIO_INTERLOCK_PIPELINE;
 
-		if (BP_IS_EMBEDDED(bp))
+		/*
+		 * A cloned block is already referenced through the BRT or
+		 * the DDT; there is nothing left to do for it here.
+		 */
+		if (BP_IS_EMBEDDED(bp) || zp->zp_brtwrite)
 			return (ZIO_PIPELINE_CONTINUE);
 
 		/*
@@ -3087,6 +3099,28 @@ zio_ddt_free(zio_t *zio)
 	return (ZIO_PIPELINE_CONTINUE);
 }
 
+/*
+ * ==========================================================================
+ * Block Reference Table
+ * ==========================================================================
+ */
+static int
+zio_brt_free(zio_t *zio)
+{
+	blkptr_t *bp = zio->io_bp;
+
+	ASSERT(zio->io_child_type == ZIO_CHILD_LOGICAL);
+
+	/*
+	 * If the block is still referenced elsewhere, only the reference
+	 * goes away; skip the rest of the free pipeline.
+	 */
+	if (!brt_entry_decref(zio->io_spa, bp))
+		zio->io_pipeline = ZIO_INTERLOCK_PIPELINE;
+
+	return (ZIO_PIPELINE_CONTINUE);
+}
+
 /*
  * ==========================================================================
  * Allocate and free blocks
@@ -3529,7 +3563,13 @@ zio_vdev_io_start(zio_t *zio)
 		return (ZIO_PIPELINE_CONTINUE);
 	}
 
-	if (vd->vdev_ops->vdev_op_leaf && (zio->io_type == ZIO_TYPE_READ ||
+	/*
+	 * Distributed spares are leaves that only remap I/O onto other
+	 * leaves, which do their own queueing and caching.
+	 */
+	if (vd->vdev_ops->vdev_op_leaf &&
+	    vd->vdev_ops != &vdev_draid_spare_ops &&
+	    (zio->io_type == ZIO_TYPE_READ ||
 	    zio->io_type == ZIO_TYPE_WRITE || zio->io_type == ZIO_TYPE_TRIM)) {
 
 		if (zio->io_type == ZIO_TYPE_READ && vdev_cache_read(zio))
@@ -3567,7 +3607,8 @@ zio_vdev_io_done(zio_t *zio)
 	if (zio->io_delay)
 		zio->io_delay = gethrtime() - zio->io_delay;
 
-	if (vd != NULL && vd->vdev_ops->vdev_op_leaf) {
+	if (vd != NULL && vd->vdev_ops->vdev_op_leaf &&
+	    vd->vdev_ops != &vdev_draid_spare_ops) {
 
 		vdev_queue_io_done(zio);
 
@@ -4511,6 +4552,7 @@ static zio_pipe_stage_t *zio_pipeline[] = {
 	zio_ddt_read_done,
 	zio_ddt_write,
 	zio_ddt_free,
+	zio_brt_free,
 	zio_gang_assemble,
 	zio_gang_issue,
 	zio_dva_throttle,
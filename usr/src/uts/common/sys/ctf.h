@@ -57,17 +57,25 @@ extern "C" {
  *
  * The CTF file or section itself has the following structure:
  *
- * +--------+--------+---------+----------+-------+--------+
- * |  file  |  type  |  data   | function | data  | string |
- * | header | labels | objects |   info   | types | table  |
- * +--------+--------+---------+----------+-------+--------+
+ * +--------+-------+--------+---------+----------+-------+--------+
+ * |  file  | name  |  type  |  data   | function | data  | string |
+ * | header | index | labels | objects |   info   | types | table  |
+ * +--------+-------+--------+---------+----------+-------+--------+
  *
  * The file header stores a magic number and version information, encoding
  * flags, and the byte offset of each of the sections relative to the end of the
- * header itself.  If the CTF data has been uniquified against another set of
- * CTF data, a reference to that data also appears in the the header.  This
- * reference is the name of the label corresponding to the types uniquified
- * against.
+ * header itself, or of the name index if there is one.  If the CTF data has
+ * been uniquified against another set of CTF data, a reference to that data
+ * also appears in the the header.  This reference is the name of the label
+ * corresponding to the types uniquified against.
+ *
+ * Starting with CTF_VERSION_3, the header is followed by a name index (see
+ * ctf_index_t, below), which is never compressed.  The index holds the hash
+ * tables used to look up struct, union, enum and other type names, along with
+ * its own copy of the names and of the parent name and label.  A consumer can
+ * therefore look up a type by name in place in the mapped section, and defer
+ * decompressing and processing the rest of the data until a type is actually
+ * examined.  Earlier versions have no index.
  *
  * Following the header is a list of labels, used to group the types included in
  * the data types section.  Each label is accompanied by a type ID i.  A given
@@ -148,10 +156,58 @@ typedef struct ctf_header_v1 {
 /* data format version number */
 #define	CTF_VERSION_1	1
 #define	CTF_VERSION_2	2
-#define	CTF_VERSION	CTF_VERSION_2	/* current version */
+#define	CTF_VERSION_3	3
+#define	CTF_VERSION	CTF_VERSION_3	/* current version */
 
 #define	CTF_F_COMPRESS	0x1	/* data buffer is compressed */
 
+/*
+ * The name index of a CTF_VERSION_3 container.  The index is made up of four
+ * hash tables, one each for struct, union and enum tags and one for all other
+ * type names, followed by a string table holding the names the hash tables
+ * refer to.  All offsets are in bytes relative to the start of the index, and
+ * the index is a multiple of four bytes long.
+ *
+ * Each hash table is an array of cit_nbuckets bucket heads, each of which is
+ * the index of the first element in its chain, and an array of cit_nelems
+ * elements.  Element zero is a sentinel, so an element index of zero ends a
+ * chain, and each element's cie_next is less than its own index.  A name is
+ * hashed into a bucket with the ELF hash function, modulo cit_nbuckets.
+ *
+ * A producer may leave an index zero-filled beyond cti_len, in which case
+ * consumers ignore it and process the type data as for earlier versions.
+ */
+#define	CTF_IDX_STRUCT	0	/* struct tags */
+#define	CTF_IDX_UNION	1	/* union tags */
+#define	CTF_IDX_ENUM	2	/* enum tags */
+#define	CTF_IDX_NAMES	3	/* typedefs and all other type names */
+#define	CTF_IDX_MAX	4
+
+typedef struct ctf_idxtab {
+	uint_t cit_nbuckets;	/* number of hash buckets */
+	uint_t cit_nelems;	/* number of elements, including sentinel */
+	uint_t cit_bucketoff;	/* offset of bucket array (ushort_t's) */
+	uint_t cit_elemoff;	/* offset of element array (ctf_idxelem_t's) */
+} ctf_idxtab_t;
+
+typedef struct ctf_idxelem {
+	uint_t cie_name;	/* offset of name in index string table */
+	ushort_t cie_type;	/* type ID of the named type */
+	ushort_t cie_next;	/* index of next element in hash chain */
+} ctf_idxelem_t;
+
+typedef struct ctf_index {
+	uint_t cti_len;		/* length of index in bytes */
+	uint_t cti_flags;	/* index flags (see below) */
+	uint_t cti_parlabel;	/* offset of parent label name, or zero */
+	uint_t cti_parname;	/* offset of parent basename, or zero */
+	uint_t cti_stroff;	/* offset of index string table */
+	uint_t cti_strlen;	/* length of index string table in bytes */
+	ctf_idxtab_t cti_tabs[CTF_IDX_MAX];	/* name hash tables */
+} ctf_index_t;
+
+#define	CTF_IDX_F_CHILD	0x1	/* container is a child */
+
 typedef struct ctf_lblent {
 	uint_t ctl_label;	/* ref to name of label */
 	uint_t ctl_typeidx;	/* last type associated with this label */
@@ -49,6 +49,7 @@
  */
 
 #include <sys/ioccom.h>
+#include <sys/types.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -140,6 +141,21 @@ extern "C" {
  */
 #define	_FIO_COUNT_FILLED	_IO('f', 100)	/* count holes in a file */
 
+/*
+ * Clone a range of another file into this one without copying the data,
+ * where the file system supports it
+ */
+#define	_FIO_CLONE_RANGE	_IO('f', 101)	/* clone a file range */
+
+#if !defined(_ASM)
+typedef struct fio_clone_range {
+	int64_t		fcr_src_fd;		/* file to clone from */
+	uint64_t	fcr_src_offset;		/* offset in source */
+	uint64_t	fcr_src_length;		/* length to clone */
+	uint64_t	fcr_dest_offset;	/* offset in this file */
+} fio_clone_range_t;
+#endif	/* !_ASM */
+
 #ifdef	__cplusplus
 }
 #endif
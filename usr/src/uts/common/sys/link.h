@@ -204,7 +204,7 @@ typedef struct {
  */
 #define	DT_ADDRRNGLO	0x6ffffe00
 
-#define	DT_GNU_HASH	0x6ffffef5	/* GNU-style hash table (unused) */
+#define	DT_GNU_HASH	0x6ffffef5	/* GNU-style hash table */
 #define	DT_TLSDESC_PLT	0x6ffffef6	/* GNU (unused) */
 #define	DT_TLSDESC_GOT	0x6ffffef7	/* GNU (unused) */
 #define	DT_GNU_CONFLICT	0x6ffffef8	/* start of conflict section (unused) */
@@ -1565,7 +1565,9 @@ static char *x86_feature_names[NUM_X86_FEATURES] = {
 	"ppin",
 	"vaes",
 	"vpclmulqdq",
-	"lfence_serializing"
+	"lfence_serializing",
+	"erms",
+	"fsrm"
 };
 
 boolean_t
@@ -3734,6 +3736,11 @@ cpuid_pass1(cpu_t *cpu, uchar_t *featureset)
 		if (ecp->cp_ebx & CPUID_INTC_EBX_7_0_INVPCID)
 			add_x86_feature(featureset, X86FSET_INVPCID);
 
+		if (ecp->cp_ebx & CPUID_INTC_EBX_7_0_ENH_REP_MOV)
+			add_x86_feature(featureset, X86FSET_ERMS);
+		if (ecp->cp_edx & CPUID_INTC_EDX_7_0_FSREPMOV)
+			add_x86_feature(featureset, X86FSET_FSRM);
+
 		if (ecp->cp_ecx & CPUID_INTC_ECX_7_0_UMIP)
 			add_x86_feature(featureset, X86FSET_UMIP);
 		if (ecp->cp_ecx & CPUID_INTC_ECX_7_0_PKU)
@@ -5543,6 +5550,10 @@ cpuid_pass4(cpu_t *cpu, uint_t *hwcap_out)
 	 */
 	if (is_x86_feature(x86_featureset, X86FSET_CLZERO))
 		hwcap_flags_2 |= AV_386_2_CLZERO;
+	if (is_x86_feature(x86_featureset, X86FSET_ERMS))
+		hwcap_flags_2 |= AV_386_2_ERMS;
+	if (is_x86_feature(x86_featureset, X86FSET_FSRM))
+		hwcap_flags_2 |= AV_386_2_FSRM;
 
 	if (cpi->cpi_xmaxeax < 0x80000001)
 		goto pass4_done;
@@ -740,6 +740,8 @@ extern "C" {
 #define	X86FSET_VAES		100
 #define	X86FSET_VPCLMULQDQ	101
 #define	X86FSET_LFENCE_SER	102
+#define	X86FSET_ERMS		103
+#define	X86FSET_FSRM		104
 
 /*
  * Intel Deep C-State invariant TSC in leaf 0x80000007.
@@ -1166,7 +1168,7 @@ extern "C" {
 
 #if defined(_KERNEL) || defined(_KMEMUSER)
 
-#define	NUM_X86_FEATURES	103
+#define	NUM_X86_FEATURES	105
 extern uchar_t x86_featureset[];
 
 extern void free_x86_featureset(void *featureset);